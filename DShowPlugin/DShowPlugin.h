@@ -40,7 +40,7 @@ void GetOutputList(IPin *curPin, List<MediaOutputInfo> &outputInfoList);
 bool GetClosestResolutionFPS(List<MediaOutputInfo> &outputList, SIZE &resolution, UINT64 &frameInterval, bool bPrioritizeFPS);
 
 extern LocaleStringLookup *pluginLocale;
-#define PluginStr(text) pluginLocale->LookupString(TEXT2(text))
+#define PluginStr(text) pluginLocale->LookupString(TEXT2(text), LocaleHashLiteral(TEXT2(text)))
 
 enum DeinterlacingType {
     DEINTERLACING_NONE,
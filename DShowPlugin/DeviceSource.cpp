@@ -74,6 +74,9 @@ bool DeviceSource::Init(XElement *data)
         return false;
     }
 
+    videoPool = new SamplePool;
+    audioPool = new SamplePool;
+
     capture->SetFiltergraph(graph);
 
     int numThreads = MAX(OSGetTotalCores()-2, 1);
@@ -101,6 +104,10 @@ DeviceSource::~DeviceSource()
 
     FlushSamples();
 
+    //anything still holding a sample keeps its pool alive until it's done with it
+    SafeRelease(videoPool);
+    SafeRelease(audioPool);
+
     SafeReleaseLogRef(capture);
     SafeReleaseLogRef(graph);
 
@@ -127,7 +134,7 @@ String DeviceSource::ChooseShader()
     if(bUseChromaKey)
         strShader << TEXT("ChromaKey_");
 
-    if(colorType == DeviceOutputType_I420)
+    if(colorType == DeviceOutputType_I420 || colorType == DeviceOutputType_NV12 || colorType == DeviceOutputType_P010)
         strShader << TEXT("YUVToRGB.pShader");
     else if(colorType == DeviceOutputType_YV12)
         strShader << TEXT("YVUToRGB.pShader");
@@ -512,6 +519,10 @@ bool DeviceSource::LoadFilters()
         colorType = DeviceOutputType_I420;
     else if(bestOutput->videoType == VideoOutputType_YV12)
         colorType = DeviceOutputType_YV12;
+    else if(bestOutput->videoType == VideoOutputType_NV12)
+        colorType = DeviceOutputType_NV12;
+    else if(bestOutput->videoType == VideoOutputType_P010)
+        colorType = DeviceOutputType_P010;
     else if(bestOutput->videoType == VideoOutputType_YVYU)
         colorType = DeviceOutputType_YVYU;
     else if(bestOutput->videoType == VideoOutputType_YUY2)
@@ -556,6 +567,8 @@ bool DeviceSource::LoadFilters()
     bmi->biHeight         = renderCY;
     bmi->biSizeImage      = renderCX*renderCY*(bmi->biBitCount>>3);
 
+    videoPool->SetBufferSize(renderCX*renderCY*bmi->biBitCount/8);
+
     if(FAILED(err = config->SetFormat(&outputMediaType)))
     {
         if(err != E_NOTIMPL)
@@ -821,6 +834,11 @@ bool DeviceSource::LoadFilters()
             goto cleanFinish;
         }
 
+        if (!(hSampleEvent = CreateEvent(NULL, FALSE, FALSE, NULL))) {
+            AppWarning(TEXT("DShowPlugin: Failed to create sample event"), err);
+            goto cleanFinish;
+        }
+
         if (!(hSampleThread = OSCreateThread((XTHREAD)SampleThread, this))) {
             AppWarning(TEXT("DShowPlugin: Failed to create sample thread"), err);
             goto cleanFinish;
@@ -881,6 +899,11 @@ cleanFinish:
             hStopSampleEvent = NULL;
         }
 
+        if (hSampleEvent) {
+            CloseHandle(hSampleEvent);
+            hSampleEvent = NULL;
+        }
+
         if(colorConvertShader)
         {
             delete colorConvertShader;
@@ -923,9 +946,11 @@ void DeviceSource::UnloadFilters()
         WaitForSingleObject(hSampleThread, INFINITE);
         CloseHandle(hSampleThread);
         CloseHandle(hStopSampleEvent);
+        CloseHandle(hSampleEvent);
 
         hSampleThread = NULL;
         hStopSampleEvent = NULL;
+        hSampleEvent = NULL;
     }
 
     if(texture)
@@ -1075,113 +1100,41 @@ void DeviceSource::GlobalSourceEnterScene()
 DWORD DeviceSource::SampleThread(DeviceSource *source)
 {
     HANDLE hSampleMutex = source->hSampleMutex;
-    LONGLONG lastTime = GetQPCTime100NS(), bufferTime = 0, frameWait = 0, curBufferTime = source->bufferTime;
-    LONGLONG lastSampleTime = 0;
+    HANDLE hEvents[2] = {source->hStopSampleEvent, source->hSampleEvent};
+    DWORD timeout = INFINITE;
 
-    bool bFirstFrame = true;
-    bool bFirstDelay = true;
+    SampleScheduler scheduler;
+    scheduler.Reset(GetQPCTime100NS(), source->bufferTime);
 
-    while (WaitForSingleObject(source->hStopSampleEvent, 2) == WAIT_TIMEOUT) {
+    //sleeps until a new sample comes in or until the oldest one is due, rather than polling
+    while (WaitForMultipleObjects(2, hEvents, FALSE, timeout) != WAIT_OBJECT_0) {
         LONGLONG t = GetQPCTime100NS();
-        LONGLONG delta = t-lastTime;
-        lastTime = t;
 
         OSEnterMutex(hSampleMutex);
-
-        if (source->samples.Num()) {
-            if (bFirstFrame) {
-                bFirstFrame = false;
-                lastSampleTime = source->samples[0]->timestamp;
-            }
-
-            //wait until the requested delay has been buffered before processing packets
-            if (bufferTime >= source->bufferTime) {
-                frameWait += delta;
-
-                //if delay time was adjusted downward, remove packets accordingly
-                bool bBufferTimeChanged = (curBufferTime != source->bufferTime);
-                if (bBufferTimeChanged) {
-                    if (curBufferTime > source->bufferTime) {
-                        if (source->audioOut)
-                            source->audioOut->FlushSamples();
-
-                        LONGLONG lostTime = curBufferTime - source->bufferTime;
-                        bufferTime -= lostTime;
-
-                        if (source->samples.Num()) {
-                            LONGLONG startTime = source->samples[0]->timestamp;
-
-                            while (source->samples.Num()) {
-                                SampleData *sample = source->samples[0];
-
-                                if ((sample->timestamp - startTime) >= lostTime)
-                                    break;
-
-                                lastSampleTime = sample->timestamp;
-
-                                sample->Release();
-                                source->samples.Remove(0);
-                            }
-                        }
-                    }
-
-                    curBufferTime = source->bufferTime;
-                }
-
-                while (source->samples.Num()) {
-                    SampleData *sample = source->samples[0];
-
-                    LONGLONG timestamp = sample->timestamp;
-                    LONGLONG sampleTime = timestamp - lastSampleTime;
-
-                    //sometimes timestamps can go to shit with horrible garbage devices.
-                    //so, bypass any unusual timestamp offsets.
-                    if (sampleTime < -10000000 || sampleTime > 10000000) {
-                        //OSDebugOut(TEXT("sample time: %lld\r\n"), sampleTime);
-                        sampleTime = 0;
-                    }
-
-                    if (frameWait < sampleTime)
-                        break;
-
-                    if (sample->bAudio) {
-                        if (source->audioOut)
-                            source->audioOut->ReceiveAudio(sample->lpData, sample->dataLength);
-
-                        sample->Release();
-                    } else {
-                        SafeRelease(source->latestVideoSample);
-                        source->latestVideoSample = sample;
-                    }
-
-                    source->samples.Remove(0);
-
-                    if (sampleTime > 0)
-                        frameWait -= sampleTime;
-
-                    lastSampleTime = timestamp;
-                }
-            }
-        }
-
+        timeout = scheduler.Update(t, source->bufferTime, source->samples, source);
         OSLeaveMutex(hSampleMutex);
-
-        if (!bFirstFrame && bufferTime < source->bufferTime)
-            bufferTime += delta;
     }
 
     return 0;
 }
 
-UINT DeviceSource::GetSampleInsertIndex(LONGLONG timestamp)
+void DeviceSource::OutputSample(SampleData *sample)
 {
-    UINT index;
-    for (index=0; index<samples.Num(); index++) {
-        if (samples[index]->timestamp > timestamp)
-            return index;
+    if (sample->bAudio) {
+        if (audioOut)
+            audioOut->ReceiveAudio(sample->lpData, sample->dataLength);
+
+        sample->Release();
+    } else {
+        SafeRelease(latestVideoSample);
+        latestVideoSample = sample;
     }
+}
 
-    return index;
+void DeviceSource::FlushAudio()
+{
+    if (audioOut)
+        audioOut->FlushSamples();
 }
 
 void DeviceSource::KillThreads()
@@ -1228,8 +1181,12 @@ void DeviceSource::ChangeSize(bool bSucceeded, bool bForce)
         break;
     case DeviceOutputType_I420:
     case DeviceOutputType_YV12:
+    case DeviceOutputType_NV12:
         lineSize = renderCX; //per plane
         break;
+    case DeviceOutputType_P010:
+        lineSize = renderCX * 2;
+        break;
     case DeviceOutputType_YVYU:
     case DeviceOutputType_YUY2:
     case DeviceOutputType_UYVY:
@@ -1290,13 +1247,14 @@ void DeviceSource::ChangeSize(bool bSucceeded, bool bForce)
     int numThreads = MAX(OSGetTotalCores()-2, 1);
     for(int i=0; i<numThreads; i++)
     {
-        convertData[i].width  = lineSize;
+        convertData[i].width  = renderCX;
         convertData[i].height = renderCY;
         convertData[i].sample = NULL;
         convertData[i].hSignalConvert  = CreateEvent(NULL, FALSE, FALSE, NULL);
         convertData[i].hSignalComplete = CreateEvent(NULL, FALSE, FALSE, NULL);
         convertData[i].linePitch = linePitch;
         convertData[i].lineShift = lineShift;
+        convertData[i].colorType = colorType;
 
         if(i == 0)
             convertData[i].startY = 0;
@@ -1309,7 +1267,7 @@ void DeviceSource::ChangeSize(bool bSucceeded, bool bForce)
             convertData[i].endY = ((renderCY/numThreads)*(i+1)) & 0xFFFFFFFE;
     }
 
-    if(colorType == DeviceOutputType_YV12 || colorType == DeviceOutputType_I420)
+    if(IsPlanarType())
     {
         for(int i=0; i<numThreads; i++)
             hConvertThreads[i] = OSCreateThread((XTHREAD)PackPlanarThread, convertData+i);
@@ -1351,7 +1309,7 @@ void DeviceSource::ChangeSize(bool bSucceeded, bool bForce)
 
     if(bSucceeded && bUseThreadedConversion)
     {
-        if(colorType == DeviceOutputType_I420 || colorType == DeviceOutputType_YV12)
+        if(IsPlanarType())
         {
             LPBYTE lpData;
             if(texture->Map(lpData, texturePitch))
@@ -1380,7 +1338,6 @@ void DeviceSource::ReceiveMediaSample(IMediaSample *sample, bool bAudio)
             return;
 
         if (SUCCEEDED(sample->GetPointer(&pointer))) {
-            SampleData *data = NULL;
             AM_MEDIA_TYPE *mt = nullptr;
 
             if (sample->GetMediaType(&mt) == S_OK)
@@ -1388,43 +1345,54 @@ void DeviceSource::ReceiveMediaSample(IMediaSample *sample, bool bAudio)
                 BITMAPINFOHEADER *bih = GetVideoBMIHeader(mt);
                 newCX = bih->biWidth;
                 newCY = bih->biHeight;
+                if (!bAudio)
+                    videoPool->SetBufferSize(bih->biSizeImage);
                 DeleteMediaType(mt);
             }
 
-            if (bUseBuffering || !bAudio) {
-                data = new SampleData;
-                data->bAudio = bAudio;
-                data->dataLength = sample->GetActualDataLength();
-                data->lpData = (LPBYTE)Allocate(data->dataLength);//pointer; //
-                data->cx = newCX;
-                data->cy = newCY;
-                /*data->sample = sample;
-                sample->AddRef();*/
+            //the data is still copied out rather than holding on to the media sample: the filter's
+            //allocator only has a few buffers, and keeping them queued up would stall the device
+            LONGLONG stopTime, timestamp = 0;
+            sample->GetTime(&stopTime, &timestamp);
+
+            QueueSample(pointer, sample->GetActualDataLength(), timestamp, bAudio);
+        }
+    }
+}
 
-                memcpy(data->lpData, pointer, data->dataLength);
+//everything after the directshow specific part, so samples can be fed in from anywhere
+void DeviceSource::QueueSample(LPBYTE lpData, long dataLength, LONGLONG timestamp, bool bAudio)
+{
+    SampleData *data = NULL;
 
-                LONGLONG stopTime;
-                sample->GetTime(&stopTime, &data->timestamp);
-            }
+    if (bUseBuffering || !bAudio) {
+        data = (bAudio ? audioPool : videoPool)->GetSample(dataLength);
+        data->bAudio = bAudio;
+        data->cx = newCX;
+        data->cy = newCY;
+        data->timestamp = timestamp;
 
-            //Log(TEXT("timestamp: %lld, bAudio - %s"), data->timestamp, bAudio ? TEXT("true") : TEXT("false"));
+        memcpy(data->lpData, lpData, dataLength);
+    }
 
-            OSEnterMutex(hSampleMutex);
+    //Log(TEXT("timestamp: %lld, bAudio - %s"), timestamp, bAudio ? TEXT("true") : TEXT("false"));
 
-            if (bUseBuffering) {
-                UINT id = GetSampleInsertIndex(data->timestamp);
-                samples.Insert(id, data);
-            } else if (bAudio) {
-                if (audioOut)
-                    audioOut->ReceiveAudio(pointer, sample->GetActualDataLength());
-            } else {
-                SafeRelease(latestVideoSample);
-                latestVideoSample = data;
-            }
+    OSEnterMutex(hSampleMutex);
 
-            OSLeaveMutex(hSampleMutex);
-        }
+    if (bUseBuffering) {
+        samples.Insert(data);
+    } else if (bAudio) {
+        if (audioOut)
+            audioOut->ReceiveAudio(lpData, dataLength);
+    } else {
+        SafeRelease(latestVideoSample);
+        latestVideoSample = data;
     }
+
+    OSLeaveMutex(hSampleMutex);
+
+    if (bUseBuffering && hSampleEvent)
+        SetEvent(hSampleEvent);
 }
 
 static DWORD STDCALL PackPlanarThread(ConvertData *data)
@@ -1433,7 +1401,7 @@ static DWORD STDCALL PackPlanarThread(ConvertData *data)
         WaitForSingleObject(data->hSignalConvert, INFINITE);
         if(data->bKillThread) break;
 
-        PackPlanar(data->output, data->input, data->width, data->height, data->pitch, data->startY, data->endY, data->linePitch, data->lineShift);
+        PackPlanar(data->colorType, data->output, data->input, data->width, data->height, data->pitch, data->startY, data->endY, data->linePitch, data->lineShift);
         data->sample->Release();
 
         SetEvent(data->hSignalComplete);
@@ -1511,7 +1479,7 @@ void DeviceSource::Preprocess()
                 bReadyToDraw = true;
             }
         }
-        else if(colorType == DeviceOutputType_I420 || colorType == DeviceOutputType_YV12)
+        else if(IsPlanarType())
         {
             if(bUseThreadedConversion)
             {
@@ -1554,7 +1522,7 @@ void DeviceSource::Preprocess()
 
                 if(texture->Map(lpData, pitch))
                 {
-                    PackPlanar(lpData, lastSample->lpData, renderCX, renderCY, pitch, 0, renderCY, linePitch, lineShift);
+                    PackPlanar(colorType, lpData, lastSample->lpData, renderCX, renderCY, pitch, 0, renderCY, linePitch, lineShift);
                     texture->Unmap();
                 }
 
@@ -1859,6 +1827,8 @@ void DeviceSource::SetInt(CTSTR lpName, int iVal)
         else if(scmpi(lpName, TEXT("bufferTime")) == 0)
         {
             bufferTime = iVal*10000;
+            if(hSampleEvent)
+                SetEvent(hSampleEvent);
         }
     }
 }
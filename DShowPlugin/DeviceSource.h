@@ -21,7 +21,7 @@
 
 #include <memory>
 
-void PackPlanar(LPBYTE convertBuffer, LPBYTE lpPlanar, UINT renderCX, UINT renderCY, UINT pitch, UINT startY, UINT endY, UINT linePitch, UINT lineShift);
+#include "SampleQueue.h"
 
 enum DeviceColorType
 {
@@ -30,6 +30,8 @@ enum DeviceColorType
     //planar 4:2:0
     DeviceOutputType_I420,
     DeviceOutputType_YV12,
+    DeviceOutputType_NV12,
+    DeviceOutputType_P010,
 
     //packed 4:2:2
     DeviceOutputType_YVYU,
@@ -38,27 +40,7 @@ enum DeviceColorType
     DeviceOutputType_HDYC,
 };
 
-struct SampleData {
-    //IMediaSample *sample;
-    LPBYTE lpData;
-    long dataLength;
-
-    int cx, cy;
-
-    bool bAudio;
-    LONGLONG timestamp;
-    volatile long refs;
-
-    inline SampleData() {refs = 1;}
-    inline ~SampleData() {Free(lpData);} //sample->Release();}
-
-    inline void AddRef() {++refs;}
-    inline void Release()
-    {
-        if(!InterlockedDecrement(&refs))
-            delete this;
-    }
-};
+void PackPlanar(DeviceColorType colorType, LPBYTE convertBuffer, LPBYTE lpPlanar, UINT renderCX, UINT renderCY, UINT pitch, UINT startY, UINT endY, UINT linePitch, UINT lineShift);
 
 struct ConvertData
 {
@@ -70,6 +52,7 @@ struct ConvertData
     UINT   pitch;
     UINT   startY, endY;
     UINT   linePitch, lineShift;
+    DeviceColorType colorType;
 };
 
 class DeviceSource;
@@ -103,7 +86,7 @@ public:
     inline void SetAudioOffset(int offset) {this->offset = offset; SetTimeOffset(offset);}
 };
 
-class DeviceSource : public ImageSource
+class DeviceSource : public ImageSource, SampleOutput
 {
     friend class DeviceAudioSource;
     friend class CapturePin;
@@ -171,12 +154,13 @@ class DeviceSource : public ImageSource
     Shader          *drawShader;
 
     bool            bUseBuffering;
-    HANDLE          hStopSampleEvent;
+    HANDLE          hStopSampleEvent, hSampleEvent;
     HANDLE          hSampleMutex;
     HANDLE          hSampleThread;
     UINT            bufferTime;
     SampleData      *latestVideoSample;
-    List<SampleData*> samples;
+    SampleQueue     samples;
+    SamplePool      *videoPool, *audioPool;
 
     UINT            opacity;
 
@@ -208,11 +192,17 @@ class DeviceSource : public ImageSource
 
     void Convert422To444(LPBYTE convertBuffer, LPBYTE lp422, UINT pitch, bool bLeadingY);
 
+    inline bool IsPlanarType() const
+    {
+        return colorType == DeviceOutputType_I420 || colorType == DeviceOutputType_YV12 ||
+               colorType == DeviceOutputType_NV12 || colorType == DeviceOutputType_P010;
+    }
+
     void FlushSamples()
     {
         OSEnterMutex(hSampleMutex);
         for (UINT i=0; i<samples.Num(); i++)
-            delete samples[i];
+            samples[i]->Release();
         samples.Clear();
         SafeRelease(latestVideoSample);
         OSLeaveMutex(hSampleMutex);
@@ -220,8 +210,8 @@ class DeviceSource : public ImageSource
 
     void SetAudioInfo(AM_MEDIA_TYPE *audioMediaType, GUID &expectedAudioType);
 
-    UINT GetSampleInsertIndex(LONGLONG timestamp);
     void ReceiveMediaSample(IMediaSample *sample, bool bAudio);
+    void QueueSample(LPBYTE lpData, long dataLength, LONGLONG timestamp, bool bAudio);
 
     bool LoadFilters();
     void UnloadFilters();
@@ -231,6 +221,9 @@ class DeviceSource : public ImageSource
 
     static DWORD WINAPI SampleThread(DeviceSource *source);
 
+    void OutputSample(SampleData *sample);
+    void FlushAudio();
+
 public:
     bool Init(XElement *data);
     ~DeviceSource();
@@ -250,5 +243,8 @@ public:
     void SetFloat(CTSTR lpName, float fValue);
 
     Vect2 GetSize() const {return Vect2(float(imageCX), float(imageCY));}
+
+    //the device can only be opened once, keeping it open in a warm scene would leave other scenes blank
+    bool CanKeepWarm() const {return false;}
 };
 
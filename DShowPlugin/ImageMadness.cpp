@@ -18,39 +18,18 @@
 
 
 #include "DShowPlugin.h"
+#include "ImageMadnessKernels.h"
+
 
 //now properly takes CPU cache into account - it's just so much faster than it was.
-void PackPlanar(LPBYTE convertBuffer, LPBYTE lpPlanar, UINT renderCX, UINT renderCY, UINT pitch, UINT startY, UINT endY, UINT linePitch, UINT lineShift)
+void PackPlanar(DeviceColorType colorType, LPBYTE convertBuffer, LPBYTE lpPlanar, UINT renderCX, UINT renderCY, UINT pitch, UINT startY, UINT endY, UINT linePitch, UINT lineShift)
 {
-    LPBYTE output = convertBuffer;
-    LPBYTE input = lpPlanar + lineShift;
-    LPBYTE input2 = input+(renderCX*renderCY);
-    LPBYTE input3 = input2+(renderCX*renderCY/4);
-
-    UINT halfStartY = startY/2;
-    UINT halfX = renderCX/2;
-    UINT halfY = endY/2;
-
-    for(UINT y=halfStartY; y<halfY; y++)
-    {
-        LPBYTE lpLum1 = input + y*2*linePitch;
-        LPBYTE lpLum2 = lpLum1 + linePitch;
-        LPBYTE lpChroma1 = input2 + y*(linePitch/2);
-        LPBYTE lpChroma2 = input3 + y*(linePitch/2);
-        LPDWORD output1 = (LPDWORD)(output + (y*2)*pitch);
-        LPDWORD output2 = (LPDWORD)(((LPBYTE)output1)+pitch);
-
-        for(UINT x=0; x<halfX; x++)
-        {
-            DWORD out = (*(lpChroma1++) << 8) | (*(lpChroma2++) << 16);
-
-            *(output1++) = *(lpLum1++) | out;
-            *(output1++) = *(lpLum1++) | out;
-
-            *(output2++) = *(lpLum2++) | out;
-            *(output2++) = *(lpLum2++) | out;
-        }
-    }
+    if(colorType == DeviceOutputType_NV12)
+        PackNV12(convertBuffer, lpPlanar, renderCX, renderCY, pitch, startY, endY, linePitch, lineShift);
+    else if(colorType == DeviceOutputType_P010)
+        PackP010(convertBuffer, lpPlanar, renderCX, renderCY, pitch, startY, endY, linePitch, lineShift);
+    else
+        PackI420(convertBuffer, lpPlanar, renderCX, renderCY, pitch, startY, endY, linePitch, lineShift);
 }
 
 void DeviceSource::Convert422To444(LPBYTE convertBuffer, LPBYTE lp422, UINT pitch, bool bLeadingY)
@@ -58,48 +37,11 @@ void DeviceSource::Convert422To444(LPBYTE convertBuffer, LPBYTE lp422, UINT pitc
     DWORD size = lineSize;
     DWORD dwDWSize = size>>2;
 
-    if(bLeadingY)
+    for(UINT y=0; y<renderCY; y++)
     {
-        for(UINT y=0; y<renderCY; y++)
-        {
-            LPDWORD output = (LPDWORD)(convertBuffer+(y*pitch));
-            LPDWORD inputDW = (LPDWORD)(lp422+(y*linePitch)+lineShift);
-            LPDWORD inputDWEnd = inputDW+dwDWSize;
-
-            while(inputDW < inputDWEnd)
-            {
-                register DWORD dw = *inputDW;
-
-                output[0] = dw;
-                dw &= 0xFFFFFF00;
-                dw |= BYTE(dw>>16);
-                output[1] = dw;
-
-                output += 2;
-                inputDW++;
-            }
-        }
-    }
-    else
-    {
-        for(UINT y=0; y<renderCY; y++)
-        {
-            LPDWORD output = (LPDWORD)(convertBuffer+(y*pitch));
-            LPDWORD inputDW = (LPDWORD)(lp422+(y*linePitch)+lineShift);
-            LPDWORD inputDWEnd = inputDW+dwDWSize;
-
-            while(inputDW < inputDWEnd)
-            {
-                register DWORD dw = *inputDW;
-
-                output[0] = dw;
-                dw &= 0xFFFF00FF;
-                dw |= (dw>>16) & 0xFF00;
-                output[1] = dw;
+        uint32_t *output = (uint32_t*)(convertBuffer+(y*pitch));
+        const uint32_t *inputDW = (const uint32_t*)(lp422+(y*linePitch)+lineShift);
 
-                output += 2;
-                inputDW++;
-            }
-        }
+        Convert422Line(output, inputDW, dwDWSize, bLeadingY);
     }
 }
@@ -0,0 +1,112 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//this file is built with /arch:AVX2 so the 128bit ops here don't get legacy SSE encodings mixed in with
+//the 256bit ones.  that also means it must not include anything with inline functions the rest of the
+//plugin uses (windows.h, OBSApi.h), or the linker could end up picking the AVX2 copies of those.  these
+//are only ever called after ImageMadnessKernels.cpp has checked the CPU supports AVX2.
+
+#include <immintrin.h>
+#include <stdint.h>
+
+
+//writes 16 pixels to each line.  uv holds U | V<<8 for the 8 chroma samples covering them
+static inline void PackPixels420(uint32_t *output1, uint32_t *output2, __m128i lum1, __m128i lum2, __m128i uv)
+{
+    __m256i chromaLo = _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_unpacklo_epi16(uv, uv)), 8);
+    __m256i chromaHi = _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_unpackhi_epi16(uv, uv)), 8);
+
+    _mm256_storeu_si256((__m256i*)(output1),   _mm256_or_si256(_mm256_cvtepu8_epi32(lum1), chromaLo));
+    _mm256_storeu_si256((__m256i*)(output1+8), _mm256_or_si256(_mm256_cvtepu8_epi32(_mm_srli_si128(lum1, 8)), chromaHi));
+
+    _mm256_storeu_si256((__m256i*)(output2),   _mm256_or_si256(_mm256_cvtepu8_epi32(lum2), chromaLo));
+    _mm256_storeu_si256((__m256i*)(output2+8), _mm256_or_si256(_mm256_cvtepu8_epi32(_mm_srli_si128(lum2, 8)), chromaHi));
+}
+
+//high bytes of 16 little endian 16bit samples
+static inline __m128i HighBytes16(const uint16_t *lpInput)
+{
+    return _mm_packus_epi16(_mm_srli_epi16(_mm_loadu_si128((const __m128i*)lpInput), 8),
+                            _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(lpInput+8)), 8));
+}
+
+unsigned int PackLinesI420_AVX2(uint32_t *output1, uint32_t *output2, const uint8_t *lpLum1, const uint8_t *lpLum2,
+                                const uint8_t *lpChroma1, const uint8_t *lpChroma2, unsigned int halfX)
+{
+    unsigned int x;
+    for(x=0; x+8 <= halfX; x += 8)
+    {
+        __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(lpChroma1+x)), _mm_loadl_epi64((const __m128i*)(lpChroma2+x)));
+
+        PackPixels420(output1+x*2, output2+x*2,
+                      _mm_loadu_si128((const __m128i*)(lpLum1+x*2)), _mm_loadu_si128((const __m128i*)(lpLum2+x*2)), uv);
+    }
+
+    _mm256_zeroupper();
+    return x;
+}
+
+unsigned int PackLinesNV12_AVX2(uint32_t *output1, uint32_t *output2, const uint8_t *lpLum1, const uint8_t *lpLum2,
+                                const uint8_t *lpChroma, unsigned int halfX)
+{
+    unsigned int x;
+    for(x=0; x+8 <= halfX; x += 8)
+    {
+        PackPixels420(output1+x*2, output2+x*2,
+                      _mm_loadu_si128((const __m128i*)(lpLum1+x*2)), _mm_loadu_si128((const __m128i*)(lpLum2+x*2)),
+                      _mm_loadu_si128((const __m128i*)(lpChroma+x*2)));
+    }
+
+    _mm256_zeroupper();
+    return x;
+}
+
+unsigned int PackLinesP010_AVX2(uint32_t *output1, uint32_t *output2, const uint16_t *lpLum1, const uint16_t *lpLum2,
+                                const uint16_t *lpChroma, unsigned int halfX)
+{
+    unsigned int x;
+    for(x=0; x+8 <= halfX; x += 8)
+        PackPixels420(output1+x*2, output2+x*2, HighBytes16(lpLum1+x*2), HighBytes16(lpLum2+x*2), HighBytes16(lpChroma+x*2));
+
+    _mm256_zeroupper();
+    return x;
+}
+
+unsigned int Convert422Line_AVX2(uint32_t *output, const uint32_t *input, unsigned int count, bool bLeadingY)
+{
+    //same as the scalar version: copy each macropixel, then again with the first luma replaced by the second
+    __m256i keepMask = _mm256_set1_epi32(int(bLeadingY ? 0xFFFFFF00 : 0xFFFF00FF));
+    __m256i lumaMask = _mm256_set1_epi32(bLeadingY ? 0x000000FF : 0x0000FF00);
+
+    unsigned int i;
+    for(i=0; i+8 <= count; i += 8)
+    {
+        __m256i dw = _mm256_loadu_si256((const __m256i*)(input+i));
+        __m256i dw2 = _mm256_or_si256(_mm256_and_si256(dw, keepMask), _mm256_and_si256(_mm256_srli_epi32(dw, 16), lumaMask));
+
+        __m256i lo = _mm256_unpacklo_epi32(dw, dw2);
+        __m256i hi = _mm256_unpackhi_epi32(dw, dw2);
+
+        _mm256_storeu_si256((__m256i*)(output+i*2),   _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(output+i*2+8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    _mm256_zeroupper();
+    return i;
+}
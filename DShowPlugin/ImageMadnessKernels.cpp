@@ -0,0 +1,340 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#include "ImageMadnessKernels.h"
+#include <emmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+
+//in ImageMadnessAVX2.cpp.  each does as many whole blocks as it can and returns where it stopped
+unsigned int PackLinesI420_AVX2(uint32_t *output1, uint32_t *output2, const uint8_t *lpLum1, const uint8_t *lpLum2,
+                                const uint8_t *lpChroma1, const uint8_t *lpChroma2, unsigned int halfX);
+unsigned int PackLinesNV12_AVX2(uint32_t *output1, uint32_t *output2, const uint8_t *lpLum1, const uint8_t *lpLum2,
+                                const uint8_t *lpChroma, unsigned int halfX);
+unsigned int PackLinesP010_AVX2(uint32_t *output1, uint32_t *output2, const uint16_t *lpLum1, const uint16_t *lpLum2,
+                                const uint16_t *lpChroma, unsigned int halfX);
+unsigned int Convert422Line_AVX2(uint32_t *output, const uint32_t *input, unsigned int count, bool bLeadingY);
+
+//SSE2 is a given (OBS won't start without it), AVX2 needs both the CPU and the OS to support it
+static bool CheckAVX2Support()
+{
+#ifdef _MSC_VER
+    int cpuInfo[4];
+
+    __cpuid(cpuInfo, 0);
+    if(cpuInfo[0] < 7)
+        return false;
+
+    __cpuid(cpuInfo, 1);
+    if((cpuInfo[2] & (1<<27)) == 0 || (cpuInfo[2] & (1<<28)) == 0) //OSXSAVE, AVX
+        return false;
+
+    if((_xgetbv(0) & 6) != 6) //XMM and YMM state saved by the OS
+        return false;
+
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1<<5)) != 0;
+#else
+    //the same with the gcc/clang builtins, for the tests
+    unsigned int eax, ebx, ecx, edx;
+
+    if(!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || eax < 7)
+        return false;
+
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    if((ecx & (1<<27)) == 0 || (ecx & (1<<28)) == 0)
+        return false;
+
+    unsigned int xcr0Lo, xcr0Hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+    if((xcr0Lo & 6) != 6)
+        return false;
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1<<5)) != 0;
+#endif
+}
+
+static const bool bAVX2Supported = CheckAVX2Support();
+static bool bUseAVX2 = bAVX2Supported;
+
+bool EnableImageMadnessAVX2(bool bEnable)
+{
+    bUseAVX2 = bEnable && bAVX2Supported;
+    return bUseAVX2;
+}
+
+//-----------------------------------------------------------
+// 4:2:0 -> 4:4:4.  the lines are done in pairs since both share a line of chroma, the SIMD versions do 16
+// pixels at a time and leave whatever's left at the end of the line to the plain loops.
+
+//writes 16 pixels to each line.  uv holds U | V<<8 for the 8 chroma samples covering them
+static inline void PackPixels420_SSE2(uint32_t *output1, uint32_t *output2, __m128i lum1, __m128i lum2, __m128i uv)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i uvLo = _mm_unpacklo_epi16(uv, uv);
+    __m128i uvHi = _mm_unpackhi_epi16(uv, uv);
+
+    __m128i chroma[4];
+    chroma[0] = _mm_slli_epi32(_mm_unpacklo_epi16(uvLo, zero), 8);
+    chroma[1] = _mm_slli_epi32(_mm_unpackhi_epi16(uvLo, zero), 8);
+    chroma[2] = _mm_slli_epi32(_mm_unpacklo_epi16(uvHi, zero), 8);
+    chroma[3] = _mm_slli_epi32(_mm_unpackhi_epi16(uvHi, zero), 8);
+
+    __m128i lum = _mm_unpacklo_epi8(lum1, zero);
+    _mm_storeu_si128((__m128i*)(output1),    _mm_or_si128(_mm_unpacklo_epi16(lum, zero), chroma[0]));
+    _mm_storeu_si128((__m128i*)(output1+4),  _mm_or_si128(_mm_unpackhi_epi16(lum, zero), chroma[1]));
+    lum = _mm_unpackhi_epi8(lum1, zero);
+    _mm_storeu_si128((__m128i*)(output1+8),  _mm_or_si128(_mm_unpacklo_epi16(lum, zero), chroma[2]));
+    _mm_storeu_si128((__m128i*)(output1+12), _mm_or_si128(_mm_unpackhi_epi16(lum, zero), chroma[3]));
+
+    lum = _mm_unpacklo_epi8(lum2, zero);
+    _mm_storeu_si128((__m128i*)(output2),    _mm_or_si128(_mm_unpacklo_epi16(lum, zero), chroma[0]));
+    _mm_storeu_si128((__m128i*)(output2+4),  _mm_or_si128(_mm_unpackhi_epi16(lum, zero), chroma[1]));
+    lum = _mm_unpackhi_epi8(lum2, zero);
+    _mm_storeu_si128((__m128i*)(output2+8),  _mm_or_si128(_mm_unpacklo_epi16(lum, zero), chroma[2]));
+    _mm_storeu_si128((__m128i*)(output2+12), _mm_or_si128(_mm_unpackhi_epi16(lum, zero), chroma[3]));
+}
+
+//high bytes of 16 little endian 16bit samples
+static inline __m128i HighBytes16_SSE2(const uint16_t *lpInput)
+{
+    return _mm_packus_epi16(_mm_srli_epi16(_mm_loadu_si128((const __m128i*)lpInput), 8),
+                            _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(lpInput+8)), 8));
+}
+
+static unsigned int PackLinesI420_SSE2(uint32_t *output1, uint32_t *output2, const uint8_t *lpLum1, const uint8_t *lpLum2,
+                                       const uint8_t *lpChroma1, const uint8_t *lpChroma2, unsigned int halfX)
+{
+    unsigned int x;
+    for(x=0; x+8 <= halfX; x += 8)
+    {
+        __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(lpChroma1+x)), _mm_loadl_epi64((const __m128i*)(lpChroma2+x)));
+
+        PackPixels420_SSE2(output1+x*2, output2+x*2,
+                           _mm_loadu_si128((const __m128i*)(lpLum1+x*2)), _mm_loadu_si128((const __m128i*)(lpLum2+x*2)), uv);
+    }
+
+    return x;
+}
+
+static unsigned int PackLinesNV12_SSE2(uint32_t *output1, uint32_t *output2, const uint8_t *lpLum1, const uint8_t *lpLum2,
+                                       const uint8_t *lpChroma, unsigned int halfX)
+{
+    unsigned int x;
+    for(x=0; x+8 <= halfX; x += 8)
+    {
+        PackPixels420_SSE2(output1+x*2, output2+x*2,
+                           _mm_loadu_si128((const __m128i*)(lpLum1+x*2)), _mm_loadu_si128((const __m128i*)(lpLum2+x*2)),
+                           _mm_loadu_si128((const __m128i*)(lpChroma+x*2)));
+    }
+
+    return x;
+}
+
+static unsigned int PackLinesP010_SSE2(uint32_t *output1, uint32_t *output2, const uint16_t *lpLum1, const uint16_t *lpLum2,
+                                       const uint16_t *lpChroma, unsigned int halfX)
+{
+    unsigned int x;
+    for(x=0; x+8 <= halfX; x += 8)
+        PackPixels420_SSE2(output1+x*2, output2+x*2, HighBytes16_SSE2(lpLum1+x*2), HighBytes16_SSE2(lpLum2+x*2), HighBytes16_SSE2(lpChroma+x*2));
+
+    return x;
+}
+
+void PackI420(uint8_t *convertBuffer, const uint8_t *lpPlanar, unsigned int renderCX, unsigned int renderCY, unsigned int pitch,
+              unsigned int startY, unsigned int endY, unsigned int linePitch, unsigned int lineShift)
+{
+    uint8_t *output = convertBuffer;
+    const uint8_t *input = lpPlanar + lineShift;
+    const uint8_t *input2 = input+(renderCX*renderCY);
+    const uint8_t *input3 = input2+(renderCX*renderCY/4);
+
+    unsigned int halfStartY = startY/2;
+    unsigned int halfX = renderCX/2;
+    unsigned int halfY = endY/2;
+
+    for(unsigned int y=halfStartY; y<halfY; y++)
+    {
+        const uint8_t *lpLum1 = input + y*2*linePitch;
+        const uint8_t *lpLum2 = lpLum1 + linePitch;
+        const uint8_t *lpChroma1 = input2 + y*(linePitch/2);
+        const uint8_t *lpChroma2 = input3 + y*(linePitch/2);
+        uint32_t *output1 = (uint32_t*)(output + (y*2)*pitch);
+        uint32_t *output2 = (uint32_t*)(((uint8_t*)output1)+pitch);
+
+        unsigned int x;
+        if(bUseAVX2)
+            x = PackLinesI420_AVX2(output1, output2, lpLum1, lpLum2, lpChroma1, lpChroma2, halfX);
+        else
+            x = PackLinesI420_SSE2(output1, output2, lpLum1, lpLum2, lpChroma1, lpChroma2, halfX);
+
+        for(; x<halfX; x++)
+        {
+            uint32_t out = (lpChroma1[x] << 8) | (lpChroma2[x] << 16);
+
+            output1[x*2]   = lpLum1[x*2]   | out;
+            output1[x*2+1] = lpLum1[x*2+1] | out;
+
+            output2[x*2]   = lpLum2[x*2]   | out;
+            output2[x*2+1] = lpLum2[x*2+1] | out;
+        }
+    }
+}
+
+//one plane of luma followed by one of interleaved U/V
+void PackNV12(uint8_t *convertBuffer, const uint8_t *lpPlanar, unsigned int renderCX, unsigned int renderCY, unsigned int pitch,
+              unsigned int startY, unsigned int endY, unsigned int linePitch, unsigned int lineShift)
+{
+    uint8_t *output = convertBuffer;
+    const uint8_t *input = lpPlanar + lineShift;
+    const uint8_t *input2 = input+(renderCX*renderCY);
+
+    unsigned int halfStartY = startY/2;
+    unsigned int halfX = renderCX/2;
+    unsigned int halfY = endY/2;
+
+    for(unsigned int y=halfStartY; y<halfY; y++)
+    {
+        const uint8_t *lpLum1 = input + y*2*linePitch;
+        const uint8_t *lpLum2 = lpLum1 + linePitch;
+        const uint8_t *lpChroma = input2 + y*linePitch;
+        uint32_t *output1 = (uint32_t*)(output + (y*2)*pitch);
+        uint32_t *output2 = (uint32_t*)(((uint8_t*)output1)+pitch);
+
+        unsigned int x;
+        if(bUseAVX2)
+            x = PackLinesNV12_AVX2(output1, output2, lpLum1, lpLum2, lpChroma, halfX);
+        else
+            x = PackLinesNV12_SSE2(output1, output2, lpLum1, lpLum2, lpChroma, halfX);
+
+        for(; x<halfX; x++)
+        {
+            uint32_t out = (lpChroma[x*2] << 8) | (lpChroma[x*2+1] << 16);
+
+            output1[x*2]   = lpLum1[x*2]   | out;
+            output1[x*2+1] = lpLum1[x*2+1] | out;
+
+            output2[x*2]   = lpLum2[x*2]   | out;
+            output2[x*2+1] = lpLum2[x*2+1] | out;
+        }
+    }
+}
+
+//NV12 with 16bit samples (10 significant bits at the top), cut down to 8 bits
+void PackP010(uint8_t *convertBuffer, const uint8_t *lpPlanar, unsigned int renderCX, unsigned int renderCY, unsigned int pitch,
+              unsigned int startY, unsigned int endY, unsigned int linePitch, unsigned int lineShift)
+{
+    uint8_t *output = convertBuffer;
+    const uint8_t *input = lpPlanar + lineShift;
+    const uint8_t *input2 = input+(renderCX*renderCY*2);
+
+    unsigned int halfStartY = startY/2;
+    unsigned int halfX = renderCX/2;
+    unsigned int halfY = endY/2;
+
+    for(unsigned int y=halfStartY; y<halfY; y++)
+    {
+        const uint16_t *lpLum1 = (const uint16_t*)(input + y*2*linePitch);
+        const uint16_t *lpLum2 = (const uint16_t*)(input + (y*2+1)*linePitch);
+        const uint16_t *lpChroma = (const uint16_t*)(input2 + y*linePitch);
+        uint32_t *output1 = (uint32_t*)(output + (y*2)*pitch);
+        uint32_t *output2 = (uint32_t*)(((uint8_t*)output1)+pitch);
+
+        unsigned int x;
+        if(bUseAVX2)
+            x = PackLinesP010_AVX2(output1, output2, lpLum1, lpLum2, lpChroma, halfX);
+        else
+            x = PackLinesP010_SSE2(output1, output2, lpLum1, lpLum2, lpChroma, halfX);
+
+        for(; x<halfX; x++)
+        {
+            uint32_t out = ((lpChroma[x*2] >> 8) << 8) | ((lpChroma[x*2+1] >> 8) << 16);
+
+            output1[x*2]   = (lpLum1[x*2]   >> 8) | out;
+            output1[x*2+1] = (lpLum1[x*2+1] >> 8) | out;
+
+            output2[x*2]   = (lpLum2[x*2]   >> 8) | out;
+            output2[x*2+1] = (lpLum2[x*2+1] >> 8) | out;
+        }
+    }
+}
+
+//-----------------------------------------------------------
+// packed 4:2:2 -> 4:4:4.  each macropixel is written out twice, the second time with the first luma
+// value replaced by the second
+
+static unsigned int Convert422Line_SSE2(uint32_t *output, const uint32_t *input, unsigned int count, bool bLeadingY)
+{
+    __m128i keepMask = _mm_set1_epi32(int(bLeadingY ? 0xFFFFFF00 : 0xFFFF00FF));
+    __m128i lumaMask = _mm_set1_epi32(bLeadingY ? 0x000000FF : 0x0000FF00);
+
+    unsigned int i;
+    for(i=0; i+4 <= count; i += 4)
+    {
+        __m128i dw = _mm_loadu_si128((const __m128i*)(input+i));
+        __m128i dw2 = _mm_or_si128(_mm_and_si128(dw, keepMask), _mm_and_si128(_mm_srli_epi32(dw, 16), lumaMask));
+
+        _mm_storeu_si128((__m128i*)(output+i*2),   _mm_unpacklo_epi32(dw, dw2));
+        _mm_storeu_si128((__m128i*)(output+i*2+4), _mm_unpackhi_epi32(dw, dw2));
+    }
+
+    return i;
+}
+
+void Convert422Line(uint32_t *output, const uint32_t *input, unsigned int count, bool bLeadingY)
+{
+    unsigned int i;
+    if(bUseAVX2)
+        i = Convert422Line_AVX2(output, input, count, bLeadingY);
+    else
+        i = Convert422Line_SSE2(output, input, count, bLeadingY);
+
+    if(bLeadingY)
+    {
+        for(; i<count; i++)
+        {
+            uint32_t dw = input[i];
+
+            output[i*2] = dw;
+            dw &= 0xFFFFFF00;
+            dw |= uint8_t(dw>>16);
+            output[i*2+1] = dw;
+        }
+    }
+    else
+    {
+        for(; i<count; i++)
+        {
+            uint32_t dw = input[i];
+
+            output[i*2] = dw;
+            dw &= 0xFFFF00FF;
+            dw |= (dw>>16) & 0xFF00;
+            output[i*2+1] = dw;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------
+// the unpacking behind PackPlanar and DeviceSource::Convert422To444.  it doesn't include windows.h or
+// OBSApi.h, so the kernels can be built and tested on their own.  every output pixel is Y | U<<8 | V<<16,
+// the YUVToRGB shaders take it from there.
+
+//4:2:0 frames to 4:4:4, lines startY to endY.  pitch is the output's, linePitch and lineShift the input's.
+//I420 and YV12 are the same as far as this goes, the shader sorts out which plane is which
+void PackI420(uint8_t *convertBuffer, const uint8_t *lpPlanar, unsigned int renderCX, unsigned int renderCY, unsigned int pitch,
+              unsigned int startY, unsigned int endY, unsigned int linePitch, unsigned int lineShift);
+void PackNV12(uint8_t *convertBuffer, const uint8_t *lpPlanar, unsigned int renderCX, unsigned int renderCY, unsigned int pitch,
+              unsigned int startY, unsigned int endY, unsigned int linePitch, unsigned int lineShift);
+void PackP010(uint8_t *convertBuffer, const uint8_t *lpPlanar, unsigned int renderCX, unsigned int renderCY, unsigned int pitch,
+              unsigned int startY, unsigned int endY, unsigned int linePitch, unsigned int lineShift);
+
+//one line of packed 4:2:2 to 4:4:4, count is in macropixels.  bLeadingY is for YUY2/YVYU, otherwise UYVY/HDYC
+void Convert422Line(uint32_t *output, const uint32_t *input, unsigned int count, bool bLeadingY);
+
+//the AVX2 kernels are used when the CPU and OS support them.  turning them off makes everything go through
+//the SSE2 ones, returns whether AVX2 is used after the call
+bool EnableImageMadnessAVX2(bool bEnable);
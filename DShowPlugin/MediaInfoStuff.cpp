@@ -74,6 +74,10 @@ VideoOutputType GetVideoOutputTypeFromFourCC(DWORD fourCC)
         type = VideoOutputType_I420;
     else if(fourCC == '21VY')
         type = VideoOutputType_YV12;
+    else if(fourCC == '21VN')
+        type = VideoOutputType_NV12;
+    else if(fourCC == '010P')
+        type = VideoOutputType_P010;
 
     // Packed YUV formats
     else if(fourCC == 'UYVY')
@@ -119,6 +123,10 @@ VideoOutputType GetVideoOutputType(const AM_MEDIA_TYPE &media_type)
             type = VideoOutputType_I420;
         else if(media_type.subtype == MEDIASUBTYPE_YV12)
             type = VideoOutputType_YV12;
+        else if(media_type.subtype == MEDIASUBTYPE_NV12)
+            type = VideoOutputType_NV12;
+        else if(media_type.subtype == MEDIASUBTYPE_OBS_P010)
+            type = VideoOutputType_P010;
 
         else if(media_type.subtype == MEDIASUBTYPE_Y41P)
             type = VideoOutputType_Y41P;
@@ -182,7 +190,10 @@ const int inputPriority[] =
     10,
     10,
 
-    9
+    9,
+
+    12,
+    11
 };
 
 bool GetVideoOutputTypes(const List<MediaOutputInfo> &outputList, UINT width, UINT height, UINT64 frameInterval, List<VideoOutputType> &types)
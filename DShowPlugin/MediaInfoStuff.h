@@ -34,6 +34,7 @@ inline void DeleteMediaType(AM_MEDIA_TYPE *pmt)
 
 
 const GUID MEDIASUBTYPE_I420 = {0x30323449, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}};
+const GUID MEDIASUBTYPE_OBS_P010 = {0x30313050, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}}; //not in older SDKs
 
 enum VideoOutputType
 {
@@ -60,7 +61,11 @@ enum VideoOutputType
     VideoOutputType_dvsd,
     VideoOutputType_dvhd,
 
-    VideoOutputType_MJPG
+    VideoOutputType_MJPG,
+
+    //added later, keep these at the end since the preferred type is saved as a number
+    VideoOutputType_NV12,
+    VideoOutputType_P010
 };
 
 static const CTSTR EnumToName[] =
@@ -89,6 +94,9 @@ static const CTSTR EnumToName[] =
     TEXT("dvhd"),
 
     TEXT("MJPG"),
+
+    TEXT("NV12"),
+    TEXT("P010"),
 };
 
 struct MediaOutputInfo
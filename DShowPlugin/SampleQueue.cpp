@@ -0,0 +1,218 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "OBSApi.h"
+#include "SampleQueue.h"
+
+void SamplePool::SetBufferSize(UINT size)
+{
+    OSEnterMutex(hMutex);
+
+    bufferSize = size;
+
+    for (UINT i=0; i<freeSamples.Num(); i++) {
+        if (freeSamples[i]->capacity < size) {
+            delete freeSamples[i];
+            freeSamples.Remove(i--);
+        }
+    }
+
+    OSLeaveMutex(hMutex);
+}
+
+SampleData* SamplePool::GetSample(UINT size)
+{
+    SampleData *sample = NULL;
+
+    OSEnterMutex(hMutex);
+
+    for (UINT i=freeSamples.Num(); i>0; i--) {
+        if (freeSamples[i-1]->capacity >= size) {
+            sample = freeSamples[i-1];
+            freeSamples.Remove(i-1);
+            break;
+        }
+    }
+
+    OSLeaveMutex(hMutex);
+
+    if (!sample) {
+        sample = new SampleData;
+        sample->capacity = MAX(size, bufferSize);
+        sample->lpData = (LPBYTE)Allocate(sample->capacity);
+    }
+
+    sample->refs = 1;
+    sample->dataLength = size;
+    sample->pool = this;
+    AddRef();
+
+    return sample;
+}
+
+void SamplePool::Recycle(SampleData *sample)
+{
+    sample->pool = NULL;
+
+    OSEnterMutex(hMutex);
+
+    bool bKeep = (sample->capacity >= bufferSize && freeSamples.Num() < SAMPLE_POOL_MAX_FREE);
+    if (bKeep)
+        freeSamples << sample;
+
+    OSLeaveMutex(hMutex);
+
+    if (!bKeep)
+        delete sample;
+
+    Release();
+}
+
+void SampleQueue::Insert(SampleData *sample)
+{
+    if (num == capacity) {
+        UINT newCapacity = capacity ? capacity*2 : 64;
+        SampleData **lpNewSamples = (SampleData**)Allocate(sizeof(SampleData*)*newCapacity);
+
+        for (UINT i=0; i<num; i++)
+            lpNewSamples[i] = (*this)[i];
+
+        Free(lpSamples);
+        lpSamples = lpNewSamples;
+        capacity = newCapacity;
+        head = 0;
+    }
+
+    //goes after any samples with the same timestamp
+    UINT index = num++;
+    while (index && (*this)[index-1]->timestamp > sample->timestamp) {
+        (*this)[index] = (*this)[index-1];
+        index--;
+    }
+
+    (*this)[index] = sample;
+}
+
+
+//------------------------------------------------
+
+void SampleScheduler::Reset(LONGLONG time, LONGLONG targetBufferTime)
+{
+    lastTime = time;
+    bufferTime = frameWait = lastSampleTime = 0;
+    curBufferTime = targetBufferTime;
+
+    bFirstFrame = true;
+    bHadSamples = false;
+}
+
+DWORD SampleScheduler::Update(LONGLONG time, LONGLONG targetBufferTime, SampleQueue &samples, SampleOutput *output)
+{
+    LONGLONG delta = time-lastTime;
+    lastTime = time;
+
+    //while the delay is still being buffered, only the time past the end of it counts towards playing samples out
+    LONGLONG playTime = delta;
+    if (!bFirstFrame && bufferTime < targetBufferTime) {
+        bufferTime += delta;
+        playTime = MAX(bufferTime-targetBufferTime, 0);
+    }
+
+    LONGLONG nextWake = 0;
+
+    if (samples.Num()) {
+        if (bFirstFrame) {
+            bFirstFrame = false;
+            lastSampleTime = samples[0]->timestamp;
+        }
+
+        //wait until the requested delay has been buffered before processing packets
+        if (bufferTime >= targetBufferTime) {
+            //only count time spent with samples waiting, same as when this polled
+            if (bHadSamples)
+                frameWait += playTime;
+
+            //if delay time was adjusted downward, remove packets accordingly
+            bool bBufferTimeChanged = (curBufferTime != targetBufferTime);
+            if (bBufferTimeChanged) {
+                if (curBufferTime > targetBufferTime) {
+                    output->FlushAudio();
+
+                    LONGLONG lostTime = curBufferTime - targetBufferTime;
+                    bufferTime -= lostTime;
+
+                    if (samples.Num()) {
+                        LONGLONG startTime = samples[0]->timestamp;
+
+                        while (samples.Num()) {
+                            SampleData *sample = samples[0];
+
+                            if ((sample->timestamp - startTime) >= lostTime)
+                                break;
+
+                            lastSampleTime = sample->timestamp;
+
+                            sample->Release();
+                            samples.PopFront();
+                        }
+                    }
+                }
+
+                curBufferTime = targetBufferTime;
+            }
+
+            while (samples.Num()) {
+                SampleData *sample = samples[0];
+
+                LONGLONG timestamp = sample->timestamp;
+                LONGLONG sampleTime = timestamp - lastSampleTime;
+
+                //sometimes timestamps can go to shit with horrible garbage devices.
+                //so, bypass any unusual timestamp offsets.
+                if (sampleTime < -10000000 || sampleTime > 10000000) {
+                    //OSDebugOut(TEXT("sample time: %lld\r\n"), sampleTime);
+                    sampleTime = 0;
+                }
+
+                if (frameWait < sampleTime) {
+                    nextWake = sampleTime - frameWait;
+                    break;
+                }
+
+                samples.PopFront();
+                output->OutputSample(sample);
+
+                if (sampleTime > 0)
+                    frameWait -= sampleTime;
+
+                lastSampleTime = timestamp;
+            }
+        } else {
+            nextWake = targetBufferTime - bufferTime;
+        }
+    }
+
+    bHadSamples = samples.Num() != 0;
+
+    //nothing queued means nothing to do until the next sample arrives
+    if (bHadSamples)
+        return DWORD(MAX((nextWake+9999)/10000, 1));
+
+    return INFINITE;
+}
@@ -0,0 +1,145 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+//device sample buffering, kept apart from the directshow parts so it only needs OBSApi
+
+struct SamplePool;
+
+struct SampleData {
+    //IMediaSample *sample;
+    LPBYTE lpData;
+    long dataLength;
+    UINT capacity;
+
+    int cx, cy;
+
+    bool bAudio;
+    LONGLONG timestamp;
+    volatile long refs;
+
+    SamplePool *pool;
+
+    inline SampleData() {refs = 1;}
+    inline ~SampleData() {Free(lpData);} //sample->Release();}
+
+    inline void AddRef() {++refs;}
+    inline void Release();
+};
+
+#define SAMPLE_POOL_MAX_FREE 16
+
+//recycles sample buffers so a steady stream of frames doesn't go through the allocator every time.
+//samples that are out in use hold a reference, so the pool stays around until the last one comes back
+struct SamplePool
+{
+    HANDLE hMutex;
+    List<SampleData*> freeSamples;
+    UINT bufferSize;
+    volatile long refs;
+
+    inline SamplePool()  {hMutex = OSCreateMutex(); bufferSize = 0; refs = 1;}
+    inline ~SamplePool()
+    {
+        for(UINT i=0; i<freeSamples.Num(); i++)
+            delete freeSamples[i];
+        OSCloseMutex(hMutex);
+    }
+
+    inline void AddRef() {InterlockedIncrement(&refs);}
+    inline void Release()
+    {
+        if(!InterlockedDecrement(&refs))
+            delete this;
+    }
+
+    //expected size of a sample (from the media type), buffers are at least this big
+    void SetBufferSize(UINT size);
+
+    SampleData* GetSample(UINT size);
+    void Recycle(SampleData *sample);
+};
+
+inline void SampleData::Release()
+{
+    if(!InterlockedDecrement(&refs))
+    {
+        if(pool)
+            pool->Recycle(this);
+        else
+            delete this;
+    }
+}
+
+//buffered samples in timestamp order.  devices almost always deliver in order, so adding one is
+//normally just a push at the back, and taking the oldest never moves anything
+struct SampleQueue
+{
+    SampleData **lpSamples;
+    UINT capacity, head, num;
+
+    inline SampleQueue()  {lpSamples = NULL; capacity = head = num = 0;}
+    inline ~SampleQueue() {Free(lpSamples);}
+
+    inline UINT Num() const                     {return num;}
+    inline SampleData*& operator[](UINT i)      {return lpSamples[(head+i) & (capacity-1)];}
+
+    void Insert(SampleData *sample);
+
+    inline SampleData* PopFront()
+    {
+        SampleData *sample = lpSamples[head];
+        head = (head+1) & (capacity-1);
+        --num;
+        return sample;
+    }
+
+    inline void Clear() {head = num = 0;}
+};
+
+//what the sample thread hands samples to once they're due
+class SampleOutput
+{
+public:
+    virtual ~SampleOutput() {}
+
+    //gets the queue's reference to the sample
+    virtual void OutputSample(SampleData *sample)=0;
+
+    //the buffer delay was lowered, so anything the audio side is holding on to is too late now
+    virtual void FlushAudio()=0;
+};
+
+//the sample thread's timing, without the thread or its events so it can be run against any clock.
+//times are in 100ns units, same as the sample timestamps
+struct SampleScheduler
+{
+    LONGLONG lastTime, bufferTime, frameWait, curBufferTime, lastSampleTime;
+    bool bFirstFrame, bHadSamples;
+
+    inline SampleScheduler() {Reset(0, 0);}
+
+    void Reset(LONGLONG time, LONGLONG targetBufferTime);
+
+    //outputs every queued sample that's due by 'time' and returns how many milliseconds to wait before the
+    //next one is, or INFINITE if the queue is empty.  the caller holds whatever protects the queue
+    DWORD Update(LONGLONG time, LONGLONG targetBufferTime, SampleQueue &samples, SampleOutput *output);
+};
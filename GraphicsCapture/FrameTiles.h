@@ -0,0 +1,137 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+#include <emmintrin.h>
+
+//-------------------------------------------
+// changed tiles for memory capture.  the hook compares every frame against the one before it in tiles
+// of FRAME_TILE_BYTES by FRAME_TILE_ROWS and writes a map with a byte per tile next to the frame, so OBS
+// only has to upload the parts of the frame that actually changed.  used by both the hook and the
+// plugin, so nothing in here can depend on either of them.
+
+#define FRAME_TILE_BYTES    256 //has to be a multiple of 16
+#define FRAME_TILE_ROWS     16
+
+inline UINT GetFrameTilesX(UINT pitch)  {return (pitch+FRAME_TILE_BYTES-1)/FRAME_TILE_BYTES;}
+inline UINT GetFrameTilesY(UINT height) {return (height+FRAME_TILE_ROWS-1)/FRAME_TILE_ROWS;}
+
+//copies with non-temporal stores, the frame gets read by another process so there's no point in keeping it in cache
+inline void StreamCopy(LPBYTE lpOutput, const BYTE *lpInput, UINT size)
+{
+    UINT i = 0;
+
+    if((UINT_PTR(lpOutput) & 15) == 0)
+    {
+        for(; i+64 <= size; i += 64)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(lpInput+i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(lpInput+i+16));
+            __m128i c = _mm_loadu_si128((const __m128i*)(lpInput+i+32));
+            __m128i d = _mm_loadu_si128((const __m128i*)(lpInput+i+48));
+            _mm_stream_si128((__m128i*)(lpOutput+i),    a);
+            _mm_stream_si128((__m128i*)(lpOutput+i+16), b);
+            _mm_stream_si128((__m128i*)(lpOutput+i+32), c);
+            _mm_stream_si128((__m128i*)(lpOutput+i+48), d);
+        }
+
+        for(; i+16 <= size; i += 16)
+            _mm_stream_si128((__m128i*)(lpOutput+i), _mm_loadu_si128((const __m128i*)(lpInput+i)));
+    }
+
+    if(i < size)
+        memcpy(lpOutput+i, lpInput+i, size-i);
+}
+
+inline bool TileChanged(const BYTE *lpA, const BYTE *lpB, UINT pitch, UINT width, UINT rows)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    for(UINT y=0; y<rows; y++, lpA += pitch, lpB += pitch)
+    {
+        __m128i diff = zero;
+        UINT x = 0;
+
+        for(; x+16 <= width; x += 16)
+            diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(lpA+x)), _mm_loadu_si128((const __m128i*)(lpB+x))));
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)) != 0xFFFF)
+            return true;
+
+        if(x < width && memcmp(lpA+x, lpB+x, width-x) != 0)
+            return true;
+    }
+
+    return false;
+}
+
+//copies a frame to lpOutput a tile at a time, setting the tiles that differ from lpPrev (the last frame, NULL if
+//there isn't one) in lpTileMap.  lpPrev can be lpOutput itself, in which case unchanged tiles aren't touched at all.
+//returns the number of tiles that changed
+inline UINT CopyFrameTiles(LPBYTE lpOutput, const BYTE *lpInput, const BYTE *lpPrev, UINT pitch, UINT height, LPBYTE lpTileMap)
+{
+    UINT tilesX = GetFrameTilesX(pitch), tilesY = GetFrameTilesY(height);
+    UINT numChanged = 0;
+
+    for(UINT tileY=0; tileY<tilesY; tileY++)
+    {
+        UINT y = tileY*FRAME_TILE_ROWS;
+        UINT rows = (height-y < FRAME_TILE_ROWS) ? height-y : FRAME_TILE_ROWS;
+
+        for(UINT tileX=0; tileX<tilesX; tileX++)
+        {
+            UINT x = tileX*FRAME_TILE_BYTES;
+            UINT width = (pitch-x < FRAME_TILE_BYTES) ? pitch-x : FRAME_TILE_BYTES;
+            UINT offset = y*pitch + x;
+
+            bool bChanged = !lpPrev || TileChanged(lpInput+offset, lpPrev+offset, pitch, width, rows);
+            lpTileMap[tileY*tilesX + tileX] = bChanged ? 1 : 0;
+
+            if(bChanged)
+                numChanged++;
+            else if(lpPrev == lpOutput)
+                continue;
+
+            for(UINT row=0; row<rows; row++)
+                StreamCopy(lpOutput+offset+(row*pitch), lpInput+offset+(row*pitch), width);
+        }
+    }
+
+    //streaming stores aren't ordered with anything else, they have to be done before the mutex is released
+    _mm_sfence();
+
+    return numChanged;
+}
+
+//finds the next run of changed tiles in a row of a tile map, from tileX on.  returns false if there aren't any left
+inline bool GetChangedTileRun(const BYTE *lpTileRow, UINT tilesX, UINT &tileX, UINT &numTiles)
+{
+    while(tileX < tilesX && !lpTileRow[tileX])
+        tileX++;
+
+    if(tileX == tilesX)
+        return false;
+
+    numTiles = 1;
+    while(tileX+numTiles < tilesX && lpTileRow[tileX+numTiles])
+        numTiles++;
+
+    return true;
+}
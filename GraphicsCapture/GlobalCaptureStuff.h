@@ -57,6 +57,11 @@ struct MemoryCopyData
     UINT        lastRendered;
     LONGLONG    frameTime;
     DWORD       texture1Offset, texture2Offset;
+
+    //which tiles of each texture changed since the frame before it (see FrameTiles.h), and the number
+    //of the frame in each texture.  the offsets are 0 if the hook doesn't keep track of changed tiles
+    DWORD       tileMap1Offset, tileMap2Offset;
+    UINT        frameIDs[2];
 };
 
 struct SharedTexData
@@ -23,6 +23,7 @@
 #include "resource.h"
 
 #include "GlobalCaptureStuff.h"
+#include "FrameTiles.h"
 
 //-----------------------------------------------------------
 
@@ -348,6 +348,7 @@ DWORD CopyD3D8CPUTextureThread(LPVOID lpUseless)
             if (lastRendered != -1)
             {
                 convertPixelFormat((LPBYTE)data, sourcePitch, pixelFormat, d3d8CaptureInfo.cx, d3d8CaptureInfo.cy, textureBuffers[lastRendered]);
+                SetSharedFrameChanged((UINT)lastRendered);
                 ReleaseMutex(textureMutexes[lastRendered]);
                 copyData->lastRendered = (UINT)lastRendered;
             }
@@ -606,7 +607,7 @@ bool CreateCPUCapture(IDirect3DDevice8* device)
     }
 
     // initialize OBS shared memory
-    d3d8CaptureInfo.mapID = InitializeSharedMemoryCPUCapture(d3d8CaptureInfo.pitch*d3d8CaptureInfo.cy, &d3d8CaptureInfo.mapSize, &copyData, textureBuffers);
+    d3d8CaptureInfo.mapID = InitializeSharedMemoryCPUCapture(d3d8CaptureInfo.pitch, d3d8CaptureInfo.cy, &d3d8CaptureInfo.mapSize, &copyData, textureBuffers);
     if (!d3d8CaptureInfo.mapID)
     {
         RUNEVERYRESET logOutput << CurrentTimeString() << "CreateCPUCapture: failed to initialize shared memory" << endl;
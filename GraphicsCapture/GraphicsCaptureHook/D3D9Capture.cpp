@@ -598,7 +598,7 @@ void DoD3D9CPUHook(IDirect3DDevice9 *device)
 
     if(bSuccess)
     {
-        d3d9CaptureInfo.mapID = InitializeSharedMemoryCPUCapture(pitch*d3d9CaptureInfo.cy, &d3d9CaptureInfo.mapSize, &copyData, textureBuffers);
+        d3d9CaptureInfo.mapID = InitializeSharedMemoryCPUCapture(pitch, d3d9CaptureInfo.cy, &d3d9CaptureInfo.mapSize, &copyData, textureBuffers);
         if(!d3d9CaptureInfo.mapID)
         {
             RUNEVERYRESET logOutput << CurrentTimeString() << "DoD3D9CPUHook: failed to initialize shared memory" << endl;
@@ -659,7 +659,7 @@ DWORD CopyD3D9CPUTextureThread(LPVOID lpUseless)
 
             if(lastRendered != -1)
             {
-                memcpy(textureBuffers[lastRendered], data, d3d9CaptureInfo.pitch*d3d9CaptureInfo.cy);
+                CopyFrameToSharedMemory((UINT)lastRendered, data);
                 ReleaseMutex(textureMutexes[lastRendered]);
                 copyData->lastRendered = (UINT)lastRendered;
             }
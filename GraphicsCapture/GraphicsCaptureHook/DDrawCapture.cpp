@@ -693,6 +693,7 @@ DWORD CopyDDrawTextureThread(LPVOID lpUseless)
                 {
                     //logOutput << CurrentTimeString() << "CopyDDrawTextureThread: converting buffer" << endl;
                     handleBufferConversion((LPDWORD)textureBuffers[lastRendered], (LPBYTE)desc.lpSurface, desc.lPitch);
+                    SetSharedFrameChanged((UINT)lastRendered);
                     //logOutput << CurrentTimeString() << "CopyDDrawTextureThread: unlocking buffer" << endl;
                     if (FAILED(err = ddCaptures[copyTex]->Unlock(NULL)))
                     {
@@ -844,9 +845,9 @@ bool SetupDDraw()
         ddrawCaptureInfo.pitch = 4 * ddrawCaptureInfo.cx;
         ddrawCaptureInfo.hwndCapture = (DWORD)hwndSender;
         ddrawCaptureInfo.format = GS_BGRA;
-        DWORD g_dwCaptureSize = ddrawCaptureInfo.pitch*ddrawCaptureInfo.cy;
+        g_dwCaptureSize = ddrawCaptureInfo.pitch*ddrawCaptureInfo.cy;
         ddrawCaptureInfo.bFlip = FALSE;
-        ddrawCaptureInfo.mapID = InitializeSharedMemoryCPUCapture(g_dwCaptureSize, &ddrawCaptureInfo.mapSize, &copyData, textureBuffers);
+        ddrawCaptureInfo.mapID = InitializeSharedMemoryCPUCapture(ddrawCaptureInfo.pitch, ddrawCaptureInfo.cy, &ddrawCaptureInfo.mapSize, &copyData, textureBuffers);
 
         memcpy(infoMem, &ddrawCaptureInfo, sizeof(CaptureInfo));
 
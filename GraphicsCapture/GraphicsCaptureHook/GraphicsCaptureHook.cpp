@@ -177,12 +177,20 @@ void QuickLog(LPCSTR lpText)
 }
 
 
-UINT InitializeSharedMemoryCPUCapture(UINT textureSize, DWORD *totalSize, MemoryCopyData **copyData, LPBYTE *textureBuffers)
+//cpu capture frames are compared against the last frame a tile at a time so OBS only has to upload what changed
+static MemoryCopyData *sharedCopyData = NULL;
+static LPBYTE sharedTextures[2] = {NULL, NULL};
+static LPBYTE sharedTileMaps[2] = {NULL, NULL};
+static UINT sharedPitch = 0, sharedHeight = 0;
+static UINT sharedFrameID = 0;
+
+UINT InitializeSharedMemoryCPUCapture(UINT pitch, UINT height, DWORD *totalSize, MemoryCopyData **copyData, LPBYTE *textureBuffers)
 {
     UINT alignedHeaderSize = (sizeof(MemoryCopyData)+15) & 0xFFFFFFF0;
-    UINT alignedTexureSize = (textureSize+15) & 0xFFFFFFF0;
+    UINT alignedTexureSize = (pitch*height+15) & 0xFFFFFFF0;
+    UINT alignedTileMapSize = (GetFrameTilesX(pitch)*GetFrameTilesY(height)+15) & 0xFFFFFFF0;
 
-    *totalSize = alignedHeaderSize + alignedTexureSize*2;
+    *totalSize = alignedHeaderSize + alignedTexureSize*2 + alignedTileMapSize*2;
 
     wstringstream strName;
     strName << TEXTURE_MEMORY << ++sharedMemoryIDCounter;
@@ -201,14 +209,46 @@ UINT InitializeSharedMemoryCPUCapture(UINT textureSize, DWORD *totalSize, Memory
     *copyData = (MemoryCopyData*)lpSharedMemory;
     (*copyData)->texture1Offset = alignedHeaderSize;
     (*copyData)->texture2Offset = alignedHeaderSize+alignedTexureSize;
+    (*copyData)->tileMap1Offset = alignedHeaderSize+alignedTexureSize*2;
+    (*copyData)->tileMap2Offset = alignedHeaderSize+alignedTexureSize*2+alignedTileMapSize;
     (*copyData)->frameTime = 0;
 
     textureBuffers[0] = lpSharedMemory+alignedHeaderSize;
     textureBuffers[1] = lpSharedMemory+alignedHeaderSize+alignedTexureSize;
 
+    sharedCopyData = *copyData;
+    sharedTextures[0] = textureBuffers[0];
+    sharedTextures[1] = textureBuffers[1];
+    sharedTileMaps[0] = lpSharedMemory+(*copyData)->tileMap1Offset;
+    sharedTileMaps[1] = lpSharedMemory+(*copyData)->tileMap2Offset;
+    sharedPitch = pitch;
+    sharedHeight = height;
+    sharedFrameID = 0;
+
     return sharedMemoryIDCounter;
 }
 
+void CopyFrameToSharedMemory(UINT bufferID, LPVOID lpData)
+{
+    if(!sharedCopyData)
+        return;
+
+    UINT prevID = sharedCopyData->lastRendered;
+    LPBYTE lpPrev = (prevID < 2 && sharedCopyData->frameIDs[prevID]) ? sharedTextures[prevID] : NULL;
+
+    CopyFrameTiles(sharedTextures[bufferID], (LPBYTE)lpData, lpPrev, sharedPitch, sharedHeight, sharedTileMaps[bufferID]);
+    sharedCopyData->frameIDs[bufferID] = ++sharedFrameID;
+}
+
+void SetSharedFrameChanged(UINT bufferID)
+{
+    if(!sharedCopyData)
+        return;
+
+    memset(sharedTileMaps[bufferID], 1, GetFrameTilesX(sharedPitch)*GetFrameTilesY(sharedHeight));
+    sharedCopyData->frameIDs[bufferID] = ++sharedFrameID;
+}
+
 UINT InitializeSharedMemoryGPUCapture(SharedTexData **texData)
 {
     int totalSize = sizeof(SharedTexData);
@@ -243,6 +283,10 @@ void DestroySharedMemory()
         hFileMap = NULL;
         lpSharedMemory = NULL;
     }
+
+    sharedCopyData = NULL;
+    sharedTextures[0] = sharedTextures[1] = NULL;
+    sharedTileMaps[0] = sharedTileMaps[1] = NULL;
 }
 
 
@@ -204,6 +204,7 @@ inline string IntString(DWORD val)
 typedef ULONG (WINAPI *RELEASEPROC)(LPVOID);
 
 #include "../GlobalCaptureStuff.h"
+#include "../FrameTiles.h"
 
 enum GSColorFormat {GS_UNKNOWNFORMAT, GS_ALPHA, GS_GRAYSCALE, GS_RGB, GS_RGBA, GS_BGR, GS_BGRA, GS_RGBA16F, GS_RGBA32F, GS_B5G5R5A1, GS_B5G6R5, GS_R10G10B10A2, GS_DXT1, GS_DXT3, GS_DXT5};
 
@@ -245,7 +246,12 @@ BOOL   WINAPI OSTryEnterMutex(HANDLE hMutex);
 void   WINAPI OSLeaveMutex(HANDLE hMutex);
 void   WINAPI OSCloseMutex(HANDLE hMutex);
 
-UINT InitializeSharedMemoryCPUCapture(UINT textureSize, DWORD *totalSize, MemoryCopyData **copyData, LPBYTE *textureBuffers);
+UINT InitializeSharedMemoryCPUCapture(UINT pitch, UINT height, DWORD *totalSize, MemoryCopyData **copyData, LPBYTE *textureBuffers);
+
+//copies a frame to one of the cpu capture textures, keeping track of the tiles that changed.  if a frame was
+//written to the texture some other way, SetSharedFrameChanged has to be called instead
+void CopyFrameToSharedMemory(UINT bufferID, LPVOID lpData);
+void SetSharedFrameChanged(UINT bufferID);
 UINT InitializeSharedMemoryGPUCapture(SharedTexData **texData);
 void DestroySharedMemory();
 
@@ -754,7 +754,7 @@ void DoGLCPUHook(RECT &rc)
 
     if(bSuccess)
     {
-        glcaptureInfo.mapID = InitializeSharedMemoryCPUCapture(dwSize, &glcaptureInfo.mapSize, &copyData, textureBuffers);
+        glcaptureInfo.mapID = InitializeSharedMemoryCPUCapture(glcaptureInfo.cx*4, glcaptureInfo.cy, &glcaptureInfo.mapSize, &copyData, textureBuffers);
         if(!glcaptureInfo.mapID)
             bSuccess = false;
     }
@@ -820,7 +820,7 @@ DWORD CopyGLCPUTextureThread(LPVOID lpUseless)
 
             if(lastRendered != -1)
             {
-                memcpy(textureBuffers[lastRendered], data, glcaptureInfo.pitch*glcaptureInfo.cy);
+                CopyFrameToSharedMemory((UINT)lastRendered, data);
                 ReleaseMutex(textureMutexes[lastRendered]);
                 copyData->lastRendered = (UINT)lastRendered;
             }
@@ -30,6 +30,8 @@ void MemoryCapture::Destroy()
     copyData = NULL;
     textureBuffers[0] = NULL;
     textureBuffers[1] = NULL;
+    tileMaps[0] = NULL;
+    tileMaps[1] = NULL;
     delete texture;
     texture = NULL;
 
@@ -48,6 +50,7 @@ void MemoryCapture::Destroy()
 
 bool MemoryCapture::Init(CaptureInfo &info)
 {
+    this->width = info.cx;
     this->height = info.cy;
     this->pitch = info.pitch;
 
@@ -84,7 +87,25 @@ bool MemoryCapture::Init(CaptureInfo &info)
     textureBuffers[1] = sharedMemory+copyData->texture2Offset;
     copyData->frameTime = 1000000/API->GetMaxFPS();
 
-    texture = CreateTexture(info.cx, info.cy, (GSColorFormat)info.format, NULL, NULL, FALSE);
+    //changed tiles are uploaded straight from shared memory, so it has to be a format that needs no conversion
+    switch(info.format)
+    {
+        case GS_RGB:  imageFormat = GS_IMAGEFORMAT_RGBX; bUseTileMaps = true; break;
+        case GS_RGBA: imageFormat = GS_IMAGEFORMAT_RGBA; bUseTileMaps = true; break;
+        case GS_BGR:  imageFormat = GS_IMAGEFORMAT_BGRX; bUseTileMaps = true; break;
+        case GS_BGRA: imageFormat = GS_IMAGEFORMAT_BGRA; bUseTileMaps = true; break;
+    }
+
+    if(!copyData->tileMap1Offset || !copyData->tileMap2Offset)
+        bUseTileMaps = false;
+
+    if(bUseTileMaps)
+    {
+        tileMaps[0] = sharedMemory+copyData->tileMap1Offset;
+        tileMaps[1] = sharedMemory+copyData->tileMap2Offset;
+    }
+
+    texture = CreateTexture(info.cx, info.cy, (GSColorFormat)info.format, NULL, NULL, bUseTileMaps);
     if(!texture)
     {
         AppWarning(TEXT("MemoryCapture::Init: Could not create texture"));
@@ -117,7 +138,12 @@ Texture* MemoryCapture::LockTexture()
             curTexture = nextTexture;
         }
 
-        if(hMutex)
+        if(hMutex && bUseTileMaps)
+        {
+            UploadChangedTiles();
+            ReleaseMutex(hMutex);
+        }
+        else if(hMutex)
         {
             BYTE *lpData;
             UINT texPitch;
@@ -154,3 +180,38 @@ Texture* MemoryCapture::LockTexture()
 void MemoryCapture::UnlockTexture()
 {
 }
+
+void MemoryCapture::UploadChangedTiles()
+{
+    UINT frameID = copyData->frameIDs[curTexture];
+
+    //nothing's been written there yet, or it's the same frame as last time
+    if(!frameID || (bHasFrame && frameID == lastFrameID))
+        return;
+
+    LPBYTE input = textureBuffers[curTexture];
+
+    //tiles only say what changed since the frame right before, if any were missed everything has to go up
+    if(!bHasFrame || frameID != lastFrameID+1)
+        texture->SetImageRect(input, imageFormat, pitch, 0, 0, width, height);
+    else
+    {
+        UINT tilesX = GetFrameTilesX(pitch), tilesY = GetFrameTilesY(height);
+        UINT tilePixels = FRAME_TILE_BYTES/4;
+
+        for(UINT tileY=0; tileY<tilesY; tileY++)
+        {
+            const BYTE *lpTileRow = tileMaps[curTexture] + tileY*tilesX;
+            UINT tileX = 0, numTiles;
+
+            while(GetChangedTileRun(lpTileRow, tilesX, tileX, numTiles))
+            {
+                texture->SetImageRect(input, imageFormat, pitch, tileX*tilePixels, tileY*FRAME_TILE_ROWS, numTiles*tilePixels, FRAME_TILE_ROWS);
+                tileX += numTiles;
+            }
+        }
+    }
+
+    lastFrameID = frameID;
+    bHasFrame = true;
+}
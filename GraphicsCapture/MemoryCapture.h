@@ -31,14 +31,22 @@ class MemoryCapture : public GraphicsCaptureMethod
     LPBYTE textureBuffers[2];
     UINT pitch;
 
+    //if the hook keeps track of changed tiles, only those get uploaded to a static texture
+    LPBYTE tileMaps[2];
+    GSImageFormat imageFormat;
+    bool bUseTileMaps, bHasFrame;
+    UINT lastFrameID;
+
     Texture *texture;
     HANDLE hMutex;
 
     bool bInitialized;
 
-    UINT height;
+    UINT width, height;
     DWORD curTexture;
 
+    void UploadChangedTiles();
+
 public:
     void Destroy();
 
@@ -163,6 +163,6 @@ void OBSGetCurMicVolumeStats(float *rms, float *max, float *peak)       {API->Ge
 void OBSAddSettingsPane(SettingsPane *pane)     {API->AddSettingsPane(pane);}
 void OBSRemoveSettingsPane(SettingsPane *pane)  {API->RemoveSettingsPane(pane);}
 
-UINT OBSGetAPIVersion()                         {return 0x0103;}
+UINT OBSGetAPIVersion()                         {return 0x0107;}
 
 UINT OBSGetSampleRateHz()                       {return API->GetSampleRateHz();}
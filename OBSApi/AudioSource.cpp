@@ -25,6 +25,8 @@
 #define KSAUDIO_SPEAKER_3POINT1     (KSAUDIO_SPEAKER_STEREO|SPEAKER_FRONT_CENTER|SPEAKER_LOW_FREQUENCY)
 #define KSAUDIO_SPEAKER_2POINT1     (KSAUDIO_SPEAKER_STEREO|SPEAKER_LOW_FREQUENCY)
 
+static Metric *timestampAdjustMetric = NULL;
+
 
 void MultiplyAudioBuffer(float *buffer, int totalFloats, float mulVal)
 {
@@ -661,6 +663,10 @@ UINT AudioSource::QueryAudio2(float curVolume, bool bCanBurstHack)
             //    Log(TEXT("A timestamp adjustment was encountered for device %s, diffVal: %llu, jumpRange: %llu, newTimestamp: %llu, lastUsedTimestamp: %llu"),
             //    GetDeviceName(), difVal, MoreVariables->jumpRange, newTimestamp, lastUsedTimestamp);
             lastUsedTimestamp = newTimestamp;
+
+            if (!timestampAdjustMetric)
+                timestampAdjustMetric = RegisterCounter(TEXT("obs_audio_timestamp_adjustments_total"), TEXT("Audio timestamps resynced after drifting past the jump range"));
+            MetricIncrement(timestampAdjustMetric);
         }
 
         //if (sstri(GetDeviceName(), L"avermedia") != NULL)
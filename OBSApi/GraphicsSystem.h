@@ -217,6 +217,11 @@ public:
 
     virtual LPVOID GetD3DTexture()=0;
     virtual HANDLE GetSharedHandle()=0;
+
+    // To prevent breaking the API, put anything new at the end of the class (and bump OBSGetAPIVersion)
+    //lpData/pitch describe the whole image, only the given rectangle of it gets uploaded.  dynamic
+    //textures can only be written as a whole, so those get the entire image
+    virtual void SetImageRect(void *lpData, GSImageFormat imageFormat, UINT pitch, UINT x, UINT y, UINT cx, UINT cy)=0;
 };
 
 
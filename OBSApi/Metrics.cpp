@@ -0,0 +1,227 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "OBSApi.h"
+
+
+struct MetricsCollector
+{
+    METRICSCOLLECTPROC collectProc;
+    LPVOID param;
+};
+
+HANDLE hMetricsMutex = NULL;
+
+static List<Metric*> metrics;
+static List<MetricsCollector> metricsCollectors;
+
+
+static Metric* RegisterMetric(MetricType type, CTSTR lpName, CTSTR lpHelp)
+{
+    OSEnterMutex(hMetricsMutex);
+
+    for(UINT i=0; i<metrics.Num(); i++)
+    {
+        if(metrics[i]->strName.Compare(lpName))
+        {
+            Metric *metric = metrics[i];
+            OSLeaveMutex(hMetricsMutex);
+
+            if(metric->type != type)
+                AppWarning(TEXT("RegisterMetric: '%s' was already registered as a different type"), lpName);
+            return metric;
+        }
+    }
+
+    Metric *metric = new Metric;
+    metric->type = type;
+    metric->strName = lpName;
+    metric->strHelp = lpHelp;
+    metric->value = metric->count = 0;
+    metric->numBuckets = 0;
+    zero((void*)metric->bucketCounts, sizeof(metric->bucketCounts));
+    metrics << metric;
+
+    OSLeaveMutex(hMetricsMutex);
+    return metric;
+}
+
+Metric* STDCALL RegisterCounter(CTSTR lpName, CTSTR lpHelp)
+{
+    return RegisterMetric(MetricType_Counter, lpName, lpHelp);
+}
+
+Metric* STDCALL RegisterGauge(CTSTR lpName, CTSTR lpHelp)
+{
+    return RegisterMetric(MetricType_Gauge, lpName, lpHelp);
+}
+
+Metric* STDCALL RegisterHistogram(CTSTR lpName, CTSTR lpHelp, const LONGLONG *bounds, UINT numBounds)
+{
+    Metric *metric = RegisterMetric(MetricType_Histogram, lpName, lpHelp);
+
+    //bounds are only set the first time, after that observers may already be reading them
+    if(!metric->numBuckets)
+    {
+        numBounds = MIN(numBounds, METRIC_MAX_BUCKETS);
+        mcpy(metric->bucketBounds, bounds, numBounds*sizeof(LONGLONG));
+        metric->numBuckets = numBounds;
+    }
+
+    return metric;
+}
+
+void STDCALL AddMetricsCollector(METRICSCOLLECTPROC collectProc, LPVOID param)
+{
+    OSEnterMutex(hMetricsMutex);
+    MetricsCollector *collector = metricsCollectors.CreateNew();
+    collector->collectProc = collectProc;
+    collector->param = param;
+    OSLeaveMutex(hMetricsMutex);
+}
+
+void STDCALL RemoveMetricsCollector(METRICSCOLLECTPROC collectProc, LPVOID param)
+{
+    OSEnterMutex(hMetricsMutex);
+    for(UINT i=0; i<metricsCollectors.Num(); i++)
+    {
+        if(metricsCollectors[i].collectProc == collectProc && metricsCollectors[i].param == param)
+        {
+            metricsCollectors.Remove(i);
+            break;
+        }
+    }
+    OSLeaveMutex(hMetricsMutex);
+}
+
+//must be called with hMetricsMutex held
+static void CollectMetrics()
+{
+    for(UINT i=0; i<metricsCollectors.Num(); i++)
+        metricsCollectors[i].collectProc(metricsCollectors[i].param);
+}
+
+static inline LONGLONG ReadMetricValue(volatile LONGLONG &value)
+{
+    //a plain 64bit read can tear on x86
+    return InterlockedCompareExchange64(&value, 0, 0);
+}
+
+static CTSTR MetricTypeName(MetricType type)
+{
+    switch(type)
+    {
+        case MetricType_Counter:    return TEXT("counter");
+        case MetricType_Gauge:      return TEXT("gauge");
+        default:                    return TEXT("histogram");
+    }
+}
+
+String STDCALL GetMetricsPrometheus()
+{
+    StringBuilder text;
+
+    OSEnterMutex(hMetricsMutex);
+    CollectMetrics();
+
+    for(UINT i=0; i<metrics.Num(); i++)
+    {
+        Metric *metric = metrics[i];
+        CTSTR lpName = metric->strName.Array();
+
+        if(metric->strHelp.IsValid())
+            text.AppendFormat(TEXT("# HELP %s %s\n"), lpName, metric->strHelp.Array());
+        text.AppendFormat(TEXT("# TYPE %s %s\n"), lpName, MetricTypeName(metric->type));
+
+        if(metric->type != MetricType_Histogram)
+        {
+            text.AppendFormat(TEXT("%s %lld\n"), lpName, ReadMetricValue(metric->value));
+            continue;
+        }
+
+        LONGLONG count = ReadMetricValue(metric->count);
+        LONGLONG cumulative = 0;
+        for(UINT j=0; j<metric->numBuckets; j++)
+        {
+            //the buckets and count aren't read atomically together, so keep them from going past the total
+            cumulative = MIN(cumulative+ReadMetricValue(metric->bucketCounts[j]), count);
+            text.AppendFormat(TEXT("%s_bucket{le=\"%lld\"} %lld\n"), lpName, metric->bucketBounds[j], cumulative);
+        }
+
+        text.AppendFormat(TEXT("%s_bucket{le=\"+Inf\"} %lld\n"), lpName, count);
+        text.AppendFormat(TEXT("%s_sum %lld\n"), lpName, ReadMetricValue(metric->value));
+        text.AppendFormat(TEXT("%s_count %lld\n"), lpName, count);
+    }
+
+    OSLeaveMutex(hMetricsMutex);
+
+    return text.ToString();
+}
+
+String STDCALL GetMetricsJSON()
+{
+    StringBuilder json;
+    json.AppendFormat(TEXT("{\"time\":%lld,\"metrics\":{"), (LONGLONG)time(0));
+
+    OSEnterMutex(hMetricsMutex);
+    CollectMetrics();
+
+    for(UINT i=0; i<metrics.Num(); i++)
+    {
+        Metric *metric = metrics[i];
+
+        if(i) json << TEXT(',');
+        json.AppendFormat(TEXT("\"%s\":"), metric->strName.Array());
+
+        if(metric->type != MetricType_Histogram)
+        {
+            json.AppendFormat(TEXT("%lld"), ReadMetricValue(metric->value));
+            continue;
+        }
+
+        LONGLONG count = ReadMetricValue(metric->count);
+        json.AppendFormat(TEXT("{\"count\":%lld,\"sum\":%lld,\"buckets\":{"), count, ReadMetricValue(metric->value));
+
+        LONGLONG cumulative = 0;
+        for(UINT j=0; j<metric->numBuckets; j++)
+        {
+            cumulative = MIN(cumulative+ReadMetricValue(metric->bucketCounts[j]), count);
+            json.AppendFormat(TEXT("\"%lld\":%lld,"), metric->bucketBounds[j], cumulative);
+        }
+        json.AppendFormat(TEXT("\"+Inf\":%lld}}"), count);
+    }
+
+    OSLeaveMutex(hMetricsMutex);
+
+    json << TEXT("}}");
+    return json.ToString();
+}
+
+//only call this at shutdown, the metrics are handed out as raw pointers
+void STDCALL FreeMetrics()
+{
+    OSEnterMutex(hMetricsMutex);
+
+    for(UINT i=0; i<metrics.Num(); i++)
+        delete metrics[i];
+    metrics.Clear();
+    metricsCollectors.Clear();
+
+    OSLeaveMutex(hMetricsMutex);
+}
@@ -0,0 +1,88 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// health metrics.  counters, gauges and histograms are registered by name once, after that they're
+// only touched with interlocked operations, so any thread can update them without taking a lock.
+// the registry itself is only locked when metrics are registered or a snapshot is formatted.
+
+enum MetricType
+{
+    MetricType_Counter,
+    MetricType_Gauge,
+    MetricType_Histogram,
+};
+
+#define METRIC_MAX_BUCKETS 16
+
+struct Metric
+{
+    MetricType type;
+    String strName;
+    String strHelp;
+
+    volatile LONGLONG value;        //sum of the observed values for histograms
+    volatile LONGLONG count;        //histograms only
+
+    UINT numBuckets;
+    LONGLONG bucketBounds[METRIC_MAX_BUCKETS];              //upper bounds, ascending
+    volatile LONGLONG bucketCounts[METRIC_MAX_BUCKETS];     //not cumulative, values above the last bound only go into count
+};
+
+typedef void (STDCALL *METRICSCOLLECTPROC)(LPVOID param);
+
+//registering a name that already exists returns the existing metric, so they're safe to register from anywhere
+BASE_EXPORT Metric* STDCALL RegisterCounter(CTSTR lpName, CTSTR lpHelp);
+BASE_EXPORT Metric* STDCALL RegisterGauge(CTSTR lpName, CTSTR lpHelp);
+BASE_EXPORT Metric* STDCALL RegisterHistogram(CTSTR lpName, CTSTR lpHelp, const LONGLONG *bounds, UINT numBounds);
+
+//collectors are called right before each snapshot, for values that are easier to read on demand than to keep updated
+BASE_EXPORT void STDCALL AddMetricsCollector(METRICSCOLLECTPROC collectProc, LPVOID param);
+BASE_EXPORT void STDCALL RemoveMetricsCollector(METRICSCOLLECTPROC collectProc, LPVOID param);
+
+BASE_EXPORT String STDCALL GetMetricsPrometheus();
+BASE_EXPORT String STDCALL GetMetricsJSON();
+BASE_EXPORT void STDCALL FreeMetrics();
+
+inline void MetricIncrement(Metric *metric, LONGLONG amount=1)
+{
+    InterlockedExchangeAdd64(&metric->value, amount);
+}
+
+inline void MetricSet(Metric *metric, LONGLONG value)
+{
+    InterlockedExchange64(&metric->value, value);
+}
+
+inline void MetricObserve(Metric *metric, LONGLONG value)
+{
+    for(UINT i=0; i<metric->numBuckets; i++)
+    {
+        if(value <= metric->bucketBounds[i])
+        {
+            InterlockedIncrement64(&metric->bucketCounts[i]);
+            break;
+        }
+    }
+
+    InterlockedIncrement64(&metric->count);
+    InterlockedExchangeAdd64(&metric->value, value);
+}
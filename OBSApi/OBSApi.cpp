@@ -426,6 +426,9 @@ void MixAudio(float *bufferDest, float *bufferSrc, UINT totalFloats, bool bForce
     }
 }
 
+extern HANDLE hMetricsMutex;
+extern HANDLE hShaderCacheMutex;
+
 BOOL CALLBACK DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
     if (fdwReason == DLL_PROCESS_ATTACH)
@@ -434,6 +437,15 @@ BOOL CALLBACK DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
         //workaround AVX2 bug in VS2013, http://connect.microsoft.com/VisualStudio/feedback/details/811093
         _set_FMA3_enable(0);
 #endif
+        hMetricsMutex = OSCreateMutex();
+        hShaderCacheMutex = OSCreateMutex();
+    }
+    else if (fdwReason == DLL_PROCESS_DETACH)
+    {
+        OSCloseMutex(hMetricsMutex);
+        hMetricsMutex = NULL;
+        OSCloseMutex(hShaderCacheMutex);
+        hShaderCacheMutex = NULL;
     }
 
     return TRUE;
@@ -87,11 +87,13 @@ BASE_EXPORT void MixAudio(float *bufferDest, float *bufferSrc, UINT totalFloats,
 //-------------------------------------------
 
 #include "GraphicsSystem.h"
+#include "ShaderCache.h"
 #include "Scene.h"
 #include "SettingsPane.h"
 #include "APIInterface.h"
 #include "AudioFilter.h"
 #include "AudioSource.h"
+#include "Metrics.h"
 #include "HotkeyControlEx.h"
 #include "ColorControl.h"
 #include "VolumeControl.h"
@@ -190,6 +190,89 @@ void SceneItem::MoveToBottom()
 
 //====================================================================================
 
+#define MAX_RECT_PIECES 64
+
+//cuts a rect out of another, adding whatever's left of it (up to four pieces) to the list
+static void SubtractRect(const SceneRect &rect, const SceneRect &cut, List<SceneRect> &pieces)
+{
+    if(cut.topLeft.x >= rect.bottomRight.x || cut.bottomRight.x <= rect.topLeft.x ||
+       cut.topLeft.y >= rect.bottomRight.y || cut.bottomRight.y <= rect.topLeft.y)
+    {
+        pieces << rect;
+        return;
+    }
+
+    SceneRect piece = rect;
+
+    if(cut.topLeft.y > rect.topLeft.y)
+    {
+        piece.bottomRight.y = cut.topLeft.y;
+        pieces << piece;
+    }
+
+    if(cut.bottomRight.y < rect.bottomRight.y)
+    {
+        piece.topLeft.y = cut.bottomRight.y;
+        piece.bottomRight.y = rect.bottomRight.y;
+        pieces << piece;
+    }
+
+    //whatever's left is the band the cut goes through vertically
+    piece.topLeft.y = MAX(rect.topLeft.y, cut.topLeft.y);
+    piece.bottomRight.y = MIN(rect.bottomRight.y, cut.bottomRight.y);
+
+    if(cut.topLeft.x > rect.topLeft.x)
+    {
+        piece.topLeft.x = rect.topLeft.x;
+        piece.bottomRight.x = cut.topLeft.x;
+        pieces << piece;
+    }
+
+    if(cut.bottomRight.x < rect.bottomRight.x)
+    {
+        piece.topLeft.x = cut.bottomRight.x;
+        piece.bottomRight.x = rect.bottomRight.x;
+        pieces << piece;
+    }
+}
+
+void GetHiddenRects(const Vect2 &canvasSize, const List<SceneRect> &rects, List<bool> &hidden)
+{
+    List<SceneRect> pieces, newPieces;
+
+    hidden.SetSize(rects.Num());
+
+    for(UINT i=0; i<rects.Num(); i++)
+    {
+        SceneRect visibleRect;
+        visibleRect.topLeft.x     = MAX(rects[i].topLeft.x, 0.0f);
+        visibleRect.topLeft.y     = MAX(rects[i].topLeft.y, 0.0f);
+        visibleRect.bottomRight.x = MIN(rects[i].bottomRight.x, canvasSize.x);
+        visibleRect.bottomRight.y = MIN(rects[i].bottomRight.y, canvasSize.y);
+
+        pieces.Clear();
+        if(visibleRect.topLeft.x < visibleRect.bottomRight.x && visibleRect.topLeft.y < visibleRect.bottomRight.y)
+            pieces << visibleRect;
+
+        //keep cutting the opaque rects above it out of what's still showing
+        for(UINT j=0; j<i && pieces.Num() && pieces.Num() <= MAX_RECT_PIECES; j++)
+        {
+            if(!rects[j].bOpaque)
+                continue;
+
+            newPieces.Clear();
+            for(UINT k=0; k<pieces.Num(); k++)
+                SubtractRect(pieces[k], rects[j], newPieces);
+
+            pieces.TransferFrom(newPieces);
+        }
+
+        hidden[i] = (pieces.Num() == 0);
+    }
+}
+
+//====================================================================================
+
 Scene::~Scene()
 {
     for(UINT i=0; i<sceneItems.Num(); i++)
@@ -273,6 +356,16 @@ void Scene::Preprocess()
     }
 }
 
+void Scene::GetAsyncPreprocessSources(List<ImageSource*> &sources)
+{
+    for(UINT i=0; i<sceneItems.Num(); i++)
+    {
+        SceneItem *item = sceneItems[i];
+        if(item->source && item->bRender && item->source->SupportsAsyncPreprocess())
+            sources << item->source;
+    }
+}
+
 void Scene::Tick(float fSeconds)
 {
     for(UINT i=0; i<sceneItems.Num(); i++)
@@ -283,20 +376,87 @@ void Scene::Tick(float fSeconds)
     }
 }
 
+void Scene::UpdateVisibility()
+{
+    itemRects.SetSize(sceneItems.Num());
+
+    for(UINT i=0; i<sceneItems.Num(); i++)
+    {
+        SceneItem *item = sceneItems[i];
+        SceneRect &rect = itemRects[i];
+
+        //items that don't draw anything just get an empty rect
+        if(!item->source || !item->bRender)
+        {
+            rect.topLeft = rect.bottomRight = Vect2(0.0f, 0.0f);
+            rect.bOpaque = false;
+            continue;
+        }
+
+        Vect2 topLeft     = item->pos + item->GetCropTL();
+        Vect2 bottomRight = item->pos + item->size + item->GetCropBR();
+
+        rect.topLeft     = Vect2(MIN(topLeft.x, bottomRight.x), MIN(topLeft.y, bottomRight.y));
+        rect.bottomRight = Vect2(MAX(topLeft.x, bottomRight.x), MAX(topLeft.y, bottomRight.y));
+        rect.bOpaque     = item->source->IsOpaque();
+    }
+
+    GetHiddenRects(API->GetBaseSize(), itemRects, hiddenItems);
+}
+
+bool Scene::HasChanged()
+{
+    if(!bRendered)
+        return true;
+
+    UpdateVisibility();
+
+    if(sceneItems.Num() != renderedSources.Num())
+        return true;
+
+    for(UINT i=0; i<sceneItems.Num(); i++)
+    {
+        const SceneRect &rect = itemRects[i], &renderedRect = renderedRects[i];
+
+        if(sceneItems[i]->source != renderedSources[i] || hiddenItems[i] != renderedHiddenItems[i] ||
+           rect.topLeft != renderedRect.topLeft || rect.bottomRight != renderedRect.bottomRight)
+            return true;
+    }
+
+    for(UINT i=0; i<sceneItems.Num(); i++)
+    {
+        if(!hiddenItems[i] && sceneItems[i]->source->HasContentChanged())
+            return true;
+    }
+
+    return false;
+}
+
 void Scene::Render()
 {
+    UpdateVisibility();
+
     GS->ClearColorBuffer();
 
     for(int i=sceneItems.Num()-1; i>=0; i--)
     {
         SceneItem *item = sceneItems[i];
-        if(item->source && item->bRender)
+        if(!hiddenItems[i])
         {
             GS->SetCropping (item->GetCrop().x, item->GetCrop().y, item->GetCrop().w, item->GetCrop().z);
             item->source->Render(item->pos, item->size);
             GS->SetCropping (0.0f, 0.0f, 0.0f, 0.0f);
         }
     }
+
+    renderedRects.CopyList(itemRects);
+    renderedHiddenItems.CopyList(hiddenItems);
+
+    renderedSources.SetSize(sceneItems.Num());
+    for(UINT i=0; i<sceneItems.Num(); i++)
+        renderedSources[i] = sceneItems[i]->source;
+
+    bRendered = true;
 }
 
 void Scene::RenderSelections(Shader *solidPixelShader)
@@ -27,6 +27,7 @@ class BASE_EXPORT ImageSource
 public:
     virtual ~ImageSource() {}
     virtual void Preprocess() {}
+
     virtual void Tick(float fSeconds) {}
     virtual void Render(const Vect2 &pos, const Vect2 &size)=0;
 
@@ -67,9 +68,43 @@ public:
     virtual bool GetVector2(CTSTR lpName, Vect2 &value)  const {return false;}
     virtual bool GetVector4(CTSTR lpName, Vect4 &value)  const {return false;}
     virtual bool GetMatrix(CTSTR lpName, Matrix &mat)    const {return false;}
+
+    //-------------------------------------------------------------
+    // To prevent breaking the API, put anything new at the end of the class (and bump OBSGetAPIVersion)
+
+    //whether Render would draw anything different from the last time it was called.  sources that can't
+    //tell should leave this returning true, otherwise the scene could end up reusing an old frame
+    virtual bool HasContentChanged() {return true;}
+
+    //whether Render fills its whole pos/size rectangle with opaque pixels, so nothing under it has to be drawn
+    virtual bool IsOpaque() const {return false;}
+
+    //sources that return true here get PreprocessAsync called on a worker thread every frame, at the same time
+    //as other sources, before Preprocess.  it can only do cpu work: no graphics calls and nothing shared with
+    //other sources, anything that needs the graphics system has to wait for Preprocess
+    virtual bool SupportsAsyncPreprocess() const {return false;}
+    virtual void PreprocessAsync() {}
+
+    //false for sources holding something only one source can have open at a time (like a capture device).
+    //scenes with such a source are deleted when switched away from instead of being kept warm for switching back
+    virtual bool CanKeepWarm() const {return true;}
 };
 
 
+//-------------------------------------------------------------------
+
+//visible area of a scene item and whether it hides everything under it
+struct SceneRect
+{
+    Vect2 topLeft, bottomRight;
+    bool bOpaque;
+};
+
+//works out which rects can't be seen, either because they're off the canvas or because the opaque rects above
+//them cover them completely.  rects go from the top down, same as scene items
+BASE_EXPORT void GetHiddenRects(const Vect2 &canvasSize, const List<SceneRect> &rects, List<bool> &hidden);
+
+
 //====================================================================================
 
 class BASE_EXPORT SceneItem
@@ -141,6 +176,18 @@ class BASE_EXPORT Scene
 
     UINT hotkeyID;
 
+    //hidden items are skipped when rendering, and what was drawn last time is kept to tell whether
+    //the scene needs to be drawn again at all
+    List<SceneRect> itemRects;
+    List<bool> hiddenItems;
+
+    List<SceneRect> renderedRects;
+    List<bool> renderedHiddenItems;
+    List<ImageSource*> renderedSources;
+    bool bRendered;
+
+    void UpdateVisibility();
+
     inline void DeselectAll()
     {
         for(UINT i=0; i<sceneItems.Num(); i++)
@@ -216,6 +263,15 @@ public:
                 items << sceneItems[i];
         }
     }
+
+    //--------------------------------
+    // To prevent breaking the API, put anything new at the end of the class (and bump OBSGetAPIVersion)
+
+    //false if rendering now would draw exactly the same thing as the last time the scene was rendered
+    virtual bool HasChanged();
+
+    //adds the sources that Preprocess would go through that want PreprocessAsync called
+    virtual void GetAsyncPreprocessSources(List<ImageSource*> &sources);
 };
 
 
@@ -0,0 +1,454 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "OBSApi.h"
+
+
+#define SHADER_CACHE_MAGIC          0x4348534F  //'OSHC'
+#define SHADER_CACHE_VERSION        1
+#define SHADER_CACHE_INCLUDE_DEPTH  8
+
+#define SHADER_CACHE_MEMORY_LIMIT   (16*1024*1024)      //least recently used entries past this are dropped from memory
+#define SHADER_CACHE_DISK_LIMIT     (64*1024*1024)      //oldest files past this are deleted at startup
+#define SHADER_CACHE_MAX_AGE        (30ULL*24*60*60)    //seconds a file can go unused before it's deleted at startup
+
+#define FNV64_OFFSET    0xCBF29CE484222325ULL
+#define FNV64_PRIME     0x00000100000001B3ULL
+
+struct ShaderCacheHeader
+{
+    DWORD magic;
+    DWORD version;
+    QWORD key;
+    DWORD dataSize;
+    DWORD checksum;
+};
+
+struct ShaderCacheEntry
+{
+    QWORD key;
+    QWORD lastUsed;
+    List<BYTE> data;
+};
+
+HANDLE hShaderCacheMutex = NULL;
+
+static String strShaderCacheFolder;
+static List<ShaderCacheEntry*> shaderCacheEntries;
+static QWORD shaderCacheUseCount = 0;
+static UINT shaderCacheMemorySize = 0;
+
+
+static inline QWORD HashBytes(QWORD hash, LPCVOID lpData, UINT size)
+{
+    const BYTE *lpBytes = (const BYTE*)lpData;
+
+    for(UINT i=0; i<size; i++)
+        hash = (hash ^ lpBytes[i]) * FNV64_PRIME;
+
+    return hash;
+}
+
+static inline DWORD GetChecksum(LPCVOID lpData, UINT size)
+{
+    QWORD hash = HashBytes(FNV64_OFFSET, lpData, size);
+    return DWORD(hash ^ (hash >> 32));
+}
+
+//hashes the source and, recursively, every file it pulls in with #include "file".  includes are looked up
+//relative to the including file the same way the shader processor does it.  a missing include just
+//doesn't get hashed, the compile will fail on it anyway.
+static QWORD HashShaderSource(QWORD hash, CTSTR lpShader, CTSTR lpFileName, UINT depth)
+{
+    hash = HashBytes(hash, lpShader, slen(lpShader)*sizeof(TCHAR));
+
+    if(!lpFileName || depth >= SHADER_CACHE_INCLUDE_DEPTH)
+        return hash;
+
+    UINT dirLength = 0;
+    for(UINT i=0; lpFileName[i]; i++)
+    {
+        if(lpFileName[i] == '/' || lpFileName[i] == '\\')
+            dirLength = i+1;
+    }
+
+    CTSTR lpInclude = lpShader;
+    while((lpInclude = schr(lpInclude, '#')) != NULL)
+    {
+        lpInclude++;
+        while(*lpInclude == ' ' || *lpInclude == '\t')
+            lpInclude++;
+
+        if(scmp_n(lpInclude, TEXT("include"), 7) != 0)
+            continue;
+
+        lpInclude += 7;
+        while(*lpInclude == ' ' || *lpInclude == '\t')
+            lpInclude++;
+
+        if(*lpInclude != '"')
+            continue;
+
+        CTSTR lpIncludeEnd = schr(++lpInclude, '"');
+        if(!lpIncludeEnd)
+            break;
+
+        String strIncludeFile;
+        if(dirLength)
+            strIncludeFile.AppendString(lpFileName, dirLength);
+        strIncludeFile.AppendString(lpInclude, UINT(lpIncludeEnd-lpInclude));
+
+        lpInclude = lpIncludeEnd+1;
+
+        XFile includeFile;
+        if(!includeFile.Open(strIncludeFile, XFILE_READ | XFILE_SHARED, XFILE_OPENEXISTING))
+            continue;
+
+        String strIncludeShader;
+        includeFile.ReadFileToString(strIncludeShader);
+        includeFile.Close();
+
+        hash = HashShaderSource(hash, strIncludeShader, strIncludeFile, depth+1);
+    }
+
+    return hash;
+}
+
+QWORD STDCALL GetShaderCacheKey(CTSTR lpShader, CTSTR lpFileName, LPCSTR lpVariant)
+{
+    QWORD hash = FNV64_OFFSET;
+
+    if(lpVariant)
+        hash = HashBytes(hash, lpVariant, (UINT)strlen(lpVariant)+1);
+
+    return HashShaderSource(hash, lpShader, lpFileName, 0);
+}
+
+struct ShaderCacheFile
+{
+    String strPath;
+    QWORD lastWrite;
+    QWORD size;
+};
+
+static inline QWORD FileTimeToQWORD(const FILETIME &fileTime)
+{
+    ULARGE_INTEGER val;
+    val.LowPart = fileTime.dwLowDateTime;
+    val.HighPart = fileTime.dwHighDateTime;
+    return val.QuadPart;
+}
+
+//files are touched whenever they're loaded, so anything that hasn't been written in a while belongs to a
+//shader that was changed or removed (or a plugin that was uninstalled).  those go first, then the oldest
+//files until the folder fits the disk limit.  temporary files left over from a crash mid store go too.
+static void TrimShaderCacheFolder(CTSTR lpCacheFolder)
+{
+    String strSearch;
+    strSearch << lpCacheFolder << TEXT("\\*");
+
+    WIN32_FIND_DATA wfd;
+    HANDLE hFind = FindFirstFile(strSearch, &wfd);
+    if(hFind == INVALID_HANDLE_VALUE)
+        return;
+
+    FILETIME nowFileTime;
+    GetSystemTimeAsFileTime(&nowFileTime);
+    QWORD now = FileTimeToQWORD(nowFileTime);
+    QWORD maxAge = SHADER_CACHE_MAX_AGE*10000000;   //filetime is in 100ns units
+
+    List<ShaderCacheFile> files;
+    QWORD totalSize = 0;
+    UINT numDeleted = 0;
+
+    do
+    {
+        if(wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+
+        UINT nameLength = slen(wfd.cFileName);
+        bool bTemp = nameLength > 4 && scmpi(wfd.cFileName+nameLength-4, TEXT(".tmp")) == 0;
+        bool bEntry = nameLength > 4 && scmpi(wfd.cFileName+nameLength-4, TEXT(".bin")) == 0;
+        if(!bTemp && !bEntry)
+            continue;
+
+        String strPath;
+        strPath << lpCacheFolder << TEXT("\\") << wfd.cFileName;
+
+        QWORD lastWrite = FileTimeToQWORD(wfd.ftLastWriteTime);
+        if(bTemp || (now > lastWrite && now-lastWrite > maxAge))
+        {
+            if(OSDeleteFile(strPath))
+                numDeleted++;
+            continue;
+        }
+
+        ShaderCacheFile *file = files.CreateNew();
+        file->strPath = strPath;
+        file->lastWrite = lastWrite;
+        file->size = (QWORD(wfd.nFileSizeHigh) << 32) | wfd.nFileSizeLow;
+        totalSize += file->size;
+    } while(FindNextFile(hFind, &wfd));
+
+    FindClose(hFind);
+
+    while(totalSize > SHADER_CACHE_DISK_LIMIT && files.Num())
+    {
+        UINT oldest = 0;
+        for(UINT i=1; i<files.Num(); i++)
+        {
+            if(files[i].lastWrite < files[oldest].lastWrite)
+                oldest = i;
+        }
+
+        if(OSDeleteFile(files[oldest].strPath))
+            numDeleted++;
+
+        totalSize -= files[oldest].size;
+        files[oldest].strPath.Clear();
+        files.Remove(oldest);
+    }
+
+    for(UINT i=0; i<files.Num(); i++)
+        files[i].strPath.Clear();
+
+    if(numDeleted)
+        Log(TEXT("Removed %u stale files from the shader cache"), numDeleted);
+}
+
+//moves the file's write time up so TrimShaderCacheFolder knows it's still in use
+static void TouchShaderCacheFile(CTSTR lpPath)
+{
+    HANDLE hFile = CreateFile(lpPath, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(hFile, NULL, NULL, &now);
+    CloseHandle(hFile);
+}
+
+void STDCALL InitShaderCache(CTSTR lpCacheFolder)
+{
+    OSEnterMutex(hShaderCacheMutex);
+
+    strShaderCacheFolder.Clear();
+
+    if(lpCacheFolder)
+    {
+        if(OSFileExists(lpCacheFolder))
+        {
+            TrimShaderCacheFolder(lpCacheFolder);
+            strShaderCacheFolder = lpCacheFolder;
+        }
+        else if(OSCreateDirectory(lpCacheFolder))
+            strShaderCacheFolder = lpCacheFolder;
+        else
+            Log(TEXT("InitShaderCache: Couldn't create directory '%s', shaders will only be cached in memory"), lpCacheFolder);
+    }
+
+    OSLeaveMutex(hShaderCacheMutex);
+}
+
+void STDCALL FreeShaderCache()
+{
+    OSEnterMutex(hShaderCacheMutex);
+
+    for(UINT i=0; i<shaderCacheEntries.Num(); i++)
+        delete shaderCacheEntries[i];
+    shaderCacheEntries.Clear();
+    shaderCacheMemorySize = 0;
+    strShaderCacheFolder.Clear();
+
+    OSLeaveMutex(hShaderCacheMutex);
+}
+
+static UINT FindEntryIndex(QWORD key)
+{
+    for(UINT i=0; i<shaderCacheEntries.Num(); i++)
+    {
+        if(shaderCacheEntries[i]->key == key)
+            return i;
+    }
+
+    return INVALID;
+}
+
+static ShaderCacheEntry* FindEntry(QWORD key)
+{
+    UINT index = FindEntryIndex(key);
+    if(index == INVALID)
+        return NULL;
+
+    ShaderCacheEntry *entry = shaderCacheEntries[index];
+    entry->lastUsed = ++shaderCacheUseCount;
+    return entry;
+}
+
+static void RemoveEntry(UINT index)
+{
+    ShaderCacheEntry *entry = shaderCacheEntries[index];
+    shaderCacheMemorySize -= entry->data.Num();
+    shaderCacheEntries.Remove(index);
+    delete entry;
+}
+
+static void AddEntry(QWORD key, LPCVOID lpData, UINT size)
+{
+    if(FindEntry(key))
+        return;
+
+    ShaderCacheEntry *entry = new ShaderCacheEntry;
+    entry->key = key;
+    entry->lastUsed = ++shaderCacheUseCount;
+    entry->data.CopyArray((const BYTE*)lpData, size);
+    shaderCacheEntries << entry;
+    shaderCacheMemorySize += size;
+
+    //only drops the memory copy, the file on disk still has it
+    while(shaderCacheMemorySize > SHADER_CACHE_MEMORY_LIMIT && shaderCacheEntries.Num() > 1)
+    {
+        UINT oldest = 0;
+        for(UINT i=1; i<shaderCacheEntries.Num(); i++)
+        {
+            if(shaderCacheEntries[i]->lastUsed < shaderCacheEntries[oldest]->lastUsed)
+                oldest = i;
+        }
+
+        RemoveEntry(oldest);
+    }
+}
+
+static String GetEntryPath(QWORD key)
+{
+    String strPath;
+    strPath << strShaderCacheFolder << TEXT("\\") << FormattedString(TEXT("%016llX"), key) << TEXT(".bin");
+    return strPath;
+}
+
+bool STDCALL ShaderCacheLoad(QWORD key, List<BYTE> &data)
+{
+    OSEnterMutex(hShaderCacheMutex);
+
+    ShaderCacheEntry *entry = FindEntry(key);
+    if(entry)
+        data.CopyList(entry->data);
+
+    String strPath;
+    if(!entry && strShaderCacheFolder.IsValid())
+        strPath = GetEntryPath(key);
+
+    OSLeaveMutex(hShaderCacheMutex);
+
+    if(entry)
+        return true;
+    if(strPath.IsEmpty())
+        return false;
+
+    //-----------------------------------------
+
+    XFile file;
+    if(!file.Open(strPath, XFILE_READ | XFILE_SHARED, XFILE_OPENEXISTING))
+        return false;
+
+    ShaderCacheHeader header;
+    if(file.Read(&header, sizeof(header)) != sizeof(header) ||
+       header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION || header.key != key ||
+       file.GetFileSize() != sizeof(header)+header.dataSize)
+    {
+        return false;
+    }
+
+    data.SetSize(header.dataSize);
+    if(file.Read(data.Array(), header.dataSize) != header.dataSize || GetChecksum(data.Array(), header.dataSize) != header.checksum)
+    {
+        data.Clear();
+        return false;
+    }
+
+    file.Close();
+
+    TouchShaderCacheFile(strPath);
+
+    OSEnterMutex(hShaderCacheMutex);
+    AddEntry(key, data.Array(), data.Num());
+    OSLeaveMutex(hShaderCacheMutex);
+
+    return true;
+}
+
+void STDCALL ShaderCacheRemove(QWORD key)
+{
+    OSEnterMutex(hShaderCacheMutex);
+
+    UINT index = FindEntryIndex(key);
+    if(index != INVALID)
+        RemoveEntry(index);
+
+    String strPath;
+    if(strShaderCacheFolder.IsValid())
+        strPath = GetEntryPath(key);
+
+    OSLeaveMutex(hShaderCacheMutex);
+
+    if(strPath.IsValid())
+        OSDeleteFile(strPath);
+}
+
+void STDCALL ShaderCacheStore(QWORD key, LPCVOID lpData, UINT size)
+{
+    OSEnterMutex(hShaderCacheMutex);
+
+    AddEntry(key, lpData, size);
+
+    String strPath;
+    if(strShaderCacheFolder.IsValid())
+        strPath = GetEntryPath(key);
+
+    OSLeaveMutex(hShaderCacheMutex);
+
+    if(strPath.IsEmpty())
+        return;
+
+    //-----------------------------------------
+    //several threads can store the same shader at once, so each writes its own temporary file and the
+    //last rename wins.  they all have the same contents anyway
+
+    ShaderCacheHeader header;
+    header.magic = SHADER_CACHE_MAGIC;
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    header.dataSize = size;
+    header.checksum = GetChecksum(lpData, size);
+
+    String strTempPath;
+    strTempPath << strPath << TEXT(".") << UIntString(OSGetCurrentThreadID()) << TEXT(".tmp");
+
+    XFile file;
+    if(!file.Open(strTempPath, XFILE_WRITE, XFILE_CREATEALWAYS))
+        return;
+
+    bool bSuccess = file.Write(&header, sizeof(header)) == sizeof(header) &&
+                    file.Write(lpData, size) == size;
+    file.Close();
+
+    if(!bSuccess || !OSRenameFile(strTempPath, strPath))
+        OSDeleteFile(strTempPath);
+}
@@ -0,0 +1,39 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// shader cache.  a plain key -> blob store that keeps everything it has seen in memory and mirrors it to
+// one file per key on disk.  it doesn't know anything about the graphics system, the key is just a hash
+// of the shader source (plus anything it #includes) and whatever variant string the caller uses to tell
+// apart different uses of the same source, like the compile target and compiler version.  memory is
+// capped by dropping the least recently used entries, and files that haven't been loaded in a while (or
+// don't fit the disk limit) are deleted when the cache is initialized.
+
+//lpCacheFolder can be NULL to only cache in memory
+BASE_EXPORT void  STDCALL InitShaderCache(CTSTR lpCacheFolder);
+BASE_EXPORT void  STDCALL FreeShaderCache();
+
+BASE_EXPORT QWORD STDCALL GetShaderCacheKey(CTSTR lpShader, CTSTR lpFileName, LPCSTR lpVariant);
+
+BASE_EXPORT bool  STDCALL ShaderCacheLoad(QWORD key, List<BYTE> &data);
+BASE_EXPORT void  STDCALL ShaderCacheStore(QWORD key, LPCVOID lpData, UINT size);
+//drops an entry from memory and disk, for when what was cached turned out to be unusable
+BASE_EXPORT void  STDCALL ShaderCacheRemove(QWORD key);
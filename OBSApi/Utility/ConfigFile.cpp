@@ -96,11 +96,36 @@ BOOL ConfigFile::LoadFile(DWORD dwOpenMode)
     return 1;
 }
 
+//case insensitive the same way scmpi is (ascii only)
+static inline UINT HashConfigName(UINT hash, CTSTR lpName)
+{
+    TCHAR val;
+    while((val = *(lpName++)) != 0)
+    {
+        if((val >= 'A') && (val <= 'Z'))
+            val += 0x20;
+
+        hash = (hash ^ UINT(val)) * 16777619;
+    }
+
+    return hash;
+}
+
+static inline UINT HashConfigKey(CTSTR lpSection, CTSTR lpKey)
+{
+    UINT hash = HashConfigName(2166136261, lpSection);
+    hash = (hash ^ '[') * 16777619;
+    return HashConfigName(hash, lpKey);
+}
+
 void ConfigFile::LoadData()
 {
     TSTR lpCurLine = lpFileData, lpNextLine;
     ConfigSection *lpCurSection=NULL;
-    DWORD i;
+
+    //key index+1 for the current section, so repeated keys can be found without scanning every key
+    List<UINT> keyTable;
+    UINT keyTableMask = 0;
 
     lpNextLine = schr(lpCurLine, '\r');
 
@@ -117,6 +142,10 @@ void ConfigFile::LoadData()
 
             lpCurSection->name = sfix(sdup(lpCurLine+1));
             lpCurSection->name[lpNextLine-lpCurLine-2] = 0;
+
+            keyTable.SetSize(16);
+            zero(keyTable.Array(), keyTable.Num()*sizeof(UINT));
+            keyTableMask = keyTable.Num()-1;
         }
         else if(lpCurSection && *lpCurLine && (*(LPWORD)lpCurLine != '//'))
         {
@@ -130,11 +159,16 @@ void ConfigFile::LoadData()
 
                 *lpValuePtr = 0;
 
-                for(i=0; i<lpCurSection->Keys.Num(); i++)
+                UINT slot = HashConfigName(2166136261, lpCurLine);
+                for(;; slot++)
                 {
-                    if(scmpi(lpCurLine, lpCurSection->Keys[i].name) == 0)
+                    UINT keyID = keyTable[slot & keyTableMask];
+                    if(!keyID)
+                        break;
+
+                    if(scmpi(lpCurLine, lpCurSection->Keys[keyID-1].name) == 0)
                     {
-                        key = &lpCurSection->Keys[i];
+                        key = &lpCurSection->Keys[keyID-1];
                         break;
                     }
                 }
@@ -143,6 +177,23 @@ void ConfigFile::LoadData()
                 {
                     key = lpCurSection->Keys.CreateNew();
                     key->name = sfix(sdup(lpCurLine));
+
+                    if(lpCurSection->Keys.Num()*2 > keyTable.Num())
+                    {
+                        keyTable.SetSize(keyTable.Num()*2);
+                        zero(keyTable.Array(), keyTable.Num()*sizeof(UINT));
+                        keyTableMask = keyTable.Num()-1;
+
+                        for(UINT i=0; i<lpCurSection->Keys.Num(); i++)
+                        {
+                            slot = HashConfigName(2166136261, lpCurSection->Keys[i].name);
+                            while(keyTable[slot & keyTableMask])
+                                slot++;
+                            keyTable[slot & keyTableMask] = i+1;
+                        }
+                    }
+                    else
+                        keyTable[slot & keyTableMask] = lpCurSection->Keys.Num();
                 }
 
                 *lpValuePtr = '=';
@@ -156,9 +207,88 @@ void ConfigFile::LoadData()
 
         *lpNextLine = '\r';
     }
+
+    BuildIndex();
+}
+
+//rebuilt after loading and whenever a change moves keys around, SetKey and AddKey otherwise add to it as
+//they go (see InsertKeyData)
+void ConfigFile::BuildIndex()
+{
+    UINT numKeys = 0;
+    for(UINT i=0; i<Sections.Num(); i++)
+        numKeys += Sections[i].Keys.Num();
+
+    UINT indexSize = 16;
+    while(indexSize < numKeys*2)
+        indexSize <<= 1;
+
+    Index.Clear();
+    Index.SetSize(indexSize);
+    numIndexKeys = 0;
+
+    for(UINT i=0; i<Sections.Num(); i++)
+    {
+        ConfigSection &section = Sections[i];
+
+        for(UINT j=0; j<section.Keys.Num(); j++)
+        {
+            UINT hash = HashConfigKey(section.name, section.Keys[j].name);
+            ConfigIndexSlot *slot = FindSlot(section.name, section.Keys[j].name, hash);
+
+            //otherwise a duplicate section later in the file, lookups have always found the first one
+            if(!slot->key)
+            {
+                slot->hash = hash;
+                slot->section = i;
+                slot->key = j+1;
+                numIndexKeys++;
+            }
+        }
+    }
+}
+
+//the slot holding the key, or the empty slot it would go in
+ConfigIndexSlot* ConfigFile::FindSlot(CTSTR lpSection, CTSTR lpKey, UINT hash)
+{
+    UINT mask = Index.Num()-1;
+
+    for(UINT slot=hash; ; slot++)
+    {
+        ConfigIndexSlot &indexSlot = Index[slot & mask];
+
+        if(!indexSlot.key)
+            return &indexSlot;
+
+        ConfigSection &section = Sections[indexSlot.section];
+        if(indexSlot.hash == hash && scmpi(lpKey, section.Keys[indexSlot.key-1].name) == 0 && scmpi(lpSection, section.name) == 0)
+            return &indexSlot;
+    }
+}
+
+ConfigKey* ConfigFile::FindKey(CTSTR lpSection, CTSTR lpKey)
+{
+    if(!Index.Num())
+        return NULL;
+
+    ConfigIndexSlot *slot = FindSlot(lpSection, lpKey, HashConfigKey(lpSection, lpKey));
+    return slot->key ? &Sections[slot->section].Keys[slot->key-1] : NULL;
 }
 
 void ConfigFile::Close()
+{
+    FreeSections();
+
+    if(lpFileData)
+    {
+        Free(lpFileData);
+        lpFileData      = NULL;
+    }
+
+    bOpen = 0;
+}
+
+void ConfigFile::FreeSections()
 {
     DWORD i,j,k;
 
@@ -180,14 +310,8 @@ void ConfigFile::Close()
         section.Keys.Clear();
     }
     Sections.Clear();
-
-    if(lpFileData)
-    {
-        Free(lpFileData);
-        lpFileData      = NULL;
-    }
-
-    bOpen = 0;
+    Index.Clear();
+    numIndexKeys = 0;
 }
 
 BOOL ConfigFile::SaveAs(CTSTR lpPath)
@@ -225,21 +349,9 @@ String ConfigFile::GetString(CTSTR lpSection, CTSTR lpKey, CTSTR def)
     assert(lpSection);
     assert(lpKey);
 
-    DWORD i,j;
-
-    for(i=0; i<Sections.Num(); i++)
-    {
-        ConfigSection &section = Sections[i];
-        if(scmpi(lpSection, section.name) == 0)
-        {
-            for(j=0; j<section.Keys.Num(); j++)
-            {
-                ConfigKey &key = section.Keys[j];
-                if(scmpi(lpKey, key.name) == 0)
-                    return String(key.ValueList[0]);
-            }
-        }
-    }
+    ConfigKey *key = FindKey(lpSection, lpKey);
+    if(key)
+        return String(key->ValueList[0]);
 
     if(def)
         return String(def);
@@ -252,21 +364,9 @@ CTSTR ConfigFile::GetStringPtr(CTSTR lpSection, CTSTR lpKey, CTSTR def)
     assert(lpSection);
     assert(lpKey);
 
-    DWORD i,j;
-
-    for(i=0; i<Sections.Num(); i++)
-    {
-        ConfigSection &section = Sections[i];
-        if(scmpi(lpSection, section.name) == 0)
-        {
-            for(j=0; j<section.Keys.Num(); j++)
-            {
-                ConfigKey &key = section.Keys[j];
-                if(scmpi(lpKey, key.name) == 0)
-                    return key.ValueList[0];
-            }
-        }
-    }
+    ConfigKey *key = FindKey(lpSection, lpKey);
+    if(key)
+        return key->ValueList[0];
 
     if(def)
         return def;
@@ -279,33 +379,31 @@ int ConfigFile::GetInt(CTSTR lpSection, CTSTR lpKey, int def)
     assert(lpSection);
     assert(lpKey);
 
-    DWORD i,j;
+    ConfigKey *key = FindKey(lpSection, lpKey);
+    if(!key)
+        return def;
 
-    for(i=0; i<Sections.Num(); i++)
+    if(!key->intState)
     {
-        ConfigSection &section = Sections[i];
-        if(scmpi(lpSection, section.name) == 0)
-        {
-            for(j=0; j<section.Keys.Num(); j++)
-            {
-                ConfigKey &key = section.Keys[j];
-                if(scmpi(lpKey, key.name) == 0)
-                {
-                    if(scmpi(key.ValueList[0], TEXT("true")) == 0)
-                        return 1;
-                    else if(scmpi(key.ValueList[0], TEXT("false")) == 0)
-                        return 0;
-                    else
-                    {
-                        if(ValidIntString(key.ValueList[0]))
-                            return tstring_base_to_int(key.ValueList[0], NULL, 0);
-                    }
-                }
-            }
-        }
+        CTSTR lpValue = key->ValueList[0];
+
+        int value = 0;
+        BYTE state = 1;
+
+        if(scmpi(lpValue, TEXT("true")) == 0)
+            value = 1;
+        else if(scmpi(lpValue, TEXT("false")) == 0)
+            value = 0;
+        else if(ValidIntString(lpValue))
+            value = tstring_base_to_int(lpValue, NULL, 0);
+        else
+            state = 2;
+
+        key->intValue = value;
+        key->intState = state;
     }
 
-    return def;
+    return (key->intState == 1) ? key->intValue : def;
 }
 
 DWORD ConfigFile::GetHex(CTSTR lpSection, CTSTR lpKey, DWORD def)
@@ -313,21 +411,9 @@ DWORD ConfigFile::GetHex(CTSTR lpSection, CTSTR lpKey, DWORD def)
     assert(lpSection);
     assert(lpKey);
 
-    DWORD i,j;
-
-    for(i=0; i<Sections.Num(); i++)
-    {
-        ConfigSection &section = Sections[i];
-        if(scmpi(lpSection, section.name) == 0)
-        {
-            for(j=0; j<section.Keys.Num(); j++)
-            {
-                ConfigKey &key = section.Keys[j];
-                if(scmpi(lpKey, key.name) == 0)
-                    return tstring_base_to_int(key.ValueList[0], NULL, 0);
-            }
-        }
-    }
+    ConfigKey *key = FindKey(lpSection, lpKey);
+    if(key)
+        return tstring_base_to_int(key->ValueList[0], NULL, 0);
 
     return def;
 }
@@ -337,23 +423,17 @@ float ConfigFile::GetFloat(CTSTR lpSection, CTSTR lpKey, float def)
     assert(lpSection);
     assert(lpKey);
 
-    DWORD i,j;
+    ConfigKey *key = FindKey(lpSection, lpKey);
+    if(!key)
+        return def;
 
-    for(i=0; i<Sections.Num(); i++)
+    if(!key->floatState)
     {
-        ConfigSection &section = Sections[i];
-        if(scmpi(lpSection, section.name) == 0)
-        {
-            for(j=0; j<section.Keys.Num(); j++)
-            {
-                ConfigKey &key = section.Keys[j];
-                if(scmpi(lpKey, key.name) == 0)
-                    return (float)tstof(key.ValueList[0]);
-            }
-        }
+        key->floatValue = (float)tstof(key->ValueList[0]);
+        key->floatState = 1;
     }
 
-    return def;
+    return key->floatValue;
 }
 
 Color4 ConfigFile::GetColor(CTSTR lpSection, CTSTR lpKey)
@@ -361,73 +441,61 @@ Color4 ConfigFile::GetColor(CTSTR lpSection, CTSTR lpKey)
     assert(lpSection);
     assert(lpKey);
 
-    DWORD i,j;
+    ConfigKey *key = FindKey(lpSection, lpKey);
+    if(!key)
+        return Color4(0.0f, 0.0f, 0.0f, 0.0f);
 
-    for(i=0; i<Sections.Num(); i++)
+    TSTR strValue = key->ValueList[0];
+    if(*strValue == '{')
     {
-        ConfigSection &section = Sections[i];
-        if(scmpi(lpSection, section.name) == 0)
-        {
-            for(j=0; j<section.Keys.Num(); j++)
-            {
-                ConfigKey &key = section.Keys[j];
-                if(scmpi(lpKey, key.name) == 0)
-                {
-                    TSTR strValue = key.ValueList[0];
-                    if(*strValue == '{')
-                    {
-                        Color4 ret;
+        Color4 ret;
 
-                        ret.x = float(tstof(++strValue));
+        ret.x = float(tstof(++strValue));
 
-                        if(!(strValue = schr(strValue, ',')))
-                            break;
-                        ret.y = float(tstof(++strValue));
+        if(!(strValue = schr(strValue, ',')))
+            return Color4(0.0f, 0.0f, 0.0f, 0.0f);
+        ret.y = float(tstof(++strValue));
 
-                        if(!(strValue = schr(strValue, ',')))
-                            break;
-                        ret.z = float(tstof(++strValue));
+        if(!(strValue = schr(strValue, ',')))
+            return Color4(0.0f, 0.0f, 0.0f, 0.0f);
+        ret.z = float(tstof(++strValue));
 
-                        if(!(strValue = schr(strValue, ',')))
-                        {
-                            ret.w = 1.0f;
-                            return ret;
-                        }
-                        ret.w = float(tstof(++strValue));
-
-                        return ret;
-                    }
-                    else if(*strValue == '[')
-                    {
-                        Color4 ret;
+        if(!(strValue = schr(strValue, ',')))
+        {
+            ret.w = 1.0f;
+            return ret;
+        }
+        ret.w = float(tstof(++strValue));
 
-                        ret.x = (float(tstoi(++strValue))/255.0f)+0.001f;
+        return ret;
+    }
+    else if(*strValue == '[')
+    {
+        Color4 ret;
 
-                        if(!(strValue = schr(strValue, ',')))
-                            break;
-                        ret.y = (float(tstoi(++strValue))/255.0f)+0.001f;
+        ret.x = (float(tstoi(++strValue))/255.0f)+0.001f;
 
-                        if(!(strValue = schr(strValue, ',')))
-                            break;
-                        ret.z = (float(tstoi(++strValue))/255.0f)+0.001f;
+        if(!(strValue = schr(strValue, ',')))
+            return Color4(0.0f, 0.0f, 0.0f, 0.0f);
+        ret.y = (float(tstoi(++strValue))/255.0f)+0.001f;
 
-                        if(!(strValue = schr(strValue, ',')))
-                        {
-                            ret.w = 1.0f;
-                            return ret;
-                        }
-                        ret.w = (float(tstoi(++strValue))/255.0f)+0.001f;
+        if(!(strValue = schr(strValue, ',')))
+            return Color4(0.0f, 0.0f, 0.0f, 0.0f);
+        ret.z = (float(tstoi(++strValue))/255.0f)+0.001f;
 
-                        return ret;
-                    }
-                    else if( (*LPWORD(strValue) == 'x0') ||
-                        (*LPWORD(strValue) == 'X0') )
-                    {
-                        return RGBA_to_Vect4(tstring_base_to_int(strValue+2, NULL, 16));
-                    }
-                }
-            }
+        if(!(strValue = schr(strValue, ',')))
+        {
+            ret.w = 1.0f;
+            return ret;
         }
+        ret.w = (float(tstoi(++strValue))/255.0f)+0.001f;
+
+        return ret;
+    }
+    else if( (*LPWORD(strValue) == 'x0') ||
+        (*LPWORD(strValue) == 'X0') )
+    {
+        return RGBA_to_Vect4(tstring_base_to_int(strValue+2, NULL, 16));
     }
 
     return Color4(0.0f, 0.0f, 0.0f, 0.0f);
@@ -751,20 +819,7 @@ void ConfigFile::SetColorList(CTSTR lpSection, CTSTR lpKey, List<Color4> &ColorL
 
 BOOL  ConfigFile::HasKey(CTSTR lpSection, CTSTR lpKey)
 {
-    for(unsigned int i=0; i<Sections.Num(); i++)
-    {
-        ConfigSection &section = Sections[i];
-        if(scmpi(section.name, lpSection) == 0)
-        {
-            for(unsigned int j=0; j<section.Keys.Num(); j++)
-            {
-                if(scmpi(section.Keys[j].name, lpKey) == 0)
-                    return TRUE;
-            }
-        }
-    }
-
-    return FALSE;
+    return FindKey(lpSection, lpKey) != NULL;
 }
 
 
@@ -792,45 +847,23 @@ void  ConfigFile::SetKey(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue)
         }
     }while(lpTemp < lpEnd);
 
+    String strNewLine;
+    strNewLine << lpKey << TEXT("=") << newvalue << TEXT("\r\n");
+
     if(!bInSection)
     {
-        lpTemp -= 2;
-
-        XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-        file.Write("\xEF\xBB\xBF", 3);
-        file.WriteAsUTF8(&lpFileData[2], dwLength-4);
-        file.Write("\r\n[", 3);
-        file.WriteAsUTF8(lpSection, dwSectionNameSize);
-        file.Write("]\r\n", 3);
-        file.WriteAsUTF8(lpKey, dwKeyNameSize);
-        file.Write("=", 1);
-        file.WriteAsUTF8(newvalue, slen(newvalue));
-        file.Write("\r\n", 2);
-        file.Close();
+        String strNewSection;
+        strNewSection << TEXT("\r\n[") << lpSection << TEXT("]\r\n") << strNewLine;
 
-        if(LoadFile(XFILE_OPENEXISTING))
-            LoadData();
+        if(SpliceFileData(lpEnd-2, lpEnd-2, strNewSection))
+            InsertKeyData(lpSection, lpKey, newvalue);
         return;
     }
 
     do
     {
         if(*lpTemp == '[')
-        {
-            XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-            file.Write("\xEF\xBB\xBF", 3);
-            file.WriteAsUTF8(&lpFileData[2], DWORD(lpSectionStart-lpFileData-2));
-            file.WriteAsUTF8(lpKey, dwKeyNameSize);
-            file.Write("=", 1);
-            file.WriteAsUTF8(newvalue, slen(newvalue));
-            file.Write("\r\n", 2);
-            file.WriteAsUTF8(lpSectionStart, slen(lpSectionStart)-2);
-            file.Close();
-
-            if(LoadFile(XFILE_OPENEXISTING))
-                LoadData();
-            return;
-        }
+            break;
         else if(*(LPWORD)lpTemp == '//')
         {
             lpTemp = schr(lpTemp, '\n')+1;
@@ -848,28 +881,14 @@ void  ConfigFile::SetKey(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue)
                 if ((*lpTemp == '\r' && *newvalue == '\0') || (lpNextLine - lpTemp == newlen && !scmp_n(lpTemp, newvalue, newlen)))
                     return;
 
-                String tmpFileName = strFileName;
-                tmpFileName += TEXT(".tmp");
+                //an empty value was never loaded, and an emptied one drops out, so those change more than the one value
+                BOOL bSameValueCount = (*lpTemp != '\r' && *newvalue != '\0');
 
-                XFile file;
-                if (file.Open(tmpFileName, XFILE_WRITE, XFILE_CREATEALWAYS))
+                if(SpliceFileData(lpTemp, lpNextLine, newvalue))
                 {
-                    if (file.Write("\xEF\xBB\xBF", 3) != 3)
-                        return;
-                    if (!file.WriteAsUTF8(&lpFileData[2], DWORD(lpTemp - lpFileData - 2)))
-                        return;
-                    if (!file.WriteAsUTF8(newvalue, slen(newvalue)))
-                        return;
-                    if (!file.WriteAsUTF8(lpNextLine, slen(lpNextLine) - 2))
-                        return;
-
-                    file.Close();
-                    if (!OSRenameFile(tmpFileName, strFileName))
-                        Log(TEXT("ConfigFile::SetKey: Unable to move new config file %s to %s"), tmpFileName.Array(), strFileName.Array());
+                    if(!bSameValueCount || !ReplaceKeyData(lpSection, lpKey, newvalue))
+                        ReloadData();
                 }
-
-                if(LoadFile(XFILE_OPENEXISTING))
-                    LoadData();
                 return;
             }
         }
@@ -877,18 +896,8 @@ void  ConfigFile::SetKey(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue)
         lpTemp = schr(lpTemp, '\n')+1;
     }while(lpTemp < lpEnd);
 
-    XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-    file.Write("\xEF\xBB\xBF", 3);
-    file.WriteAsUTF8(&lpFileData[2], DWORD(lpSectionStart-lpFileData-2));
-    file.WriteAsUTF8(lpKey, dwKeyNameSize);
-    file.Write("=", 1);
-    file.WriteAsUTF8(newvalue, slen(newvalue));
-    file.Write("\r\n", 2);
-    file.WriteAsUTF8(lpSectionStart, slen(lpSectionStart)-2);
-    file.Close();
-
-    if(LoadFile(XFILE_OPENEXISTING))
-        LoadData();
+    if(SpliceFileData(lpSectionStart, lpSectionStart, strNewLine))
+        InsertKeyData(lpSection, lpKey, newvalue);
 }
 
 void  ConfigFile::Remove(CTSTR lpSection, CTSTR lpKey)
@@ -926,14 +935,10 @@ void  ConfigFile::Remove(CTSTR lpSection, CTSTR lpKey)
             if((scmpi_n(lpTemp, lpKey, dwKeyNameSize) == 0) && (lpTemp[dwKeyNameSize] == '='))
             {
                 TSTR lpNextLine = schr(lpTemp, '\n')+1;
-                XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-                file.Write("\xEF\xBB\xBF", 3);
-                file.WriteAsUTF8(&lpFileData[2], DWORD(lpTemp-lpFileData-2));
-                file.WriteAsUTF8(lpNextLine, slen(lpNextLine)-2);
-                file.Close();
-
-                if(LoadFile(XFILE_OPENEXISTING))
-                    LoadData();
+
+                //removing a key shifts the ones after it, which the index refers to by position
+                if(SpliceFileData(lpTemp, lpNextLine, NULL))
+                    ReloadData();
                 return;
             }
         }
@@ -965,45 +970,26 @@ void  ConfigFile::AddKey(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue)
         }
     }while(lpTemp < lpEnd);
 
+    String strNewLine;
+    strNewLine << lpKey << TEXT("=") << newvalue << TEXT("\r\n");
+
     if(!bInSection)
     {
-        XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-        file.Write("\xEF\xBB\xBF", 3);
-        file.WriteAsUTF8(&lpFileData[2], dwLength-4);
-        file.Write("\r\n[", 3);
-        file.WriteAsUTF8(lpSection, dwSectionNameSize);
-        file.Write("]\r\n", 3);
-        file.WriteAsUTF8(lpKey, dwKeyNameSize);
-        file.Write("=", 1);
-        file.WriteAsUTF8(newvalue, slen(newvalue));
-        file.Write("\r\n", 2);
-        file.Close();
+        String strNewSection;
+        strNewSection << TEXT("\r\n[") << lpSection << TEXT("]\r\n") << strNewLine;
 
-        if(LoadFile(XFILE_OPENEXISTING))
-            LoadData();
+        if(SpliceFileData(lpEnd-2, lpEnd-2, strNewSection))
+            InsertKeyData(lpSection, lpKey, newvalue);
         return;
     }
 
     TSTR lpLastItem = NULL;
+    TSTR lpInsert = lpSectionStart;
 
     do
     {
         if(*lpTemp == '[')
-        {
-            XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-            file.Write("\xEF\xBB\xBF", 3);
-            file.WriteAsUTF8(&lpFileData[2], DWORD(lpSectionStart-lpFileData-2));
-            file.WriteAsUTF8(lpKey, dwKeyNameSize);
-            file.Write("=", 1);
-            file.WriteAsUTF8(newvalue, slen(newvalue));
-            file.Write("\r\n", 2);
-            file.WriteAsUTF8(lpSectionStart, slen(lpSectionStart)-2);
-            file.Close();
-
-            if(LoadFile(XFILE_OPENEXISTING))
-                LoadData();
-            return;
-        }
+            break;
         else if(*(LPWORD)lpTemp == '//')
         {
             lpTemp = schr(lpTemp, '\n')+1;
@@ -1017,36 +1003,137 @@ void  ConfigFile::AddKey(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue)
             }
             else if(lpLastItem)
             {
-                lpTemp = lpLastItem;
-                XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-                file.Write("\xEF\xBB\xBF", 3);
-                file.WriteAsUTF8(&lpFileData[2], DWORD(lpTemp-lpFileData-2));
-                file.WriteAsUTF8(lpKey, dwKeyNameSize);
-                file.Write("=", 1);
-                file.WriteAsUTF8(newvalue, slen(newvalue));
-                file.Write("\r\n", 2);
-                file.WriteAsUTF8(lpTemp, slen(lpTemp)-2);
-                file.Close();
-
-                if(LoadFile(XFILE_OPENEXISTING))
-                    LoadData();
-                return;
+                lpInsert = lpLastItem;
+                break;
             }
         }
 
         lpTemp = schr(lpTemp, '\n')+1;
     }while(lpTemp < lpEnd);
 
-    XFile file(strFileName, XFILE_WRITE, XFILE_CREATEALWAYS);
-    file.Write("\xEF\xBB\xBF", 3);
-    file.WriteAsUTF8(&lpFileData[2], DWORD(lpSectionStart-lpFileData-2));
-    file.WriteAsUTF8(lpKey, dwKeyNameSize);
-    file.Write("=", 1);
-    file.WriteAsUTF8(newvalue, slen(newvalue));
-    file.Write("\r\n", 2);
-    file.WriteAsUTF8(lpSectionStart, slen(lpSectionStart)-2);
+    if(SpliceFileData(lpInsert, lpInsert, strNewLine))
+        InsertKeyData(lpSection, lpKey, newvalue);
+}
+
+//-------------------------------------------
+// changes are made to the file data in memory and written out from there, and the parsed sections and
+// the index are patched to match rather than reloading and reparsing everything on every change
+
+BOOL ConfigFile::SpliceFileData(TSTR lpStart, TSTR lpEnd, CTSTR lpText)
+{
+    DWORD dwStart = DWORD(lpStart-lpFileData);
+    DWORD dwRemoved = DWORD(lpEnd-lpStart);
+    DWORD dwTextLength = lpText ? slen(lpText) : 0;
+    DWORD dwNewLength = dwLength-dwRemoved+dwTextLength;
+
+    TSTR lpNewData = (TSTR)Allocate((dwNewLength+1)*sizeof(TCHAR));
+    mcpy(lpNewData, lpFileData, dwStart*sizeof(TCHAR));
+    if(dwTextLength)
+        mcpy(lpNewData+dwStart, lpText, dwTextLength*sizeof(TCHAR));
+    mcpy(lpNewData+dwStart+dwTextLength, lpEnd, (dwLength-dwStart-dwRemoved+1)*sizeof(TCHAR));
+
+    String tmpFileName = strFileName;
+    tmpFileName += TEXT(".tmp");
+
+    XFile file;
+    if(!file.Open(tmpFileName, XFILE_WRITE, XFILE_CREATEALWAYS))
+    {
+        Free(lpNewData);
+        return FALSE;
+    }
+
+    //the data is wrapped in a line break on either side, which isn't part of the file
+    if(file.Write("\xEF\xBB\xBF", 3) != 3 || !file.WriteAsUTF8(&lpNewData[2], dwNewLength-4))
+    {
+        file.Close();
+        Free(lpNewData);
+        return FALSE;
+    }
+
     file.Close();
+    if(!OSRenameFile(tmpFileName, strFileName))
+    {
+        Log(TEXT("ConfigFile: Unable to move new config file %s to %s"), tmpFileName.Array(), strFileName.Array());
+        Free(lpNewData);
+        return FALSE;
+    }
 
-    if(LoadFile(XFILE_OPENEXISTING))
-        LoadData();
+    Free(lpFileData);
+    lpFileData = lpNewData;
+    dwLength = dwNewLength;
+
+    return TRUE;
+}
+
+void ConfigFile::ReloadData()
+{
+    FreeSections();
+    LoadData();
+}
+
+UINT ConfigFile::FindSection(CTSTR lpSection)
+{
+    for(UINT i=0; i<Sections.Num(); i++)
+    {
+        if(scmpi(lpSection, Sections[i].name) == 0)
+            return i;
+    }
+
+    return INVALID;
+}
+
+//the value of a key that's already loaded changed, the file changes the first section of that name
+BOOL ConfigFile::ReplaceKeyData(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue)
+{
+    ConfigIndexSlot *slot = FindSlot(lpSection, lpKey, HashConfigKey(lpSection, lpKey));
+    if(!slot->key || slot->section != FindSection(lpSection))
+        return FALSE;
+
+    ConfigKey &key = Sections[slot->section].Keys[slot->key-1];
+    Free(key.ValueList[0]);
+    key.ValueList[0] = sfix(sdup(newvalue));
+    key.intState = key.floatState = 0;
+
+    return TRUE;
+}
+
+//a line was added for a key, to the first section of that name or to a new section at the end
+void ConfigFile::InsertKeyData(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue)
+{
+    UINT sectionID = FindSection(lpSection);
+    if(sectionID == INVALID)
+    {
+        sectionID = Sections.Num();
+        Sections.CreateNew()->name = sfix(sdup(lpSection));
+    }
+
+    //same as LoadData, keys without a value aren't loaded
+    if(!*newvalue)
+        return;
+
+    UINT hash = HashConfigKey(lpSection, lpKey);
+    ConfigIndexSlot *slot = FindSlot(lpSection, lpKey, hash);
+
+    //another value for a key that's already there, or one that now takes over from a later section of the
+    //same name.  where it lands among the values depends on the lines around it, so just parse it again
+    if(slot->key)
+    {
+        ReloadData();
+        return;
+    }
+
+    ConfigSection &section = Sections[sectionID];
+    ConfigKey *key = section.Keys.CreateNew();
+    key->name = sfix(sdup(lpKey));
+    key->ValueList << sfix(sdup(newvalue));
+
+    if((numIndexKeys+1)*2 > Index.Num())
+        BuildIndex();
+    else
+    {
+        slot->hash = hash;
+        slot->section = sectionID;
+        slot->key = section.Keys.Num();
+        numIndexKeys++;
+    }
 }
@@ -27,6 +27,12 @@ struct ConfigKey
 {
     TSTR name;
     List<TSTR> ValueList;
+
+    //parsed forms of ValueList[0], filled in on first use.  the state is only set once the value is stored,
+    //so a reader that sees it also sees the value
+    int intValue;
+    float floatValue;
+    volatile BYTE intState, floatState;
 };
 
 struct ConfigSection
@@ -35,11 +41,20 @@ struct ConfigSection
     List<ConfigKey> Keys;
 };
 
+//one slot of the open addressed section+key index.  sections and keys are referred to by position, since
+//adding to their lists moves them.  key is the position+1, 0 for empty slots
+struct ConfigIndexSlot
+{
+    UINT hash;
+    UINT section;
+    UINT key;
+};
+
 
 class BASE_EXPORT ConfigFile
 {
 public:
-    ConfigFile() : bOpen(0), strFileName(), lpFileData(NULL), dwLength(0) {}
+    ConfigFile() : bOpen(0), strFileName(), lpFileData(NULL), dwLength(0), numIndexKeys(0) {}
     ~ConfigFile() {Close();}
 
     BOOL  Create(CTSTR lpConfigFile);
@@ -99,7 +114,21 @@ private:
     void  SetKey(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue);
     void  AddKey(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue);
 
+    void  FreeSections();
+    void  ReloadData();
+
+    void  BuildIndex();
+    ConfigIndexSlot* FindSlot(CTSTR lpSection, CTSTR lpKey, UINT hash);
+    ConfigKey* FindKey(CTSTR lpSection, CTSTR lpKey);
+    UINT  FindSection(CTSTR lpSection);
+
+    BOOL  SpliceFileData(TSTR lpStart, TSTR lpEnd, CTSTR lpText);
+    BOOL  ReplaceKeyData(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue);
+    void  InsertKeyData(CTSTR lpSection, CTSTR lpKey, CTSTR newvalue);
+
     List<ConfigSection> Sections;
+    List<ConfigIndexSlot> Index;
+    UINT numIndexKeys;
 
     BOOL  bOpen;
     String strFileName;
@@ -34,6 +34,173 @@ float minPercentage, minTime;
 HANDLE hProfilerMutex = NULL;
 
 
+//-----------------------------------------
+// Each thread records into its own block of fixed slots, one per (parent, name) pair, so the
+// recording path never locks or allocates.  The owning thread is the only writer; dumps read the
+// counters of every thread directly and merge them into a report tree, so a dump taken while other
+// threads are still running may be off by the call in flight.
+
+#define PROFILE_NO_SLOT             0xFFFFFFFF
+#define PROFILE_MAX_SLOTS           128
+#define PROFILE_LOOKUP_SIZE         256     //power of 2, at least twice PROFILE_MAX_SLOTS
+
+// log-linear latency histogram of microsecond times: exact below 8us, then 8 buckets per power of 2,
+// which keeps every bucket within 12.5% of its value and covers the whole DWORD range
+#define PROFILE_HISTOGRAM_BUCKETS   240
+
+inline UINT ProfileHistogramBucket(DWORD microseconds)
+{
+    if(microseconds < 8)
+        return microseconds;
+
+    DWORD topBit;
+    _BitScanReverse(&topBit, microseconds);
+    return (topBit-2)*8 + ((microseconds >> (topBit-3)) & 7);
+}
+
+inline DWORD ProfileBucketValue(UINT bucket)
+{
+    if(bucket < 8)
+        return bucket;
+
+    UINT shift = bucket/8 - 1;
+    QWORD low = QWORD(8 + (bucket&7)) << shift;
+    return DWORD(low + ((QWORD(1) << shift) >> 1)); //middle of the bucket
+}
+
+struct ProfileThreadData;
+
+struct ProfileSlot
+{
+    ProfileThreadData *threadData;
+    UINT id;
+
+    CTSTR lpName;
+    UINT parent;
+    bool bSingular;
+
+    //links are only appended to after the slot is filled in, so a dump can walk them while the owner records
+    volatile UINT firstChild, nextSibling;
+    UINT lastChild;
+
+    DWORD numCalls;
+    DWORD numParallelCalls;
+    DWORD numCpuCalls;
+    DWORD lastCall;
+
+    QWORD totalTimeElapsed,
+          lastTimeElapsed,
+          cpuTimeElapsed,
+          lastCpuTimeElapsed;
+    DWORD maxTimeElapsed;
+
+    DWORD histogram[PROFILE_HISTOGRAM_BUCKETS];
+};
+
+struct ProfileThreadData
+{
+    DWORD threadID;
+    DWORD curRootCall;
+    bool bOverflowed;
+
+    UINT numSlots;
+    volatile UINT firstRoot;
+    UINT lastRoot;
+
+    UINT lookup[PROFILE_LOOKUP_SIZE]; //slot ID + 1, 0 if empty.  only touched by the owning thread
+    ProfileSlot slots[PROFILE_MAX_SLOTS];
+
+    inline static UINT HashSlot(UINT parent, CTSTR lpName)
+    {
+        return (UINT(UPARAM(lpName) >> 1) ^ (parent*2654435761U)) & (PROFILE_LOOKUP_SIZE-1);
+    }
+
+    UINT GetSlot(UINT parent, CTSTR lpName, bool bSingular)
+    {
+        UINT pos = HashSlot(parent, lpName);
+        while(lookup[pos])
+        {
+            UINT id = lookup[pos]-1;
+            if(slots[id].lpName == lpName && slots[id].parent == parent)
+                return id;
+
+            pos = (pos+1) & (PROFILE_LOOKUP_SIZE-1);
+        }
+
+        if(numSlots == PROFILE_MAX_SLOTS)
+        {
+            bOverflowed = true;
+            return PROFILE_NO_SLOT;
+        }
+
+        UINT id = numSlots++;
+        ProfileSlot &slot = slots[id];
+        slot.threadData = this;
+        slot.id = id;
+        slot.lpName = lpName;
+        slot.parent = parent;
+        slot.bSingular = bSingular;
+        slot.firstChild = slot.nextSibling = slot.lastChild = PROFILE_NO_SLOT;
+
+        if(parent == PROFILE_NO_SLOT)
+        {
+            if(lastRoot == PROFILE_NO_SLOT) firstRoot = id;
+            else                            slots[lastRoot].nextSibling = id;
+            lastRoot = id;
+        }
+        else
+        {
+            ProfileSlot &parentSlot = slots[parent];
+            if(parentSlot.lastChild == PROFILE_NO_SLOT) parentSlot.firstChild = id;
+            else                                        slots[parentSlot.lastChild].nextSibling = id;
+            parentSlot.lastChild = id;
+        }
+
+        lookup[pos] = id+1;
+        return id;
+    }
+};
+
+static __declspec(thread) ProfileThreadData *curThreadData = NULL;
+static __declspec(thread) UINT curThreadGeneration = 0;
+
+static List<ProfileThreadData*> profileThreads;
+static volatile UINT profileGeneration = 1;
+
+//blocks taken out of the report by FreeProfileData.  a block can only be freed once nothing can be
+//recording into it:  either its thread has exited, or its thread has started a new root segment
+//(no segment of that thread is open then) and moved on to a new block
+static List<ProfileThreadData*> retiredProfileThreads;
+
+static ProfileThreadData* GetProfileThreadData()
+{
+    if(curThreadData && curThreadGeneration == profileGeneration)
+        return curThreadData;
+
+    ProfileThreadData *data = (ProfileThreadData*)Allocate(sizeof(ProfileThreadData));
+    zero(data, sizeof(ProfileThreadData));
+    data->threadID = OSGetCurrentThreadID();
+    data->firstRoot = data->lastRoot = PROFILE_NO_SLOT;
+
+    OSEnterMutex(hProfilerMutex);
+    if(curThreadData)
+    {
+        UINT retiredID = retiredProfileThreads.FindValueIndex(curThreadData);
+        if(retiredID != INVALID)
+        {
+            Free(curThreadData);
+            retiredProfileThreads.Remove(retiredID);
+        }
+    }
+
+    profileThreads << data;
+    curThreadGeneration = profileGeneration;
+    OSLeaveMutex(hProfilerMutex);
+
+    curThreadData = data;
+    return data;
+}
+
 struct BASE_EXPORT ProfileNodeInfo
 {
     ~ProfileNodeInfo()
@@ -52,6 +219,7 @@ struct BASE_EXPORT ProfileNodeInfo
 
     DWORD numCalls;
     DWORD numParallelCalls;
+    DWORD numCpuCalls;
     DWORD avgTimeElapsed;
     DWORD avgCpuTime;
     double avgPercentage;
@@ -64,16 +232,34 @@ struct BASE_EXPORT ProfileNodeInfo
           lastTimeElapsed,
           cpuTimeElapsed,
           lastCpuTimeElapsed;
+    DWORD maxTimeElapsed;
 
     DWORD lastCall;
 
+    DWORD histogram[PROFILE_HISTOGRAM_BUCKETS];
+
     ProfileNodeInfo *parent;
     List<ProfileNodeInfo> Children;
 
+    DWORD GetPercentile(double percentile) const
+    {
+        DWORD target = (DWORD)ceil(double(numCalls)*percentile);
+        DWORD count = 0;
+
+        for(UINT i=0; i<PROFILE_HISTOGRAM_BUCKETS; i++)
+        {
+            count += histogram[i];
+            if(count >= target && count)
+                return MIN(ProfileBucketValue(i), maxTimeElapsed);
+        }
+
+        return maxTimeElapsed;
+    }
+
     void calculateProfileData(int rootCallCount)
     {
         avgTimeElapsed = (DWORD)(totalTimeElapsed/(QWORD)numCalls);
-        avgCpuTime = (DWORD)(cpuTimeElapsed/(QWORD)numCalls);
+        avgCpuTime = numCpuCalls ? (DWORD)(cpuTimeElapsed/(QWORD)numCpuCalls) : 0;
 
 
         if(parent)  avgPercentage = (double(avgTimeElapsed)/double(parent->avgTimeElapsed))*parent->avgPercentage;
@@ -110,18 +296,19 @@ struct BASE_EXPORT ProfileNodeInfo
 
         CTSTR lpIndent = indent == 0 ? TEXT("") : indentStr.Array();
 
-        int perFrameCalls = (int)floor(numCalls/(double)rootCallCount+0.5);
-
         float fTimeTaken = (float)MicroToMS(avgTimeElapsed);
-        float cpuTime = (float)MicroToMS(avgCpuTime);
-        float totalCpuTime = (float)cpuTimeElapsed*0.001f;
 
         if(avgPercentage >= minPercentage && fTimeTaken >= minTime)
         {
+            float p50 = (float)MicroToMS(GetPercentile(0.50)),
+                  p95 = (float)MicroToMS(GetPercentile(0.95)),
+                  p99 = (float)MicroToMS(GetPercentile(0.99)),
+                  fMax = (float)MicroToMS(maxTimeElapsed);
+
             if(Children.Num())
-                Log(TEXT("%s%s - [%.3g%%] [avg time: %g ms] [children: %.3g%%] [unaccounted: %.3g%%]"), lpIndent, lpName, avgPercentage, fTimeTaken, childPercentage, unaccountedPercentage);
+                Log(TEXT("%s%s - [%.3g%%] [avg time: %g ms] [p50: %g ms, p95: %g ms, p99: %g ms, max: %g ms] [children: %.3g%%] [unaccounted: %.3g%%]"), lpIndent, lpName, avgPercentage, fTimeTaken, p50, p95, p99, fMax, childPercentage, unaccountedPercentage);
             else
-                Log(TEXT("%s%s - [%.3g%%] [avg time: %g ms]"), lpIndent, lpName, avgPercentage, fTimeTaken);
+                Log(TEXT("%s%s - [%.3g%%] [avg time: %g ms] [p50: %g ms, p95: %g ms, p99: %g ms, max: %g ms]"), lpIndent, lpName, avgPercentage, fTimeTaken, p50, p95, p99, fMax);
         }
 
         for(unsigned int i=0; i<Children.Num(); i++)
@@ -150,10 +337,11 @@ struct BASE_EXPORT ProfileNodeInfo
 
         if(avgPercentage >= minPercentage && fTimeTaken >= minTime)
         {
-            if(Children.Num())
+            //thread time is only sampled for roots and segments that call MonitorThread
+            if(numCpuCalls)
                 Log(TEXT("%s%s - [cpu time: avg %g ms, total %g ms] [avg calls per frame: %d]"), lpIndent, lpName, cpuTime, totalCpuTime, perFrameCalls);
             else
-                Log(TEXT("%s%s - [cpu time: avg %g ms, total %g ms] [avg calls per frame: %d]"), lpIndent, lpName, cpuTime, totalCpuTime, perFrameCalls);
+                Log(TEXT("%s%s - [avg calls per frame: %d]"), lpIndent, lpName, perFrameCalls);
         }
 
         for(unsigned int i=0; i<Children.Num(); i++)
@@ -171,7 +359,10 @@ struct BASE_EXPORT ProfileNodeInfo
 
         CTSTR lpIndent = indent == 0 ? TEXT("") : indentStr.Array();
 
-        Log(TEXT("%s%s - [time: %g ms (cpu time: %g ms)]"), lpIndent, lpName, MicroToMS((DWORD)lastTimeElapsed), MicroToMS((DWORD)lastCpuTimeElapsed));
+        if(numCpuCalls)
+            Log(TEXT("%s%s - [time: %g ms (cpu time: %g ms)]"), lpIndent, lpName, MicroToMS((DWORD)lastTimeElapsed), MicroToMS((DWORD)lastCpuTimeElapsed));
+        else
+            Log(TEXT("%s%s - [time: %g ms]"), lpIndent, lpName, MicroToMS((DWORD)lastTimeElapsed));
 
         for(unsigned int i=0; i<Children.Num(); i++)
             Children[i].dumpLastData(callNum, indent+1);
@@ -199,42 +390,82 @@ struct BASE_EXPORT ProfileNodeInfo
         return NULL;
     }
 
-    static void MergeProfileInfo(ProfileNodeInfo &info)
+    //builds profilerData from the slots of every thread.  recording threads are never blocked, the
+    //mutex only keeps the thread list stable against a thread registering its first segment
+    static void BuildReport()
     {
+        FreeReport();
+
         OSEnterMutex(hProfilerMutex);
-        ProfileNodeInfo *sum = FindProfile(info.lpName);
-        if(!sum)
+        for(UINT i=0; i<profileThreads.Num(); i++)
         {
-            sum = profilerData.CreateNew();
-            sum->lpName = info.lpName;
+            ProfileThreadData *data = profileThreads[i];
+            if(data->bOverflowed)
+                Log(TEXT("Profiler: thread %u ran out of profile slots, some segments were not recorded"), data->threadID);
+
+            for(UINT id = data->firstRoot; id != PROFILE_NO_SLOT; id = data->slots[id].nextSibling)
+            {
+                ProfileSlot &slot = data->slots[id];
+                if(!slot.numCalls)
+                    continue;
+
+                ProfileNodeInfo *sum = FindProfile(slot.lpName);
+                if(!sum)
+                {
+                    sum = profilerData.CreateNew();
+                    sum->lpName = slot.lpName;
+                }
+
+                //offset the call numbers so that the last frame of the last thread merged stays consistent
+                sum->MergeSlot(data, slot, sum->numCalls);
+            }
         }
-        sum->MergeProfileInfo(&info, info.lastCall, sum->lastCall + info.lastCall);
         OSLeaveMutex(hProfilerMutex);
     }
 
-    void MergeProfileInfo(ProfileNodeInfo *info, DWORD rootLastCall, DWORD updatedLastCall)
+    void MergeSlot(ProfileThreadData *data, ProfileSlot &slot, DWORD callOffset)
     {
-        bSingular = info->bSingular;
-        numCalls += info->numCalls;
-        if(lastCall == rootLastCall) lastCall = updatedLastCall;
-        totalTimeElapsed += info->totalTimeElapsed;
-        lastTimeElapsed = info->lastTimeElapsed;
-        cpuTimeElapsed += info->cpuTimeElapsed;
-        lastCpuTimeElapsed = info->lastCpuTimeElapsed;
-        numParallelCalls = info->numParallelCalls;
-        for(UINT i = 0; i < info->Children.Num(); i++)
+        bSingular = slot.bSingular;
+        numCalls += slot.numCalls;
+        lastCall = callOffset + slot.lastCall;
+        totalTimeElapsed += slot.totalTimeElapsed;
+        lastTimeElapsed = slot.lastTimeElapsed;
+        cpuTimeElapsed += slot.cpuTimeElapsed;
+        lastCpuTimeElapsed = slot.lastCpuTimeElapsed;
+        numCpuCalls += slot.numCpuCalls;
+        maxTimeElapsed = MAX(maxTimeElapsed, slot.maxTimeElapsed);
+
+        if(slot.numParallelCalls)
+            numParallelCalls = slot.numParallelCalls;
+        else if(!numParallelCalls)
+            numParallelCalls = 1;
+
+        for(UINT i=0; i<PROFILE_HISTOGRAM_BUCKETS; i++)
+            histogram[i] += slot.histogram[i];
+
+        for(UINT id = slot.firstChild; id != PROFILE_NO_SLOT; id = data->slots[id].nextSibling)
         {
-            ProfileNodeInfo &child = info->Children[i];
+            ProfileSlot &child = data->slots[id];
+            if(!child.numCalls)
+                continue;
+
             ProfileNodeInfo *sumChild = FindSubProfile(child.lpName);
             if(!sumChild)
             {
                 sumChild = Children.CreateNew();
                 sumChild->lpName = child.lpName;
             }
-            sumChild->MergeProfileInfo(&child, rootLastCall, updatedLastCall);
+            sumChild->MergeSlot(data, child, callOffset);
         }
     }
 
+    static void FreeReport()
+    {
+        for(unsigned int i=0; i<profilerData.Num(); i++)
+            profilerData[i].FreeData();
+        profilerData.Clear();
+    }
+
     static List<ProfileNodeInfo> profilerData;
 };
 
@@ -255,6 +486,8 @@ void STDCALL EnableProfiling(BOOL bEnable, float pminPercentage, float pminTime)
 
 void STDCALL DumpProfileData()
 {
+    ProfileNodeInfo::BuildReport();
+
     if(ProfileNodeInfo::profilerData.Num())
     {
         Log(TEXT("\r\nProfiler time results:\r\n"));
@@ -268,10 +501,14 @@ void STDCALL DumpProfileData()
             ProfileNodeInfo::profilerData[i].dumpCPUData(ProfileNodeInfo::profilerData[i].numCalls);
         Log(TEXT("==============================================================\r\n"));
     }
+
+    ProfileNodeInfo::FreeReport();
 }
 
 void STDCALL DumpLastProfileData()
 {
+    ProfileNodeInfo::BuildReport();
+
     if(ProfileNodeInfo::profilerData.Num())
     {
         Log(TEXT("\r\nProfiler result for the last frame:"));
@@ -280,17 +517,40 @@ void STDCALL DumpLastProfileData()
             ProfileNodeInfo::profilerData[i].dumpLastData(ProfileNodeInfo::profilerData[i].lastCall);
         Log(TEXT("==============================================================\r\n"));
     }
+
+    ProfileNodeInfo::FreeReport();
 }
 
+//starts the next report from scratch.  threads that are still running may be inside a segment, so
+//their blocks are only retired here and freed once it's safe (see retiredProfileThreads)
 void STDCALL FreeProfileData()
 {
-    for(unsigned int i=0; i<ProfileNodeInfo::profilerData.Num(); i++)
-        ProfileNodeInfo::profilerData[i].FreeData();
-    ProfileNodeInfo::profilerData.Clear();
+    ProfileNodeInfo::FreeReport();
+
+    OSEnterMutex(hProfilerMutex);
+    retiredProfileThreads.AppendList(profileThreads);
+    profileThreads.Clear();
+    ++profileGeneration;
+
+    for(UINT i=0; i<retiredProfileThreads.Num(); i++)
+    {
+        if(!OSIsThreadRunning(retiredProfileThreads[i]->threadID))
+        {
+            Free(retiredProfileThreads[i]);
+            retiredProfileThreads.Remove(i--);
+        }
+    }
+    OSLeaveMutex(hProfilerMutex);
 }
 
-ProfilerNode::ProfilerNode(CTSTR lpName, bool bSingularize) : lpName(nullptr), parent(nullptr), info(nullptr)
+ProfilerNode::ProfilerNode(CTSTR lpName, bool bSingularize) : lpName(lpName), thread(nullptr), parent(nullptr), bTimelineEvent(false), slot(nullptr)
 {
+    if(bTimelineEnabled)
+    {
+        bTimelineEvent = true;
+        AddTimelineEvent(lpName, 'B');
+    }
+
     parent = __curProfilerNode;
 
     if(bSingularNode = bSingularize)
@@ -304,74 +564,70 @@ ProfilerNode::ProfilerNode(CTSTR lpName, bool bSingularize) : lpName(nullptr), p
     else
         __curProfilerNode = this;
 
+    ProfileThreadData *threadData;
+    UINT slotID;
+
     if(parent)
     {
-        if(!parent->lpName) return; //profiling was disabled when parent was created, so exit to avoid inconsistent results
-        ProfileNodeInfo *parentInfo = parent->info;
-        if(parentInfo)
-        {
-            info = parentInfo->FindSubProfile(lpName);
-            if(!info)
-            {
-                info = parentInfo->Children.CreateNew();
-                info->lpName = lpName;
-                info->bSingular = bSingularNode;
-            }
-        }
+        if(!parent->slot) return; //profiling was disabled when parent was created, so exit to avoid inconsistent results
+        threadData = parent->slot->threadData;
+        slotID = threadData->GetSlot(parent->slot->id, lpName, bSingularNode);
     }
     else if(bProfilingEnabled)
     {
-        info = new ProfileNodeInfo;
-        info->lpName = lpName;
+        threadData = GetProfileThreadData();
+        slotID = threadData->GetSlot(PROFILE_NO_SLOT, lpName, false);
     }
     else
         return;
 
-    if (info)
-    {
-        ++info->numCalls;
-        if(!parent)
-            info->lastCall = info->numCalls;
-        else
-            info->lastCall = parent->info->numCalls;
-    }
+    if(slotID == PROFILE_NO_SLOT)
+        return;
 
-    this->lpName = lpName;
+    slot = threadData->slots+slotID;
+
+    ++slot->numCalls;
+    if(!parent)
+        threadData->curRootCall = slot->numCalls;
+    slot->lastCall = threadData->curRootCall;
 
     startTime = OSGetTimeMicroseconds();
 
-    MonitorThread(OSGetCurrentThread());
+    //thread time is a kernel call, so only roots get it unless a segment asks with MonitorThread
+    if(!parent)
+        MonitorThread(OSGetCurrentThread());
 
     parallelCalls = 1;
 }
 
 ProfilerNode::~ProfilerNode()
 {
+    if(bTimelineEvent)
+        AddTimelineEvent(lpName, 'E');
+
     //profiling was diabled when created
-    if(lpName)
+    if(slot)
     {
         QWORD newTime = OSGetTimeMicroseconds();
 
         DWORD curTime = (DWORD)(newTime-startTime);
-        info->totalTimeElapsed += curTime;
-        info->lastTimeElapsed = curTime;
+        slot->totalTimeElapsed += curTime;
+        slot->lastTimeElapsed = curTime;
+        if(curTime > slot->maxTimeElapsed)
+            slot->maxTimeElapsed = curTime;
+        ++slot->histogram[ProfileHistogramBucket(curTime)];
         if(thread)
         {
             DWORD cpuTime = DWORD(OSGetThreadTime(thread) - cpuStartTime);
-            info->cpuTimeElapsed += cpuTime;
-            info->lastCpuTimeElapsed = cpuTime;
+            slot->cpuTimeElapsed += cpuTime;
+            slot->lastCpuTimeElapsed = cpuTime;
+            ++slot->numCpuCalls;
         }
-        info->numParallelCalls = parallelCalls;
+        slot->numParallelCalls = parallelCalls;
     }
 
     if(!bSingularNode)
         __curProfilerNode = parent;
-
-    if(!parent && info)
-    {
-        ProfileNodeInfo::MergeProfileInfo(*info);
-        delete info;
-    }
 }
 
 void ProfilerNode::MonitorThread(HANDLE thread_)
@@ -386,3 +642,362 @@ void ProfilerNode::SetParallelCallCount(DWORD num)
 {
     parallelCalls = num;
 }
+
+
+//-----------------------------------------
+// Timeline events from all threads go into one ring.  Writers claim an index with an interlocked
+// increment and publish the event by writing its sequence number last; DumpTimeline copies the ring
+// without stopping anyone and drops events that were being overwritten while it read them.
+// One shared ring is used rather than one per thread because the capture/encode/network threads
+// are recreated every time a stream starts, and a per-thread ring would have to outlive its thread.
+
+struct TimelineRecord
+{
+    volatile UINT seq;      //index+1 once the event is complete, 0 while it's being written
+    DWORD threadID;
+    CTSTR lpName;
+    QWORD time;             //performance counter ticks
+    char type;
+};
+
+struct TimelineThreadName
+{
+    DWORD threadID;
+    String strName;
+};
+
+BOOL bTimelineEnabled = FALSE;
+
+static TimelineRecord *timelineEvents = NULL;
+static UINT timelineMask = 0;
+static volatile long timelineWritePos = 0;
+static volatile BOOL bTimelineFilled = FALSE;
+
+static List<TimelineThreadName> timelineThreadNames;
+static String strTimelineDumpFolder;
+static volatile long bTimelineDumping = 0;
+static DWORD lastTimelineDumpTime = 0;
+static HANDLE hTimelineDumpThread = NULL;
+
+#define TIMELINE_DUMP_INTERVAL 60000 //don't write more than one stall dump a minute
+
+//event names are usually literals in whichever module recorded them, and that module may be unloaded
+//before the timeline is written, so events point at a copy kept here instead.  copies are found by the
+//caller's pointer and checked against the text, since a reloaded module can put another name at the
+//same address.  they're only added to (under hProfilerMutex) and freed by FreeTimeline.
+#define TIMELINE_NAME_BITS 10
+
+struct TimelineName
+{
+    CTSTR volatile lpKey;   //set last, once lpName is filled in
+    TSTR lpName;
+};
+
+static TimelineName timelineNames[1 << TIMELINE_NAME_BITS];
+
+static CTSTR GetTimelineName(CTSTR lpName)
+{
+    const UINT mask = (1 << TIMELINE_NAME_BITS)-1;
+    UINT start = (UINT(UPARAM(lpName) >> 1) * 2654435761U) >> (32-TIMELINE_NAME_BITS);
+
+    UINT pos = start;
+    for(UINT i=0; i<=mask; i++, pos++)
+    {
+        TimelineName &name = timelineNames[pos & mask];
+        CTSTR lpKey = name.lpKey;
+        if(!lpKey)
+            break;
+        if(lpKey == lpName && scmp(name.lpName, lpName) == 0)
+            return name.lpName;
+    }
+
+    //not there yet.  look again under the lock from where the search stopped, another thread may have
+    //added it in the meantime
+    CTSTR lpCopy = TEXT("(too many names)");
+
+    OSEnterMutex(hProfilerMutex);
+    for(UINT i=0; i<=mask; i++, pos++)
+    {
+        TimelineName &name = timelineNames[pos & mask];
+        if(!name.lpKey)
+        {
+            name.lpName = sdup(lpName);
+            name.lpKey = lpName;
+            lpCopy = name.lpName;
+            break;
+        }
+        if(name.lpKey == lpName && scmp(name.lpName, lpName) == 0)
+        {
+            lpCopy = name.lpName;
+            break;
+        }
+    }
+    OSLeaveMutex(hProfilerMutex);
+
+    return lpCopy;
+}
+
+void STDCALL EnableTimeline(BOOL bEnable, UINT maxEvents, CTSTR lpStallDumpFolder)
+{
+    if(bEnable)
+    {
+        OSEnterMutex(hProfilerMutex);
+
+        //the ring is kept until FreeTimeline at shutdown, since threads may still be writing to it
+        if(!timelineEvents)
+        {
+            UINT numEvents = 1024;
+            while(numEvents < maxEvents)
+                numEvents <<= 1;
+
+            timelineEvents = (TimelineRecord*)Allocate(numEvents*sizeof(TimelineRecord));
+            zero(timelineEvents, numEvents*sizeof(TimelineRecord));
+            timelineMask = numEvents-1;
+        }
+
+        strTimelineDumpFolder = lpStallDumpFolder;
+
+        OSLeaveMutex(hProfilerMutex);
+    }
+
+    bTimelineEnabled = bEnable && timelineEvents;
+}
+
+void STDCALL AddTimelineEvent(CTSTR lpName, char type)
+{
+    if(!timelineEvents)
+        return;
+
+    UINT index = UINT(_InterlockedIncrement(&timelineWritePos)-1);
+    TimelineRecord &record = timelineEvents[index & timelineMask];
+
+    record.seq = 0;
+    record.threadID = OSGetCurrentThreadID();
+    record.lpName = GetTimelineName(lpName);
+    record.time = OSGetPerformanceCounter();
+    record.type = type;
+    record.seq = index+1;
+
+    if(index == timelineMask)
+        bTimelineFilled = TRUE;
+}
+
+void STDCALL SetTimelineThreadName(CTSTR lpName)
+{
+    if(!bTimelineEnabled)
+        return;
+
+    DWORD threadID = OSGetCurrentThreadID();
+
+    OSEnterMutex(hProfilerMutex);
+
+    TimelineThreadName *threadName = NULL;
+    for(UINT i=0; i<timelineThreadNames.Num(); i++)
+    {
+        if(timelineThreadNames[i].threadID == threadID)
+        {
+            threadName = timelineThreadNames+i;
+            break;
+        }
+    }
+
+    if(!threadName)
+    {
+        //thread IDs get recycled and threads are recreated with every stream, so only keep recent ones
+        if(timelineThreadNames.Num() >= 256)
+        {
+            timelineThreadNames[0].strName.Clear();
+            timelineThreadNames.Remove(0);
+        }
+
+        threadName = timelineThreadNames.CreateNew();
+        threadName->threadID = threadID;
+    }
+    threadName->strName = lpName;
+
+    OSLeaveMutex(hProfilerMutex);
+}
+
+static void AppendJSONString(StringBuilder &json, CTSTR lpStr)
+{
+    json << TEXT('"');
+    for(; *lpStr; lpStr++)
+    {
+        TCHAR ch = *lpStr;
+        if(ch == '"' || ch == '\\')
+            json << TEXT('\\') << ch;
+        else if(ch < 0x20)
+            json.AppendFormat(TEXT("\\u%04x"), UINT(ch));
+        else
+            json << ch;
+    }
+    json << TEXT('"');
+}
+
+BOOL STDCALL DumpTimeline(CTSTR lpFile)
+{
+    if(!timelineEvents)
+        return FALSE;
+
+    //copy the ring out first so that the events don't get overwritten while they're written to disk
+    UINT end = UINT(timelineWritePos);
+    UINT count = bTimelineFilled ? (timelineMask+1) : MIN(end, timelineMask+1);
+
+    List<TimelineRecord> events;
+    events.SetSize(count);
+
+    UINT numEvents = 0;
+    for(UINT index = end-count; index != end; index++)
+    {
+        TimelineRecord &record = timelineEvents[index & timelineMask];
+        TimelineRecord &copy = events[numEvents];
+
+        UINT seq = record.seq;
+        copy.threadID = record.threadID;
+        copy.lpName = record.lpName;
+        copy.time = record.time;
+        copy.type = record.type;
+
+        if(seq == index+1 && record.seq == seq)
+            numEvents++;
+    }
+
+    XFile file;
+    if(!file.Open(lpFile, XFILE_WRITE, XFILE_CREATEALWAYS))
+    {
+        Log(TEXT("DumpTimeline: could not open '%s' for writing"), lpFile);
+        return FALSE;
+    }
+
+    double toMicroseconds = 1000000.0/double(OSGetPerformanceFrequency());
+
+    StringBuilder json;
+    json << TEXT("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\r\n");
+    json << TEXT("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"OBS\"}}");
+
+    OSEnterMutex(hProfilerMutex);
+    for(UINT i=0; i<timelineThreadNames.Num(); i++)
+    {
+        json.AppendFormat(TEXT(",\r\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":"), timelineThreadNames[i].threadID);
+        AppendJSONString(json, timelineThreadNames[i].strName);
+        json << TEXT("}}");
+    }
+    OSLeaveMutex(hProfilerMutex);
+
+    for(UINT i=0; i<numEvents; i++)
+    {
+        TimelineRecord &record = events[i];
+
+        json << TEXT(",\r\n{\"name\":");
+        AppendJSONString(json, record.lpName);
+        json.AppendFormat(TEXT(",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u"), record.type, double(record.time)*toMicroseconds, record.threadID);
+        if(record.type == 'i')
+            json << TEXT(",\"s\":\"g\"");
+        json << TEXT('}');
+
+        //write it out in pieces so a full ring doesn't need the whole file in memory
+        if(json.Length() >= 0x10000)
+        {
+            file.WriteAsUTF8(json.Array(), json.Length());
+            json.Clear();
+        }
+    }
+
+    json << TEXT("\r\n]}\r\n");
+    BOOL bSuccess = file.WriteAsUTF8(json.Array(), json.Length());
+    file.Close();
+
+    return bSuccess;
+}
+
+static DWORD STDCALL TimelineDumpThread(LPVOID lpFile)
+{
+    String *strFile = (String*)lpFile;
+
+    if(DumpTimeline(*strFile))
+        Log(TEXT("Timeline written to '%s'"), strFile->Array());
+
+    delete strFile;
+    bTimelineDumping = 0;
+    return 0;
+}
+
+//writes the timeline to the stall dump folder on a separate thread, at most once a minute
+void STDCALL TriggerTimelineDump(CTSTR lpReason)
+{
+    if(!bTimelineEnabled || strTimelineDumpFolder.IsEmpty())
+        return;
+
+    AddTimelineEvent(lpReason, 'i');
+
+    DWORD curTime = OSGetTime();
+    if(lastTimelineDumpTime && (curTime-lastTimelineDumpTime) < TIMELINE_DUMP_INTERVAL)
+        return;
+    if(_InterlockedCompareExchange(&bTimelineDumping, 1, 0) != 0)
+        return;
+
+    lastTimelineDumpTime = curTime;
+
+    time_t now = time(0);
+    struct tm tstruct = *localtime(&now);
+
+    String *strFile = new String;
+    *strFile << strTimelineDumpFolder << FormattedString(TEXT("\\timeline-%u-%02u-%02u-%02u%02u-%02u.json"),
+        tstruct.tm_year+1900, tstruct.tm_mon+1, tstruct.tm_mday, tstruct.tm_hour, tstruct.tm_min, tstruct.tm_sec);
+
+    Log(TEXT("%s, writing timeline"), lpReason);
+
+    //the last dump has finished since bTimelineDumping was clear.  the new thread is started with the
+    //mutex held, so FreeTimeline can't look for it before the handle is stored
+    OSEnterMutex(hProfilerMutex);
+    if(hTimelineDumpThread)
+        OSCloseThread(hTimelineDumpThread);
+
+    hTimelineDumpThread = OSCreateThread((XTHREAD)TimelineDumpThread, strFile);
+    if(!hTimelineDumpThread)
+    {
+        delete strFile;
+        bTimelineDumping = 0;
+    }
+    OSLeaveMutex(hProfilerMutex);
+}
+
+//only call this at shutdown once nothing can record any more events
+void STDCALL FreeTimeline()
+{
+    bTimelineEnabled = FALSE;
+
+    //wait for a dump that's still writing, and keep any more from starting
+    while(_InterlockedCompareExchange(&bTimelineDumping, 1, 0) != 0)
+        OSSleep(10);
+
+    OSEnterMutex(hProfilerMutex);
+    if(hTimelineDumpThread)
+    {
+        OSWaitForThread(hTimelineDumpThread, NULL);
+        OSCloseThread(hTimelineDumpThread);
+        hTimelineDumpThread = NULL;
+    }
+    OSLeaveMutex(hProfilerMutex);
+
+    bTimelineDumping = 0;
+
+    Free(timelineEvents);
+    timelineEvents = NULL;
+    timelineMask = 0;
+    timelineWritePos = 0;
+    bTimelineFilled = FALSE;
+
+    for(UINT i=0; i<timelineThreadNames.Num(); i++)
+        timelineThreadNames[i].strName.Clear();
+    timelineThreadNames.Clear();
+    strTimelineDumpFolder.Clear();
+
+    for(UINT i=0; i<(1 << TIMELINE_NAME_BITS); i++)
+    {
+        if(timelineNames[i].lpName)
+            Free(timelineNames[i].lpName);
+        timelineNames[i].lpName = NULL;
+        timelineNames[i].lpKey = NULL;
+    }
+}
@@ -21,8 +21,9 @@
 
 #pragma once
 
-struct ProfileNodeInfo;
+struct ProfileSlot;
 
+//plugins put these on their own stacks through the macros below, so the size and layout stay as they were
 class BASE_EXPORT ProfilerNode
 {
     CTSTR lpName;
@@ -32,7 +33,8 @@ class BASE_EXPORT ProfilerNode
     HANDLE thread;
     ProfilerNode *parent;
     bool bSingularNode;
-    ProfileNodeInfo *info;
+    bool bTimelineEvent;    //fits in the padding after bSingularNode
+    ProfileSlot *slot;
 
 public:
     ProfilerNode(CTSTR name, bool bSingularize=false);
@@ -66,3 +68,45 @@ BASE_EXPORT void STDCALL EnableProfiling(BOOL bEnable, float minPercentage=0.0f,
 BASE_EXPORT void STDCALL DumpProfileData();
 BASE_EXPORT void STDCALL DumpLastProfileData();
 BASE_EXPORT void STDCALL FreeProfileData();
+
+//-----------------------------------------
+// timeline recorder.  while enabled, profile segments (and the trace macros below) also record
+// begin/end events into a ring buffer that can be written out as a Chrome trace_event JSON file
+// (chrome://tracing, ui.perfetto.dev).  timestamps are on the GetQPCTimeNS clock.
+
+BASE_EXPORT extern BOOL bTimelineEnabled;
+
+BASE_EXPORT void STDCALL EnableTimeline(BOOL bEnable, UINT maxEvents=0x40000, CTSTR lpStallDumpFolder=NULL);
+BASE_EXPORT void STDCALL AddTimelineEvent(CTSTR lpName, char type);
+BASE_EXPORT void STDCALL SetTimelineThreadName(CTSTR lpName);
+BASE_EXPORT BOOL STDCALL DumpTimeline(CTSTR lpFile);
+BASE_EXPORT void STDCALL TriggerTimelineDump(CTSTR lpReason);
+BASE_EXPORT void STDCALL FreeTimeline();
+
+class TimelineScope
+{
+    CTSTR lpName;
+
+public:
+    inline TimelineScope(CTSTR lpName) : lpName(bTimelineEnabled ? lpName : NULL)
+    {
+        if(this->lpName) AddTimelineEvent(lpName, 'B');
+    }
+
+    inline ~TimelineScope()
+    {
+        if(lpName) AddTimelineEvent(lpName, 'E');
+    }
+};
+
+#ifdef ENABLE_PROFILING
+    #define traceSegment(name)                          TimelineScope _curTrace(TEXT(name));
+    #define traceIn(name)                               {TimelineScope _curTrace(TEXT(name));
+    #define traceOut                                    }
+    #define traceInstant(name)                          do {if(bTimelineEnabled) AddTimelineEvent(TEXT(name), 'i');} while(0)
+#else
+    #define traceSegment(name)
+    #define traceIn(name)
+    #define traceOut
+    #define traceInstant(name)
+#endif
@@ -20,6 +20,123 @@
 #include "XT.h"
 
 
+//accumulates the text of a whole file so it goes out in one write instead of one per line
+class XConfigWriter
+{
+public:
+    TSTR lpData;
+    UINT len, size;
+
+    inline XConfigWriter() : lpData(NULL), len(0), size(0) {}
+    inline ~XConfigWriter() {if(lpData) Free(lpData);}
+
+    void Append(CTSTR lpStr, UINT strLen)
+    {
+        if(len+strLen+1 > size)
+        {
+            size = MAX(size*2, 4096);
+            while(size < len+strLen+1)
+                size *= 2;
+
+            lpData = (TSTR)ReAllocate(lpData, size*sizeof(TCHAR));
+        }
+
+        mcpy(lpData+len, lpStr, strLen*sizeof(TCHAR));
+        len += strLen;
+        lpData[len] = 0;
+    }
+
+    inline void Append(CTSTR lpStr)     {Append(lpStr, slen(lpStr));}
+    inline void Append(const String &str) {Append(str.Array(), str.Length());}
+
+    inline void Indent(int indent)
+    {
+        for(int i=0; i<indent; i++)
+            Append(TEXT("  "), 2);
+    }
+
+    inline TSTR Detach()
+    {
+        TSTR lpRet = lpData;
+        lpData = NULL;
+        len = size = 0;
+        return lpRet;
+    }
+};
+
+
+/*========================================================
+  XElementIndex
+=========================================================*/
+
+//elements with at least this many children get a name index
+const UINT XElementIndexThreshold = 16;
+
+//bumped when a data item is renamed, which can't tell its element's index about it.  an index built
+//before the latest such rename is skipped by lookups until its element is next changed
+static volatile long renameGeneration = 0;
+
+struct XChildSlot
+{
+    UINT hash;
+    UINT id;                //SubItems position+1, 0 for an empty slot
+};
+
+//open addressed by name hash.  kept by the element's XConfig rather than the element, so XBaseItem
+//and XElement keep the layout plugins were built with
+struct XElementIndex
+{
+    const XElement *element;
+    List<XChildSlot> slots;
+    long generation;
+};
+
+//case insensitive the same way CompareI is (ascii only)
+static UINT HashName(CTSTR lpName)
+{
+    UINT hash = 2166136261;
+
+    if(lpName)
+    {
+        TCHAR val;
+        while((val = *(lpName++)) != 0)
+        {
+            if((val >= 'A') && (val <= 'Z'))
+                val += 0x20;
+
+            hash = (hash ^ UINT(val)) * 16777619;
+        }
+    }
+
+    return hash;
+}
+
+static inline void InsertSlot(XElementIndex *index, UINT hash, UINT id)
+{
+    UINT mask = index->slots.Num()-1;
+    UINT slot = hash;
+    while(index->slots[slot & mask].id)
+        slot++;
+
+    index->slots[slot & mask].hash = hash;
+    index->slots[slot & mask].id = id;
+}
+
+
+/*========================================================
+  XBaseItem
+=========================================================*/
+
+void XBaseItem::SetName(CTSTR lpName)
+{
+    strName = lpName;
+
+    XElement *parent = (type == XConfig_Element) ? static_cast<XElement*>(this)->parent : NULL;
+    if(parent)
+        parent->RebuildIndex();
+    else
+        _InterlockedIncrement(&renameGeneration);
+}
 
 
 /*========================================================
@@ -33,6 +150,94 @@ XElement::~XElement()
     for(i=0; i<SubItems.Num(); i++)
         delete SubItems[i];
     SubItems.Clear();
+
+    if(file)
+        file->RemoveElementIndex(this);
+}
+
+void XElement::AddSubItem(XBaseItem *item)
+{
+    SubItems << item;
+
+    if(!file || SubItems.Num() < XElementIndexThreshold)
+        return;
+
+    XElementIndex *index = file->GetElementIndex(this, false);
+    if(!index || index->generation != renameGeneration || SubItems.Num()*2 > index->slots.Num())
+        RebuildIndex();
+    else
+        InsertSlot(index, HashName(item->strName), SubItems.Num());
+}
+
+//positions are inserted in order, so of several items with the same name the probe always meets
+//the first one first, same as the linear scan
+void XElement::RebuildIndex()
+{
+    if(!file)
+        return;
+
+    if(SubItems.Num() < XElementIndexThreshold)
+    {
+        file->RemoveElementIndex(this);
+        return;
+    }
+
+    XElementIndex *index = file->GetElementIndex(this, true);
+    index->generation = renameGeneration;
+
+    UINT indexSize = 64;
+    while(indexSize < SubItems.Num()*4)
+        indexSize <<= 1;
+
+    index->slots.SetSize(indexSize);
+    zero(index->slots.Array(), indexSize*sizeof(XChildSlot));
+
+    for(UINT i=0; i<SubItems.Num(); i++)
+        InsertSlot(index, HashName(SubItems[i]->strName), i+1);
+}
+
+UINT XElement::FindSubItem(CTSTR lpName, int type) const
+{
+    if(!lpName)
+        return INVALID;
+
+    //never builds or fixes up an index, other threads can be reading at the same time
+    const XElementIndex *index = NULL;
+    if(file && SubItems.Num() >= XElementIndexThreshold)
+    {
+        index = file->GetElementIndex(this, false);
+        if(index && index->generation != renameGeneration)
+            index = NULL;
+    }
+
+    if(!index)
+    {
+        for(UINT i=0; i<SubItems.Num(); i++)
+        {
+            XBaseItem *item = SubItems[i];
+            if((type < 0 || item->type == type) && item->strName.CompareI(lpName))
+                return i;
+        }
+
+        return INVALID;
+    }
+
+    UINT hash = HashName(lpName);
+    UINT mask = index->slots.Num()-1;
+
+    for(UINT slot=hash; ; slot++)
+    {
+        const XChildSlot &childSlot = index->slots[slot & mask];
+        if(!childSlot.id)
+            return INVALID;
+
+        if(childSlot.hash != hash || childSlot.id > SubItems.Num())
+            continue;
+
+        XBaseItem *item = SubItems[childSlot.id-1];
+        if((type < 0 || item->type == type) && item->strName.CompareI(lpName))
+            return childSlot.id-1;
+    }
 }
 
 CTSTR XElement::GetString(CTSTR lpName, TSTR def) const
@@ -142,7 +347,7 @@ void  XElement::SetString(CTSTR lpName, CTSTR lpString)
         return;
     }
 
-    SubItems << new XDataItem(lpName, lpString);
+    AddSubItem(new XDataItem(lpName, lpString));
 }
 
 void  XElement::SetInt(CTSTR lpName, int number)
@@ -158,7 +363,7 @@ void  XElement::SetInt(CTSTR lpName, int number)
         return;
     }
 
-    SubItems << new XDataItem(lpName, intStr);
+    AddSubItem(new XDataItem(lpName, intStr));
 }
 
 void  XElement::SetFloat(CTSTR lpName, float number)
@@ -174,7 +379,7 @@ void  XElement::SetFloat(CTSTR lpName, float number)
         return;
     }
 
-    SubItems << new XDataItem(lpName, floatStr);
+    AddSubItem(new XDataItem(lpName, floatStr));
 }
 
 void  XElement::SetHex(CTSTR lpName, DWORD hex)
@@ -191,7 +396,7 @@ void  XElement::SetHex(CTSTR lpName, DWORD hex)
         return;
     }
 
-    SubItems << new XDataItem(lpName, hexStr);
+    AddSubItem(new XDataItem(lpName, hexStr));
 }
 
 
@@ -232,21 +437,21 @@ void  XElement::AddString(CTSTR lpName, TSTR lpString)
 
     if(!lpString) lpString = TEXT("");
 
-    SubItems << new XDataItem(lpName, lpString);
+    AddSubItem(new XDataItem(lpName, lpString));
 }
 
 void  XElement::AddInt(CTSTR lpName, int number)
 {
     assert(lpName);
 
-    SubItems << new XDataItem(lpName, IntString(number));
+    AddSubItem(new XDataItem(lpName, IntString(number)));
 }
 
 void  XElement::AddFloat(CTSTR lpName, float number)
 {
     assert(lpName);
 
-    SubItems << new XDataItem(lpName, FloatString(number));
+    AddSubItem(new XDataItem(lpName, FloatString(number)));
 }
 
 void  XElement::AddHex(CTSTR lpName, DWORD hex)
@@ -256,7 +461,7 @@ void  XElement::AddHex(CTSTR lpName, DWORD hex)
     String hexStr;
     hexStr << TEXT("0x") << IntString(hex, 16);
 
-    SubItems << new XDataItem(lpName, hexStr);
+    AddSubItem(new XDataItem(lpName, hexStr));
 }
 
 
@@ -336,25 +541,19 @@ void  XElement::RemoveItem(CTSTR lpName)
             SubItems.Remove(i--);
         }
     }
+
+    RebuildIndex();
 }
 
 //---------------------------
 
 XElement* XElement::GetElement(CTSTR lpName) const
 {
-    if (!lpName)
+    UINT id = FindSubItem(lpName, XConfig_Element);
+    if(id == INVALID)
         return NULL;
 
-    for(DWORD i=0; i<SubItems.Num(); i++)
-    {
-        if(!SubItems[i]->IsElement()) continue;
-
-        XElement *element = static_cast<XElement*>(SubItems[i]);
-        if(element->strName.CompareI(lpName))
-            return element;
-    }
-
-    return NULL;
+    return static_cast<XElement*>(SubItems[id]);
 }
 
 XElement* XElement::GetElementByID(DWORD elementID) const
@@ -413,7 +612,7 @@ XElement* XElement::CreateElement(CTSTR lpName)
 
     XElement *newElement = new XElement(file, this, lpName);
 
-    SubItems << newElement;
+    AddSubItem(newElement);
 
     return newElement;
 }
@@ -433,9 +632,9 @@ XElement* XElement::NewElementCopy(XElement* element, bool bSelfAsRoot)
         XBaseItem *sub = element->SubItems[i];
         if (sub->GetType() == XConfig_Data) {
            XDataItem *subdata = static_cast<XDataItem *>(sub);
-           newElement->SubItems << new XDataItem(subdata->strName, subdata->strData);
+           newElement->AddSubItem(new XDataItem(subdata->strName, subdata->strData));
         } else {
-           newElement->SubItems << newElement->NewElementCopy( static_cast<XElement *>(sub), false );
+           newElement->AddSubItem(newElement->NewElementCopy( static_cast<XElement *>(sub), false ));
         }
    }
 
@@ -451,7 +650,7 @@ XElement* XElement::CopyElement(XElement* element, CTSTR lpNewName)
 
    newElement->NewElementCopy(element, true);
 
-   SubItems << newElement;
+   AddSubItem(newElement);
 
    return newElement;
 }
@@ -466,6 +665,7 @@ XElement* XElement::InsertElement(UINT pos, CTSTR lpName)
         pos = SubItems.Num();
 
     SubItems.Insert(pos, newElement);
+    RebuildIndex();
 
     return newElement;
 }
@@ -494,6 +694,7 @@ void  XElement::RemoveElement(XElement *element)
         {
             SubItems.Remove(i);
             delete element;
+            RebuildIndex();
             break;
         }
     }
@@ -514,21 +715,18 @@ void  XElement::RemoveElement(CTSTR lpName)
             SubItems.Remove(i--);
         }
     }
+
+    RebuildIndex();
 }
 
 
 XDataItem* XElement::GetDataItem(CTSTR lpName) const
 {
-    for(DWORD i=0; i<SubItems.Num(); i++)
-    {
-        if(!SubItems[i]->IsData()) continue;
-
-        XDataItem *data = static_cast<XDataItem*>(SubItems[i]);
-        if(data->strName.CompareI(lpName))
-            return data;
-    }
+    UINT id = FindSubItem(lpName, XConfig_Data);
+    if(id == INVALID)
+        return NULL;
 
-    return NULL;
+    return static_cast<XDataItem*>(SubItems[id]);
 }
 
 XDataItem* XElement::GetDataItemByID(DWORD itemID) const
@@ -550,13 +748,11 @@ XDataItem* XElement::GetDataItemByID(DWORD itemID) const
 
 XBaseItem* XElement::GetBaseItem(CTSTR lpName) const
 {
-    for(DWORD i=0; i<SubItems.Num(); i++)
-    {
-        if(SubItems[i]->strName.CompareI(lpName))
-            return SubItems[i];
-    }
+    UINT id = FindSubItem(lpName, -1);
+    if(id == INVALID)
+        return NULL;
 
-    return NULL;
+    return SubItems[id];
 }
 
 XBaseItem* XElement::GetBaseItemByID(DWORD itemID) const
@@ -626,7 +822,10 @@ void XElement::MoveUp()
             if(baseItem == this)
             {
                 if(lastElement != INVALID)
+                {
                     parent->SubItems.SwapValues(lastElement, i);
+                    parent->RebuildIndex();
+                }
 
                 break;
             }
@@ -647,7 +846,10 @@ void XElement::MoveDown()
             if(baseItem == this)
             {
                 if(lastElement != INVALID)
+                {
                     parent->SubItems.SwapValues(lastElement, (UINT)i);
+                    parent->RebuildIndex();
+                }
 
                 break;
             }
@@ -662,6 +864,7 @@ void XElement::MoveToTop()
     XElement *thisItem = this;
     parent->SubItems.RemoveItem(thisItem);
     parent->SubItems.Insert(0, thisItem);
+    parent->RebuildIndex();
 }
 
 void XElement::MoveToBottom()
@@ -669,6 +872,7 @@ void XElement::MoveToBottom()
     XElement *thisItem = this;
     parent->SubItems.RemoveItem(thisItem);
     parent->SubItems.Add(thisItem);
+    parent->RebuildIndex();
 }
 
 bool XElement::Import(CTSTR lpFile)
@@ -692,7 +896,11 @@ bool XElement::Export(CTSTR lpFile)
     if(!exportFile.Open(lpFile, XFILE_WRITE, XFILE_CREATEALWAYS))
         return false;
 
-    file->WriteFileItem(exportFile, 0, this);
+    XConfigWriter writer;
+    file->WriteFileItem(writer, 0, this);
+
+    if(writer.len)
+        exportFile.WriteAsUTF8(writer.lpData, writer.len);
 
     return true;
 }
@@ -714,64 +922,38 @@ String XConfig::ConvertToTextString(String &string)
     return String() << TEXT("\"") << stringOut << TEXT("\"");
 }
 
-String XConfig::ProcessString(TSTR &lpTemp)
+//unescapes the quoted string at lpTemp in place and returns it, lpTemp is left just past the closing quote
+TSTR XConfig::ProcessString(TSTR &lpTemp)
 {
-    TSTR lpStart = lpTemp;
+    TSTR lpStart = ++lpTemp;
+    TSTR lpOut = lpStart;
 
-    BOOL bFoundEnd = FALSE;
-    BOOL bPreviousWasEscaped = FALSE;
-    while(*++lpTemp)
+    while(*lpTemp != '"')
     {
-        if (*lpTemp == '\\' && lpTemp[-1] == '\\')
-        {
-            bPreviousWasEscaped = TRUE;
-            continue;
-        }
-        if(*lpTemp == '"' && (bPreviousWasEscaped || lpTemp[-1] != '\\'))
-        {
-            bFoundEnd = TRUE;
-            break;
-        }
-        bPreviousWasEscaped = FALSE;
-    }
-
-    if(!bFoundEnd)
-        return String();
+        if(!*lpTemp)
+            return lpTemp; //unterminated, empty
 
-    ++lpTemp;
-
-    TCHAR backupChar = *lpTemp;
-    *lpTemp = 0;
-    String string = lpStart;
-    *lpTemp = backupChar;
-
-    if (string.Length() == 2)
-        return String();
-
-    String stringOut = string.Mid(1, string.Length()-1);
-    if (stringOut.IsEmpty())
-        return String();
-
-    TSTR lpStringOut = stringOut;
-    while(*lpStringOut != 0 && (lpStringOut = schr(lpStringOut, '\\')) != 0)
-    {
-        switch(lpStringOut[1])
+        if(*lpTemp == '\\')
         {
-            case 0:     *lpStringOut = 0; break;
-            case '"':   *lpStringOut = '"';  scpy(lpStringOut+1, lpStringOut+2); break;
-            case 't':   *lpStringOut = '\t'; scpy(lpStringOut+1, lpStringOut+2); break;
-            case 'r':   *lpStringOut = '\r'; scpy(lpStringOut+1, lpStringOut+2); break;
-            case 'n':   *lpStringOut = '\n'; scpy(lpStringOut+1, lpStringOut+2); break;
-            case '/':   *lpStringOut = '/';  scpy(lpStringOut+1, lpStringOut+2); break;
-            case '\\':  scpy(lpStringOut+1, lpStringOut+2); break;
+            switch(lpTemp[1])
+            {
+                case 0:     return ++lpTemp;
+                case '"':   *(lpOut++) = '"';  lpTemp += 2; continue;
+                case 't':   *(lpOut++) = '\t'; lpTemp += 2; continue;
+                case 'r':   *(lpOut++) = '\r'; lpTemp += 2; continue;
+                case 'n':   *(lpOut++) = '\n'; lpTemp += 2; continue;
+                case '/':   *(lpOut++) = '/';  lpTemp += 2; continue;
+                case '\\':  *(lpOut++) = '\\'; lpTemp += 2; continue;
+            }
         }
 
-        lpStringOut++;
+        *(lpOut++) = *(lpTemp++);
     }
 
-    stringOut.SetLength(slen(stringOut));
+    ++lpTemp;
+    *lpOut = 0;
 
-    return stringOut;
+    return lpStart;
 }
 
 bool  XConfig::ReadFileData(XElement *curElement, int level, TSTR &lpTemp)
@@ -779,6 +961,26 @@ bool  XConfig::ReadFileData(XElement *curElement, int level, TSTR &lpTemp)
     return false;
 }
 
+static inline bool IsXSpace(TCHAR ch)
+{
+    return ch == ' ' || ch == L'　' || ch == '\t';
+}
+
+//trims the text between lpStart and lpEnd and terminates it in place, returns the old character at the end
+static inline TCHAR TerminateTrimmed(TSTR &lpStart, TSTR lpEnd, TSTR &lpTerminator)
+{
+    while(lpStart < lpEnd && IsXSpace(*lpStart))
+        ++lpStart;
+    while(lpEnd > lpStart && IsXSpace(lpEnd[-1]))
+        --lpEnd;
+
+    lpTerminator = lpEnd;
+
+    TCHAR oldChar = *lpEnd;
+    *lpEnd = 0;
+    return oldChar;
+}
+
 static inline bool GetNextLine(TSTR &lpTemp, bool isJSON)
 {
     while (*lpTemp)
@@ -797,6 +999,8 @@ static inline bool GetNextLine(TSTR &lpTemp, bool isJSON)
     return false;
 }
 
+//single pass over the (mutable) file buffer: quoted names and values are unescaped in place and
+//everything else is terminated in place, so no intermediate strings are built for each token
 bool  XConfig::ReadFileData2(XElement *curElement, int level, TSTR &lpTemp, bool isJSON)
 {
     while(*lpTemp)
@@ -810,46 +1014,39 @@ bool  XConfig::ReadFileData2(XElement *curElement, int level, TSTR &lpTemp, bool
             if(!ReadFileData2(curElement, level+1, lpTemp, true))
                 return false;
         }
-        else if(*lpTemp != ' '   &&
-                *lpTemp != L'　' &&
-                *lpTemp != '\t'  &&
+        else if(!IsXSpace(*lpTemp) &&
                 *lpTemp != '\r'  &&
                 *lpTemp != '\n'  &&
                 *lpTemp != ',')
         {
-            String strName;
+            TSTR lpName;
 
             if(*lpTemp == '"')
-                strName = ProcessString(lpTemp);
-            else
             {
-                TSTR lpDataStart = lpTemp;
+                lpName = ProcessString(lpTemp);
 
                 lpTemp = schr(lpTemp, ':');
                 if(!lpTemp)
                     return false;
-
-                *lpTemp = 0;
-                strName = lpDataStart;
-                *lpTemp = ':';
-
-                strName.KillSpaces();
             }
+            else
+            {
+                lpName = lpTemp;
 
-            //---------------------------
+                lpTemp = schr(lpTemp, ':');
+                if(!lpTemp)
+                    return false;
 
-            lpTemp = schr(lpTemp, ':');
-            if(!lpTemp)
-                return false;
+                TSTR lpNameEnd;
+                TerminateTrimmed(lpName, lpTemp, lpNameEnd);
+            }
 
             ++lpTemp;
 
-            while( *lpTemp == ' '   ||
-                   *lpTemp == L'　' ||
-                   *lpTemp == '\t'  )
-            {
+            //---------------------------
+
+            while(IsXSpace(*lpTemp))
                 ++lpTemp;
-            }
 
             //---------------------------
 
@@ -857,16 +1054,21 @@ bool  XConfig::ReadFileData2(XElement *curElement, int level, TSTR &lpTemp, bool
             {
                 ++lpTemp;
 
-                XElement *newElement = curElement->CreateElement(strName);
+                XElement *newElement = curElement->CreateElement(lpName);
                 if (!ReadFileData2(newElement, level + 1, lpTemp, isJSON))
                     return false;
             }
             else //item
             {
-                String data;
-
                 if(*lpTemp == '"')
-                    data = ProcessString(lpTemp);
+                {
+                    TSTR lpData = ProcessString(lpTemp);
+
+                    if (!GetNextLine(lpTemp, isJSON) && curElement != RootElement)
+                        return false;
+
+                    curElement->AddSubItem(new XDataItem(lpName, lpData));
+                }
                 else
                 {
                     TSTR lpDataStart = lpTemp;
@@ -876,24 +1078,17 @@ bool  XConfig::ReadFileData2(XElement *curElement, int level, TSTR &lpTemp, bool
 
                     if(lpTemp[-1] == '\r') --lpTemp;
 
-                    if(lpTemp != lpDataStart)
-                    {
-                        TCHAR oldChar = *lpTemp;
-                        *lpTemp = 0;
-                        data = lpDataStart;
-                        *lpTemp = oldChar;
+                    TSTR lpDataEnd;
+                    TCHAR oldChar = TerminateTrimmed(lpDataStart, lpTemp, lpDataEnd);
+                    curElement->AddSubItem(new XDataItem(lpName, lpDataStart));
+                    *lpDataEnd = oldChar;
 
-                        data.KillSpaces();
-                    }
+                    if (!GetNextLine(lpTemp, isJSON) && curElement != RootElement)
+                        return false;
                 }
 
-                if (!GetNextLine(lpTemp, isJSON) && curElement != RootElement)
-                    return false;
-
                 if (*lpTemp == '}')
                     lpTemp--;
-
-                curElement->SubItems << new XDataItem(strName, data);
             }
         }
 
@@ -909,112 +1104,77 @@ bool  XConfig::ReadFileData2(XElement *curElement, int level, TSTR &lpTemp, bool
     return (curElement == RootElement);
 }
 
-bool  XConfig::WriteFileItem(XFile &file, int indent, XBaseItem *baseItem)
+static inline bool NeedsQuotes(const String &str)
+{
+    return  str.IsValid()                   && (
+            str[0] == ' '                   ||
+            str[0] == '\t'                  ||
+            str[0] == '{'                   ||
+            str[str.Length()-1] == ' '      ||
+            str[str.Length()-1] == '\t'     ||
+            schr(str, '\n')                 ||
+            schr(str, '"')                  ||
+            schr(str, ':')                  );
+}
+
+void  XConfig::WriteFileItem(XConfigWriter &writer, int indent, XBaseItem *baseItem)
 {
-    int j;
+    writer.Indent(indent);
+
+    if(NeedsQuotes(baseItem->strName))
+        writer.Append(ConvertToTextString(baseItem->strName));
+    else
+        writer.Append(baseItem->strName);
 
     if(baseItem->IsData())
     {
         XDataItem *item = static_cast<XDataItem*>(baseItem);
 
-        String strItem;
-
-        for(j=0; j<indent; j++)
-            strItem << TEXT("  ");
+        writer.Append(TEXT(" : "), 3);
 
-        if( item->strName.IsValid()                         && (
-            item->strName[0] == ' '                         ||
-            item->strName[0] == '\t'                        ||
-            item->strName[0] == '{'                         ||
-            item->strName[item->strName.Length()-1] == ' '  ||
-            item->strName[item->strName.Length()-1] == '\t' ||
-            schr(item->strName, '\n')                       ||
-            schr(item->strName, '"')                        ||
-            schr(item->strName, ':')                        ))
-        {
-            strItem << ConvertToTextString(item->strName);
-        }
-        else
-            strItem << item->strName;
-
-        strItem << TEXT(" : ");
-
-        if( item->strData.IsValid()                         && (
-            item->strData[0] == ' '                         ||
-            item->strData[0] == '\t'                        ||
-            item->strData[0] == '{'                         ||
-            item->strData[item->strData.Length()-1] == ' '  ||
-            item->strData[item->strData.Length()-1] == '\t' ||
-            schr(item->strData, '\n')                       ||
-            schr(item->strData, '"')                        ||
-            schr(item->strData, ':')                        ))
-        {
-            strItem << ConvertToTextString(item->strData);
-        }
+        if(NeedsQuotes(item->strData))
+            writer.Append(ConvertToTextString(item->strData));
         else
-            strItem << item->strData;
+            writer.Append(item->strData);
 
-        strItem << TEXT("\r\n");
-
-        if (!file.WriteAsUTF8(strItem))
-            return false;
+        writer.Append(TEXT("\r\n"), 2);
     }
     else if(baseItem->IsElement())
     {
-        XElement *element = static_cast<XElement*>(baseItem);
-
-        String strElement;
-
-        for(j=0; j<indent; j++)
-            strElement << TEXT("  ");
-
-        if( element->strName.IsValid()                            && (
-            element->strName[0] == ' '                            ||
-            element->strName[0] == '\t'                           ||
-            element->strName[0] == '{'                            ||
-            element->strName[element->strName.Length()-1] == ' '  ||
-            element->strName[element->strName.Length()-1] == '\t' ||
-            schr(element->strName, '\n')                          ||
-            schr(element->strName, '"')                           ||
-            schr(element->strName, ':')                           ))
-        {
-            strElement << ConvertToTextString(element->strName);
-        }
-        else
-            strElement << element->strName;
-
-        strElement << TEXT(" : {\r\n");
+        writer.Append(TEXT(" : {\r\n"), 6);
 
-        if (!file.WriteAsUTF8(strElement))
-            return false;
+        WriteFileData(writer, indent + 1, static_cast<XElement*>(baseItem));
 
-        strElement.Clear();
-
-        if (!WriteFileData(file, indent + 1, element))
-            return false;
-
-        for(j=0; j<indent; j++)
-            strElement << TEXT("  ");
-        strElement << TEXT("}\r\n");
-
-        if (!file.WriteAsUTF8(strElement))
-            return false;
+        writer.Indent(indent);
+        writer.Append(TEXT("}\r\n"), 3);
     }
+}
 
-    return true;
+void  XConfig::WriteFileData(XConfigWriter &writer, int indent, XElement *curElement)
+{
+    for(UINT i=0; i<curElement->SubItems.Num(); i++)
+        WriteFileItem(writer, indent, curElement->SubItems[i]);
 }
 
-bool  XConfig::WriteFileData(XFile &file, int indent, XElement *curElement)
+static bool WriteConfigFile(CTSTR lpPath, CTSTR lpData, UINT len, CTSTR lpFunc)
 {
-    DWORD i;
+    String tmpPath = lpPath;
+    tmpPath.AppendString(TEXT(".tmp"));
 
-    for(i=0; i<curElement->SubItems.Num(); i++)
+    XFile file;
+    if (!file.Open(tmpPath, XFILE_WRITE, XFILE_CREATEALWAYS))
+        return false;
+
+    if (len && !file.WriteAsUTF8(lpData, len))
     {
-        XBaseItem *baseItem = curElement->SubItems[i];
-        if (!WriteFileItem(file, indent, baseItem))
-            return false;
+        Log(TEXT("%s: WriteFileData failed while writing %s."), lpFunc, lpPath);
+        return false;
     }
 
+    file.Close();
+    if (!OSRenameFile(tmpPath, lpPath))
+        Log(TEXT("%s: Unable to move new config file %s to %s"), lpFunc, tmpPath.Array(), lpPath);
+
     return true;
 }
 
@@ -1050,6 +1210,9 @@ bool  XConfig::Open(CTSTR lpFile)
         Close();
     }
 
+    //a save of this file may still be waiting to be written
+    FlushSaves();
+
     //-------------------------------------
 
     XFile file;
@@ -1122,33 +1285,102 @@ void  XConfig::Close(bool bSave)
     if(bSave)
         Save();
 
+    FlushSaves();
+
     delete RootElement;
     RootElement = NULL;
 
     strFileName.Clear();
 }
 
+XConfig::~XConfig()
+{
+    Close();
+
+    if(hSaveThread)
+    {
+        bSaveThreadExit = true;
+        OSSetEvent(hSaveEvent);
+
+        OSWaitForThread(hSaveThread, NULL);
+        OSCloseThread(hSaveThread);
+    }
+
+    if(hSaveEvent)
+        OSCloseEvent(hSaveEvent);
+    if(hSaveMutex)
+        OSCloseMutex(hSaveMutex);
+    if(hSaveWriteMutex)
+        OSCloseMutex(hSaveWriteMutex);
+
+    for(UINT i=0; i<ElementIndexes.Num(); i++)
+        delete ElementIndexes[i];
+
+    OSCloseMutex(hIndexMutex);
+}
+
+//binary search, returns where the element's index is or would be inserted
+UINT  XConfig::FindElementIndex(const XElement *element) const
+{
+    UINT low = 0, high = ElementIndexes.Num();
+    while(low < high)
+    {
+        UINT mid = (low+high)/2;
+        if(ElementIndexes[mid]->element < element)
+            low = mid+1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+XElementIndex* XConfig::GetElementIndex(const XElement *element, bool bCreate)
+{
+    XElementIndex *index = NULL;
+
+    OSEnterMutex(hIndexMutex);
+
+    UINT pos = FindElementIndex(element);
+    if(pos < ElementIndexes.Num() && ElementIndexes[pos]->element == element)
+        index = ElementIndexes[pos];
+    else if(bCreate)
+    {
+        index = new XElementIndex;
+        index->element = element;
+        ElementIndexes.Insert(pos, index);
+    }
+
+    OSLeaveMutex(hIndexMutex);
+
+    return index;
+}
+
+void  XConfig::RemoveElementIndex(const XElement *element)
+{
+    OSEnterMutex(hIndexMutex);
+
+    UINT pos = FindElementIndex(element);
+    if(pos < ElementIndexes.Num() && ElementIndexes[pos]->element == element)
+    {
+        delete ElementIndexes[pos];
+        ElementIndexes.Remove(pos);
+    }
+
+    OSLeaveMutex(hIndexMutex);
+}
+
 void  XConfig::Save()
 {
     if(RootElement)
     {
-        String tmpPath = strFileName;
-        tmpPath.AppendString(TEXT(".tmp"));
+        //anything queued for this file is older than what's about to be written
+        FlushSaves();
 
-        XFile file;
-        if (file.Open(tmpPath, XFILE_WRITE, XFILE_CREATEALWAYS))
-        {
-            if (WriteFileData(file, 0, RootElement))
-            {
-                file.Close();
-                if (!OSRenameFile(tmpPath, strFileName))
-                    Log(TEXT("XConfig::Save: Unable to move new config file %s to %s"), tmpPath.Array(), strFileName.Array());
-            }
-            else
-            {
-                Log(TEXT("XConfig::Save: WriteFileData failed while writing %s."), strFileName.Array());
-            }
-        }
+        XConfigWriter writer;
+        WriteFileData(writer, 0, RootElement);
+
+        WriteConfigFile(strFileName, writer.lpData, writer.len, TEXT("XConfig::Save"));
     }
 }
 
@@ -1156,22 +1388,139 @@ void  XConfig::SaveTo(CTSTR lpPath)
 {
     if (RootElement)
     {
-        String tmpPath = lpPath;
-        tmpPath.AppendString(TEXT(".tmp"));
+        FlushSaves();
+
+        XConfigWriter writer;
+        WriteFileData(writer, 0, RootElement);
 
-        XFile file;
-        if (file.Open(tmpPath, XFILE_WRITE, XFILE_CREATEALWAYS))
+        WriteConfigFile(lpPath, writer.lpData, writer.len, TEXT("XConfig::SaveTo"));
+    }
+}
+
+void  XConfig::SaveInBackground(DWORD delayMS)
+{
+    if(RootElement)
+        QueueSave(strFileName, delayMS);
+}
+
+void  XConfig::SaveToInBackground(CTSTR lpPath, DWORD delayMS)
+{
+    if(RootElement)
+        QueueSave(lpPath, delayMS);
+}
+
+void  XConfig::QueueSave(CTSTR lpPath, DWORD delayMS)
+{
+    XConfigWriter writer;
+    WriteFileData(writer, 0, RootElement);
+
+    if(!hSaveMutex)
+    {
+        hSaveMutex = OSCreateMutex();
+        hSaveWriteMutex = OSCreateMutex();
+        hSaveEvent = OSCreateEvent();
+    }
+
+    OSEnterMutex(hSaveMutex);
+
+    XConfigPendingSave *pending = NULL;
+    for(UINT i=0; i<PendingSaves.Num(); i++)
+    {
+        if(PendingSaves[i].strPath.CompareI(lpPath))
         {
-            if (WriteFileData(file, 0, RootElement))
-            {
-                file.Close();
-                if (!OSRenameFile(tmpPath, lpPath))
-                    Log(TEXT("XConfig::SaveTo: Unable to move new config file %s to %s"), tmpPath.Array(), lpPath);
-            }
-            else
-            {
-                Log(TEXT("XConfig::SaveTo: WriteFileData failed while writing %s."), lpPath);
-            }
+            pending = &PendingSaves[i];
+            Free(pending->lpData);
+            break;
         }
     }
-}
\ No newline at end of file
+
+    if(!pending)
+    {
+        pending = PendingSaves.CreateNew();
+        pending->strPath = lpPath;
+    }
+
+    pending->len = writer.len;
+    pending->lpData = writer.Detach();
+
+    saveDueTime = OSGetTime()+delayMS;
+
+    if(!hSaveThread)
+        hSaveThread = OSCreateThread((XTHREAD)SaveThread, this);
+
+    OSLeaveMutex(hSaveMutex);
+
+    OSSetEvent(hSaveEvent);
+}
+
+void  XConfig::WritePendingSaves(bool bOnlyDue)
+{
+    if(!hSaveMutex)
+        return;
+
+    //the write mutex is taken first so writes always land in the order their snapshots were taken
+    OSEnterMutex(hSaveWriteMutex);
+    OSEnterMutex(hSaveMutex);
+
+    if(bOnlyDue && int(OSGetTime()-saveDueTime) < 0)
+    {
+        OSLeaveMutex(hSaveMutex);
+        OSLeaveMutex(hSaveWriteMutex);
+        return;
+    }
+
+    List<XConfigPendingSave> saves;
+    saves.TransferFrom(PendingSaves);
+
+    OSLeaveMutex(hSaveMutex);
+
+    for(UINT i=0; i<saves.Num(); i++)
+    {
+        XConfigPendingSave &save = saves[i];
+        WriteConfigFile(save.strPath, save.lpData, save.len, TEXT("XConfig::SaveInBackground"));
+
+        Free(save.lpData);
+        save.strPath.Clear();
+    }
+
+    OSLeaveMutex(hSaveWriteMutex);
+}
+
+void  XConfig::FlushSaves()
+{
+    WritePendingSaves(false);
+}
+
+DWORD STDCALL XConfig::SaveThread(LPVOID lpConfig)
+{
+    XConfig *config = (XConfig*)lpConfig;
+
+    //sleeps until a snapshot is queued, then until it's due.  a newer snapshot signals the event
+    //again, which pushes the due time back
+    DWORD waitTime = WAIT_INFINITE;
+    while(true)
+    {
+        OSWaitForEvent(config->hSaveEvent, waitTime);
+        if(config->bSaveThreadExit)
+            break;
+
+        OSEnterMutex(config->hSaveMutex);
+
+        int timeLeft = int(config->saveDueTime-OSGetTime());
+        bool bPending = config->PendingSaves.Num() != 0;
+
+        OSLeaveMutex(config->hSaveMutex);
+
+        if(!bPending)
+            waitTime = WAIT_INFINITE;
+        else if(timeLeft > 0)
+            waitTime = DWORD(timeLeft);
+        else
+        {
+            config->WritePendingSaves(true);
+            waitTime = 0;
+        }
+    }
+
+    return 0;
+}
@@ -29,6 +29,10 @@ enum
     XConfig_Element
 };
 
+class XElement;
+class XConfigWriter;
+struct XElementIndex;
+
 class BASE_EXPORT XBaseItem
 {
     friend class XElement;
@@ -48,7 +52,7 @@ public:
     inline bool IsElement() const  {return type == XConfig_Element;}
 
     inline CTSTR GetName() const        {return strName;}
-    inline void  SetName(CTSTR lpName)  {strName = lpName;}
+    void  SetName(CTSTR lpName);    //not inline so child indexes know to pick up the new name
 };
 
 
@@ -72,6 +76,7 @@ public:
 
 class BASE_EXPORT XElement : public XBaseItem
 {
+    friend class XBaseItem;
     friend class XConfig;
 
     XConfig *file;
@@ -83,6 +88,13 @@ class BASE_EXPORT XElement : public XBaseItem
         : XBaseItem(XConfig_Element, lpName), parent(parentElement), file(XConfig)
     {}
 
+    //elements with enough children for a scan to hurt get a name index, which their XConfig keeps
+    //(see XElementIndex) so the items themselves keep the layout plugins were built with.  indexes
+    //are only built on changes, lookups just read them
+    void AddSubItem(XBaseItem *item);
+    void RebuildIndex();
+    UINT FindSubItem(CTSTR lpName, int type) const;
+
 protected:
     ~XElement();
 
@@ -95,16 +107,13 @@ public:
         UINT count = SubItems.Num()/2;
         for(UINT i=0; i<count; i++)
             SubItems.SwapValues(i, SubItems.Num()-1-i);
+
+        RebuildIndex();
     }
 
     inline bool HasItem(CTSTR lpName) const
     {
-        for (UINT i=0; i<SubItems.Num(); i++) {
-            if (SubItems[i]->strName.CompareI(lpName))
-                return true;
-        }
-
-        return false;
+        return FindSubItem(lpName, -1) != INVALID;
     }
 
     CTSTR GetString(CTSTR lpName, TSTR def=NULL) const;
@@ -205,6 +214,13 @@ public:
 };
 
 
+struct XConfigPendingSave
+{
+    String strPath;
+    TSTR lpData;
+    UINT len;
+};
+
 class BASE_EXPORT XConfig
 {
     friend class XElement;
@@ -212,20 +228,44 @@ class BASE_EXPORT XConfig
     XElement *RootElement;
     String strFileName;
 
+    //name indexes of the elements that have one, sorted by element.  hIndexMutex guards the list,
+    //since looking up one element's index can happen while another element is being changed
+    List<XElementIndex*> ElementIndexes;
+    HANDLE hIndexMutex;
+
+    //background saves: snapshots are taken on the calling thread and written out by the save thread
+    //once no new snapshot has come in for the debounce delay.  the thread sleeps on hSaveEvent, which
+    //is signalled whenever a snapshot is queued
+    List<XConfigPendingSave> PendingSaves;
+    DWORD saveDueTime;
+    HANDLE hSaveThread;
+    HANDLE hSaveEvent;
+    HANDLE hSaveMutex;
+    HANDLE hSaveWriteMutex;
+    volatile bool bSaveThreadExit;
+
+    UINT FindElementIndex(const XElement *element) const;
+    XElementIndex* GetElementIndex(const XElement *element, bool bCreate);
+    void RemoveElementIndex(const XElement *element);
+
     bool ReadFileData(XElement *curElement, int level, TSTR &lpFileData);
-    bool WriteFileData(XFile &file, int indent, XElement *curElement);
-    bool WriteFileItem(XFile &file, int indent, XBaseItem *curItem);
+    void WriteFileData(XConfigWriter &writer, int indent, XElement *curElement);
+    void WriteFileItem(XConfigWriter &writer, int indent, XBaseItem *curItem);
 
     static String ConvertToTextString(String &string);
-    static String ProcessString(TSTR &lpTemp);
+    static TSTR ProcessString(TSTR &lpTemp);
 
     bool ReadFileData2(XElement *curElement, int level, TSTR &lpFileData, bool isJSON);
 
+    void QueueSave(CTSTR lpPath, DWORD delayMS);
+    void WritePendingSaves(bool bOnlyDue);
+    static DWORD STDCALL SaveThread(LPVOID lpConfig);
+
 public:
-    inline XConfig() : RootElement(NULL) {}
-    inline XConfig(TSTR lpFile) : RootElement(NULL) {Open(lpFile);}
+    inline XConfig() : RootElement(NULL), hIndexMutex(OSCreateMutex()), saveDueTime(0), hSaveThread(NULL), hSaveEvent(NULL), hSaveMutex(NULL), hSaveWriteMutex(NULL), bSaveThreadExit(false) {}
+    inline XConfig(TSTR lpFile) : RootElement(NULL), hIndexMutex(OSCreateMutex()), saveDueTime(0), hSaveThread(NULL), hSaveEvent(NULL), hSaveMutex(NULL), hSaveWriteMutex(NULL), bSaveThreadExit(false) {Open(lpFile);}
 
-    inline ~XConfig() {Close();}
+    ~XConfig();
 
     bool    Open(CTSTR lpFile);
     bool    ParseString(const String& config);
@@ -233,6 +273,12 @@ public:
     void    Save();
     void    SaveTo(CTSTR lpPath);
 
+    //same as Save/SaveTo, but only the snapshot is taken now, the file is written by a background
+    //thread after delayMS without further changes.  Open, Close, Save and SaveTo flush pending saves first.
+    void    SaveInBackground(DWORD delayMS=500);
+    void    SaveToInBackground(CTSTR lpPath, DWORD delayMS=500);
+    void    FlushSaves();
+
     inline bool IsOpen() const {return RootElement != NULL;}
 
     inline XElement *GetRootElement() {return RootElement;}
@@ -153,10 +153,13 @@ BOOL XFile::WriteAsUTF8(CTSTR lpBuffer, DWORD dwElements)
         dwElements = slen(lpBuffer);
 
 #ifdef UNICODE
-    DWORD dwBytes = (DWORD)wchar_to_utf8_len(lpBuffer, dwElements, 0);
-    LPSTR lpDest = (LPSTR)Allocate(dwBytes+1);
+    //a UTF-16 unit never takes more than 3 UTF-8 bytes, so convert once into a buffer that size
+    //instead of measuring first
+    DWORD dwMaxBytes = dwElements*3;
+    LPSTR lpDest = (LPSTR)Allocate(dwMaxBytes+1);
 
-    if (wchar_to_utf8(lpBuffer, dwElements, lpDest, dwBytes, 0))
+    DWORD dwBytes = (DWORD)wchar_to_utf8(lpBuffer, dwElements, lpDest, dwMaxBytes, 0);
+    if (dwBytes)
         retVal = (Write(lpDest, dwBytes) == dwBytes);
     else
         Log(TEXT("XFile::WriteAsUTF8: wchar_to_utf8 failed: %d"), GetLastError());
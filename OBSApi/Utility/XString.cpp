@@ -48,100 +48,62 @@
 
 String::String()
 {
-    curLength = 0;
+    curLength = capacity = 0;
     lpString = NULL;
 }
 
 String::String(LPCSTR str)
 {
-#ifdef UNICODE
+    curLength = capacity = 0;
+    lpString = NULL;
+
     if(!str)
-    {
-        curLength = 0;
-        lpString = NULL;
         return;
-    }
 
+#ifdef UNICODE
     size_t utf8Len = strlen(str);
-    curLength = (UINT)utf8_to_wchar_len(str, utf8Len, 0);
+    UINT length = (UINT)utf8_to_wchar_len(str, utf8Len, 0);
 
-    if(curLength)
+    if(length)
     {
-        lpString = (TSTR)Allocate((curLength+1)*sizeof(wchar_t));
-        utf8_to_wchar(str, utf8Len+1, lpString, curLength+1, 0);
+        TSTR lpDest = MakeRoom(length, false);
+        utf8_to_wchar(str, utf8Len+1, lpDest, length+1, 0);
+        curLength = length;
     }
-    else
-        lpString = NULL;
 #else
-    if(!str)
-    {
-        curLength = 0;
-        lpString = NULL;
-        return;
-    }
-
-    curLength = slen(str);
-
-    if(curLength)
-    {
-        lpString = (TSTR)Allocate(curLength+1);
-        scpy(lpString, str);
-    }
-    else
-        lpString = NULL;
+    Assign(str, slen(str));
 #endif
 }
 
 String::String(CWSTR str)
 {
-#ifdef UNICODE
-    if(!str)
-    {
-        curLength = 0;
-        lpString = NULL;
-        return;
-    }
-
-    curLength = slen(str);
+    curLength = capacity = 0;
+    lpString = NULL;
 
-    if(curLength)
-    {
-        lpString = (TSTR)Allocate((curLength+1)*sizeof(TCHAR));
-        scpy(lpString, str);
-    }
-    else
-        lpString = NULL;
-#else
     if(!str)
-    {
-        curLength = 0;
-        lpString = NULL;
         return;
-    }
 
+#ifdef UNICODE
+    Assign(str, slen(str));
+#else
     size_t wideLen = wcslen(str);
-    curLength = (UINT)wchar_to_utf8_len(str, wideLen, 0);
+    UINT length = (UINT)wchar_to_utf8_len(str, wideLen, 0);
 
-    if(curLength)
+    if(length)
     {
-        lpString = (TSTR)Allocate(curLength+1);
-        wchar_to_utf8(str, wideLen+1, lpString, curLength+1, 0);
+        TSTR lpDest = MakeRoom(length, false);
+        wchar_to_utf8(str, wideLen+1, lpDest, length+1, 0);
+        curLength = length;
     }
-    else
-        lpString = NULL;
 #endif
 }
 
 String::String(const String &str)
 {
-    curLength = str.curLength;
-    if(curLength)
-    {
-        lpString = (TSTR)Allocate((curLength+1)*sizeof(TCHAR));
-        scpy(lpString, str.lpString);
-    }
-    else
-        lpString = NULL;
+    curLength = capacity = 0;
+    lpString = NULL;
+
+    Assign(str.Array(), str.curLength);
 }
 
 
@@ -152,65 +114,78 @@ String::~String()
 }
 
 
-String& String::operator=(CTSTR str)
+//makes sure there's room for length characters plus the null, keeping the current contents.
+//with bGrow the heap buffer grows by half again, so appending in a loop is linear rather than quadratic
+TSTR String::MakeRoom(unsigned int length, bool bGrow)
 {
-    if(!str)
-        curLength = 0;
-    else
-        curLength = slen(str);
+    if(lpString && length <= capacity)
+        return lpString;
 
-    if(curLength)
+    unsigned int newCapacity = length;
+    if(bGrow && lpString)
     {
-        lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
-        scpy(lpString, str);
-    }
-    else
-    {
-        if(lpString)
-            Free(lpString);
-        lpString = NULL;
+        unsigned int grownCapacity = capacity+(capacity>>1);
+        if(grownCapacity > newCapacity)
+            newCapacity = grownCapacity;
     }
 
-    return *this;
+    lpString = (TSTR)ReAllocate(lpString, (newCapacity+1)*sizeof(TCHAR));
+
+    capacity = newCapacity;
+    return lpString;
 }
 
-String& String::operator+=(CTSTR str)
+String& String::Assign(CTSTR str, unsigned int length)
 {
-    UINT strLength;
-    
-    if(!str)
-        strLength = 0;
-    else
-        strLength = slen(str);
+    if(!length)
+        return Clear();
+
+    //the source can't be inside our own buffer if the buffer has to move, so a move is only needed
+    //for the case where it stays put
+    TSTR lpDest = MakeRoom(length, false);
+    memmove(lpDest, str, length*sizeof(TCHAR));
+    lpDest[length] = 0;
+    curLength = length;
 
-    if(!strLength)
+    return *this;
+}
+
+String& String::Append(CTSTR str, unsigned int length)
+{
+    if(!length)
         return *this;
 
-    curLength += strLength;
+    TSTR lpOld = Array();
+    bool bSelf = lpOld && str >= lpOld && str <= lpOld+curLength;
+    UINT offset = bSelf ? UINT(str-lpOld) : 0;
 
-    if(curLength)
-    {
-        if(lpString)
-        {
-            lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
-            scat(lpString, str);
-        }
-        else
-        {
-            lpString = (TSTR)Allocate((curLength+1)*sizeof(TCHAR));
-            scpy(lpString, str);
-        }
-    }
-    else
-    {
-        if(lpString)
-            Free(lpString);
-        lpString = NULL;
-    }
+    TSTR lpDest = MakeRoom(curLength+length, true);
+    if(bSelf)
+        str = lpDest+offset;
+
+    mcpy(lpDest+curLength, str, length*sizeof(TCHAR));
+    curLength += length;
+    lpDest[curLength] = 0;
 
     return *this;
 }
 
+void String::Reserve(UINT length)
+{
+    MakeRoom(length, false);
+}
+
+
+String& String::operator=(CTSTR str)
+{
+    return Assign(str, str ? slen(str) : 0);
+}
+
+String& String::operator+=(CTSTR str)
+{
+    return Append(str, str ? slen(str) : 0);
+}
+
 String  String::operator+(CTSTR str) const
 {
     return (String(*this) += str);
@@ -219,20 +194,19 @@ String  String::operator+(CTSTR str) const
 
 String& String::operator=(TCHAR ch)
 {
+    TSTR lpDest = MakeRoom(1, false);
+    lpDest[0] = ch;
+    lpDest[1] = 0;
     curLength = 1;
-    lpString = (TSTR)ReAllocate(lpString, 2);
-    *lpString = ch;
-    lpString[1] = 0;
 
     return *this;
 }
 
 String& String::operator+=(TCHAR ch)
 {
-    ++curLength;
-    lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
-    lpString[curLength-1] = ch;
-    lpString[curLength]   = 0;
+    TSTR lpDest = MakeRoom(curLength+1, true);
+    lpDest[curLength++] = ch;
+    lpDest[curLength]   = 0;
 
     return *this;
 }
@@ -294,51 +268,15 @@ String  String::operator+(unsigned int unumber) const
 
 String& String::operator=(const String &str)
 {
-    curLength = str.curLength;
-
-    if(curLength)
-    {
-        lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
-        scpy(lpString, str.lpString);
-    }
-    else
-    {
-        if(lpString)
-            Free(lpString);
-        lpString = NULL;
-    }
+    if(&str == this)
+        return *this;
 
-    return *this;
+    return Assign(str.Array(), str.curLength);
 }
 
 String& String::operator+=(const String &str)
 {
-    if(!str.curLength)
-        return *this;
-
-    curLength += str.curLength;
-
-    if(curLength)
-    {
-        if(lpString)
-        {
-            lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
-            scat(lpString, str.lpString);
-        }
-        else
-        {
-            lpString = (TSTR)Allocate((curLength+1)*sizeof(TCHAR));
-            scpy(lpString, str.lpString);
-        }
-    }
-    else
-    {
-        if(lpString)
-            Free(lpString);
-        lpString = NULL;
-    }
-
-    return *this;
+    return Append(str.Array(), str.curLength);
 }
 
 String  String::operator+(const String &str) const
@@ -385,12 +323,12 @@ String& String::operator<<(const String &str)
 
 BOOL String::Compare(CTSTR str) const
 {
-    if(lpString)
+    if(curLength)
     {
         if(!str)
-            return (lpString[0] == 0);
+            return FALSE;
 
-        return scmp(lpString, str) == 0;
+        return scmp(Array(), str) == 0;
     }
     else
     {
@@ -400,12 +338,12 @@ BOOL String::Compare(CTSTR str) const
 
 BOOL String::CompareI(CTSTR str) const
 {
-    if(lpString)
+    if(curLength)
     {
         if(!str)
-            return (lpString[0] == 0);
+            return FALSE;
 
-        return scmpi(lpString, str) == 0;
+        return scmpi(Array(), str) == 0;
     }
     else
     {
@@ -416,84 +354,86 @@ BOOL String::CompareI(CTSTR str) const
 
 LPSTR String::CreateUTF8String()
 {
-    return (!lpString) ? NULL : tstr_createUTF8(lpString);
+    return (!curLength) ? NULL : tstr_createUTF8(Array());
 }
 
 
+//one pass over the string: replacements that don't make it longer are done in place, otherwise the
+//result is built once in a new buffer sized from the number of matches
 String& String::FindReplace(CTSTR strFind, CTSTR strReplace)
 {
-    if(!lpString)
+    if(!curLength || !strFind || !*strFind)
         return *this;
 
     if(!strReplace) strReplace = TEXT("");
 
-    int findLen = slen(strFind), replaceLen = slen(strReplace);
-    TSTR lpTemp = lpString;
+    UINT findLen = slen(strFind), replaceLen = slen(strReplace);
+    TSTR lpSrc = Array();
 
-    if(replaceLen < findLen)
-    {
-        int nOccurences = 0;
+    TSTR lpFound = sstr(lpSrc, strFind);
+    if(!lpFound)
+        return *this;
 
-        while(lpTemp = sstr(lpTemp, strFind))
+    if(replaceLen == findLen)
+    {
+        while(lpFound)
         {
-            TSTR lpEndSegment = lpTemp+findLen;
-            UINT endLen = slen(lpEndSegment);
-
-            if(endLen)
-            {
-                mcpy(lpTemp+replaceLen, lpEndSegment, (endLen+1)*sizeof(TCHAR));
-                mcpy(lpTemp, strReplace, replaceLen*sizeof(TCHAR));
-            }
-            else
-                scpy(lpTemp, strReplace);
-
-            lpTemp += replaceLen;
-            ++nOccurences;
+            mcpy(lpFound, strReplace, replaceLen*sizeof(TCHAR));
+            lpFound = sstr(lpFound+replaceLen, strFind);
         }
-
-        if(nOccurences)
-            curLength += (replaceLen-findLen)*nOccurences;
     }
-    else if(replaceLen == findLen)
+    else if(replaceLen < findLen)
     {
-        while(lpTemp = sstr(lpTemp, strFind))
+        TSTR lpOut = lpFound, lpIn = lpFound;
+
+        while(lpFound)
         {
-            mcpy(lpTemp, strReplace, replaceLen*sizeof(TCHAR));
-            lpTemp += replaceLen;
+            UINT segmentLen = UINT(lpFound-lpIn);
+            memmove(lpOut, lpIn, segmentLen*sizeof(TCHAR));
+            lpOut += segmentLen;
+
+            mcpy(lpOut, strReplace, replaceLen*sizeof(TCHAR));
+            lpOut += replaceLen;
+
+            lpIn = lpFound+findLen;
+            lpFound = sstr(lpIn, strFind);
         }
+
+        UINT endLen = UINT((lpSrc+curLength)-lpIn);
+        memmove(lpOut, lpIn, (endLen+1)*sizeof(TCHAR));
+
+        curLength = UINT(lpOut-lpSrc)+endLen;
     }
     else
     {
-        int nOccurences = 0;
-
-        while(lpTemp = sstr(lpTemp, strFind))
-        {
-            lpTemp += findLen;
+        UINT nOccurences = 0;
+        for(TSTR lpTemp = lpFound; lpTemp; lpTemp = sstr(lpTemp+findLen, strFind))
             ++nOccurences;
-        }
 
-        if(nOccurences)
+        UINT newLength = curLength + (replaceLen-findLen)*nOccurences;
+        TSTR lpNew = (TSTR)Allocate((newLength+1)*sizeof(TCHAR));
+        TSTR lpOut = lpNew, lpIn = lpSrc;
+
+        while(lpFound)
         {
-            curLength += (replaceLen-findLen)*nOccurences;
+            UINT segmentLen = UINT(lpFound-lpIn);
+            mcpy(lpOut, lpIn, segmentLen*sizeof(TCHAR));
+            lpOut += segmentLen;
 
-            lpTemp = lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
+            mcpy(lpOut, strReplace, replaceLen*sizeof(TCHAR));
+            lpOut += replaceLen;
 
-            while(lpTemp = sstr(lpTemp, strFind))
-            {
-                TSTR lpEndSegment = lpTemp+findLen;
-                UINT endLen = slen(lpEndSegment);
-
-                if(endLen)
-                {
-                    mcpyrev(lpTemp+replaceLen, lpEndSegment, (endLen+1)*sizeof(TCHAR));
-                    mcpy(lpTemp, strReplace, replaceLen*sizeof(TCHAR));
-                }
-                else
-                    scpy(lpTemp, strReplace);
-
-                lpTemp += replaceLen;
-            }
+            lpIn = lpFound+findLen;
+            lpFound = sstr(lpIn, strFind);
         }
+
+        mcpy(lpOut, lpIn, (UINT((lpSrc+curLength)-lpIn)+1)*sizeof(TCHAR));
+
+        if(lpString)
+            Free(lpString);
+
+        lpString = lpNew;
+        capacity = curLength = newLength;
     }
 
     return *this;
@@ -516,9 +456,9 @@ void String::InsertString(UINT dwPos, CTSTR str)
 
     if(strLength)
     {
-        lpString = (TSTR)ReAllocate(lpString, (curLength+strLength+1)*sizeof(TCHAR));
+        TSTR lpDest = MakeRoom(curLength+strLength, true);
 
-        TSTR lpPos = lpString+dwPos;
+        TSTR lpPos = lpDest+dwPos;
         mcpyrev(lpPos+strLength, lpPos, ((curLength+1)-dwPos)*sizeof(TCHAR));
         mcpy(lpPos, str, strLength*sizeof(TCHAR));
 
@@ -528,47 +468,32 @@ void String::InsertString(UINT dwPos, CTSTR str)
 
 String& String::AppendString(CTSTR str, UINT count)
 {
-    UINT strLength;
-    
+    UINT strLength = 0;
+
     if(!str)
         strLength = 0;
     else if(count)
-        strLength = MIN(slen(str), count);
-    else
-        strLength = slen(str);
-
-    if(!strLength)
-        return *this;
-
-    UINT oldLen = curLength;
-
-    curLength += strLength;
-
-    if(curLength)
     {
-        lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
-        scpy_n(lpString+oldLen, str, strLength);
+        while(strLength < count && str[strLength])
+            ++strLength;
     }
     else
-    {
-        if(lpString)
-            Free(lpString);
-        lpString = NULL;
-    }
+        strLength = slen(str);
 
-    return *this;
+    return Append(str, strLength);
 }
 
 UINT String::GetLinePos(UINT dwLine)
 {
-    assert(lpString);
-    if(!lpString)
+    assert(curLength);
+    if(!curLength)
         return 0;
 
     if(!dwLine)
         return 0;
 
-    TSTR lpTemp = lpString;
+    TSTR lpStart = Array();
+    TSTR lpTemp = lpStart;
 
     for(UINT i=0; i<dwLine; i++)
     {
@@ -579,7 +504,7 @@ UINT String::GetLinePos(UINT dwLine)
         lpTemp = lpNewLine+1;
     }
 
-    return UINT(lpTemp-lpString);
+    return UINT(lpTemp-lpStart);
 }
 
 String& String::Clear()
@@ -587,7 +512,7 @@ String& String::Clear()
     if(lpString)
         Free(lpString);
     lpString = NULL;
-    curLength = 0;
+    curLength = capacity = 0;
 
     return *this;
 }
@@ -611,7 +536,7 @@ int String::NumTokens(TCHAR token) const
     if(IsEmpty())
         return 0;
 
-    TSTR lpTemp = lpString;
+    TSTR lpTemp = Array();
     UINT count = 0;
 
     while(lpTemp = schr(lpTemp, token))
@@ -625,7 +550,7 @@ int String::NumTokens(TCHAR token) const
 
 String String::GetToken(int id, TCHAR token) const
 {
-    TSTR lpTemp = lpString;
+    TSTR lpTemp = Array();
     UINT curTokenID = 0;
 
     do
@@ -648,13 +573,13 @@ String String::GetToken(int id, TCHAR token) const
         ++curTokenID;
     } while((lpTemp = schr(lpTemp, token)+1) != (TSTR)sizeof(TCHAR));
 
-    AppWarning(TEXT("Bad String token, token %d, seperator '%c', string \"%s\""), id, token, lpString);
+    AppWarning(TEXT("Bad String token, token %d, seperator '%c', string \"%s\""), id, token, Array());
     return String();
 }
 
 void String::GetTokenList(StringList &strList, TCHAR token, BOOL bIncludeEmpty) const
 {
-    TSTR lpTemp = lpString;
+    TSTR lpTemp = Array();
 
     do
     {
@@ -677,7 +602,7 @@ void String::GetTokenList(StringList &strList, TCHAR token, BOOL bIncludeEmpty)
 
 CTSTR String::GetTokenOffset(int token, TCHAR seperator) const
 {
-    TSTR lpTemp = lpString;
+    TSTR lpTemp = Array();
     UINT curToken = 0;
 
     do
@@ -710,12 +635,13 @@ String  String::Mid(UINT iStart, UINT iEnd)
     if( (iStart >= curLength) ||
         (iEnd > curLength || iEnd <= iStart)   )
     {
-        AppWarning(TEXT("Bad call to String::Mid.  iStart or iEnd is bigger than the current length (string: %s)."), lpString);
+        AppWarning(TEXT("Bad call to String::Mid.  iStart or iEnd is bigger than the current length (string: %s)."), Array());
         return String();
     }
 
-    String newString = lpString+iStart;
-    return newString.SetLength(iEnd-iStart);
+    String newString;
+    newString.Assign(Array()+iStart, iEnd-iStart);
+    return newString;
 }
 
 String  String::Right(UINT iOffset)
@@ -726,30 +652,23 @@ String  String::Right(UINT iOffset)
         return String();
     }
 
-    return String((lpString+curLength)-iOffset);
+    return String((Array()+curLength)-iOffset);
 }
 
 
 String& String::SetLength(UINT length)
 {
-    UINT oldLength = curLength;
+    if(!length)
+        return Clear();
 
-    curLength = length;
-    if(curLength)
-    {
-        lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
+    TSTR lpDest = MakeRoom(length, false);
 
-        if(oldLength < curLength)
-            zero(&lpString[oldLength], ((curLength+1)-oldLength)*sizeof(TCHAR));
-        else
-            lpString[length] = 0;
-    }
+    if(curLength < length)
+        zero(&lpDest[curLength], ((length+1)-curLength)*sizeof(TCHAR));
     else
-    {
-        if(lpString)
-            Free(lpString);
-        lpString = NULL;
-    }
+        lpDest[length] = 0;
+
+    curLength = length;
 
     return *this;
 }
@@ -768,10 +687,10 @@ void String::RemoveRange(unsigned int from, unsigned int to)
         return;
     }
 
+    TSTR lpStr = Array();
     unsigned int remainderLength = (curLength+1)-to;
     curLength -= delLength;
-    mcpy(lpString+from, lpString+to, remainderLength*sizeof(TCHAR));
-    lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
+    memmove(lpStr+from, lpStr+to, remainderLength*sizeof(TCHAR));
 }
 
 
@@ -787,13 +706,13 @@ String& String::InsertChar(UINT pos, TCHAR chr)
         AppWarning(TEXT("String::InsertChar - bad index specified"));
         return *this;
     }
-    
-    ++curLength;
-    lpString = (TSTR)ReAllocate(lpString, (curLength+1)*sizeof(TCHAR));
-    if(curLength > 1)
-        mcpyrev(lpString+pos+1, lpString+pos, (curLength-pos)*sizeof(TCHAR));
 
-    lpString[pos] = chr;
+    TSTR lpDest = MakeRoom(curLength+1, true);
+    if(pos < curLength)
+        mcpyrev(lpDest+pos+1, lpDest+pos, (curLength-pos)*sizeof(TCHAR));
+
+    lpDest[pos] = chr;
+    lpDest[++curLength] = 0;
 
     return *this;
 }
@@ -811,9 +730,8 @@ String& String::RemoveChar(UINT pos)
         Clear();
     else
     {
-        if(pos < curLength)
-            mcpy(lpString+pos, lpString+pos+1, (curLength-pos)*sizeof(TCHAR));
-        lpString = (TSTR)ReAllocate(lpString, (curLength)*sizeof(TCHAR));
+        TSTR lpStr = Array();
+        memmove(lpStr+pos, lpStr+pos+1, (curLength-pos)*sizeof(TCHAR));
         --curLength;
     }
 
@@ -853,39 +771,148 @@ String String::StringToRepresentation(String &string)
     return stringOut;
 }
 
-String FormattedStringva(CTSTR lpFormat, va_list arglist)
+
+/*========================================================
+  StringBuilder
+=========================================================*/
+
+//like vtsprintf_s, but returns -1 instead of going to the invalid parameter handler when it doesn't fit
+static inline int vtsprintf_trunc(TCHAR *pDest, size_t bufLen, const TCHAR *format, va_list args)
+{
+#ifdef UNICODE
+    return _vsnwprintf_s(pDest, bufLen, _TRUNCATE, format, args);
+#else
+    return _vsnprintf_s(pDest, bufLen, _TRUNCATE, format, args);
+#endif
+}
+
+TSTR StringBuilder::MakeRoom(UINT length)
+{
+    if(lpBuffer && length <= capacity)
+        return lpBuffer;
+
+    UINT newCapacity = MAX(capacity*2, 255);
+    if(newCapacity < length)
+        newCapacity = length;
+
+    if(lpBuffer && lpBuffer != lpScratch)
+        lpBuffer = (TSTR)ReAllocate(lpBuffer, (newCapacity+1)*sizeof(TCHAR));
+    else
+    {
+        TSTR lpNewBuffer = (TSTR)Allocate((newCapacity+1)*sizeof(TCHAR));
+        if(lpBuffer)
+            mcpy(lpNewBuffer, lpBuffer, (curLength+1)*sizeof(TCHAR));
+        else
+            *lpNewBuffer = 0;
+
+        lpBuffer = lpNewBuffer;
+    }
+
+    capacity = newCapacity;
+    return lpBuffer;
+}
+
+StringBuilder& StringBuilder::Append(CTSTR str, UINT length)
+{
+    if(!length)
+        return *this;
+
+    TSTR lpDest = MakeRoom(curLength+length);
+    mcpy(lpDest+curLength, str, length*sizeof(TCHAR));
+    curLength += length;
+    lpDest[curLength] = 0;
+
+    return *this;
+}
+
+StringBuilder& StringBuilder::operator<<(TCHAR ch)
 {
+    TSTR lpDest = MakeRoom(curLength+1);
+    lpDest[curLength++] = ch;
+    lpDest[curLength]   = 0;
+
+    return *this;
+}
+
+StringBuilder& StringBuilder::operator<<(int number)
+{
+    TCHAR strNum[16];
+    itots_s(number, strNum, 15, 10);
+
+    return Append(strNum, slen(strNum));
+}
+
+StringBuilder& StringBuilder::operator<<(unsigned int unumber)
+{
+    TCHAR strNum[16];
+    uitots_s(unumber, strNum, 15, 10);
+
+    return Append(strNum, slen(strNum));
+}
+
+StringBuilder& StringBuilder::AppendFormatva(CTSTR lpFormat, va_list arglist)
+{
+    if(lpBuffer && curLength < capacity)
+    {
+        int retVal = vtsprintf_trunc(lpBuffer+curLength, (capacity-curLength)+1, lpFormat, arglist);
+        if(retVal >= 0)
+        {
+            curLength += retVal;
+            return *this;
+        }
+
+        lpBuffer[curLength] = 0;
+    }
+
     int iSize = vtscprintf(lpFormat, arglist);
-    if(!iSize)
-        return String();
+    if(iSize <= 0)
+        return *this;
 
-    String newString;
-    newString.SetLength(iSize);
+    TSTR lpDest = MakeRoom(curLength+iSize);
 
-    int retVal = vtsprintf_s(newString, iSize+1, lpFormat, arglist);
-    if(retVal == -1)
-        return newString.Clear();
+    int retVal = vtsprintf_s(lpDest+curLength, iSize+1, lpFormat, arglist);
+    if(retVal > 0)
+        curLength += retVal;
     else
-        return newString.SetLength(retVal);
+        lpDest[curLength] = 0;
+
+    return *this;
 }
 
-String FormattedString(CTSTR lpFormat, ...)
+StringBuilder& StringBuilder::AppendFormat(CTSTR lpFormat, ...)
 {
     va_list args;
     va_start(args, lpFormat);
 
-    int iSize = vtscprintf(lpFormat, args);
-    if(!iSize)
-        return String();
+    return AppendFormatva(lpFormat, args);
+}
 
-    String newString;
-    newString.SetLength(iSize);
+String StringBuilder::ToString() const
+{
+    String str;
+    str.AppendString(Array(), curLength);
+    return str;
+}
 
-    int retVal = vtsprintf_s(newString, iSize+1, lpFormat, args);
-    if(retVal == -1)
-        return newString.Clear();
-    else
-        return newString.SetLength(retVal);
+
+String FormattedStringva(CTSTR lpFormat, va_list arglist)
+{
+    //most formatted strings are short, so they're printed once into a per-thread buffer and copied
+    //from there, instead of being measured first and then printed a second time
+    __declspec(thread) static TCHAR formatBuffer[1024];
+
+    StringBuilder builder(formatBuffer, _countof(formatBuffer));
+    builder.AppendFormatva(lpFormat, arglist);
+
+    return builder.ToString();
+}
+
+String FormattedString(CTSTR lpFormat, ...)
+{
+    va_list args;
+    va_start(args, lpFormat);
+
+    return FormattedStringva(lpFormat, args);
 }
 
 int STDCALL GetStringLine(const TCHAR *lpStart, const TCHAR *lpOffset)
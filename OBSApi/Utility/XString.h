@@ -74,10 +74,18 @@ BASE_EXPORT UINT64          tstoui64(TCHAR *lpInt);
 
 class StringList;
 
+//short strings are on the heap as well, FastAlloc hands them out of its small block pools.  there's no inline
+//buffer:  plugins inline Array() and operator TSTR as a read of lpString, and List moves Strings with a plain
+//memory copy, so a pointer into an inline buffer would dangle whenever its list moved
 class BASE_EXPORT String
 {
     TSTR lpString;
     unsigned int curLength;
+    unsigned int capacity;
+
+    TSTR MakeRoom(unsigned int length, bool bGrow);
+    String& Assign(CTSTR str, unsigned int length);
+    String& Append(CTSTR str, unsigned int length);
 
 public:
     String();
@@ -140,6 +148,10 @@ public:
 
     String& Clear();
 
+    //makes room for at least length characters without changing the contents
+    void    Reserve(UINT length);
+    inline UINT Capacity() const                {return capacity;}
+
     String& GroupDigits();
 
     int     NumTokens(TCHAR token=' ') const;
@@ -192,6 +204,55 @@ public:
     BASE_EXPORT friend Serializer& operator<<(Serializer &s, String &str);
 };
 
+//growable text buffer for building a string piece by piece.  it can start out in a buffer supplied
+//by the caller (a stack or thread-local array) and only allocates once the text outgrows it.
+//AppendFormat prints straight into the free space, so it only formats twice when that's too small.
+class BASE_EXPORT StringBuilder
+{
+    TSTR lpBuffer;
+    TSTR lpScratch;
+    UINT curLength;
+    UINT capacity;
+
+    TSTR MakeRoom(UINT length);
+
+    StringBuilder(const StringBuilder&);
+    StringBuilder& operator=(const StringBuilder&);
+
+public:
+    inline StringBuilder() : lpBuffer(NULL), lpScratch(NULL), curLength(0), capacity(0) {}
+    inline StringBuilder(TSTR lpScratchBuffer, UINT scratchSize)
+        : lpBuffer(lpScratchBuffer), lpScratch(lpScratchBuffer), curLength(0), capacity(scratchSize-1)
+    {
+        *lpBuffer = 0;
+    }
+
+    inline ~StringBuilder()
+    {
+        if(lpBuffer && lpBuffer != lpScratch)
+            Free(lpBuffer);
+    }
+
+    StringBuilder& Append(CTSTR str, UINT length);
+
+    inline StringBuilder& operator<<(CTSTR str)             {return str ? Append(str, slen(str)) : *this;}
+    inline StringBuilder& operator<<(const String &str)     {return Append(str.Array(), str.Length());}
+    StringBuilder& operator<<(TCHAR ch);
+    StringBuilder& operator<<(int number);
+    StringBuilder& operator<<(unsigned int unumber);
+
+    StringBuilder& AppendFormat(CTSTR lpFormat, ...);
+    StringBuilder& AppendFormatva(CTSTR lpFormat, va_list arglist);
+
+    //keeps the buffer, so it can be reused without allocating again
+    inline void    Clear()                  {curLength = 0; if(lpBuffer) *lpBuffer = 0;}
+
+    inline CTSTR   Array() const            {return lpBuffer ? lpBuffer : TEXT("");}
+    inline UINT    Length() const           {return curLength;}
+
+    String ToString() const;
+};
+
 BASE_EXPORT String FormattedStringva(CTSTR lpFormat, va_list arglist);
 BASE_EXPORT String FormattedString(CTSTR lpFormat, ...);
 WORD StringCRC16(CTSTR lpData);
@@ -125,6 +125,7 @@ void STDCALL TerminateXT()
         StringLog.Stop();
 
         FreeProfileData();
+        FreeTimeline();
 
         delete locale;
         locale = NULL;
@@ -251,19 +252,36 @@ void __cdecl Logva(const TCHAR *format, va_list argptr)
     OSDebugOut(L"\n");
 #endif
 
+    //the line is put together in a per-thread buffer, so ordinary log lines don't allocate
+    __declspec(thread) static TCHAR logBuffer[1024];
+
     String strCurTime = CurrentTimeString();
     strCurTime << TEXT(": ");
-    String strOut = strCurTime;
-    strOut << FormattedStringva(format, argptr);
 
-    strOut.FindReplace(TEXT("\n"), String() << TEXT("\n") << strCurTime);
+    StringBuilder line(logBuffer, _countof(logBuffer));
+    line << strCurTime;
+    line.AppendFormatva(format, argptr);
+
+    CTSTR lpOut = line.Array();
+    UINT outLen = line.Length();
+
+    //multi-line messages get the time stamp on every line
+    String strOut;
+    if(schr(lpOut+strCurTime.Length(), '\n'))
+    {
+        strOut = lpOut;
+        strOut.FindReplace(TEXT("\n"), String() << TEXT("\n") << strCurTime);
+
+        lpOut = strOut;
+        outLen = strOut.Length();
+    }
 
     OpenLogFile();
-    LogFile.WriteAsUTF8(strOut, strOut.Length());
+    LogFile.WriteAsUTF8(lpOut, outLen);
     LogFile.WriteAsUTF8(TEXT("\r\n"));
     CloseLogFile();
 
-    StringLog.Append(strOut);
+    StringLog.Append(lpOut, outLen);
 }
 
 void __cdecl Log(const TCHAR *format, ...)
@@ -152,6 +152,8 @@ BASE_EXPORT int    STDCALL OSGetTotalCores();
 BASE_EXPORT int    STDCALL OSGetLogicalCores();
 BASE_EXPORT HANDLE STDCALL OSCreateThread(XTHREAD lpThreadFunc, LPVOID param);
 BASE_EXPORT HANDLE STDCALL OSGetCurrentThread();
+BASE_EXPORT DWORD  STDCALL OSGetCurrentThreadID();
+BASE_EXPORT BOOL   STDCALL OSIsThreadRunning(DWORD threadID);
 BASE_EXPORT BOOL   STDCALL OSWaitForThread(HANDLE hThread, LPDWORD ret);
 BASE_EXPORT BOOL   STDCALL OSCloseThread(HANDLE hThread);
 BASE_EXPORT BOOL   STDCALL OSTerminateThread(HANDLE hThread, DWORD waitMS=100);
@@ -162,6 +164,9 @@ BASE_EXPORT BOOL   STDCALL OSTryEnterMutex(HANDLE hMutex);
 BASE_EXPORT void   STDCALL OSLeaveMutex(HANDLE hMutex);
 BASE_EXPORT void   STDCALL OSCloseMutex(HANDLE hMutex);
 
+BASE_EXPORT HANDLE STDCALL OSCreateEvent(BOOL bManualReset=FALSE);
+BASE_EXPORT void   STDCALL OSSetEvent(HANDLE hEvent);
+BASE_EXPORT BOOL   STDCALL OSWaitForEvent(HANDLE hEvent, DWORD waitMS=WAIT_INFINITE); //FALSE on timeout
 BASE_EXPORT void           OSCloseEvent(HANDLE event);
 
 BASE_EXPORT void   STDCALL OSSetMainAppWindow(HANDLE window);
@@ -169,6 +174,8 @@ BASE_EXPORT void   STDCALL OSSetMainAppWindow(HANDLE window);
 BASE_EXPORT DWORD  STDCALL OSGetTime();
 BASE_EXPORT QWORD  STDCALL OSGetTimeMicroseconds();
 BASE_EXPORT QWORD  STDCALL OSGetThreadTime(HANDLE hThread);
+BASE_EXPORT QWORD  STDCALL OSGetPerformanceCounter();
+BASE_EXPORT QWORD  STDCALL OSGetPerformanceFrequency();
 
 BASE_EXPORT void __cdecl   OSMessageBoxva(const TCHAR *format, va_list argptr);
 BASE_EXPORT void __cdecl   OSMessageBox(const TCHAR *format, ...);
@@ -22,209 +22,100 @@
 
 
 
-struct StringLookupNode
-{
-    String str;
-    List<StringLookupNode*> subNodes;
-    LocaleStringItem *leaf;
+LocaleStringLookup *locale=NULL;
 
-    inline ~StringLookupNode()
-    {
-        for(unsigned int i=0; i<subNodes.Num(); i++)
-            delete subNodes[i];
-    }
 
-    inline StringLookupNode* FindSubNodeByChar(TCHAR ch)
-    {
-        for(unsigned int i=0; i<subNodes.Num(); i++)
-        {
-            StringLookupNode *node = subNodes[i];
-            if(node->str.IsValid() && node->str[0] == ch)
-                return subNodes[i];
-        }
 
-        return NULL;
-    }
+UINT STDCALL LocaleHash(CTSTR lookupVal)
+{
+    UINT hash = 2166136261;
 
-    inline UINT FindSubNodeID(CTSTR lpLookup)
+    if(lookupVal)
     {
-        for(unsigned int i=0; i<subNodes.Num(); i++)
-        {
-            StringLookupNode *node = subNodes[i];
-            if(scmpi_n(node->str, lpLookup, node->str.Length()) == 0)
-                return i;
-        }
-
-        return INVALID;
+        while(*lookupVal)
+            hash = (hash ^ LocaleFoldChar(*(lookupVal++))) * 16777619;
     }
 
-    inline StringLookupNode* FindSubNode(CTSTR lpLookup)
-    {
-        for(unsigned int i=0; i<subNodes.Num(); i++)
-        {
-            StringLookupNode *node = subNodes[i];
-            if(scmpi_n(node->str, lpLookup, node->str.Length()) == 0)
-                return subNodes[i];
-        }
-
-        return NULL;
-    }
-};
-
-
-LocaleStringLookup *locale=NULL;
-
+    return hash;
+}
 
 
 LocaleStringLookup::LocaleStringLookup()
 {
-    top = new StringLookupNode;
 }
 
 LocaleStringLookup::~LocaleStringLookup()
 {
     cache.Clear();
-    delete top;
 }
 
 
-void LocaleStringLookup::AddLookup(CTSTR lookupVal, LocaleStringItem *item, StringLookupNode *node)
+void LocaleStringLookup::AddToTable(LocaleStringItem *item)
 {
-    if(!node) node = top;
-
-    if(!lookupVal)
-        return;
-
-    if(!*lookupVal)
+    if(cache.Num()*2 > hashTable.Num())
     {
-        delete node->leaf;
-        node->leaf = item;
+        RebuildTable();
         return;
     }
 
-    StringLookupNode *child = node->FindSubNodeByChar(*lookupVal);
+    UINT mask = hashTable.Num()-1;
+    UINT slot = item->hash;
+    while(hashTable[slot & mask])
+        slot++;
 
-    if(child)
-    {
-        UINT len;
+    hashTable[slot & mask] = item;
+}
 
-        for(len=0; len<child->str.Length(); len++)
-        {
-            TCHAR val1 = child->str[len],
-                  val2 = lookupVal[len];
+void LocaleStringLookup::RebuildTable()
+{
+    UINT tableSize = 256;
+    while(tableSize < cache.Num()*2)
+        tableSize <<= 1;
 
-            if((val1 >= 'A') && (val1 <= 'Z'))
-                val1 += 0x20;
-            if((val2 >= 'A') && (val2 <= 'Z'))
-                val2 += 0x20;
+    hashTable.SetSize(tableSize);
+    zero(hashTable.Array(), tableSize*sizeof(LocaleStringItem*));
 
-            if(val1 != val2)
-                break;
-        }
-
-        if(len == child->str.Length())
-            return AddLookup(lookupVal+len, item, child);
-        else
-        {
-            StringLookupNode *childSplit = new StringLookupNode;
-            childSplit->str = child->str.Array()+len;
-            childSplit->leaf = child->leaf;
-            childSplit->subNodes.TransferFrom(child->subNodes);
-
-            child->leaf = NULL;
-            child->str.SetLength(len);
-
-            child->subNodes << childSplit;
-
-            if(lookupVal[len] != 0)
-            {
-                StringLookupNode *newNode = new StringLookupNode;
-                newNode->leaf = item;
-                newNode->str  = lookupVal+len;
-
-                child->subNodes << newNode;
-            }
-            else
-                child->leaf = item;
-        }
-    }
-    else
+    UINT mask = tableSize-1;
+    for(UINT i=0; i<cache.Num(); i++)
     {
-        StringLookupNode *newNode = new StringLookupNode;
-        newNode->leaf = item;
-        newNode->str  = lookupVal;
+        LocaleStringItem *item = cache[i];
+
+        UINT slot = item->hash;
+        while(hashTable[slot & mask])
+            slot++;
 
-        node->subNodes << newNode;
+        hashTable[slot & mask] = item;
     }
 }
 
-void LocaleStringLookup::RemoveLookup(CTSTR lookupVal, StringLookupNode *node)
+LocaleStringItem* LocaleStringLookup::FindItem(CTSTR lookupVal, UINT hash) const
 {
-    if(!node) node = top;
-
-    UINT childID = node->FindSubNodeID(lookupVal);
-    if(childID == INVALID)
-        return;
-
-    StringLookupNode *child = node->subNodes[childID];
+    if(!lookupVal || !hashTable.Num())
+        return NULL;
 
-    lookupVal += child->str.Length();
-    TCHAR ch = *lookupVal;
-    if(ch)
-        RemoveLookup(lookupVal, child);
+    UINT mask = hashTable.Num()-1;
 
-    if(!ch)
-    {
-        if(!child->subNodes.Num())
-        {
-            if(child->leaf)
-            {
-                cache.RemoveItem(child->leaf);
-                delete child->leaf;
-            }
-
-            node->subNodes.Remove(childID);
-            delete child;
-        }
-        else
-        {
-            if(child->leaf)
-            {
-                cache.RemoveItem(child->leaf);
-                delete child->leaf;
-            }
-
-            child->leaf = NULL;
-
-            if(child->subNodes.Num() == 1)
-            {
-                StringLookupNode *subNode = child->subNodes[0];
-
-                child->str += subNode->str;
-                child->leaf = subNode->leaf;
-                child->subNodes.CopyList(subNode->subNodes);
-                subNode->subNodes.Clear();
-                delete subNode;
-            }
-        }
-    }
-    else if(!child->subNodes.Num() && !child->leaf)
+    for(UINT slot=hash; ; slot++)
     {
-        node->subNodes.Remove(childID);
-        delete child;
+        LocaleStringItem *item = hashTable[slot & mask];
+        if(!item)
+            return NULL;
+
+        if(item->hash == hash && item->lookup.CompareI(lookupVal))
+            return item;
     }
+}
 
-    //if not a leaf node and only have one child node, then merge with child node
-    if(!node->leaf && node->subNodes.Num() == 1 && node != top)
-    {
-        StringLookupNode *subNode = node->subNodes[0];
+void LocaleStringLookup::RemoveLookupString(CTSTR lookupVal)
+{
+    LocaleStringItem *item = FindItem(lookupVal, LocaleHash(lookupVal));
+    if(!item)
+        return;
 
-        node->str += subNode->str;
-        node->leaf = subNode->leaf;
-        node->subNodes.CopyList(subNode->subNodes);
-        subNode->subNodes.Clear();
-        delete subNode;
-    }
+    cache.RemoveItem(item);
+    delete item;
+
+    RebuildTable();
 }
 
 //ugh yet more string parsing, you think you escape it for one minute and then bam!  you discover yet more string parsing code needs to be written
@@ -233,11 +124,8 @@ BOOL LocaleStringLookup::LoadStringFile(CTSTR lpFile, bool bClear)
     if(bClear)
     {
         cache.Clear();
-        delete top;
-        top = new StringLookupNode;
+        hashTable.Clear();
     }
-    else if(!top)
-        top = new StringLookupNode;
 
     //------------------------
 
@@ -310,25 +198,6 @@ BOOL LocaleStringLookup::LoadStringFile(CTSTR lpFile, bool bClear)
 }
 
 
-StringLookupNode *LocaleStringLookup::FindNode(CTSTR lookupVal, StringLookupNode *node) const
-{
-    if(!node) node = top;
-
-    StringLookupNode *child = node->FindSubNode(lookupVal);
-    if(child)
-    {
-        lookupVal += child->str.Length();
-        TCHAR ch = *lookupVal;
-        if(ch)
-            return FindNode(lookupVal, child);
-
-        if(child->leaf)
-            return child;
-    }
-
-    return NULL;
-}
-
 void LocaleStringLookup::AddLookupString(CTSTR lookupVal, CTSTR lpVal)
 {
     assert(lookupVal && *lookupVal);
@@ -336,30 +205,35 @@ void LocaleStringLookup::AddLookupString(CTSTR lookupVal, CTSTR lpVal)
     if(!lookupVal || !*lookupVal)
         return;
 
-    StringLookupNode *child = FindNode(lookupVal);
-    if(child)
-        child->leaf->strValue = lpVal;
+    UINT hash = LocaleHash(lookupVal);
+
+    LocaleStringItem *item = FindItem(lookupVal, hash);
+    if(item)
+        item->strValue = lpVal;
     else
     {
-        LocaleStringItem *item = new LocaleStringItem;
+        item = new LocaleStringItem;
         item->lookup = lookupVal;
         item->strValue = lpVal;
+        item->hash = hash;
         cache << item;
 
-        AddLookup(item->lookup, item);
+        AddToTable(item);
     }
 }
 
 CTSTR LocaleStringLookup::LookupString(CTSTR lookupVal)
 {
-    StringLookupNode *child = FindNode(lookupVal);
-    if(!child)
-        return TEXT("(string not found)");
+    return LookupString(lookupVal, LocaleHash(lookupVal));
+}
 
-    if(!child->leaf)
-        return TEXT("(lookup error)");
+CTSTR LocaleStringLookup::LookupString(CTSTR lookupVal, UINT hash)
+{
+    LocaleStringItem *item = FindItem(lookupVal, hash);
+    if(!item)
+        return TEXT("(string not found)");
 
-    return child->leaf->strValue;
+    return item->strValue;
 }
 
 
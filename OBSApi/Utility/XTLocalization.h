@@ -28,6 +28,7 @@ struct LocaleStringItem
 {
     String      lookup;
     String      strValue;
+    UINT        hash;
 };
 
 struct LocaleStringCache : public List<LocaleStringItem*>
@@ -67,7 +68,34 @@ struct LocaleStringCache : public List<LocaleStringItem*>
 };
 
 
-struct StringLookupNode;
+//------------------------------------------------------------------
+// Lookup hashing
+//------------------------------------------------------------------
+
+//lookups are case insensitive (ascii only), so the hash folds case the same way CompareI does
+inline UINT LocaleFoldChar(TCHAR ch) {return ((ch >= 'A') && (ch <= 'Z')) ? UINT(ch+0x20) : UINT(ch);}
+
+BASE_EXPORT UINT STDCALL LocaleHash(CTSTR lookupVal);
+
+//same hash as LocaleHash, unrolled over a string literal so the optimizer folds it down to a
+//constant.  this is what lets Str() skip hashing at runtime
+template<UINT len> struct LocaleLiteralHash
+{
+    static inline UINT Hash(CTSTR lpLiteral)
+    {
+        return (LocaleLiteralHash<len-1>::Hash(lpLiteral) ^ LocaleFoldChar(lpLiteral[len-1])) * 16777619;
+    }
+};
+
+template<> struct LocaleLiteralHash<0>
+{
+    static inline UINT Hash(CTSTR lpLiteral) {return 2166136261;}
+};
+
+template<UINT size> inline UINT LocaleHashLiteral(const TCHAR (&lpLiteral)[size])
+{
+    return LocaleLiteralHash<size-1>::Hash(lpLiteral);
+}
 
 
 //------------------------------------------------------------------
@@ -76,13 +104,15 @@ struct StringLookupNode;
 
 class BASE_EXPORT LocaleStringLookup
 {
-    StringLookupNode *top;
     LocaleStringCache cache;
 
-    void AddLookup(CTSTR lookupVal, LocaleStringItem *item, StringLookupNode *node=NULL);
-    void RemoveLookup(CTSTR lookupVal, StringLookupNode *node=NULL);
+    //open addressed by LocaleStringItem::hash, size is a power of two kept at least twice the item count
+    List<LocaleStringItem*> hashTable;
+
+    void AddToTable(LocaleStringItem *item);
+    void RebuildTable();
 
-    StringLookupNode* FindNode(CTSTR lookupVal, StringLookupNode *node=NULL) const;
+    LocaleStringItem* FindItem(CTSTR lookupVal, UINT hash) const;
 
 public:
     LocaleStringLookup();
@@ -90,12 +120,13 @@ public:
 
     BOOL LoadStringFile(CTSTR lpFile, bool bClear=false);
 
-    inline BOOL HasLookup(CTSTR lookupVal) const {return (FindNode(lookupVal) != NULL);}
+    inline BOOL HasLookup(CTSTR lookupVal) const {return (FindItem(lookupVal, LocaleHash(lookupVal)) != NULL);}
 
     void AddLookupString(CTSTR lookupVal, CTSTR lpVal);
-    inline void RemoveLookupString(CTSTR lookupVal) {RemoveLookup(lookupVal);}
+    void RemoveLookupString(CTSTR lookupVal);
 
     CTSTR LookupString(CTSTR lookupVal);
+    CTSTR LookupString(CTSTR lookupVal, UINT hash);
 
     const LocaleStringCache& GetCache() const {return cache;}
 };
@@ -103,7 +134,7 @@ public:
 
 BASE_EXPORT extern LocaleStringLookup *locale;
 
-#define Str(text) locale->LookupString(TEXT2(text))
+#define Str(text) locale->LookupString(TEXT2(text), LocaleHashLiteral(TEXT2(text)))
 
 inline BOOL  LoadStringFile(CTSTR lpResource)   {return locale->LoadStringFile(lpResource);}
 
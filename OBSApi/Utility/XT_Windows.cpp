@@ -703,6 +703,18 @@ QWORD STDCALL OSGetThreadTime(HANDLE thread)
 #undef TO_QWORD
 }
 
+QWORD STDCALL OSGetPerformanceCounter()
+{
+    LARGE_INTEGER currentTime;
+    QueryPerformanceCounter(&currentTime);
+    return currentTime.QuadPart;
+}
+
+QWORD STDCALL OSGetPerformanceFrequency()
+{
+    return clockFreq.QuadPart;
+}
+
 
 UINT STDCALL OSGetProcessorCount()
 {
@@ -726,6 +738,23 @@ HANDLE STDCALL OSGetCurrentThread()
 	return GetCurrentThread();
 }
 
+DWORD STDCALL OSGetCurrentThreadID()
+{
+    return GetCurrentThreadId();
+}
+
+//a recycled ID can make an exited thread look like it's still running, never the other way around
+BOOL   STDCALL OSIsThreadRunning(DWORD threadID)
+{
+    HANDLE hThread = OpenThread(SYNCHRONIZE, FALSE, threadID);
+    if(!hThread)
+        return FALSE;
+
+    BOOL bRunning = WaitForSingleObject(hThread, 0) == WAIT_TIMEOUT;
+    CloseHandle(hThread);
+    return bRunning;
+}
+
 BOOL   STDCALL OSWaitForThread(HANDLE hThread, LPDWORD ret)
 {
     BOOL bRet = (WaitForSingleObjectEx(hThread, INFINITE, 0) == WAIT_OBJECT_0);
@@ -768,6 +797,21 @@ void OSRaiseException(DWORD code)
     RaiseException(code, EXCEPTION_NONCONTINUABLE, 0, NULL);
 }
 
+HANDLE STDCALL OSCreateEvent(BOOL bManualReset)
+{
+    return CreateEvent(NULL, bManualReset, FALSE, NULL);
+}
+
+void   STDCALL OSSetEvent(HANDLE hEvent)
+{
+    SetEvent(hEvent);
+}
+
+BOOL   STDCALL OSWaitForEvent(HANDLE hEvent, DWORD waitMS)
+{
+    return WaitForSingleObject(hEvent, waitMS) == WAIT_OBJECT_0;
+}
+
 void OSCloseEvent(HANDLE event)
 {
     CloseHandle(event);
@@ -1,24 +1,158 @@
 #define _WIN32_WINDOWS 0x0410
 #define _WIN32_WINNT   0x0403
 #include <windows.h>
+#include <emmintrin.h>
 #include "XT.h"
 
+// Nearly everything that goes through here (log lines, config and scene files) is plain ASCII, so
+// the leading ASCII run is widened/narrowed here 16 characters at a time with SSE2, and only the
+// rest from the first non-ASCII character on is handed to the system converter.  An ASCII byte can
+// never be part of a multi-byte sequence, so splitting there doesn't change the result.
+
+static size_t ascii_to_wchar(const char *in, size_t insize, wchar_t *out, size_t outsize)
+{
+	size_t count = (insize < outsize) ? insize : outsize;
+	size_t i = 0;
+
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i+16 <= count; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(in+i));
+		if (_mm_movemask_epi8(bytes))
+			break;
+
+		_mm_storeu_si128((__m128i*)(out+i),   _mm_unpacklo_epi8(bytes, zero));
+		_mm_storeu_si128((__m128i*)(out+i+8), _mm_unpackhi_epi8(bytes, zero));
+	}
+
+	for (; i < count; i++) {
+		if ((unsigned char)in[i] & 0x80)
+			break;
+
+		out[i] = (wchar_t)in[i];
+	}
+
+	return i;
+}
+
+static size_t ascii_len(const char *in, size_t insize)
+{
+	size_t i = 0;
+
+	for (; i+16 <= insize; i += 16) {
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(in+i))))
+			break;
+	}
+
+	while (i < insize && !((unsigned char)in[i] & 0x80))
+		i++;
+
+	return i;
+}
+
+static size_t wchar_to_ascii(const wchar_t *in, size_t insize, char *out, size_t outsize)
+{
+	size_t count = (insize < outsize) ? insize : outsize;
+	size_t i = 0;
+
+	__m128i highMask = _mm_set1_epi16((short)0xff80);
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i+16 <= count; i += 16) {
+		__m128i lo = _mm_loadu_si128((const __m128i*)(in+i));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(in+i+8));
+
+		__m128i high = _mm_and_si128(_mm_or_si128(lo, hi), highMask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xffff)
+			break;
+
+		_mm_storeu_si128((__m128i*)(out+i), _mm_packus_epi16(lo, hi));
+	}
+
+	for (; i < count; i++) {
+		if (in[i] >= 0x80)
+			break;
+
+		out[i] = (char)in[i];
+	}
+
+	return i;
+}
+
+static size_t wchar_ascii_len(const wchar_t *in, size_t insize)
+{
+	size_t i = 0;
+
+	__m128i highMask = _mm_set1_epi16((short)0xff80);
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i+16 <= insize; i += 16) {
+		__m128i lo = _mm_loadu_si128((const __m128i*)(in+i));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(in+i+8));
+
+		__m128i high = _mm_and_si128(_mm_or_si128(lo, hi), highMask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xffff)
+			break;
+	}
+
+	while (i < insize && in[i] < 0x80)
+		i++;
+
+	return i;
+}
+
 size_t utf8_to_wchar(const char *in, size_t insize, wchar_t *out, size_t outsize, int flags)
 {
-	return (size_t)MultiByteToWideChar(CP_UTF8, 0, in, (int)insize, out, (int)outsize);
+	if (in == NULL || insize == 0 || out == NULL || outsize == 0)
+		return (size_t)MultiByteToWideChar(CP_UTF8, 0, in, (int)insize, out, (int)outsize);
+
+	size_t ascii = ascii_to_wchar(in, insize, out, outsize);
+	if (ascii == insize)
+		return ascii;
+	if (ascii == outsize)
+		return 0; // no space left
+
+	int rest = MultiByteToWideChar(CP_UTF8, 0, in+ascii, (int)(insize-ascii), out+ascii, (int)(outsize-ascii));
+	return rest ? ascii+(size_t)rest : 0;
 }
 
 size_t wchar_to_utf8(const wchar_t *in, size_t insize, char *out, size_t outsize, int flags)
 {
-	return (size_t)WideCharToMultiByte(CP_UTF8, 0, in, (int)insize, out, (int)outsize, NULL, NULL);
+	if (in == NULL || insize == 0 || out == NULL || outsize == 0)
+		return (size_t)WideCharToMultiByte(CP_UTF8, 0, in, (int)insize, out, (int)outsize, NULL, NULL);
+
+	size_t ascii = wchar_to_ascii(in, insize, out, outsize);
+	if (ascii == insize)
+		return ascii;
+	if (ascii == outsize)
+		return 0; // no space left
+
+	int rest = WideCharToMultiByte(CP_UTF8, 0, in+ascii, (int)(insize-ascii), out+ascii, (int)(outsize-ascii), NULL, NULL);
+	return rest ? ascii+(size_t)rest : 0;
 }
 
 size_t utf8_to_wchar_len(const char *in, size_t insize, int flags)
 {
-	return (size_t)MultiByteToWideChar(CP_UTF8, 0, in, (int)insize, NULL, 0);
+	if (in == NULL || insize == 0)
+		return 0;
+
+	size_t ascii = ascii_len(in, insize);
+	if (ascii == insize)
+		return ascii;
+
+	int rest = MultiByteToWideChar(CP_UTF8, 0, in+ascii, (int)(insize-ascii), NULL, 0);
+	return rest ? ascii+(size_t)rest : 0;
 }
 
 size_t wchar_to_utf8_len(const wchar_t *in, size_t insize, int flags)
 {
-	return (size_t)WideCharToMultiByte(CP_UTF8, 0, in, (int)insize, NULL, 0, NULL, NULL);
+	if (in == NULL || insize == 0)
+		return 0;
+
+	size_t ascii = wchar_ascii_len(in, insize);
+	if (ascii == insize)
+		return ascii;
+
+	int rest = WideCharToMultiByte(CP_UTF8, 0, in+ascii, (int)(insize-ascii), NULL, 0, NULL, NULL);
+	return rest ? ascii+(size_t)rest : 0;
 }
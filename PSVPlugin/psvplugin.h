@@ -29,7 +29,7 @@
 #define CONFIG_FILE TEXT("\\psv.ini")
 
 extern LocaleStringLookup *pluginLocale;
-#define PluginStr(text) pluginLocale->LookupString(TEXT2(text))
+#define PluginStr(text) pluginLocale->LookupString(TEXT2(text), LocaleHashLiteral(TEXT2(text)))
 
 // Entry points
 extern "C" __declspec(dllexport) bool LoadPlugin();
@@ -226,6 +226,7 @@ bool OBS::SetScene(CTSTR lpScene)
     if(sceneElement == newSceneElement)
         return true;
 
+    XElement *previousSceneElement = sceneElement;
     sceneElement = newSceneElement;
 
     CTSTR lpClass = sceneElement->GetString(TEXT("class"));
@@ -250,8 +251,15 @@ bool OBS::SetScene(CTSTR lpScene)
     //-------------------------
 
     Scene *newScene = NULL;
+    bool bWarmScene = false;
     if(bRunning)
-        newScene = CreateScene(lpClass, sceneData);
+    {
+        newScene = TakeWarmScene(newSceneElement);
+        bWarmScene = (newScene != NULL);
+
+        if(!newScene)
+            newScene = CreateScene(lpClass, sceneData);
+    }
 
     //-------------------------
 
@@ -295,7 +303,7 @@ bool OBS::SetScene(CTSTR lpScene)
             // This fixes the issue where capture devices sources that used the
             // same device as one in the previous scene would just go blank
             // after switching.
-            if(bRunning && newScene && !bSkipTransition)
+            if(bRunning && newScene && !bSkipTransition && !bWarmScene)
                 newScene->AddImageSource(sourceElement);
         }
     }
@@ -304,12 +312,11 @@ bool OBS::SetScene(CTSTR lpScene)
     SendMessage(hwndSources, WM_SETREDRAW, (WPARAM)TRUE, (LPARAM) 0);
     RedrawWindow(hwndSources, NULL, NULL, RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
 
-    if(scene && newScene && newScene->HasMissingSources())
+    if(scene && newScene && !bWarmScene && newScene->HasMissingSources())
         OBSMessageBox(hwndMain, Str("Scene.MissingSources"), NULL, 0);
 
     if(bRunning)
     {
-        //todo: cache scenes maybe?  undecided.  not really as necessary with global sources
         OSEnterMutex(hSceneMutex);
 
         UINT numSources;
@@ -341,9 +348,9 @@ bool OBS::SetScene(CTSTR lpScene)
             // If we're skipping the transition because of a non-global
             // DirectShow device, delete the scene here and add the
             // ImageSources at this point instead.
-            delete previousScene;
+            KeepWarmScene(previousSceneElement, previousScene);
 
-            if(sources)
+            if(sources && !bWarmScene)
             {
                 UINT numSources = sources->NumElements();
 
@@ -385,10 +392,12 @@ bool OBS::SetScene(CTSTR lpScene)
         if(!bSkipTransition) {
             // Do not delete the previous scene here, since it has already
             // been deleted.
-            delete previousScene;
+            KeepWarmScene(previousSceneElement, previousScene);
         }
 
         DWORD sceneChangeTime = OSGetTime() - sceneChangeStartTime;
+        Log(TEXT("Scene change took %u ms%s"), sceneChangeTime, bWarmScene ? TEXT(" (scene was still warm)") : TEXT(""));
+
         if (sceneChangeTime >= 500)
             Log(TEXT("PERFORMANCE WARNING: Scene change took %u ms, maybe some sources should be global sources?"), sceneChangeTime);
     }
@@ -399,6 +408,84 @@ bool OBS::SetScene(CTSTR lpScene)
     return true;
 }
 
+Scene* OBS::TakeWarmScene(XElement *sceneElement)
+{
+    for(UINT i=0; i<warmScenes.Num(); i++)
+    {
+        if(warmScenes[i].element != sceneElement)
+            continue;
+
+        Scene *warmScene = warmScenes[i].scene;
+        warmScenes.Remove(i);
+
+        //sources could have been added or removed (plugins, global sources being deleted) while it wasn't active
+        XElement *sources = sceneElement->GetElement(TEXT("sources"));
+        UINT numSources = sources ? sources->NumElements() : 0;
+
+        bool bUnchanged = (warmScene->sceneItems.Num() == numSources);
+        for(UINT j=0; bUnchanged && j<numSources; j++)
+            bUnchanged = (warmScene->sceneItems[j]->GetElement() == sources->GetElementByID(j));
+
+        if(bUnchanged)
+            return warmScene;
+
+        delete warmScene;
+        break;
+    }
+
+    return NULL;
+}
+
+void OBS::KeepWarmScene(XElement *sceneElement, Scene *scene)
+{
+    if(!scene)
+        return;
+
+    bool bKeep = (sceneElement != NULL && numWarmScenes != 0);
+
+    for(UINT i=0; bKeep && i<scene->sceneItems.Num(); i++)
+    {
+        ImageSource *source = scene->sceneItems[i]->GetSource();
+        if(source && !source->CanKeepWarm())
+            bKeep = false;
+    }
+
+    if(!bKeep)
+    {
+        delete scene;
+        return;
+    }
+
+    WarmScene warmScene = {sceneElement, scene};
+    warmScenes.Insert(0, warmScene);
+
+    while(warmScenes.Num() > numWarmScenes)
+    {
+        delete warmScenes.Last().scene;
+        warmScenes.Remove(warmScenes.Num()-1);
+    }
+}
+
+void OBS::DropWarmScene(XElement *sceneElement)
+{
+    for(UINT i=0; i<warmScenes.Num(); i++)
+    {
+        if(warmScenes[i].element == sceneElement)
+        {
+            delete warmScenes[i].scene;
+            warmScenes.Remove(i);
+            break;
+        }
+    }
+}
+
+void OBS::ClearWarmScenes()
+{
+    for(UINT i=0; i<warmScenes.Num(); i++)
+        delete warmScenes[i].scene;
+    warmScenes.Clear();
+}
+
 bool OBS::SetSceneCollection(CTSTR lpCollection) {
     if (bRunning)
         return false;
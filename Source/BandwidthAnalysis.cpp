@@ -18,6 +18,9 @@
 
 
 #include "Main.h"
+#include "RTMPStuff.h"
+#include "RTMPPublisher.h"
+#include "BandwidthProbeSteps.h"
 
 
 class BandwidthAnalyzer : public NetworkStream
@@ -85,3 +88,353 @@ NetworkStream* CreateBandwidthAnalyzer()
 {
     return new BandwidthAnalyzer;
 }
+
+
+//-----------------------------------------------------------------------------------------------
+// bandwidth probe: unlike the analyzer above, this measures the actual link by pushing filler
+// over a real RTMP connection, raising the rate until the send backlog starts to grow.  the filler
+// never goes out live:  it goes to Publish/BandwidthProbeURL when that's set, otherwise the stream
+// is marked as a bandwidth test so the ingest reads and discards it
+
+//SIO_TCP_INFO / TCP_INFO_v0 are only in newer SDKs, the call simply fails on systems that don't support it
+#define PROBE_SIO_TCP_INFO _WSAIORW(IOC_VENDOR, 39)
+
+struct ProbeTCPInfo
+{
+    int     State;
+    ULONG   Mss;
+    ULONG64 ConnectionTimeMs;
+    BOOLEAN TimestampsEnabled;
+    ULONG   RttUs;
+    ULONG   MinRttUs;
+    ULONG   BytesInFlight;
+    ULONG   Cwnd;
+    ULONG   SndWnd;
+    ULONG   RcvWnd;
+    ULONG   RcvBuf;
+    ULONG64 BytesOut;
+    ULONG64 BytesIn;
+    ULONG   BytesReordered;
+    ULONG   BytesRetrans;
+    ULONG   FastRetrans;
+    ULONG   DupAcksIn;
+    ULONG   TimeoutEpisodes;
+    UCHAR   SynRetrans;
+};
+
+class BandwidthProbe : public RTMPPublisher
+{
+    HANDLE hProbeThread;
+    HANDLE hProbeExit;
+
+    //results, only touched by the probe thread until it exits
+    BandwidthProbeSteps steps;
+    DWORD probeDuration;
+    List<DWORD> rttSamples;
+    ULONG64 bytesRetrans, bytesOut;
+    bool bHaveTCPInfo;
+
+    QWORD GetSentBytes()
+    {
+        OSEnterMutex(hDataBufferMutex);
+        QWORD ret = bytesSent;
+        OSLeaveMutex(hDataBufferMutex);
+        return ret;
+    }
+
+    UINT GetBacklogBytes()
+    {
+        OSEnterMutex(hDataMutex);
+        UINT queued = currentBufferSize;
+        OSLeaveMutex(hDataMutex);
+
+        OSEnterMutex(hDataBufferMutex);
+        queued += curDataBufferLen;
+        OSLeaveMutex(hDataBufferMutex);
+
+        return queued;
+    }
+
+    void SampleTCPInfo()
+    {
+        ProbeTCPInfo info;
+        DWORD version = 0, bytesReturned;
+
+        OSEnterMutex(hRTMPMutex);
+        bHaveTCPInfo = rtmp && WSAIoctl(rtmp->m_sb.sb_socket, PROBE_SIO_TCP_INFO, &version, sizeof(version),
+                                        &info, sizeof(info), &bytesReturned, NULL, NULL) == 0;
+        OSLeaveMutex(hRTMPMutex);
+
+        if (bHaveTCPInfo)
+        {
+            rttSamples << info.RttUs;
+            bytesRetrans = info.BytesRetrans;
+            bytesOut = info.BytesOut;
+        }
+    }
+
+    //an h.264 filler data nal in an flv video tag, which any ingest or decoder is free to discard
+    static void BuildFillerPacket(List<BYTE> &packet, UINT size, bool bKeyframe)
+    {
+        if (size < 16)
+            size = 16;
+
+        packet.SetSize(size);
+        msetd(packet.Array(), 0xFFFFFFFF, size);
+
+        UINT nalSize = size-9;
+
+        BYTE *data = packet.Array();
+        data[0] = bKeyframe ? 0x17 : 0x27;
+        data[1] = 1;                        //AVC NALU
+        data[2] = data[3] = data[4] = 0;    //composition time
+        data[5] = BYTE(nalSize >> 24);
+        data[6] = BYTE(nalSize >> 16);
+        data[7] = BYTE(nalSize >> 8);
+        data[8] = BYTE(nalSize);
+        data[9] = 0x0C;                     //nal_unit_type: filler data
+        data[size-1] = 0x80;                //rbsp_trailing_bits
+    }
+
+    void RunProbe()
+    {
+        List<BYTE> filler;
+
+        QWORD startTime = GetQPCTimeMS();
+        QWORD nextFrameTime = startTime;
+        QWORD nextSampleTime = startTime;
+
+        bool bFirstFrame = true;
+
+        steps.Start(startTime, GetSentBytes());
+
+        Log(TEXT("BandwidthProbe: starting at %u kbps, maximum %u kbps"), steps.startRate, steps.maxRate);
+
+        while (WaitForSingleObject(hProbeExit, 0) == WAIT_TIMEOUT && !bStopping)
+        {
+            QWORD curTime = GetQPCTimeMS();
+
+            if (curTime >= nextFrameTime)
+            {
+                BuildFillerPacket(filler, steps.FrameSize(), bFirstFrame);
+                SendPacketForReal(filler.Array(), filler.Num(), DWORD(nextFrameTime-startTime),
+                                  bFirstFrame ? PacketType_VideoHighest : PacketType_VideoHigh);
+
+                bFirstFrame = false;
+                nextFrameTime += probeFrameInterval;
+            }
+
+            if (curTime >= nextSampleTime)
+            {
+                nextSampleTime += probeSampleInterval;
+
+                SampleTCPInfo();
+
+                UINT backlog = GetBacklogBytes();
+                UINT rate = steps.rate;
+
+                ProbeStep step = steps.Sample(curTime, GetSentBytes(), backlog);
+
+                if (step == ProbeStep_Congested)
+                    Log(TEXT("BandwidthProbe: backlog grew to %u bytes at %u kbps"), backlog, rate);
+                else if (step != ProbeStep_Continue && step != ProbeStep_TimeUp)
+                    Log(TEXT("BandwidthProbe: %u kbps offered, %u kbps sent, %u bytes backlog"), rate, steps.lastMeasuredRate, backlog);
+
+                if (step != ProbeStep_Continue && step != ProbeStep_NextRate)
+                    break;
+            }
+
+            QWORD nextTime = min(nextFrameTime, nextSampleTime);
+            curTime = GetQPCTimeMS();
+            if (nextTime > curTime)
+                WaitForSingleObject(hProbeExit, DWORD(nextTime-curTime));
+        }
+
+        probeDuration = DWORD(GetQPCTimeMS()-startTime);
+    }
+
+    static DWORD WINAPI ProbeThread(BandwidthProbe *probe)
+    {
+        probe->RunProbe();
+
+        if (!probe->bStopping && WaitForSingleObject(probe->hProbeExit, 0) == WAIT_TIMEOUT)
+            App->PostStopMessage(true);
+
+        return 0;
+    }
+
+    void SetReport()
+    {
+        String strReport;
+        strReport << TEXT("Bandwidth test report:\r\n\r\n");
+
+        if (!steps.sustainedRate)
+        {
+            strReport << TEXT("The connection could not sustain the starting rate of ") << UIntString(steps.startRate) << TEXT(" kbps.");
+            App->SetStreamReport(strReport);
+            return;
+        }
+
+        strReport << TEXT("Sustainable throughput: ") << UIntString(steps.sustainedRate) << TEXT(" kbps");
+        if (steps.bHitMaxRate)
+            strReport << TEXT(" (test limit reached, the link may be faster)");
+        else if (steps.congestedRate)
+            strReport << TEXT(" (backlog started growing at ") << UIntString(steps.congestedRate) << TEXT(" kbps)");
+        strReport << TEXT("\r\nTest duration: ") << UIntString(probeDuration) << TEXT(" ms");
+
+        double rttStdDev = 0.0;
+
+        if (rttSamples.Num())
+        {
+            double mean = 0.0;
+            DWORD minRTT = 0xFFFFFFFF, maxRTT = 0;
+
+            for (UINT i=0; i<rttSamples.Num(); i++)
+            {
+                mean += rttSamples[i];
+                minRTT = min(minRTT, rttSamples[i]);
+                maxRTT = max(maxRTT, rttSamples[i]);
+            }
+            mean /= rttSamples.Num();
+
+            double variance = 0.0;
+            for (UINT i=0; i<rttSamples.Num(); i++)
+                variance += (rttSamples[i]-mean)*(rttSamples[i]-mean);
+            variance /= rttSamples.Num();
+
+            rttStdDev = sqrt(variance)/1000.0;
+
+            strReport << FormattedString(TEXT("\r\nRound trip time: %.1f ms average, %.1f - %.1f ms range, %.1f ms standard deviation"),
+                                         mean/1000.0, minRTT/1000.0, maxRTT/1000.0, rttStdDev);
+
+            if (bytesOut)
+                strReport << FormattedString(TEXT("\r\nRetransmitted: %.2f%%"), double(bytesRetrans)*100.0/bytesOut);
+        }
+        else
+            strReport << TEXT("\r\nRound trip time: not available on this version of Windows");
+
+        //leave headroom for overhead and fluctuations, and take the audio out of what's left for video
+        UINT totalRate = steps.sustainedRate*4/5;
+        UINT audioRate = App->GetAudioEncoder() ? App->GetAudioEncoder()->GetBitRate() : 0;
+        UINT videoRate = (totalRate > audioRate+100) ? totalRate-audioRate : 100;
+
+        //a jittery link copes better with smaller bursts, so shrink the buffer as the rtt varies more
+        double bufferScale = 1.0 - rttStdDev/200.0;
+        if (bufferScale < 0.5)
+            bufferScale = 0.5;
+        UINT bufferSize = UINT(videoRate*bufferScale);
+
+        strReport << TEXT("\r\n\r\nRecommended video bitrate: ") << UIntString(videoRate) << TEXT(" kbps");
+        strReport << TEXT("\r\nRecommended buffer size: ") << UIntString(bufferSize) << TEXT(" kbit");
+
+        Log(TEXT("BandwidthProbe: sustained %u kbps, recommending %u kbps video with a %u kbit buffer"), steps.sustainedRate, videoRate, bufferSize);
+
+        App->SetStreamReport(strReport);
+    }
+
+public:
+    BandwidthProbe() : RTMPPublisher(), steps(0, 0)
+    {
+        UINT startRate = AppConfig->GetInt(TEXT("Publish"), TEXT("BandwidthProbeStartRate"), 1000);
+        UINT maxRate = AppConfig->GetInt(TEXT("Publish"), TEXT("BandwidthProbeMaxRate"), 50000);
+
+        if (startRate < 100)    startRate = 100;
+        if (maxRate < startRate) maxRate = startRate;
+
+        steps.startRate = startRate;
+        steps.maxRate = maxRate;
+
+        hProbeExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        //a dropped connection should end the test rather than be papered over
+        bFastReconnect = false;
+    }
+
+    ~BandwidthProbe()
+    {
+        SetEvent(hProbeExit);
+
+        if (hProbeThread)
+        {
+            WaitForSingleObject(hProbeThread, INFINITE);
+            OSCloseThread(hProbeThread);
+
+            SetReport();
+        }
+
+        DropBacklog();
+
+        CloseHandle(hProbeExit);
+    }
+
+    //the filler still waiting to go out is worthless once the probe is over, and at the higher rates there
+    //can be megabytes of it that ~RTMPPublisher would otherwise wait most of a minute to flush
+    void DropBacklog()
+    {
+        OSEnterMutex(hDataMutex);
+        UINT numDropped = currentBufferSize;
+        for (UINT i=0; i<queuedPackets.Num(); i++)
+            queuedPackets[i].data.Clear();
+        queuedPackets.Clear();
+        currentBufferSize = 0;
+        OSLeaveMutex(hDataMutex);
+
+        //the connection is going away, so it doesn't matter if this cuts a packet short
+        OSEnterMutex(hDataBufferMutex);
+        numDropped += curDataBufferLen;
+        curDataBufferLen = 0;
+        OSLeaveMutex(hDataBufferMutex);
+
+        SetEvent(hBufferSpaceAvailableEvent);
+
+        if (numDropped)
+            Log(TEXT("BandwidthProbe: dropped %u bytes of unsent filler"), numDropped);
+    }
+
+    void SetConnectTarget(String &strURL, String &strPlayPath)
+    {
+        String strProbeURL = AppConfig->GetString(TEXT("Publish"), TEXT("BandwidthProbeURL"));
+
+        if (strProbeURL.IsValid())
+        {
+            strURL = strProbeURL;
+            strPlayPath = AppConfig->GetString(TEXT("Publish"), TEXT("BandwidthProbePlayPath"), TEXT("bandwidthtest"));
+            Log(TEXT("BandwidthProbe: probing the discard endpoint %s"), strURL.Array());
+        }
+        else
+        {
+            //ingests that support it read a stream marked like this and throw it away instead of going live
+            strPlayPath << (schr(strPlayPath, '?') ? TEXT("&") : TEXT("?")) << TEXT("bandwidthtest=true");
+            Log(TEXT("BandwidthProbe: probing the ingest with a bandwidth test stream"));
+        }
+    }
+
+    void SendPacket(BYTE *data, UINT size, DWORD timestamp, PacketType type)
+    {
+        //encoder output is only used for the stream headers, the probe thread supplies the data
+        if (!encoderDataInitialized)
+        {
+            InitEncoderData();
+
+            //one second at the highest rate, so the buffer itself never limits the probe
+            dataBufferSize = max(dataBufferSize, int(steps.maxRate/8*1024));
+        }
+
+        if (!bConnected && !bConnecting && !bStopping)
+        {
+            hConnectionThread = OSCreateThread((XTHREAD)CreateConnectionThread, this);
+            bConnecting = true;
+        }
+
+        if (bConnected && !hProbeThread)
+            hProbeThread = OSCreateThread((XTHREAD)ProbeThread, this);
+    }
+
+    void RequestKeyframe(int waitTime) {}
+};
+
+
+NetworkStream* CreateBandwidthProbe()
+{
+    return new BandwidthProbe;
+}
@@ -0,0 +1,117 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// rate stepping of the bandwidth probe.  the probe offers filler at a rate, samples how much actually went
+// out and how much is still waiting to be sent, and raises the rate by a quarter each step until the backlog
+// grows, which means the link stopped keeping up.  kept apart from BandwidthProbe so it can be run against
+// a shaped local ingest, so nothing in here can depend on the rest of OBS.
+
+const DWORD probeFrameInterval  = 20;       //ms between filler packets
+const DWORD probeSampleInterval = 100;      //ms between backlog/rtt samples
+const DWORD probeStepTime       = 1500;     //ms spent at each rate
+const DWORD probeMaxTime        = 25000;    //keep it under the 30 second window in which the report is shown
+const DWORD probeMaxBacklog     = 250;      //ms worth of backlog at the current rate that counts as congestion
+
+enum ProbeStep
+{
+    ProbeStep_Continue,
+    ProbeStep_NextRate,     //the link carried the last rate, moved on to a higher one
+    ProbeStep_Congested,    //the backlog grew, the probe is done
+    ProbeStep_MaxRate,      //the link carried the highest rate, the probe is done
+    ProbeStep_TimeUp,
+};
+
+struct BandwidthProbeSteps
+{
+    UINT startRate, maxRate;        //kbps
+    DWORD stepTime, maxTime;
+
+    UINT rate;                      //rate currently offered
+    UINT lastMeasuredRate;          //rate that went out during the last completed step
+
+    UINT sustainedRate;             //highest rate the link carried, 0 if it couldn't take the start rate
+    UINT congestedRate;             //rate at which the backlog grew, 0 if it never did
+    bool bHitMaxRate;
+
+    QWORD startTime, stepStartTime, stepStartBytes;
+    UINT stepStartBacklog;
+
+    BandwidthProbeSteps(UINT startRate, UINT maxRate)
+        : startRate(startRate), maxRate(maxRate), stepTime(probeStepTime), maxTime(probeMaxTime),
+          rate(startRate), lastMeasuredRate(0), sustainedRate(0), congestedRate(0), bHitMaxRate(false),
+          startTime(0), stepStartTime(0), stepStartBytes(0), stepStartBacklog(0)
+    {}
+
+    void Start(QWORD curTime, QWORD sentBytes)
+    {
+        rate = startRate;
+        startTime = stepStartTime = curTime;
+        stepStartBytes = sentBytes;
+        stepStartBacklog = 0;
+    }
+
+    //size of the next filler packet at the current rate
+    inline UINT FrameSize() const {return rate*probeFrameInterval/8;}
+
+    //called every probeSampleInterval with the total bytes sent so far and the bytes still waiting to be sent
+    ProbeStep Sample(QWORD curTime, QWORD sentBytes, UINT backlog)
+    {
+        UINT maxBacklog = rate*probeMaxBacklog/8;
+
+        if (backlog > stepStartBacklog + maxBacklog)
+        {
+            congestedRate = rate;
+            return ProbeStep_Congested;
+        }
+
+        ProbeStep step = ProbeStep_Continue;
+
+        if (curTime - stepStartTime >= stepTime)
+        {
+            lastMeasuredRate = UINT((sentBytes-stepStartBytes)*8/(curTime-stepStartTime));
+
+            //the backlog didn't grow past the limit, so the link carried this step
+            UINT carried = (lastMeasuredRate < rate) ? lastMeasuredRate : rate;
+            if (carried > sustainedRate)
+                sustainedRate = carried;
+
+            if (rate == maxRate)
+            {
+                bHitMaxRate = true;
+                return ProbeStep_MaxRate;
+            }
+
+            rate = (rate*5/4 < maxRate) ? rate*5/4 : maxRate;
+
+            stepStartTime = curTime;
+            stepStartBytes = sentBytes;
+            stepStartBacklog = backlog;
+
+            step = ProbeStep_NextRate;
+        }
+
+        if (curTime - startTime >= maxTime)
+            return ProbeStep_TimeUp;
+
+        return step;
+    }
+};
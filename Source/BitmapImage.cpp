@@ -7,6 +7,71 @@ unsigned char *BI_def_bitmap_get_buffer(void *bitmap)      {return (unsigned cha
 void BI_def_bitmap_destroy(void *bitmap)                   {Free(bitmap);}
 void BI_def_bitmap_modified(void *bitmap)                  {}
 
+//animations up to this many MB keep every decoded frame, anything bigger only keeps a window of frames ahead
+#define GIF_CACHE_ALL_MB 64
+
+//simple run length coding on whole pixels.  a header dword with the top bit set is a run of that many
+//copies of the next pixel, otherwise it's followed by that many literal pixels.  gif frames come from a
+//palette and usually have big flat areas, so this shrinks them a lot for very little work
+UINT CompressGifFrame(const DWORD *lpInput, UINT numPixels, DWORD *lpOutput)
+{
+    DWORD *lpOut = lpOutput;
+    UINT i = 0;
+
+    while(i < numPixels)
+    {
+        UINT run = 1;
+        while(i+run < numPixels && lpInput[i+run] == lpInput[i])
+            run++;
+
+        if(run >= 3)
+        {
+            *lpOut++ = 0x80000000 | run;
+            *lpOut++ = lpInput[i];
+            i += run;
+            continue;
+        }
+
+        //literal pixels up to the next run of 3 or more
+        DWORD *lpHeader = lpOut++;
+        UINT start = i;
+        while(i < numPixels)
+        {
+            if(i+2 < numPixels && lpInput[i] == lpInput[i+1] && lpInput[i] == lpInput[i+2])
+                break;
+            *lpOut++ = lpInput[i++];
+        }
+
+        *lpHeader = i-start;
+    }
+
+    return UINT(lpOut-lpOutput)*sizeof(DWORD);
+}
+
+void DecompressGifFrame(const DWORD *lpInput, UINT size, DWORD *lpOutput)
+{
+    const DWORD *lpEnd = lpInput+(size/sizeof(DWORD));
+
+    while(lpInput < lpEnd)
+    {
+        DWORD header = *lpInput++;
+        UINT count = header & 0x7FFFFFFF;
+
+        if(header & 0x80000000)
+        {
+            DWORD pixel = *lpInput++;
+            for(UINT i=0; i<count; i++)
+                *lpOutput++ = pixel;
+        }
+        else
+        {
+            memcpy(lpOutput, lpInput, count*sizeof(DWORD));
+            lpOutput += count;
+            lpInput += count;
+        }
+    }
+}
+
 
 BitmapImage::BitmapImage()
 {
@@ -16,23 +81,143 @@ BitmapImage::BitmapImage()
     bitmap_callbacks.bitmap_modified = BI_def_bitmap_modified;
     bitmap_callbacks.bitmap_set_opaque = BI_def_bitmap_set_opaque;
     bitmap_callbacks.bitmap_test_opaque = BI_def_bitmap_test_opaque;
+
+    hDecodeMutex = OSCreateMutex();
 }
 
 BitmapImage::~BitmapImage()
 {
-    if(bIsAnimatedGif)
+    Unload();
+
+    EnableFileMonitor(false);
+
+    OSCloseMutex(hDecodeMutex);
+}
+
+void BitmapImage::FreeAnimation(void)
+{
+    if(!bIsAnimatedGif)
+        return;
+
+    bIsAnimatedGif = false;
+
+    if(hDecodeThread)
     {
-        gif_finalise(&gif);
-        Free(animationFrameCache);
-        Free(animationFrameData);
+        SetEvent(hStopDecodeEvent);
+        OSWaitForThread(hDecodeThread, NULL);
+        OSCloseThread(hDecodeThread);
+        hDecodeThread = NULL;
     }
 
-    if(lpGifData)
-        Free(lpGifData);
+    if(hDecodeEvent)
+    {
+        CloseHandle(hDecodeEvent);
+        hDecodeEvent = NULL;
+    }
 
-    EnableFileMonitor(false);
+    if(hStopDecodeEvent)
+    {
+        CloseHandle(hStopDecodeEvent);
+        hStopDecodeEvent = NULL;
+    }
 
-    delete texture;
+    gif_finalise(&gif);
+
+    for(UINT i=0; i<frameSlots.Num(); i++)
+        Free(frameSlots[i].lpData);
+    frameSlots.Clear();
+
+    Free(lpFrameBuffer);
+    lpFrameBuffer = NULL;
+    Free(lpCompressBuffer);
+    lpCompressBuffer = NULL;
+}
+
+//----------------------------------------------------------------------------
+
+//copies the frame that was just decoded into its slot.  the slot being replaced always holds a frame
+//that has already been shown, so the data can be written without holding the mutex
+void BitmapImage::StoreFrame(QWORD pos)
+{
+    GifFrameSlot &slot = frameSlots[UINT(pos % frameSlots.Num())];
+    UINT frameSize = gif.width*gif.height*4;
+
+    OSEnterMutex(hDecodeMutex);
+    slot.pos = GIF_SLOT_EMPTY;
+    OSLeaveMutex(hDecodeMutex);
+
+    LPBYTE lpFrame = (LPBYTE)gif.frame_image;
+    UINT size = frameSize;
+
+    if(bCompressFrames)
+    {
+        UINT compressedSize = CompressGifFrame((const DWORD*)lpFrame, gif.width*gif.height, (DWORD*)lpCompressBuffer);
+        if(compressedSize < frameSize)
+        {
+            lpFrame = lpCompressBuffer;
+            size = compressedSize;
+        }
+    }
+
+    UINT oldCapacity = slot.capacity;
+    if(slot.capacity < size)
+    {
+        slot.lpData = (LPBYTE)ReAllocate(slot.lpData, size);
+        slot.capacity = size;
+    }
+
+    memcpy(slot.lpData, lpFrame, size);
+
+    OSEnterMutex(hDecodeMutex);
+    slot.pos = pos;
+    slot.size = size;
+    cacheSize += slot.capacity-oldCapacity;
+    peakCacheSize = MAX(peakCacheSize, cacheSize);
+    OSLeaveMutex(hDecodeMutex);
+}
+
+DWORD STDCALL BitmapImage::DecodeThread(BitmapImage *image)
+{
+    HANDLE hEvents[2] = {image->hStopDecodeEvent, image->hDecodeEvent};
+    UINT frameCount = image->gif.frame_count;
+    UINT numSlots = image->frameSlots.Num();
+    QWORD pos = image->decodePos;
+
+    while(WaitForSingleObject(image->hStopDecodeEvent, 0) == WAIT_TIMEOUT)
+    {
+        if(image->bCacheAllFrames && pos == frameCount)
+            break;
+
+        OSEnterMutex(image->hDecodeMutex);
+        QWORD displayPos = image->displayPos;
+        OSLeaveMutex(image->hDecodeMutex);
+
+        if(!image->bCacheAllFrames)
+        {
+            //window is full, wait until a frame gets shown
+            if(pos >= displayPos+numSlots)
+            {
+                if(WaitForMultipleObjects(2, hEvents, FALSE, INFINITE) == WAIT_OBJECT_0)
+                    break;
+                continue;
+            }
+
+            //fell behind by whole loops (the source wasn't ticking), those can just be skipped
+            if(displayPos > pos+frameCount)
+                pos += (displayPos-pos)/frameCount*frameCount;
+        }
+
+        //frames always have to be decoded in order, but frames that have already gone by don't need storing
+        if(gif_decode_frame(&image->gif, UINT(pos % frameCount)) == GIF_OK)
+        {
+            if(image->bCacheAllFrames || pos >= displayPos)
+                image->StoreFrame(pos);
+        }
+
+        pos++;
+    }
+
+    return 0;
 }
 
 //----------------------------------------------------------------------------
@@ -68,18 +253,9 @@ void BitmapImage::EnableFileMonitor(bool bMonitor)
         changeMonitor = OSMonitorFileStart(filePath);
 }
 
-void BitmapImage::Init(void)
+void BitmapImage::Unload(void)
 {
-    if(bIsAnimatedGif)
-    {
-        bIsAnimatedGif = false;
-        gif_finalise(&gif);
-
-        Free(animationFrameCache);
-        animationFrameCache = NULL;
-        Free(animationFrameData);
-        animationFrameData = NULL;
-    }
+    FreeAnimation();
 
     if(lpGifData)
     {
@@ -89,9 +265,31 @@ void BitmapImage::Init(void)
 
     animationTimes.Clear();
 
+    if(imageRequest)
+    {
+        ReleaseImage(imageRequest);
+        imageRequest = NULL;
+        sharedTexture = NULL;
+    }
+
     delete texture;
     texture = NULL;
 
+    changeCount++;
+}
+
+static bool IsCachedImageType(CTSTR lpBitmap)
+{
+    String strExtension = GetPathExtension(lpBitmap);
+
+    return strExtension.CompareI(TEXT("png")) || strExtension.CompareI(TEXT("jpg")) || strExtension.CompareI(TEXT("jpeg")) ||
+           strExtension.CompareI(TEXT("bmp")) || strExtension.CompareI(TEXT("tif")) || strExtension.CompareI(TEXT("tiff"));
+}
+
+void BitmapImage::Init(void)
+{
+    Unload();
+
     CTSTR lpBitmap = filePath;
     if(!lpBitmap || !*lpBitmap)
     {
@@ -140,14 +338,13 @@ void BitmapImage::Init(void)
 
         if(bIsAnimatedGif)
         {
-            gif_decode_frame(&gif, 0);
-            texture = CreateTexture(gif.width, gif.height, GS_RGBA, gif.frame_image, FALSE, FALSE);
+            DWORD startTime = OSGetTime();
 
-            animationFrameCache = (BYTE **)Allocate(gif.frame_count * sizeof(BYTE *));
-            memset(animationFrameCache, 0, gif.frame_count * sizeof(BYTE *));
+            if (gif_decode_frame(&gif, 0) != GIF_OK)
+                Log (TEXT("BitmapImage: Warning, couldn't decode frame 0 of %s"), lpBitmap);
+            texture = CreateTexture(gif.width, gif.height, GS_RGBA, gif.frame_image, FALSE, FALSE);
 
-            animationFrameData = (BYTE *)Allocate(gif.frame_count * gif.width * gif.height * 4);
-            memset(animationFrameData, 0, gif.frame_count * gif.width * gif.height * 4);
+            DWORD firstFrameTime = OSGetTime()-startTime;
 
             for(UINT i=0; i<gif.frame_count; i++)
             {
@@ -155,19 +352,55 @@ void BitmapImage::Init(void)
                 if (frameTime == 0.0f)
                     frameTime = 0.1f;
                 animationTimes << frameTime;
-
-                if (gif_decode_frame(&gif, i) != GIF_OK)
-                    Log (TEXT("BitmapImage: Warning, couldn't decode frame %d of %s"), i, lpBitmap);
             }
 
-            gif_decode_frame(&gif, 0);
+            //------------------------------------
+
+            UINT frameSize = gif.width*gif.height*4;
+
+            UINT decodeAhead = (UINT)AppConfig->GetInt(TEXT("General"), TEXT("GifDecodeAheadFrames"), 8);
+            decodeAhead = MAX(decodeAhead, 2);
+
+            QWORD cacheAllSize = QWORD(AppConfig->GetInt(TEXT("General"), TEXT("GifCacheAllFramesMB"), GIF_CACHE_ALL_MB))*1024*1024;
+
+            bCompressFrames = AppConfig->GetInt(TEXT("General"), TEXT("GifCompressFrames"), 0) != 0;
+            bCacheAllFrames = decodeAhead >= gif.frame_count || QWORD(gif.frame_count)*frameSize <= cacheAllSize;
+
+            frameSlots.SetSize(bCacheAllFrames ? gif.frame_count : decodeAhead);
+            for(UINT i=0; i<frameSlots.Num(); i++)
+                frameSlots[i].pos = GIF_SLOT_EMPTY;
+
+            lpFrameBuffer = (LPBYTE)Allocate(frameSize);
+            if(bCompressFrames)
+                lpCompressBuffer = (LPBYTE)Allocate(frameSize+sizeof(DWORD));
+
+            //libnsgif's own frame and the buffers above
+            cacheSize = QWORD(frameSize)*2 + (bCompressFrames ? frameSize+sizeof(DWORD) : 0);
+            peakCacheSize = cacheSize;
+
+            StoreFrame(0);
+
+            displayPos = 0;
+            decodePos = 1;
+
+            hDecodeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+            hStopDecodeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+            hDecodeThread = OSCreateThread((XTHREAD)DecodeThread, this);
+
+            if(!hDecodeThread)
+                AppWarning(TEXT("BitmapImage::Init: could not create decode thread for '%s'"), lpBitmap);
+
+            Log(TEXT("BitmapImage: '%s' has %u frames at %ux%u, first frame took %u ms, %s %u frames%s"),
+                lpBitmap, gif.frame_count, gif.width, gif.height, firstFrameTime,
+                bCacheAllFrames ? TEXT("caching all") : TEXT("decoding ahead"), frameSlots.Num(),
+                bCompressFrames ? TEXT(" (compressed)") : TEXT(""));
 
             fullSize.x = float(gif.width);
             fullSize.y = float(gif.height);
 
             curTime = 0.0f;
             curFrame = 0;
-            lastDecodedFrame = 0;
+            curLoop = 0;
         }
         else
         {
@@ -177,7 +410,13 @@ void BitmapImage::Init(void)
         }
     }
 
-    if(!bIsAnimatedGif)
+    //anything gdi+ can decode is loaded in the background, anything else (dds and such) still goes
+    //through d3dx right here
+    if(!bIsAnimatedGif && IsCachedImageType(lpBitmap))
+    {
+        imageRequest = LoadImageAsync(lpBitmap);
+    }
+    else if(!bIsAnimatedGif)
     {
         texture = GS->CreateTextureFromFile(lpBitmap, TRUE);
         if(!texture)
@@ -193,14 +432,76 @@ void BitmapImage::Init(void)
 
 }
 
+UINT BitmapImage::NumFramesReady() const
+{
+    if(!bIsAnimatedGif)
+        return 0;
+
+    UINT numReady = 0;
+
+    OSEnterMutex(hDecodeMutex);
+
+    for(QWORD pos=displayPos; numReady<frameSlots.Num(); pos++, numReady++)
+    {
+        QWORD slotPos = bCacheAllFrames ? pos%gif.frame_count : pos;
+        if(frameSlots[UINT(slotPos % frameSlots.Num())].pos != slotPos)
+            break;
+    }
+
+    OSLeaveMutex(hDecodeMutex);
+
+    return numReady;
+}
+
+QWORD BitmapImage::GetFrameCacheSize() const
+{
+    OSEnterMutex(hDecodeMutex);
+    QWORD size = bIsAnimatedGif ? cacheSize : 0;
+    OSLeaveMutex(hDecodeMutex);
+
+    return size;
+}
+
+QWORD BitmapImage::GetPeakFrameCacheSize() const
+{
+    OSEnterMutex(hDecodeMutex);
+    QWORD size = bIsAnimatedGif ? peakCacheSize : 0;
+    OSLeaveMutex(hDecodeMutex);
+
+    return size;
+}
+
 Vect2 BitmapImage::GetSize(void) const
 {
+    if(imageRequest)
+    {
+        WaitForImage(imageRequest);
+
+        UINT cx, cy;
+        if(GetImageSize(imageRequest, cx, cy))
+            return Vect2(float(cx), float(cy));
+
+        return Vect2(32.0f, 32.0f); //error texture
+    }
+
     return fullSize;
 }
 
-Texture* BitmapImage::GetTexture(void) const
+Texture* BitmapImage::GetTexture(void)
 {
-    return texture;
+    if(imageRequest && !sharedTexture && !texture && ImageLoaded(imageRequest))
+    {
+        sharedTexture = GetImageTexture(imageRequest);
+        if(!sharedTexture)
+        {
+            AppWarning(TEXT("BitmapImage::GetTexture: could not load '%s'"), filePath.Array());
+            CreateErrorTexture();
+        }
+
+        changeCount++;
+    }
+
+    return sharedTexture ? sharedTexture : texture;
 }
 
 void BitmapImage::Tick(float fSeconds)
@@ -214,11 +515,13 @@ void BitmapImage::Tick(float fSeconds)
         if(!totalLoops || curLoop < totalLoops)
         {
             UINT newFrame = curFrame;
+            QWORD newPos = displayPos;
 
             curTime += fSeconds;
             while(curTime > animationTimes[newFrame])
             {
                 curTime -= animationTimes[newFrame];
+                newPos++;
                 if(++newFrame == animationTimes.Num())
                 {
                     if(!totalLoops || ++curLoop < totalLoops)
@@ -226,43 +529,40 @@ void BitmapImage::Tick(float fSeconds)
                     else if (curLoop == totalLoops)
                     {
                         newFrame--;
+                        newPos--;
                         break;
                     }
                 }
             }
 
-            if(newFrame != curFrame)
+            if(newPos != displayPos)
             {
-                UINT lastFrame;
+                //if the decoder hasn't caught up yet the last frame just stays up
+                QWORD slotPos = bCacheAllFrames ? newFrame : newPos;
+                UINT frameSize = gif.width*gif.height*4;
 
-                if (!animationFrameCache[newFrame])
-                {
-                    //animation might have looped, if so make sure we decode from frame 0
-                    if (newFrame < lastDecodedFrame)
-                        lastFrame = 0;
-                    else
-                        lastFrame = lastDecodedFrame + 1;
-
-                    //we need to decode any frames we missed for consistency
-                    for (UINT i = lastFrame; i < newFrame; i++)
-                    {
-                        if (gif_decode_frame(&gif, i) != GIF_OK)
-                            return;
-                    }
+                OSEnterMutex(hDecodeMutex);
+
+                displayPos = newPos;
 
-                    //now decode and display the actual frame we want
-                    int ret = gif_decode_frame(&gif, newFrame);
-                    if (ret == GIF_OK)
+                GifFrameSlot &slot = frameSlots[UINT(slotPos % frameSlots.Num())];
+                if(slot.pos == slotPos)
+                {
+                    LPBYTE lpFrame = slot.lpData;
+                    if(slot.size < frameSize)
                     {
-                        animationFrameCache[newFrame] = animationFrameData + (newFrame * (gif.width * gif.height * 4));
-                        memcpy(animationFrameCache[newFrame], gif.frame_image, gif.width * gif.height * 4);
+                        DecompressGifFrame((const DWORD*)slot.lpData, slot.size, (DWORD*)lpFrameBuffer);
+                        lpFrame = lpFrameBuffer;
                     }
 
-                    lastDecodedFrame = newFrame;
+                    texture->SetImage(lpFrame, GS_IMAGEFORMAT_RGBA, gif.width*4);
+                    changeCount++;
                 }
 
-                if (animationFrameCache[newFrame])
-                    texture->SetImage(animationFrameCache[newFrame], GS_IMAGEFORMAT_RGBA, gif.width*4);
+                OSLeaveMutex(hDecodeMutex);
+
+                if(!bCacheAllFrames)
+                    SetEvent(hDecodeEvent);
 
                 curFrame = newFrame;
             }
@@ -2,29 +2,61 @@
 
 #include "Main.h"
 #include "libnsgif.h"
+#include "ImageCache.h"
 
 
+#define GIF_SLOT_EMPTY 0xFFFFFFFFFFFFFFFFULL
+
+//one decoded gif frame.  pos is the position in the animation (counting every loop) it was decoded for
+struct GifFrameSlot
+{
+    QWORD pos;
+    LPBYTE lpData;
+    UINT size, capacity; //size is less than a full frame if it's compressed
+};
+
+//run length coding for cached frames, on whole pixels.  the output is at most one dword bigger than the input
+UINT CompressGifFrame(const DWORD *lpInput, UINT numPixels, DWORD *lpOutput);
+void DecompressGifFrame(const DWORD *lpInput, UINT size, DWORD *lpOutput);
+
 class BitmapImage{
     Texture *texture;
     Vect2 fullSize;
 
+    //still images are loaded through the image cache, the texture belongs to it
+    ImageRequest *imageRequest;
+    Texture *sharedTexture;
+
     bool bIsAnimatedGif;
     gif_animation gif;
     LPBYTE lpGifData;
     List<float> animationTimes;
-    BYTE **animationFrameCache;
-    BYTE *animationFrameData;
-    UINT curFrame, curLoop, lastDecodedFrame;
+    UINT curFrame, curLoop;
     float curTime;
     float updateImageTime;
 
+    //frames are decoded ahead on a separate thread into a small window of slots, unless the whole
+    //animation is small enough to just keep every frame
+    List<GifFrameSlot> frameSlots;
+    bool bCacheAllFrames, bCompressFrames;
+    QWORD displayPos, decodePos;
+    LPBYTE lpFrameBuffer, lpCompressBuffer;
+    HANDLE hDecodeMutex, hDecodeThread, hDecodeEvent, hStopDecodeEvent;
+    QWORD cacheSize, peakCacheSize;
+
     String filePath;
     OSFileChangeData *changeMonitor;
 
+    UINT changeCount;
+
     gif_bitmap_callback_vt bitmap_callbacks;
 
     void CreateErrorTexture(void);
 
+    void StoreFrame(QWORD pos);
+    void FreeAnimation(void);
+    static DWORD STDCALL DecodeThread(BitmapImage *image);
+
 public:
     BitmapImage();
     ~BitmapImage();
@@ -32,9 +64,24 @@ public:
     void SetPath(String path);
     void EnableFileMonitor(bool bMonitor);
     void Init(void);
+    void Unload(void);
+
+    //Init has been called and the image hasn't been unloaded since
+    inline bool IsInitialized() const {return texture || imageRequest;}
+    inline bool IsLoaded() const      {return !imageRequest || ImageLoaded(imageRequest);}
 
+    //waits for the image to finish loading if it's still being loaded
     Vect2 GetSize(void) const;
-    Texture* GetTexture(void) const;
+    Texture* GetTexture(void);
+
+    //goes up every time what GetTexture returns (or what's in it) changes
+    inline UINT GetChangeCount() const {return changeCount;}
 
     void Tick(float fSeconds);
+
+    //animated gifs only:  how many frames from the one being shown on are decoded and waiting, and the
+    //bytes the decoded frames take up, now and at most since Init
+    UINT NumFramesReady() const;
+    QWORD GetFrameCacheSize() const;
+    QWORD GetPeakFrameCacheSize() const;
 };
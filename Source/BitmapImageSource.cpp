@@ -130,6 +130,10 @@ class BitmapImageSource : public ImageSource
 
     Shader   *colorKeyShader, *alphaIgnoreShader;
 
+    //what the image looked like the last time it was drawn
+    UINT lastChangeCount;
+    bool bDrawn;
+
 
 public:
     BitmapImageSource(XElement *data)
@@ -155,10 +159,18 @@ public:
         bitmapImage.Tick(fSeconds);
     }
 
+    bool HasContentChanged()
+    {
+        return !bDrawn || bitmapImage.GetChangeCount() != lastChangeCount;
+    }
+
     void Render(const Vect2 &pos, const Vect2 &size)
     {
         Texture *texture = bitmapImage.GetTexture();
 
+        lastChangeCount = bitmapImage.GetChangeCount();
+        bDrawn = (texture != NULL);
+
         if(texture)
         {
             if(bUseColorKey)
@@ -206,6 +218,8 @@ public:
         keyBlend        = data->GetInt(TEXT("keyBlend"), 0);
 
         bUseColorKey = bNewUseColorKey;
+
+        bDrawn = false;
     }
 
     Vect2 GetSize() const {return bitmapImage.GetSize();}
@@ -51,12 +51,37 @@ class BitmapTransitionSource : public ImageSource
     bool  bDisableFading;
     bool  bRandomize;
 
+    UINT  numPrefetch;
+
     inline int lrand(int limit)
     {
         // return a random number in the interval [0 , limit)
         return int( ( (double)rand() / (RAND_MAX + 1) ) * limit );
     }
 
+    //only the current image and the next few are kept loaded, the rest are loaded ahead of time in the
+    //background and unloaded again once they've been shown
+    void UpdatePrefetch()
+    {
+        UINT numImages = bitmapImages.Num();
+
+        for(UINT i=0; i<numImages; i++)
+        {
+            bool bWanted;
+            if(i == curTexture || i == nextTexture)
+                bWanted = true;
+            else if(bRandomize)
+                bWanted = false;
+            else
+                bWanted = ((i+numImages-curTexture) % numImages) <= numPrefetch;
+
+            if(bWanted && !bitmapImages[i]->IsInitialized())
+                bitmapImages[i]->Init();
+            else if(!bWanted && bitmapImages[i]->IsInitialized())
+                bitmapImages[i]->Unload();
+        }
+    }
+
 public:
     BitmapTransitionSource(XElement *data)
     {
@@ -100,6 +125,8 @@ public:
                     
                     nextTexture = (curTexture == bitmapImages.Num()-1) ? 0 : curTexture+1;
                 }
+
+                UpdatePrefetch();
             }
         }
 
@@ -115,6 +142,10 @@ public:
 
     void DrawBitmap(UINT texID, float alpha, const Vect2 &startPos, const Vect2 &startSize)
     {
+        //still loading, don't wait for it here
+        if(!bitmapImages[texID]->IsLoaded())
+            return;
+
         DWORD curAlpha = DWORD(alpha*255.0f);
 
         Vect2 pos = Vect2(0.0f, 0.0f);
@@ -191,10 +222,11 @@ public:
             BitmapImage *bitmapImage = new BitmapImage;
             bitmapImage->SetPath(strBitmap);
             bitmapImage->EnableFileMonitor(false);
-            bitmapImage->Init();
 
+            //the size of the source comes from the first image, so that one has to be loaded right away
             if(bFirst)
             {
+                bitmapImage->Init();
                 fullSize = bitmapImage->GetSize();
                 baseAspect = double(fullSize.x)/double(fullSize.y);
                 bFirst = false;
@@ -217,6 +249,8 @@ public:
         bDisableFading = data->GetInt(TEXT("disableFading")) != 0;
         bRandomize = data->GetInt(TEXT("randomize")) != 0;
 
+        numPrefetch = (UINT)AppConfig->GetInt(TEXT("General"), TEXT("SlideshowPrefetch"), 2);
+
         //------------------------------------
 
         curTransitionTime = 0.0f;
@@ -236,6 +270,8 @@ public:
 
         bTransitioning = false;
         curFadeValue = 0.0f;
+
+        UpdatePrefetch();
     }
 
     Vect2 GetSize() const {return fullSize;}
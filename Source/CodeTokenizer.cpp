@@ -37,12 +37,12 @@ static const int TokenPrecedence[NUMCLOSINGTOKENS] = {0,  1,  2,  2,  2,
                                                       11, 11, 12, 12, 13,
                                                       13, 13, 14, 14};
 
-BOOL CodeTokenizer::GetNextToken(String &token, BOOL bPeek)
+//finds where the next token starts and ends without copying anything.  returns the position right
+//after the token, or NULL if there isn't one
+static TSTR ScanToken(TSTR lpTemp, TSTR &lpTokenStart, BOOL &bAlphaNumeric)
 {
-    TSTR lpStart = lpTemp;
-
-    TSTR lpTokenStart = NULL;
-    BOOL bAlphaNumeric = FALSE;
+    lpTokenStart = NULL;
+    bAlphaNumeric = FALSE;
 
     while(*lpTemp)
     {
@@ -51,14 +51,14 @@ BOOL CodeTokenizer::GetNextToken(String &token, BOOL bPeek)
             lpTemp = schr(lpTemp, '\n');
 
             if(!lpTemp)
-                return FALSE;
+                return NULL;
         }
         else if(mcmp(lpTemp, TEXT("/*"), 2*sizeof(TCHAR)))
         {
             lpTemp = sstr(lpTemp+2, TEXT("*/"));
 
             if(!lpTemp)
-                return FALSE;
+                return NULL;
 
             lpTemp += 2;
         }
@@ -126,7 +126,7 @@ BOOL CodeTokenizer::GetNextToken(String &token, BOOL bPeek)
                     }
 
                     if(!bFoundEnd)
-                        return FALSE;
+                        return NULL;
 
                     ++lpTemp;
                     break;
@@ -153,7 +153,7 @@ BOOL CodeTokenizer::GetNextToken(String &token, BOOL bPeek)
                     }
 
                     if(!bFoundEnd)
-                        return FALSE;
+                        return NULL;
 
                     ++lpTemp;
                     break;
@@ -185,8 +185,24 @@ BOOL CodeTokenizer::GetNextToken(String &token, BOOL bPeek)
     }
 
     if(!lpTokenStart)
+        return NULL;
+
+    return lpTemp;
+}
+
+BOOL CodeTokenizer::GetNextToken(String &token, BOOL bPeek)
+{
+    TSTR lpStart = lpTemp;
+
+    TSTR lpTokenStart;
+    BOOL bAlphaNumeric;
+
+    TSTR lpTokenEnd = ScanToken(lpTemp, lpTokenStart, bAlphaNumeric);
+    if(!lpTokenEnd)
         return FALSE;
 
+    lpTemp = lpTokenEnd;
+
     TCHAR oldCH = *lpTemp;
     *lpTemp = 0;
 
@@ -603,3 +619,185 @@ int CodeTokenizer::GetTokenPrecedence(CTSTR lpToken)
 
     return 0;
 }
+
+//-----------------------------------------------------------------------------
+// CodeTokenList
+
+//lexes one token at lpTemp into lpText the same way GetNextToken does, including gluing numbers like 1.0f
+//and 1e-5 back together and turning hex into decimal.  the text isn't terminated.  returns the position
+//after the token, or NULL if GetNextToken would have failed here
+static TSTR LexToken(TSTR lpTemp, TSTR lpText, UINT &textPos)
+{
+    TSTR lpTokenStart;
+    BOOL bAlphaNumeric;
+
+    TSTR lpTokenEnd = ScanToken(lpTemp, lpTokenStart, bAlphaNumeric);
+    if(!lpTokenEnd)
+        return NULL;
+
+    UINT tokenLen = UINT(lpTokenEnd-lpTokenStart);
+
+    if(bAlphaNumeric && iswdigit(*lpTokenStart) && (tokenLen > 2) && (lpTokenStart[0] == '0') && (lpTokenStart[1] == 'x'))
+    {
+        unsigned int val = tstring_base_to_uint(lpTokenStart, NULL, 0);
+
+        String strVal = FormattedString(TEXT("%d"), val);
+        mcpy(lpText+textPos, strVal.Array(), strVal.Length()*sizeof(TCHAR));
+        textPos += strVal.Length();
+
+        return lpTokenEnd;
+    }
+
+    mcpy(lpText+textPos, lpTokenStart, tokenLen*sizeof(TCHAR));
+    textPos += tokenLen;
+
+    lpTemp = lpTokenEnd;
+
+    if(!bAlphaNumeric || !iswdigit(*lpTokenStart))
+        return lpTemp;
+
+    //handle floating points.  a failed lookahead fails the whole token, same as GetNextToken
+    for(UINT pass=0; pass<2; pass++)
+    {
+        UINT nextPos = textPos;
+        TSTR lpNext = LexToken(lpTemp, lpText, nextPos);
+        if(!lpNext)
+            return NULL;
+
+        if(lpText[textPos] == '.')
+        {
+            lpTemp = lpNext;
+            textPos = nextPos;
+
+            lpNext = LexToken(lpTemp, lpText, nextPos);
+            if(!lpNext)
+                return NULL;
+
+            if(iswdigit(lpText[textPos]) || (nextPos-textPos == 1 && lpText[textPos] == 'f'))
+            {
+                lpTemp = lpNext;
+                textPos = nextPos;
+            }
+        }
+
+        if(pass == 0 && lpText[textPos-1] == 'e' && *lpTemp == '-')
+        {
+            nextPos = textPos;
+            lpText[nextPos++] = '-';
+
+            lpNext = LexToken(lpTemp+1, lpText, nextPos);
+            if(!lpNext)
+                return NULL;
+
+            if(iswdigit(lpText[textPos+1]))
+            {
+                lpTemp = lpNext;
+                textPos = nextPos;
+            }
+        }
+    }
+
+    return lpTemp;
+}
+
+BOOL CodeTokenList::Tokenize(CTSTR lpCode)
+{
+    FreeData();
+
+    UINT codeLen = slen(lpCode);
+
+    //tokens never take up more room than the code they came from, plus a terminator each
+    lpText = (TSTR)Allocate((codeLen*2+16)*sizeof(TCHAR));
+
+    List<UINT> openBraces, openParens, openBrackets;
+
+    UINT numTokens = 0, textPos = 0;
+    TSTR lpTemp = (TSTR)lpCode;
+
+    while(lpTemp)
+    {
+        UINT tokenStart = textPos;
+
+        lpTemp = LexToken(lpTemp, lpText, textPos);
+        if(!lpTemp)
+            break;
+
+        lpText[textPos++] = 0;
+
+        //List reallocates on every add, so grow it in steps and trim it at the end
+        if(numTokens == tokens.Num())
+            tokens.SetSize(MAX(numTokens*2, 256));
+
+        CodeToken &token = tokens[numTokens];
+        token.offset = tokenStart;
+        token.length = textPos-tokenStart-1;
+        token.match  = INVALID;
+
+        if(token.length == 1)
+        {
+            List<UINT> *openList = NULL;
+            BOOL bClosing = FALSE;
+
+            switch(lpText[tokenStart])
+            {
+                case '{': openList = &openBraces; break;
+                case '(': openList = &openParens; break;
+                case '[': openList = &openBrackets; break;
+                case '}': openList = &openBraces;   bClosing = TRUE; break;
+                case ')': openList = &openParens;   bClosing = TRUE; break;
+                case ']': openList = &openBrackets; bClosing = TRUE; break;
+            }
+
+            if(openList)
+            {
+                if(!bClosing)
+                    openList->Add(numTokens);
+                else if(openList->Num())
+                {
+                    UINT openID = openList->Last();
+                    openList->Remove(openList->Num()-1);
+
+                    tokens[openID].match = numTokens;
+                    token.match = openID;
+                }
+            }
+        }
+
+        numTokens++;
+    }
+
+    tokens.SetSize(numTokens);
+
+    return numTokens != 0;
+}
+
+BOOL CodeTokenList::GotoToken(UINT &pos, CTSTR lpTarget, BOOL bPassToken) const
+{
+    while(pos < tokens.Num())
+    {
+        if(Is(pos, lpTarget))
+        {
+            if(bPassToken)
+                pos++;
+            return TRUE;
+        }
+
+        TCHAR ch = FirstChar(pos);
+        if(ch == '{' || ch == '(')
+        {
+            UINT match = tokens[pos].match;
+            if(match == INVALID)
+            {
+                pos = tokens.Num();
+                return FALSE;
+            }
+
+            pos = match+1;
+            continue;
+        }
+
+        pos++;
+    }
+
+    return FALSE;
+}
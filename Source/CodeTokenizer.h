@@ -48,3 +48,44 @@ struct CodeTokenizer
 
     static int GetTokenPrecedence(CTSTR lpToken);
 };
+
+//-----------------------------------------------------------------------------
+
+//single pass version of the above.  all the tokens are lexed up front into one buffer (each terminated so it
+//can be used as a plain string) and brackets know where their partner is, so peeking, backing up and
+//skipping blocks are just index changes
+
+struct CodeToken
+{
+    UINT offset;        //into CodeTokenList::lpText
+    UINT length;
+    UINT match;         //matching bracket for { } ( ) [ ], INVALID if there isn't one
+};
+
+struct CodeTokenList
+{
+    TSTR lpText;
+    List<CodeToken> tokens;
+
+    inline CodeTokenList()  {lpText = NULL;}
+    inline ~CodeTokenList() {FreeData();}
+
+    inline void FreeData()
+    {
+        if(lpText)
+            Free(lpText);
+        lpText = NULL;
+        tokens.Clear();
+    }
+
+    BOOL Tokenize(CTSTR lpCode);
+
+    //moves pos up to the next lpTarget, skipping over { } and ( ) blocks
+    BOOL GotoToken(UINT &pos, CTSTR lpTarget, BOOL bPassToken=FALSE) const;
+
+    inline UINT  Num() const                        {return tokens.Num();}
+    inline TSTR  Text(UINT id) const                {return lpText+tokens[id].offset;}
+    inline UINT  Length(UINT id) const              {return tokens[id].length;}
+    inline TCHAR FirstChar(UINT id) const           {return (id < tokens.Num()) ? lpText[tokens[id].offset] : 0;}
+    inline BOOL  Is(UINT id, CTSTR lpStr) const     {return (id < tokens.Num()) && scmp(Text(id), lpStr) == 0;}
+};
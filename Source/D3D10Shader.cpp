@@ -19,6 +19,67 @@
 
 #include "Main.h"
 
+
+//anything that changes the compiled output has to be part of the shader cache key
+#define SHADER_COMPILE_FLAGS D3D10_SHADER_OPTIMIZATION_LEVEL3
+
+static LPCSTR GetShaderTarget(bool bPixelShader, bool bCompatibilityMode)
+{
+    if(bPixelShader)
+        return bCompatibilityMode ? "ps_4_0_level_9_3" : "ps_4_0";
+    else
+        return bCompatibilityMode ? "vs_4_0_level_9_3" : "vs_4_0";
+}
+
+static HRESULT CompileShaderBlob(ShaderBlob &blob, CTSTR lpShader, CTSTR lpFileName, LPCSTR lpTarget, CTSTR lpType, bool *bCached=NULL)
+{
+    char variant[64];
+    sprintf_s(variant, "%s %08X d3dx11_%u", lpTarget, SHADER_COMPILE_FLAGS, D3DX11_SDK_VERSION);
+
+    QWORD key = GetShaderCacheKey(lpShader, lpFileName, variant);
+
+    List<BYTE> cachedBlob;
+    if (ShaderCacheLoad(key, cachedBlob) && cachedBlob.Num())
+    {
+        blob.assign((char*)cachedBlob.Array(), (char*)cachedBlob.Array() + cachedBlob.Num());
+        if (bCached) *bCached = true;
+        return S_OK;
+    }
+
+    if (bCached) *bCached = false;
+
+    //-----------------------------------------------
+
+    ComPtr<ID3D10Blob> errorMessages, shaderBlob;
+
+    LPSTR lpAnsiShader = tstr_createUTF8(lpShader);
+    LPSTR lpAnsiFileName = tstr_createUTF8(lpFileName);
+
+    HRESULT err = D3DX11CompileFromMemory(lpAnsiShader, strlen(lpAnsiShader), lpAnsiFileName, NULL, NULL, "main", lpTarget, SHADER_COMPILE_FLAGS, 0, NULL, shaderBlob.Assign(), errorMessages.Assign(), NULL);
+
+    Free(lpAnsiFileName);
+    Free(lpAnsiShader);
+
+    if (FAILED(err))
+    {
+        if (errorMessages)
+        {
+            if (errorMessages->GetBufferSize())
+            {
+                LPSTR lpErrors = (LPSTR)errorMessages->GetBufferPointer();
+                Log(TEXT("Error compiling %s shader '%s':\r\n\r\n%S\r\n"), lpType, lpFileName, lpErrors);
+            }
+        }
+
+        return err;
+    }
+
+    blob.assign((char*)shaderBlob->GetBufferPointer(), (char*)shaderBlob->GetBufferPointer() + shaderBlob->GetBufferSize());
+    ShaderCacheStore(key, shaderBlob->GetBufferPointer(), (UINT)shaderBlob->GetBufferSize());
+
+    return S_OK;
+}
+
 void D3D10Shader::LoadDefaults()
 {
     for(UINT i=0; i<Params.Num(); i++)
@@ -38,6 +99,9 @@ bool D3D10Shader::ProcessData(ShaderProcessor &processor, CTSTR lpFileName)
     Params.TransferFrom(processor.Params);
     Samplers.TransferFrom(processor.Samplers);
 
+    for(UINT i=0; i<Samplers.Num(); i++)
+        Samplers[i].sampler = CreateSamplerState(Samplers[i].info);
+
     constantSize = 0;
     for(UINT i=0; i<Params.Num(); i++)
     {
@@ -82,40 +146,16 @@ bool D3D10Shader::ProcessData(ShaderProcessor &processor, CTSTR lpFileName)
 void D3D10VertexShader::CreateVertexShaderBlob(ShaderBlob &blob, CTSTR lpShader, CTSTR lpFileName)
 {
     D3D10System *d3d10Sys = static_cast<D3D10System*>(GS);
-    LPCSTR lpVSType = d3d10Sys->bDisableCompatibilityMode ? "vs_4_0" : "vs_4_0_level_9_3";
-
-    ComPtr<ID3D10Blob> errorMessages, shaderBlob;
-
-    LPSTR lpAnsiShader = tstr_createUTF8(lpShader);
-    LPSTR lpAnsiFileName = tstr_createUTF8(lpFileName);
-
-    HRESULT err = D3DX11CompileFromMemory(lpAnsiShader, strlen(lpAnsiShader), lpAnsiFileName, NULL, NULL, "main", lpVSType, D3D10_SHADER_OPTIMIZATION_LEVEL3, 0, NULL, shaderBlob.Assign(), errorMessages.Assign(), NULL);
-
-    Free(lpAnsiFileName);
-    Free(lpAnsiShader);
 
+    HRESULT err = CompileShaderBlob(blob, lpShader, lpFileName, GetShaderTarget(false, !d3d10Sys->bDisableCompatibilityMode), TEXT("vertex"));
     if (FAILED(err))
-    {
-        if (errorMessages)
-        {
-            if (errorMessages->GetBufferSize())
-            {
-                LPSTR lpErrors = (LPSTR)errorMessages->GetBufferPointer();
-                Log(TEXT("Error compiling vertex shader '%s':\r\n\r\n%S\r\n"), lpFileName, lpErrors);
-            }
-        }
-
         CrashError(TEXT("Compilation of vertex shader '%s' failed, result = %08lX"), lpFileName, err);
-        return;
-    }
-
-    blob.assign((char*)shaderBlob->GetBufferPointer(), (char*)shaderBlob->GetBufferPointer() + shaderBlob->GetBufferSize());
 }
 
 Shader* D3D10VertexShader::CreateVertexShaderFromBlob(ShaderBlob const &blob, CTSTR lpShader, CTSTR lpFileName)
 {
     ShaderProcessor shaderProcessor;
-    if (!shaderProcessor.ProcessShader(lpShader, lpFileName))
+    if (!shaderProcessor.ProcessShaderCached(lpShader, lpFileName))
         AppWarning(TEXT("Unable to process vertex shader '%s'"), lpFileName); //don't exit, leave it to the actual shader compiler to tell the errors
 
     //-----------------------------------------------
@@ -170,40 +210,16 @@ Shader* D3D10VertexShader::CreateVertexShader(CTSTR lpShader, CTSTR lpFileName)
 void D3D10PixelShader::CreatePixelShaderBlob(ShaderBlob &blob, CTSTR lpShader, CTSTR lpFileName)
 {
     D3D10System *d3d10Sys = static_cast<D3D10System*>(GS);
-    LPCSTR lpPSType = d3d10Sys->bDisableCompatibilityMode ? "ps_4_0" : "ps_4_0_level_9_3";
-
-    ComPtr<ID3D10Blob> errorMessages, shaderBlob;
-
-    LPSTR lpAnsiShader = tstr_createUTF8(lpShader);
-    LPSTR lpAnsiFileName = tstr_createUTF8(lpFileName);
-
-    HRESULT err = D3DX11CompileFromMemory(lpAnsiShader, strlen(lpAnsiShader), lpAnsiFileName, NULL, NULL, "main", lpPSType, D3D10_SHADER_OPTIMIZATION_LEVEL3, 0, NULL, shaderBlob.Assign(), errorMessages.Assign(), NULL);
-
-    Free(lpAnsiFileName);
-    Free(lpAnsiShader);
 
+    HRESULT err = CompileShaderBlob(blob, lpShader, lpFileName, GetShaderTarget(true, !d3d10Sys->bDisableCompatibilityMode), TEXT("pixel"));
     if (FAILED(err))
-    {
-        if (errorMessages)
-        {
-            if (errorMessages->GetBufferSize())
-            {
-                LPSTR lpErrors = (LPSTR)errorMessages->GetBufferPointer();
-                Log(TEXT("Error compiling pixel shader '%s':\r\n\r\n%S\r\n"), lpFileName, lpErrors);
-            }
-        }
-
         CrashError(TEXT("Compilation of pixel shader '%s' failed, result = %08lX"), lpFileName, err);
-        return;
-    }
-
-    blob.assign((char*)shaderBlob->GetBufferPointer(), (char*)shaderBlob->GetBufferPointer() + shaderBlob->GetBufferSize());
 }
 
 Shader *D3D10PixelShader::CreatePixelShaderFromBlob(ShaderBlob const &blob, CTSTR lpShader, CTSTR lpFileName)
 {
     ShaderProcessor shaderProcessor;
-    if (!shaderProcessor.ProcessShader(lpShader, lpFileName))
+    if (!shaderProcessor.ProcessShaderCached(lpShader, lpFileName))
         AppWarning(TEXT("Unable to process pixel shader '%s'"), lpFileName); //don't exit, leave it to the actual shader compiler to tell the errors
 
     //-----------------------------------------------
@@ -241,6 +257,177 @@ Shader* D3D10PixelShader::CreatePixelShader(CTSTR lpShader, CTSTR lpFileName)
     return CreatePixelShaderFromBlob(blob, lpShader, lpFileName);
 }
 
+//-----------------------------------------------
+// shader prewarming
+
+#define SHADER_PREWARM_MAX_THREADS 8
+
+struct ShaderPrewarmData
+{
+    StringList files;
+    volatile LONG nextFile;
+    volatile LONG numCached;
+    volatile bool bStop;
+    bool bDisableCompatibilityMode;
+};
+
+static HANDLE hPrewarmThread = NULL;
+static ShaderPrewarmData *prewarmData = NULL;
+
+static void FindShaderFiles(StringList &files, CTSTR lpFolder)
+{
+    CTSTR extensions[] = {TEXT("*.vShader"), TEXT("*.pShader")};
+
+    for(UINT i=0; i<2; i++)
+    {
+        String strSearch;
+        strSearch << lpFolder << TEXT("\\") << extensions[i];
+
+        OSFindData ofd;
+        HANDLE hFind = OSFindFirstFile(strSearch, ofd);
+        if(!hFind)
+            continue;
+
+        do
+        {
+            if(ofd.bDirectory)
+                continue;
+
+            String strFile;
+            strFile << lpFolder << TEXT("\\") << ofd.fileName;
+            files << strFile;
+        } while(OSFindNextFile(hFind, ofd));
+
+        OSFindClose(hFind);
+    }
+}
+
+static DWORD STDCALL ShaderPrewarmThread(ShaderPrewarmData *data)
+{
+    LONG fileID;
+
+    while(!data->bStop && (fileID = InterlockedIncrement(&data->nextFile)-1) < (LONG)data->files.Num())
+    {
+        String &strFile = data->files[fileID];
+
+        XFile shaderFile;
+        if(!shaderFile.Open(strFile, XFILE_READ | XFILE_SHARED, XFILE_OPENEXISTING))
+            continue;
+
+        String strShader;
+        shaderFile.ReadFileToString(strShader);
+        shaderFile.Close();
+
+        if(strShader.IsEmpty())
+            continue;
+
+        bool bPixelShader = scmpi(strFile.Array()+strFile.Length()-8, TEXT(".pShader")) == 0;
+
+        //GS might not exist yet or might be torn down while this runs, so don't go through it.  the mode was
+        //taken from the same place d3d10Sys->bDisableCompatibilityMode will be, so the targets match
+        ShaderBlob blob;
+        bool bCached;
+        if(FAILED(CompileShaderBlob(blob, strShader, strFile, GetShaderTarget(bPixelShader, !data->bDisableCompatibilityMode), bPixelShader ? TEXT("pixel") : TEXT("vertex"), &bCached)))
+            continue;
+
+        if(bCached)
+            InterlockedIncrement(&data->numCached);
+
+        ShaderProcessor shaderProcessor;
+        shaderProcessor.ProcessShaderCached(strShader, strFile);
+    }
+
+    return 0;
+}
+
+static DWORD STDCALL ShaderPrewarmMain(ShaderPrewarmData *data)
+{
+    DWORD startTime = OSGetTime();
+
+    FindShaderFiles(data->files, TEXT("shaders"));
+
+    OSFindData ofd;
+    HANDLE hFind = OSFindFirstFile(TEXT("plugins\\*"), ofd);
+    if(hFind)
+    {
+        do
+        {
+            if(!ofd.bDirectory || ofd.fileName[0] == '.')
+                continue;
+
+            String strFolder;
+            strFolder << TEXT("plugins\\") << ofd.fileName << TEXT("\\shaders");
+            FindShaderFiles(data->files, strFolder);
+        } while(OSFindNextFile(hFind, ofd));
+
+        OSFindClose(hFind);
+    }
+
+    if(!data->files.Num())
+        return 0;
+
+    //-----------------------------------------------
+
+    UINT numThreads = MIN(MAX(OSGetLogicalCores()-1, 1), SHADER_PREWARM_MAX_THREADS);
+    numThreads = MIN(numThreads, data->files.Num());
+
+    List<HANDLE> threads;
+    for(UINT i=0; i<numThreads; i++)
+    {
+        HANDLE hThread = OSCreateThread((XTHREAD)ShaderPrewarmThread, data);
+        if(!hThread)
+            continue;
+
+        SetThreadPriority(hThread, THREAD_PRIORITY_BELOW_NORMAL);
+        threads << hThread;
+    }
+
+    for(UINT i=0; i<threads.Num(); i++)
+    {
+        OSWaitForThread(threads[i], NULL);
+        OSCloseThread(threads[i]);
+    }
+
+    if(!data->bStop)
+        Log(TEXT("Prewarmed %u shaders on %u threads in %u ms, %u were already in the shader cache"), data->files.Num(), threads.Num(), OSGetTime()-startTime, data->numCached);
+
+    return 0;
+}
+
+void StartShaderPrewarm()
+{
+    if(hPrewarmThread)
+        return;
+
+    prewarmData = new ShaderPrewarmData;
+    prewarmData->nextFile = 0;
+    prewarmData->numCached = 0;
+    prewarmData->bStop = false;
+    prewarmData->bDisableCompatibilityMode = D3D10System::CompatibilityModeDisabled();
+
+    hPrewarmThread = OSCreateThread((XTHREAD)ShaderPrewarmMain, prewarmData);
+    if(!hPrewarmThread)
+    {
+        delete prewarmData;
+        prewarmData = NULL;
+    }
+}
+
+void StopShaderPrewarm()
+{
+    if(!hPrewarmThread)
+        return;
+
+    prewarmData->bStop = true;
+
+    OSWaitForThread(hPrewarmThread, NULL);
+    OSCloseThread(hPrewarmThread);
+    hPrewarmThread = NULL;
+
+    delete prewarmData;
+    prewarmData = NULL;
+}
+
 D3D10Shader::~D3D10Shader()
 {
     for(UINT i=0; i<Samplers.Num(); i++)
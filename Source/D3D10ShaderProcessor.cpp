@@ -23,13 +23,13 @@
 //another stripped down code processor from my game engine
 
 
-#define PeekAtAToken(str) if(!GetNextToken(str, TRUE)) {return FALSE;}
-#define HandMeAToken(str) if(!GetNextToken(str)) {return FALSE;}
+#define PeekAtAToken(id) {if(pos >= code.Num()) {return FALSE;} id = pos;}
+#define HandMeAToken(id) {if(pos >= code.Num()) {return FALSE;} id = pos++;}
 
-#define EscapeLikeTheWind(gototoken) {if(!GotoToken(gototoken, TRUE)) {return FALSE;} continue;}
+#define EscapeLikeTheWind(gototoken) {if(!code.GotoToken(pos, gototoken, TRUE)) {return FALSE;} continue;}
 
-#define ExpectToken(expecting, gototoken) {if(!GetNextToken(curToken)) {return FALSE;} if(curToken != expecting) {if(!GotoToken(gototoken, TRUE)) {return FALSE;} continue;}}
-#define ExpectTokenIgnore(expecting) {if(!GetNextToken(curToken)) {return FALSE;} if(curToken != expecting) {continue;}}
+#define ExpectToken(expecting, gototoken) {HandMeAToken(curToken); if(!code.Is(curToken, expecting)) {if(!code.GotoToken(pos, gototoken, TRUE)) {return FALSE;} continue;}}
+#define ExpectTokenIgnore(expecting) {HandMeAToken(curToken); if(!code.Is(curToken, expecting)) {continue;}}
 
 
 CTSTR validSemanticTStrings[] = {TEXT("SV_Position"), TEXT("NORMAL"), TEXT("COLOR"), TEXT("TANGENT"), TEXT("TEXCOORD")};
@@ -41,7 +41,7 @@ struct SemanticInfo
     UINT index;
 };
 
-bool GetSemanticInfo(const String &strSemantic, SemanticInfo &info)
+bool GetSemanticInfo(CTSTR strSemantic, SemanticInfo &info)
 {
     for(UINT i=0; i<5; i++)
     {
@@ -64,40 +64,48 @@ bool GetSemanticInfo(const String &strSemantic, SemanticInfo &info)
 
 BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
 {
-    String curToken;
+    CodeTokenList code;
+    code.Tokenize(input);
 
-    BOOL bError = FALSE;
-
-    SetCodeStart(input);
+    UINT pos = 0, curToken = INVALID;
 
-    TSTR lpLastPos = lpTemp;
+    BOOL bError = FALSE;
 
     DWORD curInsideCount = 0;
     BOOL  bNewCodeLine = TRUE;
 
-    while(GetNextToken(curToken))
+    while(pos < code.Num())
     {
-        TSTR lpCurPos = lpTemp-curToken.Length();
+        curToken = pos++;
+
+        TCHAR ch = code.FirstChar(curToken);
 
-        if(curToken[0] == '{')
+        if(ch == '{')
             ++curInsideCount;
-        else if(curToken[0] == '}')
+        else if(ch == '}')
             --curInsideCount;
-        else if(curToken[0] == '(')
+        else if(ch == '(')
             ++curInsideCount;
-        else if(curToken[0] == ')')
+        else if(ch == ')')
             --curInsideCount;
-        else if(curToken[0] == '#') //preprocessor
+        else if(ch == '#') //preprocessor
         {
             HandMeAToken(curToken);
-            if(scmpi_n(curToken, TEXT("include"), 7) == 0)
+            if(scmpi_n(code.Text(curToken), TEXT("include"), 7) == 0)
             {
-                GetNextToken(curToken);
-                if(curToken[0] == '<')
+                if(pos >= code.Num())
+                    continue;
+
+                curToken = pos++;
+                if(code.FirstChar(curToken) == '<')
                     EscapeLikeTheWind(TEXT(">")); //TODO: handle #include <foo> directives
+                if(code.Length(curToken) <= 2)
+                    continue;
+
                 String parent(filename);
                 int num = parent.NumTokens('/');
-                String loadFile = curToken.Mid(1, curToken.Length()-1);
+                String loadFile;
+                loadFile.AppendString(code.Text(curToken)+1, code.Length(curToken)-2);
                 parent.FindReplace(parent.GetTokenOffset(num-1, '/'), loadFile);
                 
                 XFile ShaderFile;
@@ -112,20 +120,19 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
         }
         else if(!curInsideCount && bNewCodeLine) //not inside any code, so this is some sort of declaration (function/struct/var)
         {
-            if(curToken == TEXT("class"))
+            if(code.Is(curToken, TEXT("class")))
             {
-                while(GetNextToken(curToken))
+                while(pos < code.Num())
                 {
-                    if(curToken[0] == '{')
+                    curToken = pos++;
+
+                    if(code.FirstChar(curToken) == '{')
                         curInsideCount++;
-                    else if(curToken[0] == '}')
+                    else if(code.FirstChar(curToken) == '}')
                         curInsideCount--;
-                    else if(curToken[0] == ';')
-                        if(curInsideCount == 0)
-                            continue;
                 }
             }
-            else if(curToken == TEXT("struct"))
+            else if(code.Is(curToken, TEXT("struct")))
             {
                 //try to see if this is the vertex definition structure
                 bool bFoundDefinitionStruct = false;
@@ -137,25 +144,25 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
                 do 
                 {
                     HandMeAToken(curToken);
-                    if(curToken.Length() <= 6 && scmpi_n(curToken, TEXT("float"), 5) == 0)
+                    if(code.Length(curToken) <= 6 && scmpi_n(code.Text(curToken), TEXT("float"), 5) == 0)
                     {
-                        String strType = curToken;
+                        CTSTR lpType = code.Text(curToken);
 
-                        String strName;
-                        HandMeAToken(strName);
+                        HandMeAToken(curToken); //name
 
                         HandMeAToken(curToken);
-                        if(curToken[0] != ':') //cancel if not a vertex definition structure
+                        if(code.FirstChar(curToken) != ':') //cancel if not a vertex definition structure
                         {
                             bFoundDefinitionStruct = false;
                             break;
                         }
 
-                        String strSemantic;
-                        HandMeAToken(strSemantic);
+                        UINT semanticToken;
+                        HandMeAToken(semanticToken);
+                        CTSTR lpSemantic = code.Text(semanticToken);
 
                         SemanticInfo semanticInfo;
-                        if(!GetSemanticInfo(strSemantic, semanticInfo))
+                        if(!GetSemanticInfo(lpSemantic, semanticInfo))
                         {
                             bFoundDefinitionStruct = false;
                             break;
@@ -169,11 +176,11 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
                         inputElement.InputSlotClass         = D3D11_INPUT_PER_VERTEX_DATA;
                         inputElement.InstanceDataStepRate   = 0;
 
-                        if(strSemantic.CompareI(TEXT("color")))
+                        if(scmpi(lpSemantic, TEXT("color")) == 0)
                             inputElement.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
                         else
                         {
-                            switch(strType[5])
+                            switch(lpType[5])
                             {
                                 case 0:   inputElement.Format = DXGI_FORMAT_R32_FLOAT;          break;
                                 case '2': inputElement.Format = DXGI_FORMAT_R32G32_FLOAT;       break;
@@ -195,7 +202,7 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
                         bFoundDefinitionStruct = false;
                         break; //vertex definition structures should really only ever have float values
                     }
-                } while (curToken[0] != '}');
+                } while (code.FirstChar(curToken) != '}');
 
                 //set up the slots so they match up with vertex buffers
                 if(bFoundDefinitionStruct)
@@ -260,28 +267,28 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
                     } while(bFoundTexCoord);
                 }
             }
-            else if( (curToken != TEXT("const"))     &&
-                     (curToken != TEXT("void"))      &&
-                     (curToken != TEXT(";"))         )
+            else if( !code.Is(curToken, TEXT("const"))     &&
+                     !code.Is(curToken, TEXT("void"))      &&
+                     !code.Is(curToken, TEXT(";"))         )
             {
-                TSTR lpSavedPos = lpTemp;
-                String savedToken = curToken;
+                UINT savedPos = pos;
+                UINT savedToken = curToken;
 
-                if(curToken == TEXT("uniform"))
+                if(code.Is(curToken, TEXT("uniform")))
                     HandMeAToken(curToken);
 
-                String strType = curToken;
+                CTSTR lpType = code.Text(curToken);
 
-                String strName;
-                HandMeAToken(strName);
+                UINT nameToken;
+                HandMeAToken(nameToken);
 
                 PeekAtAToken(curToken);
-                if(curToken[0] != '(') //verified variable
+                if(code.FirstChar(curToken) != '(') //verified variable
                 {
-                    if(strType.CompareI(TEXT("samplerstate")))
+                    if(scmpi(lpType, TEXT("samplerstate")) == 0)
                     {
                         ShaderSampler &curSampler = *Samplers.CreateNew();
-                        curSampler.name = strName;
+                        curSampler.name = code.Text(nameToken);
 
                         SamplerInfo info;
 
@@ -289,17 +296,17 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
 
                         PeekAtAToken(curToken);
 
-                        while(curToken != TEXT("}"))
+                        while(!code.Is(curToken, TEXT("}")))
                         {
-                            String strState;
-                            HandMeAToken(strState);
+                            UINT stateToken;
+                            HandMeAToken(stateToken);
 
                             ExpectToken(TEXT("="), TEXT(";"));
 
-                            String strValue;
-                            HandMeAToken(strValue);
+                            UINT valueToken;
+                            HandMeAToken(valueToken);
 
-                            if(!AddState(info, strState, strValue))
+                            if(!AddState(info, code, stateToken, valueToken, pos))
                                 EscapeLikeTheWind(TEXT(";"));
 
                             ExpectToken(TEXT(";"), TEXT(";"));
@@ -307,40 +314,38 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
                             PeekAtAToken(curToken);
                         }
 
-                        curSampler.sampler = CreateSamplerState(info);
+                        curSampler.info = info;
 
                         ExpectToken(TEXT("}"), TEXT("}"));
                         ExpectTokenIgnore(TEXT(";"));
 
                         //----------------------------------------
 
-                        lpLastPos = lpTemp;
                         continue;
                     }
                     else
                     {
                         ShaderParam *param = Params.CreateNew();
-                        param->name = strName;
+                        param->name = code.Text(nameToken);
 
-                        if(curToken[0] == '[')
+                        if(code.FirstChar(curToken) == '[')
                         {
                             HandMeAToken(curToken);
 
                             HandMeAToken(curToken);
-                            param->arrayCount = tstoi(curToken);
+                            param->arrayCount = tstoi(code.Text(curToken));
 
                             ExpectToken(TEXT("]"), TEXT(";"));
 
                             PeekAtAToken(curToken);
                         }
 
-                        if(scmpi_n(strType, TEXT("texture"), 7) == 0)
+                        if(scmpi_n(lpType, TEXT("texture"), 7) == 0)
                         {
-                            TSTR lpType = strType.Array()+7;
-                            supr(lpType);
+                            CTSTR lpTextureType = lpType+7;
 
-                            if (!*lpType ||
-                                (scmp(lpType, TEXT("1D")) && scmp(lpType, TEXT("2D")) && scmp(lpType, TEXT("3D")) && scmp(lpType, TEXT("CUBE")))
+                            if (!*lpTextureType ||
+                                (scmpi(lpTextureType, TEXT("1D")) && scmpi(lpTextureType, TEXT("2D")) && scmpi(lpTextureType, TEXT("3D")) && scmpi(lpTextureType, TEXT("CUBE")))
                                 )
                             {
                                 bError = TRUE;
@@ -349,62 +354,62 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
                             param->textureID = nTextures++;
                             param->type = Parameter_Texture;
 
-                            strType = TEXT("sampler");
+                            lpType = TEXT("sampler");
                         }
-                        else if(scmp_n(strType, TEXT("float"), 5) == 0)
+                        else if(scmp_n(lpType, TEXT("float"), 5) == 0)
                         {
-                            CTSTR lpType = strType.Array()+5;
+                            CTSTR lpFloatType = lpType+5;
 
-                            if(*lpType == 0)
+                            if(*lpFloatType == 0)
                                 param->type = Parameter_Float;
-                            else if(scmpi(lpType, TEXT("2")) == 0)
+                            else if(scmpi(lpFloatType, TEXT("2")) == 0)
                                 param->type = Parameter_Vector2;
-                            else if(scmpi(lpType, TEXT("3")) == 0)
+                            else if(scmpi(lpFloatType, TEXT("3")) == 0)
                                 param->type = Parameter_Vector3;
-                            else if(scmpi(lpType, TEXT("4")) == 0)
+                            else if(scmpi(lpFloatType, TEXT("4")) == 0)
                                 param->type = Parameter_Vector4;
-                            else if(scmpi(lpType, TEXT("3x3")) == 0)
+                            else if(scmpi(lpFloatType, TEXT("3x3")) == 0)
                                 param->type = Parameter_Matrix3x3;
-                            else if(scmpi(lpType, TEXT("4x4")) == 0)
+                            else if(scmpi(lpFloatType, TEXT("4x4")) == 0)
                                 param->type = Parameter_Matrix;
                         }
-                        else if(scmp(strType, TEXT("int")) == 0)
+                        else if(scmp(lpType, TEXT("int")) == 0)
                             param->type = Parameter_Int;
-                        else if(scmp(strType, TEXT("bool")) == 0)
+                        else if(scmp(lpType, TEXT("bool")) == 0)
                             param->type = Parameter_Bool;
 
 
-                        if(curToken == TEXT("="))
+                        if(code.Is(curToken, TEXT("=")))
                         {
                             HandMeAToken(curToken);
 
                             BufferOutputSerializer sOut(param->defaultValue);
 
-                            if(scmp(strType, TEXT("float")) == 0)
+                            if(scmp(lpType, TEXT("float")) == 0)
                             {
                                 HandMeAToken(curToken);
 
-                                if(!ValidFloatString(curToken))
+                                if(!ValidFloatString(code.Text(curToken)))
                                     bError = TRUE;
 
-                                float fValue = (float)tstof(curToken);
+                                float fValue = (float)tstof(code.Text(curToken));
 
                                 sOut << fValue;
                             }
-                            else if(scmp(strType, TEXT("int")) == 0)
+                            else if(scmp(lpType, TEXT("int")) == 0)
                             {
                                 HandMeAToken(curToken);
 
-                                if(!ValidIntString(curToken))
+                                if(!ValidIntString(code.Text(curToken)))
                                     bError = TRUE;
 
-                                int iValue = tstoi(curToken);
+                                int iValue = tstoi(code.Text(curToken));
 
                                 sOut << iValue;
                             }
-                            else if(scmp_n(strType, TEXT("float"), 5) == 0)
+                            else if(scmp_n(lpType, TEXT("float"), 5) == 0)
                             {
-                                CTSTR lpFloatType = strType.Array()+5;
+                                CTSTR lpFloatType = lpType+5;
                                 int floatCount = 0;
 
                                 if(lpFloatType[0] == '1') floatCount = 1;
@@ -434,7 +439,7 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
                                     if(j)
                                     {
                                         HandMeAToken(curToken);
-                                        if(curToken[0] != ',')
+                                        if(code.FirstChar(curToken) != ',')
                                         {
                                             bError = TRUE;
                                             break;
@@ -443,19 +448,19 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
 
                                     HandMeAToken(curToken);
 
-                                    if(!ValidFloatString(curToken))
+                                    if(!ValidFloatString(code.Text(curToken)))
                                     {
                                         bError = TRUE;
                                         break;
                                     }
 
-                                    float fValue = (float)tstof(curToken);
+                                    float fValue = (float)tstof(code.Text(curToken));
                                     sOut << fValue;
                                 }
 
                                 if(j != floatCount) //processing error occured
                                 {
-                                    GotoToken(TEXT(";"));
+                                    code.GotoToken(pos, TEXT(";"));
                                     continue;
                                 }
 
@@ -469,29 +474,134 @@ BOOL ShaderProcessor::ProcessShader(CTSTR input, CTSTR filename)
 
                     //--------------------------
 
-                    lpLastPos = lpTemp;
                     bNewCodeLine = FALSE;
                     continue;
                 }
 
-                lpTemp = lpSavedPos;
+                pos = savedPos;
                 curToken = savedToken;
             }
         }
 
-        lpLastPos = lpTemp;
-
-        bNewCodeLine = (curToken.IsValid() && ((curToken[0] == ';') || (curToken[0] == '}')));
+        bNewCodeLine = (code.FirstChar(curToken) == ';') || (code.FirstChar(curToken) == '}');
     }
 
     return !bError;
 }
 
+//bump this whenever ProcessShader or SerializeData change what they produce
+#define SHADER_PROCESSOR_CACHE_VARIANT "ShaderProcessor 2"
+
+bool ShaderProcessor::SerializeData(Serializer &s)
+{
+    s << nTextures;
+
+    UINT numParams = Params.Num();
+    s << numParams;
+    if(s.IsLoading())
+        Params.SetSize(numParams);
+
+    for(UINT i=0; i<numParams; i++)
+    {
+        ShaderParam &param = Params[i];
+
+        s.Serialize(&param.type, sizeof(param.type));
+        s << param.name << param.samplerID << param.textureID << param.arrayCount << param.defaultValue;
+    }
+
+    UINT numSamplers = Samplers.Num();
+    s << numSamplers;
+    if(s.IsLoading())
+        Samplers.SetSize(numSamplers);
+
+    for(UINT i=0; i<numSamplers; i++)
+    {
+        ShaderSampler &sampler = Samplers[i];
+
+        s << sampler.name;
+        s.Serialize(&sampler.info, sizeof(sampler.info));
+    }
+
+    UINT numElements = generatedLayout.Num();
+    s << numElements;
+    if(s.IsLoading())
+        generatedLayout.SetSize(numElements);
+
+    for(UINT i=0; i<numElements; i++)
+    {
+        D3D11_INPUT_ELEMENT_DESC &element = generatedLayout[i];
+
+        //semantic names point at validSemanticStrings, so they're saved as an index into it
+        UINT semantic = 0;
+        if(!s.IsLoading())
+        {
+            while(semantic < 5 && element.SemanticName != validSemanticStrings[semantic])
+                semantic++;
+        }
+
+        s << semantic;
+        if(semantic >= 5)
+            return false;
+
+        element.SemanticName = validSemanticStrings[semantic];
+
+        s << element.SemanticIndex << element.InputSlot << element.AlignedByteOffset << element.InstanceDataStepRate;
+        s.Serialize(&element.Format, sizeof(element.Format));
+        s.Serialize(&element.InputSlotClass, sizeof(element.InputSlotClass));
+    }
+
+    BYTE flags = (bHasNormals ? 1 : 0) | (bHasColors ? 2 : 0) | (bHasTangents ? 4 : 0);
+    s << flags;
+    bHasNormals  = (flags & 1) != 0;
+    bHasColors   = (flags & 2) != 0;
+    bHasTangents = (flags & 4) != 0;
+
+    s << numTextureCoords;
+
+    //anything left over means the data wasn't written by this
+    return !s.IsLoading() || !s.DataPending();
+}
+
+//the parse results only depend on the source, so they're kept in the shader cache next to the compiled blobs
+BOOL ShaderProcessor::ProcessShaderCached(CTSTR input, CTSTR filename)
+{
+    QWORD key = GetShaderCacheKey(input, filename, SHADER_PROCESSOR_CACHE_VARIANT);
+
+    List<BYTE> data;
+    if(ShaderCacheLoad(key, data))
+    {
+        BufferInputSerializer sIn(data);
+        if(SerializeData(sIn))
+            return TRUE;
+
+        //unreadable, don't let it come back next time
+        ShaderCacheRemove(key);
+
+        FreeData();
+        generatedLayout.Clear();
+        nTextures = numTextureCoords = 0;
+        bHasNormals = bHasColors = bHasTangents = false;
+    }
+
+    //failures aren't cached so the warning still comes up every time the shader is loaded
+    if(!ProcessShader(input, filename))
+        return FALSE;
+
+    BufferOutputSerializer sOut(data, FALSE);
+    if(SerializeData(sOut))
+        ShaderCacheStore(key, data.Array(), data.Num());
+
+    return TRUE;
+}
+
 #undef  ExpectToken
-#define ExpectToken(expecting) {if(!GetNextToken(curToken)) {return FALSE;} if(curToken != expecting) {return FALSE;}}
+#define ExpectToken(expecting) {HandMeAToken(curToken); if(!code.Is(curToken, expecting)) {return FALSE;}}
 
-BOOL ShaderProcessor::AddState(SamplerInfo &info, String &stateName, String &stateVal)
+BOOL ShaderProcessor::AddState(SamplerInfo &info, CodeTokenList &code, UINT stateToken, UINT valueToken, UINT &pos)
 {
+    CTSTR stateName = code.Text(stateToken);
+    TSTR  stateVal  = code.Text(valueToken);
+
     if(scmpi_n(stateName, TEXT("Address"), 7) == 0)
     {
         int type = stateName[7]-'U';
@@ -505,51 +615,51 @@ BOOL ShaderProcessor::AddState(SamplerInfo &info, String &stateName, String &sta
             default: CrashError(TEXT("Invalid shader address type %d"), type);
         }
 
-        if(stateVal.CompareI(TEXT("Wrap")) || stateVal.CompareI(TEXT("Repeat")))
+        if((scmpi(stateVal, TEXT("Wrap")) == 0) || (scmpi(stateVal, TEXT("Repeat")) == 0))
             *mode = GS_ADDRESS_WRAP;
-        else if(stateVal.CompareI(TEXT("Clamp")) || stateVal.CompareI(TEXT("None")))
+        else if((scmpi(stateVal, TEXT("Clamp")) == 0) || (scmpi(stateVal, TEXT("None")) == 0))
             *mode = GS_ADDRESS_CLAMP;
-        else if(stateVal.CompareI(TEXT("Mirror")))
+        else if(scmpi(stateVal, TEXT("Mirror")) == 0)
             *mode = GS_ADDRESS_MIRROR;
-        else if(stateVal.CompareI(TEXT("Border")))
+        else if(scmpi(stateVal, TEXT("Border")) == 0)
             *mode = GS_ADDRESS_BORDER;
-        else if(stateVal.CompareI(TEXT("MirrorOnce")))
+        else if(scmpi(stateVal, TEXT("MirrorOnce")) == 0)
             *mode = GS_ADDRESS_MIRRORONCE;
     }
-    else if(stateName.CompareI(TEXT("MaxAnisotropy")))
+    else if(scmpi(stateName, TEXT("MaxAnisotropy")) == 0)
     {
         info.maxAnisotropy = tstoi(stateVal);
     }
-    else if(stateName.CompareI(TEXT("Filter")))
+    else if(scmpi(stateName, TEXT("Filter")) == 0)
     {
-        if(stateVal.CompareI(TEXT("Anisotropic")))
+        if(scmpi(stateVal, TEXT("Anisotropic")) == 0)
             info.filter = GS_FILTER_ANISOTROPIC;
-        else if(stateVal.CompareI(TEXT("Point")) || stateVal.CompareI(TEXT("MIN_MAG_MIP_POINT")))
+        else if((scmpi(stateVal, TEXT("Point")) == 0) || (scmpi(stateVal, TEXT("MIN_MAG_MIP_POINT")) == 0))
             info.filter = GS_FILTER_POINT;
-        else if(stateVal.CompareI(TEXT("Linear")) || stateVal.CompareI(TEXT("MIN_MAG_MIP_LINEAR")))
+        else if((scmpi(stateVal, TEXT("Linear")) == 0) || (scmpi(stateVal, TEXT("MIN_MAG_MIP_LINEAR")) == 0))
             info.filter = GS_FILTER_LINEAR;
-        else if(stateVal.CompareI(TEXT("MIN_MAG_POINT_MIP_LINEAR")))
+        else if(scmpi(stateVal, TEXT("MIN_MAG_POINT_MIP_LINEAR")) == 0)
             info.filter = GS_FILTER_MIN_MAG_POINT_MIP_LINEAR;
-        else if(stateVal.CompareI(TEXT("MIN_POINT_MAG_LINEAR_MIP_POINT")))
+        else if(scmpi(stateVal, TEXT("MIN_POINT_MAG_LINEAR_MIP_POINT")) == 0)
             info.filter = GS_FILTER_MIN_POINT_MAG_LINEAR_MIP_POINT;
-        else if(stateVal.CompareI(TEXT("MIN_POINT_MAG_MIP_LINEAR")))
+        else if(scmpi(stateVal, TEXT("MIN_POINT_MAG_MIP_LINEAR")) == 0)
             info.filter = GS_FILTER_MIN_POINT_MAG_MIP_LINEAR;
-        else if(stateVal.CompareI(TEXT("MIN_LINEAR_MAG_MIP_POINT")))
+        else if(scmpi(stateVal, TEXT("MIN_LINEAR_MAG_MIP_POINT")) == 0)
             info.filter = GS_FILTER_MIN_LINEAR_MAG_MIP_POINT;
-        else if(stateVal.CompareI(TEXT("MIN_LINEAR_MAG_POINT_MIP_LINEAR")))
+        else if(scmpi(stateVal, TEXT("MIN_LINEAR_MAG_POINT_MIP_LINEAR")) == 0)
             info.filter = GS_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
-        else if(stateVal.CompareI(TEXT("MIN_MAG_LINEAR_MIP_POINT")))
+        else if(scmpi(stateVal, TEXT("MIN_MAG_LINEAR_MIP_POINT")) == 0)
             info.filter = GS_FILTER_MIN_MAG_LINEAR_MIP_POINT;
     }
-    else if(stateName.CompareI(TEXT("BorderColor")))
+    else if(scmpi(stateName, TEXT("BorderColor")) == 0)
     {
         if(stateVal[0] == '{')
         {
-            String curToken;
+            UINT curToken;
 
             HandMeAToken(curToken);
-            if(!ValidFloatString(curToken)) {return FALSE;}
-            info.borderColor.x = (float)tstof(curToken);
+            if(!ValidFloatString(code.Text(curToken))) {return FALSE;}
+            info.borderColor.x = (float)tstof(code.Text(curToken));
 
             //-------------------------------
 
@@ -558,8 +668,8 @@ BOOL ShaderProcessor::AddState(SamplerInfo &info, String &stateName, String &sta
             //-------------------------------
 
             HandMeAToken(curToken);
-            if(!ValidFloatString(curToken)) {return FALSE;}
-            info.borderColor.y = (float)tstof(curToken);
+            if(!ValidFloatString(code.Text(curToken))) {return FALSE;}
+            info.borderColor.y = (float)tstof(code.Text(curToken));
 
             //-------------------------------
 
@@ -568,8 +678,8 @@ BOOL ShaderProcessor::AddState(SamplerInfo &info, String &stateName, String &sta
             //-------------------------------
 
             HandMeAToken(curToken);
-            if(!ValidFloatString(curToken)) {return FALSE;}
-            info.borderColor.z = (float)tstof(curToken);
+            if(!ValidFloatString(code.Text(curToken))) {return FALSE;}
+            info.borderColor.z = (float)tstof(code.Text(curToken));
 
             //-------------------------------
 
@@ -578,8 +688,8 @@ BOOL ShaderProcessor::AddState(SamplerInfo &info, String &stateName, String &sta
             //-------------------------------
 
             HandMeAToken(curToken);
-            if(!ValidFloatString(curToken)) {return FALSE;}
-            info.borderColor.w = (float)tstof(curToken);
+            if(!ValidFloatString(code.Text(curToken))) {return FALSE;}
+            info.borderColor.w = (float)tstof(code.Text(curToken));
 
             //-------------------------------
 
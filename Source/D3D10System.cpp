@@ -182,6 +182,11 @@ const static D3D_FEATURE_LEVEL featureLevels[] =
 	D3D_FEATURE_LEVEL_9_3,
 };
 
+bool D3D10System::CompatibilityModeDisabled()
+{
+    return true;//AppConfig->GetInt(TEXT("Video"), TEXT("DisableD3DCompatibilityMode"), 1) != 0;
+}
+
 D3D10System::D3D10System()
 {
     HRESULT err;
@@ -232,7 +237,7 @@ D3D10System::D3D10System()
     swapDesc.SampleDesc.Count = 1;
     swapDesc.Windowed = TRUE;
 
-    bDisableCompatibilityMode = 1;//AppConfig->GetInt(TEXT("Video"), TEXT("DisableD3DCompatibilityMode"), 1) != 0;
+    bDisableCompatibilityMode = CompatibilityModeDisabled();
 
     UINT createFlags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
     if(GlobalConfig->GetInt(TEXT("General"), TEXT("UseDebugD3D")))
@@ -130,6 +130,8 @@ public:
 
     LPVOID GetD3DTexture() {return texture;}
     virtual HANDLE GetSharedHandle();
+
+    virtual void SetImageRect(void *lpData, GSImageFormat imageFormat, UINT pitch, UINT x, UINT y, UINT cx, UINT cy);
 };
 
 //=============================================================================
@@ -161,7 +163,8 @@ struct ShaderParam
 struct ShaderSampler
 {
     String name;
-    SamplerState *sampler;
+    SamplerInfo info;
+    SamplerState *sampler;      //created from info when the shader is, processing doesn't touch the device
 
     inline ~ShaderSampler() {FreeData();}
 
@@ -174,10 +177,13 @@ struct ShaderSampler
 
 //--------------------------------------------------
 
-struct ShaderProcessor : CodeTokenizer
+struct ShaderProcessor
 {
     BOOL ProcessShader(CTSTR input, CTSTR filename);
-    BOOL AddState(SamplerInfo &info, String &stateName, String &stateVal);
+    BOOL ProcessShaderCached(CTSTR input, CTSTR filename);
+    BOOL AddState(SamplerInfo &info, CodeTokenList &code, UINT stateToken, UINT valueToken, UINT &pos);
+
+    bool SerializeData(Serializer &s);
 
     UINT nTextures;
     List<ShaderSampler> Samplers;
@@ -357,6 +363,9 @@ class D3D10System : public GraphicsSystem
 
     bool bDisableCompatibilityMode;
 
+    //what bDisableCompatibilityMode gets set to, for code that has to know before the system exists
+    static bool CompatibilityModeDisabled();
+
     //---------------------------
 
     D3D10Texture            *curRenderTarget;
@@ -484,3 +493,8 @@ public:
 
 inline ID3D11Device*        GetD3D()        {return static_cast<D3D10System*>(GS)->GetDeviceInline();}
 inline ID3D11DeviceContext* GetD3DCtx()     {return static_cast<D3D10System*>(GS)->GetContextInline();}
+
+//compiles and processes every shader in shaders\ and plugins\*\shaders\ into the shader cache on background
+//threads, so the first CreateXShaderFromFile calls only have to create the D3D objects
+void StartShaderPrewarm();
+void StopShaderPrewarm();
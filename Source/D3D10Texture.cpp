@@ -718,6 +718,48 @@ void D3D10Texture::Unmap()
     GetD3DCtx()->Unmap(texture, 0);
 }
 
+void D3D10Texture::SetImageRect(void *lpData, GSImageFormat imageFormat, UINT pitch, UINT x, UINT y, UINT cx, UINT cy)
+{
+    if(bDynamic)
+    {
+        SetImage(lpData, imageFormat, pitch);
+        return;
+    }
+
+    //no format conversions here, the data has to be copied straight in
+    bool bMatchingFormat = false;
+
+    switch(format)
+    {
+        case GS_RGB:    bMatchingFormat = (imageFormat == GS_IMAGEFORMAT_RGBX); break;
+        case GS_RGBA:   bMatchingFormat = (imageFormat == GS_IMAGEFORMAT_RGBA); break;
+        case GS_BGR:    bMatchingFormat = (imageFormat == GS_IMAGEFORMAT_BGRX); break;
+        case GS_BGRA:   bMatchingFormat = (imageFormat == GS_IMAGEFORMAT_BGRA); break;
+    }
+
+    if(!bMatchingFormat)
+    {
+        AppWarning(TEXT("D3D10Texture::SetImageRect: invalid or mismatching image format specified"));
+        return;
+    }
+
+    if(x >= width || y >= height)
+        return;
+
+    cx = MIN(cx, width-x);
+    cy = MIN(cy, height-y);
+
+    D3D11_BOX box;
+    box.left   = x;
+    box.top    = y;
+    box.front  = 0;
+    box.right  = x+cx;
+    box.bottom = y+cy;
+    box.back   = 1;
+
+    GetD3DCtx()->UpdateSubresource(texture, 0, &box, ((LPBYTE)lpData)+(y*pitch)+(x*4), pitch, 0);
+}
+
 HANDLE D3D10Texture::GetSharedHandle()
 {
     HRESULT err;
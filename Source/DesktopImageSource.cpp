@@ -559,6 +559,15 @@ public:
         return Vect2(float(width), float(height));
     }
 
+    //alpha is thrown away unless it's color keyed
+    bool IsOpaque() const
+    {
+        if(captureType == 1 && !hwndFoundWindow)
+            return false;
+
+        return lastRendered && !bUseColorKey && opacity == 100 && rotateDegrees == 0.0f;
+    }
+
     void UpdateSettings()
     {
         App->EnterSceneMutex();
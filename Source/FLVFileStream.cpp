@@ -76,6 +76,7 @@ public:
     {
         strFile = lpFile;
         initialTimestamp = -1;
+        metaDataPos = 0;
 
         if(!fileOut.Open(lpFile, XFILE_CREATEALWAYS, 1024*1024))
             return false;
@@ -96,6 +97,12 @@ public:
 
         enc = AMF_EncodeString(enc, pend, &av_onMetaData);
         char *endMetaData  = App->EncMetaData(enc, pend, true);
+        if(!endMetaData)
+        {
+            AppWarning(TEXT("FLVFileStream::Init: Could not encode the file metadata"));
+            return false;
+        }
+
         UINT  metaDataSize = endMetaData-metaDataBuffer;
 
         AppendFLVPacket((LPBYTE)metaDataBuffer, metaDataSize, 18, 0);
@@ -107,8 +114,9 @@ public:
         UINT64 fileSize = fileOut.GetPos();
         fileOut.Close();
 
+        //nothing to fill in if Init never got as far as writing the metadata
         XFile file;
-        if(file.Open(strFile, XFILE_WRITE, XFILE_OPENEXISTING))
+        if(fileSize > metaDataPos && file.Open(strFile, XFILE_WRITE, XFILE_OPENEXISTING))
         {
             double doubleFileSize = double(fileSize);
             double doubleDuration = double(lastTimeStamp/1000);
@@ -23,6 +23,7 @@
 class GlobalSource : public ImageSource
 {
     ImageSource *globalSource;
+    GlobalSourceCache *cache;
 
     XElement *data;
     ClassInfo *sourceClass;
@@ -41,13 +42,25 @@ public:
     //void Preprocess() {globalSource->Preprocess();}
     //void Tick(float fSeconds) {globalSource->Tick(fSeconds);}
 
-    void Render(const Vect2 &pos, const Vect2 &size) {if (globalSource) globalSource->Render(pos, size);}
+    void Render(const Vect2 &pos, const Vect2 &size)
+    {
+        if(cache && cache->Draw(pos, size))
+            return;
+
+        if(globalSource)
+            globalSource->Render(pos, size);
+    }
+
     Vect2 GetSize() const {return globalSource ? globalSource->GetSize() : Vect2(0.0f, 0.0f);}
 
+    bool HasContentChanged() {return globalSource ? globalSource->HasContentChanged() : true;}
+    bool IsOpaque() const    {return globalSource ? globalSource->IsOpaque() : false;}
+
     void UpdateSettings()
     {
         String strName = data->GetString(TEXT("name"));
         globalSource = App->GetGlobalSource(strName);
+        cache = App->GetGlobalSourceCache(strName);
     }
 
     //-------------------------------------------------------------
@@ -152,6 +165,7 @@ ImageSource* OBS::AddGlobalSourceToScene(CTSTR lpName)
                     info->strName = lpName;
                     info->element = globalSourceElement;
                     info->source = newGlobalSource;
+                    info->cache = new GlobalSourceCache;
 
                     info->source->BeginScene();
 
@@ -167,6 +181,29 @@ ImageSource* OBS::AddGlobalSourceToScene(CTSTR lpName)
     return NULL;
 }
 
+//renders the global sources that were drawn more than once last frame in to their cache textures.  returns
+//true if anything was rendered, in which case the render target, projection and viewport have to be set again
+bool OBS::RenderGlobalSourceCaches()
+{
+    bool bRenderedAny = false;
+
+    for(UINT i=0; i<globalSources.Num(); i++)
+    {
+        GlobalSourceInfo &info = globalSources[i];
+        if(!info.source || !info.cache)
+            continue;
+
+        //the desktop and device sources call it usePointFiltering, the text source pointFiltering
+        XElement *data = info.element->GetElement(TEXT("data"));
+        bool bPointFiltering = data && (data->GetInt(TEXT("usePointFiltering")) != 0 || data->GetInt(TEXT("pointFiltering")) != 0);
+
+        if(info.cache->Render(info.source, bPointFiltering))
+            bRenderedAny = true;
+    }
+
+    return bRenderedAny;
+}
+
 void OBS::GetGlobalSourceNames(List<CTSTR> &globalSourceNames, bool mainSceneGlobalSourceNames)
 {
     globalSourceNames.Clear();
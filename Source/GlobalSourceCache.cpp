@@ -0,0 +1,107 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#include "Main.h"
+
+
+GlobalSourceCache::~GlobalSourceCache()
+{
+    delete texture;
+    delete pointSampler;
+}
+
+void GlobalSourceCache::Invalidate()
+{
+    delete texture;
+    texture = NULL;
+    bRendered = false;
+    numInvalidations++;
+}
+
+bool GlobalSourceCache::Render(ImageSource *source, bool bPointFiltering)
+{
+    //only opaque sources come out of the texture looking the same, anything blended would get its alpha applied twice
+    if(!NextFrame(source->IsOpaque()))
+    {
+        if(texture)
+            Invalidate();
+        return false;
+    }
+
+    Vect2 size = source->GetSize();
+    UINT cx = UINT(size.x+EPSILON), cy = UINT(size.y+EPSILON);
+    if(!cx || !cy)
+        return false;
+
+    //the texture is drawn scaled, so it has to be sampled the way the source samples itself
+    if(bPointFiltering && !pointSampler)
+    {
+        SamplerInfo samplerInfo;
+        samplerInfo.filter = GS_FILTER_POINT;
+        pointSampler = CreateSamplerState(samplerInfo);
+        if(!pointSampler)
+            return false;
+    }
+
+    this->bPointFiltering = bPointFiltering;
+
+    if(texture && (texture->Width() != cx || texture->Height() != cy))
+        Invalidate();
+
+    if(!texture)
+    {
+        texture = CreateRenderTarget(cx, cy, GS_BGRA, FALSE);
+        if(!texture)
+            return false;
+    }
+
+    SetRenderTarget(texture);
+    Ortho(0.0f, float(cx), float(cy), 0.0f, -100.0f, 100.0f);
+    SetViewport(0.0f, 0.0f, float(cx), float(cy));
+    ClearColorBuffer();
+
+    source->Render(Vect2(0.0f, 0.0f), Vect2(float(cx), float(cy)));
+
+    bRendered = true;
+    numRenders++;
+    return true;
+}
+
+bool GlobalSourceCache::Draw(const Vect2 &pos, const Vect2 &size)
+{
+    if(!Use())
+        return false;
+
+    if(!bPointFiltering)
+    {
+        DrawSprite(texture, 0xFFFFFFFF, pos.x, pos.y, pos.x+size.x, pos.y+size.y);
+        return true;
+    }
+
+    Shader *pixelShader = GetCurrentPixelShader();
+
+    LoadSamplerState(pointSampler, 0);
+    DrawSprite(texture, 0xFFFFFFFF, pos.x, pos.y, pos.x+size.x, pos.y+size.y);
+
+    //reloading the shader puts its own samplers back for whatever's drawn next
+    LoadPixelShader(NULL);
+    LoadPixelShader(pixelShader);
+    return true;
+}
@@ -0,0 +1,71 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+//-------------------------------------------
+// a global source that's drawn more than once a frame (added to the scene a few times) gets rendered once in
+// to a texture before the scene, and the scene items draw the texture.  OBS::RenderGlobalSourceCaches calls
+// Render for every global source before the scene renders, GlobalSource::Render calls Draw in place of the
+// source.  a source that scales with point filtering gets its texture drawn with a point sampler too, so the
+// cached copies look the same as the source drawing itself.
+
+struct GlobalSourceCache
+{
+    Texture *texture;
+    SamplerState *pointSampler;
+    UINT uses, lastFrameUses;
+    bool bRendered; //texture holds the image for this frame
+    bool bPointFiltering;
+
+    //logged when the capture loop stops
+    UINT numRenders, numHits, numInvalidations;
+
+    ~GlobalSourceCache();
+
+    //starts a frame, returns true if the source should be rendered in to the texture for it
+    inline bool NextFrame(bool bCacheable)
+    {
+        lastFrameUses = uses;
+        uses = 0;
+        bRendered = false;
+
+        return bCacheable && lastFrameUses > 1;
+    }
+
+    //called every time the source is drawn, returns true if the texture should be drawn instead
+    inline bool Use()
+    {
+        uses++;
+        if(bRendered)
+            numHits++;
+
+        return bRendered;
+    }
+
+    void Invalidate();
+
+    //starts a frame and renders the source in to the texture if it's worth it.  returns true if anything was
+    //rendered, in which case the render target, projection and viewport have to be set again
+    bool Render(ImageSource *source, bool bPointFiltering);
+
+    //draws the texture in place of the source, returns false if the source has to draw itself
+    bool Draw(const Vect2 &pos, const Vect2 &size);
+};
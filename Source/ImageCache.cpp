@@ -0,0 +1,371 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "Main.h"
+#include "ImageCache.h"
+
+#include <gdiplus.h>
+
+
+#define IMAGE_LOADER_MAX_THREADS 4
+
+#define FNV64_OFFSET    0xCBF29CE484222325ULL
+#define FNV64_PRIME     0x00000100000001B3ULL
+
+struct CachedImage
+{
+    QWORD key;
+    UINT cx, cy;
+    LPBYTE lpPixels;
+    Texture *texture;
+    UINT refs;
+};
+
+struct ImageRequest
+{
+    String strPath;
+    CachedImage *image;
+    HANDLE hLoadedEvent;
+    volatile long refs;
+    volatile bool bLoaded;
+};
+
+static HANDLE hImageCacheMutex = NULL;
+static HANDLE hLoadSemaphore = NULL, hStopLoadEvent = NULL;
+static List<HANDLE> loaderThreads;
+
+static List<CachedImage*> cachedImages;
+static List<ImageRequest*> pendingRequests;
+
+//the last release can come from a loader thread, textures can only be destroyed on the graphics thread
+static List<Texture*> releasedTextures;
+
+
+static inline QWORD HashBytes(LPCVOID lpData, UINT size)
+{
+    const BYTE *lpBytes = (const BYTE*)lpData;
+    QWORD hash = FNV64_OFFSET;
+
+    for(UINT i=0; i<size; i++)
+        hash = (hash ^ lpBytes[i]) * FNV64_PRIME;
+
+    return hash;
+}
+
+//must be called with the mutex held
+static CachedImage* FindImage(QWORD key)
+{
+    for(UINT i=0; i<cachedImages.Num(); i++)
+    {
+        if(cachedImages[i]->key == key)
+            return cachedImages[i];
+    }
+
+    return NULL;
+}
+
+static void ReleaseCachedImage(CachedImage *image)
+{
+    OSEnterMutex(hImageCacheMutex);
+
+    bool bDestroy = (--image->refs == 0);
+    if(bDestroy)
+    {
+        cachedImages.RemoveItem(image);
+        if(image->texture)
+            releasedTextures << image->texture;
+    }
+
+    OSLeaveMutex(hImageCacheMutex);
+
+    if(bDestroy)
+    {
+        Free(image->lpPixels);
+        delete image;
+    }
+}
+
+//----------------------------------------------------------------------------
+
+static bool DecodeImage(HGLOBAL hData, CachedImage *image)
+{
+    IStream *stream;
+    if(FAILED(CreateStreamOnHGlobal(hData, FALSE, &stream)))
+        return false;
+
+    bool bSuccess = false;
+
+    {
+        Gdiplus::Bitmap bitmap(stream);
+        if(bitmap.GetLastStatus() == Gdiplus::Ok)
+        {
+            image->cx = bitmap.GetWidth();
+            image->cy = bitmap.GetHeight();
+
+            Gdiplus::Rect rect(0, 0, image->cx, image->cy);
+            Gdiplus::BitmapData bd;
+
+            //32bppARGB is BGRA in memory and not premultiplied, same as what D3DX loads
+            if(image->cx && image->cy && bitmap.LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &bd) == Gdiplus::Ok)
+            {
+                UINT pitch = image->cx*4;
+                image->lpPixels = (LPBYTE)Allocate(pitch*image->cy);
+
+                for(UINT y=0; y<image->cy; y++)
+                    mcpy(image->lpPixels+(y*pitch), (LPBYTE)bd.Scan0+(y*bd.Stride), pitch);
+
+                bitmap.UnlockBits(&bd);
+                bSuccess = true;
+            }
+        }
+    }
+
+    stream->Release();
+    return bSuccess;
+}
+
+static void LoadImageData(ImageRequest *request)
+{
+    XFile file;
+    if(!file.Open(request->strPath, XFILE_READ | XFILE_SHARED, XFILE_OPENEXISTING))
+    {
+        AppWarning(TEXT("LoadImageData: could not open '%s'"), request->strPath.Array());
+        return;
+    }
+
+    UINT fileSize = (UINT)file.GetFileSize();
+    HGLOBAL hData = GlobalAlloc(GMEM_MOVEABLE, MAX(fileSize, 1));
+    if(!hData)
+        return;
+
+    LPVOID lpData = GlobalLock(hData);
+    bool bRead = file.Read(lpData, fileSize) == fileSize;
+    QWORD key = HashBytes(lpData, fileSize);
+    GlobalUnlock(hData);
+
+    file.Close();
+
+    if(!bRead)
+    {
+        GlobalFree(hData);
+        return;
+    }
+
+    //------------------------------------
+
+    OSEnterMutex(hImageCacheMutex);
+
+    CachedImage *image = FindImage(key);
+    if(image)
+        image->refs++;
+
+    OSLeaveMutex(hImageCacheMutex);
+
+    if(!image)
+    {
+        CachedImage *newImage = new CachedImage;
+        newImage->key = key;
+        newImage->refs = 1;
+
+        if(!DecodeImage(hData, newImage))
+        {
+            Free(newImage->lpPixels);
+            delete newImage;
+            GlobalFree(hData);
+            return;
+        }
+
+        //another loader might have done the same file at the same time
+        OSEnterMutex(hImageCacheMutex);
+
+        image = FindImage(key);
+        if(image)
+            image->refs++;
+        else
+            cachedImages << (image = newImage);
+
+        OSLeaveMutex(hImageCacheMutex);
+
+        if(image != newImage)
+        {
+            Free(newImage->lpPixels);
+            delete newImage;
+        }
+    }
+
+    GlobalFree(hData);
+
+    request->image = image;
+}
+
+static DWORD STDCALL ImageLoaderThread(LPVOID lpUnused)
+{
+    HANDLE hEvents[2] = {hStopLoadEvent, hLoadSemaphore};
+
+    while(WaitForMultipleObjects(2, hEvents, FALSE, INFINITE) == WAIT_OBJECT_0+1)
+    {
+        OSEnterMutex(hImageCacheMutex);
+
+        ImageRequest *request = pendingRequests[0];
+        pendingRequests.Remove(0);
+
+        OSLeaveMutex(hImageCacheMutex);
+
+        //if the queue holds the only reference, nobody wants it anymore
+        if(request->refs > 1)
+            LoadImageData(request);
+
+        request->bLoaded = true;
+        SetEvent(request->hLoadedEvent);
+
+        ReleaseImage(request);
+    }
+
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+
+void InitImageCache()
+{
+    hImageCacheMutex = OSCreateMutex();
+    hLoadSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    hStopLoadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    int numThreads = MAX(MIN(OSGetTotalCores()/2, IMAGE_LOADER_MAX_THREADS), 1);
+    for(int i=0; i<numThreads; i++)
+    {
+        HANDLE hThread = OSCreateThread((XTHREAD)ImageLoaderThread, NULL);
+        if(hThread)
+            loaderThreads << hThread;
+    }
+}
+
+void FreeImageCache()
+{
+    SetEvent(hStopLoadEvent);
+
+    for(UINT i=0; i<loaderThreads.Num(); i++)
+    {
+        OSWaitForThread(loaderThreads[i], NULL);
+        OSCloseThread(loaderThreads[i]);
+    }
+    loaderThreads.Clear();
+
+    for(UINT i=0; i<pendingRequests.Num(); i++)
+    {
+        pendingRequests[i]->bLoaded = true;
+        ReleaseImage(pendingRequests[i]);
+    }
+    pendingRequests.Clear();
+
+    if(cachedImages.Num())
+        Log(TEXT("FreeImageCache: %u images were never released"), cachedImages.Num());
+
+    DeleteReleasedImageTextures();
+
+    CloseHandle(hLoadSemaphore);
+    CloseHandle(hStopLoadEvent);
+    OSCloseMutex(hImageCacheMutex);
+
+    hLoadSemaphore = hStopLoadEvent = hImageCacheMutex = NULL;
+}
+
+ImageRequest* LoadImageAsync(CTSTR lpPath)
+{
+    ImageRequest *request = new ImageRequest;
+    request->strPath = lpPath;
+    request->hLoadedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    request->refs = 2; //one for the caller, one for the queue
+
+    OSEnterMutex(hImageCacheMutex);
+    pendingRequests << request;
+    OSLeaveMutex(hImageCacheMutex);
+
+    ReleaseSemaphore(hLoadSemaphore, 1, NULL);
+
+    return request;
+}
+
+void ReleaseImage(ImageRequest *request)
+{
+    if(InterlockedDecrement(&request->refs))
+        return;
+
+    if(request->image)
+        ReleaseCachedImage(request->image);
+
+    CloseHandle(request->hLoadedEvent);
+    delete request;
+}
+
+bool ImageLoaded(ImageRequest *request)
+{
+    return request->bLoaded;
+}
+
+void WaitForImage(ImageRequest *request)
+{
+    if(!request->bLoaded)
+        WaitForSingleObject(request->hLoadedEvent, INFINITE);
+}
+
+bool GetImageSize(ImageRequest *request, UINT &cx, UINT &cy)
+{
+    if(!request->bLoaded || !request->image)
+        return false;
+
+    cx = request->image->cx;
+    cy = request->image->cy;
+    return true;
+}
+
+void DeleteReleasedImageTextures()
+{
+    List<Texture*> textures;
+
+    OSEnterMutex(hImageCacheMutex);
+    textures.TransferFrom(releasedTextures);
+    OSLeaveMutex(hImageCacheMutex);
+
+    for(UINT i=0; i<textures.Num(); i++)
+        delete textures[i];
+}
+
+Texture* GetImageTexture(ImageRequest *request)
+{
+    if(!request->bLoaded || !request->image)
+        return NULL;
+
+    CachedImage *image = request->image;
+
+    OSEnterMutex(hImageCacheMutex);
+
+    if(!image->texture && image->lpPixels)
+    {
+        image->texture = CreateTexture(image->cx, image->cy, GS_BGRA, image->lpPixels, FALSE, TRUE);
+
+        Free(image->lpPixels);
+        image->lpPixels = NULL;
+    }
+
+    OSLeaveMutex(hImageCacheMutex);
+
+    return image->texture;
+}
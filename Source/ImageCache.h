@@ -0,0 +1,46 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// image cache.  files are read and decoded to BGRA on a few loader threads, and decoded images are
+// shared by a hash of the file contents, so the same picture used by several sources is only decoded
+// and uploaded once.  the texture is created the first time someone asks for it on the graphics side,
+// after which the decoded pixels are dropped.  an image stays around as long as any request uses it.
+
+struct ImageRequest;
+
+void InitImageCache();
+void FreeImageCache();
+
+ImageRequest* LoadImageAsync(CTSTR lpPath);
+void ReleaseImage(ImageRequest *request);
+
+//true once the loader is done with it, whether it worked or not
+bool ImageLoaded(ImageRequest *request);
+void WaitForImage(ImageRequest *request);
+
+//only valid once loaded.  these fail if the file couldn't be read or decoded
+bool GetImageSize(ImageRequest *request, UINT &cx, UINT &cy);
+Texture* GetImageTexture(ImageRequest *request);
+
+//graphics thread only.  destroys the textures of images whose last request was released since the last
+//call, which might have happened on a loader thread
+void DeleteReleasedImageTextures();
@@ -0,0 +1,119 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// latency probe SEI.  a user_data_unregistered SEI carrying the wall clock time (unix epoch, milliseconds,
+// big endian) at which a frame was captured, so an ingest can compute glass-to-ingest latency and jitter by
+// comparing it against its own arrival times.  written by RTMPPublisher and read by the test ingest server,
+// so nothing in here can depend on either of them.
+
+#define LATENCY_PROBE_NAL_MAX   64 //4 byte length prefix, headers, payload with worst case emulation prevention
+
+//identifies the probe:  {4f425370-726f-6265-4c61-74656e637921}
+static const BYTE latencyProbeUUID[16] = {0x4f, 0x42, 0x53, 0x70, 0x72, 0x6f, 0x62, 0x65, 0x4c, 0x61, 0x74, 0x65, 0x6e, 0x63, 0x79, 0x21};
+
+//writes a length prefixed SEI NAL as it appears in an AVC video packet, returns its total size
+inline UINT WriteLatencyProbeNAL(LPBYTE lpOutput, QWORD unixTimeMS)
+{
+    BYTE payload[24];
+    memcpy(payload, latencyProbeUUID, sizeof(latencyProbeUUID));
+    for(int i=0; i<8; i++)
+        payload[16+i] = BYTE(unixTimeMS >> (56-i*8));
+
+    UINT size = 4; //length, filled in below
+    lpOutput[size++] = 0x06;                //nal_unit_type: SEI
+    lpOutput[size++] = 5;                   //payloadType: user_data_unregistered
+    lpOutput[size++] = BYTE(sizeof(payload));
+
+    //emulation prevention, the timestamp bytes can contain start code sequences
+    UINT zeroCount = 0;
+    for(UINT i=0; i<sizeof(payload); i++)
+    {
+        if(zeroCount == 2 && payload[i] <= 3)
+        {
+            lpOutput[size++] = 3;
+            zeroCount = 0;
+        }
+
+        lpOutput[size++] = payload[i];
+        zeroCount = payload[i] ? 0 : zeroCount+1;
+    }
+
+    lpOutput[size++] = 0x80; //rbsp_trailing_bits
+
+    UINT nalSize = size-4;
+    lpOutput[0] = BYTE(nalSize >> 24);
+    lpOutput[1] = BYTE(nalSize >> 16);
+    lpOutput[2] = BYTE(nalSize >> 8);
+    lpOutput[3] = BYTE(nalSize);
+
+    return size;
+}
+
+//looks for a latency probe in a single SEI NAL (starting at the nal header, no length prefix)
+inline bool ReadLatencyProbeNAL(const BYTE *lpNAL, UINT size, QWORD &unixTimeMS)
+{
+    if(!size || (lpNAL[0] & 0x1F) != 6)
+        return false;
+
+    //strip emulation prevention bytes first, SEI payloads are small so this never needs much room
+    BYTE rbsp[256];
+    UINT rbspSize = 0, zeroCount = 0;
+    for(UINT i=1; i<size && rbspSize<sizeof(rbsp); i++)
+    {
+        if(zeroCount == 2 && lpNAL[i] == 3)
+        {
+            zeroCount = 0;
+            continue;
+        }
+
+        rbsp[rbspSize++] = lpNAL[i];
+        zeroCount = lpNAL[i] ? 0 : zeroCount+1;
+    }
+
+    UINT pos = 0;
+    while(pos < rbspSize && rbsp[pos] != 0x80)
+    {
+        UINT payloadType = 0, payloadSize = 0;
+        while(pos < rbspSize && rbsp[pos] == 0xFF) payloadType += rbsp[pos++];
+        if(pos >= rbspSize) break;
+        payloadType += rbsp[pos++];
+
+        while(pos < rbspSize && rbsp[pos] == 0xFF) payloadSize += rbsp[pos++];
+        if(pos >= rbspSize) break;
+        payloadSize += rbsp[pos++];
+
+        if(payloadSize > rbspSize-pos)
+            break;
+
+        if(payloadType == 5 && payloadSize >= 24 && memcmp(rbsp+pos, latencyProbeUUID, sizeof(latencyProbeUUID)) == 0)
+        {
+            unixTimeMS = 0;
+            for(int i=0; i<8; i++)
+                unixTimeMS = (unixTimeMS << 8) | rbsp[pos+16+i];
+            return true;
+        }
+
+        pos += payloadSize;
+    }
+
+    return false;
+}
@@ -18,6 +18,7 @@
 
 
 #include "Main.h"
+#include "ImageCache.h"
 
 #include <shellapi.h>
 #include <shlobj.h>
@@ -667,6 +668,21 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
         InitXTLog(strLog);
 
+        if(GlobalConfig->GetInt(TEXT("General"), TEXT("EnableTimeline")))
+        {
+            String strTimelineFolder;
+            strTimelineFolder << lpAppDataPath << TEXT("\\logs");
+            EnableTimeline(TRUE, GlobalConfig->GetInt(TEXT("General"), TEXT("TimelineEvents"), 0x40000), strTimelineFolder);
+        }
+
+        if(GlobalConfig->GetInt(TEXT("General"), TEXT("ShaderCache"), 1))
+        {
+            String strShaderCachePath;
+            strShaderCachePath << lpAppDataPath << TEXT("\\shaderCache");
+            InitShaderCache(strShaderCachePath);
+            StartShaderPrewarm();
+        }
+
         //--------------------------------------------
 
         BOOL bDisableComposition = AppConfig->GetInt(TEXT("Video"), TEXT("DisableAero"), 0);
@@ -682,6 +698,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         OSFileChangeData *pGCHLogMF = NULL;
         pGCHLogMF = OSMonitorFileStart (strCaptureHookLog, true);
 
+        InitImageCache();
+
         App = new OBS;
 
         HACCEL hAccel = LoadAccelerators(hinstMain, MAKEINTRESOURCE(IDR_ACCELERATOR1));
@@ -698,6 +716,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
         delete App;
 
+        FreeImageCache();
+
+        StopShaderPrewarm();
+        FreeShaderCache();
+        FreeMetrics();
+
         //--------------------------------------------
 
         CCGetCustomColors(colors);
@@ -0,0 +1,326 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "Main.h"
+#include "MetricsServer.h"
+
+
+#define METRICS_REQUEST_SIZE    4096
+#define METRICS_SOCKET_TIMEOUT  2000
+
+
+MetricsServer::MetricsServer()
+    : listenSocket(INVALID_SOCKET), hAcceptEvent(WSA_INVALID_EVENT), hStopEvent(NULL), hThread(NULL), port(0), snapshotInterval(0)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    Stop();
+}
+
+bool MetricsServer::Start(UINT port, CTSTR lpSnapshotFile, DWORD snapshotIntervalMS)
+{
+    if(port)
+    {
+        listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+        sockaddr_in addr;
+        zero(&addr, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((u_short)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if(listenSocket == INVALID_SOCKET ||
+           bind(listenSocket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+           listen(listenSocket, SOMAXCONN) == SOCKET_ERROR)
+        {
+            Log(TEXT("MetricsServer::Start: could not listen on port %u, error %d"), port, WSAGetLastError());
+
+            if(listenSocket != INVALID_SOCKET)
+                closesocket(listenSocket);
+            listenSocket = INVALID_SOCKET;
+        }
+        else
+        {
+            hAcceptEvent = WSACreateEvent();
+            WSAEventSelect(listenSocket, hAcceptEvent, FD_ACCEPT);
+
+            this->port = port;
+            Log(TEXT("Serving metrics on http://127.0.0.1:%u/metrics"), port);
+        }
+    }
+
+    if(lpSnapshotFile && snapshotIntervalMS)
+    {
+        strSnapshotFile = lpSnapshotFile;
+        snapshotInterval = snapshotIntervalMS;
+
+        Log(TEXT("Writing a metrics snapshot to '%s' every %u ms"), lpSnapshotFile, snapshotIntervalMS);
+    }
+
+    if(listenSocket == INVALID_SOCKET && !snapshotInterval)
+        return false;
+
+    hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    hThread = OSCreateThread((XTHREAD)MetricsServer::ServerThread, this);
+
+    return hThread != NULL;
+}
+
+void MetricsServer::Stop()
+{
+    if(hThread)
+    {
+        SetEvent(hStopEvent);
+        OSWaitForThread(hThread, NULL);
+        OSCloseThread(hThread);
+        hThread = NULL;
+    }
+
+    if(hStopEvent)
+    {
+        CloseHandle(hStopEvent);
+        hStopEvent = NULL;
+    }
+
+    if(listenSocket != INVALID_SOCKET)
+    {
+        closesocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+    }
+
+    if(hAcceptEvent != WSA_INVALID_EVENT)
+    {
+        WSACloseEvent(hAcceptEvent);
+        hAcceptEvent = WSA_INVALID_EVENT;
+    }
+}
+
+DWORD STDCALL MetricsServer::ServerThread(MetricsServer *server)
+{
+    server->ServerLoop();
+    return 0;
+}
+
+void MetricsServer::ServerLoop()
+{
+    HANDLE events[2] = {hStopEvent, hAcceptEvent};
+    DWORD numEvents = (listenSocket != INVALID_SOCKET) ? 2 : 1;
+
+    DWORD nextSnapshotTime = OSGetTime();
+
+    while(true)
+    {
+        DWORD timeout = INFINITE;
+        if(snapshotInterval)
+        {
+            int timeLeft = int(nextSnapshotTime-OSGetTime());
+            timeout = (timeLeft > 0) ? DWORD(timeLeft) : 0;
+        }
+
+        DWORD ret = WaitForMultipleObjects(numEvents, events, FALSE, timeout);
+
+        if(ret == WAIT_OBJECT_0+1)
+        {
+            WSAResetEvent(hAcceptEvent);
+
+            SOCKET client;
+            while((client = accept(listenSocket, NULL, NULL)) != INVALID_SOCKET)
+                ServeClient(client);
+        }
+        else if(ret == WAIT_TIMEOUT)
+        {
+            WriteSnapshot();
+
+            nextSnapshotTime += snapshotInterval;
+            if(int(nextSnapshotTime-OSGetTime()) <= 0)
+                nextSnapshotTime = OSGetTime()+snapshotInterval;
+        }
+        else
+            break;
+    }
+}
+
+static void SendAll(SOCKET s, const char *lpData, int len)
+{
+    while(len > 0)
+    {
+        int ret = send(s, lpData, len, 0);
+        if(ret <= 0)
+            return;
+
+        lpData += ret;
+        len -= ret;
+    }
+}
+
+//true if the request's Host header is the loopback address with our port, or no port.  anything else
+//(including no Host at all, which browsers always send) is refused
+static bool IsLoopbackHost(const char *request, UINT port)
+{
+    const char *lpLine = strstr(request, "\r\n");
+    while(lpLine && strncmp(lpLine, "\r\n\r\n", 4) != 0)
+    {
+        lpLine += 2;
+        if(_strnicmp(lpLine, "Host:", 5) == 0)
+        {
+            const char *lpHost = lpLine+5;
+            while(*lpHost == ' ' || *lpHost == '\t')
+                lpHost++;
+
+            size_t hostLen = strcspn(lpHost, " \t\r\n");
+
+            static const char *loopbackNames[] = {"127.0.0.1", "localhost", "[::1]"};
+            for(UINT i=0; i<_countof(loopbackNames); i++)
+            {
+                size_t nameLen = strlen(loopbackNames[i]);
+                if(hostLen < nameLen || _strnicmp(lpHost, loopbackNames[i], nameLen) != 0)
+                    continue;
+
+                if(hostLen == nameLen)
+                    return true;
+
+                char portStr[16];
+                sprintf_s(portStr, ":%u", port);
+                return hostLen-nameLen == strlen(portStr) && strncmp(lpHost+nameLen, portStr, hostLen-nameLen) == 0;
+            }
+
+            return false;
+        }
+
+        lpLine = strstr(lpLine, "\r\n");
+    }
+
+    return false;
+}
+
+//requests are served one at a time on the server thread, they're small and only come from the local machine
+void MetricsServer::ServeClient(SOCKET client)
+{
+    //accepted sockets inherit the event selection of the listening socket, make this one plain and blocking again
+    WSAEventSelect(client, NULL, 0);
+    u_long nonBlocking = 0;
+    ioctlsocket(client, FIONBIO, &nonBlocking);
+
+    DWORD socketTimeout = METRICS_SOCKET_TIMEOUT;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&socketTimeout, sizeof(socketTimeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&socketTimeout, sizeof(socketTimeout));
+
+    char request[METRICS_REQUEST_SIZE];
+    int requestLen = 0;
+
+    while(requestLen < METRICS_REQUEST_SIZE-1)
+    {
+        int ret = recv(client, request+requestLen, METRICS_REQUEST_SIZE-1-requestLen, 0);
+        if(ret <= 0)
+            break;
+
+        requestLen += ret;
+        request[requestLen] = 0;
+
+        if(strstr(request, "\r\n\r\n"))
+            break;
+    }
+    request[requestLen] = 0;
+
+    //request line: METHOD PATH VERSION
+    char *lpPath = strchr(request, ' ');
+    char *lpPathEnd = lpPath ? strpbrk(lpPath+1, " ?\r\n") : NULL;
+
+    CTSTR lpStatus = TEXT("200 OK");
+    CTSTR lpContentType = TEXT("text/plain; charset=utf-8");
+    String strBody;
+
+    if(!lpPathEnd || strncmp(request, "GET ", 4) != 0)
+    {
+        lpStatus = TEXT("405 Method Not Allowed");
+        strBody = TEXT("only GET is supported\n");
+    }
+    else if(!IsLoopbackHost(request, port))
+    {
+        lpStatus = TEXT("403 Forbidden");
+        strBody = TEXT("use http://127.0.0.1 or http://localhost\n");
+    }
+    else
+    {
+        *lpPathEnd = 0;
+        lpPath++;
+
+        if(strcmp(lpPath, "/metrics") == 0)
+        {
+            lpContentType = TEXT("text/plain; version=0.0.4; charset=utf-8");
+            strBody = GetMetricsPrometheus();
+        }
+        else if(strcmp(lpPath, "/metrics.json") == 0)
+        {
+            lpContentType = TEXT("application/json; charset=utf-8");
+            strBody = GetMetricsJSON();
+        }
+        else
+        {
+            lpStatus = TEXT("404 Not Found");
+            strBody = TEXT("try /metrics or /metrics.json\n");
+        }
+    }
+
+    LPSTR lpBody = strBody.CreateUTF8String();
+    int bodyLen = lpBody ? (int)strlen(lpBody) : 0;
+
+    String strHeader;
+    strHeader << TEXT("HTTP/1.0 ") << lpStatus << TEXT("\r\n")
+              << TEXT("Content-Type: ") << lpContentType << TEXT("\r\n")
+              << TEXT("Content-Length: ") << IntString(bodyLen) << TEXT("\r\n")
+              << TEXT("Connection: close\r\n\r\n");
+
+    LPSTR lpHeader = strHeader.CreateUTF8String();
+    SendAll(client, lpHeader, (int)strlen(lpHeader));
+    if(bodyLen)
+        SendAll(client, lpBody, bodyLen);
+
+    Free(lpHeader);
+    if(lpBody)
+        Free(lpBody);
+
+    shutdown(client, SD_SEND);
+    closesocket(client);
+}
+
+void MetricsServer::WriteSnapshot()
+{
+    String strJSON = GetMetricsJSON();
+    strJSON << TEXT("\r\n");
+
+    //write to a temporary file first so whatever is watching the snapshot never reads half of one
+    String strTempFile = strSnapshotFile;
+    strTempFile << TEXT(".tmp");
+
+    XFile file;
+    if(!file.Open(strTempFile, XFILE_WRITE, XFILE_CREATEALWAYS))
+    {
+        RUNONCE Log(TEXT("MetricsServer::WriteSnapshot: could not open '%s'"), strTempFile.Array());
+        return;
+    }
+
+    file.WriteAsUTF8(strJSON, strJSON.Length());
+    file.Close();
+
+    if(!OSRenameFile(strTempFile, strSnapshotFile))
+        RUNONCE Log(TEXT("MetricsServer::WriteSnapshot: could not replace '%s'"), strSnapshotFile.Array());
+}
@@ -0,0 +1,51 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+#include <winsock2.h>
+
+//serves the metrics registry to monitoring tools: Prometheus text at http://127.0.0.1:<port>/metrics
+//and JSON at /metrics.json, plus an optional JSON snapshot written to a file every few seconds.
+//only listens on the loopback address, anything remote has to go through an exporter or a tunnel.
+//requests also have to name the loopback address in their Host header, so a web page can't reach the
+//endpoint through a DNS name that it rebinds to 127.0.0.1.
+class MetricsServer
+{
+    SOCKET listenSocket;
+    WSAEVENT hAcceptEvent;
+    HANDLE hStopEvent;
+    HANDLE hThread;
+    UINT port;
+
+    String strSnapshotFile;
+    DWORD snapshotInterval;
+
+    static DWORD STDCALL ServerThread(MetricsServer *server);
+    void ServerLoop();
+    void ServeClient(SOCKET client);
+    void WriteSnapshot();
+
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    bool Start(UINT port, CTSTR lpSnapshotFile, DWORD snapshotIntervalMS);
+    void Stop();
+};
@@ -18,6 +18,7 @@
 
 
 #include "Main.h"
+#include "MetricsServer.h"
 #include <intrin.h>
 
 void SetupSceneCollection(CTSTR scenecollection);
@@ -619,6 +620,7 @@ OBS::OBS()
 
     hHotkeyMutex = OSCreateMutex();
     hInfoMutex = OSCreateMutex();
+    hMetaDataMutex = OSCreateMutex();
     hStartupShutdownMutex = OSCreateMutex();
 
     //-----------------------------------------------------
@@ -671,6 +673,35 @@ OBS::OBS()
 
     hHotkeyThread = OSCreateThread((XTHREAD)HotkeyThread, NULL);
 
+    //-----------------------------------------------------
+
+    static const LONGLONG encodeTimeBounds[] = {1000, 2000, 4000, 8000, 16000, 33000, 50000, 100000};
+
+    framesEncodedMetric     = RegisterCounter(TEXT("obs_frames_encoded_total"), TEXT("Video frames passed to the encoder"));
+    framesDuplicatedMetric  = RegisterCounter(TEXT("obs_frames_duplicated_total"), TEXT("Video frames encoded again because no new frame was rendered in time"));
+    framesSkippedMetric     = RegisterCounter(TEXT("obs_frames_skipped_total"), TEXT("Video frames skipped due to encoder lag"));
+    framesLaggedMetric      = RegisterCounter(TEXT("obs_frames_lagged_total"), TEXT("Rendered frames that took longer than the frame interval"));
+    encodeTimeMetric        = RegisterHistogram(TEXT("obs_encode_frame_time_us"), TEXT("Time taken to encode and send out a video frame, in microseconds"), encodeTimeBounds, _countof(encodeTimeBounds));
+    audioBufferedTimeMetric = RegisterGauge(TEXT("obs_audio_buffered_time_ms"), TEXT("Desktop audio currently buffered, in milliseconds"));
+
+    //the metrics endpoint and snapshot are meant for unattended streams and are off unless set in global.ini
+    metricsServer = NULL;
+
+    UINT metricsPort = GlobalConfig->GetInt(TEXT("General"), TEXT("MetricsPort"), 0);
+    UINT metricsSnapshotInterval = GlobalConfig->GetInt(TEXT("General"), TEXT("MetricsSnapshotInterval"), 0);
+    if(metricsPort || metricsSnapshotInterval)
+    {
+        String strSnapshotFile;
+        strSnapshotFile << lpAppDataPath << TEXT("\\metrics.json");
+
+        metricsServer = new MetricsServer;
+        if(!metricsServer->Start(metricsPort, strSnapshotFile, metricsSnapshotInterval*1000))
+        {
+            delete metricsServer;
+            metricsServer = NULL;
+        }
+    }
+
 #ifndef OBS_DISABLE_AUTOUPDATE
     ULARGE_INTEGER lastUpdateTime;
     ULARGE_INTEGER currentTime;
@@ -824,6 +855,8 @@ OBS::~OBS()
 
     OSTerminateThread(hHotkeyThread, 2500);
 
+    delete metricsServer;
+
     ClosePendingStreams();
 
     for(UINT i=0; i<plugins.Num(); i++)
@@ -918,6 +951,8 @@ OBS::~OBS()
 
     if(hInfoMutex)
         OSCloseMutex(hInfoMutex);
+    if(hMetaDataMutex)
+        OSCloseMutex(hMetaDataMutex);
     if(hHotkeyMutex)
         OSCloseMutex(hHotkeyMutex);
 
@@ -23,6 +23,7 @@
 
 class Scene;
 class SettingsPane;
+class MetricsServer;
 struct EncoderPicture;
 
 #define NUM_RENDER_BUFFERS 2
@@ -383,8 +384,9 @@ struct GlobalSourceInfo
     String strName;
     XElement *element;
     ImageSource *source;
+    GlobalSourceCache *cache;
 
-    inline void FreeData() {strName.Clear(); delete source; source = NULL;}
+    inline void FreeData() {strName.Clear(); delete source; source = NULL; delete cache; cache = NULL;}
 };
 
 //----------------------------
@@ -527,6 +529,14 @@ struct SceneHotkeyInfo
     XElement *scene;
 };
 
+//a scene that was switched away from but is kept around (ended) so switching back to it doesn't have to
+//create all of its sources again
+struct WarmScene
+{
+    XElement *element;
+    Scene *scene;
+};
+
 //----------------------------
 
 struct StreamInfo
@@ -540,6 +550,17 @@ struct StreamInfo
 
 //----------------------------
 
+//encoded onMetaData object, reused until any of the values it was built from change
+struct MetaDataCache
+{
+    int maxBitRate, fps, audioBitRate;
+    UINT width, height, sampleRate, channels;
+    bool bAAC;
+    List<char> data;
+};
+
+//-------------------------------------------------------------------
+
 struct ServiceIdentifier
 {
     int id;
@@ -693,6 +714,14 @@ class OBS
     List<SceneHotkeyInfo>   sceneHotkeys;
     XElement                *sceneElement;
 
+    List<WarmScene>         warmScenes; //most recently used first
+    UINT                    numWarmScenes;
+
+    Scene* TakeWarmScene(XElement *sceneElement);
+    void KeepWarmScene(XElement *sceneElement, Scene *scene);
+    void DropWarmScene(XElement *sceneElement);
+    void ClearWarmScenes();
+
     inline void RemoveSceneHotkey(DWORD hotkey)
     {
         for(UINT i=0; i<sceneHotkeys.Num(); i++)
@@ -904,6 +933,14 @@ private:
 
     HANDLE hAuxAudioMutex;
 
+    //---------------------------------------------------
+    // health metrics
+
+    MetricsServer *metricsServer;
+
+    Metric *framesEncodedMetric, *framesDuplicatedMetric, *framesSkippedMetric, *framesLaggedMetric;
+    Metric *encodeTimeMetric, *audioBufferedTimeMetric;
+
     //---------------------------------------------------
     // hotkey stuff
 
@@ -993,6 +1030,19 @@ private:
         return AddGlobalSourceToScene(lpName);
     }
 
+    inline GlobalSourceCache* GetGlobalSourceCache(CTSTR lpName)
+    {
+        for(UINT i=0; i<globalSources.Num(); i++)
+        {
+            if(globalSources[i].strName.CompareI(lpName))
+                return globalSources[i].cache;
+        }
+
+        return NULL;
+    }
+
+    bool RenderGlobalSourceCaches();
+
     inline ClassInfo* GetSceneClass(CTSTR lpClass) const
     {
         for(UINT i=0; i<sceneClasses.Num(); i++)
@@ -1174,6 +1224,10 @@ public:
     inline QWORD GetAudioTime() const {return latestAudioTime;}
     inline QWORD GetVideoTime() const {return latestVideoTime;}
 
+    //metadata is encoded from the stream and file output threads
+    HANDLE hMetaDataMutex;
+    MetaDataCache metaDataCache[2];
+    char* EncodeMetaData(char *enc, char *pend, bool bFLVFile);
     char* EncMetaData(char *enc, char *pend, bool bFLVFile=false);
 
     inline void PostStopMessage(bool forceStop=false) {if(hwndMain) PostMessage(hwndMain, OBS_REQUESTSTOP, forceStop ? 1 : 0, 0);}
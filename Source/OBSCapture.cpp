@@ -18,6 +18,7 @@
 
 
 #include "Main.h"
+#include "ImageCache.h"
 #include <time.h>
 #include <Avrt.h>
 
@@ -33,6 +34,7 @@ AudioSource* CreateAudioSource(bool bMic, CTSTR lpID);
 NetworkStream* CreateRTMPPublisher();
 NetworkStream* CreateDelayedPublisher(DWORD delayTime);
 NetworkStream* CreateBandwidthAnalyzer();
+NetworkStream* CreateBandwidthProbe();
 
 void StartBlankSoundPlayback(CTSTR lpDevice);
 void StopBlankSoundPlayback();
@@ -360,8 +362,9 @@ void OBS::Start(bool recordingOnly, bool replayBufferOnly)
 
     DisableMenusWhileStreaming(true);
 
-    scenesConfig.SaveTo(String() << lpAppDataPath << "\\scenes.xconfig");
-    scenesConfig.Save();
+    //written by the config's save thread so starting the stream doesn't wait on the disk
+    scenesConfig.SaveToInBackground(String() << lpAppDataPath << "\\scenes.xconfig");
+    scenesConfig.SaveInBackground();
 
     //-------------------------------------------------------------
 
@@ -462,7 +465,10 @@ retryHookTest:
 
     bFirstConnect = !bReconnecting;
 
-    if(bTestStream || recordingOnly || replayBufferOnly || !bStreamFlushed)
+    //the bandwidth probe turns the stream test into a measurement of the link to the configured server
+    if(bTestStream && networkMode == 0 && bStreamFlushed && AppConfig->GetInt(TEXT("Publish"), TEXT("BandwidthProbe"), 0))
+        network.reset(CreateBandwidthProbe());
+    else if(bTestStream || recordingOnly || replayBufferOnly || !bStreamFlushed)
         network.reset(CreateNullNetwork());
     else
     {
@@ -822,6 +828,8 @@ retryHookTestV2:
     bufferingTime = GlobalConfig->GetInt(TEXT("General"), TEXT("SceneBufferingTime"), 700);
     Log(TEXT("Scene buffering time set to %u"), bufferingTime);
 
+    numWarmScenes = (UINT)MIN(MAX(GlobalConfig->GetInt(TEXT("General"), TEXT("WarmScenes"), 2), 0), 8);
+
     //-------------------------------------------------------------
 
     bForceMicMono = AppConfig->GetInt(TEXT("Audio"), TEXT("ForceMicMono")) != 0;
@@ -1070,10 +1078,14 @@ void OBS::Stop(bool overrideKeepRecording, bool stopReplayBuffer)
     delete scene;
     scene = NULL;
 
+    ClearWarmScenes();
+
     for(UINT i=0; i<globalSources.Num(); i++)
         globalSources[i].FreeData();
     globalSources.Clear();
 
+    DeleteReleasedImageTextures();
+
     //-------------------------------------------------------------
 
     for(UINT i=0; i<auxAudioSources.Num(); i++)
@@ -1186,6 +1198,7 @@ void OBS::Stop(bool overrideKeepRecording, bool stopReplayBuffer)
 DWORD STDCALL OBS::MainAudioThread(LPVOID lpUnused)
 {
     CoInitialize(0);
+    SetTimelineThreadName(TEXT("audio"));
     App->MainAudioLoop();
     CoUninitialize();
     return 0;
@@ -1322,6 +1335,8 @@ bool OBS::QueryNewAudio()
             break;
     }
 
+    MetricSet(audioBufferedTimeMetric, desktopAudio->GetBufferedTime());
+
     /* wait until buffers are completely filled before accounting for burst */
     if (!bAudioBufferFilled)
     {
@@ -1427,6 +1442,8 @@ void OBS::MainAudioLoop()
         bool bMicEnabled   = (micAudio != NULL);
 
         if (QueryNewAudio()) {
+            traceSegment("audio frame");
+
             QWORD timestamp = bufferedAudioTimes[0];
             bufferedAudioTimes.Remove(0);
 
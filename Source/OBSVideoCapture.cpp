@@ -18,6 +18,8 @@
 
 
 #include "Main.h"
+#include "WorkerPool.h"
+#include "ImageCache.h"
 
 #include <inttypes.h>
 #include "mfxstructures.h"
@@ -32,15 +34,22 @@ extern "C"
 void Convert444toI420(LPBYTE input, int width, int pitch, int height, int startY, int endY, LPBYTE *output);
 void Convert444toNV12(LPBYTE input, int width, int inPitch, int outPitch, int height, int startY, int endY, LPBYTE *output);
 
+static void STDCALL PreprocessSourceAsync(ImageSource *source)
+{
+    source->PreprocessAsync();
+}
+
 
 DWORD STDCALL OBS::EncodeThread(LPVOID lpUnused)
 {
+    SetTimelineThreadName(TEXT("encode"));
     App->EncodeLoop();
     return 0;
 }
 
 DWORD STDCALL OBS::MainCaptureThread(LPVOID lpUnused)
 {
+    SetTimelineThreadName(TEXT("video"));
     App->MainCaptureLoop();
     return 0;
 }
@@ -59,6 +68,8 @@ struct Convert444Data
 
 DWORD STDCALL Convert444Thread(Convert444Data *data)
 {
+    SetTimelineThreadName(TEXT("convert 444"));
+
     do
     {
         WaitForSingleObject(data->hSignalConvert, INFINITE);
@@ -441,8 +452,11 @@ void OBS::EncodeLoop()
             }
         } else {
             numFramesSkipped++;
-            if (!encoderInfo)
+            MetricIncrement(framesSkippedMetric);
+            if (!encoderInfo) {
                 encoderInfo = AddStreamInfo(Str("EncoderLag"), StreamInfoPriority_Critical);
+                TriggerTimelineDump(TEXT("Encoder lag detected"));
+            }
             messageTime = 0;
         }
 
@@ -467,20 +481,28 @@ void OBS::EncodeLoop()
             frameInfo.pic = curFramePic;
 
             if (lastPic == frameInfo.pic)
+            {
                 numTotalDuplicatedFrames++;
+                MetricIncrement(framesDuplicatedMetric);
+            }
 
             if(bUsingQSV)
                 curFramePic->mfxOut->Data.TimeStamp = curFrameTimestamp;
             else
                 curFramePic->picOut->i_pts = curFrameTimestamp;
 
+            QWORD encodeStartTime = OSGetTimeMicroseconds();
+
             ProcessFrame(frameInfo);
 
+            MetricObserve(encodeTimeMetric, LONGLONG(OSGetTimeMicroseconds()-encodeStartTime));
+
             lastPic = frameInfo.pic;
 
             profileOut;
 
             numTotalFrames++;
+            MetricIncrement(framesEncodedMetric);
         }
 
         if (bShutdownEncodeThread)
@@ -605,6 +627,12 @@ void OBS::MainCaptureLoop()
     int curRenderTarget = 0, curYUVTexture = 0, curCopyTexture = 0;
     int copyWait = NUM_RENDER_BUFFERS-1;
 
+    Scene *lastRenderedScene = NULL;
+
+    //sources that can do the cpu side of their preprocessing on other threads all do it at once
+    WorkerPool preprocessPool(MIN(MAX(OSGetTotalCores()/2, 1), 4));
+    List<ImageSource*> asyncSources;
+
     bSentHeaders = false;
     bFirstAudioPacket = true;
 
@@ -817,6 +845,8 @@ void OBS::MainCaptureLoop()
 
         OSEnterMutex(hSceneMutex);
 
+        DeleteReleasedImageTextures();
+
         if (bPleaseEnableProjector)
             ActuallyEnableProjector();
         else if(bPleaseDisableProjector)
@@ -833,6 +863,18 @@ void OBS::MainCaptureLoop()
         if(scene)
         {
             profileIn("scene->Preprocess");
+
+            asyncSources.Clear();
+            scene->GetAsyncPreprocessSources(asyncSources);
+
+            for(UINT i=0; i<globalSources.Num(); i++)
+            {
+                if(globalSources[i].source->SupportsAsyncPreprocess())
+                    asyncSources << globalSources[i].source;
+            }
+
+            preprocessPool.Run((WORKERJOBPROC)PreprocessSourceAsync, (LPVOID*)asyncSources.Array(), asyncSources.Num());
+
             scene->Preprocess();
 
             for(UINT i=0; i<globalSources.Num(); i++)
@@ -909,8 +951,31 @@ void OBS::MainCaptureLoop()
         Ortho(0.0f, baseSize.x, baseSize.y, 0.0f, -100.0f, 100.0f);
         SetViewport(0, 0, baseSize.x, baseSize.y);
 
-        if(scene)
+        //if nothing in the scene changed since the last frame, that frame just gets copied instead
+        if(scene && scene == lastRenderedScene && !scene->HasChanged())
+        {
+            D3D10Texture *d3dLastTex = static_cast<D3D10Texture*>(mainRenderTextures[lastRenderTarget]);
+            D3D10Texture *d3dSceneTex = static_cast<D3D10Texture*>(mainRenderTextures[curRenderTarget]);
+            GetD3DCtx()->CopyResource(d3dSceneTex->texture, d3dLastTex->texture);
+        }
+        else if(scene)
+        {
+            if(RenderGlobalSourceCaches())
+            {
+                LoadVertexShader(mainVertexShader);
+                LoadPixelShader(mainPixelShader);
+
+                SetRenderTarget(mainRenderTextures[curRenderTarget]);
+
+                Ortho(0.0f, baseSize.x, baseSize.y, 0.0f, -100.0f, 100.0f);
+                SetViewport(0, 0, baseSize.x, baseSize.y);
+            }
+
             scene->Render();
+            lastRenderedScene = scene;
+        }
+        else
+            lastRenderedScene = NULL;
 
         //------------------------------------
 
@@ -1335,6 +1400,8 @@ void OBS::MainCaptureLoop()
         if(bWasLaggedFrame = (frameDelta > frameLengthNS))
         {
             numLongFrames++;
+            MetricIncrement(framesLaggedMetric);
+            traceInstant("lagged frame");
             if(bLogLongFramesProfile && (numLongFrames/float(max(1, numTotalFrames)) * 100.) > logLongFramesProfilePercentage)
                 DumpLastProfileData();
         }
@@ -1398,4 +1465,12 @@ void OBS::MainCaptureLoop()
     Free(convertInfo);
 
     Log(TEXT("Total frames rendered: %d, number of late frames: %d (%0.2f%%) (it's okay for some frames to be late)"), numTotalFrames, numLongFrames, (numTotalFrames > 0) ? (double(numLongFrames)/double(numTotalFrames))*100.0 : 0.0f);
+
+    for(UINT i=0; i<globalSources.Num(); i++)
+    {
+        GlobalSourceCache *cache = globalSources[i].cache;
+        if(cache && cache->numRenders)
+            Log(TEXT("Global source '%s' was rendered to its cache %u times and drawn from it %u times, the cache was invalidated %u times"),
+                globalSources[i].strName.Array(), cache->numRenders, cache->numHits, cache->numInvalidations);
+    }
 }
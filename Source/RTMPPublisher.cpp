@@ -20,6 +20,7 @@
 #include "Main.h"
 #include "RTMPStuff.h"
 #include "RTMPPublisher.h"
+#include "LatencyProbe.h"
 
 #define MAX_BUFFERED_PACKETS 10
 
@@ -121,7 +122,71 @@ RTMPPublisher::RTMPPublisher()
     
     bFastInitialKeyframe = AppConfig->GetInt(TEXT("Publish"), TEXT("FastInitialKeyframe"), 0) == 1;
 
+    sendTimeout = AppConfig->GetInt(TEXT("Publish"), TEXT("SendTimeout"), 5000);
+
+    //------------------------------------------
+
+    //fast reconnect re-handshakes in the background instead of stopping the stream, the delayed publisher
+    //is excluded since its packets are already committed to a timeline by the time they reach the network
+    bFastReconnect = AppConfig->GetInt(TEXT("Publish"), TEXT("FastReconnect"), 0) == 1 && AppConfig->GetInt(TEXT("Publish"), TEXT("Delay")) == 0;
+    if (bFastReconnect)
+    {
+        reconnectBacklogTime = AppConfig->GetInt(TEXT("Publish"), TEXT("FastReconnectBacklog"), 5000);
+        if(reconnectBacklogTime < 1000)         reconnectBacklogTime = 1000;
+        else if(reconnectBacklogTime > 30000)   reconnectBacklogTime = 30000;
+
+        reconnectMaxAttempts = AppConfig->GetInt(TEXT("Publish"), TEXT("FastReconnectAttempts"), 10);
+        if(reconnectMaxAttempts < 1)
+            reconnectMaxAttempts = 1;
+
+        bUseStandby = AppConfig->GetInt(TEXT("Publish"), TEXT("FastReconnectStandby"), 0) == 1;
+
+        Log(TEXT("Using fast reconnect, backlog %u ms, %u attempts%s"), reconnectBacklogTime, reconnectMaxAttempts, bUseStandby ? TEXT(", with standby connection") : TEXT(""));
+    }
+
+    //------------------------------------------
+
+    bLatencyProbe = AppConfig->GetInt(TEXT("Publish"), TEXT("LatencyProbe"), 0) == 1;
+    if (bLatencyProbe)
+    {
+        latencyProbeInterval = AppConfig->GetInt(TEXT("Publish"), TEXT("LatencyProbeInterval"), 1000);
+        Log(TEXT("Embedding latency probe SEI every %u ms"), latencyProbeInterval);
+    }
+
+    hStandbyMutex = OSCreateMutex();
+    hReconnectExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+
     strRTMPErrors.Clear();
+
+    //------------------------------------------
+
+    droppedBFramesMetric = RegisterCounter(TEXT("obs_rtmp_dropped_b_frames_total"), TEXT("B-frames dropped because the network couldn't keep up"));
+    droppedPFramesMetric = RegisterCounter(TEXT("obs_rtmp_dropped_p_frames_total"), TEXT("P-frames dropped because the network couldn't keep up"));
+    bytesSentMetric      = RegisterCounter(TEXT("obs_rtmp_sent_bytes_total"), TEXT("Bytes written to the RTMP socket"));
+    queuedBytesMetric    = RegisterGauge(TEXT("obs_rtmp_queued_bytes"), TEXT("Packet data queued for sending"));
+    socketBufferMetric   = RegisterGauge(TEXT("obs_rtmp_socket_buffer_bytes"), TEXT("Data waiting in the socket send buffer"));
+
+    AddMetricsCollector((METRICSCOLLECTPROC)RTMPPublisher::CollectMetrics, this);
+}
+
+void STDCALL RTMPPublisher::CollectMetrics(RTMPPublisher *publisher)
+{
+    MetricSet(publisher->queuedBytesMetric, publisher->currentBufferSize);
+    MetricSet(publisher->socketBufferMetric, publisher->curDataBufferLen);
+}
+
+void RTMPPublisher::CountDroppedFrame(PacketType type)
+{
+    if(type < PacketType_VideoHigh)
+    {
+        numBFramesDumped++;
+        MetricIncrement(droppedBFramesMetric);
+    }
+    else
+    {
+        numPFramesDumped++;
+        MetricIncrement(droppedPFramesMetric);
+    }
 }
 
 bool RTMPPublisher::Init(UINT tcpBufferSize)
@@ -136,6 +201,41 @@ bool RTMPPublisher::Init(UINT tcpBufferSize)
 
     //------------------------------------------
 
+    this->tcpBufferSize = tcpBufferSize;
+    ApplySocketOptions();
+
+    //------------------------------------------
+
+    hSendThread = OSCreateThread((XTHREAD)RTMPPublisher::SendThread, this);
+    if(!hSendThread)
+        CrashError(TEXT("RTMPPublisher: Could not create send thread"));
+
+    hBufferEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    hBufferSpaceAvailableEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    hWriteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    hSendLoopExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+    hSocketLoopExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+    hSocketAbort = CreateEvent(NULL, TRUE, FALSE, NULL);
+    hSendBacklogEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    hDataBufferMutex = OSCreateMutex();
+
+    dataBuffer = (BYTE *)Allocate(dataBufferSize);
+
+    hSocketThread = OSCreateThread((XTHREAD)RTMPPublisher::SocketThread, this);
+    if(!hSocketThread)
+        CrashError(TEXT("RTMPPublisher: Could not create send thread"));
+
+    //------------------------------------------
+
+    packetWaitType = 0;
+
+    return true;
+}
+
+void RTMPPublisher::ApplySocketOptions()
+{
     int curTCPBufSize, curTCPBufSizeSize = sizeof(curTCPBufSize);
     
     if (!getsockopt(rtmp->m_sb.sb_socket, SOL_SOCKET, SO_SNDBUF, (char *)&curTCPBufSize, &curTCPBufSizeSize))
@@ -168,34 +268,6 @@ bool RTMPPublisher::Init(UINT tcpBufferSize)
     {
         Log(TEXT("getsockopt: Failed to query SO_SNDBUF, error %d"), WSAGetLastError());
     }
-
-    //------------------------------------------
-
-    hSendThread = OSCreateThread((XTHREAD)RTMPPublisher::SendThread, this);
-    if(!hSendThread)
-        CrashError(TEXT("RTMPPublisher: Could not create send thread"));
-
-    hBufferEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-    hBufferSpaceAvailableEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-    hWriteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-
-    hSendLoopExit = CreateEvent(NULL, TRUE, FALSE, NULL);
-    hSocketLoopExit = CreateEvent(NULL, TRUE, FALSE, NULL);
-    hSendBacklogEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-
-    hDataBufferMutex = OSCreateMutex();
-
-    dataBuffer = (BYTE *)Allocate(dataBufferSize);
-
-    hSocketThread = OSCreateThread((XTHREAD)RTMPPublisher::SocketThread, this);
-    if(!hSocketThread)
-        CrashError(TEXT("RTMPPublisher: Could not create send thread"));
-
-    //------------------------------------------
-
-    packetWaitType = 0;
-
-    return true;
 }
 
 void RTMPPublisher::InitEncoderData()
@@ -216,7 +288,14 @@ void RTMPPublisher::InitEncoderData()
     enc = AMF_EncodeString(enc, pend, &av_setDataFrame);
     enc = AMF_EncodeString(enc, pend, &av_onMetaData);
     enc = App->EncMetaData(enc, pend);
-    metaDataPacketBuffer.resize(enc - metaDataPacketBuffer.data());
+    if (enc)
+        metaDataPacketBuffer.resize(enc - metaDataPacketBuffer.data());
+    else
+    {
+        //BeginPublishingInternal stops the stream when there's no metadata to send
+        Log(TEXT("RTMPPublisher::InitEncoderData: Could not encode the stream metadata"));
+        metaDataPacketBuffer.clear();
+    }
 
     App->GetAudioHeaders(audioHeaders);
 
@@ -228,6 +307,49 @@ RTMPPublisher::~RTMPPublisher()
     //OSDebugOut (TEXT("*** ~RTMPPublisher (%d queued, %d buffered, %d data)\n"), queuedPackets.Num(), bufferedPackets.Num(), curDataBufferLen);
     bStopping = true;
 
+    RemoveMetricsCollector((METRICSCOLLECTPROC)RTMPPublisher::CollectMetrics, this);
+    MetricSet(queuedBytesMetric, 0);
+    MetricSet(socketBufferMetric, 0);
+
+    SetEvent(hReconnectExit);
+
+    //same for a background reconnect, which may be blocked on the new connection
+    if (hReconnectThread)
+    {
+        if (WaitForSingleObject(hReconnectThread, 0) == WAIT_TIMEOUT)
+        {
+            OSEnterMutex(hRTMPMutex);
+            if (reconnectRTMP && reconnectRTMP->m_sb.sb_socket != -1)
+            {
+                closesocket(reconnectRTMP->m_sb.sb_socket);
+                reconnectRTMP->m_sb.sb_socket = -1;
+            }
+            OSLeaveMutex(hRTMPMutex);
+        }
+
+        OSTerminateThread(hReconnectThread, 5000);
+    }
+
+    //the standby thread may be in the middle of a handshake too
+    if (hStandbyThread)
+    {
+        if (WaitForSingleObject(hStandbyThread, 0) == WAIT_TIMEOUT)
+        {
+            OSEnterMutex(hRTMPMutex);
+            if (standbyConnectingRTMP && standbyConnectingRTMP->m_sb.sb_socket != -1)
+            {
+                closesocket(standbyConnectingRTMP->m_sb.sb_socket);
+                standbyConnectingRTMP->m_sb.sb_socket = -1;
+            }
+            OSLeaveMutex(hRTMPMutex);
+        }
+
+        OSTerminateThread(hStandbyThread, 5000);
+    }
+
+    if (standbyRTMP)
+        FreeRTMP(standbyRTMP);
+
     //we're in the middle of connecting! wait for that to happen to avoid all manner of race conditions
     if (hConnectionThread)
     {
@@ -298,8 +420,11 @@ RTMPPublisher::~RTMPPublisher()
         //wake it up in case it already is empty
         SetEvent(hBufferEvent);
 
-        //wait 60 sec for it to exit
-        OSTerminateThread(hSocketThread, 60000);
+        //wait 60 sec for it to flush, then stop any send still blocked on the socket before giving up on it
+        if (WaitForSingleObject(hSocketThread, 60000) == WAIT_TIMEOUT)
+            SetEvent(hSocketAbort);
+
+        OSTerminateThread(hSocketThread, 5000);
 
         Log(TEXT("~RTMPPublisher: Socket thread terminated in %d ms"), OSGetTime() - startTime);
     }
@@ -373,6 +498,9 @@ RTMPPublisher::~RTMPPublisher()
     if (hSocketLoopExit)
         CloseHandle(hSocketLoopExit);
 
+    if (hSocketAbort)
+        CloseHandle(hSocketAbort);
+
     if (hSendBacklogEvent)
         CloseHandle(hSendBacklogEvent);
 
@@ -382,6 +510,12 @@ RTMPPublisher::~RTMPPublisher()
     if (hWriteEvent)
         CloseHandle(hWriteEvent);
 
+    if (hReconnectExit)
+        CloseHandle(hReconnectExit);
+
+    if (hStandbyMutex)
+        OSCloseMutex(hStandbyMutex);
+
     if(rtmp)
     {
         if (rtmp->Link.pubUser.av_val)
@@ -391,12 +525,25 @@ RTMPPublisher::~RTMPPublisher()
         RTMP_Free(rtmp);
     }
 
+    if (lpAnsiURL)
+        Free(lpAnsiURL);
+
+    if (lpAnsiPlaypath)
+        Free(lpAnsiPlaypath);
+
     //--------------------------
 
     for(UINT i=0; i<queuedPackets.Num(); i++)
         queuedPackets[i].data.Clear();
     queuedPackets.Clear();
 
+    for(UINT i=0; i<reconnectBacklog.Num(); i++)
+        reconnectBacklog[i].data.Clear();
+    reconnectBacklog.Clear();
+
+    if (numReconnects)
+        Log(TEXT("Number of fast reconnects: %u"), numReconnects);
+
     double dBFrameDropPercentage = double(numBFramesDumped)/max(1, NumTotalVideoFrames())*100.0;
     double dPFrameDropPercentage = double(numPFramesDumped)/max(1, NumTotalVideoFrames())*100.0;
 
@@ -545,7 +692,7 @@ void RTMPPublisher::SendPacket(BYTE *data, UINT size, DWORD timestamp, PacketTyp
 {
     InitEncoderData();
 
-    if(!bConnected && !bConnecting && !bStopping)
+    if(!bConnected && !bConnecting && !bReconnecting && !bStopping)
     {
         hConnectionThread = OSCreateThread((XTHREAD)CreateConnectionThread, this);
         bConnecting = true;
@@ -688,6 +835,9 @@ void RTMPPublisher::SendPacketForReal(BYTE *data, UINT size, DWORD timestamp, Pa
                 paddedData.SetSize(size+RTMP_MAX_HEADER_SIZE);
                 mcpy(paddedData.Array()+RTMP_MAX_HEADER_SIZE, data, size);
 
+                if(bLatencyProbe && type != PacketType_Audio)
+                    AddLatencyProbe(paddedData, timestamp);
+
                 if(!bSentFirstKeyframe)
                 {
                     DataPacket sei;
@@ -710,18 +860,75 @@ void RTMPPublisher::SendPacketForReal(BYTE *data, UINT size, DWORD timestamp, Pa
                 queuedPacket->type = type;
             }
             else
-            {
-                if(type < PacketType_VideoHigh)
-                    numBFramesDumped++;
-                else
-                    numPFramesDumped++;
-            }
+                CountDroppedFrame(type);
         }
     }
+    else if(bReconnecting)
+        AddReconnectBacklogPacket(data, size, timestamp, type);
 
     OSLeaveMutex(hDataMutex);
 }
 
+void RTMPPublisher::AddReconnectBacklogPacket(BYTE *data, UINT size, DWORD timestamp, PacketType type)
+{
+    //only keep what's needed to resume from the most recent keyframe
+    if(type == PacketType_VideoHighest)
+    {
+        for(UINT i=0; i<reconnectBacklog.Num(); i++)
+            reconnectBacklog[i].data.Clear();
+        reconnectBacklog.Clear();
+
+        bReconnectBacklogValid = true;
+    }
+
+    if(!bReconnectBacklogValid)
+        return;
+
+    if(reconnectBacklog.Num() && timestamp-reconnectBacklog[0].timestamp > reconnectBacklogTime)
+    {
+        //the gop is longer than we're willing to hold, throw it away and wait for a fresh keyframe
+        for(UINT i=0; i<reconnectBacklog.Num(); i++)
+            reconnectBacklog[i].data.Clear();
+        reconnectBacklog.Clear();
+
+        bReconnectBacklogValid = false;
+        RequestKeyframe(0);
+        return;
+    }
+
+    NetworkPacket *packet = reconnectBacklog.CreateNew();
+    packet->data.CopyArray(data, size);
+    packet->timestamp = timestamp;
+    packet->type = type;
+    packet->distanceFromDroppedFrame = 10000;
+}
+
+//embeds the wall clock time at which the frame was captured, see LatencyProbe.h
+void RTMPPublisher::AddLatencyProbe(List<BYTE> &paddedData, DWORD timestamp)
+{
+    if(bSentLatencyProbe && timestamp-lastLatencyProbeTimestamp < latencyProbeInterval)
+        return;
+
+    bSentLatencyProbe = true;
+    lastLatencyProbeTimestamp = timestamp;
+
+    //stream timestamps are offsets from the encoder's first frame, which is a QPC time
+    QWORD captureTime = App->firstFrameTimestamp + firstTimestamp + timestamp;
+    QWORD curTime = GetQPCTimeMS();
+
+    FILETIME fileTime;
+    GetSystemTimeAsFileTime(&fileTime);
+
+    QWORD unixTime = ((QWORD(fileTime.dwHighDateTime) << 32 | fileTime.dwLowDateTime) - 116444736000000000ULL) / 10000;
+    if(curTime > captureTime)
+        unixTime -= curTime-captureTime;
+
+    BYTE nal[LATENCY_PROBE_NAL_MAX];
+    UINT nalSize = WriteLatencyProbeNAL(nal, unixTime);
+
+    paddedData.InsertArray(RTMP_MAX_HEADER_SIZE+5, nal, nalSize);
+}
+
 void RTMPPublisher::BeginPublishingInternal()
 {
     RTMPPacket packet;
@@ -732,6 +939,13 @@ void RTMPPublisher::BeginPublishingInternal()
     packet.m_nTimeStamp = 0;
     packet.m_nInfoField2 = rtmp->m_stream_id;
     packet.m_hasAbsTimestamp = TRUE;
+
+    if(metaDataPacketBuffer.size() <= RTMP_MAX_HEADER_SIZE)
+    {
+        App->PostStopMessage();
+        return;
+    }
+
     packet.m_body = metaDataPacketBuffer.data() + RTMP_MAX_HEADER_SIZE;
 
     packet.m_nBodySize = metaDataPacketBuffer.size() - RTMP_MAX_HEADER_SIZE;
@@ -840,7 +1054,7 @@ DWORD WINAPI RTMPPublisher::CreateConnectionThread(RTMPPublisher *publisher)
     RTMP *rtmp = nullptr;
 
     String failReason;
-    String strBindIP;
+    UINT tcpBufferSize = 0;
 
     String strURL       = AppConfig->GetString(TEXT("Publish"), TEXT("URL"));
     String strPlayPath  = AppConfig->GetString(TEXT("Publish"), TEXT("PlayPath"));
@@ -848,8 +1062,6 @@ DWORD WINAPI RTMPPublisher::CreateConnectionThread(RTMPPublisher *publisher)
     strURL.KillSpaces();
     strPlayPath.KillSpaces();
 
-    LPSTR lpAnsiURL = NULL, lpAnsiPlaypath = NULL;
-
     //--------------------------------
     // unbelievably disgusting hack for elgato devices (should no longer be necessary)
 
@@ -976,101 +1188,38 @@ DWORD WINAPI RTMPPublisher::CreateConnectionThread(RTMPPublisher *publisher)
 
     //------------------------------------------------------
 
-    OSEnterMutex(publisher->hRTMPMutex);
-    publisher->rtmp = RTMP_Alloc();
+    publisher->SetConnectTarget(strURL, strPlayPath);
 
-    rtmp = publisher->rtmp;
-    RTMP_Init(rtmp);
+    publisher->strConnectURL = strURL;
+    publisher->strConnectPlayPath = strPlayPath;
 
     RTMP_LogSetCallback(librtmpErrorCallback);
 
-    OSLeaveMutex(publisher->hRTMPMutex);
-
     //RTMP_LogSetLevel(RTMP_LOGERROR);
 
-    lpAnsiURL = strURL.CreateUTF8String();
-    lpAnsiPlaypath = strPlayPath.CreateUTF8String();
-
-    if(!RTMP_SetupURL2(rtmp, lpAnsiURL, lpAnsiPlaypath))
-    {
-        failReason = Str("Connection.CouldNotParseURL");
+    rtmp = publisher->CreateRTMP(failReason);
+    if(!rtmp)
         goto end;
-    }
-
-    // A user name and password can be kept in the .ini file
-    // If there's some credentials there then they'll be used in the RTMP channel
-    char *rtmpUser = AppConfig->GetString(TEXT("Publish"), TEXT("Username")).CreateUTF8String();
-    char *rtmpPass = AppConfig->GetString(TEXT("Publish"), TEXT("Password")).CreateUTF8String();
 
-    if (rtmpUser)
-    {
-        rtmp->Link.pubUser.av_val = rtmpUser;
-        rtmp->Link.pubUser.av_len = (int)strlen(rtmpUser);
-    }
-
-    if (rtmpPass)
-    {
-        rtmp->Link.pubPasswd.av_val = rtmpPass;
-        rtmp->Link.pubPasswd.av_len = (int)strlen(rtmpPass);
-    }
-
-    RTMP_EnableWrite(rtmp); //set it to publish
-
-    rtmp->Link.swfUrl.av_len = rtmp->Link.tcUrl.av_len;
-    rtmp->Link.swfUrl.av_val = rtmp->Link.tcUrl.av_val;
-    /*rtmp->Link.pageUrl.av_len = rtmp->Link.tcUrl.av_len;
-    rtmp->Link.pageUrl.av_val = rtmp->Link.tcUrl.av_val;*/
-    rtmp->Link.flashVer.av_val = "FMLE/3.0 (compatible; FMSc/1.0)";
-    rtmp->Link.flashVer.av_len = (int)strlen(rtmp->Link.flashVer.av_val);
+    OSEnterMutex(publisher->hRTMPMutex);
+    publisher->rtmp = rtmp;
+    OSLeaveMutex(publisher->hRTMPMutex);
 
     //-----------------------------------------
 
-    UINT tcpBufferSize = AppConfig->GetInt(TEXT("Publish"), TEXT("TCPBufferSize"), 64*1024);
+    tcpBufferSize = AppConfig->GetInt(TEXT("Publish"), TEXT("TCPBufferSize"), 64*1024);
 
     if(tcpBufferSize < 8192)
         tcpBufferSize = 8192;
     else if(tcpBufferSize > 1024*1024)
         tcpBufferSize = 1024*1024;
 
-    rtmp->m_outChunkSize = 4096;//RTMP_DEFAULT_CHUNKSIZE;//
-    rtmp->m_bSendChunkSizeInfo = TRUE;
-
-    rtmp->m_bUseNagle = TRUE;
-
-    strBindIP = AppConfig->GetString(TEXT("Publish"), TEXT("BindToIP"), TEXT("Default"));
-    if (scmp(strBindIP, TEXT("Default")))
-    {
-        Log(TEXT("  Binding to non-default IP %s"), strBindIP.Array());
-        rtmp->m_bindIP.addr.sin_family = AF_INET;
-        rtmp->m_bindIP.addrLen = sizeof(rtmp->m_bindIP.addr);
-        if (WSAStringToAddress(strBindIP.Array(), AF_INET, NULL, (LPSOCKADDR)&rtmp->m_bindIP.addr, &rtmp->m_bindIP.addrLen) == SOCKET_ERROR)
-        {
-            // no localization since this should rarely/never happen
-            failReason = TEXT("WSAStringToAddress: Could not parse address");
-            goto end;
-        }
-    }
-
     LogInterfaceType(rtmp);
 
     //-----------------------------------------
 
-    DWORD startTime = OSGetTime();
-
-    if(!RTMP_Connect(rtmp, NULL))
-    {
-        failReason = Str("Connection.CouldNotConnect");
-        failReason << TEXT("\r\n\r\n") << RTMPPublisher::GetRTMPErrors();
-        bCanRetry = true;
-        goto end;
-    }
-
-    Log(TEXT("Completed handshake with %s in %u ms."), strURL.Array(), OSGetTime() - startTime);
-
-    if(!RTMP_ConnectStream(rtmp, 0))
+    if(!publisher->ConnectRTMP(rtmp, true, failReason))
     {
-        failReason = Str("Connection.InvalidStream");
-        failReason << TEXT("\r\n\r\n") << RTMPPublisher::GetRTMPErrors();
         bCanRetry = true;
         goto end;
     }
@@ -1087,19 +1236,12 @@ DWORD WINAPI RTMPPublisher::CreateConnectionThread(RTMPPublisher *publisher)
 
 end:
 
-    if (lpAnsiURL)
-        Free(lpAnsiURL);
-
-    if (lpAnsiPlaypath)
-        Free(lpAnsiPlaypath);
-
     if(!bSuccess)
     {
         OSEnterMutex(publisher->hRTMPMutex);
         if(rtmp)
         {
-            RTMP_Close(rtmp);
-            RTMP_Free(rtmp);
+            FreeRTMP(rtmp);
             publisher->rtmp = NULL;
         }
         OSLeaveMutex(publisher->hRTMPMutex);
@@ -1119,11 +1261,178 @@ end:
         publisher->Init(tcpBufferSize);
         publisher->bConnected = true;
         publisher->bConnecting = false;
+
+        if(publisher->bFastReconnect && publisher->bUseStandby)
+            publisher->hStandbyThread = OSCreateThread((XTHREAD)RTMPPublisher::StandbyThread, publisher);
     }
 
     return 0;
 }
 
+RTMP *RTMPPublisher::CreateRTMP(String &failReason)
+{
+    RTMP *newRTMP = RTMP_Alloc();
+    RTMP_Init(newRTMP);
+
+    //librtmp points into the URL string rather than copying it, so it's kept for the lifetime of the
+    //publisher where reconnects can reuse it
+    bool bFirstSetup = (lpAnsiURL == NULL);
+    if (bFirstSetup)
+    {
+        lpAnsiURL = strConnectURL.CreateUTF8String();
+        lpAnsiPlaypath = strConnectPlayPath.CreateUTF8String();
+    }
+
+    if(!RTMP_SetupURL2(newRTMP, lpAnsiURL, lpAnsiPlaypath))
+    {
+        failReason = Str("Connection.CouldNotParseURL");
+        RTMP_Free(newRTMP);
+        return NULL;
+    }
+
+    // A user name and password can be kept in the .ini file
+    // If there's some credentials there then they'll be used in the RTMP channel
+    char *rtmpUser = AppConfig->GetString(TEXT("Publish"), TEXT("Username")).CreateUTF8String();
+    char *rtmpPass = AppConfig->GetString(TEXT("Publish"), TEXT("Password")).CreateUTF8String();
+
+    if (rtmpUser)
+    {
+        newRTMP->Link.pubUser.av_val = rtmpUser;
+        newRTMP->Link.pubUser.av_len = (int)strlen(rtmpUser);
+    }
+
+    if (rtmpPass)
+    {
+        newRTMP->Link.pubPasswd.av_val = rtmpPass;
+        newRTMP->Link.pubPasswd.av_len = (int)strlen(rtmpPass);
+    }
+
+    RTMP_EnableWrite(newRTMP); //set it to publish
+
+    newRTMP->Link.swfUrl.av_len = newRTMP->Link.tcUrl.av_len;
+    newRTMP->Link.swfUrl.av_val = newRTMP->Link.tcUrl.av_val;
+    /*newRTMP->Link.pageUrl.av_len = newRTMP->Link.tcUrl.av_len;
+    newRTMP->Link.pageUrl.av_val = newRTMP->Link.tcUrl.av_val;*/
+    newRTMP->Link.flashVer.av_val = "FMLE/3.0 (compatible; FMSc/1.0)";
+    newRTMP->Link.flashVer.av_len = (int)strlen(newRTMP->Link.flashVer.av_val);
+
+    newRTMP->m_outChunkSize = 4096;//RTMP_DEFAULT_CHUNKSIZE;//
+    newRTMP->m_bSendChunkSizeInfo = TRUE;
+
+    newRTMP->m_bUseNagle = TRUE;
+
+    String strBindIP = AppConfig->GetString(TEXT("Publish"), TEXT("BindToIP"), TEXT("Default"));
+    if (scmp(strBindIP, TEXT("Default")))
+    {
+        if (bFirstSetup)
+            Log(TEXT("  Binding to non-default IP %s"), strBindIP.Array());
+        newRTMP->m_bindIP.addr.sin_family = AF_INET;
+        newRTMP->m_bindIP.addrLen = sizeof(newRTMP->m_bindIP.addr);
+        if (WSAStringToAddress(strBindIP.Array(), AF_INET, NULL, (LPSOCKADDR)&newRTMP->m_bindIP.addr, &newRTMP->m_bindIP.addrLen) == SOCKET_ERROR)
+        {
+            // no localization since this should rarely/never happen
+            failReason = TEXT("WSAStringToAddress: Could not parse address");
+            FreeRTMP(newRTMP);
+            return NULL;
+        }
+    }
+
+    return newRTMP;
+}
+
+bool RTMPPublisher::ConnectRTMP(RTMP *newRTMP, bool bPublish, String &failReason)
+{
+    DWORD startTime = OSGetTime();
+
+    //the reconnect and standby threads both connect, so the cached address is only touched under the data mutex
+    sockaddr_in address;
+    OSEnterMutex(hDataMutex);
+    bool bUseResolvedAddress = bHaveResolvedAddress && !newRTMP->Link.socksport;
+    if (bUseResolvedAddress)
+        mcpy(&address, &resolvedAddress, sizeof(address));
+    OSLeaveMutex(hDataMutex);
+
+    //reconnects skip DNS and go straight to the address the last successful connection used
+    if (bUseResolvedAddress)
+    {
+        if (!RTMP_Connect0(newRTMP, (struct sockaddr *)&address))
+        {
+            //the ingest may have moved, resolve from scratch next time
+            OSEnterMutex(hDataMutex);
+            bHaveResolvedAddress = false;
+            OSLeaveMutex(hDataMutex);
+
+            failReason = Str("Connection.CouldNotConnect");
+            failReason << TEXT("\r\n\r\n") << RTMPPublisher::GetRTMPErrors();
+            return false;
+        }
+
+        newRTMP->m_bSendCounter = TRUE;
+
+        if (!RTMP_Connect1(newRTMP, NULL))
+        {
+            failReason = Str("Connection.CouldNotConnect");
+            failReason << TEXT("\r\n\r\n") << RTMPPublisher::GetRTMPErrors();
+            return false;
+        }
+    }
+    else
+    {
+        if(!RTMP_Connect(newRTMP, NULL))
+        {
+            failReason = Str("Connection.CouldNotConnect");
+            failReason << TEXT("\r\n\r\n") << RTMPPublisher::GetRTMPErrors();
+            return false;
+        }
+
+        if (bFastReconnect && !newRTMP->Link.socksport)
+        {
+            int addrLen = sizeof(address);
+            bool bResolved = getpeername(newRTMP->m_sb.sb_socket, (struct sockaddr *)&address, &addrLen) == 0;
+
+            OSEnterMutex(hDataMutex);
+            if (bResolved)
+                mcpy(&resolvedAddress, &address, sizeof(address));
+            bHaveResolvedAddress = bResolved;
+            OSLeaveMutex(hDataMutex);
+        }
+    }
+
+    Log(TEXT("Completed handshake with %s in %u ms."), strConnectURL.Array(), OSGetTime() - startTime);
+
+    if (newRTMP->m_sb.sb_ssl)
+    {
+        Log(TEXT("TLS session %s."), TLS_SSPI_IsResumed((TLSSession *)newRTMP->m_sb.sb_ssl) ? TEXT("resumed") : TEXT("negotiated with a full handshake"));
+
+        //records are written whole, so a stalled socket is waited on inside the send.  bound it the same
+        //way as the rest of the socket loop so the connection is dropped (and reconnected) instead
+        TLS_SSPI_SetTimeout((TLSSession *)newRTMP->m_sb.sb_ssl, sendTimeout, hSocketAbort);
+    }
+
+    if(bPublish && !RTMP_ConnectStream(newRTMP, 0))
+    {
+        failReason = Str("Connection.InvalidStream");
+        failReason << TEXT("\r\n\r\n") << RTMPPublisher::GetRTMPErrors();
+        return false;
+    }
+
+    return true;
+}
+
+void RTMPPublisher::FreeRTMP(RTMP *oldRTMP)
+{
+    if (oldRTMP->Link.pubUser.av_val)
+        Free(oldRTMP->Link.pubUser.av_val);
+    if (oldRTMP->Link.pubPasswd.av_val)
+        Free(oldRTMP->Link.pubPasswd.av_val);
+
+    oldRTMP->Link.pubUser.av_val = NULL;
+    oldRTMP->Link.pubPasswd.av_val = NULL;
+
+    RTMP_Close(oldRTMP);
+    RTMP_Free(oldRTMP);
+}
+
 double RTMPPublisher::GetPacketStrain() const
 {
     return (curDataBufferLen / (double)dataBufferSize) * 100.0;
@@ -1156,13 +1465,24 @@ int RTMPPublisher::FlushDataBuffer()
     ioctlsocket(rtmp->m_sb.sb_socket, FIONBIO, &zero);
 
     OSEnterMutex(hDataBufferMutex);
-    int ret = send(rtmp->m_sb.sb_socket, (const char *)dataBuffer, curDataBufferLen, 0);
+    int ret = SendDataBuffer(curDataBufferLen);
     curDataBufferLen = 0;
     OSLeaveMutex(hDataBufferMutex);
 
     return ret;
 }
 
+//must be called with hDataBufferMutex held
+int RTMPPublisher::SendDataBuffer(int len)
+{
+    //rtmps: records are encrypted straight out of dataBuffer and either go out whole or the connection is dead,
+    //so the caller's partial write handling never sees a split record
+    if (rtmp->m_sb.sb_ssl)
+        return TLS_SSPI_WriteInPlace((TLSSession *)rtmp->m_sb.sb_ssl, (char *)dataBuffer, len);
+
+    return send(rtmp->m_sb.sb_socket, (const char *)dataBuffer, len, 0);
+}
+
 void RTMPPublisher::SetupSendBacklogEvent()
 {
     zero (&sendBacklogOverlapped, sizeof(sendBacklogOverlapped));
@@ -1183,15 +1503,285 @@ void RTMPPublisher::FatalSocketShutdown()
     //anything buffered is invalid now
     curDataBufferLen = 0;
 
+    //wake up a send that's waiting on buffer space so it sees the disconnect
+    SetEvent(hBufferSpaceAvailableEvent);
+
     if (!bStopping)
     {
-        if (AppConfig->GetInt(TEXT("Publish"), TEXT("ExperimentalReconnectMode")) == 1 && AppConfig->GetInt(TEXT("Publish"), TEXT("Delay")) == 0)
-            App->NetworkFailed();
+        if (bFastReconnect)
+            BeginReconnect();
         else
-            App->PostStopMessage();
+            ReportConnectionLost();
     }
 }
 
+void RTMPPublisher::ReportConnectionLost()
+{
+    if (AppConfig->GetInt(TEXT("Publish"), TEXT("ExperimentalReconnectMode")) == 1 && AppConfig->GetInt(TEXT("Publish"), TEXT("Delay")) == 0)
+        App->NetworkFailed();
+    else
+        App->PostStopMessage();
+}
+
+void RTMPPublisher::BeginReconnect()
+{
+    OSEnterMutex(hDataMutex);
+
+    bConnected = false;
+    bReconnecting = true;
+    bReconnectBacklogValid = false;
+    reconnectStartTime = GetQPCTimeMS();
+
+    //nothing queued can be delivered any more, the backlog takes over from the next keyframe
+    for(UINT i=0; i<queuedPackets.Num(); i++)
+        queuedPackets[i].data.Clear();
+    queuedPackets.Clear();
+    currentBufferSize = 0;
+
+    OSLeaveMutex(hDataMutex);
+
+    Log(TEXT("RTMPPublisher::BeginReconnect: Connection lost, reconnecting in the background"));
+
+    RequestKeyframe(0);
+
+    //a previous reconnect thread is only ever finishing up in ResumeConnection by the time the new connection
+    //drops again.  never run two at once, if it doesn't wind down in time give up on reconnecting.
+    if (hReconnectThread)
+    {
+        if (WaitForSingleObject(hReconnectThread, 5000) == WAIT_TIMEOUT)
+        {
+            Log(TEXT("RTMPPublisher::BeginReconnect: Previous reconnect is still running, giving up"));
+
+            OSEnterMutex(hDataMutex);
+            bReconnecting = false;
+            OSLeaveMutex(hDataMutex);
+
+            ReportConnectionLost();
+            return;
+        }
+
+        OSCloseThread(hReconnectThread);
+        hReconnectThread = NULL;
+    }
+
+    hReconnectThread = OSCreateThread((XTHREAD)RTMPPublisher::ReconnectThread, this);
+}
+
+DWORD WINAPI RTMPPublisher::ReconnectThread(RTMPPublisher *publisher)
+{
+    DWORD retryDelay = 250;
+
+    for (UINT attempt=1; attempt<=publisher->reconnectMaxAttempts && !publisher->bStopping; attempt++)
+    {
+        String failReason;
+        RTMP *newRTMP = NULL;
+
+        //a warm standby connection already has the TCP and RTMP handshakes done, it only needs to publish
+        if (publisher->bUseStandby)
+        {
+            OSEnterMutex(publisher->hStandbyMutex);
+            newRTMP = publisher->standbyRTMP;
+            publisher->standbyRTMP = NULL;
+            OSLeaveMutex(publisher->hStandbyMutex);
+        }
+
+        if (newRTMP)
+        {
+            OSEnterMutex(publisher->hRTMPMutex);
+            publisher->reconnectRTMP = newRTMP;
+            OSLeaveMutex(publisher->hRTMPMutex);
+
+            if (!RTMP_ConnectStream(newRTMP, 0))
+            {
+                Log(TEXT("RTMPPublisher::ReconnectThread: Standby connection could not publish"));
+
+                OSEnterMutex(publisher->hRTMPMutex);
+                publisher->reconnectRTMP = NULL;
+                OSLeaveMutex(publisher->hRTMPMutex);
+
+                FreeRTMP(newRTMP);
+                newRTMP = NULL;
+            }
+        }
+
+        if (!newRTMP && !publisher->bStopping)
+        {
+            newRTMP = publisher->CreateRTMP(failReason);
+            if (newRTMP)
+            {
+                OSEnterMutex(publisher->hRTMPMutex);
+                publisher->reconnectRTMP = newRTMP;
+                OSLeaveMutex(publisher->hRTMPMutex);
+
+                if (!publisher->ConnectRTMP(newRTMP, true, failReason))
+                {
+                    OSEnterMutex(publisher->hRTMPMutex);
+                    publisher->reconnectRTMP = NULL;
+                    OSLeaveMutex(publisher->hRTMPMutex);
+
+                    FreeRTMP(newRTMP);
+                    newRTMP = NULL;
+                }
+            }
+        }
+
+        if (newRTMP)
+        {
+            if (publisher->bStopping)
+            {
+                OSEnterMutex(publisher->hRTMPMutex);
+                publisher->reconnectRTMP = NULL;
+                OSLeaveMutex(publisher->hRTMPMutex);
+
+                FreeRTMP(newRTMP);
+                break;
+            }
+
+            publisher->ResumeConnection(newRTMP);
+
+            Log(TEXT("RTMPPublisher::ReconnectThread: Reconnected on attempt %u, %llu ms after the connection was lost"),
+                attempt, GetQPCTimeMS() - publisher->reconnectStartTime);
+            return 0;
+        }
+
+        Log(TEXT("RTMPPublisher::ReconnectThread: Attempt %u failed: %s"), attempt, failReason.Array());
+
+        if (WaitForSingleObject(publisher->hReconnectExit, retryDelay) != WAIT_TIMEOUT)
+            break;
+
+        retryDelay = min(retryDelay*2, 4000);
+    }
+
+    OSEnterMutex(publisher->hDataMutex);
+    publisher->bReconnecting = false;
+    for(UINT i=0; i<publisher->reconnectBacklog.Num(); i++)
+        publisher->reconnectBacklog[i].data.Clear();
+    publisher->reconnectBacklog.Clear();
+    OSLeaveMutex(publisher->hDataMutex);
+
+    if (!publisher->bStopping)
+    {
+        Log(TEXT("RTMPPublisher::ReconnectThread: Giving up after %u attempts"), publisher->reconnectMaxAttempts);
+        publisher->ReportConnectionLost();
+    }
+
+    return 0;
+}
+
+bool RTMPPublisher::ResumeConnection(RTMP *newRTMP)
+{
+    //the old socket loop has already exited, it's the one that called FatalSocketShutdown
+    if (hSocketThread)
+    {
+        WaitForSingleObject(hSocketThread, INFINITE);
+        OSCloseThread(hSocketThread);
+        hSocketThread = NULL;
+    }
+
+    newRTMP->m_customSendFunc = (CUSTOMSEND)RTMPPublisher::BufferedSend;
+    newRTMP->m_customSendParam = this;
+    newRTMP->m_bCustomSend = TRUE;
+
+    //the send loop holds hRTMPMutex while it's writing, so the old connection is free once we have it
+    OSEnterMutex(hRTMPMutex);
+    RTMP *oldRTMP = rtmp;
+    rtmp = newRTMP;
+    reconnectRTMP = NULL;
+    connectionID++;
+    OSLeaveMutex(hRTMPMutex);
+
+    FreeRTMP(oldRTMP);
+
+    OSEnterMutex(hDataBufferMutex);
+    curDataBufferLen = 0;
+    OSLeaveMutex(hDataBufferMutex);
+
+    ApplySocketOptions();
+
+    ResetEvent(hSocketLoopExit);
+    ResetEvent(hSendBacklogEvent);
+
+    hSocketThread = OSCreateThread((XTHREAD)RTMPPublisher::SocketThread, this);
+    if(!hSocketThread)
+        CrashError(TEXT("RTMPPublisher: Could not create send thread"));
+
+    //----------------------------------------------
+
+    OSEnterMutex(hDataMutex);
+
+    //metadata and codec headers have to go out again on the new stream, followed by the backlog
+    //which starts on a keyframe.  timestamps carry on from where the old connection left off.
+    bStreamStarted = false;
+    bSentFirstKeyframe = false;
+    packetWaitType = 0;
+    bConnected = true;
+    bReconnecting = false;
+    bReconnectFirstSend = true;
+    numReconnects++;
+
+    List<NetworkPacket> backlog;
+    backlog.TransferFrom(reconnectBacklog);
+
+    for(UINT i=0; i<backlog.Num(); i++)
+    {
+        NetworkPacket &packet = backlog[i];
+        SendPacketForReal(packet.data.Array(), packet.data.Num(), packet.timestamp, packet.type);
+        packet.data.Clear();
+    }
+
+    OSLeaveMutex(hDataMutex);
+
+    if (!backlog.Num())
+        RequestKeyframe(0);
+
+    return true;
+}
+
+DWORD WINAPI RTMPPublisher::StandbyThread(RTMPPublisher *publisher)
+{
+    //servers close connections that sit idle without publishing, so the spare is refreshed periodically
+    const DWORD standbyRefreshTime = 20000;
+
+    do
+    {
+        if (publisher->bReconnecting)
+            continue;
+
+        String failReason;
+        RTMP *newRTMP = publisher->CreateRTMP(failReason);
+        if (newRTMP)
+        {
+            OSEnterMutex(publisher->hRTMPMutex);
+            publisher->standbyConnectingRTMP = newRTMP;
+            OSLeaveMutex(publisher->hRTMPMutex);
+
+            bool bStandbyReady = publisher->ConnectRTMP(newRTMP, false, failReason);
+
+            OSEnterMutex(publisher->hRTMPMutex);
+            publisher->standbyConnectingRTMP = NULL;
+            OSLeaveMutex(publisher->hRTMPMutex);
+
+            if (!bStandbyReady)
+            {
+                Log(TEXT("RTMPPublisher::StandbyThread: Could not prepare standby connection: %s"), failReason.Array());
+                FreeRTMP(newRTMP);
+                newRTMP = NULL;
+            }
+        }
+
+        OSEnterMutex(publisher->hStandbyMutex);
+        RTMP *oldRTMP = publisher->standbyRTMP;
+        publisher->standbyRTMP = newRTMP;
+        OSLeaveMutex(publisher->hStandbyMutex);
+
+        if (oldRTMP)
+            FreeRTMP(oldRTMP);
+
+    } while (WaitForSingleObject(publisher->hReconnectExit, standbyRefreshTime) == WAIT_TIMEOUT);
+
+    return 0;
+}
+
 void RTMPPublisher::SocketLoop()
 {
     bool canWrite = false;
@@ -1373,15 +1963,17 @@ void RTMPPublisher::SocketLoop()
                 }
                 
                 int ret;
+                traceIn("SendDataBuffer");
                 if (lowLatencyMode != LL_MODE_NONE)
                 {
                     int sendLength = min (latencyPacketSize, curDataBufferLen);
-                    ret = send(rtmp->m_sb.sb_socket, (const char *)dataBuffer, sendLength, 0);
+                    ret = SendDataBuffer(sendLength);
                 }
                 else
                 {
-                    ret = send(rtmp->m_sb.sb_socket, (const char *)dataBuffer, curDataBufferLen, 0);
+                    ret = SendDataBuffer(curDataBufferLen);
                 }
+                traceOut;
 
                 if (ret > 0)
                 {
@@ -1390,13 +1982,17 @@ void RTMPPublisher::SocketLoop()
                     curDataBufferLen -= ret;
 
                     bytesSent += ret;
+                    MetricIncrement(bytesSentMetric, ret);
 
                     if (lastSendTime)
                     {
                         DWORD diff = OSGetTime() - lastSendTime;
 
                         if (diff >= 1500)
+                        {
                             Log(TEXT("RTMPPublisher::SocketLoop: Stalled for %u ms to write %d bytes (buffer: %d / %d), unstable connection?"), diff, ret, curDataBufferLen, dataBufferSize);
+                            TriggerTimelineDump(TEXT("Socket write stalled"));
+                        }
 
                         totalSendPeriod += diff;
                         totalSendBytes += ret;
@@ -1473,6 +2069,7 @@ void RTMPPublisher::SendLoop()
             List<BYTE> packetData;
             PacketType type       = queuedPackets[0].type;
             DWORD      timestamp  = queuedPackets[0].timestamp;
+            UINT       packetConnectionID = connectionID;
             packetData.TransferFrom(queuedPackets[0].data);
 
             currentBufferSize -= packetData.Num();
@@ -1481,8 +2078,19 @@ void RTMPPublisher::SendLoop()
 
             OSLeaveMutex(hDataMutex);
 
+            OSEnterMutex(hRTMPMutex);
+
+            //the connection was replaced after this packet was dequeued, it belongs to the old stream
+            if (packetConnectionID != connectionID)
+            {
+                OSLeaveMutex(hRTMPMutex);
+                continue;
+            }
+
             //--------------------------------------------
 
+            traceSegment("send packet");
+
             RTMPPacket packet;
             packet.m_nChannel = (type == PacketType_Audio) ? 0x5 : 0x4;
             packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
@@ -1499,12 +2107,20 @@ void RTMPPublisher::SendLoop()
             {
                 //should never reach here with the new shutdown sequence.
                 RUNONCE Log(TEXT("RTMP_SendPacket failure, should not happen!"));
-                if(!RTMP_IsConnected(rtmp))
+                if(!RTMP_IsConnected(rtmp) && !bFastReconnect)
                 {
+                    OSLeaveMutex(hRTMPMutex);
                     App->PostStopMessage();
                     break;
                 }
             }
+            else if(bReconnectFirstSend && type != PacketType_Audio)
+            {
+                bReconnectFirstSend = false;
+                Log(TEXT("RTMPPublisher::SendLoop: First frame after reconnect sent %llu ms after the connection was lost"), GetQPCTimeMS() - reconnectStartTime);
+            }
+
+            OSLeaveMutex(hRTMPMutex);
 
             //----------------------------------------------------------
 
@@ -1535,12 +2151,14 @@ void RTMPPublisher::SendLoop()
 
 DWORD RTMPPublisher::SendThread(RTMPPublisher *publisher)
 {
+    SetTimelineThreadName(TEXT("RTMP send"));
     publisher->SendLoop();
     return 0;
 }
 
 DWORD RTMPPublisher::SocketThread(RTMPPublisher *publisher)
 {
+    SetTimelineThreadName(TEXT("RTMP socket"));
     publisher->SocketLoop();
     return 0;
 }
@@ -1552,10 +2170,7 @@ void RTMPPublisher::DropFrame(UINT id)
     PacketType type = dropPacket.type;
     dropPacket.data.Clear();
 
-    if(dropPacket.type < PacketType_VideoHigh)
-        numBFramesDumped++;
-    else
-        numPFramesDumped++;
+    CountDroppedFrame(type);
 
     for(UINT i=id+1; i<queuedPackets.Num(); i++)
     {
@@ -1587,12 +2202,10 @@ void RTMPPublisher::DropFrame(UINT id)
                 {
                     currentBufferSize -= packet.data.Num();
                     packet.data.Clear();
+                    PacketType droppedType = packet.type;
                     queuedPackets.Remove(i--);
 
-                    if(packet.type < PacketType_VideoHigh)
-                        numBFramesDumped++;
-                    else
-                        numPFramesDumped++;
+                    CountDroppedFrame(droppedType);
                 }
                 else
                 {
@@ -47,6 +47,7 @@ typedef enum
 class RTMPPublisher : public NetworkStream
 {
     friend class DelayedPublisher;
+    friend class BandwidthProbe;
 
     /*List<PacketTimeSize> packetSizeRecord;
     DWORD outputRateSize;*/
@@ -117,6 +118,8 @@ protected:
 
     HANDLE hSendLoopExit;
     HANDLE hSocketLoopExit;
+    HANDLE hSocketAbort;            //gives up on a send that's still blocked after the flush on shutdown
+    DWORD sendTimeout;              //longest a TLS record may wait for the socket before the connection is dropped
 
     HANDLE hSendBacklogEvent;
     OVERLAPPED sendBacklogOverlapped;
@@ -132,6 +135,12 @@ protected:
     UINT numPFramesDumped;
     UINT numBFramesDumped;
 
+    Metric *droppedBFramesMetric, *droppedPFramesMetric, *bytesSentMetric;
+    Metric *queuedBytesMetric, *socketBufferMetric;
+
+    void CountDroppedFrame(PacketType type);
+    static void STDCALL CollectMetrics(RTMPPublisher *publisher);
+
     BYTE *dataBuffer;
     int dataBufferSize;
 
@@ -148,9 +157,61 @@ protected:
 
     bool bFastInitialKeyframe;
 
+    //-----------------------------------------------
+    // fast reconnect stuff
+
+    bool bFastReconnect, bReconnecting;
+    bool bReconnectBacklogValid;
+    bool bReconnectFirstSend;
+    DWORD reconnectBacklogTime;
+    UINT reconnectMaxAttempts;
+    UINT numReconnects;
+    UINT tcpBufferSize;
+    QWORD reconnectStartTime;
+    UINT connectionID;
+    List<NetworkPacket> reconnectBacklog;
+    RTMP *reconnectRTMP;
+    HANDLE hReconnectThread;
+    HANDLE hReconnectExit;
+
+    String strConnectURL, strConnectPlayPath;
+    LPSTR lpAnsiURL, lpAnsiPlaypath;
+    sockaddr_in resolvedAddress;
+    bool bHaveResolvedAddress;
+
+    //a connected and handshaked (but not yet publishing) spare connection
+    bool bUseStandby;
+    RTMP *standbyRTMP;
+    RTMP *standbyConnectingRTMP;
+    HANDLE hStandbyMutex;
+    HANDLE hStandbyThread;
+
+    RTMP *CreateRTMP(String &failReason);
+    bool ConnectRTMP(RTMP *newRTMP, bool bPublish, String &failReason);
+    static void FreeRTMP(RTMP *oldRTMP);
+    void ApplySocketOptions();
+
+    void BeginReconnect();
+    void ReportConnectionLost();
+    bool ResumeConnection(RTMP *newRTMP);
+    void AddReconnectBacklogPacket(BYTE *data, UINT size, DWORD timestamp, PacketType type);
+    static DWORD WINAPI ReconnectThread(RTMPPublisher *publisher);
+    static DWORD WINAPI StandbyThread(RTMPPublisher *publisher);
+
+    //-----------------------------------------------
+    // latency probe stuff
+
+    bool bLatencyProbe;
+    DWORD latencyProbeInterval;
+    DWORD lastLatencyProbeTimestamp;
+    bool bSentLatencyProbe;
+
+    void AddLatencyProbe(List<BYTE> &paddedData, DWORD timestamp);
+
     void SendLoop();
     void SocketLoop();
     int FlushDataBuffer();
+    int SendDataBuffer(int len);
     void SetupSendBacklogEvent();
     void FatalSocketShutdown();
     static DWORD SendThread(RTMPPublisher *publisher);
@@ -164,6 +225,9 @@ protected:
 
     virtual void RequestKeyframe(int waitTime);
 
+    //lets a subclass connect somewhere other than the configured service
+    virtual void SetConnectTarget(String &strURL, String &strPlayPath) {}
+
 public:
     RTMPPublisher();
     bool Init(UINT tcpBufferSize);
@@ -216,6 +216,52 @@ int SendPlayStop(RTMP *r)
 }
 
 char* OBS::EncMetaData(char *enc, char *pend, bool bFLVFile)
+{
+    MetaDataCache &cache = metaDataCache[bFLVFile ? 1 : 0];
+
+    int    maxBitRate    = GetVideoEncoder()->GetBitRate();
+    int    fps           = GetFPS();
+    int    audioBitRate  = GetAudioEncoder()->GetBitRate();
+    bool   bAAC          = scmpi(GetAudioEncoder()->GetCodec(), TEXT("AAC")) == 0;
+
+    OSEnterMutex(hMetaDataMutex);
+
+    if(!cache.data.Num() || cache.maxBitRate != maxBitRate || cache.fps != fps || cache.audioBitRate != audioBitRate ||
+       cache.width != outputCX || cache.height != outputCY || cache.sampleRate != GetSampleRateHz() ||
+       cache.channels != NumAudioChannels() || cache.bAAC != bAAC)
+    {
+        char buffer[2048];
+        char *end = EncodeMetaData(buffer, buffer+sizeof(buffer), bFLVFile);
+        if(!end)
+        {
+            cache.data.Clear();
+            OSLeaveMutex(hMetaDataMutex);
+            return NULL;
+        }
+
+        cache.data.CopyArray(buffer, UINT(end-buffer));
+        cache.maxBitRate    = maxBitRate;
+        cache.fps           = fps;
+        cache.audioBitRate  = audioBitRate;
+        cache.width         = outputCX;
+        cache.height        = outputCY;
+        cache.sampleRate    = GetSampleRateHz();
+        cache.channels      = NumAudioChannels();
+        cache.bAAC          = bAAC;
+    }
+
+    char *end = NULL;
+    if(enc && UINT(pend-enc) >= cache.data.Num())
+    {
+        mcpy(enc, cache.data.Array(), cache.data.Num());
+        end = enc+cache.data.Num();
+    }
+
+    OSLeaveMutex(hMetaDataMutex);
+    return end;
+}
+
+char* OBS::EncodeMetaData(char *enc, char *pend, bool bFLVFile)
 {
     int    maxBitRate    = GetVideoEncoder()->GetBitRate();
     int    fps           = GetFPS();
@@ -242,39 +288,54 @@ char* OBS::EncMetaData(char *enc, char *pend, bool bFLVFile)
     {
         *enc++ = AMF_ECMA_ARRAY;
         enc = AMF_EncodeInt32(enc, pend, 14);
+        if(!enc) return NULL;
     }
     else
         *enc++ = AMF_OBJECT;
 
     enc = AMF_EncodeNamedNumber(enc, pend, &av_duration,        0.0);
+    if(!enc) return NULL;
     enc = AMF_EncodeNamedNumber(enc, pend, &av_fileSize,        0.0);
+    if(!enc) return NULL;
     enc = AMF_EncodeNamedNumber(enc, pend, &av_width,           double(outputCX));
+    if(!enc) return NULL;
     enc = AMF_EncodeNamedNumber(enc, pend, &av_height,          double(outputCY));
+    if(!enc) return NULL;
 
     /*if(bFLVFile)
         enc = AMF_EncodeNamedNumber(enc, pend, &av_videocodecid,    7.0);//&av_avc1);//
     else*/
         enc = AMF_EncodeNamedString(enc, pend, &av_videocodecid,    &av_avc1);//7.0);//
+    if(!enc) return NULL;
 
     enc = AMF_EncodeNamedNumber(enc, pend, &av_videodatarate,   double(maxBitRate));
+    if(!enc) return NULL;
     enc = AMF_EncodeNamedNumber(enc, pend, &av_framerate,       double(fps));
+    if(!enc) return NULL;
 
     /*if(bFLVFile)
         enc = AMF_EncodeNamedNumber(enc, pend, &av_audiocodecid,    audioCodecID);//av_codecFourCC);//
     else*/
         enc = AMF_EncodeNamedString(enc, pend, &av_audiocodecid,    av_codecFourCC);//audioCodecID);//
+    if(!enc) return NULL;
 
     enc = AMF_EncodeNamedNumber(enc, pend, &av_audiodatarate,   double(audioBitRate)); //ex. 128kb\s
+    if(!enc) return NULL;
     enc = AMF_EncodeNamedNumber(enc, pend, &av_audiosamplerate, double(App->GetSampleRateHz()));
+    if(!enc) return NULL;
     enc = AMF_EncodeNamedNumber(enc, pend, &av_audiosamplesize, 16.0);
+    if(!enc) return NULL;
     enc = AMF_EncodeNamedNumber(enc, pend, &av_audiochannels,   double(App->NumAudioChannels()));
+    if(!enc) return NULL;
     //enc = AMF_EncodeNamedBoolean(enc, pend, &av_stereo,         true);
 
     if (App->NumAudioChannels() > 2 || App->NumAudioChannels() <1)
         CrashError(TEXT("bad audio channnel configuration"));
     enc = AMF_EncodeNamedBoolean(enc, pend, &av_stereo,     App->NumAudioChannels()==2);
+    if(!enc) return NULL;
 
     enc = AMF_EncodeNamedString(enc, pend, &av_encoder,         &av_OBSVersion);
+    if(!enc || enc+3 > pend) return NULL;
     *enc++ = 0;
     *enc++ = 0;
     *enc++ = AMF_OBJECT_END;
@@ -28,6 +28,7 @@
 #include <inttypes.h>
 #include "../librtmp/rtmp.h"
 #include "../librtmp/log.h"
+#include "../librtmp/tls_sspi.h"
 
 
 //just so you know, I'm fairly disgusted with all this stuff.
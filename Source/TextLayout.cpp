@@ -0,0 +1,271 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "TextLayout.h"
+
+#include <string.h>
+#include <algorithm>
+
+
+static inline uint32_t HashText(const wchar_t *lpText, unsigned int length)
+{
+    uint32_t hash = 2166136261U;
+    for(unsigned int i=0; i<length; i++)
+        hash = (hash ^ uint32_t(lpText[i])) * 16777619U;
+    return hash;
+}
+
+//non-premultiplied "over", same as gdi+ does it with SourceOver on a 32bppARGB bitmap
+static inline uint32_t BlendPixel(uint32_t src, uint32_t dst)
+{
+    uint32_t srcA = src >> 24;
+    if(srcA == 0)
+        return dst;
+    if(srcA == 255)
+        return src;
+
+    uint32_t dstA = dst >> 24;
+    uint32_t dstW = dstA*(255-srcA)/255;
+    uint32_t outA = srcA + dstW;
+
+    uint32_t out = outA << 24;
+    for(uint32_t shift=0; shift<24; shift += 8)
+    {
+        uint32_t srcC = (src >> shift) & 0xFF;
+        uint32_t dstC = (dst >> shift) & 0xFF;
+        out |= ((srcC*srcA + dstC*dstW)/outA) << shift;
+    }
+
+    return out;
+}
+
+//----------------------------------------------------------------------------
+
+void TextLayout::Clear()
+{
+    for(size_t i=0; i<paragraphs.size(); i++)
+        delete paragraphs[i];
+
+    paragraphs.clear();
+    lines.clear();
+    width = height = 0.0f;
+}
+
+TextParagraph* TextLayout::GetParagraph(TextRasterizer *rasterizer, const wchar_t *lpText, unsigned int length)
+{
+    uint32_t hash = HashText(lpText, length);
+
+    for(size_t i=0; i<paragraphs.size(); i++)
+    {
+        TextParagraph *paragraph = paragraphs[i];
+        if(paragraph->hash == hash && paragraph->strText.compare(0, std::wstring::npos, lpText, length) == 0)
+        {
+            paragraph->bUsed = true;
+            return paragraph;
+        }
+    }
+
+    TextParagraph *paragraph = new TextParagraph;
+    paragraph->strText.assign(lpText, length);
+    paragraph->hash = hash;
+    paragraph->bitmapCX = paragraph->bitmapCY = 0;
+    paragraph->bUsed = true;
+
+    rasterizer->MeasureParagraph(paragraph->strText.c_str(), maxWidth, paragraph->cx, paragraph->cy);
+
+    paragraphs.push_back(paragraph);
+    return paragraph;
+}
+
+void TextLayout::Layout(TextRasterizer *rasterizer, const wchar_t *lpText, float maxWidth, float scrollHeight)
+{
+    if(maxWidth != this->maxWidth)
+    {
+        Clear();
+        this->maxWidth = maxWidth;
+    }
+
+    for(size_t i=0; i<paragraphs.size(); i++)
+        paragraphs[i]->bUsed = false;
+
+    //------------------------------------
+
+    std::vector<TextParagraph*> textParagraphs;
+
+    const wchar_t *lpStart = lpText;
+    while(lpStart && *lpStart)
+    {
+        const wchar_t *lpEnd = lpStart;
+        while(*lpEnd && *lpEnd != '\n')
+            lpEnd++;
+
+        unsigned int length = (unsigned int)(lpEnd-lpStart);
+        if(length && lpStart[length-1] == '\r')
+            length--;
+
+        textParagraphs.push_back(GetParagraph(rasterizer, lpStart, length));
+
+        lpStart = *lpEnd ? lpEnd+1 : NULL;
+    }
+
+    //------------------------------------
+
+    size_t firstParagraph = 0;
+    if(scrollHeight > 0.0f)
+    {
+        float totalHeight = 0.0f;
+        for(size_t i=textParagraphs.size(); i>0; i--)
+        {
+            firstParagraph = i-1;
+            totalHeight += textParagraphs[i-1]->cy;
+            if(totalHeight > scrollHeight)
+                break;
+        }
+    }
+
+    lines.clear();
+    width = height = 0.0f;
+
+    for(size_t i=firstParagraph; i<textParagraphs.size(); i++)
+    {
+        TextLine line;
+        line.paragraph = textParagraphs[i];
+        line.y = height;
+        lines.push_back(line);
+
+        height += line.paragraph->cy;
+        if(line.paragraph->cx > width)
+            width = line.paragraph->cx;
+    }
+
+    //------------------------------------
+    // drop anything that isn't in the text any more
+
+    for(size_t i=0; i<paragraphs.size(); i++)
+    {
+        if(!paragraphs[i]->bUsed)
+        {
+            delete paragraphs[i];
+            paragraphs.erase(paragraphs.begin()+i--);
+        }
+    }
+}
+
+void TextLayout::Draw(TextRasterizer *rasterizer, uint8_t *lpBits, unsigned int cx, unsigned int cy, int x, int y, int clipBottom)
+{
+    int bottom = std::min(int(cy), clipBottom);
+
+    for(size_t i=0; i<lines.size(); i++)
+    {
+        TextParagraph *paragraph = lines[i].paragraph;
+        int lineY = y + int(lines[i].y);
+
+        if(paragraph->bits.empty())
+        {
+            unsigned int padding = rasterizer->GetPadding();
+            paragraph->bitmapCX = (unsigned int)(paragraph->cx + 1e-4f) + padding + 1;
+            paragraph->bitmapCY = (unsigned int)(paragraph->cy + 1e-4f) + padding + 1;
+
+            paragraph->bits.assign(paragraph->bitmapCX*paragraph->bitmapCY*4, 0);
+
+            rasterizer->DrawParagraph(paragraph->strText.c_str(), maxWidth, paragraph->bits.data(), paragraph->bitmapCX, paragraph->bitmapCY);
+        }
+
+        int startX = std::max(x, 0), endX = std::min(x+int(paragraph->bitmapCX), int(cx));
+        int startY = std::max(lineY, 0), endY = std::min(lineY+int(paragraph->bitmapCY), bottom);
+
+        for(int curY=startY; curY<endY; curY++)
+        {
+            const uint32_t *lpInput = (const uint32_t*)(paragraph->bits.data() + (curY-lineY)*paragraph->bitmapCX*4);
+            uint32_t *lpOutput = (uint32_t*)(lpBits + curY*cx*4);
+
+            for(int curX=startX; curX<endX; curX++)
+                lpOutput[curX] = BlendPixel(lpInput[curX-x], lpOutput[curX]);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+
+void FillImageRect(uint8_t *lpBits, unsigned int cx, unsigned int cy, int x, int y, int rectCX, int rectCY, uint32_t color)
+{
+    int startX = std::max(x, 0), endX = std::min(x+rectCX, int(cx));
+    int startY = std::max(y, 0), endY = std::min(y+rectCY, int(cy));
+
+    for(int curY=startY; curY<endY; curY++)
+    {
+        uint32_t *lpOutput = (uint32_t*)(lpBits + curY*cx*4);
+        for(int curX=startX; curX<endX; curX++)
+            lpOutput[curX] = color;
+    }
+}
+
+bool GetChangedRect(const uint8_t *lpOld, const uint8_t *lpNew, unsigned int cx, unsigned int cy,
+                    unsigned int &x, unsigned int &y, unsigned int &rectCX, unsigned int &rectCY)
+{
+    unsigned int pitch = cx*4;
+    unsigned int top, bottom;
+
+    for(top=0; top<cy; top++)
+    {
+        if(memcmp(lpOld+top*pitch, lpNew+top*pitch, pitch) != 0)
+            break;
+    }
+
+    if(top == cy)
+        return false;
+
+    for(bottom=cy; bottom>top+1; bottom--)
+    {
+        if(memcmp(lpOld+(bottom-1)*pitch, lpNew+(bottom-1)*pitch, pitch) != 0)
+            break;
+    }
+
+    //narrow it down horizontally too, text changes are often just a few characters
+    unsigned int left = cx, right = 0;
+    for(unsigned int curY=top; curY<bottom; curY++)
+    {
+        const uint32_t *lpOldRow = (const uint32_t*)(lpOld+curY*pitch);
+        const uint32_t *lpNewRow = (const uint32_t*)(lpNew+curY*pitch);
+
+        for(unsigned int curX=0; curX<left; curX++)
+        {
+            if(lpOldRow[curX] != lpNewRow[curX])
+            {
+                left = curX;
+                break;
+            }
+        }
+
+        for(unsigned int curX=cx; curX>right; curX--)
+        {
+            if(lpOldRow[curX-1] != lpNewRow[curX-1])
+            {
+                right = curX;
+                break;
+            }
+        }
+    }
+
+    x = left;
+    y = top;
+    rectCX = right-left;
+    rectCY = bottom-top;
+    return true;
+}
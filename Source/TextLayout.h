@@ -0,0 +1,100 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//-------------------------------------------
+// cached text layout.  text is drawn a paragraph at a time and the drawn paragraphs are kept, so when the
+// text changes (a ticker file being rewritten, lines scrolling by) only the paragraphs that actually
+// changed get drawn again.  the actual measuring and drawing goes through a TextRasterizer, so none of
+// this knows about gdi+ or the graphics system.  it doesn't include Main.h or OBSApi.h either, so it
+// can be built and tested on its own.  text is wide characters, the same as CTSTR.
+
+struct TextRasterizer
+{
+    virtual ~TextRasterizer() {}
+
+    //extra space around every paragraph bitmap for things like outlines
+    virtual unsigned int GetPadding()=0;
+
+    //size of a paragraph laid out no wider than maxWidth (0 for no limit).  empty paragraphs still need a height
+    virtual void MeasureParagraph(const wchar_t *lpText, float maxWidth, float &cx, float &cy)=0;
+
+    //draws a paragraph into a cleared (transparent) 32bit BGRA bitmap, offset by half the padding
+    virtual void DrawParagraph(const wchar_t *lpText, float maxWidth, uint8_t *lpBits, unsigned int bitmapCX, unsigned int bitmapCY)=0;
+};
+
+struct TextParagraph
+{
+    std::wstring strText;
+    uint32_t hash;
+    float cx, cy;
+
+    std::vector<uint8_t> bits; //drawn the first time it's needed
+    unsigned int bitmapCX, bitmapCY;
+
+    bool bUsed;
+};
+
+struct TextLine
+{
+    TextParagraph *paragraph;
+    float y;
+};
+
+class TextLayout
+{
+    std::vector<TextParagraph*> paragraphs;
+    std::vector<TextLine> lines;
+    float maxWidth;
+    float width, height;
+
+    TextParagraph* GetParagraph(TextRasterizer *rasterizer, const wchar_t *lpText, unsigned int length);
+
+public:
+    inline TextLayout() : maxWidth(0.0f), width(0.0f), height(0.0f) {}
+    inline ~TextLayout() {Clear();}
+
+    //throws away everything that's been drawn, for when the font or colors change
+    void Clear();
+
+    //splits the text up in to paragraphs and stacks them.  if scrollHeight isn't 0, only the last
+    //paragraphs up to and including the first one that doesn't fit in it any more are kept
+    void Layout(TextRasterizer *rasterizer, const wchar_t *lpText, float maxWidth, float scrollHeight=0.0f);
+
+    inline float Width() const  {return width;}
+    inline float Height() const {return height;}
+    inline unsigned int NumLines() const {return (unsigned int)lines.size();}
+    inline unsigned int NumCachedParagraphs() const {return (unsigned int)paragraphs.size();}
+
+    //blends the paragraphs over a 32bit BGRA image with the top left of the text at (x, y).
+    //nothing gets drawn below clipBottom
+    void Draw(TextRasterizer *rasterizer, uint8_t *lpBits, unsigned int cx, unsigned int cy, int x, int y, int clipBottom);
+};
+
+//fills a rectangle (clipped to the image) of a 32bit image with a color
+void FillImageRect(uint8_t *lpBits, unsigned int cx, unsigned int cy, int x, int y, int rectCX, int rectCY, uint32_t color);
+
+//finds the area that differs between two images of the same size, returns false if they're the same
+bool GetChangedRect(const uint8_t *lpOld, const uint8_t *lpNew, unsigned int cx, unsigned int cy,
+                    unsigned int &x, unsigned int &y, unsigned int &rectCX, unsigned int &rectCY);
@@ -18,6 +18,7 @@
 
 
 #include "Main.h"
+#include "TextLayout.h"
 
 #include <memory>
 
@@ -38,6 +39,7 @@ inline DWORD GetAlphaVal(UINT opacityLevel)
 class TextOutputSource : public ImageSource
 {
     bool        bUpdateTexture;
+    bool        bContentChanged; //since the last Render
 
     String      strCurrentText;
     Texture     *texture;
@@ -86,6 +88,82 @@ class TextOutputSource : public ImageSource
 
     XElement    *data;
 
+    //horizontal text is drawn through a cached layout, only changed paragraphs are drawn again and only
+    //the changed part of the image is uploaded.  vertical text still goes through gdi+ as a whole
+    TextLayout  layout;
+    String      strLayoutStyle;
+    LPBYTE      lpTextBits, lpNewTextBits;
+
+    //the image can be put together on a worker thread (PreprocessAsync), it's uploaded later in Preprocess
+    bool        bImageComposed, bImageResized, bImageChanged;
+    SIZE        composedSize;
+    UINT        changedX, changedY, changedCX, changedCY;
+
+    struct GDIPlusRasterizer : TextRasterizer
+    {
+        TextOutputSource *source;
+        Gdiplus::Graphics *graphics;
+        Gdiplus::Font *font;
+        Gdiplus::StringFormat *format;
+
+        UINT GetPadding()
+        {
+            return source->bUseOutline ? UINT(ceil(source->outlineSize)) : 0;
+        }
+
+        void MeasureParagraph(CTSTR lpText, float maxWidth, float &cx, float &cy)
+        {
+            Gdiplus::RectF box;
+
+            //an empty line still takes up a line
+            CTSTR lpMeasure = *lpText ? lpText : TEXT(" ");
+
+            if(maxWidth > 0.0f)
+                graphics->MeasureString(lpMeasure, -1, font, Gdiplus::RectF(0.0f, 0.0f, maxWidth, 32000.0f), format, &box);
+            else
+                graphics->MeasureString(lpMeasure, -1, font, Gdiplus::PointF(0.0f, 0.0f), format, &box);
+
+            //aligned text doesn't start at 0, the paragraph has to cover everything up to it
+            cx = *lpText ? box.X+box.Width : 0.0f;
+            cy = box.Y+box.Height;
+        }
+
+        void DrawParagraph(CTSTR lpText, float maxWidth, LPBYTE lpBits, UINT bitmapCX, UINT bitmapCY)
+        {
+            if(!*lpText)
+                return;
+
+            Gdiplus::Bitmap bmp(bitmapCX, bitmapCY, 4*bitmapCX, PixelFormat32bppARGB, lpBits);
+            Gdiplus::Graphics bmpGraphics(&bmp);
+
+            bmpGraphics.SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
+            bmpGraphics.SetCompositingMode(Gdiplus::CompositingModeSourceOver);
+            bmpGraphics.SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
+
+            Gdiplus::SolidBrush brush(Gdiplus::Color(GetAlphaVal(source->opacity)|(source->color&0x00FFFFFF)));
+
+            float offset = source->bUseOutline ? source->outlineSize/2 : 0.0f;
+            Gdiplus::RectF box(offset, offset, (maxWidth > 0.0f) ? maxWidth : float(bitmapCX), float(bitmapCY));
+
+            if(source->bUseOutline)
+            {
+                Gdiplus::FontFamily fontFamily;
+                Gdiplus::GraphicsPath path;
+
+                font->GetFamily(&fontFamily);
+                path.AddString(lpText, -1, &fontFamily, font->GetStyle(), font->GetSize(), box, format);
+
+                source->DrawOutlineText(&bmpGraphics, *font, path, *format, &brush);
+            }
+            else
+            {
+                Gdiplus::Status stat = bmpGraphics.DrawString(lpText, -1, font, box, format, &brush);
+                if(stat != Gdiplus::Ok)
+                    AppWarning(TEXT("TextSource::DrawParagraph: Graphics::DrawString failed: %u"), (int)stat);
+            }
+        }
+    };
+
     void DrawOutlineText(Gdiplus::Graphics *graphics,
                          Gdiplus::Font &font,
                          const Gdiplus::GraphicsPath &path,
@@ -255,6 +333,68 @@ class TextOutputSource : public ImageSource
         return offset;
     }
 
+    //texture size for the measured text, the bounding box grows to the minimum size if it's smaller
+    void GetTextSize(Gdiplus::RectF &boundingBox, SIZE &textSize)
+    {
+        if(bVertical)
+        {
+            if(boundingBox.Width<size)
+            {
+                textSize.cx = size;
+                boundingBox.Width = float(size);
+            }
+            else
+                textSize.cx = LONG(boundingBox.Width + EPSILON);
+
+            textSize.cy = LONG(boundingBox.Height + EPSILON);
+        }
+        else
+        {
+            if(boundingBox.Height<size)
+            {
+                textSize.cy = size;
+                boundingBox.Height = float(size);
+            }
+            else
+                textSize.cy = LONG(boundingBox.Height + EPSILON);
+
+            textSize.cx = LONG(boundingBox.Width + EPSILON);
+        }
+
+        if(bUseExtents)
+        {
+            if(bWrap)
+            {
+                textSize.cx = extentWidth;
+                textSize.cy = extentHeight;
+            }
+            else
+            {
+                if(LONG(extentWidth) > textSize.cx)
+                    textSize.cx = extentWidth;
+                if(LONG(extentHeight) > textSize.cy)
+                    textSize.cy = extentHeight;
+            }
+        }
+
+        //textSize.cx &= 0xFFFFFFFE;
+        //textSize.cy &= 0xFFFFFFFE;
+
+        textSize.cx += textSize.cx%2;
+        textSize.cy += textSize.cy%2;
+
+        ClampVal(textSize.cx, 32, 8192);
+        ClampVal(textSize.cy, 32, 8192);
+    }
+
+    DWORD GetBackgroundColor()
+    {
+        if(backgroundOpacity == 0 && scrollSpeed !=0)
+            return 1<<24 | (color&0x00FFFFFF);
+
+        return ((strCurrentText.IsValid() || bUseExtents) ? GetAlphaVal(backgroundOpacity) : GetAlphaVal(0)) | (backgroundColor&0x00FFFFFF);
+    }
+
     void UpdateTexture()
     {
         HFONT hFont;
@@ -333,55 +473,7 @@ class TextOutputSource : public ImageSource
         hdc = NULL;
         DeleteObject(hFont);
 
-        if(bVertical)
-        {
-            if(boundingBox.Width<size)
-            {
-                textSize.cx = size;
-                boundingBox.Width = float(size);
-            }
-            else
-                textSize.cx = LONG(boundingBox.Width + EPSILON);
-
-            textSize.cy = LONG(boundingBox.Height + EPSILON);
-        }
-        else
-        {
-            if(boundingBox.Height<size)
-            {
-                textSize.cy = size;
-                boundingBox.Height = float(size);
-            }
-            else
-                textSize.cy = LONG(boundingBox.Height + EPSILON);
-
-            textSize.cx = LONG(boundingBox.Width + EPSILON);
-        }
-
-        if(bUseExtents)
-        {
-            if(bWrap)
-            {
-                textSize.cx = extentWidth;
-                textSize.cy = extentHeight;
-            }
-            else
-            {
-                if(LONG(extentWidth) > textSize.cx)
-                    textSize.cx = extentWidth;
-                if(LONG(extentHeight) > textSize.cy)
-                    textSize.cy = extentHeight;
-            }
-        }
-
-        //textSize.cx &= 0xFFFFFFFE;
-        //textSize.cy &= 0xFFFFFFFE;
-
-        textSize.cx += textSize.cx%2;
-        textSize.cy += textSize.cy%2;
-
-        ClampVal(textSize.cx, 32, 8192);
-        ClampVal(textSize.cy, 32, 8192);
+        GetTextSize(boundingBox, textSize);
 
         //----------------------------------------------------------------------
         // write image
@@ -409,12 +501,7 @@ class TextOutputSource : public ImageSource
 
             Gdiplus::SolidBrush  *brush = new Gdiplus::SolidBrush(Gdiplus::Color(GetAlphaVal(opacity)|(color&0x00FFFFFF)));
 
-            DWORD bkColor;
-
-		    if(backgroundOpacity == 0 && scrollSpeed !=0)
-                bkColor = 1<<24 | (color&0x00FFFFFF);
-            else
-                bkColor = ((strCurrentText.IsValid() || bUseExtents) ? GetAlphaVal(backgroundOpacity) : GetAlphaVal(0)) | (backgroundColor&0x00FFFFFF);
+            DWORD bkColor = GetBackgroundColor();
 
             if((textSize.cx > boundingBox.Width  || textSize.cy > boundingBox.Height) && !bUseExtents)
             {
@@ -480,7 +567,12 @@ class TextOutputSource : public ImageSource
                 texture = CreateTexture(textSize.cx, textSize.cy, GS_BGRA, lpBits, FALSE, FALSE);
             }
             else if(texture)
-                texture->SetImage(lpBits, GS_IMAGEFORMAT_BGRA, 4*textSize.cx);
+                texture->SetImageRect(lpBits, GS_IMAGEFORMAT_BGRA, 4*textSize.cx, 0, 0, textSize.cx, textSize.cy);
+
+            //the cached layout's last image doesn't match the texture anymore
+            Free(lpTextBits);
+            Free(lpNewTextBits);
+            lpTextBits = lpNewTextBits = NULL;
 
             if(!texture)
             {
@@ -493,6 +585,152 @@ class TextOutputSource : public ImageSource
         }
     }
 
+    //everything up to the upload, no graphics calls in here
+    void ComposeLayoutImage()
+    {
+        UpdateCurrentText();
+
+        HFONT hFont = GetFont();
+        if(!hFont)
+            return;
+
+        Gdiplus::StringFormat format(Gdiplus::StringFormat::GenericTypographic());
+        SetStringFormat(format);
+
+        HDC hdc = CreateCompatibleDC(NULL);
+
+        Gdiplus::Font font(hdc, hFont);
+        Gdiplus::Graphics graphics(hdc);
+        graphics.SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
+
+        GDIPlusRasterizer rasterizer;
+        rasterizer.source = this;
+        rasterizer.graphics = &graphics;
+        rasterizer.font = &font;
+        rasterizer.format = &format;
+
+        //anything that changes how a paragraph looks means they all have to be drawn again
+        String strStyle = FormattedString(TEXT("%s|%d|%d|%d|%d|%d|%08lX|%u|%d|%g|%08lX|%u"), strFont.Array(), size,
+            (int)bBold, (int)bItalic, (int)bUnderline, align, color, opacity, (int)bUseOutline, outlineSize, outlineColor, outlineOpacity);
+
+        if(strStyle != strLayoutStyle)
+        {
+            layout.Clear();
+            strLayoutStyle = strStyle;
+        }
+
+        //------------------------------------
+
+        Gdiplus::RectF boundingBox(0.0f, 0.0f, 32.0f, 32.0f);
+        float padding = bUseOutline ? outlineSize : 0.0f;
+
+        if(bUseExtents && bWrap)
+        {
+            //Note: since there's no path widening in DrawOutlineText the padding is half than what it was supposed to be.
+            Gdiplus::RectF layoutBox(0.0f, 0.0f, float(extentWidth)-padding, float(extentHeight)-padding);
+
+            if(bScrollMode)
+            {
+                layout.Layout(&rasterizer, strCurrentText, layoutBox.Width, layoutBox.Height);
+
+                float offset = layout.NumLines() ? layoutBox.Height-layout.Height() : 0.0f;
+
+                boundingBox = layoutBox;
+                boundingBox.Y = offset;
+                if(offset < 0)
+                    boundingBox.Height -= offset;
+            }
+            else
+            {
+                layout.Layout(&rasterizer, strCurrentText, layoutBox.Width);
+
+                if(layout.NumLines())
+                    boundingBox = Gdiplus::RectF(0.0f, 0.0f, layout.Width(), MIN(layout.Height(), layoutBox.Height));
+            }
+        }
+        else
+        {
+            layout.Layout(&rasterizer, strCurrentText, 0.0f);
+
+            if(layout.NumLines())
+                boundingBox = Gdiplus::RectF(0.0f, 0.0f, layout.Width()+padding, layout.Height()+padding);
+        }
+
+        SIZE textSize;
+        GetTextSize(boundingBox, textSize);
+
+        //------------------------------------
+        // draw the image
+
+        bool bResized = (textureSize.cx != textSize.cx || textureSize.cy != textSize.cy || !texture || !lpTextBits);
+        if(bResized)
+        {
+            UINT imageSize = textSize.cx*textSize.cy*4;
+
+            Free(lpTextBits);
+            Free(lpNewTextBits);
+            lpTextBits    = (LPBYTE)Allocate(imageSize);
+            lpNewTextBits = (LPBYTE)Allocate(imageSize);
+        }
+
+        DWORD bkColor = GetBackgroundColor();
+
+        if((textSize.cx > boundingBox.Width  || textSize.cy > boundingBox.Height) && !bUseExtents)
+        {
+            FillImageRect(lpNewTextBits, textSize.cx, textSize.cy, 0, 0, textSize.cx, textSize.cy, 0);
+            FillImageRect(lpNewTextBits, textSize.cx, textSize.cy, int(boundingBox.X), int(boundingBox.Y),
+                int(ceil(boundingBox.Width)), int(ceil(boundingBox.Height)), bkColor);
+        }
+        else
+            FillImageRect(lpNewTextBits, textSize.cx, textSize.cy, 0, 0, textSize.cx, textSize.cy, bkColor);
+
+        //DrawString clips to the bounding box, outlines never were
+        int clipBottom = bUseOutline ? textSize.cy : int(ceil(boundingBox.Y+boundingBox.Height));
+        layout.Draw(&rasterizer, lpNewTextBits, textSize.cx, textSize.cy, int(boundingBox.X), int(floor(boundingBox.Y)), clipBottom);
+
+        DeleteDC(hdc);
+        DeleteObject(hFont);
+
+        mcpy(&composedSize, &textSize, sizeof(composedSize));
+        bImageResized = bResized;
+        bImageChanged = bResized || GetChangedRect(lpTextBits, lpNewTextBits, textSize.cx, textSize.cy, changedX, changedY, changedCX, changedCY);
+        bImageComposed = true;
+    }
+
+    //uploads only what changed
+    void UploadLayoutImage()
+    {
+        if(!bImageComposed)
+            return;
+
+        bImageComposed = false;
+
+        SIZE &textSize = composedSize;
+
+        if(bImageResized)
+        {
+            delete texture;
+
+            mcpy(&textureSize, &textSize, sizeof(textureSize));
+            texture = CreateTexture(textSize.cx, textSize.cy, GS_BGRA, lpNewTextBits, FALSE, TRUE);
+
+            if(!texture)
+                AppWarning(TEXT("TextSource::UpdateLayoutTexture: could not create texture"));
+        }
+        else if(bImageChanged)
+            texture->SetImageRect(lpNewTextBits, GS_IMAGEFORMAT_BGRA, 4*textSize.cx, changedX, changedY, changedCX, changedCY);
+
+        LPBYTE lpTemp = lpTextBits;
+        lpTextBits = lpNewTextBits;
+        lpNewTextBits = lpTemp;
+    }
+
+    void UpdateLayoutTexture()
+    {
+        ComposeLayoutImage();
+        UploadLayoutImage();
+    }
+
 public:
     inline TextOutputSource(XElement *data)
     {
@@ -519,6 +757,9 @@ public:
             texture = NULL;
         }
 
+        Free(lpTextBits);
+        Free(lpNewTextBits);
+
         delete ss;
 
         if(bMonitoringFileChanges)
@@ -527,8 +768,30 @@ public:
         }
     }
 
+    //vertical text still draws straight to a texture, so it has to wait for Preprocess
+    bool SupportsAsyncPreprocess() const {return true;}
+
+    void PreprocessAsync()
+    {
+        if(bMonitoringFileChanges)
+        {
+            if (OSFileHasChanged(fileChangeMonitor))
+                bUpdateTexture = true;
+        }
+
+        if(bUpdateTexture && !bVertical)
+        {
+            bUpdateTexture = false;
+            bContentChanged = true;
+
+            ComposeLayoutImage();
+        }
+    }
+
     void Preprocess()
     {
+        UploadLayoutImage();
+
         if(bMonitoringFileChanges)
         {
             if (OSFileHasChanged(fileChangeMonitor))
@@ -538,10 +801,20 @@ public:
         if(bUpdateTexture)
         {
             bUpdateTexture = false;
-            UpdateTexture();
+            bContentChanged = true;
+
+            if(bVertical)
+                UpdateTexture();
+            else
+                UpdateLayoutTexture();
         }
     }
 
+    bool HasContentChanged()
+    {
+        return bContentChanged || scrollSpeed != 0 || showExtentTime > 0.0f;
+    }
+
     void Tick(float fSeconds)
     {
         if(scrollSpeed != 0 && texture)
@@ -565,6 +838,8 @@ public:
 
     void Render(const Vect2 &pos, const Vect2 &size)
     {
+        bContentChanged = false;
+
         if(texture)
         {
             //EnableBlending(FALSE);
@@ -870,7 +870,10 @@ LRESULT CALLBACK OBS::ListboxHook(HWND hwnd, UINT message, WPARAM wParam, LPARAM
                 SendMessage(hwndMain, WM_COMMAND, MAKEWPARAM(ID_SCENES, LBN_SELCHANGE), (LPARAM)GetDlgItem(hwndMain, ID_SCENES));
 
                 if(bDelete)
+                {
+                    App->DropWarmScene(item);
                     item->GetParent()->RemoveElement(item);
+                }
             }
             else if(bDelete)
             {
@@ -2175,6 +2178,9 @@ INT_PTR CALLBACK OBS::GlobalSourcesProc(HWND hwnd, UINT message, WPARAM wParam,
 
                         XElement *element = globals->GetElementByID(id);
 
+                        //scenes that aren't active can still have the global source in them
+                        App->ClearWarmScenes();
+
                         if(App->bRunning && App->scene && App->scene->sceneItems.Num())
                         {
                             for(int i=int(App->scene->sceneItems.Num()-1); i>=0; i--)
@@ -3569,8 +3575,8 @@ LRESULT CALLBACK OBS::OBSProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lPa
                     break;
 
                 case ID_FILE_SAVE2:
-                    App->scenesConfig.SaveTo(String() << lpAppDataPath << "\\scenes.xconfig");
-                    App->scenesConfig.Save();
+                    App->scenesConfig.SaveToInBackground(String() << lpAppDataPath << "\\scenes.xconfig");
+                    App->scenesConfig.SaveInBackground();
                     break;
 
                 case ID_TOGGLERECORDING:
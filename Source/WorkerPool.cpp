@@ -0,0 +1,97 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "Main.h"
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool(UINT numThreads)
+{
+    hWakeSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    hDoneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    for(UINT i=0; i<numThreads; i++)
+    {
+        HANDLE hThread = OSCreateThread((XTHREAD)WorkerThread, this);
+        if(hThread)
+            threads << hThread;
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    SetEvent(hStopEvent);
+
+    for(UINT i=0; i<threads.Num(); i++)
+    {
+        OSWaitForThread(threads[i], NULL);
+        OSCloseThread(threads[i]);
+    }
+
+    CloseHandle(hWakeSemaphore);
+    CloseHandle(hStopEvent);
+    CloseHandle(hDoneEvent);
+}
+
+void WorkerPool::DoJobs()
+{
+    long job;
+    while((job = InterlockedIncrement(&nextJob)-1) < long(numJobs))
+        jobProc(jobParams[job]);
+}
+
+DWORD STDCALL WorkerPool::WorkerThread(WorkerPool *pool)
+{
+    HANDLE hEvents[2] = {pool->hStopEvent, pool->hWakeSemaphore};
+
+    while(WaitForMultipleObjects(2, hEvents, FALSE, INFINITE) == WAIT_OBJECT_0+1)
+    {
+        pool->DoJobs();
+
+        if(InterlockedDecrement(&pool->activeWorkers) == 0)
+            SetEvent(pool->hDoneEvent);
+    }
+
+    return 0;
+}
+
+void WorkerPool::Run(WORKERJOBPROC proc, LPVOID *params, UINT numParams)
+{
+    if(!numParams)
+        return;
+
+    jobProc = proc;
+    jobParams = params;
+    numJobs = numParams;
+    nextJob = 0;
+
+    //only wake as many as could possibly get something to do, this thread takes jobs as well.  every
+    //worker woken up has to check back in before returning so none of them can wander into the next batch
+    long numWorkers = long(MIN(threads.Num(), numParams-1));
+    activeWorkers = numWorkers;
+
+    if(numWorkers)
+        ReleaseSemaphore(hWakeSemaphore, numWorkers, NULL);
+
+    DoJobs();
+
+    if(numWorkers)
+        WaitForSingleObject(hDoneEvent, INFINITE);
+}
@@ -0,0 +1,49 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// a few threads that sit around waiting to split up a batch of jobs.  the thread calling Run does
+// jobs too and doesn't return until every one of them is done, so nothing is left running between batches.
+
+typedef void (STDCALL *WORKERJOBPROC)(LPVOID param);
+
+class WorkerPool
+{
+    List<HANDLE> threads;
+    HANDLE hWakeSemaphore, hStopEvent, hDoneEvent;
+
+    WORKERJOBPROC jobProc;
+    LPVOID *jobParams;
+    UINT numJobs;
+
+    volatile long nextJob;
+    volatile long activeWorkers;
+
+    void DoJobs();
+    static DWORD STDCALL WorkerThread(WorkerPool *pool);
+
+public:
+    WorkerPool(UINT numThreads);
+    ~WorkerPool();
+
+    //calls proc once for every param, spread across the pool
+    void Run(WORKERJOBPROC proc, LPVOID *params, UINT numParams);
+};
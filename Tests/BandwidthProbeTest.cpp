@@ -0,0 +1,236 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// runs the bandwidth probe's rate stepping against the local ingest shaped to a known speed.  the sender
+// mirrors RTMPPublisher:  the probe queues filler, a send thread writes it out, and the backlog is what's
+// queued but not yet written.  checks that the probe settles near the shaped rate, that the stream is marked
+// as a bandwidth test, and that dropping the backlog at the end lets the connection close right away.
+
+#include "IngestServer/IngestServer.h"
+#include "IngestServer/TestPublisher.h"
+#include "../Source/BandwidthProbeSteps.h"
+
+#include "log.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+class ProbeSender
+{
+    TestPublisher publisher;
+    std::thread sendThread;
+
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<std::pair<DWORD, UINT> > queue;   //timestamp, size
+    UINT queuedBytes;
+    bool bExit;
+
+    std::atomic<QWORD> sentBytes;
+    std::atomic<bool> bSendFailed;
+
+    void SendLoop()
+    {
+        bool bFirst = true;
+
+        while(true)
+        {
+            std::pair<DWORD, UINT> packet;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueChanged.wait(lock, [&] {return bExit || !queue.empty();});
+                if(bExit)
+                    break;
+
+                packet = queue.front();
+                queue.pop_front();
+                queuedBytes -= packet.second;
+            }
+
+            if(!publisher.SendVideo(packet.first, bFirst, packet.second))
+            {
+                bSendFailed = true;
+                break;
+            }
+
+            bFirst = false;
+            sentBytes += packet.second;
+        }
+    }
+
+public:
+    ProbeSender() : queuedBytes(0), bExit(false), sentBytes(0), bSendFailed(false) {}
+    ~ProbeSender() {Stop();}
+
+    bool Start(WORD port, const char *playPath)
+    {
+        publisher.SetPlayPath(playPath);
+        if(!publisher.Connect(port))
+            return false;
+
+        //keep the kernel from soaking up the backlog so the probe sees it, the way a real link fills up
+        int sendBufferSize = 16384;
+        setsockopt(publisher.GetRTMP()->m_sb.sb_socket, SOL_SOCKET, SO_SNDBUF, (const char*)&sendBufferSize, sizeof(sendBufferSize));
+
+        sendThread = std::thread(&ProbeSender::SendLoop, this);
+        return true;
+    }
+
+    void Queue(DWORD timestamp, UINT size)
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(std::make_pair(timestamp, size));
+        queuedBytes += size;
+        queueChanged.notify_one();
+    }
+
+    UINT GetBacklogBytes()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return queuedBytes;
+    }
+
+    inline QWORD GetSentBytes() const {return sentBytes;}
+    inline bool SendFailed() const {return bSendFailed;}
+
+    //what ~BandwidthProbe does:  throws away what's still queued so shutting down doesn't wait for it
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.clear();
+            queuedBytes = 0;
+            bExit = true;
+            queueChanged.notify_one();
+        }
+
+        if(sendThread.joinable())
+            sendThread.join();
+
+        publisher.Close();
+    }
+};
+
+//the loop of BandwidthProbe::RunProbe, returns how the probe ended
+static ProbeStep RunProbe(ProbeSender &sender, BandwidthProbeSteps &steps)
+{
+    QWORD startTime = TestTimeMS();
+    QWORD nextFrameTime = startTime;
+    QWORD nextSampleTime = startTime;
+
+    steps.Start(startTime, sender.GetSentBytes());
+
+    while(!sender.SendFailed())
+    {
+        QWORD curTime = TestTimeMS();
+
+        if(curTime >= nextFrameTime)
+        {
+            sender.Queue(DWORD(nextFrameTime-startTime), steps.FrameSize());
+            nextFrameTime += probeFrameInterval;
+        }
+
+        if(curTime >= nextSampleTime)
+        {
+            nextSampleTime += probeSampleInterval;
+
+            UINT rate = steps.rate;
+            ProbeStep step = steps.Sample(curTime, sender.GetSentBytes(), sender.GetBacklogBytes());
+
+            if(step == ProbeStep_NextRate || step == ProbeStep_MaxRate)
+                printf("  %5u kbps offered, %5u kbps sent\n", rate, steps.lastMeasuredRate);
+
+            if(step != ProbeStep_Continue && step != ProbeStep_NextRate)
+                return step;
+        }
+
+        QWORD nextTime = (nextFrameTime < nextSampleTime) ? nextFrameTime : nextSampleTime;
+        curTime = TestTimeMS();
+        if(nextTime > curTime)
+            TestSleep(UINT(nextTime-curTime));
+    }
+
+    return ProbeStep_TimeUp;
+}
+
+//probes a link shaped to linkRate kbps, 0 for unshaped, and returns the steps with the results
+static BandwidthProbeSteps ProbeLink(UINT linkRate, UINT startRate, UINT maxRate, ProbeStep &result)
+{
+    printf("link %u kbps, probing %u - %u kbps\n", linkRate, startRate, maxRate);
+
+    IngestServer server;
+    server.SetReadRate(linkRate);
+    server.SetReceiveBufferSize(16384);
+    CHECK(server.Start());
+
+    BandwidthProbeSteps steps(startRate, maxRate);
+
+    result = ProbeStep_TimeUp;
+
+    ProbeSender sender;
+    CHECK(sender.Start(server.GetPort(), "probe?bandwidthtest=true"));
+
+    result = RunProbe(sender, steps);
+    CHECK(!sender.SendFailed());
+
+    IngestStats stats = server.GetStats();
+    printf("  ingest received %.0f kbps on average\n", stats.MediaBitrate());
+    printf("  sustained %u kbps, congested at %u kbps, %u bytes backlog\n", steps.sustainedRate, steps.congestedRate, sender.GetBacklogBytes());
+
+    //at most the packet that's being written has to go out
+    QWORD stopTime = TestTimeMS();
+    sender.Stop();
+    CHECK(TestTimeMS()-stopTime < 1000);
+
+    CHECK_EQUAL(stats.numBandwidthTests, 1);
+
+    server.Stop();
+    return steps;
+}
+
+int main()
+{
+    //the ingest closing on the sender at the end is expected
+    RTMP_LogSetLevel(RTMP_LOGCRIT);
+
+    ProbeStep result;
+
+    //the probe should stop within a step or so of the shaped rate and report about that much
+    BandwidthProbeSteps slowLink = ProbeLink(2000, 500, 20000, result);
+    CHECK_EQUAL(result, ProbeStep_Congested);
+    CHECK(slowLink.sustainedRate >= 2000*7/10 && slowLink.sustainedRate <= 2000*13/10);
+    CHECK(slowLink.congestedRate > 2000*8/10 && slowLink.congestedRate <= 2000*2);
+
+    BandwidthProbeSteps fastLink = ProbeLink(6000, 2000, 50000, result);
+    CHECK_EQUAL(result, ProbeStep_Congested);
+    CHECK(fastLink.sustainedRate >= 6000*7/10 && fastLink.sustainedRate <= 6000*13/10);
+    CHECK(fastLink.congestedRate > 6000*8/10 && fastLink.congestedRate <= 6000*2);
+
+    //a link faster than the test limit runs to the limit without a backlog
+    BandwidthProbeSteps openLink = ProbeLink(0, 1000, 3000, result);
+    CHECK_EQUAL(result, ProbeStep_MaxRate);
+    CHECK(openLink.bHitMaxRate);
+    CHECK(!openLink.congestedRate);
+    CHECK(openLink.sustainedRate >= 3000*9/10);
+
+    return TestResult("BandwidthProbeTest");
+}
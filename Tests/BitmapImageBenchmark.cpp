@@ -0,0 +1,136 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// animated gifs in BitmapImage of increasing size and length, with every frame kept, with a window of
+// frames decoded ahead, and with every frame kept run length coded.  prints how long Init takes to put up
+// the first frame, how long a loop takes to play when every frame is shown as soon as it's ready, and the
+// most memory the decoded frames took up.
+
+#include "Main.h"       //Main.h has to come before the winsock headers TestCommon.h pulls in
+#include "TestCommon.h"
+#include "MockGraphicsSystem.h"
+#include "TestGifs.h"
+#include "BitmapImage.h"
+
+MOCK_GRAPHICS_SYSTEM_STATICS
+
+ConfigFile *AppConfig = NULL;   //BitmapImage reads its gif settings from here
+
+static const float frameTime = float(TEST_GIF_DELAY)*0.01f + 0.0001f;
+
+struct GifMode
+{
+    const char *lpName;
+    int cacheAllMB, decodeAhead;
+    bool bCompress;
+};
+
+static const GifMode modes[] =
+{
+    {"every frame",     4096, 8, false},
+    {"8 frame window",  0,    8, false},
+    {"compressed",      4096, 8, true},
+};
+
+static void RunGif(CTSTR lpPath, UINT cx, UINT cy, UINT numFrames, const GifMode &mode)
+{
+    AppConfig->SetInt(TEXT("General"), TEXT("GifCacheAllFramesMB"), mode.cacheAllMB);
+    AppConfig->SetInt(TEXT("General"), TEXT("GifDecodeAheadFrames"), mode.decodeAhead);
+    AppConfig->SetInt(TEXT("General"), TEXT("GifCompressFrames"), mode.bCompress ? 1 : 0);
+
+    BitmapImage *image = new BitmapImage;   //new zeroes it, same as the sources that hold one
+    image->SetPath(lpPath);
+
+    QWORD startTime = TestTimeNS();
+    image->Init();
+    double firstFrameMS = double(TestTimeNS()-startTime)/1000000.0;
+
+    CHECK(image->GetTexture() != NULL);
+
+    //one loop, each frame goes up as soon as the one after it is ready
+    startTime = TestTimeNS();
+    for(UINT i=0; i<numFrames; i++)
+    {
+        QWORD waitStart = TestTimeMS();
+        while(image->NumFramesReady() < 2)
+        {
+            if(TestTimeMS()-waitStart > 10000)
+                break;
+            std::this_thread::yield();
+        }
+
+        image->Tick(frameTime);
+    }
+    double loopMS = double(TestTimeNS()-startTime)/1000000.0;
+
+    CHECK(image->NumFramesReady() > 0);
+
+    char name[64];
+    sprintf(name, "%ux%u, %u frames, %s", cx, cy, numFrames, mode.lpName);
+    printf("  %-40s first frame %9.2f ms  loop %9.1f ms  peak %8.1f MB\n", name, firstFrameMS, loopMS,
+        double(image->GetPeakFrameCacheSize())/(1024.0*1024.0));
+    fflush(stdout);
+
+    delete image;
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    GS = new MockGraphicsSystem;
+
+    {
+        String strConfig;
+        strConfig << TestGifFolder() << TEXT("\\BitmapImageBenchmark.ini");
+
+        AppConfig = new ConfigFile;
+        AppConfig->Create(strConfig);
+
+        static const UINT corpus[][3] =
+        {
+            {320,  240,  10},
+            {640,  360,  30},
+            {1280, 720,  60},
+            {1920, 1080, 30},
+        };
+
+        for(UINT i=0; i<_countof(corpus); i++)
+        {
+            UINT cx = corpus[i][0], cy = corpus[i][1], numFrames = corpus[i][2];
+            String strPath = WriteTestGif(FormattedString(TEXT("bench%u.gif"), i), cx, cy, numFrames);
+
+            for(UINT j=0; j<_countof(modes); j++)
+                RunGif(strPath, cx, cy, numFrames, modes[j]);
+
+            OSDeleteFile(strPath);
+        }
+
+        delete AppConfig;
+        AppConfig = NULL;
+        OSDeleteFile(strConfig);
+    }
+
+    delete GS;
+    GS = NULL;
+
+    TerminateXT();
+    return TestResult("BitmapImageBenchmark");
+}
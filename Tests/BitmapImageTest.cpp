@@ -0,0 +1,286 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// animated gifs in BitmapImage against a mock graphics system.  the run length frame codec round trips
+// anything, small animations keep every frame, bigger ones only keep a window of frames ahead of the one
+// being shown and the decoder thread waits when the window is full until a frame goes by, catching up
+// when the source fell behind by whole loops.  compressed frames take less memory than raw ones.
+
+#include "Main.h"       //Main.h has to come before the winsock headers TestCommon.h pulls in
+#include "TestCommon.h"
+#include "MockGraphicsSystem.h"
+#include "TestGifs.h"
+#include "BitmapImage.h"
+
+MOCK_GRAPHICS_SYSTEM_STATICS
+
+ConfigFile *AppConfig = NULL;   //BitmapImage reads its gif settings from here
+
+static const float frameTime = float(TEST_GIF_DELAY)*0.01f + 0.0001f;
+
+static void SetGifConfig(int cacheAllMB, int decodeAhead, bool bCompress)
+{
+    AppConfig->SetInt(TEXT("General"), TEXT("GifCacheAllFramesMB"), cacheAllMB);
+    AppConfig->SetInt(TEXT("General"), TEXT("GifDecodeAheadFrames"), decodeAhead);
+    AppConfig->SetInt(TEXT("General"), TEXT("GifCompressFrames"), bCompress ? 1 : 0);
+}
+
+//new zeroes it, same as the sources that hold one
+static BitmapImage* LoadGif(CTSTR lpPath)
+{
+    BitmapImage *image = new BitmapImage;
+    image->SetPath(lpPath);
+    image->Init();
+    return image;
+}
+
+//gives the decoder thread a few seconds to get numFrames ready
+static bool WaitForFrames(BitmapImage *image, UINT numFrames)
+{
+    QWORD startTime = TestTimeMS();
+    while(image->NumFramesReady() < numFrames)
+    {
+        if(TestTimeMS()-startTime > 5000)
+            return false;
+        TestSleep(1);
+    }
+
+    return true;
+}
+
+//-------------------------------------------
+
+static bool RoundTrips(const DWORD *lpPixels, UINT numPixels)
+{
+    List<DWORD> compressed, decompressed;
+    compressed.SetSize(numPixels+1);
+    decompressed.SetSize(numPixels+1);
+    decompressed[numPixels] = 0xDEADBEEF;
+
+    UINT size = CompressGifFrame(lpPixels, numPixels, compressed.Array());
+    if(size > (numPixels+1)*sizeof(DWORD))
+        return false;
+
+    DecompressGifFrame(compressed.Array(), size, decompressed.Array());
+
+    return memcmp(decompressed.Array(), lpPixels, numPixels*sizeof(DWORD)) == 0 && decompressed[numPixels] == 0xDEADBEEF;
+}
+
+static void CheckCodec()
+{
+    List<DWORD> pixels;
+    pixels.SetSize(1000);
+
+    DWORD one = 0xFF123456;
+    CHECK(RoundTrips(&one, 1));
+    CHECK(RoundTrips(pixels.Array(), 0));
+
+    //flat
+    for(UINT i=0; i<1000; i++)
+        pixels[i] = 0xFF00FF00;
+    CHECK(RoundTrips(pixels.Array(), 1000));
+    CHECK(RoundTrips(pixels.Array(), 2));
+    CHECK(RoundTrips(pixels.Array(), 3));
+
+    DWORD compressed[2];
+    CHECK_EQUAL(CompressGifFrame(pixels.Array(), 1000, compressed), 8);
+
+    //nothing repeats, the worst case
+    for(UINT i=0; i<1000; i++)
+        pixels[i] = i;
+    CHECK(RoundTrips(pixels.Array(), 1000));
+
+    //pairs never make a run, threes just do
+    for(UINT i=0; i<1000; i++)
+        pixels[i] = i/2;
+    CHECK(RoundTrips(pixels.Array(), 1000));
+
+    for(UINT i=0; i<1000; i++)
+        pixels[i] = (i%4 == 3) ? 1 : 0;
+    CHECK(RoundTrips(pixels.Array(), 1000));
+
+    //runs of random length and color, ending at every possible point
+    UINT seed = 1;
+    for(UINT i=0; i<1000;)
+    {
+        seed = seed*1103515245 + 12345;
+        UINT run = 1 + (seed >> 16) % 6;
+        DWORD color = (seed >> 8) & 3;
+
+        for(UINT j=0; j<run && i<1000; j++)
+            pixels[i++] = color;
+    }
+
+    for(UINT i=0; i<=1000; i++)
+        CHECK(RoundTrips(pixels.Array(), i));
+}
+
+//small enough that every frame is kept
+static void CheckCacheAll(CTSTR lpPath, UINT numFrames, UINT frameSize)
+{
+    SetGifConfig(64, 4, false);
+
+    BitmapImage *image = LoadGif(lpPath);
+    CHECK(image->GetTexture() != NULL);
+
+    CHECK(WaitForFrames(image, numFrames));
+    CHECK_EQUAL(image->GetFrameCacheSize(), QWORD(numFrames+2)*frameSize);
+
+    //two loops, every frame is ready when it's due
+    UINT changeCount = image->GetChangeCount();
+    for(UINT i=0; i<numFrames*2; i++)
+        image->Tick(frameTime);
+
+    CHECK_EQUAL(image->GetChangeCount(), changeCount + numFrames*2);
+    CHECK_EQUAL(image->NumFramesReady(), numFrames);
+
+    delete image;
+}
+
+//only a window of frames, the decoder has to wait for the frames to go by
+static void CheckWindow(CTSTR lpPath, UINT numFrames, UINT frameSize)
+{
+    SetGifConfig(0, 4, false);
+
+    BitmapImage *image = LoadGif(lpPath);
+    CHECK(image->GetTexture() != NULL);
+
+    //decodes four ahead and stops there, without overwriting any of them
+    CHECK(WaitForFrames(image, 4));
+    TestSleep(50);
+    CHECK_EQUAL(image->NumFramesReady(), 4);
+    CHECK_EQUAL(image->GetPeakFrameCacheSize(), QWORD(4+2)*frameSize);
+
+    //every frame shown lets it decode one more, on past the end of the animation
+    UINT changeCount = image->GetChangeCount();
+    for(UINT i=0; i<numFrames+numFrames/2; i++)
+    {
+        CHECK(WaitForFrames(image, 4));
+        image->Tick(frameTime);
+    }
+
+    CHECK_EQUAL(image->GetChangeCount(), changeCount + numFrames+numFrames/2);
+    CHECK(WaitForFrames(image, 4));
+
+    //the source wasn't ticking for a few loops, the decoder skips ahead and catches up
+    image->Tick(frameTime*float(numFrames*3 + 2));
+    CHECK(WaitForFrames(image, 4));
+
+    changeCount = image->GetChangeCount();
+    image->Tick(frameTime);
+    CHECK_EQUAL(image->GetChangeCount(), changeCount+1);
+
+    //the window never grew
+    CHECK_EQUAL(image->GetPeakFrameCacheSize(), QWORD(4+2)*frameSize);
+
+    delete image;
+}
+
+static void CheckCompressed(CTSTR lpPath, UINT numFrames, UINT frameSize)
+{
+    SetGifConfig(64, 4, true);
+
+    BitmapImage *image = LoadGif(lpPath);
+    CHECK(WaitForFrames(image, numFrames));
+
+    //flat bands and a square, every frame fits in a small part of a raw one
+    QWORD buffersSize = QWORD(frameSize)*3 + sizeof(DWORD);
+    CHECK(image->GetPeakFrameCacheSize() > buffersSize);
+    CHECK(image->GetPeakFrameCacheSize() < buffersSize + QWORD(numFrames)*frameSize/8);
+
+    //and they decompress into what was shown
+    UINT changeCount = image->GetChangeCount();
+    for(UINT i=0; i<numFrames; i++)
+        image->Tick(frameTime);
+    CHECK_EQUAL(image->GetChangeCount(), changeCount + numFrames);
+
+    delete image;
+}
+
+static void *TestBitmapCreate(int width, int height)      {return Allocate(width*height*4);}
+static void TestBitmapDestroy(void *bitmap)                 {Free(bitmap);}
+static unsigned char *TestBitmapGetBuffer(void *bitmap)     {return (unsigned char*)bitmap;}
+
+//the decoded frames themselves round trip through the codec
+static void CheckDecodedFrames(List<BYTE> &gifData, UINT numFrames)
+{
+    gif_bitmap_callback_vt callbacks;
+    zero(&callbacks, sizeof(callbacks));
+    callbacks.bitmap_create = TestBitmapCreate;
+    callbacks.bitmap_destroy = TestBitmapDestroy;
+    callbacks.bitmap_get_buffer = TestBitmapGetBuffer;
+
+    gif_animation gif;
+    gif_create(&gif, &callbacks);
+
+    gif_result result;
+    do
+    {
+        result = gif_initialise(&gif, gifData.Num(), gifData.Array());
+    } while(result == GIF_WORKING);
+
+    CHECK_EQUAL(result, GIF_OK);
+    CHECK_EQUAL(gif.frame_count, numFrames);
+
+    for(UINT i=0; i<gif.frame_count; i++)
+    {
+        CHECK_EQUAL(gif_decode_frame(&gif, i), GIF_OK);
+        CHECK(RoundTrips((const DWORD*)gif.frame_image, gif.width*gif.height));
+    }
+
+    gif_finalise(&gif);
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    GS = new MockGraphicsSystem;
+
+    {
+        String strConfig;
+        strConfig << TestGifFolder() << TEXT("\\BitmapImageTest.ini");
+
+        AppConfig = new ConfigFile;
+        AppConfig->Create(strConfig);
+
+        const UINT cx = 160, cy = 120, numFrames = 20;
+        String strPath = WriteTestGif(TEXT("test.gif"), cx, cy, numFrames);
+
+        List<BYTE> gifData;
+        BuildTestGif(gifData, cx, cy, numFrames);
+
+        CheckCodec();
+        CheckDecodedFrames(gifData, numFrames);
+        CheckCacheAll(strPath, numFrames, cx*cy*4);
+        CheckWindow(strPath, numFrames, cx*cy*4);
+        CheckCompressed(strPath, numFrames, cx*cy*4);
+
+        delete AppConfig;
+        AppConfig = NULL;
+        OSDeleteFile(strConfig);
+    }
+
+    delete GS;
+    GS = NULL;
+
+    TerminateXT();
+    return TestResult("BitmapImageTest");
+}
@@ -0,0 +1,48 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// force included into a separate build of librtmp so a test can count the allocations it makes.  the
+// test provides the functions.
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void *CountedMalloc(size_t size);
+void *CountedCalloc(size_t num, size_t size);
+void *CountedRealloc(void *ptr, size_t size);
+void CountedFree(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifndef __cplusplus
+#define malloc(size)        CountedMalloc(size)
+#define calloc(num, size)   CountedCalloc(num, size)
+#define realloc(ptr, size)  CountedRealloc(ptr, size)
+#define free(ptr)           CountedFree(ptr)
+#endif
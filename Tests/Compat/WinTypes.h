@@ -0,0 +1,35 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// just enough of the windows types for the standalone headers (the ones that don't pull in Main.h or
+// OBSApi.h) to compile on other platforms, so their tests can run anywhere.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../../OBSApi/Utility/Defs.h"
+
+typedef uint32_t            ULONG,DWORD,*LPDWORD;
+typedef int32_t             LONG,*LPLONG;
+typedef uintptr_t           UINT_PTR;
+typedef intptr_t            INT_PTR;
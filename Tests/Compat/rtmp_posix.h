@@ -0,0 +1,43 @@
+/*
+ *  Forced include for building librtmp outside of windows for the tests.
+ *
+ *  OBS only ships librtmp on windows, so rtmp.c leans on a few winsock names even on the
+ *  non-windows side of rtmp_sys.h.  this maps them to their posix equivalents, nothing
+ *  here is used by the application build.
+ */
+
+#ifndef __RTMP_POSIX_H__
+#define __RTMP_POSIX_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+
+#define FORMAT_MESSAGE_FROM_SYSTEM          0
+#define FormatMessageA(a, b, c, d, e, f, g) 0
+
+#define WSA_FLAG_OVERLAPPED                 0
+#define WSASocket(af, type, protocol, info, group, flags) socket(af, type, protocol)
+
+typedef struct hostent HOSTENT;
+#define GetLastError()                      h_errno
+#define WSAHOST_NOT_FOUND                   HOST_NOT_FOUND
+
+#endif
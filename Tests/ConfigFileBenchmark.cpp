@@ -0,0 +1,147 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// ConfigFile with a 5,000 key profile:  loading it, looking keys up and changing them.  changes patch the
+// loaded keys and the index in place instead of reloading, so after a run of changes everything is
+// compared against a fresh load of the file that was written.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+
+const UINT numSections = 50;
+const UINT keysPerSection = 100;
+
+static String KeyName(UINT i) {return FormattedString(TEXT("Key%u"), i);}
+static String SectionName(UINT i) {return FormattedString(TEXT("Section%u"), i);}
+
+static void WriteProfile(CTSTR lpPath)
+{
+    String strData;
+    for(UINT i=0; i<numSections; i++)
+    {
+        strData << TEXT("[") << SectionName(i) << TEXT("]\r\n");
+        for(UINT j=0; j<keysPerSection; j++)
+            strData << KeyName(j) << TEXT("=") << UINT(i*keysPerSection+j) << TEXT("\r\n");
+        strData << TEXT("\r\n");
+    }
+
+    XFile file(lpPath, XFILE_WRITE, XFILE_CREATEALWAYS);
+    file.Write("\xEF\xBB\xBF", 3);
+    file.WriteAsUTF8(strData, strData.Length());
+}
+
+//every key of every section has the same values in both
+static bool SameKeys(ConfigFile &a, ConfigFile &b)
+{
+    for(UINT i=0; i<numSections; i++)
+    {
+        String strSection = SectionName(i);
+        for(UINT j=0; j<keysPerSection+10; j++)
+        {
+            String strKey = KeyName(j);
+
+            StringList listA, listB;
+            BOOL bHasA = a.GetStringList(strSection, strKey, listA);
+            BOOL bHasB = b.GetStringList(strSection, strKey, listB);
+
+            if(bHasA != bHasB || a.HasKey(strSection, strKey) != b.HasKey(strSection, strKey) || listA.Num() != listB.Num())
+                return false;
+            for(UINT k=0; k<listA.Num(); k++)
+            {
+                if(listA[k] != listB[k])
+                    return false;
+            }
+
+            if(a.GetInt(strSection, strKey, -1) != b.GetInt(strSection, strKey, -1))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    {
+        TCHAR tempDir[MAX_PATH];
+        GetTempPath(MAX_PATH, tempDir);
+        String strPath = String(tempDir) << TEXT("ConfigFileBenchmark.ini");
+
+        WriteProfile(strPath);
+
+        Benchmark("ConfigFile::Open, 5000 keys", [&] {
+            ConfigFile config;
+            config.Open(strPath);
+        });
+
+        ConfigFile config;
+        CHECK(config.Open(strPath));
+        CHECK_EQUAL(config.GetInt(TEXT("Section49"), TEXT("Key99"), -1), 4999);
+        CHECK_EQUAL(config.GetInt(TEXT("section10"), TEXT("KEY5"), -1), 1005);
+        CHECK(!config.HasKey(TEXT("Section0"), TEXT("Key100")));
+
+        UINT i = 0;
+        Benchmark("ConfigFile::GetInt, 5000 keys", [&] {
+            i = (i+7919) % (numSections*keysPerSection);
+            DoNotOptimize(config.GetInt(SectionName(i/keysPerSection), KeyName(i%keysPerSection)));
+        });
+
+        UINT numSets = 0;
+        Benchmark("ConfigFile::SetInt, 5000 keys", [&] {
+            i = (i+7919) % (numSections*keysPerSection);
+            config.SetInt(SectionName(i/keysPerSection), KeyName(i%keysPerSection), int(100000+numSets++));
+        });
+
+        //new keys, new sections, extra values, removals and emptied values, then the same as a fresh load
+        for(UINT j=0; j<200; j++)
+            config.SetInt(SectionName(j%numSections), KeyName(keysPerSection+j%10), int(j));
+        config.SetString(TEXT("NewSection"), TEXT("Key1"), TEXT("new"));
+        config.AddInt(SectionName(3), KeyName(4), 12345);
+        config.AddInt(SectionName(3), KeyName(4), 23456);
+        config.Remove(SectionName(5), KeyName(6));
+        config.SetString(SectionName(7), KeyName(8), TEXT(""));
+        config.SetString(SectionName(7), KeyName(8), TEXT("back"));
+        config.SetString(SectionName(9), KeyName(1), TEXT(""));
+
+        CHECK_EQUAL(config.GetInt(SectionName(9), KeyName(keysPerSection+9), -1), 159);
+        CHECK(config.GetString(TEXT("NewSection"), TEXT("Key1")) == TEXT("new"));
+        CHECK(!config.HasKey(SectionName(5), KeyName(6)));
+        CHECK(config.GetString(SectionName(7), KeyName(8)) == TEXT("back"));
+        CHECK(!config.HasKey(SectionName(9), KeyName(1)));
+
+        List<int> values;
+        config.GetIntList(SectionName(3), KeyName(4), values);
+        CHECK_EQUAL(values.Num(), 3);
+
+        ConfigFile reloaded;
+        CHECK(reloaded.Open(strPath));
+        CHECK(SameKeys(config, reloaded));
+        CHECK(reloaded.GetString(TEXT("NewSection"), TEXT("Key1")) == TEXT("new"));
+
+        reloaded.Close();
+        config.Close();
+        OSDeleteFile(strPath);
+    }
+
+    TerminateXT();
+    return TestResult("ConfigFileBenchmark");
+}
@@ -0,0 +1,244 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// the memory capture tile kernels from GraphicsCapture/FrameTiles.h over synthetic frame sequences:  a
+// still desktop, a cursor sized box moving around, a scrolling window, a flickering single pixel, and a
+// full change.  every frame the tile map has to match a plain memcmp of each tile, the output has to be
+// the frame, copying in place has to give the same map, and uploading only the runs from
+// GetChangedTileRun has to turn the last frame into the new one.  odd pitches and heights cover the
+// partial tiles on the right and bottom, and misaligned buffers the unaligned copy path.
+
+#include "TestCommon.h"
+#include "../GraphicsCapture/FrameTiles.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+typedef void (*DrawFrameFunc)(std::vector<BYTE> &frame, UINT pitch, UINT height, UINT frameIndex);
+
+static void DrawStill(std::vector<BYTE> &frame, UINT pitch, UINT height, UINT frameIndex)
+{
+    if(frameIndex == 0)
+    {
+        for(UINT i=0; i<frame.size(); i++)
+            frame[i] = BYTE(i*31 + (i>>8));
+    }
+}
+
+static void DrawMovingBox(std::vector<BYTE> &frame, UINT pitch, UINT height, UINT frameIndex)
+{
+    DrawStill(frame, pitch, height, 0);
+
+    UINT boxX = (frameIndex*37) % (pitch > 128 ? pitch-128 : 1);
+    UINT boxY = (frameIndex*11) % (height > 32 ? height-32 : 1);
+
+    for(UINT y=boxY; y<boxY+32 && y<height; y++)
+    {
+        for(UINT x=boxX; x<boxX+128 && x<pitch; x++)
+            frame[y*pitch + x] = BYTE(0xF0 ^ frameIndex);
+    }
+}
+
+static void DrawScrolling(std::vector<BYTE> &frame, UINT pitch, UINT height, UINT frameIndex)
+{
+    for(UINT y=0; y<height; y++)
+    {
+        UINT line = y + frameIndex*3;
+        for(UINT x=0; x<pitch; x++)
+            frame[y*pitch + x] = BYTE(line*7 + x);
+    }
+}
+
+static void DrawFlicker(std::vector<BYTE> &frame, UINT pitch, UINT height, UINT frameIndex)
+{
+    DrawStill(frame, pitch, height, 0);
+    frame[frame.size()-1] ^= BYTE(frameIndex & 1);
+    frame[(height/2)*pitch + pitch/2] = BYTE(frameIndex);
+}
+
+static void DrawNoise(std::vector<BYTE> &frame, UINT pitch, UINT height, UINT frameIndex)
+{
+    std::mt19937 random(frameIndex);
+    for(UINT i=0; i<frame.size(); i++)
+        frame[i] = BYTE(random());
+}
+
+//----------------------------------------------------------------------------
+
+static bool ReferenceTileChanged(const BYTE *lpA, const BYTE *lpB, UINT pitch, UINT height, UINT tileX, UINT tileY)
+{
+    UINT x = tileX*FRAME_TILE_BYTES, y = tileY*FRAME_TILE_ROWS;
+    UINT width = std::min(pitch-x, UINT(FRAME_TILE_BYTES)), rows = std::min(height-y, UINT(FRAME_TILE_ROWS));
+
+    for(UINT row=0; row<rows; row++)
+    {
+        if(memcmp(lpA+(y+row)*pitch+x, lpB+(y+row)*pitch+x, width) != 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void RunSequence(const char *name, DrawFrameFunc drawFrame, UINT pitch, UINT height, UINT misalign)
+{
+    UINT size = pitch*height;
+    UINT tilesX = GetFrameTilesX(pitch), tilesY = GetFrameTilesY(height);
+
+    std::vector<BYTE> frame(size), lastFrame(size);
+    std::vector<BYTE> outputStorage(size+16+misalign), inPlaceStorage(size+16+misalign);
+    std::vector<BYTE> tileMap(tilesX*tilesY), inPlaceTileMap(tilesX*tilesY);
+    std::vector<BYTE> texture(size);
+
+    //the output buffers start at an aligned address plus misalign
+    LPBYTE lpOutput  = (LPBYTE)((UINT_PTR(outputStorage.data())+15) & ~UINT_PTR(15)) + misalign;
+    LPBYTE lpInPlace = (LPBYTE)((UINT_PTR(inPlaceStorage.data())+15) & ~UINT_PTR(15)) + misalign;
+
+    int failuresBefore = TestFailureCount();
+
+    for(UINT frameIndex=0; frameIndex<12; frameIndex++)
+    {
+        drawFrame(frame, pitch, height, frameIndex);
+
+        //into a separate buffer against the last frame
+        UINT numChanged = CopyFrameTiles(lpOutput, frame.data(), frameIndex ? lastFrame.data() : NULL, pitch, height, tileMap.data());
+
+        UINT numExpected = 0;
+        for(UINT tileY=0; tileY<tilesY; tileY++)
+        {
+            for(UINT tileX=0; tileX<tilesX; tileX++)
+            {
+                bool bExpected = !frameIndex || ReferenceTileChanged(frame.data(), lastFrame.data(), pitch, height, tileX, tileY);
+                CHECK_EQUAL(tileMap[tileY*tilesX + tileX], bExpected ? 1 : 0);
+                if(bExpected)
+                    numExpected++;
+            }
+        }
+        CHECK_EQUAL(numChanged, numExpected);
+        CHECK(memcmp(lpOutput, frame.data(), size) == 0);
+
+        //in place, the way the hook does it
+        UINT numInPlace = CopyFrameTiles(lpInPlace, frame.data(), frameIndex ? lpInPlace : NULL, pitch, height, inPlaceTileMap.data());
+        CHECK_EQUAL(numInPlace, numChanged);
+        CHECK(inPlaceTileMap == tileMap);
+        CHECK(memcmp(lpInPlace, frame.data(), size) == 0);
+
+        //upload only the changed runs, like the plugin does
+        for(UINT tileY=0; tileY<tilesY; tileY++)
+        {
+            UINT y = tileY*FRAME_TILE_ROWS, rows = std::min(height-y, UINT(FRAME_TILE_ROWS));
+            UINT tileX = 0, numTiles;
+
+            while(GetChangedTileRun(tileMap.data() + tileY*tilesX, tilesX, tileX, numTiles))
+            {
+                for(UINT i=0; i<numTiles; i++)
+                    CHECK(tileMap[tileY*tilesX + tileX + i] != 0);
+                CHECK(tileX+numTiles == tilesX || tileMap[tileY*tilesX + tileX + numTiles] == 0);
+
+                UINT x = tileX*FRAME_TILE_BYTES;
+                UINT width = std::min(numTiles*FRAME_TILE_BYTES, pitch-x);
+                for(UINT row=0; row<rows; row++)
+                    memcpy(&texture[(y+row)*pitch + x], lpOutput+(y+row)*pitch+x, width);
+
+                tileX += numTiles;
+            }
+        }
+        CHECK(texture == frame);
+
+        lastFrame = frame;
+    }
+
+    printf("%-14s %5ux%-4u %s\n", name, pitch, height, TestFailureCount() == failuresBefore ? "ok" : "FAILED");
+}
+
+int main()
+{
+    struct {UINT pitch, height;} sizes[] =
+    {
+        {1920*4, 1080},     //a full tile grid on the right, a partial one on the bottom
+        {1366*4, 768},      //partial tiles on both
+        {100*4, 7},         //smaller than a tile
+        {FRAME_TILE_BYTES, FRAME_TILE_ROWS},
+        {FRAME_TILE_BYTES*3+4, FRAME_TILE_ROWS*2+1},
+    };
+
+    struct {const char *name; DrawFrameFunc func;} sequences[] =
+    {
+        {"still",       DrawStill},
+        {"moving box",  DrawMovingBox},
+        {"scrolling",   DrawScrolling},
+        {"flicker",     DrawFlicker},
+        {"noise",       DrawNoise},
+    };
+
+    for(UINT i=0; i<sizeof(sequences)/sizeof(sequences[0]); i++)
+    {
+        for(UINT j=0; j<sizeof(sizes)/sizeof(sizes[0]); j++)
+        {
+            RunSequence(sequences[i].name, sequences[i].func, sizes[j].pitch, sizes[j].height, 0);
+            RunSequence(sequences[i].name, sequences[i].func, sizes[j].pitch, sizes[j].height, 4);
+        }
+    }
+
+    //tile counts
+    CHECK_EQUAL(GetFrameTilesX(FRAME_TILE_BYTES), 1);
+    CHECK_EQUAL(GetFrameTilesX(FRAME_TILE_BYTES+1), 2);
+    CHECK_EQUAL(GetFrameTilesY(FRAME_TILE_ROWS), 1);
+    CHECK_EQUAL(GetFrameTilesY(1), 1);
+
+    //runs in a hand made row
+    const BYTE row[] = {0, 1, 1, 0, 0, 1, 0, 1};
+    UINT tileX = 0, numTiles = 0;
+    CHECK(GetChangedTileRun(row, 8, tileX, numTiles));
+    CHECK_EQUAL(tileX, 1);
+    CHECK_EQUAL(numTiles, 2);
+    tileX += numTiles;
+    CHECK(GetChangedTileRun(row, 8, tileX, numTiles));
+    CHECK_EQUAL(tileX, 5);
+    CHECK_EQUAL(numTiles, 1);
+    tileX += numTiles;
+    CHECK(GetChangedTileRun(row, 8, tileX, numTiles));
+    CHECK_EQUAL(tileX, 7);
+    CHECK_EQUAL(numTiles, 1);
+    tileX += numTiles;
+    CHECK(!GetChangedTileRun(row, 8, tileX, numTiles));
+
+    //StreamCopy on its own, every size up to a few blocks and both alignments
+    std::vector<BYTE> source(300), dest(320);
+    for(UINT i=0; i<source.size(); i++)
+        source[i] = BYTE(i*13+1);
+
+    for(UINT misalign=0; misalign<2; misalign++)
+    {
+        LPBYTE lpDest = (LPBYTE)((UINT_PTR(dest.data())+15) & ~UINT_PTR(15)) + misalign;
+        for(UINT size=0; size<=256; size++)
+        {
+            memset(dest.data(), 0xCC, dest.size());
+            StreamCopy(lpDest, source.data(), size);
+            _mm_sfence();
+
+            CHECK(memcmp(lpDest, source.data(), size) == 0);
+            CHECK_EQUAL(lpDest[size], 0xCC);
+        }
+    }
+
+    return TestResult("FrameTilesTest");
+}
@@ -0,0 +1,192 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// GlobalSourceCache against a mock graphics system:  a global source is only rendered to its texture once
+// it was drawn more than once the frame before, every copy after that draws the texture, and anything that
+// isn't opaque or changes size invalidates it.  sources that scale with point filtering have their texture
+// drawn with a point sampler, and the pixel shader's own sampler is back for whatever's drawn after it.
+
+#include "Main.h"       //Main.h has to come before the winsock headers TestCommon.h pulls in
+#include "TestCommon.h"
+#include "MockGraphicsSystem.h"
+
+MOCK_GRAPHICS_SYSTEM_STATICS
+
+class TestSource : public ImageSource
+{
+public:
+    Vect2 size;
+    bool bOpaque;
+    UINT numRenders;
+
+    TestSource() : size(320.0f, 180.0f), bOpaque(true), numRenders(0) {}
+
+    void Render(const Vect2 &pos, const Vect2 &size) {numRenders++;}
+    Vect2 GetSize() const {return size;}
+    bool IsOpaque() const {return bOpaque;}
+};
+
+static MockGraphicsSystem* MockGS() {return static_cast<MockGraphicsSystem*>(GS);}
+
+//one frame:  the cache gets its chance before the scene, then the scene draws the source numCopies times.
+//returns how many copies came from the texture
+static UINT RunFrame(GlobalSourceCache &cache, TestSource &source, UINT numCopies, bool bPointFiltering=false)
+{
+    cache.Render(&source, bPointFiltering);
+
+    UINT numFromCache = 0;
+    for(UINT i=0; i<numCopies; i++)
+    {
+        Vect2 pos(float(i)*100.0f, 0.0f), size(640.0f, 360.0f);
+        if(cache.Draw(pos, size))
+            numFromCache++;
+        else
+            source.Render(pos, size);
+    }
+
+    return numFromCache;
+}
+
+static void CheckCaching()
+{
+    GlobalSourceCache *cache = new GlobalSourceCache;   //new zeroes it, same as OBS::AddGlobalSourceToScene
+    TestSource source;
+
+    //a single copy is never cached
+    CHECK_EQUAL(RunFrame(*cache, source, 1), 0);
+    CHECK_EQUAL(RunFrame(*cache, source, 1), 0);
+    CHECK(cache->texture == NULL);
+    CHECK_EQUAL(source.numRenders, 2);
+
+    //three copies:  the first frame finds out, from the second on it's rendered once
+    CHECK_EQUAL(RunFrame(*cache, source, 3), 0);
+    CHECK_EQUAL(source.numRenders, 5);
+
+    MockGS()->draws.clear();
+    CHECK_EQUAL(RunFrame(*cache, source, 3), 3);
+    CHECK_EQUAL(source.numRenders, 6);
+    CHECK(cache->texture != NULL);
+    CHECK_EQUAL(cache->texture->Width(), 320);
+    CHECK_EQUAL(cache->texture->Height(), 180);
+    CHECK(MockGS()->renderTarget == cache->texture);
+
+    CHECK_EQUAL(MockGS()->draws.size(), 3);
+    for(UINT i=0; i<MockGS()->draws.size(); i++)
+    {
+        const MockDraw &draw = MockGS()->draws[i];
+        CHECK(draw.texture == cache->texture);
+        CHECK(draw.sampler == NULL);
+        CHECK(draw.x == float(i)*100.0f && draw.x2 == float(i)*100.0f+640.0f);
+    }
+
+    Texture *texture = cache->texture;
+    CHECK_EQUAL(RunFrame(*cache, source, 3), 3);
+    CHECK(cache->texture == texture);
+    CHECK_EQUAL(cache->numRenders, 2);
+    CHECK_EQUAL(cache->numHits, 6);
+
+    //down to one copy, it renders itself again the frame after
+    CHECK_EQUAL(RunFrame(*cache, source, 1), 1);
+    CHECK_EQUAL(RunFrame(*cache, source, 1), 0);
+    CHECK(cache->texture == NULL);
+    CHECK_EQUAL(cache->numInvalidations, 1);
+
+    //a size change makes a new texture
+    RunFrame(*cache, source, 2);
+    RunFrame(*cache, source, 2);
+    source.size = Vect2(100.0f, 50.0f);
+    CHECK_EQUAL(RunFrame(*cache, source, 2), 2);
+    CHECK_EQUAL(cache->texture->Width(), 100);
+    CHECK_EQUAL(cache->numInvalidations, 2);
+
+    //anything translucent would be blended twice, so it isn't cached
+    source.bOpaque = false;
+    CHECK_EQUAL(RunFrame(*cache, source, 2), 0);
+    CHECK(cache->texture == NULL);
+    CHECK_EQUAL(RunFrame(*cache, source, 2), 0);
+
+    //nothing to render in to
+    source.bOpaque = true;
+    source.size = Vect2(0.0f, 0.0f);
+    CHECK_EQUAL(RunFrame(*cache, source, 2), 0);
+    CHECK_EQUAL(RunFrame(*cache, source, 2), 0);
+
+    UINT numCreated = MockTexture::numCreated;
+    delete cache;
+    CHECK_EQUAL(MockTexture::NumDeleted(), numCreated);
+}
+
+static void CheckPointFiltering()
+{
+    GlobalSourceCache *cache = new GlobalSourceCache;
+    TestSource source;
+
+    MockShader drawShader(ShaderType_Pixel);
+    LoadPixelShader(&drawShader);
+
+    RunFrame(*cache, source, 2, true);
+    MockGS()->draws.clear();
+    CHECK_EQUAL(RunFrame(*cache, source, 2, true), 2);
+
+    CHECK(cache->pointSampler != NULL);
+    CHECK_EQUAL(MockGS()->draws.size(), 2);
+    for(UINT i=0; i<MockGS()->draws.size(); i++)
+    {
+        const MockDraw &draw = MockGS()->draws[i];
+        CHECK(draw.texture == cache->texture);
+        CHECK(draw.sampler == cache->pointSampler);
+        CHECK(draw.sampler && draw.sampler->GetSamplerInfo().filter == GS_FILTER_POINT);
+        CHECK(draw.pixelShader == &drawShader);
+    }
+
+    //the shader is still loaded, with its own sampler
+    CHECK(GetCurrentPixelShader() == &drawShader);
+    CHECK(MockGS()->samplers[0] == NULL);
+
+    //the sampler is made once and kept
+    SamplerState *sampler = cache->pointSampler;
+    RunFrame(*cache, source, 2, true);
+    CHECK(cache->pointSampler == sampler);
+
+    //turning it off goes back to the shader's sampler
+    MockGS()->draws.clear();
+    CHECK_EQUAL(RunFrame(*cache, source, 2, false), 2);
+    CHECK(MockGS()->draws.size() == 2 && MockGS()->draws[0].sampler == NULL);
+
+    LoadPixelShader(NULL);
+    delete cache;
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    GS = new MockGraphicsSystem;
+
+    CheckCaching();
+    CheckPointFiltering();
+
+    delete GS;
+    GS = NULL;
+
+    TerminateXT();
+    return TestResult("GlobalSourceCacheTest");
+}
@@ -0,0 +1,193 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// GetHiddenRects from OBSApi/Scene.cpp, which decides which scene items don't get rendered at all.  items
+// off the canvas, items covered by one or by several opaque items above them, items only partly covered or
+// covered by something that isn't opaque, and the cut off at 64 pieces, past which an item is drawn rather
+// than checked any further.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+
+static const Vect2 canvas(1280.0f, 720.0f);
+
+static void AddRect(List<SceneRect> &rects, float x, float y, float cx, float cy, bool bOpaque)
+{
+    SceneRect &rect = *rects.CreateNew();
+    rect.topLeft = Vect2(x, y);
+    rect.bottomRight = Vect2(x+cx, y+cy);
+    rect.bOpaque = bOpaque;
+}
+
+//whether the last rect is hidden
+static bool LastHidden(const List<SceneRect> &rects)
+{
+    List<bool> hidden;
+    GetHiddenRects(canvas, rects, hidden);
+
+    CHECK_EQUAL(hidden.Num(), rects.Num());
+    return hidden.Num() == rects.Num() && hidden.Last();
+}
+
+static void CheckOffCanvas()
+{
+    List<SceneRect> rects;
+    List<bool> hidden;
+
+    AddRect(rects, -200.0f, 100.0f, 200.0f, 100.0f, false);     //just left of it
+    AddRect(rects, 1280.0f, 100.0f, 100.0f, 100.0f, false);     //just right of it
+    AddRect(rects, 100.0f, -300.0f, 100.0f, 250.0f, false);     //above it
+    AddRect(rects, 100.0f, 720.0f, 100.0f, 100.0f, false);      //below it
+    AddRect(rects, -50.0f, -50.0f, 100.0f, 100.0f, false);      //partly on it
+    AddRect(rects, 1270.0f, 710.0f, 100.0f, 100.0f, false);
+    AddRect(rects, 300.0f, 300.0f, 0.0f, 0.0f, false);          //nothing to draw
+    AddRect(rects, -100.0f, -100.0f, 1480.0f, 920.0f, false);   //bigger than it
+
+    GetHiddenRects(canvas, rects, hidden);
+    CHECK_EQUAL(hidden.Num(), 8);
+    CHECK(hidden[0]);
+    CHECK(hidden[1]);
+    CHECK(hidden[2]);
+    CHECK(hidden[3]);
+    CHECK(!hidden[4]);
+    CHECK(!hidden[5]);
+    CHECK(hidden[6]);
+    CHECK(!hidden[7]);
+
+    //an off canvas item doesn't hide anything either
+    rects.Clear();
+    AddRect(rects, -2000.0f, 0.0f, 1000.0f, 720.0f, true);
+    AddRect(rects, 0.0f, 0.0f, 100.0f, 100.0f, false);
+    CHECK(!LastHidden(rects));
+}
+
+static void CheckFullCover()
+{
+    List<SceneRect> rects;
+    List<bool> hidden;
+
+    //one opaque item over another
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, true);
+    AddRect(rects, 100.0f, 100.0f, 300.0f, 200.0f, false);
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, true);
+
+    GetHiddenRects(canvas, rects, hidden);
+    CHECK(!hidden[0]);
+    CHECK(hidden[1]);
+    CHECK(hidden[2]);
+
+    //exactly the same size
+    rects.Clear();
+    AddRect(rects, 10.0f, 20.0f, 300.0f, 200.0f, true);
+    AddRect(rects, 10.0f, 20.0f, 300.0f, 200.0f, false);
+    CHECK(LastHidden(rects));
+
+    //covered by several, none of which cover it alone
+    rects.Clear();
+    AddRect(rects, 0.0f, 0.0f, 640.0f, 720.0f, true);
+    AddRect(rects, 640.0f, 0.0f, 640.0f, 360.0f, true);
+    AddRect(rects, 600.0f, 300.0f, 680.0f, 420.0f, true);
+    AddRect(rects, 500.0f, 200.0f, 400.0f, 300.0f, false);
+    CHECK(LastHidden(rects));
+
+    //only the part on the canvas has to be covered
+    rects.Clear();
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, true);
+    AddRect(rects, -100.0f, 600.0f, 300.0f, 300.0f, false);
+    CHECK(LastHidden(rects));
+}
+
+static void CheckPartialCover()
+{
+    List<SceneRect> rects;
+
+    //a pixel wide gap
+    AddRect(rects, 0.0f, 0.0f, 640.0f, 720.0f, true);
+    AddRect(rects, 641.0f, 0.0f, 639.0f, 720.0f, true);
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, false);
+    CHECK(!LastHidden(rects));
+
+    //a hole in the middle
+    rects.Clear();
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 300.0f, true);
+    AddRect(rects, 0.0f, 400.0f, 1280.0f, 320.0f, true);
+    AddRect(rects, 0.0f, 300.0f, 600.0f, 100.0f, true);
+    AddRect(rects, 700.0f, 300.0f, 580.0f, 100.0f, true);
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, false);
+    CHECK(!LastHidden(rects));
+
+    //covered but not by anything opaque
+    rects.Clear();
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, false);
+    AddRect(rects, 100.0f, 100.0f, 100.0f, 100.0f, false);
+    CHECK(!LastHidden(rects));
+
+    //an opaque item under it doesn't count
+    rects.Clear();
+    AddRect(rects, 100.0f, 100.0f, 100.0f, 100.0f, false);
+    AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, true);
+
+    List<bool> hidden;
+    GetHiddenRects(canvas, rects, hidden);
+    CHECK(!hidden[0]);
+    CHECK(!hidden[1]);
+}
+
+//small opaque items scattered over a big one each cut what's left of it into more pieces.  once there are
+//more than 64 it stops looking and draws the item, even if a later item would have covered the rest
+static void CheckPieceLimit()
+{
+    for(UINT numDots=4; numDots<=40; numDots += 36)
+    {
+        List<SceneRect> rects;
+
+        for(UINT i=0; i<numDots; i++)
+            AddRect(rects, 20.0f + float(i)*30.0f, 20.0f + float(i)*15.0f, 10.0f, 10.0f, true);
+
+        AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, true);
+        AddRect(rects, 0.0f, 0.0f, 1280.0f, 720.0f, false);
+
+        List<bool> hidden;
+        GetHiddenRects(canvas, rects, hidden);
+
+        for(UINT i=0; i<numDots; i++)
+            CHECK(!hidden[i]);
+        CHECK(!hidden[numDots]);
+
+        if(numDots == 4)
+            CHECK(hidden[numDots+1]);
+        else
+            CHECK(!hidden[numDots+1]);
+    }
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    CheckOffCanvas();
+    CheckFullCover();
+    CheckPartialCover();
+    CheckPieceLimit();
+
+    TerminateXT();
+    return TestResult("HiddenRectsTest");
+}
@@ -0,0 +1,92 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// loading a batch of image sources through the image cache against a mock graphics system, with every
+// source on its own picture against all of them on the same one (a slideshow or a logo used by many
+// scenes), and the release and texture cleanup that follows a scene going away.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+#include "MockGraphicsSystem.h"
+#include "TestBitmaps.h"
+#include "ImageCache.h"
+
+#include <gdiplus.h>
+
+MOCK_GRAPHICS_SYSTEM_STATICS
+
+#define NUM_SOURCES 32
+
+static void LoadBatch(String *paths)
+{
+    ImageRequest *requests[NUM_SOURCES];
+
+    for(UINT i=0; i<NUM_SOURCES; i++)
+        requests[i] = LoadImageAsync(paths[i]);
+
+    for(UINT i=0; i<NUM_SOURCES; i++)
+    {
+        WaitForImage(requests[i]);
+        DoNotOptimize(GetImageTexture(requests[i]));
+    }
+
+    for(UINT i=0; i<NUM_SOURCES; i++)
+        ReleaseImage(requests[i]);
+
+    DeleteReleasedImageTextures();
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    ULONG_PTR gdipToken;
+    const Gdiplus::GdiplusStartupInput gdipInput;
+    Gdiplus::GdiplusStartup(&gdipToken, &gdipInput, NULL);
+
+    GS = new MockGraphicsSystem;
+    InitImageCache();
+
+    String distinctPaths[NUM_SOURCES], sharedPaths[NUM_SOURCES];
+
+    String strShared = WriteTestBitmap(TEXT("shared.bmp"), 512, 512, 0);
+    for(UINT i=0; i<NUM_SOURCES; i++)
+    {
+        distinctPaths[i] = WriteTestBitmap(FormattedString(TEXT("distinct%u.bmp"), i), 512, 512, i+1);
+        sharedPaths[i] = strShared;
+    }
+
+    printf("%u sources, 512x512\n", NUM_SOURCES);
+
+    Benchmark("  every source on its own picture", [&] {LoadBatch(distinctPaths);});
+    Benchmark("  every source on the same picture", [&] {LoadBatch(sharedPaths);});
+
+    CHECK_EQUAL(MockTexture::NumDeleted(), MockTexture::numCreated);
+
+    FreeImageCache();
+    delete GS;
+    GS = NULL;
+
+    Gdiplus::GdiplusShutdown(gdipToken);
+    TerminateXT();
+
+    return TestResult("ImageCacheBenchmark");
+}
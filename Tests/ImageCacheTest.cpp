@@ -0,0 +1,156 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// the image cache against a mock graphics system.  files with the same contents share one decoded image and
+// one texture whatever they're called, an image goes away with its last request, and its texture is only
+// ever destroyed by DeleteReleasedImageTextures on the graphics thread, even when the last request was
+// released by a loader thread.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+#include "MockGraphicsSystem.h"
+#include "TestBitmaps.h"
+#include "ImageCache.h"
+
+#include <gdiplus.h>
+
+MOCK_GRAPHICS_SYSTEM_STATICS
+
+static ImageRequest* LoadAndWait(CTSTR lpPath)
+{
+    ImageRequest *request = LoadImageAsync(lpPath);
+    WaitForImage(request);
+    return request;
+}
+
+static void TestSharing()
+{
+    String strA = WriteTestBitmap(TEXT("a.bmp"), 37, 21, 1);
+    String strSameAsA = WriteTestBitmap(TEXT("same_as_a.bmp"), 37, 21, 1);
+    String strB = WriteTestBitmap(TEXT("b.bmp"), 16, 16, 2);
+
+    MockTexture::ResetCounts();
+
+    ImageRequest *a = LoadAndWait(strA);
+    ImageRequest *sameAsA = LoadAndWait(strSameAsA);
+    ImageRequest *b = LoadAndWait(strB);
+    ImageRequest *missing = LoadAndWait(TestImageFolder() << TEXT("\\missing.bmp"));
+
+    UINT cx = 0, cy = 0;
+    CHECK(GetImageSize(a, cx, cy));
+    CHECK_EQUAL(cx, 37);
+    CHECK_EQUAL(cy, 21);
+    CHECK(GetImageSize(b, cx, cy));
+    CHECK_EQUAL(cx, 16);
+
+    CHECK(ImageLoaded(missing));
+    CHECK(!GetImageSize(missing, cx, cy));
+    CHECK(GetImageTexture(missing) == NULL);
+
+    Texture *texA = GetImageTexture(a);
+    CHECK(texA != NULL);
+    CHECK(GetImageTexture(sameAsA) == texA);
+    CHECK(GetImageTexture(a) == texA);
+    CHECK(GetImageTexture(b) != NULL && GetImageTexture(b) != texA);
+    CHECK_EQUAL(MockTexture::numCreated, 2);
+
+    //the texture stays while any request uses it, and is only deleted when asked for
+    ReleaseImage(a);
+    DeleteReleasedImageTextures();
+    CHECK_EQUAL(MockTexture::NumDeleted(), 0);
+    CHECK(GetImageTexture(sameAsA) == texA);
+
+    ReleaseImage(sameAsA);
+    CHECK_EQUAL(MockTexture::NumDeleted(), 0);
+    DeleteReleasedImageTextures();
+    CHECK_EQUAL(MockTexture::NumDeleted(), 1);
+
+    ReleaseImage(b);
+    ReleaseImage(missing);
+    DeleteReleasedImageTextures();
+    CHECK_EQUAL(MockTexture::NumDeleted(), 2);
+}
+
+static void TestReleaseOffGraphicsThread()
+{
+    String strPath = WriteTestBitmap(TEXT("released.bmp"), 64, 32, 3);
+
+    MockTexture::ResetCounts();
+
+    //released from some other thread, the way a loader thread does it
+    ImageRequest *request = LoadAndWait(strPath);
+    CHECK(GetImageTexture(request) != NULL);
+
+    std::thread releaser([request]() {ReleaseImage(request);});
+    releaser.join();
+
+    CHECK_EQUAL(MockTexture::NumDeleted(), 0);
+    DeleteReleasedImageTextures();
+    CHECK_EQUAL(MockTexture::NumDeleted(), 1);
+
+    //a request that's dropped while the loader still holds it gets its last release on the loader thread.
+    //whoever releases last, every texture has to be destroyed here
+    std::thread::id graphicsThread = std::this_thread::get_id();
+
+    for(UINT i=0; i<200; i++)
+    {
+        ImageRequest *first = LoadAndWait(strPath);
+        GetImageTexture(first);
+
+        ImageRequest *second = LoadImageAsync(strPath);
+        ReleaseImage(first);
+        ReleaseImage(second);
+
+        if(i%16 == 0)
+            DeleteReleasedImageTextures();
+    }
+
+    FreeImageCache();
+    InitImageCache();
+
+    CHECK_EQUAL(MockTexture::NumDeleted(), MockTexture::numCreated);
+    for(UINT i=0; i<MockTexture::deletingThreads.size(); i++)
+        CHECK(MockTexture::deletingThreads[i] == graphicsThread);
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    ULONG_PTR gdipToken;
+    const Gdiplus::GdiplusStartupInput gdipInput;
+    Gdiplus::GdiplusStartup(&gdipToken, &gdipInput, NULL);
+
+    GS = new MockGraphicsSystem;
+    InitImageCache();
+
+    TestSharing();
+    TestReleaseOffGraphicsThread();
+
+    FreeImageCache();
+    delete GS;
+    GS = NULL;
+
+    Gdiplus::GdiplusShutdown(gdipToken);
+    TerminateXT();
+
+    return TestResult("ImageCacheTest");
+}
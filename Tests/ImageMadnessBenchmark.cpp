@@ -0,0 +1,95 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// unpacking one 1080p frame of each device format with the reference loops, the SSE2 kernels and the AVX2
+// ones when the CPU has it.  one thread, DeviceSource splits the 4:2:0 formats across its conversion threads.
+
+#include "TestCommon.h"
+#include "ImageMadnessReference.h"
+#include "../DShowPlugin/ImageMadnessKernels.h"
+
+#include <vector>
+
+const UINT width = 1920, height = 1080;
+
+int main()
+{
+    std::vector<uint8_t> planar(width*height*3), packed422(width*height*2);
+    for(size_t i=0; i<planar.size(); i++)
+        planar[i] = uint8_t(i*7 + (i>>11));
+    for(size_t i=0; i<packed422.size(); i++)
+        packed422[i] = uint8_t(i*13 + (i>>9));
+
+    std::vector<uint32_t> output(width*height);
+    uint8_t *convertBuffer = (uint8_t*)&output[0];
+
+    const char *formatNames[] = {"I420", "NV12", "P010"};
+
+    for(int format=0; format<3; format++)
+    {
+        UINT linePitch = (format == 2) ? width*2 : width;
+        char name[64];
+
+        sprintf(name, "%s 1080p, reference", formatNames[format]);
+        Benchmark(name, [&] {ReferencePack420(format, convertBuffer, &planar[0], width, height, width*4, 0, height, linePitch, 0);});
+
+        for(int pass=0; pass<2; pass++)
+        {
+            if(EnableImageMadnessAVX2(pass == 0) != (pass == 0))
+                continue;
+
+            sprintf(name, "%s 1080p, %s", formatNames[format], pass == 0 ? "AVX2" : "SSE2");
+            Benchmark(name, [&]
+            {
+                if(format == 0)
+                    PackI420(convertBuffer, &planar[0], width, height, width*4, 0, height, linePitch, 0);
+                else if(format == 1)
+                    PackNV12(convertBuffer, &planar[0], width, height, width*4, 0, height, linePitch, 0);
+                else
+                    PackP010(convertBuffer, &planar[0], width, height, width*4, 0, height, linePitch, 0);
+            });
+        }
+    }
+
+    const uint32_t *input = (const uint32_t*)&packed422[0];
+
+    Benchmark("YUY2 1080p, reference", [&]
+    {
+        for(UINT y=0; y<height; y++)
+            ReferenceConvert422Line(&output[y*width], input+y*width/2, width/2, true);
+    });
+
+    for(int pass=0; pass<2; pass++)
+    {
+        if(EnableImageMadnessAVX2(pass == 0) != (pass == 0))
+            continue;
+
+        Benchmark(pass == 0 ? "YUY2 1080p, AVX2" : "YUY2 1080p, SSE2", [&]
+        {
+            for(UINT y=0; y<height; y++)
+                Convert422Line(&output[y*width], input+y*width/2, width/2, true);
+        });
+    }
+
+    DoNotOptimize(output[0]);
+
+    return TestResult("ImageMadnessBenchmark");
+}
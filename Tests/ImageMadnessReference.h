@@ -0,0 +1,85 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+#include <stdint.h>
+
+//-------------------------------------------
+// what the DShowPlugin unpacking kernels should produce, written a pixel at a time straight from the
+// layout of each format.  the plane offsets are the ones DeviceSource gives PackPlanar: the chroma planes
+// start right after renderCX*renderCY luma samples, whatever the line pitch.
+
+inline void ReferencePack420(int format, uint8_t *convertBuffer, const uint8_t *lpPlanar, unsigned int renderCX, unsigned int renderCY,
+                             unsigned int pitch, unsigned int startY, unsigned int endY, unsigned int linePitch, unsigned int lineShift)
+{
+    const uint8_t *input = lpPlanar + lineShift;
+
+    for(unsigned int y=startY/2*2; y<endY/2*2; y++)
+    {
+        uint32_t *output = (uint32_t*)(convertBuffer + y*pitch);
+
+        for(unsigned int x=0; x<renderCX/2*2; x++)
+        {
+            unsigned int lum, u, v;
+
+            if(format == 0)         //I420
+            {
+                lum = input[y*linePitch + x];
+                u   = input[renderCX*renderCY + (y/2)*(linePitch/2) + x/2];
+                v   = input[renderCX*renderCY + renderCX*renderCY/4 + (y/2)*(linePitch/2) + x/2];
+            }
+            else if(format == 1)    //NV12
+            {
+                lum = input[y*linePitch + x];
+                u   = input[renderCX*renderCY + (y/2)*linePitch + (x/2)*2];
+                v   = input[renderCX*renderCY + (y/2)*linePitch + (x/2)*2 + 1];
+            }
+            else                    //P010, the high byte of each little endian sample
+            {
+                lum = input[y*linePitch + x*2 + 1];
+                u   = input[renderCX*renderCY*2 + (y/2)*linePitch + (x/2)*4 + 1];
+                v   = input[renderCX*renderCY*2 + (y/2)*linePitch + (x/2)*4 + 3];
+            }
+
+            output[x] = lum | (u << 8) | (v << 16);
+        }
+    }
+}
+
+//YUY2/YVYU macropixels are Y0 C0 Y1 C1, UYVY/HDYC are C0 Y0 C1 Y1.  each becomes two pixels with the same
+//chroma, the first with Y0 and the second with Y1
+inline void ReferenceConvert422Line(uint32_t *output, const uint32_t *input, unsigned int count, bool bLeadingY)
+{
+    for(unsigned int i=0; i<count; i++)
+    {
+        const uint8_t *bytes = (const uint8_t*)(input+i);
+
+        output[i*2] = input[i];
+
+        uint8_t pixel[4] = {bytes[0], bytes[1], bytes[2], bytes[3]};
+        if(bLeadingY)
+            pixel[0] = bytes[2];
+        else
+            pixel[1] = bytes[3];
+
+        output[i*2+1] = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16) | (uint32_t(pixel[3]) << 24);
+    }
+}
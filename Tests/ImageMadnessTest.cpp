@@ -0,0 +1,180 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// the DShowPlugin unpacking kernels against hand worked frames and against ImageMadnessReference.h, with
+// AVX2 and again with only SSE2.  widths that aren't a multiple of the SIMD block, partial ranges of lines
+// and padded input and output lines are all covered, and nothing past the end of each output line may be
+// written.
+
+#include "TestCommon.h"
+#include "ImageMadnessReference.h"
+#include "../DShowPlugin/ImageMadnessKernels.h"
+
+#include <random>
+#include <vector>
+
+const uint32_t guardValue = 0xDEADBEEF;
+
+static void PackFormat(int format, uint8_t *convertBuffer, const uint8_t *lpPlanar, UINT renderCX, UINT renderCY,
+                       UINT pitch, UINT startY, UINT endY, UINT linePitch, UINT lineShift)
+{
+    if(format == 0)
+        PackI420(convertBuffer, lpPlanar, renderCX, renderCY, pitch, startY, endY, linePitch, lineShift);
+    else if(format == 1)
+        PackNV12(convertBuffer, lpPlanar, renderCX, renderCY, pitch, startY, endY, linePitch, lineShift);
+    else
+        PackP010(convertBuffer, lpPlanar, renderCX, renderCY, pitch, startY, endY, linePitch, lineShift);
+}
+
+//a 4x2 frame of each format worked out by hand
+static void CheckWorkedFrames()
+{
+    uint32_t output[8];
+
+    const uint8_t i420[] = {0x10, 0x11, 0x12, 0x13,
+                            0x20, 0x21, 0x22, 0x23,
+                            0x80, 0x81,                 //U
+                            0xC0, 0xC1};                //V
+    PackI420((uint8_t*)output, i420, 4, 2, 16, 0, 2, 4, 0);
+    CHECK_EQUAL(output[0], 0xC08010u);
+    CHECK_EQUAL(output[1], 0xC08011u);
+    CHECK_EQUAL(output[2], 0xC18112u);
+    CHECK_EQUAL(output[3], 0xC18113u);
+    CHECK_EQUAL(output[4], 0xC08020u);
+    CHECK_EQUAL(output[7], 0xC18123u);
+
+    const uint8_t nv12[] = {0x10, 0x11, 0x12, 0x13,
+                            0x20, 0x21, 0x22, 0x23,
+                            0x80, 0xC0, 0x81, 0xC1};    //U V U V
+    PackNV12((uint8_t*)output, nv12, 4, 2, 16, 0, 2, 4, 0);
+    CHECK_EQUAL(output[0], 0xC08010u);
+    CHECK_EQUAL(output[3], 0xC18113u);
+    CHECK_EQUAL(output[6], 0xC18122u);
+
+    //10 bit samples at the top of each 16 bit word, only the high byte is kept
+    const uint16_t p010[] = {0x1040, 0x1140, 0x12C0, 0x13FF,
+                             0x2000, 0x2140, 0x2280, 0x23C0,
+                             0x8040, 0xC0C0, 0x81FF, 0xC100};
+    PackP010((uint8_t*)output, (const uint8_t*)p010, 4, 2, 16, 0, 2, 8, 0);
+    CHECK_EQUAL(output[0], 0xC08010u);
+    CHECK_EQUAL(output[3], 0xC18113u);
+    CHECK_EQUAL(output[5], 0xC08021u);
+
+    //YUY2 Y0 U Y1 V, then UYVY U Y0 V Y1
+    const uint32_t yuy2[] = {0xC0208010, 0xC1218111};
+    Convert422Line(output, yuy2, 2, true);
+    CHECK_EQUAL(output[0], 0xC0208010u);
+    CHECK_EQUAL(output[1], 0xC0208020u);
+    CHECK_EQUAL(output[2], 0xC1218111u);
+    CHECK_EQUAL(output[3], 0xC1218121u);
+
+    const uint32_t uyvy[] = {0x20C01080, 0x21C11181};
+    Convert422Line(output, uyvy, 2, false);
+    CHECK_EQUAL(output[0], 0x20C01080u);
+    CHECK_EQUAL(output[1], 0x20C02080u);
+    CHECK_EQUAL(output[3], 0x21C12181u);
+}
+
+static void Check420(std::mt19937 &rng, int format, UINT width, UINT height, UINT startY, UINT endY, UINT lineShift, UINT outputPadding)
+{
+    UINT bytesPerSample = (format == 2) ? 2 : 1;
+    UINT linePitch = width*bytesPerSample;
+    UINT pitch = width*4 + outputPadding;
+
+    std::vector<uint8_t> input(lineShift + width*height*bytesPerSample*3/2 + 64);
+    for(size_t i=0; i<input.size(); i++)
+        input[i] = uint8_t(rng());
+
+    std::vector<uint32_t> expected(pitch/4*height, guardValue), output(pitch/4*height, guardValue);
+
+    ReferencePack420(format, (uint8_t*)&expected[0], &input[0], width, height, pitch, startY, endY, linePitch, lineShift);
+    PackFormat(format, (uint8_t*)&output[0], &input[0], width, height, pitch, startY, endY, linePitch, lineShift);
+
+    if(output != expected)
+    {
+        fprintf(stderr, "format %d, %ux%u, lines %u to %u, shift %u, padding %u\n", format, width, height, startY, endY, lineShift, outputPadding);
+        CHECK(output == expected);
+    }
+}
+
+static void Check422(std::mt19937 &rng, UINT count, bool bLeadingY)
+{
+    std::vector<uint32_t> input(count+1);
+    for(size_t i=0; i<input.size(); i++)
+        input[i] = rng();
+
+    std::vector<uint32_t> expected(count*2+8, guardValue), output(count*2+8, guardValue);
+
+    ReferenceConvert422Line(&expected[0], &input[0], count, bLeadingY);
+    Convert422Line(&output[0], &input[0], count, bLeadingY);
+
+    if(output != expected)
+    {
+        fprintf(stderr, "4:2:2, %u macropixels, %s\n", count, bLeadingY ? "leading Y" : "leading chroma");
+        CHECK(output == expected);
+    }
+}
+
+static void CheckKernels()
+{
+    std::mt19937 rng(0x4D41444E);
+
+    CheckWorkedFrames();
+
+    const UINT widths[] = {2, 4, 14, 16, 18, 30, 32, 34, 62, 64, 66, 126, 1280, 1920};
+
+    for(int format=0; format<3; format++)
+    {
+        for(UINT i=0; i<sizeof(widths)/sizeof(widths[0]); i++)
+        {
+            Check420(rng, format, widths[i], 6, 0, 6, 0, 0);
+            Check420(rng, format, widths[i], 6, 0, 6, 2, 12);   //shifted input, padded output lines
+            Check420(rng, format, widths[i], 8, 2, 6, 0, 4);    //the range one conversion thread gets
+            Check420(rng, format, widths[i], 8, 3, 7, 0, 0);    //odd ranges round down to line pairs
+        }
+
+        Check420(rng, format, 1920, 1080, 0, 1080, 0, 0);
+    }
+
+    for(UINT count=0; count<=70; count++)
+    {
+        Check422(rng, count, true);
+        Check422(rng, count, false);
+    }
+    Check422(rng, 960, true);
+    Check422(rng, 960, false);
+}
+
+int main()
+{
+    bool bAVX2 = EnableImageMadnessAVX2(true);
+    printf("checking the %s kernels\n", bAVX2 ? "AVX2" : "SSE2");
+    CheckKernels();
+
+    if(bAVX2)
+    {
+        EnableImageMadnessAVX2(false);
+        printf("checking the SSE2 kernels\n");
+        CheckKernels();
+    }
+
+    return TestResult("ImageMadnessTest");
+}
@@ -0,0 +1,513 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "IngestServer.h"
+#include "../../Source/LatencyProbe.h"
+
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+typedef int socklen_t;
+#define SHUT_RDWR SD_BOTH
+#else
+#include <netinet/tcp.h>
+#include <signal.h>
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+const QWORD maxLinkBurst = 100;    //ms
+const QWORD maxLinkWait = 2000;     //ms, the longest one read can hold the link for
+const UINT linkWaitStep = 20;       //ms, how often a shaping wait checks for a drop
+
+#define SAVC(x) static const AVal av_##x = {(char*)#x, sizeof(#x)-1}
+#define SAVS(name, str) static const AVal av_##name = {(char*)str, sizeof(str)-1}
+
+SAVC(connect);
+SAVC(createStream);
+SAVC(publish);
+SAVC(onStatus);
+SAVC(_result);
+SAVC(fmsVer);
+SAVC(capabilities);
+SAVC(mode);
+SAVC(level);
+SAVC(code);
+SAVC(description);
+SAVC(status);
+SAVS(serverVersion, "FMS/3,5,7,7009");
+SAVS(connectSuccess, "NetConnection.Connect.Success");
+SAVS(connectDescription, "Connection succeeded.");
+SAVS(publishStart, "NetStream.Publish.Start");
+SAVS(publishDescription, "Started publishing.");
+
+static const int streamID = 1;
+
+
+IngestServer::IngestServer()
+    : listenSocket(INVALID_SOCKET), port(0), bStopping(false), readRate(0), receiveBufferSize(0)
+{
+#ifdef _WIN32
+    WSADATA wsad;
+    WSAStartup(MAKEWORD(2, 2), &wsad);
+#else
+    //a peer going away should fail the write, not end the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    ResetStats();
+}
+
+IngestServer::~IngestServer()
+{
+    Stop();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool IngestServer::Start(WORD newPort)
+{
+    if(listenSocket != INVALID_SOCKET)
+        return false;
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(listenSocket == INVALID_SOCKET)
+        return false;
+
+    int on = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+
+    //accepted sockets inherit this, it has to be set before listening for the window to follow it
+    if(receiveBufferSize)
+        setsockopt(listenSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&receiveBufferSize, sizeof(receiveBufferSize));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(newPort);
+
+    socklen_t addrLen = sizeof(addr);
+    if(bind(listenSocket, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+       listen(listenSocket, 8) != 0 ||
+       getsockname(listenSocket, (sockaddr*)&addr, &addrLen) != 0)
+    {
+        closesocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+        return false;
+    }
+
+    port = ntohs(addr.sin_port);
+
+    bStopping = false;
+    acceptThread = std::thread(&IngestServer::AcceptLoop, this);
+    return true;
+}
+
+void IngestServer::Stop()
+{
+    if(listenSocket == INVALID_SOCKET)
+        return;
+
+    bStopping = true;
+    acceptThread.join();
+
+    closesocket(listenSocket);
+    listenSocket = INVALID_SOCKET;
+
+    DropConnections();
+}
+
+void IngestServer::DropConnections()
+{
+    std::lock_guard<std::mutex> lock(connectionMutex);
+
+    //the connection threads close their own sockets, this only wakes them up
+    for(std::list<Connection>::iterator it = connections.begin(); it != connections.end(); ++it)
+    {
+        it->bDrop = true;
+        shutdown(it->socket, SHUT_RDWR);
+    }
+
+    ReapConnections(true);
+}
+
+//connectionMutex has to be held
+void IngestServer::ReapConnections(bool bAll)
+{
+    std::list<Connection>::iterator it = connections.begin();
+    while(it != connections.end())
+    {
+        if(bAll || it->bFinished)
+        {
+            it->thread.join();
+            it = connections.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void IngestServer::AcceptLoop()
+{
+    while(!bStopping)
+    {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(listenSocket, &readSet);
+
+        timeval timeout = {0, 50000};
+        if(select(int(listenSocket)+1, &readSet, NULL, NULL, &timeout) <= 0)
+            continue;
+
+        SOCKET clientSocket = accept(listenSocket, NULL, NULL);
+        if(clientSocket == INVALID_SOCKET)
+            continue;
+
+        int on = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        ReapConnections(false);
+
+        connections.emplace_back();
+        Connection *connection = &connections.back();
+        connection->socket = clientSocket;
+        connection->bDrop = false;
+        connection->bFinished = false;
+        connection->thread = std::thread(&IngestServer::ConnectionLoop, this, connection);
+    }
+}
+
+void IngestServer::ConnectionLoop(Connection *connection)
+{
+    RTMP *rtmp = RTMP_Alloc();
+    RTMP_Init(rtmp);
+    rtmp->m_sb.sb_socket = connection->socket;
+
+    if(RTMP_Serve(rtmp))
+    {
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            stats.numConnections++;
+        }
+
+        //microseconds up to which the shaped link is busy, and what had been read when it was last advanced
+        QWORD linkTime = TestTimeNS()/1000;
+        UINT linkBytesIn = 0;
+
+        RTMPPacket packet;
+        memset(&packet, 0, sizeof(packet));
+
+        while(RTMP_IsConnected(rtmp) && !connection->bDrop)
+        {
+            //only block in librtmp once there's data, so a drop is noticed even if the socket stays quiet
+            if(!rtmp->m_sb.sb_size)
+            {
+                fd_set readSet;
+                FD_ZERO(&readSet);
+                FD_SET(connection->socket, &readSet);
+
+                timeval timeout = {0, 50000};
+                int ret = select(int(connection->socket)+1, &readSet, NULL, NULL, &timeout);
+                if(ret == 0)
+                    continue;
+                else if(ret < 0)
+                    break;
+            }
+
+            if(!RTMP_ReadPacket(rtmp, &packet))
+                break;
+
+            if(!RTMPPacket_IsReady(&packet))
+                continue;
+
+            bool bKeepGoing = true;
+
+            switch(packet.m_packetType)
+            {
+                case RTMP_PACKET_TYPE_CHUNK_SIZE:
+                    if(packet.m_nBodySize >= 4)
+                        rtmp->m_inChunkSize = (int)AMF_DecodeInt32(packet.m_body);
+                    break;
+
+                case RTMP_PACKET_TYPE_INVOKE:
+                    bKeepGoing = HandleInvoke(rtmp, packet.m_body, packet.m_nBodySize);
+                    break;
+
+                case RTMP_PACKET_TYPE_VIDEO:
+                    HandleVideo((const BYTE*)packet.m_body, packet.m_nBodySize, packet.m_nTimeStamp);
+                    break;
+
+                case RTMP_PACKET_TYPE_AUDIO:
+                {
+                    std::lock_guard<std::mutex> lock(statsMutex);
+                    QWORD curTime = TestTimeMS();
+                    if(!stats.firstMediaTime)
+                        stats.firstMediaTime = curTime;
+                    stats.lastMediaTime = curTime;
+                    stats.numAudioPackets++;
+                    stats.numMediaBytes += packet.m_nBodySize;
+                    break;
+                }
+            }
+
+            RTMPPacket_Free(&packet);
+
+            if(!bKeepGoing || !RTMP_IsConnected(rtmp))
+                break;
+
+            //act as a link of limited speed by not reading ahead of it.  time the link sat idle only buys a
+            //short burst, otherwise a slow start would let it run far over its rate later on
+            UINT rate = readRate;
+            if(rate)
+            {
+                QWORD curTime = TestTimeNS()/1000;
+                if(linkTime + maxLinkBurst*1000 < curTime)
+                    linkTime = curTime - maxLinkBurst*1000;
+
+                //librtmp resets its count when it closes the connection
+                UINT bytesIn = UINT(rtmp->m_nBytesIn);
+                if(bytesIn < linkBytesIn)
+                    linkBytesIn = bytesIn;
+
+                linkTime += QWORD(bytesIn-linkBytesIn)*8000/rate;
+                linkBytesIn = bytesIn;
+
+                if(linkTime > curTime + maxLinkWait*1000)
+                    linkTime = curTime + maxLinkWait*1000;
+
+                //wait in steps so a drop or stop doesn't have to sit out the whole wait
+                while(linkTime > curTime+1000 && !connection->bDrop && !bStopping)
+                {
+                    TestSleep(UINT(std::min<QWORD>((linkTime-curTime)/1000, linkWaitStep)));
+                    curTime = TestTimeNS()/1000;
+                }
+            }
+        }
+
+        RTMPPacket_Free(&packet);
+    }
+
+    RTMP_Close(rtmp);
+    RTMP_Free(rtmp);
+
+    connection->bFinished = true;
+}
+
+static void SendInvokePacket(RTMP *rtmp, char *pbuf, char *enc, int channel, int infoField2)
+{
+    RTMPPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.m_nChannel = channel;
+    packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+    packet.m_packetType = RTMP_PACKET_TYPE_INVOKE;
+    packet.m_nInfoField2 = infoField2;
+    packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
+    packet.m_nBodySize = UINT(enc-packet.m_body);
+
+    RTMP_SendPacket(rtmp, &packet, FALSE);
+}
+
+static char* EncodeStatusObject(char *enc, char *pend, const AVal *code, const AVal *description)
+{
+    *enc++ = AMF_OBJECT;
+    enc = AMF_EncodeNamedString(enc, pend, &av_level, &av_status);
+    enc = AMF_EncodeNamedString(enc, pend, &av_code, code);
+    enc = AMF_EncodeNamedString(enc, pend, &av_description, description);
+    *enc++ = 0;
+    *enc++ = 0;
+    *enc++ = AMF_OBJECT_END;
+    return enc;
+}
+
+bool IngestServer::HandleInvoke(RTMP *rtmp, const char *body, UINT size)
+{
+    if(!size || body[0] != AMF_STRING)
+        return true;
+
+    AMFObject obj;
+    if(AMF_Decode(&obj, body, int(size), FALSE) < 0)
+        return false;
+
+    AVal method;
+    AMFProp_GetString(AMF_GetProp(&obj, NULL, 0), &method);
+    double txn = AMFProp_GetNumber(AMF_GetProp(&obj, NULL, 1));
+
+    char pbuf[512], *pend = pbuf+sizeof(pbuf);
+    char *enc = pbuf+RTMP_MAX_HEADER_SIZE;
+
+    if(AVMATCH(&method, &av_connect))
+    {
+        RTMP_SendServerBW(rtmp);
+
+        enc = AMF_EncodeString(enc, pend, &av__result);
+        enc = AMF_EncodeNumber(enc, pend, txn);
+        *enc++ = AMF_OBJECT;
+        enc = AMF_EncodeNamedString(enc, pend, &av_fmsVer, &av_serverVersion);
+        enc = AMF_EncodeNamedNumber(enc, pend, &av_capabilities, 31.0);
+        enc = AMF_EncodeNamedNumber(enc, pend, &av_mode, 1.0);
+        *enc++ = 0;
+        *enc++ = 0;
+        *enc++ = AMF_OBJECT_END;
+        enc = EncodeStatusObject(enc, pend, &av_connectSuccess, &av_connectDescription);
+
+        SendInvokePacket(rtmp, pbuf, enc, 0x03, 0);
+    }
+    else if(AVMATCH(&method, &av_createStream))
+    {
+        enc = AMF_EncodeString(enc, pend, &av__result);
+        enc = AMF_EncodeNumber(enc, pend, txn);
+        *enc++ = AMF_NULL;
+        enc = AMF_EncodeNumber(enc, pend, double(streamID));
+
+        SendInvokePacket(rtmp, pbuf, enc, 0x03, 0);
+    }
+    else if(AVMATCH(&method, &av_publish))
+    {
+        enc = AMF_EncodeString(enc, pend, &av_onStatus);
+        enc = AMF_EncodeNumber(enc, pend, 0.0);
+        *enc++ = AMF_NULL;
+        enc = EncodeStatusObject(enc, pend, &av_publishStart, &av_publishDescription);
+
+        SendInvokePacket(rtmp, pbuf, enc, 0x05, streamID);
+
+        AVal name;
+        AMFProp_GetString(AMF_GetProp(&obj, NULL, 3), &name);
+        bool bBandwidthTest = name.av_len && std::string(name.av_val, name.av_len).find("bandwidthtest=true") != std::string::npos;
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.numPublishes++;
+        if(bBandwidthTest)
+            stats.numBandwidthTests++;
+        stats.lastPublishTime = TestTimeMS();
+        stats.firstVideoTime = 0;
+        stats.numPublishVideoPackets = 0;
+        statsChanged.notify_all();
+    }
+    else if(txn > 0.0)
+    {
+        //releaseStream, FCPublish and friends, nothing to do but acknowledge them
+        enc = AMF_EncodeString(enc, pend, &av__result);
+        enc = AMF_EncodeNumber(enc, pend, txn);
+        *enc++ = AMF_NULL;
+        *enc++ = AMF_UNDEFINED;
+
+        SendInvokePacket(rtmp, pbuf, enc, 0x03, 0);
+    }
+
+    AMF_Reset(&obj);
+    return true;
+}
+
+void IngestServer::HandleVideo(const BYTE *body, UINT size, DWORD timestamp)
+{
+    QWORD curTime = TestTimeMS();
+    QWORD curUnixTime = TestUnixTimeMS();
+
+    bool bKeyframe = size && (body[0] >> 4) == 1;
+
+    //AVC NALUs (avc packet type 1) carry length prefixed nals after the 5 byte video tag header
+    QWORD probeTime = 0;
+    bool bFoundProbe = false;
+
+    if(size > 5 && (body[0] & 0x0F) == 7 && body[1] == 1)
+    {
+        UINT pos = 5;
+        while(pos+4 <= size)
+        {
+            UINT nalSize = UINT(body[pos]) << 24 | UINT(body[pos+1]) << 16 | UINT(body[pos+2]) << 8 | UINT(body[pos+3]);
+            pos += 4;
+            if(nalSize > size-pos)
+                break;
+
+            if(!bFoundProbe && ReadLatencyProbeNAL(body+pos, nalSize, probeTime))
+                bFoundProbe = true;
+
+            pos += nalSize;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+
+    if(!stats.firstMediaTime)
+        stats.firstMediaTime = curTime;
+    stats.lastMediaTime = curTime;
+
+    if(!stats.firstVideoTime)
+        stats.firstVideoTime = curTime;
+
+    stats.numVideoPackets++;
+    stats.numPublishVideoPackets++;
+    stats.numMediaBytes += size;
+    stats.lastVideoTimestamp = timestamp;
+    if(bKeyframe)
+        stats.numKeyframes++;
+
+    if(bFoundProbe)
+    {
+        double latency = double(INT64(curUnixTime-probeTime));
+
+        if(stats.numProbes)
+        {
+            if(latency < stats.minLatency) stats.minLatency = latency;
+            if(latency > stats.maxLatency) stats.maxLatency = latency;
+
+            double difference = latency-stats.lastLatency;
+            if(difference < 0.0)
+                difference = -difference;
+            stats.jitter += (difference-stats.jitter)/16.0;
+        }
+        else
+            stats.minLatency = stats.maxLatency = latency;
+
+        stats.lastLatency = latency;
+        stats.totalLatency += latency;
+        stats.numProbes++;
+    }
+
+    statsChanged.notify_all();
+}
+
+IngestStats IngestServer::GetStats()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return stats;
+}
+
+void IngestServer::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool IngestServer::WaitForVideo(UINT numPackets, UINT timeoutMS)
+{
+    std::unique_lock<std::mutex> lock(statsMutex);
+    return statsChanged.wait_for(lock, std::chrono::milliseconds(timeoutMS), [&] {return stats.numPublishVideoPackets >= numPackets;});
+}
+
+bool IngestServer::WaitForPublish(UINT numPublishes, UINT timeoutMS)
+{
+    std::unique_lock<std::mutex> lock(statsMutex);
+    return statsChanged.wait_for(lock, std::chrono::milliseconds(timeoutMS), [&] {return stats.numPublishes >= numPublishes;});
+}
@@ -0,0 +1,126 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+#include "../TestCommon.h"
+
+#include "rtmp.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+
+//-------------------------------------------
+// a minimal local RTMP ingest built on librtmp's server side (RTMP_Serve/RTMP_ReadPacket).  it accepts a
+// publish, records when media arrives and reads the latency probe SEI that RTMPPublisher can embed, so
+// streaming can be tested and benchmarked without a live service.  it can throttle how fast it reads to
+// act as a shaped link, drop its connections to force a reconnect, or be stopped and started again to
+// act like an ingest restarting.
+
+struct IngestStats
+{
+    UINT numConnections;            //connections that completed the handshake
+    UINT numPublishes;              //connections that started publishing
+    UINT numBandwidthTests;         //publishes marked with bandwidthtest=true, which a real ingest discards
+
+    UINT numVideoPackets;
+    UINT numAudioPackets;
+    UINT numKeyframes;
+    QWORD numMediaBytes;
+
+    QWORD firstMediaTime;           //TestTimeMS() of the first and latest media packet
+    QWORD lastMediaTime;
+    QWORD lastPublishTime;          //when the latest publish started
+    QWORD firstVideoTime;           //first video packet of the latest publish
+    UINT numPublishVideoPackets;    //video packets of the latest publish
+    DWORD lastVideoTimestamp;       //stream timestamp of the latest video packet
+
+    //glass-to-ingest latency from the probe SEI, in milliseconds
+    UINT numProbes;
+    double minLatency, maxLatency, totalLatency, lastLatency;
+    double jitter;                  //smoothed latency variation, the same estimator RTP uses
+
+    inline double AverageLatency() const {return numProbes ? totalLatency/double(numProbes) : 0.0;}
+
+    //average media bitrate in kbps
+    inline double MediaBitrate() const
+    {
+        QWORD duration = lastMediaTime-firstMediaTime;
+        return duration ? double(numMediaBytes)*8.0/double(duration) : 0.0;
+    }
+};
+
+class IngestServer
+{
+    struct Connection
+    {
+        SOCKET socket;
+        std::thread thread;
+        std::atomic<bool> bDrop, bFinished;
+    };
+
+    SOCKET listenSocket;
+    WORD port;
+    std::thread acceptThread;
+    std::atomic<bool> bStopping;
+
+    std::mutex connectionMutex;
+    std::list<Connection> connections;
+
+    std::mutex statsMutex;
+    std::condition_variable statsChanged;
+    IngestStats stats;
+
+    std::atomic<UINT> readRate;     //kbps, 0 for as fast as the data arrives
+    UINT receiveBufferSize;
+
+    void AcceptLoop();
+    void ConnectionLoop(Connection *connection);
+    void ReapConnections(bool bAll);
+
+    bool HandleInvoke(RTMP *rtmp, const char *body, UINT size);
+    void HandleVideo(const BYTE *body, UINT size, DWORD timestamp);
+
+public:
+    IngestServer();
+    ~IngestServer();
+
+    //listens on localhost, port 0 picks a free one
+    bool Start(WORD port=0);
+    //closes the listening socket and every connection, like the ingest going away
+    void Stop();
+    //closes the connections but keeps listening, like a connection dropping on the way to the ingest
+    void DropConnections();
+
+    inline WORD GetPort() const {return port;}
+
+    //throttles reads to act as a link of the given speed, the receive buffer is kept small so the
+    //sender feels it quickly.  the buffer size has to be set before Start.
+    inline void SetReadRate(UINT kbps) {readRate = kbps;}
+    inline void SetReceiveBufferSize(UINT size) {receiveBufferSize = size;}
+
+    IngestStats GetStats();
+    void ResetStats();
+
+    //waits until at least numPackets video packets arrived since the latest publish started
+    bool WaitForVideo(UINT numPackets, UINT timeoutMS);
+    bool WaitForPublish(UINT numPublishes, UINT timeoutMS);
+};
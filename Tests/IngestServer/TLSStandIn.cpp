@@ -0,0 +1,416 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+#include "TLSStandIn.h"
+
+
+#pragma comment(lib, "secur32.lib")
+#pragma comment(lib, "crypt32.lib")
+
+#define STANDIN_KEY_CONTAINER L"OBSTestTLSStandIn"
+
+const DWORD acceptFlags = ASC_REQ_SEQUENCE_DETECT | ASC_REQ_REPLAY_DETECT | ASC_REQ_CONFIDENTIALITY |
+                          ASC_REQ_ALLOCATE_MEMORY | ASC_REQ_STREAM;
+
+
+TLSStandIn::TLSStandIn()
+    : listenSocket(INVALID_SOCKET), port(0), backendPort(0), bStopping(false), bPaused(false), numHandshakes(0),
+      certificate(NULL), hCryptProv(0), bHaveCred(false)
+{
+    WSADATA wsad;
+    WSAStartup(MAKEWORD(2, 2), &wsad);
+}
+
+TLSStandIn::~TLSStandIn()
+{
+    Stop();
+
+    if(bHaveCred)
+        FreeCredentialsHandle(&cred);
+    if(certificate)
+        CertFreeCertificateContext(certificate);
+    if(hCryptProv)
+    {
+        CryptReleaseContext(hCryptProv, 0);
+        CryptAcquireContextW(&hCryptProv, STANDIN_KEY_CONTAINER, MS_ENH_RSA_AES_PROV_W, PROV_RSA_AES, CRYPT_DELETEKEYSET);
+    }
+
+    WSACleanup();
+}
+
+bool TLSStandIn::CreateCredentials()
+{
+    if(bHaveCred)
+        return true;
+
+    //a throwaway key and a self-signed certificate for 127.0.0.1
+    CryptAcquireContextW(&hCryptProv, STANDIN_KEY_CONTAINER, MS_ENH_RSA_AES_PROV_W, PROV_RSA_AES, CRYPT_DELETEKEYSET);
+    if(!CryptAcquireContextW(&hCryptProv, STANDIN_KEY_CONTAINER, MS_ENH_RSA_AES_PROV_W, PROV_RSA_AES, CRYPT_NEWKEYSET))
+    {
+        hCryptProv = 0;
+        return false;
+    }
+
+    HCRYPTKEY hKey;
+    if(!CryptGenKey(hCryptProv, AT_KEYEXCHANGE, (2048 << 16) | CRYPT_EXPORTABLE, &hKey))
+        return false;
+    CryptDestroyKey(hKey);
+
+    BYTE nameBuffer[256];
+    CERT_NAME_BLOB subject = {sizeof(nameBuffer), nameBuffer};
+    if(!CertStrToNameW(X509_ASN_ENCODING, L"CN=127.0.0.1", CERT_X500_NAME_STR, NULL, nameBuffer, &subject.cbData, NULL))
+        return false;
+
+    CRYPT_KEY_PROV_INFO keyProvInfo;
+    memset(&keyProvInfo, 0, sizeof(keyProvInfo));
+    keyProvInfo.pwszContainerName = STANDIN_KEY_CONTAINER;
+    keyProvInfo.pwszProvName = MS_ENH_RSA_AES_PROV_W;
+    keyProvInfo.dwProvType = PROV_RSA_AES;
+    keyProvInfo.dwKeySpec = AT_KEYEXCHANGE;
+
+    certificate = CertCreateSelfSignCertificate(hCryptProv, &subject, 0, &keyProvInfo, NULL, NULL, NULL, NULL);
+    if(!certificate)
+        return false;
+
+    SCHANNEL_CRED schannelCred;
+    memset(&schannelCred, 0, sizeof(schannelCred));
+    schannelCred.dwVersion = SCHANNEL_CRED_VERSION;
+    schannelCred.cCreds = 1;
+    schannelCred.paCred = &certificate;
+
+    if(AcquireCredentialsHandleW(NULL, UNISP_NAME_W, SECPKG_CRED_INBOUND, NULL, &schannelCred, NULL, NULL, &cred, NULL) != SEC_E_OK)
+        return false;
+
+    bHaveCred = true;
+    return true;
+}
+
+bool TLSStandIn::Start(WORD backendPort)
+{
+    Stop();
+
+    if(!CreateCredentials())
+    {
+        fprintf(stderr, "TLSStandIn: could not create the server certificate (%u)\n", GetLastError());
+        return false;
+    }
+
+    this->backendPort = backendPort;
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(listenSocket == INVALID_SOCKET)
+        return false;
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    int addrLen = sizeof(address);
+    if(bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 8) != 0 ||
+       getsockname(listenSocket, (sockaddr*)&address, &addrLen) != 0)
+    {
+        closesocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+        return false;
+    }
+
+    port = ntohs(address.sin_port);
+    bStopping = false;
+    acceptThread = std::thread(&TLSStandIn::AcceptLoop, this);
+    return true;
+}
+
+void TLSStandIn::Stop()
+{
+    if(listenSocket == INVALID_SOCKET)
+        return;
+
+    bStopping = true;
+    acceptThread.join();
+
+    closesocket(listenSocket);
+    listenSocket = INVALID_SOCKET;
+
+    ReapConnections(true);
+}
+
+void TLSStandIn::ReapConnections(bool bAll)
+{
+    std::lock_guard<std::mutex> lock(connectionMutex);
+
+    for(auto it = connections.begin(); it != connections.end();)
+    {
+        if(bAll || it->bFinished)
+        {
+            it->thread.join();
+            it = connections.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void TLSStandIn::AcceptLoop()
+{
+    while(!bStopping)
+    {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(listenSocket, &fds);
+
+        timeval tv = {0, 50000};
+        if(select(0, &fds, NULL, NULL, &tv) != 1)
+        {
+            ReapConnections(false);
+            continue;
+        }
+
+        SOCKET clientSocket = accept(listenSocket, NULL, NULL);
+        if(clientSocket == INVALID_SOCKET)
+            continue;
+
+        //small so that pausing stalls the client's sends quickly
+        int receiveBufferSize = 16*1024;
+        setsockopt(clientSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&receiveBufferSize, sizeof(receiveBufferSize));
+
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        connections.emplace_back();
+
+        Connection &connection = connections.back();
+        connection.clientSocket = clientSocket;
+        connection.backendSocket = INVALID_SOCKET;
+        connection.bHaveContext = false;
+        connection.bFinished = false;
+        connection.thread = std::thread(&TLSStandIn::ConnectionLoop, this, &connection);
+    }
+}
+
+bool TLSStandIn::Handshake(Connection *connection, std::vector<char> &recvBuffer)
+{
+    bool bNeedData = true;
+
+    for(;;)
+    {
+        if(bNeedData)
+        {
+            char buffer[16*1024];
+            int nBytes = recv(connection->clientSocket, buffer, sizeof(buffer), 0);
+            if(nBytes <= 0)
+                return false;
+
+            recvBuffer.insert(recvBuffer.end(), buffer, buffer+nBytes);
+        }
+
+        SecBuffer inBufs[2];
+        inBufs[0].BufferType = SECBUFFER_TOKEN;
+        inBufs[0].pvBuffer = recvBuffer.data();
+        inBufs[0].cbBuffer = (ULONG)recvBuffer.size();
+        inBufs[1].BufferType = SECBUFFER_EMPTY;
+        inBufs[1].pvBuffer = NULL;
+        inBufs[1].cbBuffer = 0;
+        SecBufferDesc inDesc = {SECBUFFER_VERSION, 2, inBufs};
+
+        SecBuffer outBufs[1];
+        outBufs[0].BufferType = SECBUFFER_TOKEN;
+        outBufs[0].pvBuffer = NULL;
+        outBufs[0].cbBuffer = 0;
+        SecBufferDesc outDesc = {SECBUFFER_VERSION, 1, outBufs};
+
+        DWORD retFlags;
+        SECURITY_STATUS status = AcceptSecurityContext(&cred, connection->bHaveContext ? &connection->context : NULL,
+            &inDesc, acceptFlags, 0, connection->bHaveContext ? NULL : &connection->context, &outDesc, &retFlags, NULL);
+
+        if(status == SEC_E_INCOMPLETE_MESSAGE)
+        {
+            bNeedData = true;
+            continue;
+        }
+
+        if(status == SEC_E_OK || status == SEC_I_CONTINUE_NEEDED)
+            connection->bHaveContext = true;
+
+        if(outBufs[0].pvBuffer)
+        {
+            bool bSent = outBufs[0].cbBuffer == 0 ||
+                send(connection->clientSocket, (const char*)outBufs[0].pvBuffer, outBufs[0].cbBuffer, 0) == int(outBufs[0].cbBuffer);
+            FreeContextBuffer(outBufs[0].pvBuffer);
+            if(!bSent)
+                return false;
+        }
+
+        if(FAILED(status))
+        {
+            fprintf(stderr, "TLSStandIn: handshake failed: 0x%08x\n", status);
+            return false;
+        }
+
+        if(inBufs[1].BufferType == SECBUFFER_EXTRA && inBufs[1].cbBuffer)
+            recvBuffer.erase(recvBuffer.begin(), recvBuffer.end()-inBufs[1].cbBuffer);
+        else
+            recvBuffer.clear();
+
+        if(status == SEC_E_OK)
+            return QueryContextAttributes(&connection->context, SECPKG_ATTR_STREAM_SIZES, &connection->sizes) == SEC_E_OK;
+
+        bNeedData = recvBuffer.empty();
+    }
+}
+
+bool TLSStandIn::SendRecord(Connection *connection, const char *data, UINT size)
+{
+    const SecPkgContext_StreamSizes &sizes = connection->sizes;
+
+    while(size)
+    {
+        UINT chunk = size;
+        if(chunk > sizes.cbMaximumMessage)
+            chunk = sizes.cbMaximumMessage;
+
+        std::vector<char> record(sizes.cbHeader + chunk + sizes.cbTrailer);
+        memcpy(record.data()+sizes.cbHeader, data, chunk);
+
+        SecBuffer bufs[4];
+        bufs[0].BufferType = SECBUFFER_STREAM_HEADER;
+        bufs[0].pvBuffer = record.data();
+        bufs[0].cbBuffer = sizes.cbHeader;
+        bufs[1].BufferType = SECBUFFER_DATA;
+        bufs[1].pvBuffer = record.data()+sizes.cbHeader;
+        bufs[1].cbBuffer = chunk;
+        bufs[2].BufferType = SECBUFFER_STREAM_TRAILER;
+        bufs[2].pvBuffer = record.data()+sizes.cbHeader+chunk;
+        bufs[2].cbBuffer = sizes.cbTrailer;
+        bufs[3].BufferType = SECBUFFER_EMPTY;
+        bufs[3].pvBuffer = NULL;
+        bufs[3].cbBuffer = 0;
+        SecBufferDesc desc = {SECBUFFER_VERSION, 4, bufs};
+
+        if(EncryptMessage(&connection->context, 0, &desc, 0) != SEC_E_OK)
+            return false;
+
+        int recordSize = int(bufs[0].cbBuffer + bufs[1].cbBuffer + bufs[2].cbBuffer);
+        if(send(connection->clientSocket, record.data(), recordSize, 0) != recordSize)
+            return false;
+
+        data += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+void TLSStandIn::ConnectionLoop(Connection *connection)
+{
+    std::vector<char> recvBuffer;
+
+    if(Handshake(connection, recvBuffer))
+    {
+        numHandshakes++;
+
+        connection->backendSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(backendPort);
+
+        bool bOpen = connect(connection->backendSocket, (sockaddr*)&address, sizeof(address)) == 0;
+
+        while(bOpen && !bStopping)
+        {
+            //decrypt whatever whole records are buffered and pass them on
+            while(recvBuffer.size() && !bPaused)
+            {
+                SecBuffer bufs[4];
+                bufs[0].BufferType = SECBUFFER_DATA;
+                bufs[0].pvBuffer = recvBuffer.data();
+                bufs[0].cbBuffer = (ULONG)recvBuffer.size();
+                for(int i=1; i<4; i++)
+                {
+                    bufs[i].BufferType = SECBUFFER_EMPTY;
+                    bufs[i].pvBuffer = NULL;
+                    bufs[i].cbBuffer = 0;
+                }
+                SecBufferDesc desc = {SECBUFFER_VERSION, 4, bufs};
+
+                SECURITY_STATUS status = DecryptMessage(&connection->context, &desc, 0, NULL);
+                if(status == SEC_E_INCOMPLETE_MESSAGE)
+                    break;
+
+                if(status != SEC_E_OK)
+                {
+                    bOpen = false;
+                    break;
+                }
+
+                UINT extraSize = 0;
+                for(int i=1; i<4; i++)
+                {
+                    if(bufs[i].BufferType == SECBUFFER_DATA && bufs[i].cbBuffer)
+                    {
+                        if(send(connection->backendSocket, (const char*)bufs[i].pvBuffer, bufs[i].cbBuffer, 0) != int(bufs[i].cbBuffer))
+                            bOpen = false;
+                    }
+                    else if(bufs[i].BufferType == SECBUFFER_EXTRA)
+                        extraSize = bufs[i].cbBuffer;
+                }
+
+                recvBuffer.erase(recvBuffer.begin(), recvBuffer.end()-extraSize);
+            }
+
+            fd_set fds;
+            FD_ZERO(&fds);
+            if(!bPaused)
+                FD_SET(connection->clientSocket, &fds);
+            FD_SET(connection->backendSocket, &fds);
+
+            timeval tv = {0, 50000};
+            if(select(0, &fds, NULL, NULL, &tv) <= 0)
+                continue;
+
+            char buffer[16*1024];
+
+            if(FD_ISSET(connection->clientSocket, &fds))
+            {
+                int nBytes = recv(connection->clientSocket, buffer, sizeof(buffer), 0);
+                if(nBytes <= 0)
+                    break;
+
+                recvBuffer.insert(recvBuffer.end(), buffer, buffer+nBytes);
+            }
+
+            if(FD_ISSET(connection->backendSocket, &fds))
+            {
+                int nBytes = recv(connection->backendSocket, buffer, sizeof(buffer), 0);
+                if(nBytes <= 0 || !SendRecord(connection, buffer, nBytes))
+                    break;
+            }
+        }
+    }
+
+    if(connection->backendSocket != INVALID_SOCKET)
+        closesocket(connection->backendSocket);
+    closesocket(connection->clientSocket);
+
+    if(connection->bHaveContext)
+        DeleteSecurityContext(&connection->context);
+
+    connection->bFinished = true;
+}
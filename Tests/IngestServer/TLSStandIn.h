@@ -0,0 +1,85 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+#include "../TestCommon.h"
+
+#define SECURITY_WIN32
+#include <security.h>
+#include <schannel.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <vector>
+
+//-------------------------------------------
+// windows only:  a TLS terminating proxy in front of the local ingest, built on the SChannel server side
+// with a self-signed certificate, so the rtmps:// path of librtmp (tls_sspi.c) can be tested without a
+// live service.  librtmp has to be built with TLS_SSPI_NO_VALIDATION to accept the certificate.  it can
+// stop reading from the client to stall its sends.
+
+class TLSStandIn
+{
+    struct Connection
+    {
+        SOCKET clientSocket, backendSocket;
+        CtxtHandle context;
+        bool bHaveContext;
+        SecPkgContext_StreamSizes sizes;
+        std::thread thread;
+        std::atomic<bool> bFinished;
+    };
+
+    SOCKET listenSocket;
+    WORD port, backendPort;
+    std::thread acceptThread;
+    std::atomic<bool> bStopping, bPaused;
+    std::atomic<UINT> numHandshakes;
+
+    PCCERT_CONTEXT certificate;
+    HCRYPTPROV hCryptProv;
+    CredHandle cred;
+    bool bHaveCred;
+
+    std::mutex connectionMutex;
+    std::list<Connection> connections;
+
+    bool CreateCredentials();
+    void AcceptLoop();
+    void ConnectionLoop(Connection *connection);
+    bool Handshake(Connection *connection, std::vector<char> &recvBuffer);
+    bool SendRecord(Connection *connection, const char *data, UINT size);
+    void ReapConnections(bool bAll);
+
+public:
+    TLSStandIn();
+    ~TLSStandIn();
+
+    //listens on a free localhost port and forwards the decrypted stream to backendPort
+    bool Start(WORD backendPort);
+    void Stop();
+
+    inline WORD GetPort() const {return port;}
+    inline UINT NumHandshakes() const {return numHandshakes;}
+
+    //stops reading from clients, so their sends back up until their socket buffers are full
+    inline void SetPaused(bool bPause) {bPaused = bPause;}
+};
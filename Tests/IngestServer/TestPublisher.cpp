@@ -0,0 +1,188 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "TestPublisher.h"
+#include "../../Source/LatencyProbe.h"
+
+#ifdef _WIN32
+typedef int socklen_t;
+#else
+#include <signal.h>
+#endif
+
+
+TestPublisher::TestPublisher()
+    : rtmp(NULL), playPath("test"), bTLS(false)
+{
+#ifdef _WIN32
+    WSADATA wsad;
+    WSAStartup(MAKEWORD(2, 2), &wsad);
+#else
+    //a peer going away should fail the write, not end the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+TestPublisher::~TestPublisher()
+{
+    Close();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool TestPublisher::Setup(WORD port)
+{
+    Close();
+
+    //librtmp points into these instead of copying them
+    sprintf(url, "%s://127.0.0.1:%u/live", bTLS ? "rtmps" : "rtmp", UINT(port));
+
+    rtmp = RTMP_Alloc();
+    RTMP_Init(rtmp);
+
+    if(!RTMP_SetupURL2(rtmp, url, &playPath[0]))
+    {
+        Close();
+        return false;
+    }
+
+    RTMP_EnableWrite(rtmp);
+
+    rtmp->Link.timeout = 5;
+    rtmp->m_outChunkSize = 4096;
+    rtmp->m_bSendChunkSizeInfo = TRUE;
+    rtmp->m_bUseNagle = FALSE;
+    return true;
+}
+
+bool TestPublisher::Connect(WORD port, bool bPublish)
+{
+    if(!Setup(port) || !RTMP_Connect(rtmp, NULL))
+        return false;
+
+    return !bPublish || Publish();
+}
+
+bool TestPublisher::ConnectToAddress(WORD port, const sockaddr_in &address, bool bPublish)
+{
+    if(!Setup(port))
+        return false;
+
+    sockaddr_in service = address;
+    if(!RTMP_Connect0(rtmp, (sockaddr*)&service))
+        return false;
+
+    rtmp->m_bSendCounter = TRUE;
+
+    if(!RTMP_Connect1(rtmp, NULL))
+        return false;
+
+    return !bPublish || Publish();
+}
+
+bool TestPublisher::Publish()
+{
+    return rtmp && RTMP_ConnectStream(rtmp, 0) != 0;
+}
+
+void TestPublisher::Close()
+{
+    if(rtmp)
+    {
+        RTMP_Close(rtmp);
+        RTMP_Free(rtmp);
+        rtmp = NULL;
+    }
+}
+
+bool TestPublisher::GetPeerAddress(sockaddr_in &address)
+{
+    socklen_t addrLen = sizeof(address);
+    return rtmp && getpeername(rtmp->m_sb.sb_socket, (sockaddr*)&address, &addrLen) == 0;
+}
+
+bool TestPublisher::SendVideo(DWORD timestamp, bool bKeyframe, UINT payloadSize, QWORD probeTime)
+{
+    if(!rtmp)
+        return false;
+
+    packetBuffer.resize(RTMP_MAX_HEADER_SIZE + 5 + LATENCY_PROBE_NAL_MAX + 4 + payloadSize + 1);
+
+    BYTE *body = (BYTE*)&packetBuffer[RTMP_MAX_HEADER_SIZE];
+    UINT size = 0;
+
+    body[size++] = bKeyframe ? 0x17 : 0x27;     //frame type, AVC
+    body[size++] = 1;                           //AVC NALU
+    body[size++] = 0;                           //composition time
+    body[size++] = 0;
+    body[size++] = 0;
+
+    if(probeTime)
+        size += WriteLatencyProbeNAL(body+size, probeTime);
+
+    UINT nalSize = payloadSize+1;
+    body[size++] = BYTE(nalSize >> 24);
+    body[size++] = BYTE(nalSize >> 16);
+    body[size++] = BYTE(nalSize >> 8);
+    body[size++] = BYTE(nalSize);
+    body[size++] = bKeyframe ? 0x65 : 0x41;     //IDR or non-IDR slice
+    memset(body+size, 0x5A, payloadSize);
+    size += payloadSize;
+
+    RTMPPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.m_nChannel = 0x04;
+    packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+    packet.m_packetType = RTMP_PACKET_TYPE_VIDEO;
+    packet.m_nTimeStamp = timestamp;
+    packet.m_nInfoField2 = rtmp->m_stream_id;
+    packet.m_hasAbsTimestamp = TRUE;
+    packet.m_nBodySize = size;
+    packet.m_body = (char*)body;
+
+    return RTMP_SendPacket(rtmp, &packet, FALSE) != 0;
+}
+
+bool TestPublisher::SendAudio(DWORD timestamp, UINT payloadSize)
+{
+    if(!rtmp)
+        return false;
+
+    packetBuffer.resize(RTMP_MAX_HEADER_SIZE + 2 + payloadSize);
+
+    BYTE *body = (BYTE*)&packetBuffer[RTMP_MAX_HEADER_SIZE];
+    body[0] = 0xAF; //AAC, 44.1khz, 16 bit, stereo
+    body[1] = 1;    //raw AAC frame
+    memset(body+2, 0x21, payloadSize);
+
+    RTMPPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.m_nChannel = 0x05;
+    packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+    packet.m_packetType = RTMP_PACKET_TYPE_AUDIO;
+    packet.m_nTimeStamp = timestamp;
+    packet.m_nInfoField2 = rtmp->m_stream_id;
+    packet.m_hasAbsTimestamp = TRUE;
+    packet.m_nBodySize = 2+payloadSize;
+    packet.m_body = (char*)body;
+
+    return RTMP_SendPacket(rtmp, &packet, FALSE) != 0;
+}
@@ -0,0 +1,68 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+#include "../TestCommon.h"
+
+#include "rtmp.h"
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------
+// publishes synthetic FLV framed AVC/AAC packets through librtmp the same way RTMPPublisher does (same
+// connection setup, chunk size and channels), for driving the ingest server from tests and benchmarks.
+
+class TestPublisher
+{
+    RTMP *rtmp;
+    char url[64];
+    std::string playPath;
+    bool bTLS;
+    std::vector<char> packetBuffer;
+
+    bool Setup(WORD port);
+
+public:
+    TestPublisher();
+    ~TestPublisher();
+
+    //stream name for the next connect, "test" by default
+    inline void SetPlayPath(const char *path) {playPath = path;}
+    //connect with rtmps:// instead of rtmp://
+    inline void SetTLS(bool bEnable) {bTLS = bEnable;}
+
+    //full connect, resolving the host first
+    bool Connect(WORD port, bool bPublish=true);
+    //connects straight to an address from an earlier connection, the way a fast reconnect does
+    bool ConnectToAddress(WORD port, const sockaddr_in &address, bool bPublish=true);
+    //publishes on an already handshaked connection, the way a standby connection is used
+    bool Publish();
+    void Close();
+
+    bool GetPeerAddress(sockaddr_in &address);
+
+    //a video packet with a single NAL of payloadSize bytes, led by a latency probe SEI when probeTime is set
+    bool SendVideo(DWORD timestamp, bool bKeyframe, UINT payloadSize, QWORD probeTime=0);
+    bool SendAudio(DWORD timestamp, UINT payloadSize);
+
+    inline RTMP* GetRTMP() {return rtmp;}
+    inline bool IsConnected() {return rtmp && RTMP_IsConnected(rtmp);}
+};
@@ -0,0 +1,107 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// standalone ingest for testing OBS itself:  point the stream at rtmp://127.0.0.1:<port>/live with
+// Publish/LatencyProbe=1 set and it prints throughput, glass-to-ingest latency and jitter every second.
+
+#include "IngestServer.h"
+
+static void PrintUsage()
+{
+    printf("usage: IngestServer [options]\n"
+           "  -port <n>        port to listen on (default 1935)\n"
+           "  -rate <kbps>     read no faster than this, to act as a shaped link\n"
+           "  -rcvbuf <bytes>  socket receive buffer size\n"
+           "  -drop <ms>       drop the connection this often to exercise reconnects\n"
+           "  -duration <s>    exit after this many seconds\n");
+}
+
+int main(int argc, char **argv)
+{
+    UINT port = 1935, rate = 0, receiveBuffer = 0, dropInterval = 0, duration = 0;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(i+1 >= argc)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if(strcmp(argv[i], "-port") == 0)           port = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-rate") == 0)      rate = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-rcvbuf") == 0)    receiveBuffer = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-drop") == 0)      dropInterval = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-duration") == 0)  duration = atoi(argv[++i]);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    IngestServer server;
+    server.SetReadRate(rate);
+    server.SetReceiveBufferSize(receiveBuffer);
+
+    if(!server.Start(WORD(port)))
+    {
+        fprintf(stderr, "could not listen on port %u\n", port);
+        return 1;
+    }
+
+    printf("listening on rtmp://127.0.0.1:%u/live\n", UINT(server.GetPort()));
+    fflush(stdout);
+
+    QWORD lastDropTime = TestTimeMS();
+    IngestStats lastStats = server.GetStats();
+
+    for(UINT seconds=1; !duration || seconds<=duration; seconds++)
+    {
+        TestSleep(1000);
+
+        IngestStats stats = server.GetStats();
+
+        double kbps = double(stats.numMediaBytes-lastStats.numMediaBytes)*8.0/1000.0;
+        UINT numVideo = stats.numVideoPackets-lastStats.numVideoPackets;
+        UINT numAudio = stats.numAudioPackets-lastStats.numAudioPackets;
+
+        printf("%4us  %8.1f kbps  %4u video  %4u audio  %u publishes", seconds, kbps, numVideo, numAudio, stats.numPublishes);
+        if(stats.numProbes)
+        {
+            printf("  latency %.0f ms (min %.0f, max %.0f, avg %.1f)  jitter %.1f ms",
+                stats.lastLatency, stats.minLatency, stats.maxLatency, stats.AverageLatency(), stats.jitter);
+        }
+        printf("\n");
+        fflush(stdout);
+
+        lastStats = stats;
+
+        if(dropInterval && TestTimeMS()-lastDropTime >= dropInterval)
+        {
+            server.DropConnections();
+            lastDropTime = TestTimeMS();
+            printf("dropped connections\n");
+        }
+    }
+
+    server.Stop();
+    return 0;
+}
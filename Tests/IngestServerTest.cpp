@@ -0,0 +1,117 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "IngestServer/IngestServer.h"
+#include "IngestServer/TestPublisher.h"
+
+const UINT captureDelay = 40; //pretend frames take this long from capture to the network
+
+static void PublishFrames(TestPublisher &publisher, UINT numFrames, UINT probeInterval)
+{
+    for(UINT i=0; i<numFrames; i++)
+    {
+        DWORD timestamp = i*10;
+        QWORD probeTime = (i % probeInterval) == 0 ? TestUnixTimeMS()-captureDelay : 0;
+
+        CHECK(publisher.SendVideo(timestamp, (i % 30) == 0, 2000, probeTime));
+        CHECK(publisher.SendAudio(timestamp, 200));
+
+        TestSleep(10);
+    }
+}
+
+int main()
+{
+    IngestServer server;
+    CHECK(server.Start());
+
+    //publish, and read the latency probes back out
+    {
+        TestPublisher publisher;
+        CHECK(publisher.Connect(server.GetPort()));
+        CHECK(server.WaitForPublish(1, 5000));
+
+        PublishFrames(publisher, 100, 5);
+        CHECK(server.WaitForVideo(100, 5000));
+
+        IngestStats stats = server.GetStats();
+        CHECK_EQUAL(stats.numConnections, 1);
+        CHECK_EQUAL(stats.numPublishes, 1);
+        CHECK_EQUAL(stats.numVideoPackets, 100);
+        CHECK_EQUAL(stats.numAudioPackets, 100);
+        CHECK_EQUAL(stats.numKeyframes, 4);
+        CHECK_EQUAL(stats.lastVideoTimestamp, 990);
+        CHECK_EQUAL(stats.numProbes, 20);
+
+        //loopback adds next to nothing on top of the pretend capture delay
+        CHECK(stats.minLatency >= double(captureDelay));
+        CHECK(stats.maxLatency < double(captureDelay+1000));
+        CHECK(stats.AverageLatency() >= stats.minLatency && stats.AverageLatency() <= stats.maxLatency);
+        CHECK(stats.jitter >= 0.0 && stats.jitter < 500.0);
+        CHECK(stats.MediaBitrate() > 0.0);
+
+        printf("latency %.1f ms avg (min %.0f, max %.0f), jitter %.2f ms\n",
+            stats.AverageLatency(), stats.minLatency, stats.maxLatency, stats.jitter);
+    }
+
+    //a dropped connection is seen by the publisher, and it can publish again
+    {
+        server.ResetStats();
+
+        TestPublisher publisher;
+        CHECK(publisher.Connect(server.GetPort()));
+        CHECK(server.WaitForPublish(1, 5000));
+
+        server.DropConnections();
+
+        bool bSendFailed = false;
+        for(UINT i=0; i<200 && !bSendFailed; i++)
+        {
+            bSendFailed = !publisher.SendVideo(i*10, i == 0, 20000);
+            TestSleep(5);
+        }
+        CHECK(bSendFailed);
+
+        CHECK(publisher.Connect(server.GetPort()));
+        CHECK(server.WaitForPublish(2, 5000));
+
+        PublishFrames(publisher, 10, 5);
+        CHECK(server.WaitForVideo(10, 5000));
+        CHECK_EQUAL(server.GetStats().numConnections, 2);
+    }
+
+    //a stopped server refuses connections until it's started again on the same port
+    {
+        WORD port = server.GetPort();
+        server.Stop();
+
+        TestPublisher publisher;
+        CHECK(!publisher.Connect(port));
+
+        CHECK(server.Start(port));
+        CHECK(publisher.Connect(port));
+
+        PublishFrames(publisher, 10, 5);
+        CHECK(server.WaitForVideo(10, 5000));
+    }
+
+    server.Stop();
+
+    return TestResult("IngestServerTest");
+}
@@ -0,0 +1,80 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// librtmp send throughput into the local ingest, unthrottled and against a shaped link.  for the shaped
+// runs the interesting number is how long sends block once the socket buffers are full (backpressure).
+
+#include "IngestServer/IngestServer.h"
+#include "IngestServer/TestPublisher.h"
+
+static void RunThroughput(UINT readRate, UINT packetSize, UINT durationMS)
+{
+    IngestServer server;
+    server.SetReadRate(readRate);
+    if(readRate)
+        server.SetReceiveBufferSize(64*1024);
+
+    CHECK(server.Start());
+
+    TestPublisher publisher;
+    CHECK(publisher.Connect(server.GetPort()));
+    CHECK(server.WaitForPublish(1, 5000));
+
+    QWORD startTime = TestTimeNS(), maxSendTime = 0;
+    UINT numPackets = 0;
+    while(TestTimeNS()-startTime < QWORD(durationMS)*1000000)
+    {
+        QWORD sendStart = TestTimeNS();
+        if(!publisher.SendVideo(numPackets*33, (numPackets % 60) == 0, packetSize))
+        {
+            CHECK(!"send failed");
+            break;
+        }
+
+        QWORD sendTime = TestTimeNS()-sendStart;
+        if(sendTime > maxSendTime)
+            maxSendTime = sendTime;
+
+        numPackets++;
+    }
+
+    double seconds = double(TestTimeNS()-startTime)/1e9;
+    double sentKbps = double(numPackets)*double(packetSize)*8.0/1000.0/seconds;
+
+    CHECK(server.WaitForVideo(numPackets, 30000));
+    IngestStats stats = server.GetStats();
+
+    printf("read rate %6u kbps, %6u byte packets:  sent %10.0f kbps, received %10.0f kbps, longest send %7.2f ms\n",
+        readRate, packetSize, sentKbps, stats.MediaBitrate(), double(maxSendTime)/1e6);
+    fflush(stdout);
+
+    publisher.Close();
+    server.Stop();
+}
+
+int main()
+{
+    RunThroughput(0, 4000, 500);
+    RunThroughput(0, 64000, 500);
+    RunThroughput(8000, 16000, 1500);
+    RunThroughput(2000, 16000, 1500);
+
+    return TestResult("IngestThroughputBenchmark");
+}
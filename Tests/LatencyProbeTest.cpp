@@ -0,0 +1,100 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#include "TestCommon.h"
+#include "../Source/LatencyProbe.h"
+
+static bool RoundTrip(QWORD unixTime)
+{
+    BYTE nal[LATENCY_PROBE_NAL_MAX];
+    UINT size = WriteLatencyProbeNAL(nal, unixTime);
+    if(size > LATENCY_PROBE_NAL_MAX)
+        return false;
+
+    UINT nalSize = UINT(nal[0]) << 24 | UINT(nal[1]) << 16 | UINT(nal[2]) << 8 | UINT(nal[3]);
+    if(nalSize != size-4)
+        return false;
+
+    //the written nal must never contain a start code
+    for(UINT i=4; i+2<size; i++)
+    {
+        if(nal[i] == 0 && nal[i+1] == 0 && nal[i+2] <= 2)
+            return false;
+    }
+
+    QWORD readTime = 0;
+    return ReadLatencyProbeNAL(nal+4, nalSize, readTime) && readTime == unixTime;
+}
+
+int main()
+{
+    //current times, and timestamps full of zero bytes that need emulation prevention
+    CHECK(RoundTrip(TestUnixTimeMS()));
+    CHECK(RoundTrip(0));
+    CHECK(RoundTrip(1));
+    CHECK(RoundTrip(0x0000000100000000ULL));
+    CHECK(RoundTrip(0x0000000300000003ULL));
+    CHECK(RoundTrip(0xFFFFFFFFFFFFFFFFULL));
+
+    srand(1234);
+    for(int i=0; i<10000; i++)
+    {
+        QWORD val = 0;
+        for(int j=0; j<8; j++)
+        {
+            int r = rand() % 4;
+            val = (val << 8) | QWORD(r == 0 ? 0 : (r == 1 ? rand()%4 : rand()%256));
+        }
+
+        if(!RoundTrip(val))
+        {
+            CHECK(!"round trip failed");
+            break;
+        }
+    }
+
+    //other SEI payloads and other nal types are ignored
+    BYTE otherSEI[] = {0x06, 0x05, 0x18, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+                       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80};
+    QWORD readTime = 0;
+    CHECK(!ReadLatencyProbeNAL(otherSEI, sizeof(otherSEI), readTime));
+
+    BYTE nal[LATENCY_PROBE_NAL_MAX];
+    UINT size = WriteLatencyProbeNAL(nal, 12345);
+    nal[4] = 0x65; //IDR slice
+    CHECK(!ReadLatencyProbeNAL(nal+4, size-4, readTime));
+
+    //a probe that follows another SEI message in the same nal is still found
+    BYTE combined[LATENCY_PROBE_NAL_MAX+8];
+    size = WriteLatencyProbeNAL(nal, 987654321);
+    combined[0] = 0x06;
+    combined[1] = 0x01; //pic_timing, 2 bytes
+    combined[2] = 0x02;
+    combined[3] = 0x11;
+    combined[4] = 0x22;
+    memcpy(combined+5, nal+5, size-5);
+    CHECK(ReadLatencyProbeNAL(combined, size, readTime) && readTime == 987654321);
+
+    //truncated probes are rejected rather than read past
+    size = WriteLatencyProbeNAL(nal, 42);
+    for(UINT i=1; i<size-5; i++)
+        CHECK(!ReadLatencyProbeNAL(nal+4, i, readTime));
+
+    return TestResult("LatencyProbeTest");
+}
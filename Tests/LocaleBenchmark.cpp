@@ -0,0 +1,149 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// LocaleStringLookup with the shipped locale files:  loading them and looking strings up, both with a
+// runtime string and through Str(), whose hash is folded from the literal.  the old node tree lookup is
+// timed next to it, and every locale is checked to give the same strings through both.
+
+#include "TestCommon.h"
+#include "LocaleLookupLegacy.h"
+
+//a few lookups the way the UI code makes them
+#define LOCALE_LOOKUPS(lookup) \
+    lookup("Add"); \
+    lookup("Cancel"); \
+    lookup("Preview"); \
+    lookup("DeleteConfirm"); \
+    lookup("MainWindow.Exit"); \
+    lookup("Settings.General"); \
+    lookup("Settings.General.Language"); \
+    lookup("Settings.General.SceneCollection");
+
+#define STR_LOOKUP(text) DoNotOptimize(Str(text))
+
+static CTSTR lookupNames[] =
+{
+    TEXT("Add"), TEXT("Cancel"), TEXT("Preview"), TEXT("DeleteConfirm"), TEXT("MainWindow.Exit"),
+    TEXT("Settings.General"), TEXT("Settings.General.Language"), TEXT("Settings.General.SceneCollection")
+};
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    {
+        StringList localeFiles;
+
+        OSFindData findData;
+        HANDLE hFind = OSFindFirstFile(TEXT("locale/*.txt"), findData);
+        if(hFind)
+        {
+            do
+            {
+                localeFiles << (String(TEXT("locale/")) << findData.fileName);
+            } while(OSFindNextFile(hFind, findData));
+
+            OSFindClose(hFind);
+        }
+
+        CHECK(localeFiles.Num() > 1);
+
+        //english first and then the language on top, the same as OBS loads them
+        for(UINT i=0; i<localeFiles.Num(); i++)
+        {
+            LocaleStringLookup lookup;
+            LegacyLocaleStringLookup legacyLookup;
+
+            CHECK(lookup.LoadStringFile(TEXT("locale/en.txt")) && legacyLookup.LoadStringFile(TEXT("locale/en.txt")));
+            CHECK(lookup.LoadStringFile(localeFiles[i]) && legacyLookup.LoadStringFile(localeFiles[i]));
+
+            const LocaleStringCache &cache = lookup.GetCache();
+            for(UINT j=0; j<cache.Num(); j++)
+            {
+                String strUpper = String(cache[j]->lookup).MakeUpper();
+                CHECK(legacyLookup.HasLookup(cache[j]->lookup));
+                CHECK(scmp(lookup.LookupString(cache[j]->lookup), legacyLookup.LookupString(cache[j]->lookup)) == 0);
+                CHECK(scmp(lookup.LookupString(strUpper), cache[j]->strValue) == 0);
+            }
+
+            CHECK(!lookup.HasLookup(TEXT("Settings.General.DoesNotExist")));
+            CHECK(scmp(lookup.LookupString(TEXT("Settings.General.DoesNotExist")), legacyLookup.LookupString(TEXT("Settings.General.DoesNotExist"))) == 0);
+        }
+
+        Benchmark("LocaleStringLookup::LoadStringFile, every locale", [&] {
+            for(UINT i=0; i<localeFiles.Num(); i++)
+            {
+                LocaleStringLookup lookup;
+                lookup.LoadStringFile(localeFiles[i]);
+            }
+        });
+
+        Benchmark("old LocaleStringLookup::LoadStringFile, every locale", [&] {
+            for(UINT i=0; i<localeFiles.Num(); i++)
+            {
+                LegacyLocaleStringLookup lookup;
+                lookup.LoadStringFile(localeFiles[i]);
+            }
+        });
+
+        //------------------------
+
+        LocaleStringLookup lookup;
+        LegacyLocaleStringLookup legacyLookup;
+        CHECK(lookup.LoadStringFile(TEXT("locale/en.txt")) && legacyLookup.LoadStringFile(TEXT("locale/en.txt")));
+
+        StringList allLookups;
+        for(UINT i=0; i<lookup.GetCache().Num(); i++)
+            allLookups << lookup.GetCache()[i]->lookup;
+
+        LocaleStringLookup *prevLocale = locale;
+        locale = &lookup;
+
+        Benchmark("Str(), 8 literal lookups", [&] {
+            LOCALE_LOOKUPS(STR_LOOKUP)
+        });
+
+        Benchmark("LocaleStringLookup::LookupString, 8 runtime lookups", [&] {
+            for(UINT i=0; i<_countof(lookupNames); i++)
+                DoNotOptimize(lookup.LookupString(lookupNames[i]));
+        });
+
+        Benchmark("old LocaleStringLookup::LookupString, 8 lookups", [&] {
+            for(UINT i=0; i<_countof(lookupNames); i++)
+                DoNotOptimize(legacyLookup.LookupString(lookupNames[i]));
+        });
+
+        UINT i = 0;
+        Benchmark("LocaleStringLookup::LookupString, every english string", [&] {
+            i = (i+7919) % allLookups.Num();
+            DoNotOptimize(lookup.LookupString(allLookups[i]));
+        });
+
+        Benchmark("old LocaleStringLookup::LookupString, every english string", [&] {
+            i = (i+7919) % allLookups.Num();
+            DoNotOptimize(legacyLookup.LookupString(allLookups[i]));
+        });
+
+        locale = prevLocale;
+    }
+
+    TerminateXT();
+    return TestResult("LocaleBenchmark");
+}
@@ -0,0 +1,268 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// LocaleStringLookup as it was before the hash table, a radix tree walked one child list at a time.  kept so
+// LocaleBenchmark can check the new lookup against it and time the two side by side.  only loading and
+// lookups are here, removal isn't.
+
+#include "LocaleLookupLegacy.h"
+
+
+struct LegacyStringLookupNode
+{
+    String str;
+    List<LegacyStringLookupNode*> subNodes;
+    LocaleStringItem *leaf;
+
+    inline LegacyStringLookupNode() : leaf(NULL) {}
+
+    inline ~LegacyStringLookupNode()
+    {
+        for(unsigned int i=0; i<subNodes.Num(); i++)
+            delete subNodes[i];
+    }
+
+    inline LegacyStringLookupNode* FindSubNodeByChar(TCHAR ch)
+    {
+        for(unsigned int i=0; i<subNodes.Num(); i++)
+        {
+            LegacyStringLookupNode *node = subNodes[i];
+            if(node->str.IsValid() && node->str[0] == ch)
+                return subNodes[i];
+        }
+
+        return NULL;
+    }
+
+    inline LegacyStringLookupNode* FindSubNode(CTSTR lpLookup)
+    {
+        for(unsigned int i=0; i<subNodes.Num(); i++)
+        {
+            LegacyStringLookupNode *node = subNodes[i];
+            if(scmpi_n(node->str, lpLookup, node->str.Length()) == 0)
+                return subNodes[i];
+        }
+
+        return NULL;
+    }
+};
+
+
+LegacyLocaleStringLookup::LegacyLocaleStringLookup()
+{
+    top = new LegacyStringLookupNode;
+}
+
+LegacyLocaleStringLookup::~LegacyLocaleStringLookup()
+{
+    cache.Clear();
+    delete top;
+}
+
+
+void LegacyLocaleStringLookup::AddLookup(CTSTR lookupVal, LocaleStringItem *item, LegacyStringLookupNode *node)
+{
+    if(!node) node = top;
+
+    if(!lookupVal)
+        return;
+
+    if(!*lookupVal)
+    {
+        delete node->leaf;
+        node->leaf = item;
+        return;
+    }
+
+    LegacyStringLookupNode *child = node->FindSubNodeByChar(*lookupVal);
+
+    if(child)
+    {
+        UINT len;
+
+        for(len=0; len<child->str.Length(); len++)
+        {
+            TCHAR val1 = child->str[len],
+                  val2 = lookupVal[len];
+
+            if((val1 >= 'A') && (val1 <= 'Z'))
+                val1 += 0x20;
+            if((val2 >= 'A') && (val2 <= 'Z'))
+                val2 += 0x20;
+
+            if(val1 != val2)
+                break;
+        }
+
+        if(len == child->str.Length())
+            return AddLookup(lookupVal+len, item, child);
+        else
+        {
+            LegacyStringLookupNode *childSplit = new LegacyStringLookupNode;
+            childSplit->str = child->str.Array()+len;
+            childSplit->leaf = child->leaf;
+            childSplit->subNodes.TransferFrom(child->subNodes);
+
+            child->leaf = NULL;
+            child->str.SetLength(len);
+
+            child->subNodes << childSplit;
+
+            if(lookupVal[len] != 0)
+            {
+                LegacyStringLookupNode *newNode = new LegacyStringLookupNode;
+                newNode->leaf = item;
+                newNode->str  = lookupVal+len;
+
+                child->subNodes << newNode;
+            }
+            else
+                child->leaf = item;
+        }
+    }
+    else
+    {
+        LegacyStringLookupNode *newNode = new LegacyStringLookupNode;
+        newNode->leaf = item;
+        newNode->str  = lookupVal;
+
+        node->subNodes << newNode;
+    }
+}
+
+BOOL LegacyLocaleStringLookup::LoadStringFile(CTSTR lpFile)
+{
+    XFile file;
+
+    if(!file.Open(lpFile, XFILE_READ, XFILE_OPENEXISTING))
+        return FALSE;
+
+    String fileString;
+    file.ReadFileToString(fileString);
+    file.Close();
+
+    if(fileString.IsEmpty())
+        return FALSE;
+
+    //------------------------
+
+    fileString.FindReplace(TEXT("\r"), TEXT(" "));
+
+    TSTR lpTemp = fileString.Array()-1;
+    TSTR lpNextLine;
+
+    do
+    {
+        ++lpTemp;
+        lpNextLine = schr(lpTemp, '\n');
+
+        while(*lpTemp == ' ' || *lpTemp == L'\x3000' || *lpTemp == '\t')
+            ++lpTemp;
+
+        if(!*lpTemp || *lpTemp == '\n') continue;
+
+        if(lpNextLine) *lpNextLine = 0;
+
+        //----------
+
+        TSTR lpValueStart = lpTemp;
+        while(*lpValueStart && *lpValueStart != '=')
+            ++lpValueStart;
+
+        String lookupVal, strVal;
+
+        TCHAR prevChar = *lpValueStart;
+        *lpValueStart = 0;
+        lookupVal = lpTemp;
+        *lpValueStart = prevChar;
+        lookupVal.KillSpaces();
+
+        String value = ++lpValueStart;
+        value.KillSpaces();
+        if(value.IsValid() && value[0] == '"')
+        {
+            value = String::RepresentationToString(value);
+            strVal = value;
+        }
+        else
+            strVal = value;
+
+        if(lookupVal.IsValid())
+            AddLookupString(lookupVal, strVal);
+
+        //----------
+
+        if(lpNextLine) *lpNextLine = '\n';
+    }while(lpTemp = lpNextLine);
+
+    return TRUE;
+}
+
+
+LegacyStringLookupNode *LegacyLocaleStringLookup::FindNode(CTSTR lookupVal, LegacyStringLookupNode *node) const
+{
+    if(!node) node = top;
+
+    LegacyStringLookupNode *child = node->FindSubNode(lookupVal);
+    if(child)
+    {
+        lookupVal += child->str.Length();
+        TCHAR ch = *lookupVal;
+        if(ch)
+            return FindNode(lookupVal, child);
+
+        if(child->leaf)
+            return child;
+    }
+
+    return NULL;
+}
+
+void LegacyLocaleStringLookup::AddLookupString(CTSTR lookupVal, CTSTR lpVal)
+{
+    if(!lookupVal || !*lookupVal)
+        return;
+
+    LegacyStringLookupNode *child = FindNode(lookupVal);
+    if(child)
+        child->leaf->strValue = lpVal;
+    else
+    {
+        LocaleStringItem *item = new LocaleStringItem;
+        item->lookup = lookupVal;
+        item->strValue = lpVal;
+        cache << item;
+
+        AddLookup(item->lookup, item);
+    }
+}
+
+CTSTR LegacyLocaleStringLookup::LookupString(CTSTR lookupVal)
+{
+    LegacyStringLookupNode *child = FindNode(lookupVal);
+    if(!child)
+        return TEXT("(string not found)");
+
+    if(!child->leaf)
+        return TEXT("(lookup error)");
+
+    return child->leaf->strValue;
+}
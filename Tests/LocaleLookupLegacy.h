@@ -0,0 +1,50 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+#include "OBSApi.h"
+
+//-------------------------------------------
+// the node tree LocaleStringLookup, see LocaleLookupLegacy.cpp
+
+struct LegacyStringLookupNode;
+
+class LegacyLocaleStringLookup
+{
+    LegacyStringLookupNode *top;
+    LocaleStringCache cache;
+
+    void AddLookup(CTSTR lookupVal, LocaleStringItem *item, LegacyStringLookupNode *node=NULL);
+
+    LegacyStringLookupNode* FindNode(CTSTR lookupVal, LegacyStringLookupNode *node=NULL) const;
+
+public:
+    LegacyLocaleStringLookup();
+    ~LegacyLocaleStringLookup();
+
+    BOOL LoadStringFile(CTSTR lpFile);
+
+    inline BOOL HasLookup(CTSTR lookupVal) const {return (FindNode(lookupVal) != NULL);}
+
+    void AddLookupString(CTSTR lookupVal, CTSTR lpVal);
+
+    CTSTR LookupString(CTSTR lookupVal);
+};
@@ -0,0 +1,247 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+#include "OBSApi.h"
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------
+// a GraphicsSystem that doesn't touch a device, so the code around it can be tested without a GPU.  textures
+// are plain objects that remember their size and who destroyed them, sampler states remember how they were
+// made, and every sprite drawn is recorded with the render target, texture and sampler it used.  everything
+// else does nothing.  install it with GS = new MockGraphicsSystem.
+
+class MockTexture : public Texture
+{
+    DWORD width, height;
+    GSColorFormat format;
+
+public:
+    static std::mutex lock;
+    static UINT numCreated;
+    static std::vector<std::thread::id> deletingThreads;
+
+    inline MockTexture(DWORD width, DWORD height, GSColorFormat format) : width(width), height(height), format(format)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        numCreated++;
+    }
+
+    ~MockTexture()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        deletingThreads.push_back(std::this_thread::get_id());
+    }
+
+    static inline UINT NumDeleted()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return (UINT)deletingThreads.size();
+    }
+
+    static inline void ResetCounts()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        numCreated = 0;
+        deletingThreads.clear();
+    }
+
+    DWORD Width() const                 {return width;}
+    DWORD Height() const                {return height;}
+    BOOL HasAlpha() const               {return format == GS_RGBA || format == GS_BGRA;}
+    void SetImage(void *lpData, GSImageFormat imageFormat, UINT pitch) {}
+    bool Map(BYTE *&lpData, UINT &pitch) {return false;}
+    void Unmap()                        {}
+    GSColorFormat GetFormat() const     {return format;}
+
+    bool GetDC(HDC &hDC)                {return false;}
+    void ReleaseDC()                    {}
+
+    LPVOID GetD3DTexture()              {return NULL;}
+    HANDLE GetSharedHandle()            {return NULL;}
+
+    void SetImageRect(void *lpData, GSImageFormat imageFormat, UINT pitch, UINT x, UINT y, UINT cx, UINT cy) {}
+};
+
+class MockSamplerState : public SamplerState
+{
+public:
+    inline MockSamplerState(const SamplerInfo &samplerInfo) {info = samplerInfo;}
+};
+
+class MockShader : public Shader
+{
+    ShaderType type;
+
+public:
+    inline MockShader(ShaderType type) : type(type) {hViewProj = NULL;}
+
+    ShaderType GetType() const                                          {return type;}
+
+    int    NumParams() const                                            {return 0;}
+    HANDLE GetParameter(UINT parameter) const                           {return NULL;}
+    HANDLE GetParameterByName(CTSTR lpName) const                       {return NULL;}
+    void   GetParameterInfo(HANDLE hObject, ShaderParameterInfo &paramInfo) const {}
+
+    void   SetBool(HANDLE hObject, BOOL bValue)                         {}
+    void   SetFloat(HANDLE hObject, float fValue)                       {}
+    void   SetInt(HANDLE hObject, int iValue)                           {}
+    void   SetMatrix(HANDLE hObject, float *matrix)                     {}
+    void   SetVector(HANDLE hObject, const Vect &value)                 {}
+    void   SetVector2(HANDLE hObject, const Vect2 &value)               {}
+    void   SetVector4(HANDLE hObject, const Vect4 &value)               {}
+    void   SetTexture(HANDLE hObject, BaseTexture *texture)             {}
+    void   SetValue(HANDLE hObject, const void *val, DWORD dwSize)      {}
+};
+
+//a sprite as it was drawn.  a NULL sampler means whatever the pixel shader declares itself
+struct MockDraw
+{
+    Texture *renderTarget;
+    Texture *texture;
+    SamplerState *sampler;
+    Shader *pixelShader;
+    float x, y, x2, y2;
+};
+
+//needs to be in exactly one file of each test
+#define MOCK_GRAPHICS_SYSTEM_STATICS \
+    std::mutex MockTexture::lock; \
+    UINT MockTexture::numCreated = 0; \
+    std::vector<std::thread::id> MockTexture::deletingThreads;
+
+class MockGraphicsSystem : public GraphicsSystem
+{
+    void ResizeView()                   {}
+    void UnloadAllData()                {}
+
+    void CreateVertexShaderBlob(ShaderBlob &blob, CTSTR lpShader, CTSTR lpFileName) {}
+    void CreatePixelShaderBlob(ShaderBlob &blob, CTSTR lpShader, CTSTR lpFileName) {}
+
+protected:
+    void ResetViewMatrix()              {}
+
+    void RecordDraw(Texture *texture, float x, float y, float x2, float y2)
+    {
+        MockDraw draw = {renderTarget, texture, samplers[0], pixelShader, x, y, x2, y2};
+        draws.push_back(draw);
+    }
+
+public:
+    Texture *renderTarget;
+    Shader *pixelShader, *vertexShader;
+    SamplerState *samplers[8];
+
+    std::vector<MockDraw> draws;
+    UINT numClears;
+
+    inline MockGraphicsSystem() : renderTarget(NULL), pixelShader(NULL), vertexShader(NULL), numClears(0)
+    {
+        for(UINT i=0; i<8; i++)
+            samplers[i] = NULL;
+    }
+
+    LPVOID GetDevice()                  {return NULL;}
+    LPVOID GetContext()                 {return NULL;}
+
+    Texture* CreateTextureFromSharedHandle(unsigned int width, unsigned int height, HANDLE handle)
+    {
+        return new MockTexture(width, height, GS_BGRA);
+    }
+    Texture* CreateTexture(unsigned int width, unsigned int height, GSColorFormat colorFormat, void *lpData, BOOL bBuildMipMaps, BOOL bStatic)
+    {
+        return new MockTexture(width, height, colorFormat);
+    }
+    Texture* CreateTextureFromFile(CTSTR lpFile, BOOL bBuildMipMaps)    {return NULL;}
+    Texture* CreateRenderTarget(unsigned int width, unsigned int height, GSColorFormat colorFormat, BOOL bGenMipMaps)
+    {
+        return new MockTexture(width, height, colorFormat);
+    }
+    Texture* CreateGDITexture(unsigned width, unsigned int height)
+    {
+        return new MockTexture(width, height, GS_BGRA);
+    }
+    Texture* CreateSharedTexture(unsigned int width, unsigned int height)
+    {
+        return new MockTexture(width, height, GS_BGRA);
+    }
+
+    bool GetTextureFileInfo(CTSTR lpFile, TextureInfo &info)            {return false;}
+
+    SamplerState* CreateSamplerState(SamplerInfo &info)                 {return new MockSamplerState(info);}
+
+    UINT GetNumOutputs()                                                {return 0;}
+    OutputDuplicator* CreateOutputDuplicator(UINT outputID)             {return NULL;}
+
+    Shader* CreateVertexShader(CTSTR lpShader, CTSTR lpFileName)        {return NULL;}
+    Shader* CreatePixelShader(CTSTR lpShader, CTSTR lpFileName)         {return NULL;}
+    Shader* CreateVertexShaderFromBlob(ShaderBlob const &blob, CTSTR lpShader, CTSTR lpFileName) {return NULL;}
+    Shader* CreatePixelShaderFromBlob(ShaderBlob const &blob, CTSTR lpShader, CTSTR lpFileName)  {return NULL;}
+
+    VertexBuffer* CreateVertexBuffer(VBData *vbData, BOOL bStatic)      {return NULL;}
+
+    void LoadVertexBuffer(VertexBuffer* vb)                             {}
+    void LoadTexture(Texture *texture, UINT idTexture)                  {}
+    void LoadSamplerState(SamplerState *sampler, UINT idSampler)        {samplers[idSampler] = sampler;}
+    void LoadVertexShader(Shader *vShader)                              {vertexShader = vShader;}
+
+    //like the real one, a different pixel shader brings its own samplers back
+    void LoadPixelShader(Shader *pShader)
+    {
+        if(pixelShader != pShader)
+        {
+            for(UINT i=0; i<8; i++)
+                samplers[i] = NULL;
+            pixelShader = pShader;
+        }
+    }
+
+    Shader* GetCurrentPixelShader()                                     {return pixelShader;}
+    Shader* GetCurrentVertexShader()                                    {return vertexShader;}
+
+    void SetRenderTarget(Texture *texture)                              {renderTarget = texture;}
+    void Draw(GSDrawMode drawMode, DWORD startVert, DWORD nVerts)       {}
+
+    void EnableBlending(BOOL bEnable)                                   {}
+    void BlendFunction(GSBlendType srcFactor, GSBlendType destFactor, float fFactor) {}
+    void ClearColorBuffer(DWORD color)                                  {numClears++;}
+
+    void DrawSpriteEx(Texture *texture, DWORD color, float x, float y, float x2, float y2, float u, float v, float u2, float v2)
+    {
+        RecordDraw(texture, x, y, x2, y2);
+    }
+    void DrawSpriteExRotate(Texture *texture, DWORD color, float x, float y, float x2, float y2, float degrees, float u, float v, float u2, float v2, float texDegrees)
+    {
+        RecordDraw(texture, x, y, x2, y2);
+    }
+    void DrawBox(const Vect2 &upperLeft, const Vect2 &size)             {}
+    void SetCropping(float top, float left, float bottom, float right)  {}
+
+    void Ortho(float left, float right, float top, float bottom, float znear, float zfar)   {}
+    void Frustum(float left, float right, float top, float bottom, float znear, float zfar) {}
+    void SetViewport(float x, float y, float width, float height)       {}
+    void SetScissorRect(XRect *pRect)                                   {}
+
+    void CopyTexture(Texture *texDest, Texture *texSrc)                 {}
+};
@@ -0,0 +1,128 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// librtmp built with Compat/CountingAlloc.h, checking that a publishing connection stops allocating once
+// it's up:  media sends of any size reuse the per-connection buffers, and the connect path encodes into
+// the per-connection AMF arena, so commands bigger than the old stack buffers still go out.
+
+#include "IngestServer/IngestServer.h"
+#include "IngestServer/TestPublisher.h"
+#include "Compat/CountingAlloc.h"
+
+#include "log.h"
+
+#include <atomic>
+#include <string>
+
+//only allocations made by the publishing thread count, the ingest server runs librtmp on its own threads
+static thread_local bool bCountAllocations = false;
+static std::atomic<UINT> numAllocations(0);
+
+extern "C"
+{
+    void *CountedMalloc(size_t size)
+    {
+        if(bCountAllocations) numAllocations++;
+        return malloc(size);
+    }
+
+    void *CountedCalloc(size_t num, size_t size)
+    {
+        if(bCountAllocations) numAllocations++;
+        return calloc(num, size);
+    }
+
+    void *CountedRealloc(void *ptr, size_t size)
+    {
+        if(bCountAllocations) numAllocations++;
+        return realloc(ptr, size);
+    }
+
+    void CountedFree(void *ptr)
+    {
+        free(ptr);
+    }
+}
+
+static UINT CountSendAllocations(TestPublisher &publisher, UINT numFrames, UINT videoSize)
+{
+    numAllocations = 0;
+    bCountAllocations = true;
+
+    for(UINT i=0; i<numFrames; i++)
+    {
+        CHECK(publisher.SendVideo(1000+i*33, (i % 60) == 0, videoSize, (i % 30) == 0 ? TestUnixTimeMS() : 0));
+        CHECK(publisher.SendAudio(1000+i*33, 300));
+    }
+
+    bCountAllocations = false;
+    return numAllocations;
+}
+
+int main()
+{
+    IngestServer server;
+    CHECK(server.Start());
+
+    //steady state media sends
+    {
+        TestPublisher publisher;
+        CHECK(publisher.Connect(server.GetPort()));
+        CHECK(server.WaitForPublish(1, 5000));
+
+        //first packets on each channel set up the channel table
+        CountSendAllocations(publisher, 2, 1000);
+
+        //below the chunk size, a few chunks, and a lot of chunks
+        CHECK_EQUAL(CountSendAllocations(publisher, 500, 1000), 0);
+        CHECK_EQUAL(CountSendAllocations(publisher, 200, 20000), 0);
+        CHECK_EQUAL(CountSendAllocations(publisher, 20, 500000), 0);
+
+        CHECK(server.WaitForVideo(722, 10000));
+        publisher.Close();
+    }
+
+    //a play path much longer than the old 1k command buffers
+    {
+        server.ResetStats();
+
+        std::string longPath(3000, 'k');
+        longPath.insert(0, "stream?token=");
+
+        TestPublisher publisher;
+        publisher.SetPlayPath(longPath.c_str());
+
+        numAllocations = 0;
+        bCountAllocations = true;
+        bool bConnected = publisher.Connect(server.GetPort());
+        bCountAllocations = false;
+
+        CHECK(bConnected);
+        CHECK(server.WaitForPublish(1, 5000));
+        printf("connect and publish with a %u byte play path: %u allocations\n", UINT(longPath.size()), UINT(numAllocations));
+
+        CHECK(publisher.SendVideo(0, true, 1000));
+        CHECK(server.WaitForVideo(1, 5000));
+    }
+
+    server.Stop();
+
+    return TestResult("RTMPAllocationTest");
+}
@@ -0,0 +1,165 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// how long the stream is off the ingest after a dropped connection, for the three ways RTMPPublisher
+// reconnects:  a full connect (resolve, TCP and RTMP handshakes, publish), a connect straight to the
+// address cached from the first connection, and publishing on a standby connection that already has the
+// handshakes done.  measured from the drop being noticed to the first video packet arriving again.
+
+#include "IngestServer/IngestServer.h"
+#include "IngestServer/TestPublisher.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <vector>
+
+enum ReconnectMode
+{
+    Reconnect_Full,
+    Reconnect_CachedAddress,
+    Reconnect_Standby,
+};
+
+static const char *modeNames[] = {"full connect", "cached address", "standby connection"};
+
+const UINT numRounds = 10;
+
+//drops the connection, reconnects and returns how long it took until video arrived again, in microseconds
+static QWORD MeasureReconnect(IngestServer &server, TestPublisher &publisher, ReconnectMode mode, const sockaddr_in &address)
+{
+    server.ResetStats();
+    server.DropConnections();
+
+    //keep sending until the drop is noticed, like the send thread would
+    bool bSendFailed = false;
+    for(UINT i=0; i<400 && !bSendFailed; i++)
+    {
+        bSendFailed = !publisher.SendVideo(i*10, i == 0, 20000);
+        if(!bSendFailed)
+            TestSleep(5);
+    }
+    CHECK(bSendFailed);
+
+    //dropping takes every connection with it, so the standby is made now, untimed, standing in for the
+    //one StandbyThread would have had ready
+    TestPublisher standby;
+    if(mode == Reconnect_Standby)
+        CHECK(standby.Connect(server.GetPort(), false));
+
+    QWORD startTime = TestTimeNS();
+
+    bool bConnected = false;
+    switch(mode)
+    {
+        case Reconnect_Full:            bConnected = publisher.Connect(server.GetPort()); break;
+        case Reconnect_CachedAddress:   bConnected = publisher.ConnectToAddress(server.GetPort(), address); break;
+        case Reconnect_Standby:         bConnected = standby.Publish(); break;
+    }
+    CHECK(bConnected);
+
+    TestPublisher &newPublisher = (mode == Reconnect_Standby) ? standby : publisher;
+    CHECK(newPublisher.SendVideo(0, true, 2000));
+    CHECK(server.WaitForVideo(1, 5000));
+
+    QWORD reconnectTime = (TestTimeNS()-startTime)/1000;
+
+    //the next round starts from the main publisher again
+    if(mode == Reconnect_Standby)
+    {
+        standby.Close();
+        CHECK(publisher.Connect(server.GetPort()));
+        CHECK(server.WaitForPublish(2, 5000));
+    }
+
+    return reconnectTime;
+}
+
+int main()
+{
+    //every round fails sends on purpose
+    RTMP_LogSetLevel(RTMP_LOGCRIT);
+
+    IngestServer server;
+    CHECK(server.Start());
+
+    TestPublisher publisher;
+    CHECK(publisher.Connect(server.GetPort()));
+    CHECK(server.WaitForPublish(1, 5000));
+
+    sockaddr_in address;
+    CHECK(publisher.GetPeerAddress(address));
+
+    double medians[3];
+
+    for(int mode=Reconnect_Full; mode<=Reconnect_Standby; mode++)
+    {
+        std::vector<QWORD> times;
+        for(UINT i=0; i<numRounds; i++)
+            times.push_back(MeasureReconnect(server, publisher, ReconnectMode(mode), address));
+
+        std::sort(times.begin(), times.end());
+        medians[mode] = double(times[times.size()/2])/1000.0;
+
+        printf("%-20s  median %8.3f ms, min %8.3f ms, max %8.3f ms\n", modeNames[mode],
+            medians[mode], double(times.front())/1000.0, double(times.back())/1000.0);
+        fflush(stdout);
+
+        //on loopback every mode should be back well within a second
+        CHECK(times.back() < 1000000);
+    }
+
+    //a standby only has to publish, it shouldn't ever be slower than doing the handshakes as well.  allow
+    //some slack since the timings here are tiny.
+    CHECK(medians[Reconnect_Standby] <= medians[Reconnect_Full]*1.5 + 1.0);
+
+    //an ingest that restarts takes the stream down until it's back, reconnecting retries until then
+    {
+        WORD port = server.GetPort();
+        server.Stop();
+
+        publisher.SendVideo(0, true, 20000);
+
+        QWORD startTime = TestTimeMS();
+        std::thread restartThread([&server, port] {TestSleep(300); server.Start(port);});
+
+        bool bConnected = false;
+        for(UINT attempt=0; attempt<100 && !bConnected; attempt++)
+        {
+            bConnected = publisher.ConnectToAddress(port, address);
+            if(!bConnected)
+                TestSleep(20);
+        }
+        restartThread.join();
+
+        CHECK(bConnected);
+        CHECK(publisher.SendVideo(0, true, 2000));
+        CHECK(server.WaitForVideo(1, 5000));
+
+        QWORD outage = TestTimeMS()-startTime;
+        printf("%-20s  %u ms with the ingest down for 300 ms\n", "ingest restart", UINT(outage));
+        CHECK(outage >= 300 && outage < 3000);
+    }
+
+    publisher.Close();
+    server.Stop();
+
+    return TestResult("ReconnectLatencyTest");
+}
@@ -0,0 +1,422 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// DShowPlugin's sample buffering fed by a synthetic producer rather than a capture graph.  timestamped video
+// frames and audio packets go into SamplePool buffers and a SampleQueue the way DeviceSource::QueueSample puts
+// them there, and come back out through SampleScheduler against a made up clock.  covers samples arriving out
+// of order, buffers being reused (or not) after the video media type changes size, and when the sample
+// thread gets woken up next, with and without a buffering delay.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+#include "SampleQueue.h"
+
+static const LONGLONG msTime = 10000; //sample times are in 100ns units
+
+static const UINT videoSize = 640*480*2;
+static const UINT audioSize = 441*4;
+
+//what DeviceSource::QueueSample does with the data it gets, minus the locking
+static SampleData* MakeSample(SamplePool *pool, LONGLONG timestamp, UINT size, bool bAudio)
+{
+    SampleData *sample = pool->GetSample(size);
+    sample->bAudio = bAudio;
+    sample->cx = bAudio ? 0 : 640;
+    sample->cy = bAudio ? 0 : 480;
+    sample->timestamp = timestamp;
+
+    memset(sample->lpData, int(timestamp/msTime) & 0xFF, size);
+    return sample;
+}
+
+static bool IsOrdered(SampleQueue &queue)
+{
+    for (UINT i=1; i<queue.Num(); i++) {
+        if (queue[i-1]->timestamp > queue[i]->timestamp)
+            return false;
+    }
+
+    return true;
+}
+
+static void ReleaseAll(SampleQueue &queue)
+{
+    while (queue.Num())
+        queue.PopFront()->Release();
+}
+
+//stands in for DeviceSource, keeps track of what came out and when
+struct TestOutput : SampleOutput
+{
+    List<LONGLONG> timestamps;
+    List<bool> audio;
+    UINT numFlushes;
+    bool bDataIntact;
+
+    TestOutput() : numFlushes(0), bDataIntact(true) {}
+
+    void OutputSample(SampleData *sample)
+    {
+        BYTE val = BYTE(sample->timestamp/msTime);
+        if (sample->lpData[0] != val || sample->lpData[sample->dataLength-1] != val)
+            bDataIntact = false;
+
+        timestamps << sample->timestamp;
+        audio << sample->bAudio;
+        sample->Release();
+    }
+
+    void FlushAudio() {numFlushes++;}
+};
+
+//-------------------------------------------
+
+static void CheckOutOfOrder()
+{
+    SamplePool *videoPool = new SamplePool, *audioPool = new SamplePool;
+    SampleQueue queue;
+
+    videoPool->SetBufferSize(videoSize);
+
+    //30fps video and 10ms audio packets over a second, shuffled.  more than the queue starts out with
+    List<LONGLONG> times;
+    for (LONGLONG i=0; i<30; i++)
+        times << i*333333;
+    for (LONGLONG i=0; i<100; i++)
+        times << -(i*100000)-1; //negative for audio
+
+    UINT seed = 12345;
+    for (UINT i=times.Num()-1; i>0; i--) {
+        seed = seed*1103515245 + 12345;
+        UINT j = (seed >> 8) % (i+1);
+        LONGLONG temp = times[i];
+        times[i] = times[j];
+        times[j] = temp;
+    }
+
+    for (UINT i=0; i<times.Num(); i++) {
+        if (times[i] < 0)
+            queue.Insert(MakeSample(audioPool, -(times[i]+1), audioSize, true));
+        else
+            queue.Insert(MakeSample(videoPool, times[i], videoSize, false));
+    }
+
+    CHECK_EQUAL(queue.Num(), 130);
+    CHECK(IsOrdered(queue));
+
+    //samples with the same timestamp stay in the order they came in
+    SampleData *first = MakeSample(audioPool, 10000000, audioSize, true);
+    SampleData *second = MakeSample(videoPool, 10000000, videoSize, false);
+    SampleData *third = MakeSample(audioPool, 10000000, audioSize, true);
+    queue.Insert(first);
+    queue.Insert(second);
+    queue.Insert(third);
+
+    UINT index = queue.Num()-3;
+    CHECK(queue[index] == first && queue[index+1] == second && queue[index+2] == third);
+
+    //take most of them out so the ring wraps around, then grow it while the oldest part is in the middle
+    for (UINT i=0; i<100; i++)
+        queue.PopFront()->Release();
+
+    LONGLONG lastTime = queue[queue.Num()-1]->timestamp;
+    for (LONGLONG i=1; i<=300; i++) {
+        LONGLONG time = lastTime + i*100000;
+        if ((i % 7) == 0)
+            time -= 350000; //a few stragglers
+
+        queue.Insert(MakeSample(audioPool, time, audioSize, true));
+        CHECK(IsOrdered(queue));
+    }
+
+    CHECK_EQUAL(queue.Num(), 333);
+
+    //everything handed out is accounted for by the pools
+    CHECK_EQUAL(videoPool->refs + audioPool->refs, 2 + queue.Num());
+
+    ReleaseAll(queue);
+    CHECK_EQUAL(videoPool->refs, 1);
+    CHECK_EQUAL(audioPool->refs, 1);
+
+    videoPool->Release();
+    audioPool->Release();
+}
+
+static void CheckResize()
+{
+    SamplePool *pool = new SamplePool;
+    const UINT bigSize = 1280*720*2;
+
+    pool->SetBufferSize(videoSize);
+
+    //a steady stream of frames keeps going through the same buffer
+    SampleData *first = MakeSample(pool, 0, videoSize, false);
+    CHECK(first->capacity >= videoSize);
+    first->Release();
+    CHECK_EQUAL(pool->freeSamples.Num(), 1);
+
+    for (LONGLONG i=1; i<100; i++) {
+        SampleData *sample = MakeSample(pool, i*333333, videoSize, false);
+        CHECK(sample == first);
+        sample->Release();
+    }
+
+    //the device switches to a bigger format while a frame of the old size is still queued up
+    SampleData *queued = MakeSample(pool, 0, videoSize, false);
+    SampleData *spare = MakeSample(pool, 0, videoSize, false);
+    spare->Release();
+    CHECK_EQUAL(pool->freeSamples.Num(), 1);
+
+    pool->SetBufferSize(bigSize);
+    CHECK_EQUAL(pool->freeSamples.Num(), 0);
+
+    SampleData *big = MakeSample(pool, 0, bigSize, false);
+    CHECK(big != queued);
+    CHECK(big->capacity >= bigSize);
+
+    //the old frame is too small to be any use now, so it isn't kept
+    queued->Release();
+    CHECK_EQUAL(pool->freeSamples.Num(), 0);
+
+    big->Release();
+    CHECK_EQUAL(pool->freeSamples.Num(), 1);
+
+    SampleData *sample = MakeSample(pool, 0, bigSize, false);
+    CHECK(sample == big);
+    sample->Release();
+
+    //going back down keeps the bigger buffers, they still fit
+    pool->SetBufferSize(videoSize);
+    CHECK_EQUAL(pool->freeSamples.Num(), 1);
+
+    sample = MakeSample(pool, 0, videoSize, false);
+    CHECK(sample == big);
+    CHECK_EQUAL(sample->dataLength, videoSize);
+    sample->Release();
+
+    //audio packets change size without a media type, a bigger one than anything free gets its own buffer
+    SamplePool *audioPool = new SamplePool;
+
+    SampleData *packet = MakeSample(audioPool, 0, audioSize, true);
+    packet->Release();
+
+    SampleData *bigPacket = MakeSample(audioPool, 0, audioSize*2, true);
+    CHECK(bigPacket != packet);
+    bigPacket->Release();
+
+    for (UINT i=0; i<10; i++) {
+        SampleData *smallPacket = MakeSample(audioPool, 0, audioSize, true);
+        CHECK(smallPacket == packet || smallPacket == bigPacket);
+        smallPacket->Release();
+    }
+
+    CHECK_EQUAL(audioPool->freeSamples.Num(), 2);
+
+    //only so many are kept around after a burst
+    SampleData *burst[40];
+    for (UINT i=0; i<40; i++)
+        burst[i] = MakeSample(audioPool, 0, audioSize, true);
+    for (UINT i=0; i<40; i++)
+        burst[i]->Release();
+
+    CHECK_EQUAL(audioPool->freeSamples.Num(), SAMPLE_POOL_MAX_FREE);
+
+    //a sample that's still out keeps its pool alive after the source lets go of it
+    SampleData *last = MakeSample(pool, 0, videoSize, false);
+    CHECK_EQUAL(pool->refs, 2);
+
+    pool->Release();
+    CHECK_EQUAL(pool->refs, 1);
+    CHECK(last->capacity >= videoSize);
+    last->Release();
+
+    audioPool->Release();
+}
+
+//no buffering delay, samples go out as their timestamps come up
+static void CheckWakeups()
+{
+    SamplePool *pool = new SamplePool;
+    SampleQueue queue;
+    TestOutput output;
+    SampleScheduler scheduler;
+
+    LONGLONG now = 12345*msTime;
+    scheduler.Reset(now, 0);
+
+    //nothing queued, nothing to wake up for
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), INFINITE);
+
+    //the first samples go straight out
+    now += msTime;
+    queue.Insert(MakeSample(pool, 0, videoSize, false));
+    queue.Insert(MakeSample(pool, 0, audioSize, true));
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), INFINITE);
+    CHECK_EQUAL(output.timestamps.Num(), 2);
+
+    //audio at 10, 20 and 30ms arriving out of order around a frame at 33.3ms.  the next one is 10ms away
+    now += msTime;
+    queue.Insert(MakeSample(pool, 333333, videoSize, false));
+    queue.Insert(MakeSample(pool, 200000, audioSize, true));
+    queue.Insert(MakeSample(pool, 100000, audioSize, true));
+    queue.Insert(MakeSample(pool, 300000, audioSize, true));
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), 10);
+    CHECK_EQUAL(output.timestamps.Num(), 2);
+
+    //woken up early by another sample coming in, the deadline stays where it was
+    now += 4*msTime;
+    queue.Insert(MakeSample(pool, 400000, audioSize, true));
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), 6);
+    CHECK_EQUAL(output.timestamps.Num(), 2);
+
+    //then one at a time as they're due, waits are rounded up so a sample is never early
+    now += 6*msTime;
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), 10);
+    CHECK_EQUAL(output.timestamps.Num(), 3);
+
+    now += 10*msTime;
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), 10);
+    CHECK_EQUAL(output.timestamps.Num(), 4);
+
+    now += 10*msTime;
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), 4);
+    CHECK_EQUAL(output.timestamps.Num(), 5);
+
+    now += 4*msTime;
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), 6);
+    CHECK_EQUAL(output.timestamps.Num(), 6);
+
+    now += 6*msTime;
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), INFINITE);
+    CHECK_EQUAL(output.timestamps.Num(), 7);
+
+    static const LONGLONG expected[] = {0, 0, 100000, 200000, 300000, 333333, 400000};
+    for (UINT i=0; i<output.timestamps.Num() && i<7; i++)
+        CHECK_EQUAL(output.timestamps[i], expected[i]);
+    CHECK(!output.audio[0] && output.audio[1] && !output.audio[5]);
+
+    //a thread that oversleeps puts out everything that's due at once
+    now += msTime;
+    queue.Insert(MakeSample(pool, 500000, audioSize, true));
+    queue.Insert(MakeSample(pool, 600000, audioSize, true));
+    queue.Insert(MakeSample(pool, 700000, audioSize, true));
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), 10);
+
+    now += 35*msTime;
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), INFINITE);
+    CHECK_EQUAL(output.timestamps.Num(), 10);
+
+    //a timestamp way off from the last one doesn't stall the queue for seconds
+    now += msTime;
+    queue.Insert(MakeSample(pool, 700000 + 5000*msTime, videoSize, false));
+    CHECK_EQUAL(scheduler.Update(now, 0, queue, &output), INFINITE);
+    CHECK_EQUAL(output.timestamps.Num(), 11);
+
+    CHECK(output.bDataIntact);
+    CHECK_EQUAL(pool->refs, 1);
+    pool->Release();
+}
+
+//a 500ms delay, then lowered and raised again
+static void CheckBufferDelay()
+{
+    SamplePool *pool = new SamplePool;
+    SampleQueue queue;
+    TestOutput output;
+    SampleScheduler scheduler;
+
+    LONGLONG delay = 500*msTime;
+    LONGLONG now = 777*msTime;
+    scheduler.Reset(now, delay);
+
+    //the first sample starts the delay
+    queue.Insert(MakeSample(pool, 0, videoSize, false));
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 500);
+
+    //later ones don't restart it
+    now += 33*msTime;
+    queue.Insert(MakeSample(pool, 333333, videoSize, false));
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 467);
+    CHECK_EQUAL(output.timestamps.Num(), 0);
+
+    //once it's full, samples go out spaced the way they came in.  time spent filling it doesn't count
+    //towards them, or the whole delay would come out at once
+    now += 467*msTime;
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 34);
+    CHECK_EQUAL(output.timestamps.Num(), 1);
+
+    now += 34*msTime;
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), INFINITE);
+    CHECK_EQUAL(output.timestamps.Num(), 2);
+
+    //a second's worth of audio, 50ms apart from 100ms on
+    now += msTime;
+    for (LONGLONG i=0; i<20; i++)
+        queue.Insert(MakeSample(pool, 100*msTime + i*50*msTime, audioSize, true));
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 66);
+
+    //lowering the delay to 200ms drops the first 300ms of what's queued and flushes the audio output
+    delay = 200*msTime;
+    now += msTime;
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 49);
+    CHECK_EQUAL(output.numFlushes, 1);
+    CHECK_EQUAL(output.timestamps.Num(), 2);
+    CHECK_EQUAL(queue.Num(), 14);
+    CHECK_EQUAL(queue[0]->timestamp, 400*msTime);
+
+    //raising it again holds everything back until the extra 300ms has been buffered
+    delay = 500*msTime;
+    now += msTime;
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 299);
+    CHECK_EQUAL(output.timestamps.Num(), 2);
+
+    //and then carries on where it left off
+    now += 299*msTime;
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 49);
+    CHECK_EQUAL(output.timestamps.Num(), 2);
+
+    now += 49*msTime;
+    CHECK_EQUAL(scheduler.Update(now, delay, queue, &output), 50);
+    CHECK_EQUAL(output.timestamps.Num(), 3);
+    CHECK_EQUAL(output.timestamps.Last(), 400*msTime);
+    CHECK_EQUAL(output.numFlushes, 1);
+
+    CHECK(output.bDataIntact);
+    CHECK_EQUAL(pool->refs, 1 + queue.Num());
+
+    ReleaseAll(queue);
+    pool->Release();
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    {
+        CheckOutOfOrder();
+        CheckResize();
+        CheckWakeups();
+        CheckBufferDelay();
+    }
+
+    TerminateXT();
+
+    return TestResult("SampleQueueTest");
+}
@@ -0,0 +1,216 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// the shader cache on its own, with made up blobs:  storing and loading them in memory and through a cache
+// folder, files that fail their checks being turned away, removal, the least recently used entries being
+// dropped once memory is over its limit, keys following the variant and #included files, and stale files
+// being cleaned out when the cache starts up.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+
+static void MakeBlob(List<BYTE> &blob, UINT size, BYTE seed)
+{
+    blob.SetSize(size);
+    for(UINT i=0; i<size; i++)
+        blob[i] = BYTE(i*31 + seed);
+}
+
+static bool HasEntry(QWORD key)
+{
+    List<BYTE> data;
+    return ShaderCacheLoad(key, data);
+}
+
+static bool LoadsBlob(QWORD key, const List<BYTE> &blob)
+{
+    List<BYTE> data;
+    return ShaderCacheLoad(key, data) && data.Num() == blob.Num() && mcmp(data.Array(), blob.Array(), blob.Num());
+}
+
+static String EntryPath(CTSTR lpFolder, QWORD key)
+{
+    return String(lpFolder) << TEXT("\\") << FormattedString(TEXT("%016llX"), key) << TEXT(".bin");
+}
+
+static void WriteTestFile(CTSTR lpPath, LPCVOID lpData, UINT size)
+{
+    XFile file(lpPath, XFILE_WRITE, XFILE_CREATEALWAYS);
+    file.Write(lpData, size);
+}
+
+static void ClearFolder(CTSTR lpFolder)
+{
+    OSFindData ofd;
+    HANDLE hFind = OSFindFirstFile(String(lpFolder) << TEXT("\\*"), ofd);
+    if(!hFind)
+        return;
+
+    do
+    {
+        if(!ofd.bDirectory)
+            OSDeleteFile(String(lpFolder) << TEXT("\\") << ofd.fileName);
+    } while(OSFindNextFile(hFind, ofd));
+
+    OSFindClose(hFind);
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    {
+        TCHAR tempDir[MAX_PATH];
+        GetTempPath(MAX_PATH, tempDir);
+        String strFolder = String(tempDir) << TEXT("ShaderCacheTest");
+
+        OSCreateDirectory(strFolder);
+        ClearFolder(strFolder);
+
+        //keys follow the source, the variant and what the source #includes
+        String strInclude = String(strFolder) << TEXT("\\common.inc");
+        WriteTestFile(strInclude, "float4 helper;", 14);
+
+        String strShaderFile = String(strFolder) << TEXT("\\test.pShader");
+        CTSTR lpShader = TEXT("#include \"common.inc\"\nfloat4 main() : SV_Target {return helper;}\n");
+
+        QWORD key = GetShaderCacheKey(lpShader, strShaderFile, "ps_4_0");
+        CHECK(key == GetShaderCacheKey(lpShader, strShaderFile, "ps_4_0"));
+        CHECK(key != GetShaderCacheKey(lpShader, strShaderFile, "ps_5_0"));
+        CHECK(key != GetShaderCacheKey(TEXT("float4 main() : SV_Target {return 0;}\n"), strShaderFile, "ps_4_0"));
+
+        WriteTestFile(strInclude, "float4 helper2;", 15);
+        QWORD changedIncludeKey = GetShaderCacheKey(lpShader, strShaderFile, "ps_4_0");
+        CHECK(key != changedIncludeKey);
+        OSDeleteFile(strInclude);
+
+        //memory only
+        InitShaderCache(NULL);
+
+        List<BYTE> blob;
+        MakeBlob(blob, 1000, 1);
+        CHECK(!HasEntry(key));
+        ShaderCacheStore(key, blob.Array(), blob.Num());
+        CHECK(LoadsBlob(key, blob));
+        ShaderCacheRemove(key);
+        CHECK(!HasEntry(key));
+
+        //the least recently used entries go once memory is over its limit (16mb).  loading one counts as using it
+        const UINT bigSize = 3*1024*1024;
+        List<BYTE> bigBlobs[6];
+        for(UINT i=0; i<5; i++)
+        {
+            MakeBlob(bigBlobs[i], bigSize, BYTE(i));
+            ShaderCacheStore(1000+i, bigBlobs[i].Array(), bigSize);
+        }
+
+        CHECK(LoadsBlob(1000, bigBlobs[0]));
+
+        MakeBlob(bigBlobs[5], bigSize, 5);
+        ShaderCacheStore(1005, bigBlobs[5].Array(), bigSize);
+
+        CHECK(!HasEntry(1001));
+        CHECK(LoadsBlob(1000, bigBlobs[0]));
+        for(UINT i=2; i<6; i++)
+            CHECK(LoadsBlob(1000+i, bigBlobs[i]));
+
+        FreeShaderCache();
+        CHECK(!HasEntry(1000));
+
+        //through the folder:  entries come back after the memory copy is gone
+        InitShaderCache(strFolder);
+        ShaderCacheStore(key, blob.Array(), blob.Num());
+        CHECK(OSFileExists(EntryPath(strFolder, key)));
+
+        FreeShaderCache();
+        InitShaderCache(strFolder);
+        CHECK(LoadsBlob(key, blob));
+
+        //the memory copy is still there after the file goes, until it's removed
+        OSDeleteFile(EntryPath(strFolder, key));
+        CHECK(LoadsBlob(key, blob));
+        ShaderCacheStore(key, blob.Array(), blob.Num());
+        ShaderCacheRemove(key);
+        CHECK(!OSFileExists(EntryPath(strFolder, key)));
+        CHECK(!HasEntry(key));
+
+        //files that don't pass their checks are turned away:  a flipped byte, a cut off file and a file
+        //stored under another key
+        ShaderCacheStore(key, blob.Array(), blob.Num());
+        FreeShaderCache();
+        InitShaderCache(strFolder);
+
+        String strPath = EntryPath(strFolder, key);
+        List<BYTE> fileData;
+        {
+            XFile file(strPath, XFILE_READ, XFILE_OPENEXISTING);
+            fileData.SetSize(UINT(file.GetFileSize()));
+            file.Read(fileData.Array(), fileData.Num());
+        }
+
+        fileData.Last() ^= 0xFF;
+        WriteTestFile(strPath, fileData.Array(), fileData.Num());
+        CHECK(!HasEntry(key));
+
+        fileData.Last() ^= 0xFF;
+        WriteTestFile(strPath, fileData.Array(), fileData.Num()-1);
+        CHECK(!HasEntry(key));
+
+        WriteTestFile(EntryPath(strFolder, changedIncludeKey), fileData.Array(), fileData.Num());
+        CHECK(!HasEntry(changedIncludeKey));
+
+        WriteTestFile(strPath, fileData.Array(), fileData.Num());
+        CHECK(LoadsBlob(key, blob));
+
+        //starting up clears out files left over from an interrupted store and files unused for over a month
+        FreeShaderCache();
+
+        String strTempPath = strPath + TEXT(".1234.tmp");
+        WriteTestFile(strTempPath, fileData.Array(), fileData.Num());
+
+        String strOldPath = EntryPath(strFolder, 2000);
+        WriteTestFile(strOldPath, fileData.Array(), fileData.Num());
+
+        HANDLE hFile = CreateFile(strOldPath, FILE_WRITE_ATTRIBUTES, 0, NULL, OPEN_EXISTING, 0, NULL);
+        FILETIME fileTime;
+        GetSystemTimeAsFileTime(&fileTime);
+        ULARGE_INTEGER time;
+        time.LowPart = fileTime.dwLowDateTime;
+        time.HighPart = fileTime.dwHighDateTime;
+        time.QuadPart -= 31ULL*24*60*60*10000000;
+        fileTime.dwLowDateTime = time.LowPart;
+        fileTime.dwHighDateTime = time.HighPart;
+        SetFileTime(hFile, NULL, NULL, &fileTime);
+        CloseHandle(hFile);
+
+        InitShaderCache(strFolder);
+        CHECK(!OSFileExists(strTempPath));
+        CHECK(!OSFileExists(strOldPath));
+        CHECK(OSFileExists(strPath));
+        CHECK(LoadsBlob(key, blob));
+
+        FreeShaderCache();
+        ClearFolder(strFolder);
+        RemoveDirectory(strFolder);
+    }
+
+    TerminateXT();
+    return TestResult("ShaderCacheTest");
+}
@@ -0,0 +1,139 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// lexing and processing the biggest shipped shaders with CodeTokenList against the CodeTokenizer versions,
+// uncached, the way a first start or a changed shader goes.  then the same shaders coming back out of the
+// shader cache, from memory and from the cache folder the way a restart goes.  runs from rundir.
+
+#include "ShaderProcessorLegacy.h"     //Main.h has to come before the winsock headers TestCommon.h pulls in
+#include "TestCommon.h"
+
+static CTSTR benchmarkShaders[] =
+{
+    TEXT("shaders/DownscaleLanczos6tapYUV.pShader"),
+    TEXT("shaders/DrawTexture_ColorAdjust.pShader"),
+    TEXT("shaders/DrawTexture.vShader"),
+    TEXT("plugins/DShowPlugin/shaders/Deinterlace_yadif.pShader"),
+};
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    {
+        TCHAR tempDir[MAX_PATH];
+        GetTempPath(MAX_PATH, tempDir);
+        String strCacheFolder = String(tempDir) << TEXT("ShaderProcessorBenchmarkCache");
+        OSCreateDirectory(strCacheFolder);
+        InitShaderCache(strCacheFolder);
+
+        for(UINT i=0; i<_countof(benchmarkShaders); i++)
+        {
+            CTSTR lpFile = benchmarkShaders[i];
+
+            XFile file;
+            if(!file.Open(lpFile, XFILE_READ | XFILE_SHARED, XFILE_OPENEXISTING))
+            {
+                CHECK(!"couldn't open a shader");
+                continue;
+            }
+
+            String strShader;
+            file.ReadFileToString(strShader);
+            file.Close();
+
+            printf("%S (%u characters)\n", lpFile, strShader.Length());
+
+            Benchmark("  CodeTokenizer, all tokens", [&]
+            {
+                CodeTokenizer tokenizer;
+                tokenizer.SetCodeStart(strShader);
+
+                String strToken;
+                UINT numTokens = 0;
+                while(tokenizer.GetNextToken(strToken))
+                    numTokens++;
+                DoNotOptimize(numTokens);
+            });
+
+            Benchmark("  CodeTokenList::Tokenize", [&]
+            {
+                CodeTokenList code;
+                code.Tokenize(strShader);
+                DoNotOptimize(code.Num());
+            });
+
+            Benchmark("  LegacyShaderProcessor::ProcessShader", [&]
+            {
+                LegacyShaderProcessor legacy;
+                legacy.ProcessShader(strShader, lpFile);
+                DoNotOptimize(legacy.Params.Num());
+            });
+
+            Benchmark("  ShaderProcessor::ProcessShader", [&]
+            {
+                ShaderProcessor processor;
+                processor.ProcessShader(strShader, lpFile);
+                DoNotOptimize(processor.Params.Num());
+            });
+
+            ShaderProcessor stored;
+            CHECK(stored.ProcessShaderCached(strShader, lpFile));
+
+            Benchmark("  ShaderProcessor::ProcessShaderCached, in memory", [&]
+            {
+                ShaderProcessor processor;
+                processor.ProcessShaderCached(strShader, lpFile);
+                DoNotOptimize(processor.Params.Num());
+            });
+
+            Benchmark("  ShaderProcessor::ProcessShaderCached, from the folder", [&]
+            {
+                FreeShaderCache();
+                InitShaderCache(strCacheFolder);
+
+                ShaderProcessor processor;
+                processor.ProcessShaderCached(strShader, lpFile);
+                DoNotOptimize(processor.Params.Num());
+            });
+        }
+
+        FreeShaderCache();
+
+        OSFindData ofd;
+        HANDLE hFind = OSFindFirstFile(String(strCacheFolder) << TEXT("\\*"), ofd);
+        if(hFind)
+        {
+            do
+            {
+                if(!ofd.bDirectory)
+                    OSDeleteFile(String(strCacheFolder) << TEXT("\\") << ofd.fileName);
+            } while(OSFindNextFile(hFind, ofd));
+
+            OSFindClose(hFind);
+        }
+
+        RemoveDirectory(strCacheFolder);
+    }
+
+    TerminateXT();
+    return TestResult("ShaderProcessorBenchmark");
+}
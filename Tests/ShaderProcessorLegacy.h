@@ -0,0 +1,57 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+#include "Main.h"
+
+//-------------------------------------------
+// the CodeTokenizer based ShaderProcessor, see ShaderProcessorLegacy.cpp
+
+struct LegacyShaderProcessor : CodeTokenizer
+{
+    BOOL ProcessShader(CTSTR input, CTSTR filename);
+    BOOL AddState(SamplerInfo &info, String &stateName, String &stateVal);
+
+    UINT nTextures;
+    List<ShaderSampler> Samplers;
+    List<ShaderParam>   Params;
+
+    List<D3D11_INPUT_ELEMENT_DESC> generatedLayout;
+
+    bool bHasNormals;
+    bool bHasColors;
+    bool bHasTangents;
+    UINT numTextureCoords;
+
+    inline LegacyShaderProcessor()  {zero(this, sizeof(LegacyShaderProcessor));}
+    inline ~LegacyShaderProcessor() {FreeData();}
+
+    inline void FreeData()
+    {
+        UINT i;
+        for(i=0; i<Samplers.Num(); i++)
+            Samplers[i].FreeData();
+        Samplers.Clear();
+        for(i=0; i<Params.Num(); i++)
+            Params[i].FreeData();
+        Params.Clear();
+    }
+};
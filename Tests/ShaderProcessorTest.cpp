@@ -0,0 +1,325 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// ShaderProcessor on CodeTokenList against the CodeTokenizer version it replaced, over every shipped shader
+// and a few made up ones that hit the odd corners (hex and exponent numbers, border colors, arrays, vertex
+// structures that stop being one halfway through).  the tokens, the vertex layout, the sampler states and
+// the parameters all have to come out the same.  every shader also goes through the shader cache and has to
+// come back out of it the same as it went in.  runs from rundir so the shaders can be found.
+
+#include "ShaderProcessorLegacy.h"     //Main.h has to come before the winsock headers TestCommon.h pulls in
+#include "TestCommon.h"
+
+static CTSTR testShaders[] =
+{
+    TEXT("uniform float4x4 ViewProj;\n")
+    TEXT("uniform Texture2D diffuseTexture;\n")
+    TEXT("struct VertData\n{\n")
+    TEXT("    float4 pos      : SV_Position;\n")
+    TEXT("    float3 norm     : NORMAL;\n")
+    TEXT("    float4 color    : COLOR;\n")
+    TEXT("    float4 tangent  : TANGENT;\n")
+    TEXT("    float2 texCoord : TEXCOORD0;\n")
+    TEXT("    float2 texCoord2: TEXCOORD1;\n")
+    TEXT("};\n")
+    TEXT("VertData main(VertData input) {input.pos = mul(float4(input.pos.xyz, 1.0), ViewProj); return input;}\n"),
+
+    TEXT("SamplerState pointSampler\n{\n")
+    TEXT("    Filter   = MIN_MAG_MIP_POINT;\n")
+    TEXT("    AddressU = Clamp;\n")
+    TEXT("    AddressV = Mirror;\n")
+    TEXT("    AddressW = Border;\n")
+    TEXT("    MaxAnisotropy = 4;\n")
+    TEXT("    BorderColor = {0.25, 0.5f, 1e-5, 1.0};\n")
+    TEXT("};\n")
+    TEXT("SamplerState hexSampler {Filter = Anisotropic; AddressU = MirrorOnce; BorderColor = 0xFF00FF80;};\n")
+    TEXT("SamplerState linearSampler {Filter = MIN_LINEAR_MAG_POINT_MIP_LINEAR; AddressU = Wrap; AddressV = Repeat;};\n")
+    TEXT("float4 main(float4 pos : SV_Position) : SV_Target {return pos;}\n"),
+
+    TEXT("uniform float gamma = 2.2;\n")
+    TEXT("uniform float small = 1.5e-3;\n")
+    TEXT("uniform int mask = 0x00FF;\n")
+    TEXT("uniform bool bEnabled;\n")
+    TEXT("uniform float2 offset = {0.5f, -0.25};\n")
+    TEXT("uniform float3 tint = {1.0, 0.75, 0.5};\n")
+    TEXT("uniform float4 weights[4];\n")
+    TEXT("uniform float3x3 colorMatrix = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};\n")
+    TEXT("uniform Texture2D planes[3];\n")
+    TEXT("/* a comment with { and ( in it */\n")
+    TEXT("// SamplerState commented {Filter = Point;};\n")
+    TEXT("float4 helper(float4 a) {return a*gamma;}\n")
+    TEXT("float4 main(float4 pos : SV_Position) : SV_Target {return helper(pos);}\n"),
+
+    //stops being a vertex structure at the int, so there shouldn't be a layout
+    TEXT("struct Mixed\n{\n")
+    TEXT("    float4 pos : SV_Position;\n")
+    TEXT("    int id;\n")
+    TEXT("};\n")
+    TEXT("struct NoSemantics {float4 a; float4 b;};\n")
+    TEXT("uniform float after;\n"),
+};
+
+static bool SameTokens(CTSTR lpShader)
+{
+    CodeTokenizer tokenizer;
+    tokenizer.SetCodeStart(lpShader);
+
+    CodeTokenList code;
+    code.Tokenize(lpShader);
+
+    String strToken;
+    UINT pos = 0;
+    while(tokenizer.GetNextToken(strToken))
+    {
+        if(pos >= code.Num() || scmp(strToken, code.Text(pos)) != 0 || strToken.Length() != code.Length(pos))
+            return false;
+        pos++;
+    }
+
+    return pos == code.Num();
+}
+
+//legacy is either a LegacyShaderProcessor or another ShaderProcessor
+template<typename T> static void CheckSameOutput(ShaderProcessor &processor, T &legacy)
+{
+    CHECK_EQUAL(processor.nTextures, legacy.nTextures);
+    CHECK_EQUAL(processor.bHasNormals, legacy.bHasNormals);
+    CHECK_EQUAL(processor.bHasColors, legacy.bHasColors);
+    CHECK_EQUAL(processor.bHasTangents, legacy.bHasTangents);
+    CHECK_EQUAL(processor.numTextureCoords, legacy.numTextureCoords);
+
+    //semantic names point at the same strings in both, so the pointers can be compared
+    CHECK_EQUAL(processor.generatedLayout.Num(), legacy.generatedLayout.Num());
+    for(UINT i=0; i<processor.generatedLayout.Num() && i<legacy.generatedLayout.Num(); i++)
+    {
+        D3D11_INPUT_ELEMENT_DESC &element = processor.generatedLayout[i];
+        D3D11_INPUT_ELEMENT_DESC &legacyElement = legacy.generatedLayout[i];
+
+        CHECK(element.SemanticName == legacyElement.SemanticName);
+        CHECK_EQUAL(element.SemanticIndex, legacyElement.SemanticIndex);
+        CHECK_EQUAL(element.Format, legacyElement.Format);
+        CHECK_EQUAL(element.InputSlot, legacyElement.InputSlot);
+        CHECK_EQUAL(element.AlignedByteOffset, legacyElement.AlignedByteOffset);
+        CHECK_EQUAL(element.InputSlotClass, legacyElement.InputSlotClass);
+    }
+
+    CHECK_EQUAL(processor.Samplers.Num(), legacy.Samplers.Num());
+    for(UINT i=0; i<processor.Samplers.Num() && i<legacy.Samplers.Num(); i++)
+    {
+        ShaderSampler &sampler = processor.Samplers[i];
+        ShaderSampler &legacySampler = legacy.Samplers[i];
+
+        CHECK(sampler.name.Compare(legacySampler.name));
+        CHECK(mcmp(&sampler.info, &legacySampler.info, sizeof(SamplerInfo)));
+    }
+
+    CHECK_EQUAL(processor.Params.Num(), legacy.Params.Num());
+    for(UINT i=0; i<processor.Params.Num() && i<legacy.Params.Num(); i++)
+    {
+        ShaderParam &param = processor.Params[i];
+        ShaderParam &legacyParam = legacy.Params[i];
+
+        CHECK(param.name.Compare(legacyParam.name));
+        CHECK_EQUAL(param.type, legacyParam.type);
+        CHECK_EQUAL(param.textureID, legacyParam.textureID);
+        CHECK_EQUAL(param.arrayCount, legacyParam.arrayCount);
+        CHECK(param.defaultValue.Num() == legacyParam.defaultValue.Num() &&
+              mcmp(param.defaultValue.Array(), legacyParam.defaultValue.Array(), param.defaultValue.Num()));
+    }
+}
+
+static void CheckSameResults(CTSTR lpName, CTSTR lpShader)
+{
+    ShaderProcessor processor;
+    LegacyShaderProcessor legacy;
+
+    BOOL bSuccess = processor.ProcessShader(lpShader, lpName);
+    BOOL bLegacySuccess = legacy.ProcessShader(lpShader, lpName);
+
+    UINT numFailures = TestFailureCount();
+
+    CHECK(SameTokens(lpShader));
+    CHECK_EQUAL(bSuccess, bLegacySuccess);
+    CheckSameOutput(processor, legacy);
+
+    if(TestFailureCount() != numFailures)
+        fwprintf(stderr, L"  in %s\n", lpName);
+}
+
+//the cache folder only ever holds the one shader being checked, its file name is the key
+static bool FindCachedKey(CTSTR lpCacheFolder, QWORD &key)
+{
+    OSFindData ofd;
+    HANDLE hFind = OSFindFirstFile(String(lpCacheFolder) << TEXT("\\*.bin"), ofd);
+    if(!hFind)
+        return false;
+
+    key = _wcstoui64(ofd.fileName, NULL, 16);
+    OSFindClose(hFind);
+    return true;
+}
+
+static void ClearCacheFolder(CTSTR lpCacheFolder)
+{
+    OSFindData ofd;
+    HANDLE hFind = OSFindFirstFile(String(lpCacheFolder) << TEXT("\\*"), ofd);
+    if(!hFind)
+        return;
+
+    do
+    {
+        if(!ofd.bDirectory)
+            OSDeleteFile(String(lpCacheFolder) << TEXT("\\") << ofd.fileName);
+    } while(OSFindNextFile(hFind, ofd));
+
+    OSFindClose(hFind);
+}
+
+//stored by one ProcessShaderCached and loaded by the next once the memory copy is gone.  an entry with data
+//left over after it's read back is thrown out and replaced rather than used
+static void CheckCachedResults(CTSTR lpName, CTSTR lpShader, CTSTR lpCacheFolder)
+{
+    ShaderProcessor processor;
+    if(!processor.ProcessShader(lpShader, lpName))
+        return;
+
+    UINT numFailures = TestFailureCount();
+
+    FreeShaderCache();
+    ClearCacheFolder(lpCacheFolder);
+    InitShaderCache(lpCacheFolder);
+
+    ShaderProcessor stored;
+    CHECK(stored.ProcessShaderCached(lpShader, lpName));
+    CheckSameOutput(processor, stored);
+
+    QWORD key = 0;
+    List<BYTE> data;
+    CHECK(FindCachedKey(lpCacheFolder, key) && ShaderCacheLoad(key, data));
+    UINT dataSize = data.Num();
+
+    FreeShaderCache();
+    InitShaderCache(lpCacheFolder);
+
+    ShaderProcessor loaded;
+    CHECK(loaded.ProcessShaderCached(lpShader, lpName));
+    CheckSameOutput(processor, loaded);
+
+    data << 0x12 << 0x34;
+    FreeShaderCache();
+    InitShaderCache(lpCacheFolder);
+    ShaderCacheStore(key, data.Array(), data.Num());
+
+    ShaderProcessor replaced;
+    CHECK(replaced.ProcessShaderCached(lpShader, lpName));
+    CheckSameOutput(processor, replaced);
+    CHECK(ShaderCacheLoad(key, data) && data.Num() == dataSize);
+
+    if(TestFailureCount() != numFailures)
+        fwprintf(stderr, L"  cached, in %s\n", lpName);
+}
+
+static void FindShaderFiles(StringList &files, CTSTR lpFolder)
+{
+    CTSTR extensions[] = {TEXT("*.vShader"), TEXT("*.pShader")};
+
+    for(UINT i=0; i<2; i++)
+    {
+        String strSearch;
+        strSearch << lpFolder << TEXT("/") << extensions[i];
+
+        OSFindData ofd;
+        HANDLE hFind = OSFindFirstFile(strSearch, ofd);
+        if(!hFind)
+            continue;
+
+        do
+        {
+            if(!ofd.bDirectory)
+                files << (String() << lpFolder << TEXT("/") << ofd.fileName);
+        } while(OSFindNextFile(hFind, ofd));
+
+        OSFindClose(hFind);
+    }
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    {
+        TCHAR tempDir[MAX_PATH];
+        GetTempPath(MAX_PATH, tempDir);
+        String strCacheFolder = String(tempDir) << TEXT("ShaderProcessorTestCache");
+        OSCreateDirectory(strCacheFolder);
+
+        for(UINT i=0; i<_countof(testShaders); i++)
+        {
+            String strName = FormattedString(TEXT("testShaders[%u]"), i);
+            CheckSameResults(strName, testShaders[i]);
+            CheckCachedResults(strName, testShaders[i], strCacheFolder);
+        }
+
+        StringList files;
+        FindShaderFiles(files, TEXT("shaders"));
+
+        OSFindData ofd;
+        HANDLE hFind = OSFindFirstFile(TEXT("plugins/*"), ofd);
+        if(hFind)
+        {
+            do
+            {
+                if(ofd.bDirectory && ofd.fileName[0] != '.')
+                    FindShaderFiles(files, String() << TEXT("plugins/") << ofd.fileName << TEXT("/shaders"));
+            } while(OSFindNextFile(hFind, ofd));
+
+            OSFindClose(hFind);
+        }
+
+        CHECK(files.Num() != 0);
+
+        for(UINT i=0; i<files.Num(); i++)
+        {
+            XFile file;
+            if(!file.Open(files[i], XFILE_READ | XFILE_SHARED, XFILE_OPENEXISTING))
+            {
+                CHECK(!"couldn't open a shader");
+                continue;
+            }
+
+            String strShader;
+            file.ReadFileToString(strShader);
+            file.Close();
+
+            CheckSameResults(files[i], strShader);
+            CheckCachedResults(files[i], strShader, strCacheFolder);
+        }
+
+        printf("compared %u shaders\n", files.Num()+UINT(_countof(testShaders)));
+
+        FreeShaderCache();
+        ClearCacheFolder(strCacheFolder);
+        RemoveDirectory(strCacheFolder);
+    }
+
+    TerminateXT();
+    return TestResult("ShaderProcessorTest");
+}
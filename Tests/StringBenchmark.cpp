@@ -0,0 +1,125 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// Log() throughput and String::FindReplace:  log lines are put together in a per-thread buffer, and
+// FindReplace does a single pass whether the replacement is shorter, longer or the same length.  the
+// results are checked against the expected text before anything is timed.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+
+//a few kilobytes of scene collection like text with paths to replace
+static String MakeText()
+{
+    String strText;
+    for(UINT i=0; i<100; i++)
+        strText << TEXT("path : \"C:\\Users\\streamer\\Pictures\\overlay") << i << TEXT(".png\"\r\n");
+    return strText;
+}
+
+int main()
+{
+    TCHAR tempDir[MAX_PATH];
+    GetTempPath(MAX_PATH, tempDir);
+    String strLogPath = String(tempDir) << TEXT("StringBenchmark.log");
+
+    InitXT(strLogPath, TEXT("FastAlloc"));
+
+    {
+        //FindReplace shorter, longer, the same length and at the ends of the string
+        String strTest = TEXT("abcabcabc");
+        CHECK(String(strTest).FindReplace(TEXT("abc"), TEXT("x")) == TEXT("xxx"));
+        CHECK(String(strTest).FindReplace(TEXT("b"), TEXT("BBB")) == TEXT("aBBBcaBBBcaBBBc"));
+        CHECK(String(strTest).FindReplace(TEXT("c"), TEXT("C")) == TEXT("abCabCabC"));
+        CHECK(String(strTest).FindReplace(TEXT("abc"), TEXT("")).IsEmpty());
+        CHECK(String(strTest).FindReplace(TEXT("zz"), TEXT("y")) == strTest);
+        CHECK(String(TEXT("aaaa")).FindReplace(TEXT("aa"), TEXT("a")) == TEXT("aa"));
+
+        String strText = MakeText();
+        String strLonger = String(strText).FindReplace(TEXT("\\"), TEXT("/"));
+        strLonger.FindReplace(TEXT("Pictures"), TEXT("Pictures/Stream Overlays"));
+        CHECK(strLonger.Length() == strText.Length() + 100*16);
+        CHECK(sstr(strLonger, TEXT("\\")) == NULL);
+
+        //appending in a loop grows by half again rather than to the exact length
+        String strAppend;
+        for(UINT i=0; i<1000; i++)
+            strAppend << TEXT("0123456789");
+        CHECK_EQUAL(strAppend.Length(), 10000);
+        CHECK(strAppend.Capacity() < 20000);
+
+        Benchmark("String::FindReplace, same length", [&] {
+            String strCopy = strText;
+            DoNotOptimize(strCopy.FindReplace(TEXT("\\"), TEXT("/")).Length());
+        });
+
+        Benchmark("String::FindReplace, shorter", [&] {
+            String strCopy = strText;
+            DoNotOptimize(strCopy.FindReplace(TEXT("\\Users\\streamer"), TEXT("~")).Length());
+        });
+
+        Benchmark("String::FindReplace, longer", [&] {
+            String strCopy = strText;
+            DoNotOptimize(strCopy.FindReplace(TEXT("overlay"), TEXT("stream_overlay_")).Length());
+        });
+
+        //the time stamp and separator the log puts in front of every line
+        String strTime = TEXT("12:34:56");
+        Benchmark("String::operator+, short strings", [&] {
+            String strPrefix = strTime + TEXT(": ");
+            DoNotOptimize(strPrefix.Length());
+        });
+
+        Benchmark("String::operator<<, 1000 appends", [&] {
+            String strOut;
+            for(UINT i=0; i<1000; i++)
+                strOut << TEXT("line ") << i << TEXT("\r\n");
+            DoNotOptimize(strOut.Length());
+        });
+
+        //log lines land in the log with their time stamps, a multi-line message gets one on every line
+        Log(TEXT("StringBenchmark single %d %s"), 42, TEXT("line"));
+        Log(TEXT("StringBenchmark first\nStringBenchmark second"));
+
+        String strLog;
+        ReadLog(strLog);
+        CHECK(sstr(strLog, TEXT(": StringBenchmark single 42 line")) != NULL);
+        CHECK(sstr(strLog, TEXT(": StringBenchmark first\n")) != NULL);
+        CHECK(sstr(strLog, TEXT(": StringBenchmark second")) != NULL);
+
+        UINT i = 0;
+        Benchmark("Log, short line", [&] {
+            Log(TEXT("frame %u: %d dropped"), i++, 0);
+        });
+
+        Benchmark("Log, formatted values", [&] {
+            Log(TEXT("  %s: %d x %d at %.2f fps, bitrate %u kbps, buffer %u ms"), TEXT("video encoder"), 1920, 1080, 59.94, 3500u, 3000u);
+        });
+
+        Benchmark("Log, multi-line", [&] {
+            Log(TEXT("settings:\n  width: %d\n  height: %d\n  fps: %d"), 1280, 720, 30);
+        });
+    }
+
+    TerminateXT();
+    OSDeleteFile(strLogPath);
+    return TestResult("StringBenchmark");
+}
@@ -0,0 +1,146 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+//-------------------------------------------
+// rtmps:// through librtmp's SChannel client (tls_sspi.c) against the local TLS stand-in:  publishing,
+// session resumption on reconnect, and that a stalled socket can neither hold a send for longer than the
+// timeout nor past the abort event.  windows only.
+
+#include "IngestServer/IngestServer.h"
+#include "IngestServer/TestPublisher.h"
+#include "IngestServer/TLSStandIn.h"
+
+#include "log.h"
+#include "tls_sspi.h"
+
+static TLSSession* GetSession(TestPublisher &publisher)
+{
+    return publisher.GetRTMP() ? (TLSSession*)publisher.GetRTMP()->m_sb.sb_ssl : NULL;
+}
+
+//the socket loop in RTMPPublisher sends on a non-blocking socket
+static void SetNonBlocking(TestPublisher &publisher)
+{
+    u_long one = 1;
+    ioctlsocket(publisher.GetRTMP()->m_sb.sb_socket, FIONBIO, &one);
+}
+
+//sends until a send fails, returns how long the failing send took in ms
+static QWORD SendUntilFailure(TestPublisher &publisher)
+{
+    for(UINT i=0; i<10000; i++)
+    {
+        QWORD startTime = TestTimeMS();
+        if(!publisher.SendVideo(i*33, i == 0, 64000))
+            return TestTimeMS()-startTime;
+    }
+
+    CHECK(!"sends never failed");
+    return 0;
+}
+
+int main()
+{
+    //failures below are on purpose
+    RTMP_LogSetLevel(RTMP_LOGCRIT);
+
+    IngestServer server;
+    CHECK(server.Start());
+
+    TLSStandIn standIn;
+    CHECK(standIn.Start(server.GetPort()));
+
+    //publish over TLS, the second connection to the same host resumes the session
+    for(UINT i=0; i<2; i++)
+    {
+        server.ResetStats();
+
+        TestPublisher publisher;
+        publisher.SetTLS(true);
+        CHECK(publisher.Connect(standIn.GetPort()));
+        CHECK(GetSession(publisher) != NULL);
+        CHECK(server.WaitForPublish(1, 5000));
+
+        for(UINT frame=0; frame<30; frame++)
+        {
+            CHECK(publisher.SendVideo(frame*33, frame == 0, 20000, TestUnixTimeMS()));
+            CHECK(publisher.SendAudio(frame*33, 300));
+        }
+
+        CHECK(server.WaitForVideo(30, 5000));
+        CHECK_EQUAL(server.GetStats().numProbes, 30);
+
+        if(i == 1)
+            CHECK(GetSession(publisher) && TLS_SSPI_IsResumed(GetSession(publisher)));
+    }
+    CHECK_EQUAL(standIn.NumHandshakes(), 2);
+
+    //a stalled socket fails the send once the timeout passes
+    {
+        TestPublisher publisher;
+        publisher.SetTLS(true);
+        CHECK(publisher.Connect(standIn.GetPort()));
+
+        HANDLE hAbort = CreateEvent(NULL, TRUE, FALSE, NULL);
+        TLS_SSPI_SetTimeout(GetSession(publisher), 500, hAbort);
+        SetNonBlocking(publisher);
+
+        standIn.SetPaused(true);
+        QWORD sendTime = SendUntilFailure(publisher);
+        standIn.SetPaused(false);
+
+        //the failing send may also wait out the unpublish and close_notify the close sends
+        printf("stalled send with a 500 ms timeout failed after %u ms\n", UINT(sendTime));
+        CHECK(sendTime >= 500 && sendTime < 5000);
+
+        CloseHandle(hAbort);
+    }
+
+    //and the abort event ends the wait long before a long timeout
+    {
+        TestPublisher publisher;
+        publisher.SetTLS(true);
+        CHECK(publisher.Connect(standIn.GetPort()));
+
+        HANDLE hAbort = CreateEvent(NULL, TRUE, FALSE, NULL);
+        TLS_SSPI_SetTimeout(GetSession(publisher), 60000, hAbort);
+        SetNonBlocking(publisher);
+
+        standIn.SetPaused(true);
+        std::thread abortThread([hAbort] {TestSleep(300); SetEvent(hAbort);});
+
+        QWORD startTime = TestTimeMS();
+        SendUntilFailure(publisher);
+        QWORD abortTime = TestTimeMS()-startTime;
+
+        abortThread.join();
+        standIn.SetPaused(false);
+
+        printf("stalled send aborted %u ms after the sends started\n", UINT(abortTime));
+        CHECK(abortTime < 5000);
+
+        publisher.Close();
+        CloseHandle(hAbort);
+    }
+
+    standIn.Stop();
+    server.Stop();
+
+    return TestResult("TLSStandInTest");
+}
@@ -0,0 +1,84 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+//-------------------------------------------
+// writes small 24 bit .bmp files for the image cache tests, GDI+ decodes them without any codec of its own.
+// the pixels are a pattern picked by seed, so the same seed makes byte for byte the same file.
+
+inline String TestImageFolder()
+{
+    TCHAR tempPath[MAX_PATH];
+    GetTempPath(MAX_PATH, tempPath);
+
+    String strFolder;
+    strFolder << tempPath << TEXT("OBSImageCacheTest");
+    OSCreateDirectory(strFolder);
+    return strFolder;
+}
+
+inline String WriteTestBitmap(CTSTR lpName, UINT cx, UINT cy, UINT seed)
+{
+    String strPath;
+    strPath << TestImageFolder() << TEXT("\\") << lpName;
+
+    UINT pitch = (cx*3 + 3) & ~3;
+    List<BYTE> pixels;
+    pixels.SetSize(pitch*cy);
+
+    for(UINT y=0; y<cy; y++)
+    {
+        for(UINT x=0; x<cx; x++)
+        {
+            BYTE *pixel = pixels.Array() + y*pitch + x*3;
+            pixel[0] = BYTE(x*7 + seed);
+            pixel[1] = BYTE(y*5 + seed*3);
+            pixel[2] = BYTE((x^y) + seed*11);
+        }
+    }
+
+    BITMAPFILEHEADER fileHeader;
+    BITMAPINFOHEADER infoHeader;
+    zero(&fileHeader, sizeof(fileHeader));
+    zero(&infoHeader, sizeof(infoHeader));
+
+    fileHeader.bfType = 0x4D42; //BM
+    fileHeader.bfOffBits = sizeof(fileHeader)+sizeof(infoHeader);
+    fileHeader.bfSize = fileHeader.bfOffBits+pixels.Num();
+
+    infoHeader.biSize = sizeof(infoHeader);
+    infoHeader.biWidth = cx;
+    infoHeader.biHeight = cy;
+    infoHeader.biPlanes = 1;
+    infoHeader.biBitCount = 24;
+    infoHeader.biCompression = BI_RGB;
+    infoHeader.biSizeImage = pixels.Num();
+
+    XFile file;
+    if(file.Open(strPath, XFILE_WRITE, XFILE_CREATEALWAYS))
+    {
+        file.Write(&fileHeader, sizeof(fileHeader));
+        file.Write(&infoHeader, sizeof(infoHeader));
+        file.Write(pixels.Array(), pixels.Num());
+    }
+
+    return strPath;
+}
@@ -0,0 +1,125 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+#pragma once
+
+//-------------------------------------------
+// shared bits for the tests and benchmarks.  every test is its own executable that returns non-zero
+// when a check failed, and every benchmark prints one line per measurement so runs can be diffed.
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include "Compat/WinTypes.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+
+inline int& TestFailureCount()
+{
+    static int numFailures = 0;
+    return numFailures;
+}
+
+#define CHECK(expr) \
+    do { \
+        if(!(expr)) \
+        { \
+            fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #expr); \
+            TestFailureCount()++; \
+        } \
+    } while(0)
+
+#define CHECK_EQUAL(a, b) \
+    do { \
+        if(!((a) == (b))) \
+        { \
+            fprintf(stderr, "%s(%d): check failed: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, #a, #b, (long long)(a), (long long)(b)); \
+            TestFailureCount()++; \
+        } \
+    } while(0)
+
+inline int TestResult(const char *name)
+{
+    if(TestFailureCount())
+        printf("%s: %d check(s) failed\n", name, TestFailureCount());
+    else
+        printf("%s: passed\n", name);
+
+    return TestFailureCount() ? 1 : 0;
+}
+
+//-------------------------------------------
+// timing
+
+inline QWORD TestTimeNS()
+{
+    return (QWORD)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline QWORD TestTimeMS()
+{
+    return TestTimeNS()/1000000;
+}
+
+inline QWORD TestUnixTimeMS()
+{
+    return (QWORD)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline void TestSleep(UINT ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+//runs func until at least minTimeMS has passed and prints the average time per iteration
+template<typename T> double Benchmark(const char *name, T func, UINT minTimeMS=200)
+{
+    func(); //warm up
+
+    QWORD startTime = TestTimeNS(), curTime;
+    QWORD numIterations = 0;
+    do
+    {
+        func();
+        numIterations++;
+        curTime = TestTimeNS();
+    } while(curTime-startTime < QWORD(minTimeMS)*1000000);
+
+    double nsPerIteration = double(curTime-startTime)/double(numIterations);
+    printf("%-48s %14.1f ns/iter  (%llu iterations)\n", name, nsPerIteration, (unsigned long long)numIterations);
+    fflush(stdout);
+
+    return nsPerIteration;
+}
+
+//keeps the optimizer from throwing away results in benchmarks
+template<typename T> inline void DoNotOptimize(const T &val)
+{
+    static volatile const void *sink;
+    sink = &val;
+}
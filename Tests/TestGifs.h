@@ -0,0 +1,184 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+#pragma once
+
+//-------------------------------------------
+// writes animated gifs for the BitmapImage tests.  every frame covers the whole image and uses one 256 color
+// palette.  the lzw data is never actually compressed, a clear code goes out before the codes would get
+// wider, which keeps this short and is still a gif any decoder has to handle.  the pictures are flat
+// color bands with a square moving across them, which is what most animated gifs look like.
+
+#define TEST_GIF_DELAY 4 //in 1/100 seconds
+
+inline BYTE TestGifPixel(UINT x, UINT y, UINT frame, UINT cx, UINT cy)
+{
+    UINT squareSize = MAX(cy/4, 1);
+    UINT squareX = (frame*8) % cx, squareY = cy/2;
+
+    if(x >= squareX && x < squareX+squareSize && y >= squareY && y < squareY+squareSize)
+        return BYTE(200 + (frame%8));
+
+    return BYTE((y/16 + frame/4) % 16);
+}
+
+//the most lzw data a frame can come to
+inline UINT MaxTestGifLZWSize(UINT numPixels)
+{
+    return (numPixels + numPixels/250 + 3)*9/8 + 2;
+}
+
+//writes into a buffer sized up front, a List grows with a reallocation every time which would take ages
+//for the big ones
+struct TestGifWriter
+{
+    List<BYTE> &data;
+    UINT pos;
+
+    inline TestGifWriter(List<BYTE> &data, UINT maxSize) : data(data), pos(0) {data.SetSize(maxSize);}
+    inline ~TestGifWriter() {data.SetSize(pos);}
+
+    inline void Byte(BYTE val)                      {data[pos++] = val;}
+    inline void Word(UINT val)                      {Byte(BYTE(val)); Byte(BYTE(val >> 8));}
+    inline void Bytes(const void *lpData, UINT size) {mcpy(data.Array()+pos, lpData, size); pos += size;}
+};
+
+//one frame's palette indices as 9 bit lzw codes in data sub-blocks
+inline void WriteTestGifLZW(TestGifWriter &gif, const BYTE *lpIndices, UINT numPixels)
+{
+    const UINT clearCode = 256, endCode = 257;
+
+    List<BYTE> codes;
+    {
+        TestGifWriter out(codes, MaxTestGifLZWSize(numPixels));
+        DWORD bits = 0;
+        UINT numBits = 0;
+
+        auto WriteCode = [&](UINT code)
+        {
+            bits |= DWORD(code) << numBits;
+            numBits += 9;
+            while(numBits >= 8)
+            {
+                out.Byte(BYTE(bits));
+                bits >>= 8;
+                numBits -= 8;
+            }
+        };
+
+        for(UINT i=0; i<numPixels; i++)
+        {
+            //every literal after the first adds a table entry, clear it well before it needs 10 bits
+            if((i % 250) == 0)
+                WriteCode(clearCode);
+            WriteCode(lpIndices[i]);
+        }
+
+        WriteCode(endCode);
+        if(numBits)
+            out.Byte(BYTE(bits));
+    }
+
+    gif.Byte(8);
+    for(UINT i=0; i<codes.Num(); i+=255)
+    {
+        UINT blockSize = MIN(codes.Num()-i, 255);
+        gif.Byte(BYTE(blockSize));
+        gif.Bytes(codes.Array()+i, blockSize);
+    }
+    gif.Byte(0);
+}
+
+inline void BuildTestGif(List<BYTE> &data, UINT cx, UINT cy, UINT numFrames)
+{
+    UINT maxLZWSize = MaxTestGifLZWSize(cx*cy);
+    TestGifWriter gif(data, 1024 + numFrames*(maxLZWSize + maxLZWSize/255 + 32));
+
+    gif.Bytes("GIF89a", 6);
+    gif.Word(cx);
+    gif.Word(cy);
+    gif.Byte(0xF7); //256 color global palette
+    gif.Byte(0);
+    gif.Byte(0);
+
+    for(UINT i=0; i<256; i++)
+    {
+        gif.Byte(BYTE(i*37));
+        gif.Byte(BYTE(i*91));
+        gif.Byte(BYTE(i*53));
+    }
+
+    //loop forever
+    gif.Bytes("\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+
+    List<BYTE> indices;
+    indices.SetSize(cx*cy);
+
+    for(UINT frame=0; frame<numFrames; frame++)
+    {
+        gif.Bytes("\x21\xF9\x04\x00", 4);
+        gif.Word(TEST_GIF_DELAY);
+        gif.Byte(0);
+        gif.Byte(0);
+
+        gif.Byte(0x2C);
+        gif.Word(0);
+        gif.Word(0);
+        gif.Word(cx);
+        gif.Word(cy);
+        gif.Byte(0);
+
+        for(UINT y=0; y<cy; y++)
+        {
+            for(UINT x=0; x<cx; x++)
+                indices[y*cx + x] = TestGifPixel(x, y, frame, cx, cy);
+        }
+
+        WriteTestGifLZW(gif, indices.Array(), cx*cy);
+    }
+
+    gif.Byte(0x3B);
+}
+
+inline String TestGifFolder()
+{
+    TCHAR tempPath[MAX_PATH];
+    GetTempPath(MAX_PATH, tempPath);
+
+    String strFolder;
+    strFolder << tempPath << TEXT("OBSBitmapImageTest");
+    OSCreateDirectory(strFolder);
+    return strFolder;
+}
+
+inline String WriteTestGif(CTSTR lpName, UINT cx, UINT cy, UINT numFrames)
+{
+    String strPath;
+    strPath << TestGifFolder() << TEXT("\\") << lpName;
+
+    List<BYTE> gif;
+    BuildTestGif(gif, cx, cy, numFrames);
+
+    XFile file;
+    if(file.Open(strPath, XFILE_WRITE, XFILE_CREATEALWAYS))
+        file.Write(gif.Array(), gif.Num());
+
+    return strPath;
+}
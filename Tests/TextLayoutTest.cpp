@@ -0,0 +1,266 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// TextLayout with a stub rasterizer in place of gdi+.  every character is a solid cell of a color made
+// from the character, so what got drawn where can be checked to the pixel, and the rasterizer counts its
+// calls so the paragraph cache can be checked too:  unchanged paragraphs are neither measured nor drawn
+// again, paragraphs that go away are dropped, scrolling keeps the right ones, and GetChangedRect finds
+// exactly what moved.
+
+#include "TestCommon.h"
+#include "../Source/TextLayout.h"
+
+#include <algorithm>
+#include <vector>
+
+#define CHAR_CX 8
+#define CHAR_CY 16
+
+struct StubRasterizer : TextRasterizer
+{
+    UINT padding;
+    UINT numMeasured, numDrawn;
+    BYTE alpha;
+
+    StubRasterizer() : padding(0), numMeasured(0), numDrawn(0), alpha(255) {}
+
+    static inline uint32_t CharColor(wchar_t ch) {return (uint32_t(ch)*0x010305) & 0x00FFFFFF;}
+
+    UINT GetPadding() {return padding;}
+
+    //wraps at whole characters, empty paragraphs are one line high
+    void MeasureParagraph(const wchar_t *lpText, float maxWidth, float &cx, float &cy)
+    {
+        numMeasured++;
+
+        UINT length = (UINT)wcslen(lpText);
+        UINT perLine = (maxWidth > 0.0f) ? std::max(UINT(maxWidth)/CHAR_CX, 1U) : std::max(length, 1U);
+        UINT numLines = std::max((length+perLine-1)/perLine, 1U);
+
+        cx = float(std::min(length, perLine)*CHAR_CX);
+        cy = float(numLines*CHAR_CY);
+    }
+
+    void DrawParagraph(const wchar_t *lpText, float maxWidth, uint8_t *lpBits, UINT bitmapCX, UINT bitmapCY)
+    {
+        numDrawn++;
+
+        UINT length = (UINT)wcslen(lpText);
+        UINT perLine = (maxWidth > 0.0f) ? std::max(UINT(maxWidth)/CHAR_CX, 1U) : std::max(length, 1U);
+        UINT offset = padding/2;
+
+        for(UINT i=0; i<length; i++)
+        {
+            UINT cellX = offset + (i%perLine)*CHAR_CX, cellY = offset + (i/perLine)*CHAR_CY;
+            FillImageRect(lpBits, bitmapCX, bitmapCY, cellX, cellY, CHAR_CX, CHAR_CY, (uint32_t(alpha) << 24) | CharColor(lpText[i]));
+        }
+    }
+};
+
+static inline uint32_t GetPixel(const std::vector<uint8_t> &image, UINT cx, UINT x, UINT y)
+{
+    return ((const uint32_t*)image.data())[y*cx + x];
+}
+
+//----------------------------------------------------------------------------
+
+static void CheckCache()
+{
+    StubRasterizer rasterizer;
+    TextLayout layout;
+
+    layout.Layout(&rasterizer, L"abc\ndefg\r\n\nxy", 0.0f);
+    CHECK_EQUAL(layout.NumLines(), 4);
+    CHECK_EQUAL(layout.NumCachedParagraphs(), 4);
+    CHECK_EQUAL(rasterizer.numMeasured, 4);
+    CHECK(layout.Width() == 4*CHAR_CX);
+    CHECK(layout.Height() == 4*CHAR_CY);
+
+    std::vector<uint8_t> image(64*64*4, 0);
+    layout.Draw(&rasterizer, image.data(), 64, 64, 0, 0, 64);
+    CHECK_EQUAL(rasterizer.numDrawn, 4);
+
+    //the same text again costs nothing
+    layout.Layout(&rasterizer, L"abc\ndefg\r\n\nxy", 0.0f);
+    layout.Draw(&rasterizer, image.data(), 64, 64, 0, 0, 64);
+    CHECK_EQUAL(rasterizer.numMeasured, 4);
+    CHECK_EQUAL(rasterizer.numDrawn, 4);
+
+    //one changed line is the only thing measured and drawn, the old one is dropped
+    layout.Layout(&rasterizer, L"abc\ndefh\r\n\nxy", 0.0f);
+    layout.Draw(&rasterizer, image.data(), 64, 64, 0, 0, 64);
+    CHECK_EQUAL(rasterizer.numMeasured, 5);
+    CHECK_EQUAL(rasterizer.numDrawn, 5);
+    CHECK_EQUAL(layout.NumCachedParagraphs(), 4);
+
+    //repeated lines share one paragraph
+    layout.Layout(&rasterizer, L"abc\nabc\nabc", 0.0f);
+    CHECK_EQUAL(layout.NumLines(), 3);
+    CHECK_EQUAL(layout.NumCachedParagraphs(), 1);
+    CHECK_EQUAL(rasterizer.numMeasured, 5);
+
+    //a different width lays everything out again
+    layout.Layout(&rasterizer, L"abc\nabc\nabc", 2*CHAR_CX);
+    CHECK_EQUAL(rasterizer.numMeasured, 6);
+    CHECK(layout.Width() == 2*CHAR_CX);
+    CHECK(layout.Height() == 3*2*CHAR_CY);
+
+    //so does a style change
+    layout.Clear();
+    CHECK_EQUAL(layout.NumLines(), 0);
+    layout.Layout(&rasterizer, L"abc\nabc\nabc", 2*CHAR_CX);
+    CHECK_EQUAL(rasterizer.numMeasured, 7);
+
+    layout.Layout(&rasterizer, L"", 0.0f);
+    CHECK_EQUAL(layout.NumLines(), 0);
+    CHECK_EQUAL(layout.NumCachedParagraphs(), 0);
+    CHECK(layout.Height() == 0.0f);
+}
+
+static void CheckScrolling()
+{
+    StubRasterizer rasterizer;
+    TextLayout layout;
+
+    //room for two and a half lines keeps the last three, the top one partly off the top
+    layout.Layout(&rasterizer, L"1\n2\n3\n4\n5", 0.0f, 2.5f*CHAR_CY);
+    CHECK_EQUAL(layout.NumLines(), 3);
+    CHECK(layout.Height() == 3*CHAR_CY);
+
+    std::vector<uint8_t> image(CHAR_CX*40*4, 0);
+    int offset = int(2.5f*CHAR_CY - layout.Height());
+    layout.Draw(&rasterizer, image.data(), CHAR_CX, 40, 0, offset, 40);
+
+    CHECK_EQUAL(GetPixel(image, CHAR_CX, 0, 0),  0xFF000000 | StubRasterizer::CharColor('3'));
+    CHECK_EQUAL(GetPixel(image, CHAR_CX, 0, 39), 0xFF000000 | StubRasterizer::CharColor('5'));
+
+    //exactly fitting lines aren't cut
+    layout.Layout(&rasterizer, L"1\n2\n3\n4\n5", 0.0f, 2.0f*CHAR_CY);
+    CHECK_EQUAL(layout.NumLines(), 3);
+
+    //wrapped paragraphs scroll as a whole
+    layout.Layout(&rasterizer, L"abcd\nef", 2*CHAR_CX, 1.5f*CHAR_CY);
+    CHECK_EQUAL(layout.NumLines(), 2);
+    CHECK(layout.Height() == 3*CHAR_CY);
+}
+
+static void CheckDrawing()
+{
+    const UINT cx = 40, cy = 24;
+    const uint32_t background = 0xFF204060;
+
+    StubRasterizer rasterizer;
+    TextLayout layout;
+    layout.Layout(&rasterizer, L"ab\nc", 0.0f);
+
+    //placed, clipped on the left by a negative x, and cut off at clipBottom
+    std::vector<uint8_t> image(cx*cy*4);
+    FillImageRect(image.data(), cx, cy, 0, 0, cx, cy, background);
+    layout.Draw(&rasterizer, image.data(), cx, cy, -4, 2, 20);
+
+    CHECK_EQUAL(GetPixel(image, cx, 0, 1), background);
+    CHECK_EQUAL(GetPixel(image, cx, 0, 2), 0xFF000000 | StubRasterizer::CharColor('a'));
+    CHECK_EQUAL(GetPixel(image, cx, 3, 2), 0xFF000000 | StubRasterizer::CharColor('a'));
+    CHECK_EQUAL(GetPixel(image, cx, 4, 2), 0xFF000000 | StubRasterizer::CharColor('b'));
+    CHECK_EQUAL(GetPixel(image, cx, 11, 17), 0xFF000000 | StubRasterizer::CharColor('b'));
+    CHECK_EQUAL(GetPixel(image, cx, 12, 2), background);
+    CHECK_EQUAL(GetPixel(image, cx, 0, 18), 0xFF000000 | StubRasterizer::CharColor('c'));
+    CHECK_EQUAL(GetPixel(image, cx, 0, 19), 0xFF000000 | StubRasterizer::CharColor('c'));
+    CHECK_EQUAL(GetPixel(image, cx, 0, 20), background);
+    CHECK_EQUAL(GetPixel(image, cx, 4, 18), background);
+
+    //half transparent text over an opaque background keeps the background's alpha
+    rasterizer.alpha = 128;
+    layout.Clear();
+    layout.Layout(&rasterizer, L"a", 0.0f);
+
+    FillImageRect(image.data(), cx, cy, 0, 0, cx, cy, 0xFF000000);
+    layout.Draw(&rasterizer, image.data(), cx, cy, 0, 0, cy);
+
+    uint32_t color = StubRasterizer::CharColor('a');
+    uint32_t blended = GetPixel(image, cx, 0, 0);
+    CHECK_EQUAL(blended >> 24, 255);
+    for(UINT shift=0; shift<24; shift += 8)
+        CHECK_EQUAL((blended >> shift) & 0xFF, ((color >> shift) & 0xFF)*128/255);
+
+    //...and over nothing is the text as it is
+    FillImageRect(image.data(), cx, cy, 0, 0, cx, cy, 0);
+    layout.Draw(&rasterizer, image.data(), cx, cy, 0, 0, cy);
+    CHECK_EQUAL(GetPixel(image, cx, 0, 0), 0x80000000 | color);
+
+    //padding grows the paragraph bitmaps and moves the text in by half of it
+    rasterizer.alpha = 255;
+    rasterizer.padding = 4;
+    layout.Clear();
+    layout.Layout(&rasterizer, L"a", 0.0f);
+
+    FillImageRect(image.data(), cx, cy, 0, 0, cx, cy, 0);
+    layout.Draw(&rasterizer, image.data(), cx, cy, 0, 0, cy);
+    CHECK_EQUAL(GetPixel(image, cx, 1, 1), 0);
+    CHECK_EQUAL(GetPixel(image, cx, 2, 2), 0xFF000000 | color);
+    CHECK_EQUAL(GetPixel(image, cx, 9, 17), 0xFF000000 | color);
+    CHECK_EQUAL(GetPixel(image, cx, 10, 18), 0);
+}
+
+static void CheckImageHelpers()
+{
+    const UINT cx = 16, cy = 8;
+    std::vector<uint8_t> before(cx*cy*4, 0), after(cx*cy*4, 0);
+    UINT x, y, rectCX, rectCY;
+
+    CHECK(!GetChangedRect(before.data(), after.data(), cx, cy, x, y, rectCX, rectCY));
+
+    ((uint32_t*)after.data())[3*cx + 5] = 1;
+    CHECK(GetChangedRect(before.data(), after.data(), cx, cy, x, y, rectCX, rectCY));
+    CHECK_EQUAL(x, 5);
+    CHECK_EQUAL(y, 3);
+    CHECK_EQUAL(rectCX, 1);
+    CHECK_EQUAL(rectCY, 1);
+
+    ((uint32_t*)after.data())[6*cx + 1] = 1;
+    ((uint32_t*)after.data())[4*cx + 15] = 1;
+    CHECK(GetChangedRect(before.data(), after.data(), cx, cy, x, y, rectCX, rectCY));
+    CHECK_EQUAL(x, 1);
+    CHECK_EQUAL(y, 3);
+    CHECK_EQUAL(rectCX, 15);
+    CHECK_EQUAL(rectCY, 4);
+
+    //clipped on every side
+    FillImageRect(after.data(), cx, cy, -2, -2, 100, 100, 0x12345678);
+    for(UINT i=0; i<cx*cy; i++)
+        CHECK_EQUAL(((uint32_t*)after.data())[i], 0x12345678);
+
+    FillImageRect(before.data(), cx, cy, 14, 6, 4, 4, 7);
+    CHECK(GetChangedRect(after.data(), before.data(), cx, cy, x, y, rectCX, rectCY));
+    CHECK_EQUAL(GetPixel(before, cx, 15, 7), 7);
+    CHECK_EQUAL(GetPixel(before, cx, 13, 7), 0);
+    CHECK_EQUAL(GetPixel(before, cx, 15, 5), 0);
+}
+
+int main()
+{
+    CheckCache();
+    CheckScrolling();
+    CheckDrawing();
+    CheckImageHelpers();
+
+    return TestResult("TextLayoutTest");
+}
@@ -0,0 +1,194 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// the SSE2 ASCII runs in utf8-windows.cpp against the system converter on its own, which is what the
+// conversions were before.  random text that's mostly ASCII with multi-byte characters, surrogate pairs,
+// invalid sequences and lone surrogates mixed in, converted into buffers that are big enough, exactly big
+// enough or too small.  the results, lengths and output have to be the same every time.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+
+#include <random>
+#include <vector>
+
+const UINT numIterations = 20000;
+const UINT maxTextLength = 100;
+
+static std::mt19937 rng(0x4F425321);
+
+static UINT Random(UINT range) {return UINT(rng() % range);}
+
+static void AppendUTF8(std::vector<char> &text, UINT codePoint)
+{
+    if(codePoint < 0x80)
+        text.push_back(char(codePoint));
+    else if(codePoint < 0x800)
+    {
+        text.push_back(char(0xC0 | (codePoint >> 6)));
+        text.push_back(char(0x80 | (codePoint & 0x3F)));
+    }
+    else if(codePoint < 0x10000)
+    {
+        text.push_back(char(0xE0 | (codePoint >> 12)));
+        text.push_back(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.push_back(char(0x80 | (codePoint & 0x3F)));
+    }
+    else
+    {
+        text.push_back(char(0xF0 | (codePoint >> 18)));
+        text.push_back(char(0x80 | ((codePoint >> 12) & 0x3F)));
+        text.push_back(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.push_back(char(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+//long ASCII runs so the 16 character blocks get used, broken up at random spots
+static std::vector<char> RandomUTF8()
+{
+    std::vector<char> text;
+    UINT length = Random(maxTextLength+1);
+    UINT asciiOdds = 1+Random(64);
+
+    while(text.size() < length)
+    {
+        if(Random(asciiOdds))
+        {
+            text.push_back(char(Random(0x80)));
+            continue;
+        }
+
+        switch(Random(6))
+        {
+            case 0: AppendUTF8(text, 0x80+Random(0x800-0x80)); break;
+            case 1: AppendUTF8(text, 0x800+Random(0xD800-0x800)); break;
+            case 2: AppendUTF8(text, 0x10000+Random(0x100000)); break;
+            case 3: text.push_back(char(0x80+Random(0x80))); break;                  //stray continuation or lead byte
+            case 4: text.push_back(char(0xE2)); text.push_back(char(0x82)); break;   //truncated sequence
+            case 5: text.push_back(char(0xC0)); text.push_back(char(0xAF)); break;   //overlong
+        }
+    }
+
+    return text;
+}
+
+static std::vector<wchar_t> RandomWide()
+{
+    std::vector<wchar_t> text;
+    UINT length = Random(maxTextLength+1);
+    UINT asciiOdds = 1+Random(64);
+
+    while(text.size() < length)
+    {
+        if(Random(asciiOdds))
+        {
+            text.push_back(wchar_t(Random(0x80)));
+            continue;
+        }
+
+        switch(Random(5))
+        {
+            case 0: text.push_back(wchar_t(0x80+Random(0x80))); break;               //just past ASCII
+            case 1: text.push_back(wchar_t(0x100+Random(0xD800-0x100))); break;
+            case 2: text.push_back(wchar_t(0xD800+Random(0x400))); text.push_back(wchar_t(0xDC00+Random(0x400))); break;
+            case 3: text.push_back(wchar_t(0xD800+Random(0x800))); break;             //lone surrogate
+            case 4: text.push_back(wchar_t(0xE000+Random(0x2000))); break;
+        }
+    }
+
+    return text;
+}
+
+//an output size that's plenty, exactly right, one short or anything in between
+static size_t RandomOutSize(size_t needed)
+{
+    switch(Random(4))
+    {
+        case 0:  return needed*3+4;
+        case 1:  return needed;
+        case 2:  return needed ? needed-1 : 0;
+        default: return Random(UINT(needed)+2);
+    }
+}
+
+static void CheckUTF8(const std::vector<char> &text)
+{
+    const char *in = text.empty() ? "" : &text[0];
+    size_t insize = text.size();
+
+    int expectedLen = insize ? MultiByteToWideChar(CP_UTF8, 0, in, int(insize), NULL, 0) : 0;
+    CHECK_EQUAL(utf8_to_wchar_len(in, insize, 0), size_t(expectedLen));
+
+    size_t outsize = RandomOutSize(size_t(expectedLen));
+    std::vector<wchar_t> expected(outsize+1, 0x5A5A), out(outsize+1, 0x5A5A);
+
+    int expectedRet = MultiByteToWideChar(CP_UTF8, 0, in, int(insize), outsize ? &expected[0] : NULL, int(outsize));
+    size_t ret = utf8_to_wchar(in, insize, outsize ? &out[0] : NULL, outsize, 0);
+
+    CHECK_EQUAL(ret, size_t(expectedRet));
+    if(ret && size_t(expectedRet) == ret)
+        CHECK(memcmp(&out[0], &expected[0], ret*sizeof(wchar_t)) == 0);
+    CHECK(out[outsize] == 0x5A5A);
+}
+
+static void CheckWide(const std::vector<wchar_t> &text)
+{
+    const wchar_t *in = text.empty() ? L"" : &text[0];
+    size_t insize = text.size();
+
+    int expectedLen = insize ? WideCharToMultiByte(CP_UTF8, 0, in, int(insize), NULL, 0, NULL, NULL) : 0;
+    CHECK_EQUAL(wchar_to_utf8_len(in, insize, 0), size_t(expectedLen));
+
+    size_t outsize = RandomOutSize(size_t(expectedLen));
+    std::vector<char> expected(outsize+1, 0x5A), out(outsize+1, 0x5A);
+
+    int expectedRet = WideCharToMultiByte(CP_UTF8, 0, in, int(insize), outsize ? &expected[0] : NULL, int(outsize), NULL, NULL);
+    size_t ret = wchar_to_utf8(in, insize, outsize ? &out[0] : NULL, outsize, 0);
+
+    CHECK_EQUAL(ret, size_t(expectedRet));
+    if(ret && size_t(expectedRet) == ret)
+        CHECK(memcmp(&out[0], &expected[0], ret) == 0);
+    CHECK(out[outsize] == 0x5A);
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    for(UINT i=0; i<numIterations; i++)
+    {
+        CheckUTF8(RandomUTF8());
+        CheckWide(RandomWide());
+
+        //stop at the first few failures rather than printing thousands of them
+        if(TestFailureCount() > 10)
+            break;
+    }
+
+    //a null terminated string the way String and XFile pass them, the terminator is converted too
+    const char *utf8 = "settings for the \xE2\x80\x9Cmain\xE2\x80\x9D scene, 1920x1080 at 60 fps";
+    wchar_t wide[64];
+    CHECK_EQUAL(utf8_to_wchar(utf8, strlen(utf8)+1, wide, 64, 0), wcslen(wide)+1);
+    CHECK(wcscmp(wide, L"settings for the \x201Cmain\x201D scene, 1920x1080 at 60 fps") == 0);
+
+    TerminateXT();
+    return TestResult("UTF8FuzzTest");
+}
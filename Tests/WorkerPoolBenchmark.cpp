@@ -0,0 +1,149 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// scheduling PreprocessAsync the way MainCaptureLoop does, over synthetic sources that each burn a fixed
+// amount of cpu per frame (blending a BGRA frame the size of a text source).  the same batch goes through
+// a plain loop on one thread and through pools of a few sizes, with even loads and with one source much
+// heavier than the rest.  every source has to run exactly once per batch.
+
+#include "Main.h"       //Main.h has to come before the winsock headers TestCommon.h pulls in
+#include "WorkerPool.h"
+#include "TestCommon.h"
+
+class BusySource : public ImageSource
+{
+    List<DWORD> frame;
+    UINT numPasses;
+
+public:
+    UINT numRuns;
+
+    BusySource(UINT numPixels, UINT numPasses) : numPasses(numPasses), numRuns(0)
+    {
+        frame.SetSize(numPixels);
+        for(UINT i=0; i<numPixels; i++)
+            frame[i] = i*0x9E3779B9;
+    }
+
+    bool SupportsAsyncPreprocess() const {return true;}
+
+    void PreprocessAsync()
+    {
+        for(UINT pass=0; pass<numPasses; pass++)
+        {
+            for(UINT i=0; i<frame.Num(); i++)
+            {
+                DWORD src = frame[i], dst = frame[(i*7) % frame.Num()];
+                DWORD alpha = src >> 24;
+                frame[i] = (((src & 0xFF00FF)*alpha + (dst & 0xFF00FF)*(255-alpha)) >> 8 & 0xFF00FF) |
+                           (((src & 0x00FF00)*alpha + (dst & 0x00FF00)*(255-alpha)) >> 8 & 0x00FF00) | (src & 0xFF000000);
+            }
+        }
+
+        numRuns++;
+    }
+
+    void Render(const Vect2 &pos, const Vect2 &size) {}
+    Vect2 GetSize() const {return Vect2(0.0f, 0.0f);}
+};
+
+static void STDCALL PreprocessSourceAsync(ImageSource *source)
+{
+    source->PreprocessAsync();
+}
+
+static void RunBatch(const char *name, List<ImageSource*> &sources)
+{
+    char line[128];
+
+    for(UINT i=0; i<sources.Num(); i++)
+        static_cast<BusySource*>(sources[i])->numRuns = 0;
+
+    UINT numBatches = 0;
+    sprintf(line, "  %s, one thread", name);
+    Benchmark(line, [&]
+    {
+        for(UINT i=0; i<sources.Num(); i++)
+            sources[i]->PreprocessAsync();
+        numBatches++;
+    });
+
+    for(UINT numThreads=1; numThreads<=8; numThreads *= 2)
+    {
+        WorkerPool pool(numThreads);
+
+        sprintf(line, "  %s, pool of %u + caller", name, numThreads);
+        Benchmark(line, [&]
+        {
+            pool.Run((WORKERJOBPROC)PreprocessSourceAsync, (LPVOID*)sources.Array(), sources.Num());
+            numBatches++;
+        });
+    }
+
+    for(UINT i=0; i<sources.Num(); i++)
+        CHECK_EQUAL(static_cast<BusySource*>(sources[i])->numRuns, numBatches);
+}
+
+static void FreeSources(List<ImageSource*> &sources)
+{
+    for(UINT i=0; i<sources.Num(); i++)
+        delete sources[i];
+    sources.Clear();
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    printf("%u cores\n", OSGetTotalCores());
+
+    //640x120 is about what a line of text source is
+    const UINT numPixels = 640*120;
+
+    UINT sourceCounts[] = {1, 2, 4, 8, 16};
+    for(UINT i=0; i<sizeof(sourceCounts)/sizeof(sourceCounts[0]); i++)
+    {
+        List<ImageSource*> sources;
+        for(UINT j=0; j<sourceCounts[i]; j++)
+            sources << new BusySource(numPixels, 1);
+
+        char name[64];
+        sprintf(name, "%u even sources", sourceCounts[i]);
+        RunBatch(name, sources);
+        FreeSources(sources);
+    }
+
+    //one source doing eight times the work of the others, the batch can't finish before it does
+    List<ImageSource*> sources;
+    sources << new BusySource(numPixels, 8);
+    for(UINT i=0; i<7; i++)
+        sources << new BusySource(numPixels, 1);
+
+    RunBatch("1 heavy + 7 light sources", sources);
+    FreeSources(sources);
+
+    //nothing to do at all still has to be cheap, it happens every frame in scenes without any such source
+    WorkerPool pool(4);
+    Benchmark("  empty batch", [&] {pool.Run((WORKERJOBPROC)PreprocessSourceAsync, NULL, 0);});
+
+    TerminateXT();
+    return TestResult("WorkerPoolBenchmark");
+}
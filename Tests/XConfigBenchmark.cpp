@@ -0,0 +1,216 @@
+/********************************************************************************
+ Copyright (C) 2012 Hugh Bailey <obs.jim@gmail.com>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+********************************************************************************/
+
+
+
+//-------------------------------------------
+// XConfig with a 1,000 source scene collection:  parsing it, looking elements and values up by name and
+// saving it.  lookups in large elements go through the name index, so it's checked against renames,
+// reordering and duplicate names, and a background save is checked to land on its own and reload the same.
+// lookups only read the indexes, so one element is read from another thread while the file is changed.
+
+#include "TestCommon.h"
+#include "OBSApi.h"
+
+#include <atomic>
+#include <thread>
+
+const UINT numSources = 1000;
+const UINT valuesPerSource = 12;
+
+static String SourceName(UINT i) {return FormattedString(TEXT("source%u"), i);}
+static String ValueName(UINT i) {return FormattedString(TEXT("value%u"), i);}
+
+static void FillCollection(XConfig &config)
+{
+    XElement *sources = config.GetRootElement()->CreateElement(TEXT("sources"));
+    for(UINT i=0; i<numSources; i++)
+    {
+        XElement *source = sources->CreateElement(SourceName(i));
+        source->SetString(TEXT("class"), TEXT("BitmapImageSource"));
+        for(UINT j=0; j<valuesPerSource; j++)
+            source->SetInt(ValueName(j), int(i*valuesPerSource+j));
+    }
+}
+
+//same names, order and values all the way down
+static bool SameElements(XElement *a, XElement *b)
+{
+    if(a->NumBaseItems() != b->NumBaseItems())
+        return false;
+
+    for(UINT i=0; i<a->NumBaseItems(); i++)
+    {
+        XBaseItem *itemA = a->GetBaseItemByID(i);
+        XBaseItem *itemB = b->GetBaseItemByID(i);
+
+        if(itemA->IsElement() != itemB->IsElement() || scmp(itemA->GetName(), itemB->GetName()) != 0)
+            return false;
+
+        if(itemA->IsElement())
+        {
+            if(!SameElements(static_cast<XElement*>(itemA), static_cast<XElement*>(itemB)))
+                return false;
+        }
+        else if(scmp(static_cast<XDataItem*>(itemA)->GetData(), static_cast<XDataItem*>(itemB)->GetData()) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    InitXT(NULL, TEXT("FastAlloc"));
+
+    {
+        TCHAR tempDir[MAX_PATH];
+        GetTempPath(MAX_PATH, tempDir);
+        String strPath = String(tempDir) << TEXT("XConfigBenchmark.xconfig");
+        String strBackgroundPath = String(tempDir) << TEXT("XConfigBenchmarkBackground.xconfig");
+
+        {
+            XConfig config;
+            config.Open(strPath);
+            FillCollection(config);
+            config.Close(true);
+        }
+
+        Benchmark("XConfig::Open, 1000 sources", [&] {
+            XConfig config;
+            config.Open(strPath);
+        });
+
+        XConfig config;
+        CHECK(config.Open(strPath));
+
+        XElement *sources = config.GetRootElement()->GetElement(TEXT("sources"));
+        CHECK(sources != NULL);
+        if(!sources)
+            return TestResult("XConfigBenchmark");
+
+        CHECK_EQUAL(sources->NumElements(), numSources);
+        CHECK_EQUAL(sources->GetElement(TEXT("SOURCE999"))->GetInt(TEXT("value11")), int(999*valuesPerSource+11));
+        CHECK(sources->GetElement(TEXT("source1000")) == NULL);
+
+        UINT i = 0;
+        Benchmark("XElement::GetElement, 1000 sources", [&] {
+            i = (i+7919) % numSources;
+            DoNotOptimize(sources->GetElement(SourceName(i)));
+        });
+
+        Benchmark("XElement::GetInt, 1000 sources", [&] {
+            i = (i+7919) % numSources;
+            DoNotOptimize(sources->GetElement(SourceName(i))->GetInt(ValueName(i%valuesPerSource)));
+        });
+
+        Benchmark("XConfig::Save, 1000 sources", [&] {
+            config.Save();
+        });
+
+        //renames, reordering and duplicate names resolve the same way a scan of the items would
+        XElement *renamed = sources->GetElement(SourceName(500));
+        renamed->SetName(TEXT("Renamed"));
+        CHECK(sources->GetElement(SourceName(500)) == NULL);
+        CHECK(sources->GetElement(TEXT("renamed")) == renamed);
+
+        XElement *duplicate = sources->InsertElement(0, SourceName(10));
+        CHECK(sources->GetElement(SourceName(10)) == duplicate);
+        duplicate->MoveToBottom();
+        CHECK(sources->GetElement(SourceName(10)) != duplicate);
+        CHECK(sources->GetElement(SourceName(10))->NumDataItems() == valuesPerSource+1);
+        sources->RemoveElement(duplicate);
+
+        XElement *moved = sources->GetElement(SourceName(20));
+        moved->MoveUp();
+        CHECK(sources->GetElementByID(19) == moved);
+        CHECK(sources->GetElement(SourceName(20)) == moved);
+
+        sources->ReverseOrder();
+        CHECK(sources->GetElementByID(0) == sources->GetElement(SourceName(numSources-1)));
+        CHECK(sources->GetElement(TEXT("renamed")) == renamed);
+
+        for(UINT j=0; j<valuesPerSource; j++)
+            sources->RemoveItem(ValueName(j));
+        sources->SetInt(TEXT("count"), int(numSources));
+        CHECK_EQUAL(sources->GetInt(TEXT("count")), int(numSources));
+
+        //a renamed data item can't reach its element's index, lookups skip the index until the element changes
+        XDataItem *count = sources->GetDataItem(TEXT("count"));
+        count->SetName(TEXT("numSources"));
+        CHECK(sources->GetDataItem(TEXT("count")) == NULL);
+        CHECK(sources->GetDataItem(TEXT("NUMSOURCES")) == count);
+        count->SetName(TEXT("count"));
+        CHECK(sources->GetElement(TEXT("renamed")) == renamed);
+        sources->SetInt(TEXT("count"), int(numSources));
+        CHECK_EQUAL(sources->GetInt(TEXT("count")), int(numSources));
+
+        //indexes of other elements come and go (and the file's index list moves) while sources is read
+        std::atomic<bool> bStopReading(false);
+        std::atomic<UINT> numMissing(0);
+        std::thread reader([&] {
+            UINT k = 0;
+            while(!bStopReading)
+            {
+                k = (k+7919) % numSources;
+                if(k != 500 && !sources->GetElement(SourceName(k)))
+                    numMissing++;
+            }
+        });
+
+        for(UINT pass=0; pass<200; pass++)
+        {
+            XElement *scratch = config.GetRootElement()->CreateElement(TEXT("scratch"));
+            for(UINT j=0; j<40; j++)
+                scratch->SetInt(ValueName(j), int(j));
+            scratch->SetName(TEXT("scratch2"));
+            config.GetRootElement()->RemoveElement(scratch);
+        }
+
+        bStopReading = true;
+        reader.join();
+        CHECK_EQUAL(numMissing.load(), 0u);
+
+        //the save thread wakes for the snapshot on its own, without a flush
+        OSDeleteFile(strBackgroundPath);
+        config.SaveToInBackground(strBackgroundPath, 50);
+
+        QWORD startTime = TestTimeMS();
+        while(!OSFileExists(strBackgroundPath) && TestTimeMS()-startTime < 2000)
+            TestSleep(10);
+        CHECK(OSFileExists(strBackgroundPath));
+
+        //a later snapshot replaces the queued one, and a flush writes it straight away
+        sources->SetInt(TEXT("count"), 5);
+        config.SaveToInBackground(strBackgroundPath, 60000);
+        config.FlushSaves();
+
+        XConfig reloaded;
+        CHECK(reloaded.Open(strBackgroundPath));
+        CHECK(SameElements(config.GetRootElement(), reloaded.GetRootElement()));
+        CHECK_EQUAL(reloaded.GetRootElement()->GetElement(TEXT("sources"))->GetInt(TEXT("count")), 5);
+
+        reloaded.Close();
+        config.Close();
+        OSDeleteFile(strPath);
+        OSDeleteFile(strBackgroundPath);
+    }
+
+    TerminateXT();
+    return TestResult("XConfigBenchmark");
+}
@@ -136,6 +136,10 @@ static void HandleClientBW(RTMP *r, const RTMPPacket *packet);
 static int ReadN(RTMP *r, char *buffer, int n);
 static int WriteN(RTMP *r, const char *buffer, int n);
 
+static char *Scratch_Reserve(RTMPScratch *s, int size);
+static void Scratch_Free(RTMPScratch *s);
+static char *AMF_ArenaReserve(RTMP *r, int bodySize, char **pend);
+
 static void DecodeTEA(AVal *key, AVal *text);
 
 static int HTTP_Post(RTMP *r, RTMPTCmd cmd, const char *buf, int len);
@@ -149,6 +153,10 @@ static int clk_tck;
 #include "handshake.h"
 #endif
 
+#ifdef USE_SCHANNEL
+#include "tls_sspi.h"
+#endif
+
 uint32_t
 RTMP_GetTime()
 {
@@ -1230,6 +1238,14 @@ RTMP_Connect1(RTMP *r, RTMPPacket *cp)
             RTMP_Close(r);
             return FALSE;
         }
+#elif defined(USE_SCHANNEL)
+        r->m_sb.sb_ssl = TLS_SSPI_Connect(r->m_sb.sb_socket, r->Link.hostname.av_val, r->Link.hostname.av_len);
+        if (!r->m_sb.sb_ssl)
+        {
+            RTMP_Log(RTMP_LOGERROR, "%s, TLS_SSPI_Connect failed", __FUNCTION__);
+            RTMP_Close(r);
+            return FALSE;
+        }
 #else
         RTMP_Log(RTMP_LOGERROR, "%s, no SSL/TLS support", __FUNCTION__);
         RTMP_Close(r);
@@ -1766,9 +1782,11 @@ WriteN(RTMP *r, const char *buffer, int n)
     if (r->Link.rc4keyOut)
     {
         if (n > sizeof(buf))
-            encrypted = (char *)malloc(n);
+            encrypted = Scratch_Reserve(&r->m_cryptScratch, n);
         else
             encrypted = (char *)buf;
+        if (!encrypted)
+            return FALSE;
         ptr = encrypted;
         RC4_encrypt2(r->Link.rc4keyOut, n, buffer, ptr);
     }
@@ -1807,14 +1825,53 @@ WriteN(RTMP *r, const char *buffer, int n)
         ptr += nBytes;
     }
 
-#ifdef CRYPTO
-    if (encrypted && encrypted != buf)
-        free(encrypted);
-#endif
-
     return n == 0;
 }
 
+static char *
+Scratch_Reserve(RTMPScratch *s, int size)
+{
+    if (size > s->size)
+    {
+        int newSize = s->size ? s->size : RTMP_BUFFER_CACHE_SIZE;
+        char *buf;
+
+        while (newSize < size)
+            newSize *= 2;
+
+        buf = realloc(s->buf, newSize);
+        if (!buf)
+            return NULL;
+
+        s->buf = buf;
+        s->size = newSize;
+    }
+
+    return s->buf;
+}
+
+static void
+Scratch_Free(RTMPScratch *s)
+{
+    free(s->buf);
+    s->buf = NULL;
+    s->size = 0;
+}
+
+/* the connect path encodes its commands into the connection's AMF arena instead of fixed size stack
+ * buffers, so long play paths, tokens and connect extras fit.  returns the start of the buffer, the
+ * body goes RTMP_MAX_HEADER_SIZE bytes in so RTMP_SendPacket can put the header in front of it. */
+static char *
+AMF_ArenaReserve(RTMP *r, int bodySize, char **pend)
+{
+    char *buf = Scratch_Reserve(&r->m_amfScratch, RTMP_MAX_HEADER_SIZE + bodySize);
+    if (!buf)
+        return NULL;
+
+    *pend = buf + r->m_amfScratch.size;
+    return buf;
+}
+
 #define SAVC(x)	static const AVal av_##x = AVC(#x)
 
 SAVC(app);
@@ -1834,96 +1891,66 @@ SAVC(secureTokenResponse);
 SAVC(type);
 SAVC(nonprivate);
 
-static int
-SendConnectPacket(RTMP *r, RTMPPacket *cp)
+static char *
+EncodeConnect(RTMP *r, char *enc, char *pend, double txn)
 {
-    RTMPPacket packet;
-    char pbuf[4096], *pend = pbuf + sizeof(pbuf);
-    char *enc;
-
-    if (cp)
-        return RTMP_SendPacket(r, cp, TRUE);
-
-    if((r->Link.protocol & RTMP_FEATURE_WRITE) && r->m_bSendChunkSizeInfo)
-    {
-        packet.m_nChannel = 0x02;
-        packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
-        packet.m_packetType = RTMP_PACKET_TYPE_CHUNK_SIZE;
-        packet.m_nTimeStamp = 0;
-        packet.m_nInfoField2 = 0;
-        packet.m_hasAbsTimestamp = 0;
-        packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
-        packet.m_nBodySize = 4;
-
-        enc = packet.m_body;
-        AMF_EncodeInt32(enc, pend, r->m_outChunkSize);
-
-        if(!RTMP_SendPacket(r, &packet, FALSE))
-            return 0;
-    }
-
-    packet.m_nChannel = 0x03;	/* control channel (invoke) */
-    packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
-    packet.m_packetType = RTMP_PACKET_TYPE_INVOKE;
-    packet.m_nTimeStamp = 0;
-    packet.m_nInfoField2 = 0;
-    packet.m_hasAbsTimestamp = 0;
-    packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
-
-    enc = packet.m_body;
     enc = AMF_EncodeString(enc, pend, &av_connect);
-    enc = AMF_EncodeNumber(enc, pend, ++r->m_numInvokes);
+    if (!enc)
+        return NULL;
+    enc = AMF_EncodeNumber(enc, pend, txn);
+    if (!enc || enc >= pend)
+        return NULL;
     *enc++ = AMF_OBJECT;
 
     enc = AMF_EncodeNamedString(enc, pend, &av_app, &r->Link.app);
     if (!enc)
-        return FALSE;
+        return NULL;
     if (r->Link.protocol & RTMP_FEATURE_WRITE)
     {
         enc = AMF_EncodeNamedString(enc, pend, &av_type, &av_nonprivate);
         if (!enc)
-            return FALSE;
+            return NULL;
     }
     if (r->Link.flashVer.av_len)
     {
         enc = AMF_EncodeNamedString(enc, pend, &av_flashVer, &r->Link.flashVer);
         if (!enc)
-            return FALSE;
+            return NULL;
     }
     if (r->Link.swfUrl.av_len)
     {
         enc = AMF_EncodeNamedString(enc, pend, &av_swfUrl, &r->Link.swfUrl);
         if (!enc)
-            return FALSE;
+            return NULL;
     }
     if (r->Link.tcUrl.av_len)
     {
         enc = AMF_EncodeNamedString(enc, pend, &av_tcUrl, &r->Link.tcUrl);
         if (!enc)
-            return FALSE;
+            return NULL;
     }
     if (!(r->Link.protocol & RTMP_FEATURE_WRITE))
     {
         enc = AMF_EncodeNamedBoolean(enc, pend, &av_fpad, FALSE);
         if (!enc)
-            return FALSE;
+            return NULL;
         enc = AMF_EncodeNamedNumber(enc, pend, &av_capabilities, 15.0);
         if (!enc)
-            return FALSE;
+            return NULL;
         enc = AMF_EncodeNamedNumber(enc, pend, &av_audioCodecs, r->m_fAudioCodecs);
         if (!enc)
-            return FALSE;
+            return NULL;
         enc = AMF_EncodeNamedNumber(enc, pend, &av_videoCodecs, r->m_fVideoCodecs);
         if (!enc)
-            return FALSE;
+            return NULL;
         enc = AMF_EncodeNamedNumber(enc, pend, &av_videoFunction, 1.0);
         if (!enc)
-            return FALSE;
+            return NULL;
         if (r->Link.pageUrl.av_len)
         {
             enc = AMF_EncodeNamedString(enc, pend, &av_pageUrl, &r->Link.pageUrl);
             if (!enc)
-                return FALSE;
+                return NULL;
         }
     }
     if (r->m_fEncoding != 0.0 || r->m_bSendEncoding)
@@ -1931,10 +1958,10 @@ SendConnectPacket(RTMP *r, RTMPPacket *cp)
         /* AMF0, AMF3 not fully supported yet */
         enc = AMF_EncodeNamedNumber(enc, pend, &av_objectEncoding, r->m_fEncoding);
         if (!enc)
-            return FALSE;
+            return NULL;
     }
     if (enc + 3 >= pend)
-        return FALSE;
+        return NULL;
     *enc++ = 0;
     *enc++ = 0;			/* end of object - 0x00 0x00 0x09 */
     *enc++ = AMF_OBJECT_END;
@@ -1944,10 +1971,10 @@ SendConnectPacket(RTMP *r, RTMPPacket *cp)
     {
         enc = AMF_EncodeBoolean(enc, pend, r->Link.lFlags & RTMP_LF_AUTH);
         if (!enc)
-            return FALSE;
+            return NULL;
         enc = AMF_EncodeString(enc, pend, &r->Link.auth);
         if (!enc)
-            return FALSE;
+            return NULL;
     }
     if (r->Link.extras.o_num)
     {
@@ -1956,9 +1983,68 @@ SendConnectPacket(RTMP *r, RTMPPacket *cp)
         {
             enc = AMFProp_Encode(&r->Link.extras.o_props[i], enc, pend);
             if (!enc)
-                return FALSE;
+                return NULL;
         }
     }
+
+    return enc;
+}
+
+static int
+SendConnectPacket(RTMP *r, RTMPPacket *cp)
+{
+    RTMPPacket packet;
+    char sbuf[RTMP_MAX_HEADER_SIZE + 4];
+    char *pbuf, *pend, *enc;
+    int size = 4096;
+    double txn;
+
+    if (cp)
+        return RTMP_SendPacket(r, cp, TRUE);
+
+    if((r->Link.protocol & RTMP_FEATURE_WRITE) && r->m_bSendChunkSizeInfo)
+    {
+        packet.m_nChannel = 0x02;
+        packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
+        packet.m_packetType = RTMP_PACKET_TYPE_CHUNK_SIZE;
+        packet.m_nTimeStamp = 0;
+        packet.m_nInfoField2 = 0;
+        packet.m_hasAbsTimestamp = 0;
+        packet.m_body = sbuf + RTMP_MAX_HEADER_SIZE;
+        packet.m_nBodySize = 4;
+
+        AMF_EncodeInt32(packet.m_body, sbuf + sizeof(sbuf), r->m_outChunkSize);
+
+        if(!RTMP_SendPacket(r, &packet, FALSE))
+            return 0;
+    }
+
+    packet.m_nChannel = 0x03;	/* control channel (invoke) */
+    packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
+    packet.m_packetType = RTMP_PACKET_TYPE_INVOKE;
+    packet.m_nTimeStamp = 0;
+    packet.m_nInfoField2 = 0;
+    packet.m_hasAbsTimestamp = 0;
+
+    /* the transaction id is taken once, a retry with a bigger arena has to encode the same command */
+    txn = ++r->m_numInvokes;
+
+    for (;;)
+    {
+        pbuf = AMF_ArenaReserve(r, size, &pend);
+        if (!pbuf)
+            return FALSE;
+
+        packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
+        enc = EncodeConnect(r, packet.m_body, pend, txn);
+        if (enc)
+            break;
+
+        size = (int)(pend - pbuf) * 2;
+        if (size > RTMP_AMF_ARENA_MAX)
+            return FALSE;
+    }
+
     packet.m_nBodySize = enc - packet.m_body;
 
     return RTMP_SendPacket(r, &packet, TRUE);
@@ -2004,7 +2090,7 @@ int
 RTMP_SendCreateStream(RTMP *r)
 {
     RTMPPacket packet;
-    char pbuf[256], *pend = pbuf + sizeof(pbuf);
+    char *pbuf, *pend;
     char *enc;
 
     packet.m_nChannel = 0x03;	/* control channel (invoke) */
@@ -2013,6 +2099,9 @@ RTMP_SendCreateStream(RTMP *r)
     packet.m_nTimeStamp = 0;
     packet.m_nInfoField2 = 0;
     packet.m_hasAbsTimestamp = 0;
+    pbuf = AMF_ArenaReserve(r, 64, &pend);
+    if (!pbuf)
+        return FALSE;
     packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
 
     enc = packet.m_body;
@@ -2095,7 +2184,7 @@ static int
 SendReleaseStream(RTMP *r)
 {
     RTMPPacket packet;
-    char pbuf[1024], *pend = pbuf + sizeof(pbuf);
+    char *pbuf, *pend;
     char *enc;
 
     packet.m_nChannel = 0x03;	/* control channel (invoke) */
@@ -2104,6 +2193,9 @@ SendReleaseStream(RTMP *r)
     packet.m_nTimeStamp = 0;
     packet.m_nInfoField2 = 0;
     packet.m_hasAbsTimestamp = 0;
+    pbuf = AMF_ArenaReserve(r, 64 + r->Link.playpath.av_len, &pend);
+    if (!pbuf)
+        return FALSE;
     packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
 
     enc = packet.m_body;
@@ -2125,7 +2217,7 @@ static int
 SendFCPublish(RTMP *r)
 {
     RTMPPacket packet;
-    char pbuf[1024], *pend = pbuf + sizeof(pbuf);
+    char *pbuf, *pend;
     char *enc;
 
     packet.m_nChannel = 0x03;	/* control channel (invoke) */
@@ -2134,6 +2226,9 @@ SendFCPublish(RTMP *r)
     packet.m_nTimeStamp = 0;
     packet.m_nInfoField2 = 0;
     packet.m_hasAbsTimestamp = 0;
+    pbuf = AMF_ArenaReserve(r, 64 + r->Link.playpath.av_len, &pend);
+    if (!pbuf)
+        return FALSE;
     packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
 
     enc = packet.m_body;
@@ -2187,7 +2282,7 @@ static int
 SendPublish(RTMP *r)
 {
     RTMPPacket packet;
-    char pbuf[1024], *pend = pbuf + sizeof(pbuf);
+    char *pbuf, *pend;
     char *enc;
 
     packet.m_nChannel = 0x04;	/* source channel (invoke) */
@@ -2196,6 +2291,9 @@ SendPublish(RTMP *r)
     packet.m_nTimeStamp = 0;
     packet.m_nInfoField2 = r->m_stream_id;
     packet.m_hasAbsTimestamp = 0;
+    pbuf = AMF_ArenaReserve(r, 64 + r->Link.playpath.av_len, &pend);
+    if (!pbuf)
+        return FALSE;
     packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
 
     enc = packet.m_body;
@@ -4269,7 +4367,8 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
 
     if (packet->m_nChannel >= r->m_channelsAllocatedOut)
     {
-        int n = packet->m_nChannel + 10;
+        /* reserve the standard control/media channels up front so a new publish doesn't grow this per channel */
+        int n = packet->m_nChannel + 10 < RTMP_CHANNELS_OUT_RESERVE ? RTMP_CHANNELS_OUT_RESERVE : packet->m_nChannel + 10;
         RTMPPacket **packets = realloc(r->m_vecChannelsOut, sizeof(RTMPPacket*) * n);
         if (!packets)
         {
@@ -4389,7 +4488,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         if (chunks > 1)
         {
             tlen = chunks * (cSize + 1) + nSize + hSize;
-            tbuf = malloc(tlen);
+            tbuf = Scratch_Reserve(&r->m_chunkScratch, tlen);
             if (!tbuf)
                 return FALSE;
             toff = tbuf;
@@ -4441,7 +4540,6 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     if (tbuf)
     {
         int wrote = WriteN(r, tbuf, toff-tbuf);
-        free(tbuf);
         tbuf = NULL;
         if (!wrote)
             return FALSE;
@@ -4548,6 +4646,9 @@ RTMP_Close(RTMP *r)
     free(r->m_vecChannelsOut);
     r->m_vecChannelsOut = NULL;
     r->m_channelsAllocatedOut = 0;
+    Scratch_Free(&r->m_chunkScratch);
+    Scratch_Free(&r->m_cryptScratch);
+    Scratch_Free(&r->m_amfScratch);
     AV_clear(r->m_methodCalls, r->m_numCalls);
     r->m_methodCalls = NULL;
     r->m_numCalls = 0;
@@ -4621,6 +4722,12 @@ RTMPSockBuf_Fill(RTMPSockBuf *sb)
             nBytes = TLS_read(sb->sb_ssl, sb->sb_start + sb->sb_size, nBytes);
         }
         else
+#elif defined(USE_SCHANNEL)
+        if (sb->sb_ssl)
+        {
+            nBytes = TLS_SSPI_Read(sb->sb_ssl, sb->sb_start + sb->sb_size, nBytes);
+        }
+        else
 #endif
         {
             nBytes = recv(sb->sb_socket, sb->sb_start + sb->sb_size, nBytes, 0);
@@ -4674,6 +4781,12 @@ RTMPSockBuf_Send(RTMPSockBuf *sb, const char *buf, int len)
         rc = TLS_write(sb->sb_ssl, buf, len);
     }
     else
+#elif defined(USE_SCHANNEL)
+    if (sb->sb_ssl)
+    {
+        rc = TLS_SSPI_Write(sb->sb_ssl, buf, len);
+    }
+    else
 #endif
     {
         rc = send(sb->sb_socket, buf, len, 0);
@@ -4691,6 +4804,13 @@ RTMPSockBuf_Close(RTMPSockBuf *sb)
         TLS_close(sb->sb_ssl);
         sb->sb_ssl = NULL;
     }
+#elif defined(USE_SCHANNEL)
+    if (sb->sb_ssl)
+    {
+        TLS_SSPI_Shutdown(sb->sb_ssl);
+        TLS_SSPI_Close(sb->sb_ssl);
+        sb->sb_ssl = NULL;
+    }
 #endif
     if (sb->sb_socket != -1)
         return closesocket(sb->sb_socket);
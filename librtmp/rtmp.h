@@ -65,6 +65,9 @@ extern "C"
 
     /* needs to fit largest number of bytes recv() may return */
 #define RTMP_BUFFER_CACHE_SIZE (16*1024)
+#define RTMP_CHANNELS_OUT_RESERVE 16
+    /* largest command the connect path will encode */
+#define RTMP_AMF_ARENA_MAX (1024*1024)
 
 #define	RTMP_CHANNELS	65600
 
@@ -249,6 +252,14 @@ extern "C"
 
     typedef int (*CUSTOMSEND)(RTMPSockBuf*, const char *, int, void*);
 
+    /* per-connection scratch memory.  grows to the largest size requested and is
+     * reused afterwards, so sending doesn't allocate once it reaches steady state. */
+    typedef struct RTMPScratch
+    {
+        char *buf;
+        int size;
+    } RTMPScratch;
+
     typedef struct RTMP
     {
         int m_inChunkSize;
@@ -304,6 +315,10 @@ extern "C"
         RTMPPacket m_write;
         RTMPSockBuf m_sb;
         RTMP_LNK Link;
+
+        RTMPScratch m_chunkScratch;	/* chunk assembly for RTMPT sends */
+        RTMPScratch m_cryptScratch;	/* RC4 output for RTMPE sends */
+        RTMPScratch m_amfScratch;	/* AMF arena for connect path commands */
     } RTMP;
 
     int RTMP_ParseURL(const char *url, int *protocol, AVal *host,
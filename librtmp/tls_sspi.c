@@ -0,0 +1,632 @@
+/*
+ *  This file is part of librtmp.
+ *
+ *  librtmp is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1,
+ *  or (at your option) any later version.
+ *
+ *  librtmp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with librtmp see the file COPYING.  If not, write to
+ *  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *  http://www.gnu.org/copyleft/lgpl.html
+ */
+
+#include "rtmp_sys.h"
+#include "log.h"
+
+#ifdef USE_SCHANNEL
+
+#define SECURITY_WIN32
+#include <security.h>
+#include <schannel.h>
+
+#include "tls_sspi.h"
+
+#define TLS_RECV_BUFFER_SIZE (64*1024)
+
+/* how long a non-blocking socket may refuse the rest of a record (or the rest
+ * of a renegotiation) before the connection is considered dead, unless the
+ * caller sets its own with TLS_SSPI_SetTimeout.  the wait is done in slices so
+ * the abort event is noticed. */
+#define TLS_DEFAULT_TIMEOUT 5000
+#define TLS_WAIT_SLICE 50
+
+struct TLSSession
+{
+    SOCKET socket;
+    CtxtHandle context;
+    SecPkgContext_StreamSizes sizes;
+    int resumed;
+    char target[256];
+
+    DWORD timeout;
+    HANDLE abortEvent;
+
+    /* raw records read from the socket and not yet decrypted */
+    char *recvBuf;
+    int recvLen;
+    int recvSize;
+
+    /* decrypted data not yet handed out */
+    char *plainBuf;
+    int plainOffset;
+    int plainLen;
+
+    /* record assembly for TLS_SSPI_Write, and header/trailer space for
+     * TLS_SSPI_WriteInPlace */
+    char *recordBuf;
+    char *headerBuf;
+    char *trailerBuf;
+};
+
+static CredHandle sspiCred;
+static INIT_ONCE sspiCredInit = INIT_ONCE_STATIC_INIT;
+static BOOL sspiCredValid;
+
+static BOOL CALLBACK
+AcquireCred(PINIT_ONCE initOnce, PVOID param, PVOID *context)
+{
+    SCHANNEL_CRED cred;
+    SECURITY_STATUS status;
+
+    memset(&cred, 0, sizeof(cred));
+    cred.dwVersion = SCHANNEL_CRED_VERSION;
+#ifdef TLS_SSPI_NO_VALIDATION
+    /* only for the tests, the local stand-in server has a self-signed certificate */
+    cred.dwFlags = SCH_CRED_MANUAL_CRED_VALIDATION | SCH_CRED_NO_DEFAULT_CREDS;
+#else
+    cred.dwFlags = SCH_CRED_AUTO_CRED_VALIDATION | SCH_CRED_NO_DEFAULT_CREDS;
+#endif
+
+    status = AcquireCredentialsHandleA(NULL, UNISP_NAME_A, SECPKG_CRED_OUTBOUND, NULL,
+                                       &cred, NULL, NULL, &sspiCred, NULL);
+    if (status != SEC_E_OK)
+        RTMP_Log(RTMP_LOGERROR, "%s, AcquireCredentialsHandle failed: 0x%08x", __FUNCTION__, status);
+    else
+        sspiCredValid = TRUE;
+
+    return TRUE;
+}
+
+static int
+WaitSocket(TLSSession *ssn, int write)
+{
+    DWORD startTime = GetTickCount();
+
+    for (;;)
+    {
+        fd_set fds;
+        struct timeval tv;
+        int ret;
+
+        if (ssn->abortEvent && WaitForSingleObject(ssn->abortEvent, 0) == WAIT_OBJECT_0)
+        {
+            SetSockError(WSAECONNABORTED);
+            return FALSE;
+        }
+
+        FD_ZERO(&fds);
+        FD_SET(ssn->socket, &fds);
+        tv.tv_sec = 0;
+        tv.tv_usec = TLS_WAIT_SLICE * 1000;
+
+        ret = select(0, write ? NULL : &fds, write ? &fds : NULL, NULL, &tv);
+        if (ret == 1)
+            return TRUE;
+        if (ret == SOCKET_ERROR)
+            return FALSE;
+
+        if (GetTickCount() - startTime >= ssn->timeout)
+        {
+            RTMP_Log(RTMP_LOGERROR, "%s, socket not %s after %u ms", __FUNCTION__, write ? "writable" : "readable", ssn->timeout);
+            SetSockError(WSAETIMEDOUT);
+            return FALSE;
+        }
+    }
+}
+
+static int
+SendAll(TLSSession *ssn, WSABUF *bufs, DWORD count)
+{
+    while (count)
+    {
+        DWORD sent = 0;
+
+        if (WSASend(ssn->socket, bufs, count, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+        {
+            /* a record can't be left half written, so wait for the socket to take the rest */
+            if (WSAGetLastError() == WSAEWOULDBLOCK && WaitSocket(ssn, TRUE))
+                continue;
+            return FALSE;
+        }
+
+        while (count && sent >= bufs->len)
+        {
+            sent -= bufs->len;
+            bufs++;
+            count--;
+        }
+
+        if (count)
+        {
+            bufs->buf += sent;
+            bufs->len -= sent;
+        }
+    }
+
+    return TRUE;
+}
+
+static int
+SendToken(TLSSession *ssn, SecBuffer *token)
+{
+    WSABUF buf;
+    int ret;
+
+    if (!token->cbBuffer || !token->pvBuffer)
+        return TRUE;
+
+    buf.buf = (char *)token->pvBuffer;
+    buf.len = token->cbBuffer;
+    ret = SendAll(ssn, &buf, 1);
+
+    FreeContextBuffer(token->pvBuffer);
+    token->pvBuffer = NULL;
+    return ret;
+}
+
+static int
+RecvMore(TLSSession *ssn)
+{
+    int nBytes;
+
+    if (ssn->recvLen == ssn->recvSize)
+    {
+        char *buf = realloc(ssn->recvBuf, ssn->recvSize * 2);
+        if (!buf)
+            return -1;
+        ssn->recvBuf = buf;
+        ssn->recvSize *= 2;
+    }
+
+    nBytes = recv(ssn->socket, ssn->recvBuf + ssn->recvLen, ssn->recvSize - ssn->recvLen, 0);
+    if (nBytes > 0)
+        ssn->recvLen += nBytes;
+    return nBytes;
+}
+
+#define TLS_REQ_FLAGS (ISC_REQ_SEQUENCE_DETECT | ISC_REQ_REPLAY_DETECT | ISC_REQ_CONFIDENTIALITY | \
+                       ISC_REQ_ALLOCATE_MEMORY | ISC_REQ_STREAM)
+
+/* feeds what's in recvBuf (reading more first if needData is set) to InitializeSecurityContext until
+ * the context is complete.  used for the initial handshake and for renegotiation, which may happen on
+ * a non-blocking socket. */
+static int
+HandshakeLoop(TLSSession *ssn, int needData)
+{
+    SecBuffer inBufs[2], outBufs[1];
+    SecBufferDesc inDesc, outDesc;
+    SECURITY_STATUS status;
+    DWORD retFlags;
+
+    outDesc.ulVersion = SECBUFFER_VERSION;
+    outDesc.cBuffers = 1;
+    outDesc.pBuffers = outBufs;
+
+    for (;;)
+    {
+        if (needData)
+        {
+            int nBytes = RecvMore(ssn);
+            if (nBytes < 0 && GetSockError() == WSAEWOULDBLOCK)
+            {
+                if (!WaitSocket(ssn, FALSE))
+                    return FALSE;
+                continue;
+            }
+
+            if (nBytes <= 0)
+            {
+                RTMP_Log(RTMP_LOGERROR, "%s, connection closed during handshake (%d)", __FUNCTION__, GetSockError());
+                return FALSE;
+            }
+        }
+
+        inBufs[0].BufferType = SECBUFFER_TOKEN;
+        inBufs[0].pvBuffer = ssn->recvBuf;
+        inBufs[0].cbBuffer = ssn->recvLen;
+        inBufs[1].BufferType = SECBUFFER_EMPTY;
+        inBufs[1].pvBuffer = NULL;
+        inBufs[1].cbBuffer = 0;
+        inDesc.ulVersion = SECBUFFER_VERSION;
+        inDesc.cBuffers = 2;
+        inDesc.pBuffers = inBufs;
+
+        outBufs[0].BufferType = SECBUFFER_TOKEN;
+        outBufs[0].pvBuffer = NULL;
+        outBufs[0].cbBuffer = 0;
+
+        status = InitializeSecurityContextA(&sspiCred, &ssn->context, ssn->target, TLS_REQ_FLAGS, 0, 0,
+                                            &inDesc, 0, NULL, &outDesc, &retFlags, NULL);
+
+        if (status == SEC_E_INCOMPLETE_MESSAGE)
+        {
+            needData = TRUE;
+            continue;
+        }
+
+        if (status == SEC_E_OK || status == SEC_I_CONTINUE_NEEDED ||
+            (FAILED(status) && (retFlags & ISC_RET_EXTENDED_ERROR)))
+        {
+            /* alerts are sent out too so the server knows why we gave up */
+            if (!SendToken(ssn, &outBufs[0]))
+                return FALSE;
+        }
+        else if (outBufs[0].pvBuffer)
+        {
+            FreeContextBuffer(outBufs[0].pvBuffer);
+        }
+
+        if (FAILED(status))
+        {
+            RTMP_Log(RTMP_LOGERROR, "%s, TLS handshake failed: 0x%08x", __FUNCTION__, status);
+            return FALSE;
+        }
+
+        if (inBufs[1].BufferType == SECBUFFER_EXTRA && inBufs[1].cbBuffer)
+        {
+            memmove(ssn->recvBuf, ssn->recvBuf + ssn->recvLen - inBufs[1].cbBuffer, inBufs[1].cbBuffer);
+            ssn->recvLen = inBufs[1].cbBuffer;
+            needData = FALSE;
+        }
+        else
+        {
+            ssn->recvLen = 0;
+            needData = TRUE;
+        }
+
+        if (status == SEC_E_OK)
+            return TRUE;
+
+        if (status != SEC_I_CONTINUE_NEEDED)
+        {
+            /* SEC_I_INCOMPLETE_CREDENTIALS: the server wants a client certificate, which we don't have */
+            RTMP_Log(RTMP_LOGERROR, "%s, unsupported handshake status: 0x%08x", __FUNCTION__, status);
+            return FALSE;
+        }
+    }
+}
+
+static int
+Handshake(TLSSession *ssn)
+{
+    SecBuffer outBufs[1];
+    SecBufferDesc outDesc;
+    SECURITY_STATUS status;
+    DWORD retFlags;
+
+    outBufs[0].BufferType = SECBUFFER_TOKEN;
+    outBufs[0].pvBuffer = NULL;
+    outBufs[0].cbBuffer = 0;
+    outDesc.ulVersion = SECBUFFER_VERSION;
+    outDesc.cBuffers = 1;
+    outDesc.pBuffers = outBufs;
+
+    status = InitializeSecurityContextA(&sspiCred, NULL, ssn->target, TLS_REQ_FLAGS, 0, 0, NULL, 0,
+                                        &ssn->context, &outDesc, &retFlags, NULL);
+    if (status != SEC_I_CONTINUE_NEEDED)
+    {
+        RTMP_Log(RTMP_LOGERROR, "%s, InitializeSecurityContext failed: 0x%08x", __FUNCTION__, status);
+        return FALSE;
+    }
+
+    if (!SendToken(ssn, &outBufs[0]))
+        return FALSE;
+
+    return HandshakeLoop(ssn, TRUE);
+}
+
+TLSSession *
+TLS_SSPI_Connect(SOCKET s, const char *host, int hostLen)
+{
+    TLSSession *ssn;
+    SecPkgContext_SessionInfo sessionInfo;
+
+    InitOnceExecuteOnce(&sspiCredInit, AcquireCred, NULL, NULL);
+    if (!sspiCredValid)
+        return NULL;
+
+    if (hostLen >= sizeof(ssn->target))
+        return NULL;
+
+    ssn = calloc(1, sizeof(TLSSession));
+    if (!ssn)
+        return NULL;
+
+    ssn->socket = s;
+    ssn->timeout = TLS_DEFAULT_TIMEOUT;
+    memcpy(ssn->target, host, hostLen);
+    ssn->target[hostLen] = 0;
+    SecInvalidateHandle(&ssn->context);
+
+    ssn->recvSize = TLS_RECV_BUFFER_SIZE;
+    ssn->recvBuf = malloc(ssn->recvSize);
+    if (!ssn->recvBuf)
+        goto fail;
+
+    if (!Handshake(ssn))
+        goto fail;
+
+    if (QueryContextAttributesA(&ssn->context, SECPKG_ATTR_STREAM_SIZES, &ssn->sizes) != SEC_E_OK)
+    {
+        RTMP_Log(RTMP_LOGERROR, "%s, could not query TLS stream sizes", __FUNCTION__);
+        goto fail;
+    }
+
+    if (QueryContextAttributesA(&ssn->context, SECPKG_ATTR_SESSION_INFO, &sessionInfo) == SEC_E_OK)
+        ssn->resumed = (sessionInfo.dwFlags & SSL_SESSION_RECONNECT) != 0;
+
+    ssn->plainBuf = malloc(ssn->sizes.cbMaximumMessage);
+    ssn->recordBuf = malloc(ssn->sizes.cbHeader + ssn->sizes.cbMaximumMessage + ssn->sizes.cbTrailer);
+    ssn->headerBuf = malloc(ssn->sizes.cbHeader);
+    ssn->trailerBuf = malloc(ssn->sizes.cbTrailer);
+    if (!ssn->plainBuf || !ssn->recordBuf || !ssn->headerBuf || !ssn->trailerBuf)
+        goto fail;
+
+    RTMP_Log(RTMP_LOGDEBUG, "%s, TLS session with %s %s", __FUNCTION__, ssn->target,
+             ssn->resumed ? "resumed" : "established");
+    return ssn;
+
+fail:
+    TLS_SSPI_Close(ssn);
+    return NULL;
+}
+
+void
+TLS_SSPI_Close(TLSSession *ssn)
+{
+    if (!ssn)
+        return;
+
+    if (SecIsValidHandle(&ssn->context))
+        DeleteSecurityContext(&ssn->context);
+
+    free(ssn->recvBuf);
+    free(ssn->plainBuf);
+    free(ssn->recordBuf);
+    free(ssn->headerBuf);
+    free(ssn->trailerBuf);
+    free(ssn);
+}
+
+int
+TLS_SSPI_IsResumed(TLSSession *ssn)
+{
+    return ssn->resumed;
+}
+
+void
+TLS_SSPI_SetTimeout(TLSSession *ssn, unsigned int timeoutMS, HANDLE abortEvent)
+{
+    ssn->timeout = timeoutMS;
+    ssn->abortEvent = abortEvent;
+}
+
+void
+TLS_SSPI_Shutdown(TLSSession *ssn)
+{
+    DWORD type = SCHANNEL_SHUTDOWN;
+    SecBuffer buf;
+    SecBufferDesc desc;
+    DWORD retFlags;
+
+    buf.BufferType = SECBUFFER_TOKEN;
+    buf.pvBuffer = &type;
+    buf.cbBuffer = sizeof(type);
+    desc.ulVersion = SECBUFFER_VERSION;
+    desc.cBuffers = 1;
+    desc.pBuffers = &buf;
+
+    if (ApplyControlToken(&ssn->context, &desc) != SEC_E_OK)
+        return;
+
+    buf.BufferType = SECBUFFER_TOKEN;
+    buf.pvBuffer = NULL;
+    buf.cbBuffer = 0;
+
+    /* produces the close_notify alert */
+    if (SUCCEEDED(InitializeSecurityContextA(&sspiCred, &ssn->context, ssn->target, TLS_REQ_FLAGS,
+                  0, 0, NULL, 0, NULL, &desc, &retFlags, NULL)))
+        SendToken(ssn, &buf);
+    else if (buf.pvBuffer)
+        FreeContextBuffer(buf.pvBuffer);
+}
+
+int
+TLS_SSPI_Read(TLSSession *ssn, char *buf, int len)
+{
+    while (!ssn->plainLen)
+    {
+        if (ssn->recvLen)
+        {
+            SecBuffer bufs[4];
+            SecBufferDesc desc;
+            SECURITY_STATUS status;
+            int i;
+
+            bufs[0].BufferType = SECBUFFER_DATA;
+            bufs[0].pvBuffer = ssn->recvBuf;
+            bufs[0].cbBuffer = ssn->recvLen;
+            for (i = 1; i < 4; i++)
+            {
+                bufs[i].BufferType = SECBUFFER_EMPTY;
+                bufs[i].pvBuffer = NULL;
+                bufs[i].cbBuffer = 0;
+            }
+            desc.ulVersion = SECBUFFER_VERSION;
+            desc.cBuffers = 4;
+            desc.pBuffers = bufs;
+
+            status = DecryptMessage(&ssn->context, &desc, 0, NULL);
+
+            if (status == SEC_E_OK || status == SEC_I_RENEGOTIATE)
+            {
+                SecBuffer *data = NULL, *extra = NULL;
+
+                for (i = 1; i < 4; i++)
+                {
+                    if (bufs[i].BufferType == SECBUFFER_DATA)
+                        data = &bufs[i];
+                    else if (bufs[i].BufferType == SECBUFFER_EXTRA)
+                        extra = &bufs[i];
+                }
+
+                if (data && data->cbBuffer)
+                {
+                    memcpy(ssn->plainBuf, data->pvBuffer, data->cbBuffer);
+                    ssn->plainOffset = 0;
+                    ssn->plainLen = data->cbBuffer;
+                }
+
+                if (extra && extra->cbBuffer)
+                {
+                    memmove(ssn->recvBuf, ssn->recvBuf + ssn->recvLen - extra->cbBuffer, extra->cbBuffer);
+                    ssn->recvLen = extra->cbBuffer;
+                }
+                else
+                    ssn->recvLen = 0;
+
+                /* the server asked to renegotiate (with TLS 1.3 this is also how post-handshake messages
+                 * like new session tickets arrive), whatever came after the record goes back into
+                 * InitializeSecurityContext */
+                if (status == SEC_I_RENEGOTIATE && !HandshakeLoop(ssn, ssn->recvLen == 0))
+                {
+                    RTMP_Log(RTMP_LOGERROR, "%s, TLS renegotiation failed", __FUNCTION__);
+                    SetSockError(WSAECONNABORTED);
+                    return -1;
+                }
+
+                continue;
+            }
+            else if (status == SEC_I_CONTEXT_EXPIRED)
+            {
+                /* close_notify from the server */
+                ssn->recvLen = 0;
+                return 0;
+            }
+            else if (status != SEC_E_INCOMPLETE_MESSAGE)
+            {
+                RTMP_Log(RTMP_LOGERROR, "%s, DecryptMessage failed: 0x%08x", __FUNCTION__, status);
+                SetSockError(WSAECONNABORTED);
+                return -1;
+            }
+        }
+
+        {
+            int nBytes = RecvMore(ssn);
+            if (nBytes <= 0)
+                return nBytes;
+        }
+    }
+
+    if (len > ssn->plainLen)
+        len = ssn->plainLen;
+
+    memcpy(buf, ssn->plainBuf + ssn->plainOffset, len);
+    ssn->plainOffset += len;
+    ssn->plainLen -= len;
+    return len;
+}
+
+static int
+EncryptAndSend(TLSSession *ssn, char *header, char *data, int len, char *trailer)
+{
+    SecBuffer bufs[4];
+    SecBufferDesc desc;
+    WSABUF wsaBufs[3];
+
+    bufs[0].BufferType = SECBUFFER_STREAM_HEADER;
+    bufs[0].pvBuffer = header;
+    bufs[0].cbBuffer = ssn->sizes.cbHeader;
+    bufs[1].BufferType = SECBUFFER_DATA;
+    bufs[1].pvBuffer = data;
+    bufs[1].cbBuffer = len;
+    bufs[2].BufferType = SECBUFFER_STREAM_TRAILER;
+    bufs[2].pvBuffer = trailer;
+    bufs[2].cbBuffer = ssn->sizes.cbTrailer;
+    bufs[3].BufferType = SECBUFFER_EMPTY;
+    bufs[3].pvBuffer = NULL;
+    bufs[3].cbBuffer = 0;
+    desc.ulVersion = SECBUFFER_VERSION;
+    desc.cBuffers = 4;
+    desc.pBuffers = bufs;
+
+    if (EncryptMessage(&ssn->context, 0, &desc, 0) != SEC_E_OK)
+    {
+        SetSockError(WSAECONNABORTED);
+        return FALSE;
+    }
+
+    wsaBufs[0].buf = header;
+    wsaBufs[0].len = bufs[0].cbBuffer;
+    wsaBufs[1].buf = data;
+    wsaBufs[1].len = bufs[1].cbBuffer;
+    wsaBufs[2].buf = trailer;
+    wsaBufs[2].len = bufs[2].cbBuffer;
+
+    return SendAll(ssn, wsaBufs, 3);
+}
+
+int
+TLS_SSPI_Write(TLSSession *ssn, const char *buf, int len)
+{
+    int total = 0;
+
+    while (total < len)
+    {
+        int chunk = len - total;
+        char *data = ssn->recordBuf + ssn->sizes.cbHeader;
+
+        if (chunk > (int)ssn->sizes.cbMaximumMessage)
+            chunk = ssn->sizes.cbMaximumMessage;
+
+        memcpy(data, buf + total, chunk);
+
+        if (!EncryptAndSend(ssn, ssn->recordBuf, data, chunk, data + chunk))
+            return total ? total : -1;
+
+        total += chunk;
+    }
+
+    return total;
+}
+
+int
+TLS_SSPI_WriteInPlace(TLSSession *ssn, char *buf, int len)
+{
+    int total = 0;
+
+    while (total < len)
+    {
+        int chunk = len - total;
+
+        if (chunk > (int)ssn->sizes.cbMaximumMessage)
+            chunk = ssn->sizes.cbMaximumMessage;
+
+        if (!EncryptAndSend(ssn, ssn->headerBuf, buf + total, chunk, ssn->trailerBuf))
+            return total ? total : -1;
+
+        total += chunk;
+    }
+
+    return total;
+}
+
+#endif
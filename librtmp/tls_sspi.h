@@ -0,0 +1,64 @@
+#ifndef __TLS_SSPI_H__
+#define __TLS_SSPI_H__
+/*
+ *  This file is part of librtmp.
+ *
+ *  librtmp is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1,
+ *  or (at your option) any later version.
+ *
+ *  librtmp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with librtmp see the file COPYING.  If not, write to
+ *  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *  http://www.gnu.org/copyleft/lgpl.html
+ */
+
+/* Built-in TLS client on top of the Windows SChannel SSP, used for rtmps://
+ * when librtmp isn't built against an external TLS library.
+ *
+ * All sessions share one credentials handle for the life of the process.
+ * SChannel keeps its client session cache per credentials handle and target
+ * name, so reconnecting to the same ingest host resumes the previous TLS
+ * session (or uses its session ticket) instead of doing a full handshake. */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct TLSSession TLSSession;
+
+    TLSSession *TLS_SSPI_Connect(SOCKET s, const char *host, int hostLen);
+    void TLS_SSPI_Close(TLSSession *ssn);
+
+    int TLS_SSPI_Read(TLSSession *ssn, char *buf, int len);
+    int TLS_SSPI_Write(TLSSession *ssn, const char *buf, int len);
+
+    /* encrypts buf in place and writes it out as one or more records with
+     * the record headers and trailers gathered from separate buffers, so
+     * the payload isn't copied.  the contents of buf are undefined after
+     * the call.  like TLS_SSPI_Write this waits for a non-blocking socket to
+     * accept each whole record rather than leaving one half written, for up to
+     * the TLS_SSPI_SetTimeout limit. */
+    int TLS_SSPI_WriteInPlace(TLSSession *ssn, char *buf, int len);
+
+    int TLS_SSPI_IsResumed(TLSSession *ssn);
+
+    /* bounds how long a write (or a renegotiation started by a read) waits on
+     * a non-blocking socket, and gives an event that stops the wait when it's
+     * set.  the call fails with WSAETIMEDOUT or WSAECONNABORTED. */
+    void TLS_SSPI_SetTimeout(TLSSession *ssn, unsigned int timeoutMS, HANDLE abortEvent);
+    void TLS_SSPI_Shutdown(TLSSession *ssn);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif